@@ -130,10 +130,26 @@ void AllocateAndParseFlags() {
 
   ops_flags = new XlaOpsCommonFlags;
   ops_flags->tf_xla_always_defer_compilation = false;
+  ops_flags->tf_xla_async_compilation = false;
 
   jitter_flags = new IntroduceFloatingPointJitterPassFlags;
   jitter_flags->jitter_amount = 1e-5;
 
+  auto setter_for_batch_size_buckets = [](string sequence) {
+    std::vector<int64> buckets;
+    for (absl::string_view bucket :
+         absl::StrSplit(sequence, ',', absl::SkipEmpty())) {
+      int64 size;
+      if (!absl::SimpleAtoi(bucket, &size) || size <= 0 ||
+          (!buckets.empty() && size <= buckets.back())) {
+        return false;
+      }
+      buckets.push_back(size);
+    }
+    ops_flags->tf_xla_batch_size_buckets = std::move(buckets);
+    return true;
+  };
+
   auto setter_for_jitter_tensor_names = [](string sequence) {
     jitter_flags->tensor_names = absl::StrSplit(sequence, ',');
     return true;
@@ -161,6 +177,13 @@ void AllocateAndParseFlags() {
 
        Flag("tf_xla_always_defer_compilation",
             &ops_flags->tf_xla_always_defer_compilation, ""),
+       Flag("tf_xla_async_compilation", &ops_flags->tf_xla_async_compilation,
+            "If true then clusters are compiled on a background thread and "
+            "run in the TF executor until their compilation completes."),
+       Flag("tf_xla_batch_size_buckets", setter_for_batch_size_buckets, "",
+            "Comma-separated increasing sizes the leading dimension of the "
+            "inputs of CPU clusters is padded to, so that clusters are "
+            "compiled once per bucket instead of once per batch size."),
 
        Flag("tf_introduce_floating_point_jitter_to_tensors",
             setter_for_jitter_tensor_names, "",
@@ -91,6 +91,23 @@ struct XlaOpsCommonFlags {
   // If true, _XlaCompile always refuses to compile the cluster, which means the
   // XLA clusters always run in the TF executor.  Defaults to false.
   bool tf_xla_always_defer_compilation;
+
+  // If true, _XlaCompile compiles the clusters it does not have an executable
+  // for on a background thread, and runs them in the TF executor until the
+  // compilation completes, instead of blocking on the compilation.  Clusters
+  // that must be compiled are always compiled synchronously.  Defaults to
+  // false.
+  bool tf_xla_async_compilation;
+
+  // If non-empty, the increasing sizes the leading dimension of the inputs of
+  // clusters running on the CPU is padded to, so that a cluster is compiled
+  // once per bucket rather than once per batch size.  The outputs are sliced
+  // back to the batch size.  Clusters that cannot be compiled with padded
+  // inputs are compiled for their exact shapes.  Values the cluster folds from
+  // the shapes of its inputs at compile time see the bucket size, so this
+  // should only be enabled for models known to be insensitive to it.
+  // Defaults to empty.
+  std::vector<int64> tf_xla_batch_size_buckets;
 };
 
 // Flags for the build_xla_ops pass.
@@ -31,6 +31,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/function.h"
+#include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op.h"
@@ -99,18 +100,25 @@ XlaPlatformInfo PlatformInfoFromContext(OpKernelConstruction* ctx) {
 // the initial values for the resource variables (and cannot snapshot them again
 // during execution) because otherwise we risk observing a different snapshot
 // with shapes different from what we compiled for.
+//
+// If the executable was compiled with the inputs padded to a bucket of batch
+// sizes, `bucket` describes the padding and `padded_outputs` the outputs to
+// slice back to the batch size.
 class XlaExecutableClosure {
  public:
   explicit XlaExecutableClosure(
       xla::LocalClient* client, xla::LocalExecutable* executable,
       const XlaCompiler::CompilationResult* compilation_result,
       std::map<int, OptionalTensor> resource_var_snapshots,
-      int num_constant_args)
+      int num_constant_args, absl::optional<ShapeBucket> bucket,
+      std::vector<bool> padded_outputs)
       : client_(client),
         executable_(executable),
         compilation_result_(compilation_result),
         resource_var_snapshots_(std::move(resource_var_snapshots)),
-        num_constant_args_(num_constant_args) {}
+        num_constant_args_(num_constant_args),
+        bucket_(std::move(bucket)),
+        padded_outputs_(std::move(padded_outputs)) {}
 
   XlaExecutableClosure(XlaExecutableClosure&&) = default;
   XlaExecutableClosure& operator=(XlaExecutableClosure&&) = default;
@@ -124,6 +132,8 @@ class XlaExecutableClosure {
     return resource_var_snapshots_;
   }
   int num_constant_args() const { return num_constant_args_; }
+  const absl::optional<ShapeBucket>& bucket() const { return bucket_; }
+  const std::vector<bool>& padded_outputs() const { return padded_outputs_; }
 
  private:
   xla::LocalClient* client_;
@@ -131,6 +141,8 @@ class XlaExecutableClosure {
   const XlaCompiler::CompilationResult* compilation_result_;
   std::map<int, OptionalTensor> resource_var_snapshots_;
   int num_constant_args_;
+  absl::optional<ShapeBucket> bucket_;
+  std::vector<bool> padded_outputs_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(XlaExecutableClosure);
 };
@@ -267,13 +279,18 @@ static Status BuildCompilationCache(OpKernelContext* ctx,
   return Status::OK();
 }
 
+// If `batch_size_buckets` is non-empty, the arguments are padded to one of
+// these buckets when BucketArguments can, in which case `*bucket` describes the
+// padding.
 static Status CompileToLocalExecutable(
     OpKernelContext* ctx, const NameAttrList& function,
     const XlaPlatformInfo& platform_info, absl::Span<const int> resources,
-    absl::Span<const int> constants, bool lazy, xla::LocalClient** client,
+    absl::Span<const int> constants,
+    XlaCompilationCache::CompileMode compile_mode,
+    absl::Span<const int64> batch_size_buckets, xla::LocalClient** client,
     std::map<int, OptionalTensor>* variables,
     const XlaCompiler::CompilationResult** kernel,
-    xla::LocalExecutable** executable) {
+    xla::LocalExecutable** executable, absl::optional<ShapeBucket>* bucket) {
   // We store information about the JIT-compiled XLA computation
   // in the ResourceMgr.
   ResourceMgr* rm = ctx->resource_manager();
@@ -334,9 +351,10 @@ static Status CompileToLocalExecutable(
   std::vector<XlaCompiler::Argument> args;
   TF_RETURN_IF_ERROR(XlaComputationLaunchContext::BuildXlaCompilerArguments(
       constant_args, *variables, ctx, &args));
-  return cache->Compile(options, function, args, compile_options,
-                        lazy ? XlaCompilationCache::CompileMode::kLazy
-                             : XlaCompilationCache::CompileMode::kStrict,
+  if (!batch_size_buckets.empty()) {
+    *bucket = BucketArguments(batch_size_buckets, &args);
+  }
+  return cache->Compile(options, function, args, compile_options, compile_mode,
                         kernel, executable);
 }
 
@@ -351,8 +369,10 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
 
   {
     Status s = CompileToLocalExecutable(
-        ctx, function_, platform_info_, resources_, constants_, /*lazy=*/false,
-        &client, &variables, &kernel, &executable);
+        ctx, function_, platform_info_, resources_, constants_,
+        XlaCompilationCache::CompileMode::kStrict,
+        /*batch_size_buckets=*/{}, &client, &variables, &kernel, &executable,
+        /*bucket=*/nullptr);
     if (!s.ok() && (platform_info_.device_type().type_string() == DEVICE_CPU ||
                     platform_info_.device_type().type_string() == DEVICE_GPU)) {
       // Suggest auto jit if the failure was with GPU or CPU.
@@ -475,6 +495,8 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   const XlaCompiler::CompilationResult* kernel;
   xla::LocalExecutable* executable;
   std::map<int, OptionalTensor> variables;
+  absl::optional<ShapeBucket> bucket;
+  std::vector<bool> padded_outputs;
 
   bool cannot_compile_cluster;
   {
@@ -482,13 +504,52 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
     cannot_compile_cluster = cannot_compile_cluster_;
   }
 
-  if (GetXlaOpsCommonFlags().tf_xla_always_defer_compilation ||
-      cannot_compile_cluster) {
+  const XlaOpsCommonFlags& flags = GetXlaOpsCommonFlags();
+  if (flags.tf_xla_always_defer_compilation || cannot_compile_cluster) {
     executable = nullptr;
+    // Fallbacks decided by the compilation cache are recorded by the cache.
+    metrics::RecordXlaCompilationFallback(
+        cannot_compile_cluster ? "unimplemented" : "deferred");
   } else {
+    XlaCompilationCache::CompileMode compile_mode =
+        XlaCompilationCache::CompileMode::kStrict;
+    if (!must_compile_) {
+      compile_mode = flags.tf_xla_async_compilation
+                         ? XlaCompilationCache::CompileMode::kAsync
+                         : XlaCompilationCache::CompileMode::kLazy;
+    }
+    // Inputs are padded in host memory, so only clusters running on the CPU
+    // are bucketed.
+    absl::Span<const int64> batch_size_buckets;
+    if (platform_info_.platform_id() == se::host::kHostPlatformId) {
+      mutex_lock guard(bucketing_mu_);
+      if (!cannot_bucket_cluster_) {
+        batch_size_buckets = flags.tf_xla_batch_size_buckets;
+      }
+    }
     Status status = CompileToLocalExecutable(
-        ctx, function_, platform_info_, resources_, constants_,
-        /*lazy=*/!must_compile_, &client, &variables, &kernel, &executable);
+        ctx, function_, platform_info_, resources_, constants_, compile_mode,
+        batch_size_buckets, &client, &variables, &kernel, &executable,
+        &bucket);
+    if (status.ok() && bucket.has_value() && executable) {
+      status = GetPaddedOutputs(*kernel, *bucket, &padded_outputs);
+    }
+    if (!status.ok() && bucket.has_value()) {
+      VLOG(1) << "Compiling " << def().name()
+              << " for its exact shapes, since it cannot run with its inputs "
+                 "padded to a bucket: "
+              << status;
+      {
+        mutex_lock guard(bucketing_mu_);
+        cannot_bucket_cluster_ = true;
+      }
+      bucket.reset();
+      variables.clear();
+      status = CompileToLocalExecutable(
+          ctx, function_, platform_info_, resources_, constants_, compile_mode,
+          /*batch_size_buckets=*/{}, &client, &variables, &kernel, &executable,
+          /*bucket=*/nullptr);
+    }
     if (must_compile_ || status.code() != error::UNIMPLEMENTED) {
       OP_REQUIRES_OK(ctx, status);
     }
@@ -501,6 +562,7 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
           XlaOptimizationRemark::UNIMPLEMENTED_OPERATION, status.ToString())
           .IgnoreError();
       executable = nullptr;
+      metrics::RecordXlaCompilationFallback("unimplemented");
       mutex_lock guard(cannot_compile_cluster_mu_);
       cannot_compile_cluster_ = true;
     }
@@ -528,7 +590,8 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   // variables.
   XlaExecutableClosureStore::KeyT key =
       XlaExecutableClosureStore::Global()->Produce(XlaExecutableClosure(
-          client, executable, kernel, std::move(variables), constants_.size()));
+          client, executable, kernel, std::move(variables), constants_.size(),
+          std::move(bucket), std::move(padded_outputs)));
 
   Tensor compilation_key(cpu_allocator, DT_STRING, TensorShape({}));
   compilation_key.flat<tstring>()(0) = key;
@@ -540,6 +603,36 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   ctx->set_output(1, compilation_successful);
 }
 
+Status XlaCompileOp::GetPaddedOutputs(
+    const XlaCompiler::CompilationResult& kernel, const ShapeBucket& bucket,
+    std::vector<bool>* padded_outputs) {
+  bool found;
+  {
+    mutex_lock guard(bucketing_mu_);
+    found = bucketed_executables_.contains(&kernel);
+  }
+  // FindPaddedOutputs runs an HLO analysis, so it runs once per executable and
+  // outside of the lock.
+  BucketedExecutable new_executable;
+  if (!found) {
+    TF_RETURN_IF_ERROR(
+        FindPaddedOutputs(kernel, &new_executable.padded_outputs));
+  }
+
+  mutex_lock guard(bucketing_mu_);
+  BucketedExecutable& executable =
+      bucketed_executables_.emplace(&kernel, std::move(new_executable))
+          .first->second;
+  const bool first_run = executable.batch_sizes.empty();
+  const bool new_batch_size =
+      executable.batch_sizes.insert(bucket.batch_size).second;
+  metrics::RecordXlaShapeBucketing(bucket.batch_size, bucket.bucket_size,
+                                   /*reused_executable=*/!first_run &&
+                                       new_batch_size);
+  *padded_outputs = executable.padded_outputs;
+  return Status::OK();
+}
+
 XlaRunOp::XlaRunOp(OpKernelConstruction* ctx)
     : OpKernel(ctx), platform_info_(PlatformInfoFromContext(ctx)) {}
 
@@ -559,6 +652,9 @@ void XlaRunOp::Compute(OpKernelContext* ctx) {
       /*allocate_xla_tensors=*/platform_info_.is_on_xla_device(),
       /*use_multiple_streams=*/platform_info_.UseMultipleStreams());
 
+  // The padded inputs must outlive the execution.
+  std::map<int, OptionalTensor> padded_inputs;
+
   // We're missing the must-be-constant inputs, tell `PopulateInputs`
   // about this.  We don't actually need these inputs because they've
   // already been baked into the compiled kernel.
@@ -571,8 +667,17 @@ void XlaRunOp::Compute(OpKernelContext* ctx) {
         },
         tensorflow::profiler::TraceMeLevel::kInfo);
 
+    const std::map<int, OptionalTensor>* inputs =
+        &closure.resource_var_snapshots();
+    if (closure.bucket().has_value()) {
+      padded_inputs = closure.resource_var_snapshots();
+      OP_REQUIRES_OK(ctx, PadInputs(ctx, *closure.bucket(),
+                                    closure.num_constant_args(),
+                                    &padded_inputs));
+      inputs = &padded_inputs;
+    }
     launch_context.PopulateInputs(
-        ctx, closure.compilation_result(), closure.resource_var_snapshots(),
+        ctx, closure.compilation_result(), *inputs,
         /*missing_ctx_input_prefix=*/closure.num_constant_args());
   }
 
@@ -614,6 +719,11 @@ void XlaRunOp::Compute(OpKernelContext* ctx) {
           ctx, closure.compilation_result(), run_result.ConsumeValueOrDie(),
           /*missing_ctx_input_prefix=*/closure.num_constant_args(),
           input_output_alias));
+  if (closure.bucket().has_value()) {
+    OP_REQUIRES_OK(ctx, SlicePaddedOutputs(ctx, *closure.compilation_result(),
+                                           closure.padded_outputs(),
+                                           closure.bucket()->batch_size));
+  }
 }
 
 REGISTER_KERNEL_BUILDER(Name("XlaLaunch").Device(DEVICE_CPU), XlaLocalLaunchOp);
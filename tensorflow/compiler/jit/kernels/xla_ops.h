@@ -18,6 +18,9 @@ limitations under the License.
 
 #include <atomic>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/jit/shape_bucketing.h"
 #include "tensorflow/compiler/jit/xla_compilation_cache.h"
 #include "tensorflow/compiler/jit/xla_device.h"
 #include "tensorflow/compiler/jit/xla_launch_util.h"
@@ -160,6 +163,32 @@ class XlaCompileOp : public OpKernel {
   bool cannot_compile_cluster_ GUARDED_BY(cannot_compile_cluster_mu_) = false;
 
   mutex cannot_compile_cluster_mu_;
+
+  // Returns the outputs of `kernel`, compiled with its inputs padded as
+  // described by `bucket`, that must be sliced back to the batch size, and
+  // records the execution in the shape bucketing metrics.
+  Status GetPaddedOutputs(const XlaCompiler::CompilationResult& kernel,
+                          const ShapeBucket& bucket,
+                          std::vector<bool>* padded_outputs);
+
+  // cannot_bucket_cluster_ is set to true if the cluster cannot be compiled, or
+  // its outputs cannot be sliced, with its inputs padded to a bucket.  The
+  // cluster is then compiled for its exact shapes on any future calls.
+  bool cannot_bucket_cluster_ GUARDED_BY(bucketing_mu_) = false;
+
+  // Describes an executable compiled with bucketed inputs.
+  struct BucketedExecutable {
+    // The outputs to slice back to the batch size, as found by
+    // FindPaddedOutputs.
+    std::vector<bool> padded_outputs;
+
+    // The batch sizes the executable has run.
+    absl::flat_hash_set<int64> batch_sizes;
+  };
+  absl::flat_hash_map<const XlaCompiler::CompilationResult*, BucketedExecutable>
+      bucketed_executables_ GUARDED_BY(bucketing_mu_);
+
+  mutex bucketing_mu_;
 };
 
 class XlaRunOp : public OpKernel {
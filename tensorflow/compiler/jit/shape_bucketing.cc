@@ -0,0 +1,227 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/jit/shape_bucketing.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/service/dynamic_dimension_inference.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns true if `size`, the dynamic size of a dimension of the computation's
+// result, is the batch size argument, which is the only parameter
+// BucketArguments binds to dynamic dimensions.
+bool IsBatchSizeParameter(const xla::HloInstruction* size) {
+  if (size->opcode() == xla::HloOpcode::kGetTupleElement) {
+    size = size->operand(0);
+  }
+  return size->opcode() == xla::HloOpcode::kParameter;
+}
+
+}  // namespace
+
+absl::optional<int64> FindBucket(absl::Span<const int64> buckets,
+                                 int64 batch_size) {
+  auto it = std::lower_bound(buckets.begin(), buckets.end(), batch_size);
+  if (it == buckets.end()) {
+    return absl::nullopt;
+  }
+  return *it;
+}
+
+absl::optional<ShapeBucket> BucketArguments(
+    absl::Span<const int64> buckets, std::vector<XlaCompiler::Argument>* args) {
+  ShapeBucket bucket;
+  bucket.batch_size = 0;
+  for (int i = 0; i < args->size(); ++i) {
+    const XlaCompiler::Argument& arg = (*args)[i];
+    if (arg.kind != XlaCompiler::Argument::kParameter) {
+      continue;
+    }
+    if (!absl::holds_alternative<TensorShape>(arg.shape) ||
+        !arg.dynamic_dim_to_arg_num_map.empty()) {
+      return absl::nullopt;
+    }
+    const TensorShape& shape = absl::get<TensorShape>(arg.shape);
+    if (shape.dims() == 0) {
+      continue;
+    }
+    if (!bucket.padded_args.empty() && shape.dim_size(0) != bucket.batch_size) {
+      // The batch dimension is ambiguous.
+      return absl::nullopt;
+    }
+    bucket.batch_size = shape.dim_size(0);
+    bucket.padded_args.push_back(i);
+  }
+  if (bucket.batch_size == 0) {
+    return absl::nullopt;
+  }
+  absl::optional<int64> bucket_size = FindBucket(buckets, bucket.batch_size);
+  if (!bucket_size) {
+    return absl::nullopt;
+  }
+  bucket.bucket_size = *bucket_size;
+  bucket.batch_size_arg = args->size();
+
+  for (int i : bucket.padded_args) {
+    XlaCompiler::Argument& arg = (*args)[i];
+    TensorShape shape = absl::get<TensorShape>(arg.shape);
+    shape.set_dim(0, bucket.bucket_size);
+    arg.shape = shape;
+    arg.dynamic_dim_to_arg_num_map[0] = bucket.batch_size_arg;
+  }
+  XlaCompiler::Argument batch_size_arg;
+  batch_size_arg.kind = XlaCompiler::Argument::kParameter;
+  batch_size_arg.type = DT_UINT32;
+  batch_size_arg.shape = TensorShape();
+  batch_size_arg.name = "shape_bucketing_batch_size";
+  args->push_back(std::move(batch_size_arg));
+  return bucket;
+}
+
+Status FindPaddedOutputs(const XlaCompiler::CompilationResult& result,
+                         std::vector<bool>* padded_outputs) {
+  TF_RET_CHECK(result.computation != nullptr);
+  const xla::HloModuleProto& proto = result.computation->proto();
+  TF_ASSIGN_OR_RETURN(xla::HloModuleConfig config,
+                      xla::HloModule::CreateModuleConfigFromProto(
+                          proto, xla::GetDebugOptionsFromFlags()));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<xla::HloModule> module,
+                      xla::HloModule::CreateFromProto(proto, config));
+  // Fails on ops the inference does not know how to propagate dynamic
+  // dimensions through, which may not handle the padding correctly either.
+  TF_ASSIGN_OR_RETURN(xla::DynamicDimensionInference inference,
+                      xla::DynamicDimensionInference::Run(module.get()));
+
+  int num_outputs = 0;
+  for (const XlaCompiler::OutputDescription& output : result.outputs) {
+    if (!output.is_constant && output.type != DT_RESOURCE) {
+      ++num_outputs;
+    }
+  }
+  padded_outputs->assign(num_outputs, false);
+
+  xla::HloInstruction* root = module->entry_computation()->root_instruction();
+  const bool is_tuple = root->shape().IsTuple();
+  return xla::ShapeUtil::ForEachSubshapeWithStatus(
+      root->shape(),
+      [&](const xla::Shape& subshape, const xla::ShapeIndex& index) -> Status {
+        if (!subshape.IsArray()) {
+          return Status::OK();
+        }
+        for (int64 dim = 0; dim < subshape.rank(); ++dim) {
+          xla::HloInstruction* size =
+              inference.GetDynamicSize(root, index, dim);
+          if (size == nullptr) {
+            continue;
+          }
+          if (dim != 0 || !IsBatchSizeParameter(size)) {
+            return errors::Unimplemented(
+                "Dimension ", dim, " of output ", index.ToString(),
+                " depends on the batch size in a way that cannot be sliced.");
+          }
+          int output_num = 0;
+          if (is_tuple) {
+            if (index.size() != 1 || index[0] >= num_outputs) {
+              return errors::Unimplemented(
+                  "Output ", index.ToString(),
+                  " depends on the batch size but is not a tensor output.");
+            }
+            output_num = index[0];
+          } else {
+            TF_RET_CHECK(num_outputs == 1);
+          }
+          (*padded_outputs)[output_num] = true;
+        }
+        return Status::OK();
+      });
+}
+
+Status PadInputs(OpKernelContext* ctx, const ShapeBucket& bucket,
+                 int missing_ctx_input_prefix,
+                 std::map<int, OptionalTensor>* inputs) {
+  for (int arg_num : bucket.padded_args) {
+    const int input_num = arg_num - missing_ctx_input_prefix;
+    TF_RET_CHECK(input_num >= 0 && input_num < ctx->num_inputs());
+    const Tensor& input = ctx->input(input_num);
+    TF_RET_CHECK(input.dims() > 0 && input.dim_size(0) == bucket.batch_size);
+    if (!DataTypeCanUseMemcpy(input.dtype())) {
+      return errors::Unimplemented("Cannot pad inputs of type ",
+                                   DataTypeString(input.dtype()));
+    }
+
+    TensorShape padded_shape = input.shape();
+    padded_shape.set_dim(0, bucket.bucket_size);
+    OptionalTensor& padded = (*inputs)[arg_num];
+    padded.name = ctx->op_kernel().requested_input(input_num);
+    padded.present = true;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_temp(input.dtype(), padded_shape, &padded.value));
+    // The rows are contiguous, so the padding follows the batch.
+    char* data = static_cast<char*>(DMAHelper::base(&padded.value));
+    const size_t batch_bytes = input.TotalBytes();
+    if (batch_bytes > 0) {
+      std::memcpy(data, DMAHelper::base(&input), batch_bytes);
+    }
+    std::memset(data + batch_bytes, 0, padded.value.TotalBytes() - batch_bytes);
+  }
+
+  OptionalTensor& batch_size = (*inputs)[bucket.batch_size_arg];
+  batch_size.name = "shape_bucketing_batch_size";
+  batch_size.present = true;
+  TF_RETURN_IF_ERROR(
+      ctx->allocate_temp(DT_UINT32, TensorShape(), &batch_size.value));
+  batch_size.value.scalar<uint32>()() = bucket.batch_size;
+  return Status::OK();
+}
+
+Status SlicePaddedOutputs(OpKernelContext* ctx,
+                          const XlaCompiler::CompilationResult& result,
+                          const std::vector<bool>& padded_outputs,
+                          int64 batch_size) {
+  TF_RET_CHECK(ctx->num_outputs() == result.outputs.size());
+  // Outputs are numbered like in XlaComputationLaunchContext::PopulateOutputs.
+  int output_num = 0;
+  for (int i = 0; i < ctx->num_outputs(); ++i) {
+    const XlaCompiler::OutputDescription& output = result.outputs[i];
+    if (output.is_constant || output.type == DT_RESOURCE) {
+      continue;
+    }
+    TF_RET_CHECK(output_num < padded_outputs.size());
+    if (padded_outputs[output_num++]) {
+      TensorValue padded = ctx->release_output(i);
+      TF_RET_CHECK(padded.tensor != nullptr && padded.tensor->dims() > 0 &&
+                   padded.tensor->dim_size(0) >= batch_size);
+      Tensor sliced = padded.tensor->Slice(0, batch_size);
+      delete padded.tensor;
+      ctx->set_output(i, sliced);
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace tensorflow
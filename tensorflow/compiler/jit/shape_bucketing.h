@@ -0,0 +1,100 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Shape bucketing compiles an XLA cluster once per bucket of batch sizes
+// rather than once per batch size.  The leading dimension of the inputs is
+// padded to the smallest bucket that holds the batch, the batch size is passed
+// to the computation as an extra argument bound to that dimension, so that XLA
+// masks the padding out of the reductions and other ops that mix rows, and the
+// outputs are sliced back to the batch size.
+
+#ifndef TENSORFLOW_COMPILER_JIT_SHAPE_BUCKETING_H_
+#define TENSORFLOW_COMPILER_JIT_SHAPE_BUCKETING_H_
+
+#include <map>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/jit/xla_launch_util.h"
+#include "tensorflow/compiler/tf2xla/xla_compiler.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Describes how the arguments of a cluster have been padded to a bucket.
+struct ShapeBucket {
+  // The leading dimension of the padded arguments.
+  int64 batch_size;
+
+  // The leading dimension the padded arguments are padded to.
+  int64 bucket_size;
+
+  // The indices of the padded arguments.
+  std::vector<int> padded_args;
+
+  // The index of the scalar DT_UINT32 argument holding `batch_size`, which
+  // the computation is compiled with in addition to the cluster's arguments.
+  int batch_size_arg;
+};
+
+// Returns the smallest of the increasing `buckets` that is at least
+// `batch_size`, or nullopt if `batch_size` is larger than all of them.
+absl::optional<int64> FindBucket(absl::Span<const int64> buckets,
+                                 int64 batch_size);
+
+// Pads the leading dimension of the non-scalar parameters in `args` to the
+// bucket of their batch size, binds it to a batch size argument appended to
+// `args`, and returns how they were padded.  Returns nullopt and leaves `args`
+// unchanged if the arguments cannot be bucketed, i.e. if the non-scalar
+// parameters do not share a non-zero leading dimension or it is larger than
+// all the buckets.
+absl::optional<ShapeBucket> BucketArguments(
+    absl::Span<const int64> buckets, std::vector<XlaCompiler::Argument>* args);
+
+// Finds the outputs of `result`, compiled from arguments bucketed by
+// BucketArguments, whose leading dimension is the batch size, and must be
+// sliced back to it.  `padded_outputs` is indexed like the elements of the XLA
+// computation's result, i.e. it has an entry for every output that is neither a
+// compile-time constant nor a resource.
+//
+// Returns an error if some outputs or resource updates cannot be sliced back,
+// e.g. because a dimension other than the leading one depends on the batch
+// size, or if the batch size cannot be inferred through the computation, in
+// which case the cluster must be compiled for its exact shapes instead.
+Status FindPaddedOutputs(const XlaCompiler::CompilationResult& result,
+                         std::vector<bool>* padded_outputs);
+
+// Adds to `inputs`, keyed by argument index, copies of the padded inputs of
+// `ctx` whose leading dimension is padded with zeros to the bucket size, and
+// the batch size argument.  `inputs` can then be passed to
+// XlaComputationLaunchContext::PopulateInputs.  The inputs must be in host
+// memory.
+Status PadInputs(OpKernelContext* ctx, const ShapeBucket& bucket,
+                 int missing_ctx_input_prefix,
+                 std::map<int, OptionalTensor>* inputs);
+
+// Slices the outputs of `ctx` marked in `padded_outputs` back to `batch_size`
+// rows, after XlaComputationLaunchContext::PopulateOutputs set them.
+Status SlicePaddedOutputs(OpKernelContext* ctx,
+                          const XlaCompiler::CompilationResult& result,
+                          const std::vector<bool>& padded_outputs,
+                          int64 batch_size);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMPILER_JIT_SHAPE_BUCKETING_H_
@@ -0,0 +1,162 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/jit/shape_bucketing.h"
+
+#include "absl/memory/memory.h"
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/function_ops.h"
+#include "tensorflow/cc/ops/math_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+XlaCompiler::Argument Parameter(DataType type, const TensorShape& shape) {
+  XlaCompiler::Argument arg;
+  arg.kind = XlaCompiler::Argument::kParameter;
+  arg.type = type;
+  arg.shape = shape;
+  return arg;
+}
+
+TEST(ShapeBucketingTest, FindBucket) {
+  const std::vector<int64> buckets = {8, 32, 128};
+  EXPECT_EQ(FindBucket(buckets, 1), 8);
+  EXPECT_EQ(FindBucket(buckets, 8), 8);
+  EXPECT_EQ(FindBucket(buckets, 9), 32);
+  EXPECT_EQ(FindBucket(buckets, 128), 128);
+  EXPECT_FALSE(FindBucket(buckets, 129).has_value());
+}
+
+TEST(ShapeBucketingTest, BucketArguments) {
+  XlaCompiler::Argument constant;
+  constant.kind = XlaCompiler::Argument::kConstant;
+  constant.type = DT_INT32;
+  constant.shape = TensorShape({2});
+  std::vector<XlaCompiler::Argument> args = {
+      constant, Parameter(DT_FLOAT, TensorShape({5, 3})),
+      Parameter(DT_FLOAT, TensorShape({})),
+      Parameter(DT_INT32, TensorShape({5}))};
+
+  absl::optional<ShapeBucket> bucket = BucketArguments({4, 8}, &args);
+  ASSERT_TRUE(bucket.has_value());
+  EXPECT_EQ(bucket->batch_size, 5);
+  EXPECT_EQ(bucket->bucket_size, 8);
+  EXPECT_EQ(bucket->padded_args, std::vector<int>({1, 3}));
+  EXPECT_EQ(bucket->batch_size_arg, 4);
+
+  ASSERT_EQ(args.size(), 5);
+  EXPECT_EQ(absl::get<TensorShape>(args[0].shape), TensorShape({2}));
+  EXPECT_EQ(absl::get<TensorShape>(args[1].shape), TensorShape({8, 3}));
+  EXPECT_EQ(args[1].dynamic_dim_to_arg_num_map.at(0), 4);
+  EXPECT_TRUE(args[2].dynamic_dim_to_arg_num_map.empty());
+  EXPECT_EQ(absl::get<TensorShape>(args[3].shape), TensorShape({8}));
+  EXPECT_EQ(args[3].dynamic_dim_to_arg_num_map.at(0), 4);
+  EXPECT_EQ(args[4].kind, XlaCompiler::Argument::kParameter);
+  EXPECT_EQ(args[4].type, DT_UINT32);
+  EXPECT_EQ(absl::get<TensorShape>(args[4].shape), TensorShape());
+}
+
+TEST(ShapeBucketingTest, CannotBucketArguments) {
+  // The batch dimension is ambiguous.
+  std::vector<XlaCompiler::Argument> args = {
+      Parameter(DT_FLOAT, TensorShape({5, 3})),
+      Parameter(DT_FLOAT, TensorShape({3, 5}))};
+  EXPECT_FALSE(BucketArguments({8}, &args).has_value());
+  EXPECT_EQ(args.size(), 2);
+  EXPECT_EQ(absl::get<TensorShape>(args[0].shape), TensorShape({5, 3}));
+
+  // The batch is larger than the buckets.
+  args = {Parameter(DT_FLOAT, TensorShape({9}))};
+  EXPECT_FALSE(BucketArguments({8}, &args).has_value());
+
+  // The batch is empty, or there is no batch at all.
+  args = {Parameter(DT_FLOAT, TensorShape({0}))};
+  EXPECT_FALSE(BucketArguments({8}, &args).has_value());
+  args = {Parameter(DT_FLOAT, TensorShape({}))};
+  EXPECT_FALSE(BucketArguments({8}, &args).has_value());
+}
+
+class FindPaddedOutputsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    XlaOpRegistry::RegisterCompilationKernels();
+    flib_def_ = absl::make_unique<FunctionLibraryDefinition>(
+        OpRegistry::Global(), FunctionDefLibrary());
+  }
+
+  // Compiles `scope`, whose single argument is a f32[5, 3] batch, with its
+  // arguments padded to a bucket of 8.
+  Status Compile(const Scope& scope, XlaCompiler::CompilationResult* result) {
+    auto graph = absl::make_unique<Graph>(OpRegistry::Global());
+    TF_RETURN_IF_ERROR(scope.ToGraph(graph.get()));
+    std::vector<XlaCompiler::Argument> args = {
+        Parameter(DT_FLOAT, TensorShape({5, 3}))};
+    if (!BucketArguments({8}, &args).has_value()) {
+      return errors::Internal("Cannot bucket the arguments.");
+    }
+
+    XlaCompiler::Options options;
+    options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+    options.client = xla::ClientLibrary::LocalClientOrDie();
+    options.flib_def = flib_def_.get();
+    XlaCompiler compiler(options);
+    XlaCompiler::CompileOptions compile_options;
+    compile_options.always_return_tuple = false;
+    return compiler.CompileGraph(compile_options, "bucketed", std::move(graph),
+                                 args, /*user_aliases=*/{}, result);
+  }
+
+  std::unique_ptr<FunctionLibraryDefinition> flib_def_;
+};
+
+TEST_F(FindPaddedOutputsTest, SlicesBatchOutputs) {
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto x = ops::_Arg(scope.WithOpName("x"), DT_FLOAT, 0);
+  auto doubled = ops::Mul(scope.WithOpName("doubled"), x, 2.0f);
+  auto sum = ops::Sum(scope.WithOpName("sum"), x, 0);
+  ops::_Retval(scope.WithOpName("doubled_retval"), doubled, 0);
+  ops::_Retval(scope.WithOpName("sum_retval"), sum, 1);
+
+  XlaCompiler::CompilationResult result;
+  TF_ASSERT_OK(Compile(scope, &result));
+  std::vector<bool> padded_outputs;
+  TF_ASSERT_OK(FindPaddedOutputs(result, &padded_outputs));
+  // The reduction over the batch does not depend on the batch size.
+  EXPECT_EQ(padded_outputs, std::vector<bool>({true, false}));
+}
+
+TEST_F(FindPaddedOutputsTest, RejectsOutputsMixingBatchDimension) {
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto x = ops::_Arg(scope.WithOpName("x"), DT_FLOAT, 0);
+  auto flat = ops::Reshape(scope.WithOpName("flat"), x, {-1});
+  ops::_Retval(scope.WithOpName("flat_retval"), flat, 0);
+
+  XlaCompiler::CompilationResult result;
+  TF_ASSERT_OK(Compile(scope, &result));
+  std::vector<bool> padded_outputs;
+  EXPECT_FALSE(FindPaddedOutputs(result, &padded_outputs).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
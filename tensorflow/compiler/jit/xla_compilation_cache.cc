@@ -18,6 +18,7 @@ limitations under the License.
 #include <numeric>
 
 #include "absl/base/call_once.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/jit/xla_activity.pb.h"
@@ -49,6 +50,11 @@ XlaCompilationCache::XlaCompilationCache(xla::LocalClient* client,
     : client_(client), device_type_(std::move(device_type)) {}
 
 XlaCompilationCache::~XlaCompilationCache() {
+  // Wait for the background compilations, which write into the cache entries.
+  {
+    mutex_lock lock(async_compile_pool_mu_);
+    async_compile_pool_.reset();
+  }
   // Ensure any use of our programs have completed by waiting for all stream
   // executors to complete.
   for (auto* executor : client_->backend().stream_executors()) {
@@ -176,16 +182,16 @@ Status XlaCompilationCache::Compile(
     CompileMode compile_mode,
     const XlaCompiler::CompilationResult** out_compilation_result,
     xla::LocalExecutable** out_executable) {
-  absl::optional<int64> compile_threshold;
-  if (compile_mode == CompileMode::kLazy) {
-    compile_threshold = kDefaultCompilationThreshold;
-  }
-  auto compile_fn = [&](XlaCompiler* compiler,
+  // The function may be compiled after this call returns, so it owns copies of
+  // its arguments.
+  std::vector<XlaCompiler::Argument> compile_args(args.begin(), args.end());
+  auto compile_fn = [compile_options, function, compile_args](
+                        XlaCompiler* compiler,
                         XlaCompiler::CompilationResult* result) {
-    return compiler->CompileFunction(compile_options, function, args, result);
+    return compiler->CompileFunction(compile_options, function, compile_args,
+                                     result);
   };
-  return CompileImpl(options, function, args, compile_fn,
-                     /*compile_threshold=*/compile_threshold,
+  return CompileImpl(options, function, args, compile_fn, compile_mode,
                      out_compilation_result, out_executable);
 }
 
@@ -223,8 +229,7 @@ Status XlaCompilationCache::CompileSingleOp(
     return compiler->CompileSingleOp(compile_options, ctx->op_kernel().def(),
                                      args, result_dtypes, result);
   };
-  return CompileImpl(options, name, args, compile_op,
-                     /*compile_threshold=*/absl::nullopt,
+  return CompileImpl(options, name, args, compile_op, CompileMode::kStrict,
                      out_compilation_result, out_executable);
 }
 
@@ -242,12 +247,103 @@ void LogOnceXlaCompiledFirstCluster() {
 }
 }  // namespace
 
+Status XlaCompilationCache::CompileAndBuildExecutable(
+    const XlaCompiler::Options& options, const string& function_name,
+    const CompileFn& compile_fn,
+    XlaCompiler::CompilationResult* compilation_result,
+    std::unique_ptr<xla::LocalExecutable>* executable) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  const uint64 compile_start_us = env->NowMicros();
+
+  XlaCompiler compiler(options);
+  TF_RETURN_IF_ERROR(compile_fn(&compiler, compilation_result));
+  CHECK_EQ(executable->get(), nullptr);
+  Status status = BuildExecutable(options, *compilation_result, executable);
+
+  const uint64 compile_end_us = env->NowMicros();
+  const uint64 compile_time_us = compile_end_us - compile_start_us;
+  metrics::UpdateXlaCompilationTime(compile_time_us);
+  {
+    mutex_lock lock(cluster_compile_stats_mu_);
+    auto it = cluster_compile_stats_.find(function_name);
+    it->second.compile_count++;
+    it->second.cumulative_compile_time_us += compile_time_us;
+    LogOnceXlaCompiledFirstCluster();
+    VLOG(1) << "compiled " << function_name << " "
+            << it->second.compile_count
+            << " times, compile time: " << compile_time_us
+            << " us, cumulative: " << it->second.cumulative_compile_time_us
+            << " us ("
+            << tensorflow::strings::HumanReadableElapsedTime(compile_time_us /
+                                                             1.0e6)
+            << " / "
+            << tensorflow::strings::HumanReadableElapsedTime(
+                   it->second.cumulative_compile_time_us / 1.0e6)
+            << ")";
+
+    XlaJitCompilationActivity jit_compilation_activity;
+    jit_compilation_activity.set_cluster_name(function_name);
+    jit_compilation_activity.set_compile_count(it->second.compile_count);
+    jit_compilation_activity.set_compile_time_us(compile_time_us);
+    jit_compilation_activity.set_cumulative_compile_time_us(
+        it->second.cumulative_compile_time_us);
+
+    TF_RETURN_IF_ERROR(
+        BroadcastXlaActivity(std::move(jit_compilation_activity)));
+  }
+  return status;
+}
+
+void XlaCompilationCache::CompileAsync(const XlaCompiler::Options& options,
+                                       const string& function_name,
+                                       CompileFn compile_fn, Entry* entry) {
+  // The function library and the allocator of `options` belong to the
+  // requesting op, which may be gone by the time the compilation runs. Compile
+  // against a copy of the library, and let the client pick the allocator used
+  // during compilation.
+  XlaCompiler::Options async_options = options;
+  std::shared_ptr<FunctionLibraryDefinition> flib_def;
+  if (options.flib_def != nullptr) {
+    flib_def = std::make_shared<FunctionLibraryDefinition>(*options.flib_def);
+    async_options.flib_def = flib_def.get();
+  }
+  async_options.device_allocator = nullptr;
+
+  metrics::UpdateXlaAsyncCompilationQueueDepth(1);
+  mutex_lock lock(async_compile_pool_mu_);
+  if (!async_compile_pool_) {
+    async_compile_pool_ = absl::make_unique<thread::ThreadPool>(
+        Env::Default(), "xla_async_compile", kNumAsyncCompileThreads);
+  }
+  async_compile_pool_->Schedule([this, async_options, flib_def, function_name,
+                                 compile_fn, entry]() {
+    VLOG(2) << "Compiling " << function_name << " in the background";
+    XlaCompiler::CompilationResult compilation_result;
+    std::unique_ptr<xla::LocalExecutable> executable;
+    Status status = CompileAndBuildExecutable(
+        async_options, function_name, compile_fn, &compilation_result,
+        &executable);
+    if (!status.ok()) {
+      VLOG(1) << "Background compilation of " << function_name
+              << " failed: " << status;
+    }
+    {
+      // Swaps the result in at once, so callers either see no executable or
+      // the complete result of the compilation.
+      mutex_lock entry_lock(entry->mu);
+      entry->compilation_status = status;
+      entry->compilation_result = std::move(compilation_result);
+      entry->executable = std::move(executable);
+      entry->compile_state = CompileState::kCompiled;
+    }
+    metrics::UpdateXlaAsyncCompilationQueueDepth(-1);
+  });
+}
+
 Status XlaCompilationCache::CompileImpl(
     const XlaCompiler::Options& options, const NameAttrList& function,
-    absl::Span<const XlaCompiler::Argument> args,
-    const std::function<Status(XlaCompiler* compiler,
-                               XlaCompiler::CompilationResult*)>& compile_fn,
-    absl::optional<int64> compile_threshold,
+    absl::Span<const XlaCompiler::Argument> args, const CompileFn& compile_fn,
+    CompileMode compile_mode,
     const XlaCompiler::CompilationResult** out_compilation_result,
     xla::LocalExecutable** out_executable) {
   DCHECK_NE(out_executable, nullptr);
@@ -260,6 +356,11 @@ Status XlaCompilationCache::CompileImpl(
     }
   }
 
+  absl::optional<int64> compile_threshold;
+  if (compile_mode != CompileMode::kStrict) {
+    compile_threshold = kDefaultCompilationThreshold;
+  }
+
   TF_ASSIGN_OR_RETURN(Signature signature, BuildSignature(function, args));
   VLOG(2) << "Signature: " << signature.HumanString();
 
@@ -307,11 +408,20 @@ Status XlaCompilationCache::CompileImpl(
   // cache eviction.
   mutex_lock entry_lock(entry->mu);
   int64 current_request_count = ++entry->request_count;
-  VLOG(2) << "Compilation cache entry hit: " << entry->compiled
+  VLOG(2) << "Compilation cache entry hit: "
+          << static_cast<int>(entry->compile_state)
           << " signature: " << signature.HumanString() << " with request count "
           << current_request_count << " and compile threshold "
           << compile_threshold.value_or(0);
-  if (!entry->compiled) {
+  if (entry->compile_state == CompileState::kCompiling) {
+    VLOG(2) << "Not waiting for the background compilation of signature: "
+            << signature.HumanString();
+    metrics::RecordXlaCompilationFallback("compiling");
+    *out_compilation_result = nullptr;
+    *out_executable = nullptr;
+    return Status::OK();
+  }
+  if (entry->compile_state == CompileState::kUncompiled) {
     const bool should_compile = [&] {
       if (!compile_threshold.has_value()) {
         // Lazy compilation is disabled.
@@ -345,57 +455,27 @@ Status XlaCompilationCache::CompileImpl(
 
     if (!should_compile) {
       VLOG(2) << "Not compiling for signature: " << signature.HumanString();
+      metrics::RecordXlaCompilationFallback("lazy");
       *out_compilation_result = nullptr;
       *out_executable = nullptr;
       return Status::OK();
     }
 
-    tensorflow::Env* env = tensorflow::Env::Default();
-    const uint64 compile_start_us = env->NowMicros();
-    // Do the actual JIT compilation without holding the lock (it can take
-    // a long time.)
-
-    XlaCompiler compiler(options);
-    entry->compiled = true;
-
-    entry->compilation_status =
-        compile_fn(&compiler, &entry->compilation_result);
-    TF_RETURN_IF_ERROR(entry->compilation_status);
-    CHECK_EQ(entry->executable.get(), nullptr);
-    entry->compilation_status =
-        BuildExecutable(options, entry->compilation_result, &entry->executable);
-
-    const uint64 compile_end_us = env->NowMicros();
-    const uint64 compile_time_us = compile_end_us - compile_start_us;
-    metrics::UpdateXlaCompilationTime(compile_time_us);
-    {
-      mutex_lock lock(cluster_compile_stats_mu_);
-      auto it = cluster_compile_stats_.find(function.name());
-      it->second.compile_count++;
-      it->second.cumulative_compile_time_us += compile_time_us;
-      LogOnceXlaCompiledFirstCluster();
-      VLOG(1) << "compiled " << function.name() << " "
-              << it->second.compile_count
-              << " times, compile time: " << compile_time_us
-              << " us, cumulative: " << it->second.cumulative_compile_time_us
-              << " us ("
-              << tensorflow::strings::HumanReadableElapsedTime(compile_time_us /
-                                                               1.0e6)
-              << " / "
-              << tensorflow::strings::HumanReadableElapsedTime(
-                     it->second.cumulative_compile_time_us / 1.0e6)
-              << ")";
-
-      XlaJitCompilationActivity jit_compilation_activity;
-      jit_compilation_activity.set_cluster_name(function.name());
-      jit_compilation_activity.set_compile_count(it->second.compile_count);
-      jit_compilation_activity.set_compile_time_us(compile_time_us);
-      jit_compilation_activity.set_cumulative_compile_time_us(
-          it->second.cumulative_compile_time_us);
-
-      TF_RETURN_IF_ERROR(
-          BroadcastXlaActivity(std::move(jit_compilation_activity)));
+    if (compile_mode == CompileMode::kAsync) {
+      entry->compile_state = CompileState::kCompiling;
+      CompileAsync(options, function.name(), compile_fn, entry);
+      metrics::RecordXlaCompilationFallback("compiling");
+      *out_compilation_result = nullptr;
+      *out_executable = nullptr;
+      return Status::OK();
     }
+
+    // Do the actual JIT compilation without holding the outer lock (it can
+    // take a long time.)
+    entry->compile_state = CompileState::kCompiled;
+    entry->compilation_status = CompileAndBuildExecutable(
+        options, function.name(), compile_fn, &entry->compilation_result,
+        &entry->executable);
   }
   TF_RETURN_IF_ERROR(entry->compilation_status);
   *out_compilation_result = &entry->compilation_result;
@@ -49,6 +49,7 @@ class XlaCompilationCache : public ResourceBase {
   enum class CompileMode {
     kLazy,
     kStrict,
+    kAsync,
   };
 
   // Compiles a function into a XlaCompiler::CompilationResult that can be used
@@ -61,7 +62,11 @@ class XlaCompilationCache : public ResourceBase {
   // heuristics, the compilation cache may decide not to compile the cluster at
   // this time.  In this case it returns null into both `out_compilation_result`
   // and `out_executable`.  If `compile_mode` is `kStrict` then the compilation
-  // cache always attempts the compilation on a cache miss.
+  // cache always attempts the compilation on a cache miss.  If `compile_mode`
+  // is `kAsync` then the cache makes the same decisions as with `kLazy`, but
+  // runs the compilations it decides to do on a background thread and returns
+  // null until they complete, so the caller can run the cluster some other way
+  // in the meantime.
   //
   // The result of compilation is written to `*out_compilation_result`, which
   // must be non-null. If `out_executable` is non-null, also builds an
@@ -119,16 +124,25 @@ class XlaCompilationCache : public ResourceBase {
       absl::Span<const XlaCompiler::Argument> args);
 
  private:
+  using CompileFn = std::function<Status(XlaCompiler* compiler,
+                                          XlaCompiler::CompilationResult*)>;
+
   // Common implementation of Compile and CompileSingleOp.
   Status CompileImpl(
       const XlaCompiler::Options& options, const NameAttrList& function,
       absl::Span<const XlaCompiler::Argument> args,
-      const std::function<Status(XlaCompiler* compiler,
-                                 XlaCompiler::CompilationResult*)>& compile_fn,
-      absl::optional<int64> compile_threshold,
+      const CompileFn& compile_fn, CompileMode compile_mode,
       const XlaCompiler::CompilationResult** out_compilation_result,
       xla::LocalExecutable** out_executable);
 
+  // Runs `compile_fn` and builds the executable of its result, and records
+  // the compilation in the statistics of `function_name`.
+  Status CompileAndBuildExecutable(
+      const XlaCompiler::Options& options, const string& function_name,
+      const CompileFn& compile_fn,
+      XlaCompiler::CompilationResult* compilation_result,
+      std::unique_ptr<xla::LocalExecutable>* executable);
+
   // Takes `result` which has been compiled from a Tensorflow subgraph to a
   // XLA computation already, and generates an XLA LocalExecutable `executable`.
   Status BuildExecutable(const XlaCompiler::Options& options,
@@ -138,12 +152,19 @@ class XlaCompilationCache : public ResourceBase {
   xla::LocalClient* const client_;
   const DeviceType device_type_;
 
+  enum class CompileState {
+    kUncompiled,
+    kCompiling,
+    kCompiled,
+  };
+
   // The value associated with a cache entry.
   struct Entry {
     mutex mu;
 
-    // Have we tried compiling this entry?
-    bool compiled = false;
+    // Have we tried compiling this entry, or is it being compiled in the
+    // background?
+    CompileState compile_state = CompileState::kUncompiled;
 
     // The number of times a compilation with this signature has been requested.
     int64 request_count = 0;
@@ -159,6 +180,12 @@ class XlaCompilationCache : public ResourceBase {
     std::unique_ptr<xla::LocalExecutable> executable GUARDED_BY(mu);
   };
 
+  // Compiles the entry on `async_compile_pool_`, and makes the result visible
+  // to the callers of Compile once it is available.
+  void CompileAsync(const XlaCompiler::Options& options,
+                    const string& function_name, CompileFn compile_fn,
+                    Entry* entry);
+
   mutex compile_cache_mu_;
   absl::flat_hash_map<Signature, std::unique_ptr<Entry>, Signature::Hash> cache_
       GUARDED_BY(compile_cache_mu_);
@@ -189,6 +216,13 @@ class XlaCompilationCache : public ResourceBase {
   // signature before  we attempt to compile it.
   static constexpr int64 kDefaultCompilationThreshold = 2;
 
+  // The number of threads compiling clusters in the background.  Created on
+  // the first asynchronous compilation.
+  static constexpr int kNumAsyncCompileThreads = 2;
+  mutex async_compile_pool_mu_;
+  std::unique_ptr<thread::ThreadPool> async_compile_pool_
+      GUARDED_BY(async_compile_pool_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(XlaCompilationCache);
 };
 
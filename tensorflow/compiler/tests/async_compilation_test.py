@@ -0,0 +1,102 @@
+# Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for asynchronous compilation of XLA clusters."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+import time
+
+import numpy as np
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.core.protobuf import rewriter_config_pb2
+from tensorflow.python.client import session as session_lib
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import function
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.platform import test
+
+
+def NoRewriteSessionConfig():
+  rewriter_config = rewriter_config_pb2.RewriterConfig(
+      disable_model_pruning=True,
+      arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF,
+      dependency_optimization=rewriter_config_pb2.RewriterConfig.OFF,
+      function_optimization=rewriter_config_pb2.RewriterConfig.OFF)
+  graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
+  return config_pb2.ConfigProto(graph_options=graph_options)
+
+
+def RunAndCheckXlaRun(sess, fetch, feed_dict):
+  """Runs `fetch` and returns its value and whether an _XlaRun op ran."""
+  run_metadata = config_pb2.RunMetadata()
+  value = sess.run(
+      fetch,
+      feed_dict=feed_dict,
+      run_metadata=run_metadata,
+      options=config_pb2.RunOptions(
+          trace_level=config_pb2.RunOptions.FULL_TRACE))
+  labels = [
+      node_stats.timeline_label
+      for dev_stats in run_metadata.step_stats.dev_stats
+      for node_stats in dev_stats.node_stats
+  ]
+  return value, any("_XlaRun" in label for label in labels)
+
+
+class AsyncCompilationTest(test.TestCase):
+
+  def testFallsBackUntilCompiled(self):
+
+    @function.Defun(compiled=True)
+    def CompiledFunction(x):
+      return math_ops.log(x) * 2.
+
+    inputs = np.array([2., 10., 19., 77., 100.], dtype=np.float32)
+    expected = np.log(inputs) * 2.
+    with session_lib.Session(config=NoRewriteSessionConfig()) as sess:
+      x = array_ops.placeholder(dtypes.float32)
+      y = CompiledFunction(x)
+
+      # The first run queues the compilation and runs the cluster in the TF
+      # executor instead of waiting for it.
+      value, ran_xla = RunAndCheckXlaRun(sess, y, {x: inputs})
+      self.assertFalse(ran_xla)
+      self.assertAllClose(expected, value)
+
+      # Later runs pick up the executable once its compilation completes.
+      deadline = time.time() + 60
+      while not ran_xla and time.time() < deadline:
+        value, ran_xla = RunAndCheckXlaRun(sess, y, {x: inputs})
+        self.assertAllClose(expected, value)
+        if not ran_xla:
+          time.sleep(0.01)
+      self.assertTrue(ran_xla)
+
+      # Once compiled, the cluster keeps running through XLA.
+      value, ran_xla = RunAndCheckXlaRun(sess, y, {x: inputs})
+      self.assertTrue(ran_xla)
+      self.assertAllClose(expected, value)
+
+
+if __name__ == "__main__":
+  os.environ["TF_XLA_FLAGS"] = ("--tf_xla_enable_lazy_compilation=true "
+                                "--tf_xla_async_compilation=true " +
+                                os.environ.get("TF_XLA_FLAGS", ""))
+  test.main()
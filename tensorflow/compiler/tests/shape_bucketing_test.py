@@ -0,0 +1,93 @@
+# Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for compiling XLA clusters for buckets of batch sizes."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+import numpy as np
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.core.protobuf import rewriter_config_pb2
+from tensorflow.python.client import session as session_lib
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import function
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.platform import test
+
+
+def NoRewriteSessionConfig():
+  rewriter_config = rewriter_config_pb2.RewriterConfig(
+      disable_model_pruning=True,
+      arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF,
+      dependency_optimization=rewriter_config_pb2.RewriterConfig.OFF,
+      function_optimization=rewriter_config_pb2.RewriterConfig.OFF)
+  graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
+  return config_pb2.ConfigProto(graph_options=graph_options)
+
+
+class ShapeBucketingTest(test.TestCase):
+
+  def testOutputsMatchUnpaddedBatches(self):
+
+    @function.Defun(compiled=True)
+    def CompiledFunction(x):
+      return (math_ops.tanh(x) * 2., math_ops.reduce_sum(x, axis=0),
+              math_ops.reduce_mean(x, axis=0), math_ops.reduce_max(x, axis=0))
+
+    with ops.device("device:CPU:0"):
+      with session_lib.Session(config=NoRewriteSessionConfig()) as sess:
+        x = array_ops.placeholder(dtypes.float32, shape=[None, 3])
+        y = CompiledFunction(x)
+
+        # Batches of 3 and 4 share the executable of the bucket of 4, the one
+        # of 6 is padded to 8, and the one of 9 is compiled for its shape.
+        for batch_size in [3, 4, 6, 9, 3]:
+          inputs = np.random.uniform(
+              -1., 1., size=(batch_size, 3)).astype(np.float32)
+          doubled, total, mean, maximum = sess.run(y, {x: inputs})
+          self.assertAllClose(np.tanh(inputs) * 2., doubled)
+          self.assertAllClose(np.sum(inputs, axis=0), total)
+          self.assertAllClose(np.mean(inputs, axis=0), mean)
+          self.assertAllClose(np.max(inputs, axis=0), maximum)
+
+  def testFallsBackToExactShapes(self):
+
+    @function.Defun(compiled=True)
+    def CompiledFunction(x):
+      # The flattened batch cannot be sliced back to the batch size.
+      return array_ops.reshape(x, [-1]) + 1.
+
+    with ops.device("device:CPU:0"):
+      with session_lib.Session(config=NoRewriteSessionConfig()) as sess:
+        x = array_ops.placeholder(dtypes.float32, shape=[None, 3])
+        y = CompiledFunction(x)
+
+        for batch_size in [3, 5]:
+          inputs = np.arange(batch_size * 3, dtype=np.float32).reshape(
+              (batch_size, 3))
+          self.assertAllClose(
+              inputs.reshape([-1]) + 1., sess.run(y, {x: inputs}))
+
+
+if __name__ == "__main__":
+  os.environ["TF_XLA_FLAGS"] = ("--tf_xla_batch_size_buckets=4,8 " +
+                                os.environ.get("TF_XLA_FLAGS", ""))
+  test.main()
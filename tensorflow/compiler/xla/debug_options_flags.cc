@@ -534,6 +534,21 @@ static void AllocateFlags() {
                        flag_values->xla_gpu_algorithm_blacklist_path(),
                        "An AlgorithmBlacklist text proto file as a blacklist "
                        "of convolutions to avoid to use."),
+      tensorflow::Flag(
+          "xla_cpu_persistent_cache_dir",
+          string_setter_for(&DebugOptions::set_xla_cpu_persistent_cache_dir),
+          flag_values->xla_cpu_persistent_cache_dir(),
+          "If non-empty, the CPU backend stores compiled object code in this "
+          "directory and reuses it for identical LLVM modules, including "
+          "across processes."),
+      tensorflow::Flag(
+          "xla_cpu_enable_concurrent_regions",
+          bool_setter_for(
+              &DebugOptions::set_xla_cpu_enable_concurrent_regions),
+          flag_values->xla_cpu_enable_concurrent_regions(),
+          "Run independent instructions of the entry computation concurrently "
+          "on the intra-op thread pool in the CPU backend, at the expense of "
+          "some memory."),
   });
   ParseFlagsFromEnvAndDieIfUnknown("XLA_FLAGS", *flag_objects);
 }
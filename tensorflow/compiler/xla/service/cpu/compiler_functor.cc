@@ -23,6 +23,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
@@ -80,8 +81,47 @@ class FilteredPassManager : public llvm::legacy::PassManager {
 };
 }  // anonymous namespace
 
+string CompilerFunctor::CompileOptionsString() const {
+  const auto& opts = target_machine_->Options;
+  return absl::StrCat("opt_level=", opt_level_,
+                      ",optimize_for_size=", optimize_for_size_,
+                      ",disable_expensive_passes=", disable_expensive_passes_,
+                      ",unsafe_fp_math=", opts.UnsafeFPMath,
+                      ",no_infs_fp_math=", opts.NoInfsFPMath,
+                      ",no_nans_fp_math=", opts.NoNaNsFPMath,
+                      ",no_signed_zeros_fp_math=", opts.NoSignedZerosFPMath,
+                      ",no_trapping_fp_math=", opts.NoTrappingFPMath);
+}
+
+void CompilerFunctor::RunPostCodegenHook(
+    const llvm::MemoryBuffer& memory_buffer) const {
+  if (!post_codegen_hook_) {
+    return;
+  }
+  llvm::Expected<std::unique_ptr<llvm::object::ObjectFile>> obj_file =
+      llvm::object::ObjectFile::createObjectFile(memory_buffer);
+  if (obj_file) {
+    post_codegen_hook_(*obj_file.get());
+  } else {
+    LOG(WARNING) << "Could convert memory buffer to object file!";
+  }
+}
+
 std::unique_ptr<llvm::MemoryBuffer> CompilerFunctor::operator()(
     llvm::Module& module) const {
+  // The key is computed before the module is optimized in place.
+  string cache_key;
+  if (object_cache_) {
+    cache_key = PersistentObjectCache::Key(module, *target_machine_,
+                                           CompileOptionsString());
+    std::unique_ptr<llvm::MemoryBuffer> cached_object =
+        object_cache_->Lookup(cache_key);
+    if (cached_object) {
+      RunPostCodegenHook(*cached_object);
+      return cached_object;
+    }
+  }
+
   FilteredPassManager module_passes(disable_expensive_passes_);
   llvm::legacy::FunctionPassManager function_passes(&module);
 
@@ -148,13 +188,14 @@ std::unique_ptr<llvm::MemoryBuffer> CompilerFunctor::operator()(
   std::unique_ptr<llvm::MemoryBuffer> memory_buffer(
       new llvm::SmallVectorMemoryBuffer(std::move(stream_buffer)));
 
-  if (post_codegen_hook_) {
-    llvm::Expected<std::unique_ptr<llvm::object::ObjectFile>> obj_file =
-        llvm::object::ObjectFile::createObjectFile(*memory_buffer);
-    if (obj_file) {
-      post_codegen_hook_(*obj_file.get());
-    } else {
-      LOG(WARNING) << "Could convert memory buffer to object file!";
+  RunPostCodegenHook(*memory_buffer);
+
+  if (object_cache_) {
+    Status status =
+        object_cache_->Insert(cache_key, memory_buffer->getMemBufferRef());
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to store the compiled object in "
+                   << object_cache_->directory() << ": " << status;
     }
   }
 
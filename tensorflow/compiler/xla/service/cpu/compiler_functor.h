@@ -20,6 +20,7 @@ limitations under the License.
 #include "llvm/IR/Module.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Target/TargetMachine.h"
+#include "tensorflow/compiler/xla/service/cpu/persistent_object_cache.h"
 #include "tensorflow/compiler/xla/service/llvm_compiler.h"
 #include "tensorflow/core/platform/logging.h"
 
@@ -28,6 +29,9 @@ namespace cpu {
 
 // Functor class for compiling an LLVM module down to an object file. For use by
 // Orc JIT compile layer.
+//
+// If `object_cache` is not null, objects compiled for identical modules are
+// reused, in which case the IR hooks are not invoked.
 class CompilerFunctor {
  public:
   explicit CompilerFunctor(
@@ -36,14 +40,16 @@ class CompilerFunctor {
       LLVMCompiler::ModuleHook pre_optimization_hook = nullptr,
       LLVMCompiler::ModuleHook post_optimization_hook = nullptr,
       std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook =
-          nullptr)
+          nullptr,
+      std::shared_ptr<const PersistentObjectCache> object_cache = nullptr)
       : target_machine_(target_machine),
         opt_level_(opt_level),
         optimize_for_size_(optimize_for_size),
         disable_expensive_passes_(disable_expensive_passes),
         pre_optimization_hook_(std::move(pre_optimization_hook)),
         post_optimization_hook_(std::move(post_optimization_hook)),
-        post_codegen_hook_(std::move(post_codegen_hook)) {}
+        post_codegen_hook_(std::move(post_codegen_hook)),
+        object_cache_(std::move(object_cache)) {}
 
   // Compile a Module to an ObjectFile.
   std::unique_ptr<llvm::MemoryBuffer> operator()(
@@ -59,6 +65,13 @@ class CompilerFunctor {
                              llvm::legacy::FunctionPassManager* function_passes,
                              unsigned opt_level, unsigned size_level) const;
 
+  // Returns the options that, with the module and the target machine, decide
+  // the compiled object.
+  string CompileOptionsString() const;
+
+  // Invokes `post_codegen_hook_` on the object in `memory_buffer`.
+  void RunPostCodegenHook(const llvm::MemoryBuffer& memory_buffer) const;
+
   llvm::TargetMachine* target_machine_;
   const unsigned opt_level_;
   const bool optimize_for_size_;
@@ -66,6 +79,7 @@ class CompilerFunctor {
   LLVMCompiler::ModuleHook pre_optimization_hook_;
   LLVMCompiler::ModuleHook post_optimization_hook_;
   std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook_;
+  std::shared_ptr<const PersistentObjectCache> object_cache_;
 };
 
 }  // namespace cpu
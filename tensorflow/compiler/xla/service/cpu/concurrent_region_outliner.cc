@@ -0,0 +1,166 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/concurrent_region_outliner.h"
+
+#include <set>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_dce.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using RegionMap = absl::flat_hash_map<const HloInstruction*, int64>;
+
+// Returns true if 'instruction' emits no code that must run in the entry
+// computation, because its buffer is known statically.
+bool StaysInEntryComputation(const HloInstruction& instruction) {
+  switch (instruction.opcode()) {
+    case HloOpcode::kParameter:
+    case HloOpcode::kConstant:
+    case HloOpcode::kGetTupleElement:
+    case HloOpcode::kBitcast:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Adds to 'predecessors' the regions in 'region_of' whose results
+// 'instruction' uses, directly or through instructions that stay in the entry
+// computation.
+void AddPredecessors(const HloInstruction& instruction,
+                     const RegionMap& region_of,
+                     std::set<int64>* predecessors) {
+  for (const HloInstruction* operand : instruction.operands()) {
+    auto it = region_of.find(operand);
+    if (it != region_of.end()) {
+      predecessors->insert(it->second);
+    } else if (StaysInEntryComputation(*operand)) {
+      AddPredecessors(*operand, region_of, predecessors);
+    }
+  }
+}
+
+// Returns the operand of 'instruction' whose region 'instruction' can join,
+// i.e. its only operand that is neither a parameter nor a constant, if
+// 'instruction' is the only user of that operand, or nullptr otherwise.
+const HloInstruction* ChainedOperand(const HloInstruction& instruction,
+                                     const RegionMap& region_of) {
+  const HloInstruction* chained_operand = nullptr;
+  for (const HloInstruction* operand : instruction.operands()) {
+    if (operand->opcode() == HloOpcode::kParameter ||
+        operand->opcode() == HloOpcode::kConstant) {
+      continue;
+    }
+    if (chained_operand != nullptr && chained_operand != operand) {
+      return nullptr;
+    }
+    chained_operand = operand;
+  }
+  // The root of the entry computation must stay the output of its region.
+  if (chained_operand == nullptr || !region_of.contains(chained_operand) ||
+      chained_operand->user_count() != 1 ||
+      chained_operand == chained_operand->parent()->root_instruction()) {
+    return nullptr;
+  }
+  return chained_operand;
+}
+
+}  // namespace
+
+StatusOr<bool> ConcurrentRegionOutliner::Run(HloModule* module) {
+  regions_.clear();
+  HloComputation* entry = module->entry_computation();
+  const std::vector<HloInstruction*> post_order =
+      entry->MakeInstructionPostOrder();
+  for (const HloInstruction* instruction : post_order) {
+    if (instruction->HasSideEffect() ||
+        !instruction->control_predecessors().empty()) {
+      VLOG(2) << "Not splitting " << entry->name()
+              << " into concurrent regions because of "
+              << instruction->ToString();
+      return false;
+    }
+  }
+
+  // Group the instructions into regions in post order, so that the regions
+  // are in a topological order too.
+  std::vector<std::vector<HloInstruction*>> region_instructions;
+  RegionMap region_of;
+  for (HloInstruction* instruction : post_order) {
+    if (StaysInEntryComputation(*instruction)) {
+      continue;
+    }
+    if (const HloInstruction* operand =
+            ChainedOperand(*instruction, region_of)) {
+      const int64 region = region_of.at(operand);
+      region_instructions[region].push_back(instruction);
+      region_of[instruction] = region;
+    } else {
+      region_of[instruction] = region_instructions.size();
+      region_instructions.push_back({instruction});
+    }
+  }
+
+  std::vector<std::set<int64>> predecessors(region_instructions.size());
+  for (int64 region = 0; region < region_instructions.size(); ++region) {
+    for (const HloInstruction* instruction : region_instructions[region]) {
+      AddPredecessors(*instruction, region_of, &predecessors[region]);
+    }
+    predecessors[region].erase(region);
+  }
+
+  // The regions cannot run concurrently if each of them uses the result of the
+  // previous one.
+  bool has_independent_regions = false;
+  for (int64 region = 1; region < region_instructions.size(); ++region) {
+    if (predecessors[region].count(region - 1) == 0) {
+      has_independent_regions = true;
+      break;
+    }
+  }
+  if (!has_independent_regions) {
+    VLOG(2) << "No independent regions in " << entry->name();
+    return false;
+  }
+
+  for (int64 region = 0; region < region_instructions.size(); ++region) {
+    const std::vector<HloInstruction*>& instructions =
+        region_instructions[region];
+    HloInstruction* call = module->OutlineExpressionFromComputation(
+        instructions, absl::StrCat("region_", instructions.back()->name()),
+        entry);
+    regions_.push_back(
+        {call, std::vector<int64>(predecessors[region].begin(),
+                                  predecessors[region].end())});
+  }
+  VLOG(2) << "Split " << entry->name() << " into " << regions_.size()
+          << " concurrent regions";
+
+  // Remove the fused computations of the outlined fusion instructions, which
+  // the regions cloned.
+  TF_RETURN_IF_ERROR(HloDCE().Run(module).status());
+  return true;
+}
+
+}  // namespace cpu
+}  // namespace xla
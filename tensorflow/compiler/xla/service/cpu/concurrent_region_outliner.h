@@ -0,0 +1,70 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CONCURRENT_REGION_OUTLINER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CONCURRENT_REGION_OUTLINER_H_
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace cpu {
+
+// ConcurrentRegionOutliner splits the entry computation into regions that
+// CpuExecutable can run concurrently.  Every instruction of the entry
+// computation that emits code is outlined into a region, together with the
+// chain of instructions that only it feeds, and each region is invoked from a
+// kCall instruction of the entry computation.  Parameters, constants,
+// get-tuple-elements and bitcasts stay in the entry computation: their buffers
+// are known statically, so they need no code to run between regions.
+//
+// The entry computation is left unchanged if its instructions cannot run
+// out of order, i.e. if some have side effects or control dependencies, or if
+// no two regions would be independent of each other.
+//
+// The pass must run after copy insertion, as the last pass before scheduling.
+class ConcurrentRegionOutliner : public HloModulePass {
+ public:
+  // A region outlined from the entry computation.
+  struct Region {
+    // The kCall instruction of the entry computation that runs the region.
+    HloInstruction* call;
+
+    // The indices in regions() of the regions whose results the region uses,
+    // which are all smaller than its own index.
+    std::vector<int64> predecessors;
+  };
+
+  absl::string_view name() const override {
+    return "cpu-concurrent-region-outliner";
+  }
+
+  // Returns true if the entry computation was split into regions.
+  StatusOr<bool> Run(HloModule* module) override;
+
+  // The regions the last call to Run outlined, in a topological order.
+  const std::vector<Region>& regions() const { return regions_; }
+
+ private:
+  std::vector<Region> regions_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CONCURRENT_REGION_OUTLINER_H_
@@ -0,0 +1,179 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/concurrent_region_outliner.h"
+
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+using ConcurrentRegionOutlinerTest = HloTestBase;
+
+TEST_F(ConcurrentRegionOutlinerTest, IndependentTowersAreSplit) {
+  const string hlo_string = R"(
+    HloModule IndependentTowers
+    ENTRY IndependentTowers {
+      p0 = f32[64] parameter(0)
+      p1 = f32[64] parameter(1)
+      exp0 = f32[64] exponential(p0)
+      tanh0 = f32[64] tanh(exp0)
+      exp1 = f32[64] exponential(p1)
+      tanh1 = f32[64] tanh(exp1)
+      ROOT tuple = (f32[64], f32[64]) tuple(tanh0, tanh1)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  ConcurrentRegionOutliner outliner;
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, outliner.Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  // Each tower is a chain outlined into a single region, which the tuple
+  // waits for.
+  const std::vector<ConcurrentRegionOutliner::Region>& regions =
+      outliner.regions();
+  ASSERT_EQ(regions.size(), 3);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(regions[i].call, op::Call(op::Parameter()));
+    EXPECT_THAT(regions[i].call->to_apply()->root_instruction(),
+                op::Tanh(op::Exp(op::Parameter(0))));
+    EXPECT_TRUE(regions[i].predecessors.empty());
+  }
+  EXPECT_EQ(module->entry_computation()->root_instruction(), regions[2].call);
+  EXPECT_THAT(regions[2].call, op::Call(regions[0].call, regions[1].call));
+  EXPECT_EQ(regions[2].predecessors, std::vector<int64>({0, 1}));
+}
+
+TEST_F(ConcurrentRegionOutlinerTest, PredecessorsThroughGetTupleElement) {
+  const string hlo_string = R"(
+    HloModule PredecessorsThroughGetTupleElement
+    ENTRY PredecessorsThroughGetTupleElement {
+      p0 = f32[64] parameter(0)
+      p1 = f32[64] parameter(1)
+      exp0 = f32[64] exponential(p0)
+      exp1 = f32[64] exponential(p1)
+      pair = (f32[64], f32[64]) tuple(exp0, exp1)
+      gte0 = f32[64] get-tuple-element(pair), index=0
+      gte1 = f32[64] get-tuple-element(pair), index=1
+      ROOT add = f32[64] add(gte0, gte1)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  ConcurrentRegionOutliner outliner;
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, outliner.Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  const std::vector<ConcurrentRegionOutliner::Region>& regions =
+      outliner.regions();
+  ASSERT_EQ(regions.size(), 4);
+  EXPECT_EQ(regions[2].predecessors, std::vector<int64>({0, 1}));
+  // The get-tuple-elements stay in the entry computation.
+  EXPECT_THAT(regions[3].call,
+              op::Call(op::GetTupleElement(regions[2].call),
+                       op::GetTupleElement(regions[2].call)));
+  EXPECT_EQ(regions[3].predecessors, std::vector<int64>({2}));
+}
+
+TEST_F(ConcurrentRegionOutlinerTest, ChainIsNotSplit) {
+  const string hlo_string = R"(
+    HloModule Chain
+    ENTRY Chain {
+      p0 = f32[64] parameter(0)
+      exp = f32[64] exponential(p0)
+      tanh = f32[64] tanh(exp)
+      ROOT add = f32[64] add(exp, tanh)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  ConcurrentRegionOutliner outliner;
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, outliner.Run(module.get()));
+  EXPECT_FALSE(changed);
+  EXPECT_TRUE(outliner.regions().empty());
+}
+
+TEST_F(ConcurrentRegionOutlinerTest, SideEffectsAreNotSplit) {
+  const string hlo_string = R"(
+    HloModule SideEffects
+    ENTRY SideEffects {
+      p0 = f32[64] parameter(0)
+      zero = f32[] constant(0)
+      one = f32[] constant(1)
+      rng = f32[64] rng(zero, one), distribution=rng_uniform
+      exp = f32[64] exponential(p0)
+      ROOT tuple = (f32[64], f32[64]) tuple(rng, exp)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  ConcurrentRegionOutliner outliner;
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, outliner.Run(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+class ConcurrentRegionsExecutionTest : public HloTestBase {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_enable_concurrent_regions(true);
+    return debug_options;
+  }
+};
+
+TEST_F(ConcurrentRegionsExecutionTest, ParallelTowers) {
+  const string hlo_string = R"(
+    HloModule ParallelTowers
+
+    add {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT add = f32[] add(lhs, rhs)
+    }
+
+    ENTRY ParallelTowers {
+      x = f32[32,64] parameter(0)
+      w0 = f32[64,64] parameter(1)
+      w1 = f32[64,64] parameter(2)
+      dot0 = f32[32,64] dot(x, w0), lhs_contracting_dims={1},
+        rhs_contracting_dims={0}
+      tanh0 = f32[32,64] tanh(dot0)
+      dot1 = f32[32,64] dot(x, w1), lhs_contracting_dims={1},
+        rhs_contracting_dims={0}
+      tanh1 = f32[32,64] tanh(dot1)
+      sum = f32[32,64] add(tanh0, tanh1)
+      zero = f32[] constant(0)
+      reduce = f32[32] reduce(sum, zero), dimensions={1}, to_apply=add
+      ROOT tuple = (f32[32,64], f32[32]) tuple(sum, reduce)
+    }
+  )";
+
+  EXPECT_TRUE(RunAndCompare(hlo_string, ErrorSpec{1e-4, 1e-4}));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
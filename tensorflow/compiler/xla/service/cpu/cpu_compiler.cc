@@ -27,6 +27,7 @@ limitations under the License.
 
 // IWYU pragma: no_include "llvm/Config/Disassemblers.def.inc"
 // IWYU pragma: no_include "llvm/Config/Targets.def.inc"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "llvm/ADT/StringRef.h"
@@ -58,6 +59,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/copy_insertion.h"
 #include "tensorflow/compiler/xla/service/cpu/buffer_info_util.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
+#include "tensorflow/compiler/xla/service/cpu/concurrent_region_outliner.h"
 #include "tensorflow/compiler/xla/service/cpu/conv_canonicalization.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_hlo_support_checker.h"
@@ -69,11 +71,13 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/persistent_object_cache.h"
 #include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
 #include "tensorflow/compiler/xla/service/dfs_hlo_visitor_with_default.h"
 #include "tensorflow/compiler/xla/service/dot_decomposer.h"
 #include "tensorflow/compiler/xla/service/dump.h"
 #include "tensorflow/compiler/xla/service/dynamic_index_splitter.h"
+#include "tensorflow/compiler/xla/service/dynamic_padder.h"
 #include "tensorflow/compiler/xla/service/flatten_call_graph.h"
 #include "tensorflow/compiler/xla/service/hlo.pb.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
@@ -115,6 +119,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace xla {
 namespace cpu {
@@ -280,6 +285,9 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // TODO(b/65775800): Fix wrong output bug in Call and remove the CallInliner
   // pass.
   pipeline.AddPass<CallInliner>();
+  // Masks the padding of dynamic dimensions out of the ops that mix elements
+  // along them, e.g. for clusters compiled for a bucket of batch sizes.
+  pipeline.AddPass<DynamicPadder>();
   pipeline.AddPass<BatchDotSimplification>();
   pipeline.AddPass<DotDecomposer>();
   // After canonicalization, there may be more batch dots that can be
@@ -626,16 +634,36 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   auto llvm_module =
       absl::make_unique<llvm::Module>("__compute_module", *llvm_context);
 
+  std::shared_ptr<const PersistentObjectCache> object_cache;
+  const string& cache_dir =
+      module->config().debug_options().xla_cpu_persistent_cache_dir();
+  if (!cache_dir.empty()) {
+    object_cache = std::make_shared<PersistentObjectCache>(
+        tensorflow::Env::Default(), cache_dir);
+  }
+
   auto jit = absl::make_unique<SimpleOrcJIT>(
       CompilerTargetOptions(module->config()),
       CodeGenOptLevel(module->config()),
       options::OptimizeForSizeRequested(module->config()),
       module->config().debug_options().xla_llvm_disable_expensive_passes(),
       pre_optimization_ir_hook, post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      OrcJITPostCompilationHook::Create(module.get()),
+      std::move(object_cache));
   llvm_module->setDataLayout(jit->data_layout());
   llvm_module->setTargetTriple(jit->target_triple().getTriple());
 
+  // Split the entry computation into regions that CpuExecutable runs
+  // concurrently, if requested.  The HLO profile attributes cycles to the
+  // instructions of a single thread, so it is not supported with regions.
+  ConcurrentRegionOutliner region_outliner;
+  bool has_concurrent_regions = false;
+  if (module->config().debug_options().xla_cpu_enable_concurrent_regions() &&
+      !module->config().hlo_profiling_enabled()) {
+    TF_ASSIGN_OR_RETURN(has_concurrent_regions,
+                        region_outliner.Run(module.get()));
+  }
+
   HloComputation* entry_computation = module->entry_computation();
   std::unordered_map<const HloInstruction*, int64> instruction_to_profile_idx;
   std::unordered_map<const HloComputation*, int64> computation_to_profile_idx;
@@ -662,11 +690,18 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
                                      ComputationSchedulerToModuleScheduler(
                                          DFSMemoryScheduler)));
 
-  // Run buffer allocation on the HLO graph.
+  // Run buffer allocation on the HLO graph.  Regions that may run concurrently
+  // must not share buffers, so with concurrent regions only the instructions
+  // ordered by their dependencies share buffers.
+  std::unique_ptr<HloOrdering> hlo_ordering;
+  if (has_concurrent_regions) {
+    hlo_ordering = absl::make_unique<DependencyHloOrdering>(module.get());
+  } else {
+    hlo_ordering = absl::make_unique<SequentialHloOrdering>(schedule);
+  }
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<BufferAssignment> assignment,
-      BufferAssigner::Run(module.get(),
-                          absl::make_unique<SequentialHloOrdering>(schedule),
+      BufferAssigner::Run(module.get(), std::move(hlo_ordering),
                           BufferSizeBytesFunction(), memory_alignment,
                           /*allocate_buffers_for_constants=*/true));
   DumpHloModuleIfEnabled(*module, *assignment, "after_optimizations");
@@ -690,18 +725,45 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   TF_RETURN_IF_ERROR(ir_emitter.EmitConstantGlobals());
 
+  auto mangled_name = [&](const llvm::Function* function) {
+    llvm::SmallVector<char, 40> function_name_vector;
+    llvm::Mangler::getNameWithPrefix(function_name_vector, function->getName(),
+                                     jit->data_layout());
+    return string(function_name_vector.begin(), function_name_vector.end());
+  };
+
+  // The computations of the concurrent regions are emitted as functions that
+  // CpuExecutable calls directly, indexed like the regions.
+  absl::flat_hash_map<const HloComputation*, int64> region_computations;
+  for (int64 i = 0; i < region_outliner.regions().size(); ++i) {
+    region_computations[region_outliner.regions()[i].call->to_apply()] = i;
+  }
+  std::vector<CpuExecutable::ConcurrentRegion> concurrent_regions(
+      region_computations.size());
+
   for (auto embedded_computation :
        entry_computation->MakeEmbeddedComputationsList()) {
     if (embedded_computation->IsFusionComputation()) {
       continue;
     }
-    TF_RETURN_IF_ERROR(
-        ir_emitter
-            .EmitComputation(
-                embedded_computation, embedded_computation->name(),
-                /*is_top_level_computation=*/false,
-                schedule.sequence(embedded_computation).instructions())
-            .status());
+    auto region_it = region_computations.find(embedded_computation);
+    const bool is_region = region_it != region_computations.end();
+    TF_ASSIGN_OR_RETURN(
+        llvm::Function * function,
+        ir_emitter.EmitComputation(
+            embedded_computation, embedded_computation->name(),
+            /*is_top_level_computation=*/is_region,
+            schedule.sequence(embedded_computation).instructions()));
+    if (is_region) {
+      // Keep the entry function, which runs the regions in sequence when no
+      // thread pool is available, from inlining a copy of each of them.
+      function->addFnAttr(llvm::Attribute::NoInline);
+      CpuExecutable::ConcurrentRegion& region =
+          concurrent_regions[region_it->second];
+      region.function_name = mangled_name(function);
+      region.predecessors =
+          region_outliner.regions()[region_it->second].predecessors;
+    }
   }
   string function_name_prefix = entry_computation->name().empty()
                                     ? "__compute"
@@ -712,12 +774,7 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
                           /*is_top_level_computation=*/true,
                           schedule.sequence(entry_computation).instructions()));
 
-  string function_name = [&]() {
-    llvm::SmallVector<char, 40> function_name_vector;
-    llvm::Mangler::getNameWithPrefix(
-        function_name_vector, entry_function->getName(), jit->data_layout());
-    return string(function_name_vector.begin(), function_name_vector.end());
-  }();
+  string function_name = mangled_name(entry_function);
 
   string ir_module_string;
   if (embed_ir_in_executable) {
@@ -730,7 +787,8 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   jit->AddModule(std::move(llvm_module));
   cpu_executable.reset(new CpuExecutable(
       std::move(jit), std::move(assignment), std::move(module), function_name,
-      std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map)));
+      std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map),
+      std::move(concurrent_regions)));
 
   if (embed_ir_in_executable) {
     static_cast<CpuExecutable&>(*cpu_executable)
@@ -15,18 +15,23 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
 
+#define EIGEN_USE_THREADS
+
 #include <stdint.h>
 
 #include <algorithm>
+#include <deque>
 #include <set>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/computation_layout.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
@@ -48,13 +53,86 @@ limitations under the License.
 
 namespace xla {
 namespace cpu {
+namespace {
+
+// The state of one run of the concurrent regions, shared with the tasks that
+// run regions on the thread pool.
+struct ConcurrentRegionsState {
+  tensorflow::mutex mu;
+  tensorflow::condition_variable region_done;
+
+  // The regions whose predecessors are done, but which have not started.
+  std::deque<int64> ready GUARDED_BY(mu);
+
+  // The number of predecessors of each region that are not done.
+  std::vector<int64> pending_predecessors GUARDED_BY(mu);
+
+  // The number of regions that are done.
+  int64 num_done GUARDED_BY(mu) = 0;
+};
+
+// The number of threads of each thread pool that run concurrent regions, over
+// all the executions that share the pool.
+class RegionThreadCounts {
+ public:
+  static RegionThreadCounts* Get() {
+    static RegionThreadCounts* counts = new RegionThreadCounts();
+    return counts;
+  }
+
+  // Reserves a thread of 'pool' for a region and returns true, unless
+  // 'max_threads' of its threads already run regions.
+  bool TryAcquire(const void* pool, int64 max_threads) {
+    tensorflow::mutex_lock lock(mu_);
+    int64& count = counts_[pool];
+    if (count >= max_threads) {
+      if (count == 0) {
+        counts_.erase(pool);
+      }
+      return false;
+    }
+    ++count;
+    return true;
+  }
+
+  void Release(const void* pool) {
+    tensorflow::mutex_lock lock(mu_);
+    auto it = counts_.find(pool);
+    CHECK(it != counts_.end());
+    // Forget the pool once it is idle, since its address may be reused.
+    if (--it->second == 0) {
+      counts_.erase(it);
+    }
+  }
+
+ private:
+  tensorflow::mutex mu_;
+  absl::flat_hash_map<const void*, int64> counts_ GUARDED_BY(mu_);
+};
+
+// Marks 'region' as done and makes its successors ready if it was the last of
+// their predecessors.
+void FinishRegion(int64 region, absl::Span<const int64> successors,
+                  ConcurrentRegionsState* state)
+    EXCLUSIVE_LOCKS_REQUIRED(state->mu) {
+  ++state->num_done;
+  for (int64 successor : successors) {
+    if (--state->pending_predecessors[successor] == 0) {
+      state->ready.push_back(successor);
+    }
+  }
+  state->region_done.notify_all();
+}
+
+}  // namespace
 
 CpuExecutable::CpuExecutable(
     std::unique_ptr<SimpleOrcJIT> jit,
     std::unique_ptr<const BufferAssignment> assignment,
     std::unique_ptr<HloModule> hlo_module, const string& entry_function_name,
     std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data,
-    std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map)
+    std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map,
+    std::vector<ConcurrentRegion> concurrent_regions)
     : Executable(std::move(hlo_module), std::move(hlo_profile_printer_data),
                  std::move(hlo_profile_index_map)),
       jit_(std::move(jit)),
@@ -71,6 +149,22 @@ CpuExecutable::CpuExecutable(
       reinterpret_cast<ComputeFunctionType>(cantFail(sym.getAddress()));
   VLOG(1) << "compute_function_ at address "
           << reinterpret_cast<void*>(compute_function_);
+
+  region_successors_.resize(concurrent_regions.size());
+  for (int64 i = 0; i < concurrent_regions.size(); ++i) {
+    const ConcurrentRegion& region = concurrent_regions[i];
+    llvm::JITSymbol region_sym = jit_->FindCompiledSymbol(region.function_name);
+    CHECK(region_sym) << "Symbol " << region.function_name << " not found.";
+    region_functions_.push_back(reinterpret_cast<ComputeFunctionType>(
+        cantFail(region_sym.getAddress())));
+    region_num_predecessors_.push_back(region.predecessors.size());
+    for (int64 predecessor : region.predecessors) {
+      CHECK_LT(predecessor, i);
+      region_successors_[predecessor].push_back(i);
+    }
+  }
+  VLOG(1) << "Entry computation split into " << region_functions_.size()
+          << " concurrent regions";
 }
 
 StatusOr<std::pair<std::vector<se::DeviceMemoryBase>,
@@ -189,8 +283,15 @@ Status CpuExecutable::ExecuteComputeFunction(
     VLOG(3) << absl::StrFormat("    profile_counters = %p", profile_counters);
   }
 
-  compute_function_(result_buffer, run_options, nullptr, buffer_pointers.data(),
-                    profile_counters);
+  const Eigen::ThreadPoolDevice* thread_pool =
+      run_options->intra_op_thread_pool();
+  if (!region_functions_.empty() && thread_pool != nullptr) {
+    ExecuteConcurrentRegions(thread_pool, run_options, buffer_pointers.data(),
+                             profile_counters);
+  } else {
+    compute_function_(result_buffer, run_options, nullptr,
+                      buffer_pointers.data(), profile_counters);
+  }
 
   uint64 end_micros = tensorflow::Env::Default()->NowMicros();
 
@@ -209,6 +310,73 @@ Status CpuExecutable::ExecuteComputeFunction(
   return Status::OK();
 }
 
+void CpuExecutable::ExecuteConcurrentRegions(
+    const Eigen::ThreadPoolDevice* thread_pool,
+    const ExecutableRunOptions* run_options, void** buffer_table,
+    int64* profile_counters) {
+  // The regions run with the calling convention of the entry function.  They
+  // write their results to the buffer table rather than to the result
+  // argument, like the computations invoked by a kCall.
+  auto run_region = [this, run_options, buffer_table,
+                     profile_counters](int64 region) {
+    region_functions_[region](nullptr, run_options, nullptr, buffer_table,
+                              profile_counters);
+  };
+
+  auto state = std::make_shared<ConcurrentRegionsState>();
+  const int64 num_regions = region_functions_.size();
+  // Regions may block on the Eigen tasks of their own instructions, which run
+  // on the same thread pool, so leave one of its threads to those tasks. The
+  // pool may be shared with other executions, so the threads running regions
+  // are counted per pool rather than per execution.
+  const void* pool = thread_pool->getPool();
+  const int64 max_on_thread_pool = std::max(0, thread_pool->numThreads() - 1);
+  RegionThreadCounts* region_thread_counts = RegionThreadCounts::Get();
+  {
+    tensorflow::mutex_lock lock(state->mu);
+    state->pending_predecessors = region_num_predecessors_;
+    for (int64 region = 0; region < num_regions; ++region) {
+      if (region_num_predecessors_[region] == 0) {
+        state->ready.push_back(region);
+      }
+    }
+  }
+
+  // This thread hands all but one of the ready regions to the thread pool
+  // while it has threads to spare, and runs the remaining ones itself.
+  while (true) {
+    int64 region;
+    {
+      tensorflow::mutex_lock lock(state->mu);
+      while (state->ready.empty() && state->num_done < num_regions) {
+        state->region_done.wait(lock);
+      }
+      if (state->num_done == num_regions) {
+        break;
+      }
+      while (state->ready.size() > 1 &&
+             region_thread_counts->TryAcquire(pool, max_on_thread_pool)) {
+        const int64 pool_region = state->ready.back();
+        state->ready.pop_back();
+        thread_pool->enqueueNoNotification(
+            [this, state, run_region, pool_region, pool,
+             region_thread_counts]() {
+              run_region(pool_region);
+              region_thread_counts->Release(pool);
+              tensorflow::mutex_lock lock(state->mu);
+              FinishRegion(pool_region, region_successors_[pool_region],
+                           state.get());
+            });
+      }
+      region = state->ready.front();
+      state->ready.pop_front();
+    }
+    run_region(region);
+    tensorflow::mutex_lock lock(state->mu);
+    FinishRegion(region, region_successors_[region], state.get());
+  }
+}
+
 StatusOr<ScopedShapedBuffer> CpuExecutable::CreateResultShapedBuffer(
     const ServiceExecutableRunOptions* run_options,
     absl::Span<se::OwningDeviceMemory> buffers) {
@@ -47,12 +47,27 @@ namespace cpu {
 // architecture, so JIT-ed code and host code share the same ABI.
 class CpuExecutable : public Executable {
  public:
+  // A region of the entry computation, outlined by ConcurrentRegionOutliner,
+  // that can run concurrently with the regions it does not depend on.
+  struct ConcurrentRegion {
+    // The name of the function that runs the region, which has the same
+    // signature as the entry function.
+    string function_name;
+
+    // The indices of the regions that must complete before the region starts,
+    // which are all smaller than its own index.
+    std::vector<int64> predecessors;
+  };
+
+  // If 'concurrent_regions' is not empty, they are run instead of the entry
+  // function whenever the run options provide an intra-op thread pool.
   CpuExecutable(std::unique_ptr<SimpleOrcJIT> jit,
                 std::unique_ptr<const BufferAssignment> assignment,
                 std::unique_ptr<HloModule> hlo_module,
                 const string& entry_function_name,
                 std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data,
-                std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map);
+                std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map,
+                std::vector<ConcurrentRegion> concurrent_regions);
   ~CpuExecutable() override {}
 
   StatusOr<ScopedShapedBuffer> ExecuteAsyncOnStream(
@@ -108,6 +123,12 @@ class CpuExecutable : public Executable {
                                 absl::Span<const se::DeviceMemoryBase> buffers,
                                 HloExecutionProfile* hlo_execution_profile);
 
+  // Runs the concurrent regions on 'thread_pool', each once the regions it
+  // depends on are done, and returns once all of them are done.
+  void ExecuteConcurrentRegions(const Eigen::ThreadPoolDevice* thread_pool,
+                                const ExecutableRunOptions* run_options,
+                                void** buffer_table, int64* profile_counters);
+
   // Creates a ScopedShapedBuffer for holding the result of the computation,
   // moving buffers out of allocated_buffers and into the result as appropriate.
   // The addresses are set according to buffer assignment.
@@ -136,6 +157,12 @@ class CpuExecutable : public Executable {
   // Entry function name for the computation.
   const string entry_function_name_;
 
+  // The functions running the concurrent regions, the regions that depend on
+  // each of them, and the number of regions each of them depends on.
+  std::vector<ComputeFunctionType> region_functions_;
+  std::vector<std::vector<int64>> region_successors_;
+  std::vector<int64> region_num_predecessors_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(CpuExecutable);
 };
 
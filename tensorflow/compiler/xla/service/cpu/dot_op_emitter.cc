@@ -111,6 +111,7 @@ class DotOpEmitter {
                         const llvm_ir::IrArray& lhs_array,
                         const llvm_ir::IrArray& rhs_array,
                         const llvm_ir::IrArray* addend_array,
+                        const DynamicLoopBounds* dynamic_loop_bounds,
                         llvm::Value* executable_run_options_value,
                         llvm::IRBuilder<>* b,
                         const HloModuleConfig& hlo_module_config,
@@ -192,6 +193,9 @@ class DotOpEmitter {
   const llvm_ir::IrArray& lhs_array_;
   const llvm_ir::IrArray& rhs_array_;
   const llvm_ir::IrArray* addend_array_;
+  // The bounds of the rows of the result to compute, or nullptr to compute all
+  // of them.
+  const DynamicLoopBounds* dynamic_loop_bounds_;
   llvm::Value* executable_run_options_value_;
   llvm::IRBuilder<>* b_;
   const HloModuleConfig& hlo_module_config_;
@@ -204,6 +208,7 @@ DotOpEmitter::DotOpEmitter(DotInfo dot_info, string dot_hlo_name,
                            const llvm_ir::IrArray& lhs_array,
                            const llvm_ir::IrArray& rhs_array,
                            const llvm_ir::IrArray* addend_array,
+                           const DynamicLoopBounds* dynamic_loop_bounds,
                            llvm::Value* executable_run_options_value,
                            llvm::IRBuilder<>* b,
                            const HloModuleConfig& hlo_module_config,
@@ -214,6 +219,7 @@ DotOpEmitter::DotOpEmitter(DotInfo dot_info, string dot_hlo_name,
       lhs_array_(lhs_array),
       rhs_array_(rhs_array),
       addend_array_(addend_array),
+      dynamic_loop_bounds_(dynamic_loop_bounds),
       executable_run_options_value_(executable_run_options_value),
       b_(b),
       hlo_module_config_(hlo_module_config),
@@ -404,8 +410,13 @@ Status DotOpEmitter::Emit() {
     return EmitScalarDot();
   }
 
-  switch (GetDotImplementationStrategy(hlo_module_config_, dot_info_,
-                                       target_machine_features_)) {
+  DotImplementationStrategy strategy = GetDotImplementationStrategy(
+      hlo_module_config_, dot_info_, target_machine_features_);
+  // Only the naive loops and the calls to Eigen can compute a range of rows.
+  TF_RET_CHECK(dynamic_loop_bounds_ == nullptr ||
+               strategy == DotImplementationStrategy::kNaiveLlvmIr ||
+               strategy == DotImplementationStrategy::kEigen);
+  switch (strategy) {
     case DotImplementationStrategy::kNaiveLlvmIr:
       EmitNaiveLlvmIrGemm();
       return Status::OK();
@@ -449,9 +460,19 @@ void DotOpEmitter::EmitNaiveLlvmIrGemm() {
   // operand dimensions. The reduction dimension of the LHS and RHS are handled
   // in a separate innermost loop which performs the sum of products.
   llvm_ir::ForLoopNest loop_nest(llvm_ir::IrName(dot_hlo_name_), b_);
-  std::vector<llvm::Value*> lhs_multi_index =
-      loop_nest.EmitOperandArrayLoopNest(
-          lhs_array_, /*dimension_to_skip=*/lhs_reduction_dimension, "lhs");
+  std::vector<llvm::Value*> lhs_multi_index;
+  if (dynamic_loop_bounds_ != nullptr) {
+    // The rows of the result are the rows of the LHS, of which we only loop
+    // over the ones within the dynamic loop bounds.
+    CHECK_EQ(lhs_reduction_dimension, 1);
+    std::unique_ptr<llvm_ir::ForLoop> row_loop =
+        loop_nest.AddLoop("lhs.0", (*dynamic_loop_bounds_)[0].first,
+                          (*dynamic_loop_bounds_)[0].second);
+    lhs_multi_index = {row_loop->GetIndVarValue(), nullptr};
+  } else {
+    lhs_multi_index = loop_nest.EmitOperandArrayLoopNest(
+        lhs_array_, /*dimension_to_skip=*/lhs_reduction_dimension, "lhs");
+  }
   std::vector<llvm::Value*> rhs_multi_index =
       loop_nest.EmitOperandArrayLoopNest(
           rhs_array_, /*dimension_to_skip=*/rhs_reduction_dimension, "rhs");
@@ -678,26 +699,44 @@ Status DotOpEmitter::EmitCallToRuntime() {
 
   CHECK_EQ(mat_mult_dims.lhs_column_major, mat_mult_dims.rhs_column_major);
 
-  const llvm_ir::IrArray* lhs = &lhs_array_;
-  const llvm_ir::IrArray* rhs = &rhs_array_;
   bool transpose_lhs = !mat_mult_dims.lhs_canonical;
   bool transpose_rhs = !mat_mult_dims.rhs_canonical;
 
+  llvm::Value* target_ptr =
+      b_->CreateBitCast(target_array_.GetBasePointer(), float_ptr_type);
+  llvm::Value* lhs_ptr =
+      b_->CreateBitCast(lhs_array_.GetBasePointer(), float_ptr_type);
+  llvm::Value* rhs_ptr =
+      b_->CreateBitCast(rhs_array_.GetBasePointer(), float_ptr_type);
+  llvm::Value* m = b_->getInt64(mat_mult_dims.m);
+  if (dynamic_loop_bounds_ != nullptr) {
+    // Multiply the rows of the LHS within the dynamic loop bounds into the
+    // same rows of the result.  The operands and the result are row major, so
+    // those rows are contiguous in both.
+    TF_RET_CHECK(!mat_mult_dims.lhs_column_major &&
+                 mat_mult_dims.lhs_canonical);
+    llvm::Value* row_start = (*dynamic_loop_bounds_)[0].first;
+    m = b_->CreateSub((*dynamic_loop_bounds_)[0].second, row_start);
+    target_ptr = b_->CreateInBoundsGEP(
+        float_type, target_ptr,
+        b_->CreateMul(row_start, b_->getInt64(mat_mult_dims.n)));
+    lhs_ptr = b_->CreateInBoundsGEP(
+        float_type, lhs_ptr,
+        b_->CreateMul(row_start, b_->getInt64(mat_mult_dims.k)));
+  }
+  llvm::Value* n = b_->getInt64(mat_mult_dims.n);
+
   if (!mat_mult_dims.lhs_column_major) {
-    std::swap(mat_mult_dims.m, mat_mult_dims.n);
-    std::swap(lhs, rhs);
+    std::swap(m, n);
+    std::swap(lhs_ptr, rhs_ptr);
     std::swap(transpose_lhs, transpose_rhs);
   }
 
   b_->CreateCall(
       matmul_func,
       {b_->CreateBitCast(executable_run_options_value_, int8_ptr_type),
-       b_->CreateBitCast(target_array_.GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(lhs->GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(rhs->GetBasePointer(), float_ptr_type),
-       b_->getInt64(mat_mult_dims.m), b_->getInt64(mat_mult_dims.n),
-       b_->getInt64(mat_mult_dims.k), b_->getInt32(transpose_lhs),
-       b_->getInt32(transpose_rhs)});
+       target_ptr, lhs_ptr, rhs_ptr, m, n, b_->getInt64(mat_mult_dims.k),
+       b_->getInt32(transpose_lhs), b_->getInt32(transpose_rhs)});
   return Status::OK();
 }
 
@@ -888,6 +927,7 @@ Status EmitNonBatchDotOperation(
     DotInfo dot_info, string hlo_name, const llvm_ir::IrArray& target_array,
     const llvm_ir::IrArray& lhs_array, const llvm_ir::IrArray& rhs_array,
     const llvm_ir::IrArray* addend_array,
+    const DynamicLoopBounds* dynamic_loop_bounds,
     llvm::Value* executable_run_options_value, llvm::IRBuilder<>* b,
     const HloModuleConfig& hlo_module_config,
     const TargetMachineFeatures& target_machine_features) {
@@ -896,8 +936,8 @@ Status EmitNonBatchDotOperation(
                C128 == type);
   DotOpEmitter dot_emitter(std::move(dot_info), std::move(hlo_name),
                            target_array, lhs_array, rhs_array, addend_array,
-                           executable_run_options_value, b, hlo_module_config,
-                           target_machine_features);
+                           dynamic_loop_bounds, executable_run_options_value,
+                           b, hlo_module_config, target_machine_features);
   return dot_emitter.Emit();
 }
 
@@ -1029,8 +1069,8 @@ Status EmitBatchDotOperation(
         // Emit the inner non-batch dot operation.
         return EmitNonBatchDotOperation(
             dot_info, dot.name(), target_slice, lhs_slice, rhs_slice, nullptr,
-            executable_run_options_value, b, hlo_module_config,
-            target_machine_features);
+            /*dynamic_loop_bounds=*/nullptr, executable_run_options_value, b,
+            hlo_module_config, target_machine_features);
       });
 }
 
@@ -1055,6 +1095,35 @@ bool DotImplementationCanHandleTranspose(
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
+bool DotImplementationCanBePartitionedByRows(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features) {
+  if (IsBatchDot(dot_instr)) {
+    return false;
+  }
+  DotInfo dot_info(dot_instr);
+  if (!IsRank2(dot_info.lhs_shape) || !IsRank2(dot_info.rhs_shape) ||
+      !IsRank2(dot_info.result_shape) ||
+      dot_info.dim_nums.lhs_contracting_dimensions(0) != 1 ||
+      !LayoutUtil::IsMonotonicWithDim0Major(dot_info.result_shape.layout())) {
+    return false;
+  }
+
+  const HloModuleConfig& config = dot_instr.parent()->parent()->config();
+  switch (GetDotImplementationStrategy(config, dot_info,
+                                       target_machine_features)) {
+    case DotImplementationStrategy::kNaiveLlvmIr:
+      return true;
+    case DotImplementationStrategy::kEigen:
+      // The rows of the LHS are contiguous, like those of the result, only if
+      // the LHS is row major.
+      return !ShouldUseMultiThreadedEigen(config) &&
+             LayoutUtil::IsMonotonicWithDim0Major(dot_info.lhs_shape.layout());
+    default:
+      return false;
+  }
+}
+
 bool DotOperandsAndResultMustHaveRowMajorLayout(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features) {
@@ -1078,13 +1147,24 @@ Status EmitDotOperation(const HloInstruction& dot,
                         const llvm_ir::IrArray& lhs_array,
                         const llvm_ir::IrArray& rhs_array,
                         const llvm_ir::IrArray* addend_array,
+                        const DynamicLoopBounds* dynamic_loop_bounds,
                         llvm::Value* executable_run_options_value,
                         llvm::IRBuilder<>* b,
                         const HloModuleConfig& hlo_module_config,
                         const TargetMachineFeatures& target_machine_features) {
-  // This routine assumes that the dot operation is not in a parallelized
-  // enclosing computation.
-  CHECK(dot.parent()->root_instruction()->outer_dimension_partitions().empty());
+  if (dynamic_loop_bounds != nullptr) {
+    // ParallelTaskAssigner only partitions the rows of the result.
+    TF_RET_CHECK(dot.parent()->root_instruction() == &dot);
+    TF_RET_CHECK(dynamic_loop_bounds->size() == 1);
+    TF_RET_CHECK(addend_array == nullptr);
+    TF_RET_CHECK(DotImplementationCanBePartitionedByRows(
+        dot, target_machine_features));
+  } else {
+    // This routine assumes that the dot operation is not in a parallelized
+    // enclosing computation.
+    CHECK(
+        dot.parent()->root_instruction()->outer_dimension_partitions().empty());
+  }
 
   if (IsBatchDot(dot)) {
     TF_RET_CHECK(addend_array == nullptr);
@@ -1093,10 +1173,10 @@ Status EmitDotOperation(const HloInstruction& dot,
                                  hlo_module_config, target_machine_features);
   }
 
-  return EmitNonBatchDotOperation(DotInfo(dot), dot.name(), target_array,
-                                  lhs_array, rhs_array, addend_array,
-                                  executable_run_options_value, b,
-                                  hlo_module_config, target_machine_features);
+  return EmitNonBatchDotOperation(
+      DotInfo(dot), dot.name(), target_array, lhs_array, rhs_array,
+      addend_array, dynamic_loop_bounds, executable_run_options_value, b,
+      hlo_module_config, target_machine_features);
 }
 }  // namespace cpu
 }  // namespace xla
@@ -19,6 +19,7 @@ limitations under the License.
 #include "absl/strings/string_view.h"
 #include "llvm/IR/IRBuilder.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
+#include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_module_config.h"
@@ -42,6 +43,14 @@ bool DotImplementationCanHandleTranspose(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features);
 
+// Returns true if our lowering strategy for `dot_instr` can compute any range
+// of rows of its result on its own, so that ParallelTaskAssigner can partition
+// the result along its most major dimension.  Dots that call into
+// multi-threaded Eigen are parallelized by Eigen instead.
+bool DotImplementationCanBePartitionedByRows(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features);
+
 // Returns the index for an operand to `hlo` that should ideally be column
 // major.  Returns nullopt if there is no such operand or if `hlo` is not a dot
 // or a fusion containing a dot.
@@ -57,11 +66,18 @@ absl::optional<int64> ProfitableToMakeDotOperandColumnMajor(
 // dimensions as the result, and the result is computed as `addend_array` +
 // dot(`lhs_array`, `rhs_array`).  A non-null `addend_array` is only supported
 // for Matrix-vector products.
+//
+// If `dynamic_loop_bounds` is not nullptr then `dot` is the root of a
+// computation partitioned by ParallelTaskAssigner, which
+// DotImplementationCanBePartitionedByRows must allow, and only the rows of the
+// result within the dynamic loop bounds of its most major dimension are
+// computed.
 Status EmitDotOperation(const HloInstruction& dot,
                         const llvm_ir::IrArray& target_array,
                         const llvm_ir::IrArray& lhs_array,
                         const llvm_ir::IrArray& rhs_array,
                         const llvm_ir::IrArray* addend_array,
+                        const DynamicLoopBounds* dynamic_loop_bounds,
                         llvm::Value* executable_run_options_value,
                         llvm::IRBuilder<>* b,
                         const HloModuleConfig& hlo_module_config,
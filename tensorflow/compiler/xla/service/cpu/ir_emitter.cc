@@ -996,11 +996,20 @@ Status IrEmitter::HandleDot(HloInstruction* dot) {
   VLOG(2) << "  target: "
           << llvm_ir::DumpToString(*target_array.GetBasePointer());
 
+  // If the dot was assigned parallel tasks, only the rows of its result within
+  // the dynamic loop bounds are computed.
+  DynamicLoopBounds dynamic_loop_bounds;
+  if (ShouldEmitParallelLoopFor(*dot)) {
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+
   // Dot operation is complicated so we delegate to a helper class.
-  return EmitDotOperation(*dot, target_array, lhs_array, rhs_array,
-                          /*addend_array=*/nullptr,
-                          GetExecutableRunOptionsArgument(), &b_,
-                          hlo_module_config_, target_machine_features_);
+  return EmitDotOperation(
+      *dot, target_array, lhs_array, rhs_array,
+      /*addend_array=*/nullptr,
+      ShouldEmitParallelLoopFor(*dot) ? &dynamic_loop_bounds : nullptr,
+      GetExecutableRunOptionsArgument(), &b_, hlo_module_config_,
+      target_machine_features_);
 }
 
 StatusOr<llvm::Value*> IrEmitter::EmitElementalConvolution(
@@ -1770,6 +1779,19 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
     return false;
   }
 
+  // If the reduction was assigned parallel tasks, only the partition of its
+  // result within the dynamic loop bounds is computed here.  The loops below
+  // step over the most minor dimension by the vectorization factor, so it
+  // cannot be partitioned.
+  DynamicLoopBounds dynamic_loop_bounds;
+  if (ShouldEmitParallelLoopFor(*reduce)) {
+    if (num_dynamic_loop_bounds_ >= reduce->shape().rank()) {
+      *failure_reason = "minor dimension of the result is partitioned";
+      return false;
+    }
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+
   CHECK(!reduce->shape().IsTuple());
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(reduce));
 
@@ -1799,10 +1821,18 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
   for (int i = LayoutUtil::MinorToMajor(reduce->shape()).size() - 1; i > 0;
        --i) {
     int64 dimension = LayoutUtil::Minor(reduce->shape().layout(), i);
-    int64 start_index = 0;
-    int64 end_index = reduce->shape().dimensions(dimension);
-    std::unique_ptr<llvm_ir::ForLoop> loop = loop_nest.AddLoop(
-        start_index, end_index, absl::StrFormat("dim.%d", dimension));
+    const int bounds_index = reduce->shape().rank() - 1 - i;
+    std::unique_ptr<llvm_ir::ForLoop> loop;
+    if (bounds_index < dynamic_loop_bounds.size()) {
+      loop = loop_nest.AddLoop(absl::StrFormat("dim.%d", dimension),
+                               dynamic_loop_bounds[bounds_index].first,
+                               dynamic_loop_bounds[bounds_index].second);
+    } else {
+      int64 start_index = 0;
+      int64 end_index = reduce->shape().dimensions(dimension);
+      loop = loop_nest.AddLoop(start_index, end_index,
+                               absl::StrFormat("dim.%d", dimension));
+    }
     array_multi_index[dimension] = loop->GetIndVarValue();
   }
 
@@ -2305,7 +2335,8 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
 
     TF_RETURN_IF_ERROR(
         EmitDotOperation(*dot, target_array, lhs_array, rhs_array,
-                         &addend_array, GetExecutableRunOptionsArgument(), &b_,
+                         &addend_array, /*dynamic_loop_bounds=*/nullptr,
+                         GetExecutableRunOptionsArgument(), &b_,
                          hlo_module_config_, target_machine_features_));
     return Status::OK();
   } else {
@@ -90,11 +90,11 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   // not unique among already emitted functions then a suffix is appended to
   // make the name unique.
   //
-  // 'is_top_level_computation' has the following meanings for each CPU backend:
-  // *) sequential: indicates that this is the entry computation of the HLO
-  //    module.
-  // *) parallel: indices that this is the callee of a kCall HLO in the entry
-  //    computation of the HLO module.
+  // 'is_top_level_computation' indicates that the function is called directly
+  // by CpuExecutable, which gives it external linkage:
+  // *) the entry computation of the HLO module.
+  // *) with concurrent regions, the callee of a kCall HLO in the entry
+  //    computation, i.e. a region outlined by ConcurrentRegionOutliner.
   //
   // If 'instruction_order' is not NULL, then the HLO instructions are emitted
   // in the given order.  In this case, 'instruction_order' must be a
@@ -112,10 +112,18 @@ ParallelTaskAssignment::ParallelTaskAssignment(
     const TargetMachineFeatures* target_machine_features)
     : target_machine_features_(*target_machine_features) {
   VLOG(1) << "ParallelTaskAssignment max_parallelism: " << max_parallelism;
-  // Run cost analysis on 'module'.
+  // Run cost analysis on 'module'.  Instructions are assigned parallel tasks
+  // in the bodies of While and Call HLOs as well as in the entry computation,
+  // so every non-fusion computation is analyzed: the analysis of the entry
+  // computation only records the total cost of the computations it calls.
   auto cost_analysis = absl::make_unique<HloCostAnalysis>(shape_size);
-  HloComputation* computation = module->entry_computation();
-  Status status = computation->root_instruction()->Accept(cost_analysis.get());
+  Status status;
+  for (HloComputation* computation : module->MakeNonfusionComputations()) {
+    status = computation->root_instruction()->Accept(cost_analysis.get());
+    if (!status.ok()) {
+      break;
+    }
+  }
   if (status.ok()) {
     // Set default cost model based on 'cost_analysis'.
     cost_model_.reset(new DefaultCostModel(max_parallelism, shape_size,
@@ -133,6 +141,8 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
   // Currently, we do not assign parallel tasks to instructions with at least
   // one of the following properties:
   // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall).
+  //    Dots whose result can be computed a range of rows at a time, i.e.
+  //    naive LLVM IR loops and single-threaded Eigen calls, are partitioned.
   // *) Emit custom loops (kSelectAndScatter).
   // *) Operations that are not thread safe (like infeed and rng).
   // *) Tuple-shaped.
@@ -144,7 +154,10 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
   auto opcode = instruction->opcode();
   if (opcode == HloOpcode::kParameter || opcode == HloOpcode::kConstant ||
       opcode == HloOpcode::kCall || opcode == HloOpcode::kCustomCall ||
-      opcode == HloOpcode::kDot || opcode == HloOpcode::kSelectAndScatter ||
+      (opcode == HloOpcode::kDot &&
+       !DotImplementationCanBePartitionedByRows(*instruction,
+                                                target_machine_features_)) ||
+      opcode == HloOpcode::kSelectAndScatter ||
       opcode == HloOpcode::kGetTupleElement || opcode == HloOpcode::kBitcast ||
       opcode == HloOpcode::kFft || opcode == HloOpcode::kInfeed ||
       opcode == HloOpcode::kOutfeed || opcode == HloOpcode::kRng ||
@@ -159,7 +172,15 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
   }
 
   // Consult 'cost_model_' to compute target parallel task count.
-  return cost_model_->GetParallelTaskCount(instruction);
+  const int64 target_parallel_task_count =
+      cost_model_->GetParallelTaskCount(instruction);
+  if (opcode == HloOpcode::kDot) {
+    // Only partition the rows of the result, which ShapePartitionAssigner
+    // does as long as there are at least as many rows as partitions.
+    return std::min(target_parallel_task_count,
+                    instruction->shape().dimensions(0));
+  }
+  return target_parallel_task_count;
 }
 
 StatusOr<bool> ParallelTaskAssigner::Run(HloModule* module) {
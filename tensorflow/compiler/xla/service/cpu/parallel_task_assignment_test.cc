@@ -44,6 +44,18 @@ class ParallelTaskAssignmentTest : public HloTestBase {
                                      &target_machine_features_)
         .Run(module);
   }
+
+  // Returns the instruction of 'module' that was assigned parallel tasks, or
+  // nullptr if there is none.
+  const HloInstruction* FindPartitionedInstruction(const HloModule& module) {
+    for (const HloComputation* computation : module.computations()) {
+      const HloInstruction* root = computation->root_instruction();
+      if (!root->outer_dimension_partitions().empty()) {
+        return root;
+      }
+    }
+    return nullptr;
+  }
 };
 
 TEST_F(ParallelTaskAssignmentTest, DotOperationNotParallelized) {
@@ -91,6 +103,100 @@ TEST_F(ParallelTaskAssignmentTest,
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, NaiveDotParallelizedByRows) {
+  // Complex dots are lowered to naive LLVM IR loops.
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_NaiveDot
+    ENTRY NaiveDot {
+      dot_lhs = c64[64,64]{1,0} parameter(0)
+      dot_rhs = c64[64,64]{1,0} parameter(1)
+      ROOT dot = c64[64,64]{1,0} dot(dot_lhs, dot_rhs),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  const HloInstruction* dot = FindPartitionedInstruction(*m);
+  ASSERT_NE(dot, nullptr);
+  EXPECT_EQ(dot->opcode(), HloOpcode::kDot);
+  EXPECT_EQ(dot->outer_dimension_partitions(),
+            std::vector<int64>({max_parallelism_}));
+}
+
+TEST_F(ParallelTaskAssignmentTest, SingleThreadedEigenDotParallelizedByRows) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_EigenDot
+    ENTRY EigenDot {
+      dot_lhs = f32[256,256]{1,0} parameter(0)
+      dot_rhs = f32[256,256]{1,0} parameter(1)
+      ROOT dot = f32[256,256]{1,0} dot(dot_lhs, dot_rhs),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  // Multi-threaded Eigen parallelizes the dot on its own.
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+
+  HloModuleConfig config = GetModuleConfigForTest();
+  DebugOptions debug_options = config.debug_options();
+  debug_options.set_xla_cpu_multi_thread_eigen(false);
+  config.set_debug_options(debug_options);
+  TF_ASSERT_OK_AND_ASSIGN(m, ParseAndReturnVerifiedModule(hlo_string, config));
+  TF_ASSERT_OK_AND_ASSIGN(changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  const HloInstruction* dot = FindPartitionedInstruction(*m);
+  ASSERT_NE(dot, nullptr);
+  EXPECT_EQ(dot->opcode(), HloOpcode::kDot);
+  EXPECT_EQ(dot->outer_dimension_partitions().size(), 1);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ComputeBoundWhileBodyParallelized) {
+  // The dot is too small to be parallelized if it is not known to be compute
+  // bound, which the cost analysis of the while body tells.
+  const string hlo_string = R"(
+  HloModule test
+
+  body {
+    loop_carry = (s32[], c64[64,64]) parameter(0)
+    i = s32[] get-tuple-element(loop_carry), index=0
+    one = s32[] constant(1)
+    new_i = s32[] add(i, one)
+    data = c64[64,64] get-tuple-element(loop_carry), index=1
+    new_data = c64[64,64] dot(data, data),
+      lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    ROOT tuple = (s32[], c64[64,64]) tuple(new_i, new_data)
+  }
+
+  cond {
+    loop_carry = (s32[], c64[64,64]) parameter(0)
+    two = s32[] constant(2)
+    i = s32[] get-tuple-element(loop_carry), index=0
+    ROOT less-than = pred[] compare(i, two), direction=LT
+  }
+
+  ENTRY test {
+    initial_i = s32[] parameter(0)
+    data = c64[64,64] parameter(1)
+    tuple = (s32[], c64[64,64]) tuple(initial_i, data)
+    ROOT while = (s32[], c64[64,64]) while(tuple), condition=cond, body=body
+  }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  const HloInstruction* dot = FindPartitionedInstruction(*m);
+  ASSERT_NE(dot, nullptr);
+  EXPECT_EQ(dot->opcode(), HloOpcode::kDot);
+}
+
 TEST_F(ParallelTaskAssignmentTest, RngOperationNotParallelized) {
   const string hlo_string = R"(
     HloModule TestTaskParallel_rng
@@ -0,0 +1,136 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/persistent_object_cache.h"
+
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Identifies the format of the cached objects. The version must be bumped when
+// objects are compiled or stored in a way the key does not capture.
+constexpr char kMagic[] = "XLACPUOBJ1";
+constexpr size_t kMagicSize = sizeof(kMagic) - 1;
+// Objects are stored after the magic string and a masked crc32c of the object.
+constexpr size_t kHeaderSize = kMagicSize + sizeof(uint32);
+
+}  // namespace
+
+tensorflow::monitoring::Counter<1>* PersistentObjectCacheLookups() {
+  static auto* lookups = tensorflow::monitoring::Counter<1>::New(
+      "/xla/cpu/persistent_object_cache_lookups",
+      "The number of lookups in persistent object caches of the CPU backend.",
+      "result");
+  return lookups;
+}
+
+PersistentObjectCache::PersistentObjectCache(tensorflow::Env* env,
+                                             const string& directory)
+    : env_(env), directory_(directory) {}
+
+/*static*/ string PersistentObjectCache::Key(
+    const llvm::Module& module, const llvm::TargetMachine& target_machine,
+    absl::string_view options) {
+  string contents;
+  {
+    llvm::raw_string_ostream stream(contents);
+    llvm::WriteBitcodeToFile(module, stream);
+    stream << '\0' << LLVM_VERSION_STRING << '\0'
+           << target_machine.getTargetTriple().str() << '\0'
+           << target_machine.getTargetCPU() << '\0'
+           << target_machine.getTargetFeatureString() << '\0'
+           << llvm::StringRef(options.data(), options.size());
+  }
+  const tensorflow::Fprint128 fingerprint =
+      tensorflow::Fingerprint128(contents);
+  return absl::StrFormat("%016x%016x", fingerprint.high64, fingerprint.low64);
+}
+
+string PersistentObjectCache::Filename(const string& key) const {
+  return tensorflow::io::JoinPath(directory_, absl::StrCat(key, ".o"));
+}
+
+std::unique_ptr<llvm::MemoryBuffer> PersistentObjectCache::Lookup(
+    const string& key) const {
+  const string filename = Filename(key);
+  string contents;
+  Status status = tensorflow::ReadFileToString(env_, filename, &contents);
+  if (!status.ok()) {
+    if (tensorflow::errors::IsNotFound(status)) {
+      PersistentObjectCacheLookups()->GetCell("miss")->IncrementBy(1);
+    } else {
+      LOG(WARNING) << "Failed to read the cached object " << filename << ": "
+                   << status;
+      PersistentObjectCacheLookups()->GetCell("error")->IncrementBy(1);
+    }
+    return nullptr;
+  }
+  if (contents.size() < kHeaderSize ||
+      std::memcmp(contents.data(), kMagic, kMagicSize) != 0 ||
+      tensorflow::crc32c::Unmask(tensorflow::core::DecodeFixed32(
+          contents.data() + kMagicSize)) !=
+          tensorflow::crc32c::Value(contents.data() + kHeaderSize,
+                                    contents.size() - kHeaderSize)) {
+    LOG(WARNING) << "Ignoring the corrupted cached object " << filename;
+    PersistentObjectCacheLookups()->GetCell("error")->IncrementBy(1);
+    return nullptr;
+  }
+  VLOG(1) << "Loaded the cached object " << filename;
+  PersistentObjectCacheLookups()->GetCell("hit")->IncrementBy(1);
+  return llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(contents.data() + kHeaderSize,
+                      contents.size() - kHeaderSize),
+      filename);
+}
+
+Status PersistentObjectCache::Insert(const string& key,
+                                     llvm::MemoryBufferRef object) const {
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+  string contents(kMagic, kMagicSize);
+  tensorflow::core::PutFixed32(
+      &contents, tensorflow::crc32c::Mask(tensorflow::crc32c::Value(
+                     object.getBufferStart(), object.getBufferSize())));
+  contents.append(object.getBufferStart(), object.getBufferSize());
+  // Concurrent processes may compile the same module, so the object is
+  // renamed into place to never expose a partially written file.
+  const string filename = Filename(key);
+  const string tmp_filename =
+      absl::StrCat(filename, ".tmp", tensorflow::random::New64());
+  TF_RETURN_IF_ERROR(
+      tensorflow::WriteStringToFile(env_, tmp_filename, contents));
+  Status status = env_->RenameFile(tmp_filename, filename);
+  if (!status.ok()) {
+    env_->DeleteFile(tmp_filename).IgnoreError();
+  }
+  return status;
+}
+
+}  // namespace cpu
+}  // namespace xla
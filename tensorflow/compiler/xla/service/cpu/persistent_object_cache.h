@@ -0,0 +1,76 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PERSISTENT_OBJECT_CACHE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PERSISTENT_OBJECT_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace xla {
+namespace cpu {
+
+// Stores the object code compiled by the CPU backend in a directory, so that
+// a process compiling an LLVM module that an earlier process has compiled,
+// typically because it JIT-compiles the same clusters after a restart, skips
+// the LLVM optimization and code generation, which dominate compile times.
+//
+// Objects are keyed by a fingerprint of the unoptimized LLVM module, which
+// is derived from the optimized HLO module and its buffer assignment, and of
+// the target machine and code generation options. The cache can be shared by
+// concurrent processes: objects are written to a temporary file that is then
+// renamed, and unreadable or corrupted objects are treated as misses.
+class PersistentObjectCache {
+ public:
+  PersistentObjectCache(tensorflow::Env* env, const string& directory);
+
+  // Returns the key of `module` compiled for `target_machine` with the given
+  // options. Must be called before `module` is optimized.
+  static string Key(const llvm::Module& module,
+                    const llvm::TargetMachine& target_machine,
+                    absl::string_view options);
+
+  // Returns the object stored for `key`, or nullptr if there is none.
+  std::unique_ptr<llvm::MemoryBuffer> Lookup(const string& key) const;
+
+  // Stores `object` for `key`, replacing any object stored for it.
+  Status Insert(const string& key, llvm::MemoryBufferRef object) const;
+
+  const string& directory() const { return directory_; }
+
+ private:
+  string Filename(const string& key) const;
+
+  tensorflow::Env* const env_;
+  const string directory_;
+};
+
+// Counts the lookups in persistent object caches. The `result` label is
+// "hit", "miss" or "error" for objects that could not be read.
+tensorflow::monitoring::Counter<1>* PersistentObjectCacheLookups();
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PERSISTENT_OBJECT_CACHE_H_
@@ -0,0 +1,197 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/persistent_object_cache.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+const char* const kHloText = R"(
+HloModule persistent_object_cache
+
+ENTRY main {
+  p0 = f32[64,64] parameter(0)
+  p1 = f32[64,64] parameter(1)
+  dot = f32[64,64] dot(p0, p1), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  ROOT tanh = f32[64,64] tanh(dot)
+}
+)";
+
+// Returns an empty directory that no other test uses.
+string NewCacheDirectory() {
+  static int next_id = 0;
+  string directory = tensorflow::io::JoinPath(
+      tensorflow::testing::TmpDir(),
+      absl::StrCat("persistent_object_cache_", next_id++));
+  int64 undeleted_files, undeleted_dirs;
+  tensorflow::Env::Default()
+      ->DeleteRecursively(directory, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  return directory;
+}
+
+int64 LookupCount(const string& result) {
+  return PersistentObjectCacheLookups()->GetCell(result)->value();
+}
+
+std::unique_ptr<llvm::MemoryBuffer> MakeObject(const string& contents) {
+  return llvm::MemoryBuffer::getMemBufferCopy(contents);
+}
+
+TEST(PersistentObjectCacheTest, InsertAndLookup) {
+  PersistentObjectCache cache(tensorflow::Env::Default(), NewCacheDirectory());
+  const int64 hits = LookupCount("hit");
+  const int64 misses = LookupCount("miss");
+
+  EXPECT_EQ(cache.Lookup("key"), nullptr);
+  EXPECT_EQ(LookupCount("miss"), misses + 1);
+
+  TF_ASSERT_OK(cache.Insert("key", MakeObject("object")->getMemBufferRef()));
+  std::unique_ptr<llvm::MemoryBuffer> object = cache.Lookup("key");
+  ASSERT_NE(object, nullptr);
+  EXPECT_EQ(object->getBuffer().str(), "object");
+  EXPECT_EQ(LookupCount("hit"), hits + 1);
+
+  // Inserting again replaces the object.
+  TF_ASSERT_OK(cache.Insert("key", MakeObject("other")->getMemBufferRef()));
+  object = cache.Lookup("key");
+  ASSERT_NE(object, nullptr);
+  EXPECT_EQ(object->getBuffer().str(), "other");
+  EXPECT_EQ(cache.Lookup("other_key"), nullptr);
+}
+
+TEST(PersistentObjectCacheTest, SharedBetweenInstances) {
+  const string directory = NewCacheDirectory();
+  PersistentObjectCache writer(tensorflow::Env::Default(), directory);
+  TF_ASSERT_OK(writer.Insert("key", MakeObject("object")->getMemBufferRef()));
+
+  PersistentObjectCache reader(tensorflow::Env::Default(), directory);
+  std::unique_ptr<llvm::MemoryBuffer> object = reader.Lookup("key");
+  ASSERT_NE(object, nullptr);
+  EXPECT_EQ(object->getBuffer().str(), "object");
+}
+
+TEST(PersistentObjectCacheTest, CorruptedObjectIsIgnored) {
+  const string directory = NewCacheDirectory();
+  PersistentObjectCache cache(tensorflow::Env::Default(), directory);
+  TF_ASSERT_OK(cache.Insert("key", MakeObject("object")->getMemBufferRef()));
+
+  const string filename = tensorflow::io::JoinPath(directory, "key.o");
+  string contents;
+  TF_ASSERT_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                            filename, &contents));
+  contents.back() ^= 1;
+  TF_ASSERT_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                             filename, contents));
+  const int64 errors = LookupCount("error");
+  EXPECT_EQ(cache.Lookup("key"), nullptr);
+  EXPECT_EQ(LookupCount("error"), errors + 1);
+
+  TF_ASSERT_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                             filename, "short"));
+  EXPECT_EQ(cache.Lookup("key"), nullptr);
+  EXPECT_EQ(LookupCount("error"), errors + 2);
+}
+
+class PersistentObjectCacheCompileTest : public HloTestBase {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_persistent_cache_dir(cache_dir_);
+    return debug_options;
+  }
+
+  const string cache_dir_ = NewCacheDirectory();
+};
+
+TEST_F(PersistentObjectCacheCompileTest, RecompileLoadsCachedObject) {
+  Literal lhs(ShapeUtil::MakeShape(F32, {64, 64}));
+  Literal rhs(ShapeUtil::MakeShape(F32, {64, 64}));
+  lhs.PopulateWithValue(0.5f);
+  rhs.PopulateWithValue(0.25f);
+
+  const int64 hits = LookupCount("hit");
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHloText));
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          Execute(std::move(module), {&lhs, &rhs}));
+  EXPECT_EQ(LookupCount("hit"), hits);
+
+  std::vector<string> objects;
+  TF_ASSERT_OK(tensorflow::Env::Default()->GetMatchingPaths(
+      tensorflow::io::JoinPath(cache_dir_, "*.o"), &objects));
+  EXPECT_EQ(objects.size(), 1);
+
+  // Compiling the same module again, as a restarted process would, loads the
+  // object compiled above instead of running LLVM.
+  TF_ASSERT_OK_AND_ASSIGN(module, ParseAndReturnVerifiedModule(kHloText));
+  TF_ASSERT_OK_AND_ASSIGN(Literal actual,
+                          Execute(std::move(module), {&lhs, &rhs}));
+  EXPECT_EQ(LookupCount("hit"), hits + 1);
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+}
+
+// Compiles the module above with an empty cache if `warm` is false, or with a
+// cache holding its object otherwise, to measure the compile time a restarted
+// process saves.
+void BM_CompileWithPersistentCache(int num_iters, int warm) {
+  tensorflow::testing::StopTiming();
+  se::Platform* platform = PlatformUtil::GetPlatform("cpu").ValueOrDie();
+  HloRunner runner(platform);
+  const string warm_cache_dir = NewCacheDirectory();
+  for (int i = 0; i < num_iters; ++i) {
+    HloModuleConfig config;
+    DebugOptions debug_options = GetDebugOptionsFromFlags();
+    debug_options.set_xla_cpu_persistent_cache_dir(warm ? warm_cache_dir
+                                                        : NewCacheDirectory());
+    config.set_debug_options(debug_options);
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnUnverifiedModule(kHloText, config).ValueOrDie();
+    if (warm && i == 0) {
+      TF_CHECK_OK(runner.CreateExecutable(module->Clone(), true).status());
+    }
+
+    tensorflow::testing::StartTiming();
+    TF_CHECK_OK(runner.CreateExecutable(std::move(module), true).status());
+    tensorflow::testing::StopTiming();
+  }
+}
+
+BENCHMARK(BM_CompileWithPersistentCache)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
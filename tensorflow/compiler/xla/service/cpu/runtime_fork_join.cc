@@ -17,6 +17,10 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/compiler/xla/executable_run_options.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
@@ -31,9 +35,50 @@ using tensorflow::uint64;
 using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
                                      int64*, uint64*);
 
-// Dispatches 'num_partitions - 1' calls to 'function_ptr' in parallel.
-// Calls 'function_ptr' for first partition inline.
-// Uses blocking counter to synchonize threads after parallel calls complete.
+namespace {
+
+// The partitions of a parallel fork-join, which the calling thread and the
+// helper threads it dispatches claim one at a time until none are left.  It is
+// shared with the helpers, which may only start once all the partitions are
+// done and the calling thread has returned.
+struct ForkJoinState {
+  explicit ForkJoinState(int32 num_partitions)
+      : num_partitions(num_partitions),
+        next_partition(0),
+        partitions_done(num_partitions) {}
+
+  const int32 num_partitions;
+  std::atomic<int32> next_partition;
+  tensorflow::BlockingCounter partitions_done;
+};
+
+// Runs the partitions of 'state' that no other thread has claimed yet.
+void RunPartitions(ForkJoinState* state, ComputeFunctionType function,
+                   void* result_ptr, const void* run_options_ptr,
+                   void** buffer_table, uint64* prof_counters,
+                   int64* partitions, int64 stride) {
+  for (;;) {
+    const int32 i =
+        state->next_partition.fetch_add(1, std::memory_order_relaxed);
+    if (i >= state->num_partitions) {
+      return;
+    }
+    function(result_ptr, run_options_ptr, nullptr, buffer_table,
+             &partitions[i * stride], prof_counters);
+    VLOG(3) << "ParallelForkJoin partition " << i << " done.";
+    state->partitions_done.DecrementCount();
+  }
+}
+
+}  // namespace
+
+// Runs the 'num_partitions' calls to 'function_ptr' on the calling thread and
+// on up to 'num_partitions - 1' helper threads of the intra-op thread pool.
+// Rather than assigning a partition to each thread, the threads claim the next
+// unclaimed partition whenever they finish one, so that partitions of uneven
+// cost and helpers the thread pool is slow to start do not hold up the others.
+// The calling thread only blocks on the partitions that are running on other
+// threads once there are none left to claim, never on idle helpers.
 //
 // The 'partitions' array has a total number of elements equal to
 // 'num_partitions * num_partitioned_dims * 2' (the '2' is necessary to specify
@@ -81,24 +126,22 @@ TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ParallelForkJoin(
   // Compute partition stride in 'partitions' array.
   const int64 stride = 2 * num_partitioned_dims;
 
-  // Dispatch 'num_partitions - 1' compute functions to run in parallel.
-  tensorflow::BlockingCounter bc(num_partitions - 1);
-  for (int32 i = 1; i < num_partitions; ++i) {
-    const int64 offset = i * stride;
+  // Dispatch as many helpers as there are threads to run the partitions the
+  // calling thread does not get to.
+  auto state = std::make_shared<ForkJoinState>(num_partitions);
+  const int num_helpers = std::min<int>(
+      num_partitions - 1, run_options->intra_op_thread_pool()->numThreads());
+  for (int i = 0; i < num_helpers; ++i) {
     run_options->intra_op_thread_pool()->enqueueNoNotification(
-        [i, function, result_ptr, run_options_ptr, buffer_table, prof_counters,
-         partitions, offset, &bc]() {
-          function(result_ptr, run_options_ptr, nullptr, buffer_table,
-                   &partitions[offset], prof_counters);
-          bc.DecrementCount();
-          VLOG(3) << "ParallelForkJoin partition " << i << " done.";
+        [state, function, result_ptr, run_options_ptr, buffer_table,
+         prof_counters, partitions, stride]() {
+          RunPartitions(state.get(), function, result_ptr, run_options_ptr,
+                        buffer_table, prof_counters, partitions, stride);
         });
   }
 
-  // Call first compute function inline.
-  function(result_ptr, run_options_ptr, params, buffer_table, &partitions[0],
-           prof_counters);
-  VLOG(3) << "ParallelForkJoin partition 0 done.";
-  bc.Wait();
+  RunPartitions(state.get(), function, result_ptr, run_options_ptr,
+                buffer_table, prof_counters, partitions, stride);
+  state->partitions_done.Wait();
   VLOG(2) << "ParallelForkJoin EXIT";
 }
@@ -98,7 +98,8 @@ SimpleOrcJIT::SimpleOrcJIT(
     bool disable_expensive_passes,
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
-    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook)
+    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+    std::shared_ptr<const PersistentObjectCache> object_cache)
     : target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
       data_layout_(target_machine_->createDataLayout()),
       symbol_resolver_(llvm::orc::createLegacyLookupResolver(
@@ -134,7 +135,8 @@ SimpleOrcJIT::SimpleOrcJIT(
           CompilerFunctor(
               target_machine_.get(), opt_level, optimize_for_size,
               disable_expensive_passes, std::move(pre_optimization_hook),
-              std::move(post_optimization_hook), std::move(post_codegen_hook))),
+              std::move(post_optimization_hook), std::move(post_codegen_hook),
+              std::move(object_cache))),
       gdb_jit_event_listener_(
           llvm::JITEventListener::createGDBRegistrationListener()) {
   VLOG(1) << "CPU target: " << target_machine_->getTargetCPU().str()
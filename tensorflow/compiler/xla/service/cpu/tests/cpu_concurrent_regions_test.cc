@@ -0,0 +1,103 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/xla/array2d.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Four independent dots, each large enough to run as a multi-threaded Eigen
+// contraction, which the concurrent regions run side by side.
+const char* const kIndependentDots = R"(
+  HloModule IndependentDots
+  ENTRY IndependentDots {
+    p0 = f32[256,256] parameter(0)
+    p1 = f32[256,256] parameter(1)
+    dot0 = f32[256,256] dot(p0, p0), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    dot1 = f32[256,256] dot(p1, p1), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    dot2 = f32[256,256] dot(p0, p1), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    dot3 = f32[256,256] dot(p1, p0), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    ROOT tuple = (f32[256,256], f32[256,256], f32[256,256], f32[256,256]) tuple(dot0, dot1, dot2, dot3)
+  }
+)";
+
+TEST(CpuConcurrentRegionsTest, ConcurrentExecutionsShareTheThreadPool) {
+  TF_ASSERT_OK_AND_ASSIGN(se::Platform * platform,
+                          PlatformUtil::GetPlatform("cpu"));
+  // With two threads, each execution running a region on the thread pool would
+  // leave no thread for the Eigen tasks that the regions wait on.
+  HloRunner runner(platform, /*intra_op_parallelism_threads=*/2);
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_cpu_enable_concurrent_regions(true);
+
+  std::vector<std::unique_ptr<Executable>> executables;
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<HloModule> module,
+        HloRunner::CreateModuleFromString(kIndependentDots, debug_options));
+    TF_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<Executable> executable,
+        runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true));
+    executables.push_back(std::move(executable));
+  }
+
+  Literal p0 = LiteralUtil::CreateR2FromArray2D(Array2D<float>(256, 256, 1.0f));
+  Literal p1 = LiteralUtil::CreateR2FromArray2D(Array2D<float>(256, 256, 2.0f));
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<ScopedShapedBuffer> arguments,
+                          runner.TransferLiteralsToDevice({&p0, &p1}));
+  Literal dot0 =
+      LiteralUtil::CreateR2FromArray2D(Array2D<float>(256, 256, 256.0f));
+  Literal dot1 =
+      LiteralUtil::CreateR2FromArray2D(Array2D<float>(256, 256, 1024.0f));
+  Literal dot23 =
+      LiteralUtil::CreateR2FromArray2D(Array2D<float>(256, 256, 512.0f));
+  const Literal expected =
+      LiteralUtil::MakeTuple({&dot0, &dot1, &dot23, &dot23});
+
+  {
+    tensorflow::thread::ThreadPool pool(tensorflow::Env::Default(),
+                                        "executions", executables.size());
+    for (const std::unique_ptr<Executable>& executable : executables) {
+      pool.Schedule([&runner, &arguments, &expected,
+                     executable = executable.get()]() {
+        for (int i = 0; i < 10; ++i) {
+          TF_ASSERT_OK_AND_ASSIGN(
+              ScopedShapedBuffer result,
+              runner.ExecuteWithDeviceBuffers(executable, arguments));
+          TF_ASSERT_OK_AND_ASSIGN(Literal literal,
+                                  runner.TransferLiteralFromDevice(result));
+          EXPECT_TRUE(LiteralTestUtil::Equal(expected, literal));
+        }
+      });
+    }
+  }
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -24,9 +24,11 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/compiler/xla/array2d.h"
+#include "tensorflow/compiler/xla/array4d.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/literal.h"
@@ -825,10 +827,12 @@ XLA_TEST_F(FusionClientLibraryTest, ManyLayoutTransformations) {
   ComputeAndCompare(&b, {});
 }
 
-void BM_ParallelFusion(int num_iters) {
-  // Simple element-wise computation to benchmark parallel task partitioning.
-  tensorflow::testing::StopTiming();
-
+// Runs 'computation' on 'args' with a pool of intra-op threads, to benchmark
+// parallel task partitioning.  The dots of 'computation' are partitioned, and
+// not multi-threaded by Eigen, unless 'multi_thread_eigen' is true.
+void RunParallelBenchmark(int num_iters, const XlaComputation& computation,
+                          absl::Span<const Literal> args, int64 total_bytes,
+                          bool multi_thread_eigen) {
   se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
   auto executors = PlatformUtil::GetStreamExecutors(platform).ValueOrDie();
   se::StreamExecutorMemoryAllocator allocator(platform, executors);
@@ -842,53 +846,24 @@ void BM_ParallelFusion(int num_iters) {
 
   int device_ordinal = client->default_device_ordinal();
 
-  // Computation shape parameters.
-  const int64 param0_dim0 = 1024;
-  const int64 param0_dim1 = 1024;
-  const int64 param1_dim0 = 1024;
-  const int64 param1_dim1 = 1024;
-  const int64 param2_dim0 = 1024;
-  const int64 param2_dim1 = 1024;
-
-  // Create computation.
-  XlaBuilder builder("ParallelFusion");
-  Shape shape0 = ShapeUtil::MakeShape(F32, {param0_dim0, param0_dim1});
-  auto param0 = Parameter(&builder, 0, shape0, "param0");
-  Shape shape1 = ShapeUtil::MakeShape(F32, {param1_dim0, param1_dim1});
-  auto param1 = Parameter(&builder, 1, shape1, "param1");
-  Shape shape2 = ShapeUtil::MakeShape(F32, {param2_dim0, param2_dim1});
-  auto param2 = Parameter(&builder, 2, shape2, "param2");
-
-  auto x = Mul(param0, param1);
-  Add(x, param2);
-  auto computation = builder.Build().ConsumeValueOrDie();
-
   // Transfer literals to device.
-  auto param0_literal =
-      LiteralUtil::CreateR2F32Linspace(1.0, 2.0, param0_dim0, param0_dim1);
-  ScopedShapedBuffer buffer0 =
-      client->LiteralToShapedBuffer(param0_literal, device_ordinal)
-          .ConsumeValueOrDie();
-
-  auto param1_literal =
-      LiteralUtil::CreateR2F32Linspace(1.0, 2.0, param1_dim0, param1_dim1);
-  ScopedShapedBuffer buffer1 =
-      client->LiteralToShapedBuffer(param1_literal, device_ordinal)
-          .ConsumeValueOrDie();
-
-  auto param2_literal =
-      LiteralUtil::CreateR2F32Linspace(1.0, 2.0, param2_dim0, param2_dim1);
-  ScopedShapedBuffer buffer2 =
-      client->LiteralToShapedBuffer(param2_literal, device_ordinal)
-          .ConsumeValueOrDie();
+  std::vector<ScopedShapedBuffer> buffers;
+  std::vector<const ShapedBuffer*> buffer_ptrs;
+  std::vector<const Shape*> buffer_shapes;
+  buffers.reserve(args.size());
+  for (const Literal& arg : args) {
+    buffers.push_back(
+        client->LiteralToShapedBuffer(arg, device_ordinal).ConsumeValueOrDie());
+    buffer_ptrs.push_back(&buffers.back());
+    buffer_shapes.push_back(&buffers.back().on_host_shape());
+  }
 
   // Build executable.
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()->set_xla_cpu_multi_thread_eigen(
+      multi_thread_eigen);
   std::unique_ptr<LocalExecutable> executable =
-      client
-          ->Compile(computation,
-                    {&buffer0.on_host_shape(), &buffer1.on_host_shape(),
-                     &buffer2.on_host_shape()},
-                    ExecutableBuildOptions())
+      client->Compile(computation, buffer_shapes, build_options)
           .ConsumeValueOrDie();
 
   se::Stream stream(executors[device_ordinal]);
@@ -907,25 +882,158 @@ void BM_ParallelFusion(int num_iters) {
   // Run some warm-up executions.
   const int kWarmups = 2;
   for (int i = 0; i < kWarmups; ++i) {
-    auto result = executable->Run({&buffer0, &buffer1, &buffer2}, options);
+    auto result = executable->Run(buffer_ptrs, options);
     ASSERT_TRUE(result.ok());
   }
 
   // Run benchmark.
-  const int64 total_bytes = param0_dim0 * param0_dim0 +
-                            param1_dim0 * param1_dim0 +
-                            param2_dim0 * param2_dim0;
   tensorflow::testing::BytesProcessed(static_cast<int64>(num_iters) *
-                                      total_bytes * sizeof(float));
+                                      total_bytes);
   tensorflow::testing::UseRealTime();
   tensorflow::testing::StartTiming();
   for (int i = 0; i < num_iters; ++i) {
-    auto result = executable->Run({&buffer0, &buffer1, &buffer2}, options);
+    auto result = executable->Run(buffer_ptrs, options);
     ASSERT_TRUE(result.ok());
   }
 }
 
+void BM_ParallelFusion(int num_iters) {
+  // Simple element-wise computation to benchmark parallel task partitioning.
+  tensorflow::testing::StopTiming();
+
+  // Computation shape parameters.
+  const int64 param0_dim0 = 1024;
+  const int64 param0_dim1 = 1024;
+  const int64 param1_dim0 = 1024;
+  const int64 param1_dim1 = 1024;
+  const int64 param2_dim0 = 1024;
+  const int64 param2_dim1 = 1024;
+
+  // Create computation.
+  XlaBuilder builder("ParallelFusion");
+  Shape shape0 = ShapeUtil::MakeShape(F32, {param0_dim0, param0_dim1});
+  auto param0 = Parameter(&builder, 0, shape0, "param0");
+  Shape shape1 = ShapeUtil::MakeShape(F32, {param1_dim0, param1_dim1});
+  auto param1 = Parameter(&builder, 1, shape1, "param1");
+  Shape shape2 = ShapeUtil::MakeShape(F32, {param2_dim0, param2_dim1});
+  auto param2 = Parameter(&builder, 2, shape2, "param2");
+
+  auto x = Mul(param0, param1);
+  Add(x, param2);
+  auto computation = builder.Build().ConsumeValueOrDie();
+
+  std::vector<Literal> args;
+  args.push_back(
+      LiteralUtil::CreateR2F32Linspace(1.0, 2.0, param0_dim0, param0_dim1));
+  args.push_back(
+      LiteralUtil::CreateR2F32Linspace(1.0, 2.0, param1_dim0, param1_dim1));
+  args.push_back(
+      LiteralUtil::CreateR2F32Linspace(1.0, 2.0, param2_dim0, param2_dim1));
+
+  const int64 total_bytes = param0_dim0 * param0_dim0 +
+                            param1_dim0 * param1_dim0 +
+                            param2_dim0 * param2_dim0;
+  RunParallelBenchmark(num_iters, computation, args,
+                       total_bytes * sizeof(float),
+                       /*multi_thread_eigen=*/true);
+}
+
 BENCHMARK(BM_ParallelFusion);
 
+// Benchmarks a multi-layer perceptron, whose dots are partitioned by rows if
+// 'multi_thread_eigen' is false.
+void BM_ParallelMlp(int num_iters, int multi_thread_eigen) {
+  tensorflow::testing::StopTiming();
+
+  const int64 batch_size = 256;
+  const int64 layer_size = 1024;
+  const int kNumLayers = 3;
+
+  XlaBuilder builder("ParallelMlp");
+  std::vector<Literal> args;
+  args.push_back(
+      LiteralUtil::CreateR2F32Linspace(-1.0, 1.0, batch_size, layer_size));
+  auto activations = Parameter(&builder, 0, args.back().shape(), "input");
+  for (int i = 0; i < kNumLayers; ++i) {
+    args.push_back(
+        LiteralUtil::CreateR2F32Linspace(-0.1, 0.1, layer_size, layer_size));
+    auto weights = Parameter(&builder, args.size() - 1, args.back().shape(),
+                             absl::StrCat("weights", i));
+    args.push_back(LiteralUtil::CreateR1<float>(
+        std::vector<float>(layer_size, 0.01f)));
+    auto biases = Parameter(&builder, args.size() - 1, args.back().shape(),
+                            absl::StrCat("biases", i));
+    activations = Max(Add(Dot(activations, weights), biases, {1}),
+                      ConstantR0<float>(&builder, 0.0f));
+  }
+  auto computation = builder.Build().ConsumeValueOrDie();
+
+  int64 total_bytes = 0;
+  for (const Literal& arg : args) {
+    total_bytes += arg.size_bytes();
+  }
+  RunParallelBenchmark(num_iters, computation, args, total_bytes,
+                       multi_thread_eigen);
+}
+
+BENCHMARK(BM_ParallelMlp)->Arg(0)->Arg(1);
+
+// Benchmarks a stack of convolutions with biases and relus, whose elementwise
+// parts are partitioned.
+void BM_ParallelConvolution(int num_iters) {
+  tensorflow::testing::StopTiming();
+
+  const int64 batch_size = 8;
+  const int64 image_size = 56;
+  const int64 num_features = 64;
+  const int kNumLayers = 3;
+
+  XlaBuilder builder("ParallelConvolution");
+  std::vector<Literal> args;
+  Array4D<float> input(batch_size, image_size, image_size, num_features);
+  input.FillRandom(1.0f);
+  args.push_back(LiteralUtil::CreateR4FromArray4D(input));
+  auto activations = Parameter(&builder, 0, args.back().shape(), "input");
+
+  ConvolutionDimensionNumbers dnums;
+  dnums.set_input_batch_dimension(0);
+  dnums.set_input_feature_dimension(3);
+  dnums.add_input_spatial_dimensions(1);
+  dnums.add_input_spatial_dimensions(2);
+  dnums.set_kernel_input_feature_dimension(2);
+  dnums.set_kernel_output_feature_dimension(3);
+  dnums.add_kernel_spatial_dimensions(0);
+  dnums.add_kernel_spatial_dimensions(1);
+  dnums.set_output_batch_dimension(0);
+  dnums.set_output_feature_dimension(3);
+  dnums.add_output_spatial_dimensions(1);
+  dnums.add_output_spatial_dimensions(2);
+  for (int i = 0; i < kNumLayers; ++i) {
+    Array4D<float> kernel(3, 3, num_features, num_features);
+    kernel.FillRandom(0.1f);
+    args.push_back(LiteralUtil::CreateR4FromArray4D(kernel));
+    auto weights = Parameter(&builder, args.size() - 1, args.back().shape(),
+                             absl::StrCat("kernel", i));
+    args.push_back(LiteralUtil::CreateR1<float>(
+        std::vector<float>(num_features, 0.01f)));
+    auto biases = Parameter(&builder, args.size() - 1, args.back().shape(),
+                            absl::StrCat("biases", i));
+    auto conv = ConvWithGeneralDimensions(activations, weights, {1, 1},
+                                          Padding::kSame, dnums);
+    activations =
+        Max(Add(conv, biases, {3}), ConstantR0<float>(&builder, 0.0f));
+  }
+  auto computation = builder.Build().ConsumeValueOrDie();
+
+  int64 total_bytes = 0;
+  for (const Literal& arg : args) {
+    total_bytes += arg.size_bytes();
+  }
+  RunParallelBenchmark(num_iters, computation, args, total_bytes,
+                       /*multi_thread_eigen=*/true);
+}
+
+BENCHMARK(BM_ParallelConvolution);
+
 }  // namespace
 }  // namespace xla
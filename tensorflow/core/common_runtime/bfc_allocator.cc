@@ -16,6 +16,8 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
 
 #include <atomic>
+#include <functional>
+#include <thread>  // NOLINT
 
 #include "tensorflow/core/common_runtime/allocator_retry.h"
 #include "tensorflow/core/lib/core/bits.h"
@@ -23,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
@@ -31,7 +34,7 @@ namespace tensorflow {
 
 BFCAllocator::BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
                            bool allow_growth, const string& name,
-                           bool garbage_collection)
+                           bool garbage_collection, bool thread_caches)
     : garbage_collection_(garbage_collection),
       sub_allocator_(sub_allocator),
       name_(name),
@@ -67,6 +70,13 @@ BFCAllocator::BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
       CHECK_NE(BinForSize(bin_size * 2), BinFromIndex(b));
     }
   }
+
+  if (thread_caches) {
+    num_cache_shards_ = std::max(1, port::NumTotalCPUs());
+    cache_shards_.reset(new CacheShard[num_cache_shards_]);
+    VLOG(1) << "Enabled " << num_cache_shards_ << " thread caches for "
+            << name_;
+  }
 }
 
 BFCAllocator::~BFCAllocator() {
@@ -199,28 +209,63 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
   if (allocation_attr.freed_by_func != nullptr) {
     freed_by_count = (*allocation_attr.freed_by_func)();
   }
-  void* r =
-      AllocateRawInternal(unused_alignment, num_bytes, false, freed_by_count);
+  void* r = AllocateRawInternalMaybeFlush(unused_alignment, num_bytes, false,
+                                          freed_by_count);
   if (r != nullptr) {
     return r;
   } else {
     static const int64 kMaxMillisToWait = 10000;  // 10 seconds
+    num_retrying_allocations_.fetch_add(1);
     r = retry_helper_.AllocateRaw(
         [this, &allocation_attr](size_t a, size_t nb, bool v) {
           uint64 freed_by_count = 0;
           if (allocation_attr.freed_by_func != nullptr) {
             freed_by_count = (*allocation_attr.freed_by_func)();
           }
-          return AllocateRawInternal(a, nb, v, freed_by_count);
+          return AllocateRawInternalMaybeFlush(a, nb, v, freed_by_count);
         },
         kMaxMillisToWait, unused_alignment, num_bytes);
+    num_retrying_allocations_.fetch_sub(1);
     return r;
   }
 }
 
+void* BFCAllocator::AllocateRawInternalMaybeFlush(size_t alignment,
+                                                  size_t num_bytes,
+                                                  bool dump_log_on_failure,
+                                                  uint64 freed_before_count) {
+  if (cache_shards_ == nullptr) {
+    return AllocateRawInternal(alignment, num_bytes, dump_log_on_failure,
+                               freed_before_count);
+  }
+  void* ptr = AllocateRawInternal(alignment, num_bytes,
+                                  /*dump_log_on_failure=*/false,
+                                  freed_before_count);
+  if (ptr == nullptr) {
+    // The memory we need may be held in the thread caches.
+    FlushThreadCaches();
+    ptr = AllocateRawInternal(alignment, num_bytes, dump_log_on_failure,
+                              freed_before_count);
+  }
+  return ptr;
+}
+
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(1) << "AllocateRaw " << Name() << "  " << num_bytes;
+  if (cache_shards_ != nullptr && allocation_attr.freed_by_func == nullptr &&
+      timing_counter_ == nullptr) {
+    const int cache_class = CacheClassForSize(num_bytes);
+    if (cache_class >= 0) {
+      void* ptr = AllocateRawFromCache(cache_class);
+      if (ptr != nullptr) {
+        return ptr;
+      }
+      // Round the request up to its cache class, so that the chunk can serve
+      // any request of that class once it is cached.
+      num_bytes = CacheClassToSize(cache_class);
+    }
+  }
   if (allocation_attr.no_retry_on_failure) {
     // Return immediately upon the first failure if this is for allocating an
     // optional scratch space.
@@ -229,8 +274,8 @@ void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
     if (allocation_attr.freed_by_func != nullptr) {
       freed_by_count = (*allocation_attr.freed_by_func)();
     }
-    void* result = AllocateRawInternal(unused_alignment, num_bytes,
-                                       dump_log_on_failure, freed_by_count);
+    void* result = AllocateRawInternalMaybeFlush(
+        unused_alignment, num_bytes, dump_log_on_failure, freed_by_count);
     if (result == nullptr) {
       static std::atomic<int32> log_counter{0};
       int32 counter_value = log_counter.load(std::memory_order_relaxed);
@@ -525,10 +570,133 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 void BFCAllocator::DeallocateRaw(void* ptr) {
   VLOG(1) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
+  // While allocations are waiting for memory, bypass the caches so that the
+  // freed chunk can be coalesced and the waiters notified.
+  if (cache_shards_ != nullptr && ptr != nullptr &&
+      timing_counter_ == nullptr &&
+      num_retrying_allocations_.load(std::memory_order_relaxed) == 0 &&
+      DeallocateRawToCache(ptr)) {
+    return;
+  }
   DeallocateRawInternal(ptr);
   retry_helper_.NotifyDealloc();
 }
 
+// static
+int BFCAllocator::CacheClassForSize(size_t num_bytes) {
+  if (num_bytes == 0 || num_bytes > CacheClassToSize(kNumCacheClasses - 1)) {
+    return -1;
+  }
+  return Log2Ceiling64(RoundedBytes(num_bytes) >> kMinAllocationBits);
+}
+
+BFCAllocator::CacheShard* BFCAllocator::CurrentCacheShard() {
+  int cpu = port::GetCurrentCPU();
+  if (cpu < 0) {
+    cpu = static_cast<int>(std::hash<std::thread::id>()(
+                               std::this_thread::get_id()) &
+                           0x7fffffff);
+  }
+  return &cache_shards_[cpu % num_cache_shards_];
+}
+
+void* BFCAllocator::AllocateRawFromCache(int cache_class) {
+  CacheShard* shard = CurrentCacheShard();
+  CachedChunk cached;
+  {
+    mutex_lock l(shard->mu);
+    std::vector<CachedChunk>& free_chunks = shard->free_chunks[cache_class];
+    if (free_chunks.empty()) {
+      cache_misses_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    cached = free_chunks.back();
+    free_chunks.pop_back();
+  }
+  cache_hits_.fetch_add(1, std::memory_order_relaxed);
+  cached_bytes_.fetch_sub(cached.size, std::memory_order_relaxed);
+  return cached.ptr;
+}
+
+bool BFCAllocator::DeallocateRawToCache(void* ptr) {
+  CachedChunk cached;
+  int cache_class;
+  {
+    // The chunk metadata only changes under an exclusive lock, so a shared
+    // lock is enough to read it without contending with other readers.
+    tf_shared_lock l(lock_);
+    const ChunkHandle h = region_manager_.get_handle(ptr);
+    CHECK(h != kInvalidChunkHandle);
+    const Chunk* c = ChunkFromHandle(h);
+    cache_class = CacheClassForSize(c->requested_size);
+    // Only chunks allocated through AllocateRaw() with thread caches enabled
+    // have been rounded up to their cache class.
+    if (cache_class < 0 ||
+        c->requested_size != CacheClassToSize(cache_class)) {
+      return false;
+    }
+    cached.handle = h;
+    cached.ptr = ptr;
+    cached.size = c->size;
+  }
+
+  std::vector<CachedChunk> to_release;
+  CacheShard* shard = CurrentCacheShard();
+  {
+    mutex_lock l(shard->mu);
+    std::vector<CachedChunk>& free_chunks = shard->free_chunks[cache_class];
+    free_chunks.push_back(cached);
+    cached_bytes_.fetch_add(cached.size, std::memory_order_relaxed);
+    if (free_chunks.size() > kMaxCachedChunksPerClass) {
+      // Return the least recently cached half to the bins.
+      const size_t n = free_chunks.size() / 2;
+      to_release.assign(free_chunks.begin(), free_chunks.begin() + n);
+      free_chunks.erase(free_chunks.begin(), free_chunks.begin() + n);
+    }
+  }
+  if (!to_release.empty()) {
+    ReleaseCachedChunks(to_release);
+  }
+  return true;
+}
+
+size_t BFCAllocator::FlushThreadCaches() {
+  size_t num_flushed = 0;
+  for (int i = 0; i < num_cache_shards_; ++i) {
+    CacheShard* shard = &cache_shards_[i];
+    std::vector<CachedChunk> chunks;
+    {
+      mutex_lock l(shard->mu);
+      for (std::vector<CachedChunk>& free_chunks : shard->free_chunks) {
+        chunks.insert(chunks.end(), free_chunks.begin(), free_chunks.end());
+        free_chunks.clear();
+      }
+    }
+    if (!chunks.empty()) {
+      num_flushed += chunks.size();
+      ReleaseCachedChunks(chunks);
+    }
+  }
+  return num_flushed;
+}
+
+void BFCAllocator::ReleaseCachedChunks(const std::vector<CachedChunk>& chunks) {
+  {
+    mutex_lock l(lock_);
+    for (const CachedChunk& cached : chunks) {
+      cached_bytes_.fetch_sub(cached.size, std::memory_order_relaxed);
+      MarkFree(cached.handle);
+      if (timing_counter_) {
+        InsertFreeChunkIntoBin(cached.handle);
+        timestamped_chunks_.push_back(cached.handle);
+      } else {
+        InsertFreeChunkIntoBin(TryToCoalesce(cached.handle, false));
+      }
+    }
+  }
+  retry_helper_.NotifyDealloc();
+}
+
 void BFCAllocator::DeallocateRawInternal(void* ptr) {
   if (ptr == nullptr) {
     VLOG(2) << "tried to deallocate nullptr";
@@ -931,7 +1099,15 @@ void BFCAllocator::DumpMemoryLog(size_t num_bytes) {
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
   mutex_lock l(lock_);
-  return stats_;
+  if (cache_shards_ == nullptr) {
+    return stats_;
+  }
+  AllocatorStats stats = stats_;
+  stats.num_cache_hits = cache_hits_.load(std::memory_order_relaxed);
+  stats.num_cache_misses = cache_misses_.load(std::memory_order_relaxed);
+  stats.num_allocs += stats.num_cache_hits;
+  stats.bytes_in_use -= cached_bytes_.load(std::memory_order_relaxed);
+  return stats;
 }
 
 void BFCAllocator::ClearStats() {
@@ -939,6 +1115,8 @@ void BFCAllocator::ClearStats() {
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
+  cache_hits_.store(0, std::memory_order_relaxed);
+  cache_misses_.store(0, std::memory_order_relaxed);
 }
 
 std::array<BFCAllocator::BinDebugInfo, BFCAllocator::kNumBins>
@@ -45,12 +45,21 @@ namespace tensorflow {
 // coalescing.  One assumption we make is that the process using this
 // allocator owns pretty much all of the memory, and that nearly
 // all requests to allocate memory go through this interface.
+//
+// If 'thread_caches' is true, small allocations are served from per-CPU
+// caches of free chunks placed in front of the bins, so that threads
+// allocating and freeing small temporaries concurrently rarely contend on the
+// allocator lock.  Cached chunks are returned to the bins when a cache grows
+// past a threshold, or when an allocation cannot otherwise be satisfied.
+// With thread caches enabled, small allocations are rounded up to a power of
+// two, RequestedSize() reports the rounded size, and AllocationId() may
+// return the same id for successive allocations reusing a cached chunk.
 class BFCAllocator : public Allocator {
  public:
   // Takes ownership of sub_allocator.
   BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
                bool allow_growth, const string& name,
-               bool garbage_collection = false);
+               bool garbage_collection = false, bool thread_caches = false);
   ~BFCAllocator() override;
 
   string Name() override { return name_; }
@@ -93,6 +102,40 @@ class BFCAllocator : public Allocator {
 
   void DeallocateRawInternal(void* ptr);
 
+  // Thread cache support.  Chunks held in a cache are in use as far as the
+  // bins are concerned; only the caches themselves know that they are free.
+
+  // Returns the cache class serving allocations of 'num_bytes', or -1 if
+  // such allocations bypass the thread caches.
+  static int CacheClassForSize(size_t num_bytes);
+  static size_t CacheClassToSize(int cache_class) {
+    return kMinAllocationSize << cache_class;
+  }
+
+  // Pops a cached chunk of class 'cache_class' from the current CPU's cache.
+  // Returns nullptr on a cache miss.
+  void* AllocateRawFromCache(int cache_class);
+
+  // Pushes the chunk holding 'ptr' to the current CPU's cache if it belongs
+  // to a cache class.  Returns false if the chunk must be freed to the bins.
+  bool DeallocateRawToCache(void* ptr);
+
+  // Returns every cached chunk to the bins.  Returns the number of chunks
+  // that were returned.
+  size_t FlushThreadCaches() LOCKS_EXCLUDED(lock_);
+
+  struct CachedChunk;
+
+  // Returns the chunks in 'chunks' to the bins.
+  void ReleaseCachedChunks(const std::vector<CachedChunk>& chunks)
+      LOCKS_EXCLUDED(lock_);
+
+  // Allocates with AllocateRawInternal(), flushing the thread caches and
+  // trying again if the first attempt fails.
+  void* AllocateRawInternalMaybeFlush(size_t alignment, size_t num_bytes,
+                                      bool dump_log_on_failure,
+                                      uint64 freed_before_count);
+
   // Chunks whose freed_at_count is later than the safe frontier value are kept
   // on a special list and not subject to merging immediately upon being freed.
   //
@@ -416,7 +459,7 @@ class BFCAllocator : public Allocator {
 
   Chunk* ChunkFromHandle(ChunkHandle h) EXCLUSIVE_LOCKS_REQUIRED(lock_);
   const Chunk* ChunkFromHandle(ChunkHandle h) const
-      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+      SHARED_LOCKS_REQUIRED(lock_);
 
   void MarkFree(ChunkHandle h) EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
@@ -516,6 +559,44 @@ class BFCAllocator : public Allocator {
   // Stats.
   AllocatorStats stats_ GUARDED_BY(lock_);
 
+  // Thread caches cover cache classes of 256B (kMinAllocationSize) up to
+  // 64KiB, each holding at most kMaxCachedChunksPerClass chunks per CPU.
+  static const int kNumCacheClasses = 9;
+  static const int kMaxCachedChunksPerClass = 64;
+
+  // A chunk held in a thread cache.  'ptr' and 'size' are copies of the
+  // corresponding Chunk fields, which can only be read under lock_.
+  struct CachedChunk {
+    ChunkHandle handle;
+    void* ptr;
+    size_t size;
+  };
+
+  // The free chunks cached for one CPU, by cache class.
+  struct CacheShard {
+    mutex mu;
+    std::array<std::vector<CachedChunk>, kNumCacheClasses> free_chunks
+        GUARDED_BY(mu);
+  };
+
+  // Returns the shard of the CPU the calling thread runs on.
+  CacheShard* CurrentCacheShard();
+
+  // Null iff thread caches are disabled.
+  std::unique_ptr<CacheShard[]> cache_shards_;
+  int num_cache_shards_ = 0;
+
+  // Number of allocations currently waiting in the retry loop.  Thread caches
+  // are bypassed while this is positive, so that freed memory goes straight
+  // back to the bins.
+  std::atomic<int> num_retrying_allocations_{0};
+
+  // Cache stats.  Chunks held in the caches are counted in
+  // stats_.bytes_in_use, so GetStats() subtracts cached_bytes_.
+  std::atomic<int64> cache_hits_{0};
+  std::atomic<int64> cache_misses_{0};
+  std::atomic<int64> cached_bytes_{0};
+
   friend class GPUBFCAllocatorPrivateMethodsTest;
   TF_DISALLOW_COPY_AND_ASSIGN(BFCAllocator);
 };
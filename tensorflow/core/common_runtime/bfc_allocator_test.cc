@@ -0,0 +1,225 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace {
+
+SubAllocator* NewCPUSubAllocator() {
+  return new BasicCPUAllocator(port::kNUMANoAffinity, {}, {});
+}
+
+TEST(BFCAllocatorTest, ThreadCachesReuseFreedChunks) {
+  BFCAllocator a(NewCPUSubAllocator(), 1 << 30, true /*allow_growth*/,
+                 "cpu_bfc", false /*garbage_collection*/,
+                 true /*thread_caches*/);
+
+  void* p1 = a.AllocateRaw(1, 1000);
+  ASSERT_NE(p1, nullptr);
+  // Small allocations are rounded up to their cache class.
+  EXPECT_EQ(1024, a.RequestedSize(p1));
+  a.DeallocateRaw(p1);
+
+  absl::optional<AllocatorStats> stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(0, stats->bytes_in_use);
+  EXPECT_EQ(0, stats->num_cache_hits);
+  EXPECT_EQ(1, stats->num_cache_misses);
+
+  void* p2 = a.AllocateRaw(1, 900);
+  ASSERT_NE(p2, nullptr);
+  stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(1024, stats->bytes_in_use);
+  EXPECT_EQ(2, stats->num_allocs);
+  EXPECT_EQ(1, stats->num_cache_hits);
+  EXPECT_EQ(1, stats->num_cache_misses);
+  a.DeallocateRaw(p2);
+}
+
+TEST(BFCAllocatorTest, ThreadCachesBypassLargeAllocations) {
+  BFCAllocator a(NewCPUSubAllocator(), 1 << 30, true /*allow_growth*/,
+                 "cpu_bfc", false /*garbage_collection*/,
+                 true /*thread_caches*/);
+
+  void* p = a.AllocateRaw(1, 1 << 20);
+  ASSERT_NE(p, nullptr);
+  EXPECT_EQ(1 << 20, a.RequestedSize(p));
+  a.DeallocateRaw(p);
+
+  absl::optional<AllocatorStats> stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(0, stats->bytes_in_use);
+  EXPECT_EQ(0, stats->num_cache_hits);
+  EXPECT_EQ(0, stats->num_cache_misses);
+}
+
+TEST(BFCAllocatorTest, ThreadCachesDisabledByDefault) {
+  BFCAllocator a(NewCPUSubAllocator(), 1 << 30, true /*allow_growth*/,
+                 "cpu_bfc");
+
+  void* p = a.AllocateRaw(1, 1000);
+  ASSERT_NE(p, nullptr);
+  EXPECT_EQ(1000, a.RequestedSize(p));
+  a.DeallocateRaw(p);
+
+  absl::optional<AllocatorStats> stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(0, stats->num_cache_hits);
+  EXPECT_EQ(0, stats->num_cache_misses);
+}
+
+TEST(BFCAllocatorTest, ThreadCachesAreFlushedWhenOutOfMemory) {
+  // 1MiB of memory, all of it ends up in the caches as 64KiB chunks.
+  const size_t kMemory = 1 << 20;
+  BFCAllocator a(NewCPUSubAllocator(), kMemory, false /*allow_growth*/,
+                 "cpu_bfc", false /*garbage_collection*/,
+                 true /*thread_caches*/);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < kMemory / (64 << 10); ++i) {
+    void* p = a.AllocateRaw(1, 64 << 10);
+    ASSERT_NE(p, nullptr);
+    ptrs.push_back(p);
+  }
+  for (void* p : ptrs) {
+    a.DeallocateRaw(p);
+  }
+
+  // Succeeds only if the cached chunks are returned to the bins and
+  // coalesced.
+  AllocationAttributes attr;
+  attr.no_retry_on_failure = true;
+  void* p = a.AllocateRaw(1, kMemory / 2, attr);
+  ASSERT_NE(p, nullptr);
+  a.DeallocateRaw(p);
+}
+
+TEST(BFCAllocatorTest, ThreadCachesConcurrentAllocations) {
+  BFCAllocator a(NewCPUSubAllocator(), 1 << 30, true /*allow_growth*/,
+                 "cpu_bfc", false /*garbage_collection*/,
+                 true /*thread_caches*/);
+  const int kNumThreads = 8;
+  const int kNumIters = 1000;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, t]() {
+        std::vector<std::pair<uint8*, size_t>> live;
+        for (int i = 0; i < kNumIters; ++i) {
+          const size_t bytes = 16 << ((i + t) % 12);
+          uint8* p = static_cast<uint8*>(a.AllocateRaw(1, bytes));
+          ASSERT_NE(p, nullptr);
+          std::fill(p, p + bytes, static_cast<uint8>(t));
+          live.emplace_back(p, bytes);
+          if (live.size() > 16) {
+            for (const auto& chunk : live) {
+              // No other thread may have been handed the same memory.
+              ASSERT_EQ(static_cast<uint8>(t), chunk.first[0]);
+              ASSERT_EQ(static_cast<uint8>(t), chunk.first[chunk.second - 1]);
+              a.DeallocateRaw(chunk.first);
+            }
+            live.clear();
+          }
+        }
+        for (const auto& chunk : live) {
+          a.DeallocateRaw(chunk.first);
+        }
+      });
+    }
+  }
+  absl::optional<AllocatorStats> stats = a.GetStats();
+  ASSERT_TRUE(stats);
+  LOG(INFO) << "Alloc stats: " << std::endl << stats->DebugString();
+  EXPECT_EQ(0, stats->bytes_in_use);
+  EXPECT_EQ(kNumThreads * kNumIters, stats->num_allocs);
+  EXPECT_GT(stats->num_cache_hits, 0);
+}
+
+// Each thread allocates and frees a few small temporaries, as kernels running
+// concurrently on the inter-op threadpool do.
+static void BM_SmallAllocationsThreaded(int iters, int num_threads,
+                                        int thread_caches) {
+  testing::StopTiming();
+  BFCAllocator a(NewCPUSubAllocator(), 1uLL << 33, true /*allow_growth*/,
+                 "cpu_bfc", false /*garbage_collection*/,
+                 thread_caches != 0);
+  thread::ThreadPool pool(Env::Default(), "test", num_threads);
+  std::atomic_int_fast32_t count(iters);
+  mutex done_lock;
+  condition_variable done;
+  bool done_flag = false;
+  testing::StartTiming();
+
+  for (int t = 0; t < num_threads; t++) {
+    pool.Schedule([&a, &count, &done_lock, &done, &done_flag, iters]() {
+      const std::vector<int> sizes = {64, 256, 1024, 4096, 16384, 512};
+      int size_index = 0;
+      for (int i = 0; i < iters; i++) {
+        void* p1 = a.AllocateRaw(1, sizes[size_index++ % sizes.size()]);
+        void* p2 = a.AllocateRaw(1, sizes[size_index++ % sizes.size()]);
+        a.DeallocateRaw(p1);
+        a.DeallocateRaw(p2);
+        const int64 remaining = count.fetch_sub(1);
+        if (remaining == 1) {
+          mutex_lock l(done_lock);
+          done_flag = true;
+          done.notify_all();
+        }
+        if (remaining <= 1) {
+          break;
+        }
+      }
+    });
+  }
+  mutex_lock l(done_lock);
+  if (!done_flag) {
+    done.wait(l);
+  }
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * 2);
+  if (thread_caches) {
+    absl::optional<AllocatorStats> stats = a.GetStats();
+    const int64 total = stats->num_cache_hits + stats->num_cache_misses;
+    testing::SetLabel(strings::StrCat(
+        "cache hit rate: ",
+        total > 0 ? 100 * stats->num_cache_hits / total : 0, "%"));
+  }
+}
+BENCHMARK(BM_SmallAllocationsThreaded)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(4, 0)
+    ->ArgPair(4, 1)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1);
+
+}  // namespace
+}  // namespace tensorflow
@@ -151,6 +151,28 @@ string GetRendezvousKey(const string& tensor_name,
                          frame_iter.frame_id, ":", frame_iter.iter_id);
 }
 
+// Adds the allocation counts of a step that ran with a static memory plan on
+// `device` to `step_stats`.
+void AddStaticMemoryPlanStats(const string& device,
+                              const StaticMemoryPlan::Stats& stats,
+                              StepStats* step_stats) {
+  DeviceStepStats* dev_stats = nullptr;
+  for (DeviceStepStats& ds : *step_stats->mutable_dev_stats()) {
+    if (ds.device() == device) {
+      dev_stats = &ds;
+      break;
+    }
+  }
+  if (dev_stats == nullptr) {
+    dev_stats = step_stats->add_dev_stats();
+    dev_stats->set_device(device);
+  }
+  StaticMemoryPlanStats* plan_stats = dev_stats->mutable_static_memory_plan();
+  plan_stats->set_num_arena_allocations(stats.num_arena_allocations);
+  plan_stats->set_num_allocator_allocations(stats.num_allocator_allocations);
+  plan_stats->set_arena_bytes(stats.arena_bytes);
+}
+
 }  // namespace
 
 class DirectSessionFactory : public SessionFactory {
@@ -517,7 +539,8 @@ Status DirectSession::RunInternal(
                             executor_step_count, &debugger_state));
   }
 
-  run_state.rendez = new IntraProcessRendezvous(device_mgr_.get());
+  run_state.rendez = new IntraProcessRendezvous(
+      device_mgr_.get(), executors_and_keys->num_rendezvous_slots);
 #ifndef __ANDROID__
   // Set up for collectives if ExecutorsAndKeys declares a key.
   if (executors_and_keys->collective_graph_key !=
@@ -675,6 +698,19 @@ Status DirectSession::RunInternal(
     };
   }
 
+  // Bracket the step of every static memory plan, and remember its allocation
+  // counts so that the share of this step can be reported.
+  std::vector<int64> memory_plan_steps(num_executors, -1);
+  std::vector<StaticMemoryPlan::Stats> memory_plan_stats(num_executors);
+  for (size_t i = 0; i < num_executors; ++i) {
+    StaticMemoryPlan* plan =
+        executors_and_keys->items[i].static_memory_plan.get();
+    if (plan != nullptr) {
+      memory_plan_stats[i] = plan->GetStats();
+      memory_plan_steps[i] = plan->StartStep();
+    }
+  }
+
   for (const auto& item : executors_and_keys->items) {
     // TODO(azaks): support partial run.
     // TODO(azaks): if the device picks its own threadpool, we need to assign
@@ -693,6 +729,7 @@ Status DirectSession::RunInternal(
     if (handler != nullptr) {
       args.user_intra_op_threadpool = handler->AsIntraThreadPoolInterface();
     }
+    args.static_memory_plan = item.static_memory_plan.get();
 
     item.executor->RunAsync(args, barrier->Get());
   }
@@ -702,6 +739,22 @@ Status DirectSession::RunInternal(
                           ? run_options.timeout_in_ms()
                           : operation_timeout_in_ms_);
 
+  for (size_t i = 0; i < num_executors; ++i) {
+    StaticMemoryPlan* plan =
+        executors_and_keys->items[i].static_memory_plan.get();
+    if (plan != nullptr) {
+      plan->EndStep(memory_plan_steps[i]);
+      const StaticMemoryPlan::Stats stats = plan->GetStats();
+      memory_plan_stats[i].num_arena_allocations =
+          stats.num_arena_allocations -
+          memory_plan_stats[i].num_arena_allocations;
+      memory_plan_stats[i].num_allocator_allocations =
+          stats.num_allocator_allocations -
+          memory_plan_stats[i].num_allocator_allocations;
+      memory_plan_stats[i].arena_bytes = stats.arena_bytes;
+    }
+  }
+
   if (!cancellation_manager_->DeregisterCallback(cancellation_token)) {
     // The step has been cancelled: make sure we don't attempt to receive the
     // outputs as this would make it block forever.
@@ -728,6 +781,13 @@ Status DirectSession::RunInternal(
 
   if (run_state.collector) {
     run_state.collector->Finalize();
+    for (size_t i = 0; i < num_executors; ++i) {
+      const PerPartitionExecutorsAndLib& item = executors_and_keys->items[i];
+      if (item.static_memory_plan != nullptr) {
+        AddStaticMemoryPlanStats(item.device->name(), memory_plan_stats[i],
+                                 run_metadata->mutable_step_stats());
+      }
+    }
   }
 
   // Build and return the cost model as instructed.
@@ -905,7 +965,8 @@ Status DirectSession::PRunSetup(const std::vector<string>& input_names,
   args.step_id = step_id_counter_.fetch_add(1);
   RunState* run_state =
       new RunState(input_names, output_names, args.step_id, &devices_);
-  run_state->rendez = new IntraProcessRendezvous(device_mgr_.get());
+  run_state->rendez = new IntraProcessRendezvous(
+      device_mgr_.get(), executors_and_keys->num_rendezvous_slots);
   {
     mutex_lock l(executor_lock_);
     if (!partial_runs_
@@ -1256,7 +1317,8 @@ Status DirectSession::CreateExecutors(
   std::unordered_map<string, std::unique_ptr<Graph>> graphs;
   TF_RETURN_IF_ERROR(CreateGraphs(
       options, &graphs, &func_info->flib_def, run_state_args, &ek->input_types,
-      &ek->output_types, &ek->collective_graph_key));
+      &ek->output_types, &ek->collective_graph_key,
+      &ek->num_rendezvous_slots));
 
   if (run_state_args->is_partial_run) {
     ek->graph = std::move(run_state_args->graph);
@@ -1357,6 +1419,12 @@ Status DirectSession::CreateExecutors(
     item->graph = partition_graph.get();
     item->executor = nullptr;
     item->device = device;
+    if (callable_options.use_static_memory_plan() &&
+        device->device_type() == DEVICE_CPU) {
+      item->static_memory_plan.reset(
+          new StaticMemoryPlan(device->GetAllocator(AllocatorAttributes()),
+                               partition_graph->num_node_ids()));
+    }
     auto executor_type = options_.config.experimental().executor_type();
     TF_RETURN_IF_ERROR(NewExecutor(
         executor_type, params, std::move(partition_graph), &item->executor));
@@ -1518,7 +1586,8 @@ Status DirectSession::CreateGraphs(
     std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
     std::unique_ptr<FunctionLibraryDefinition>* flib_def,
     RunStateArgs* run_state_args, DataTypeVector* input_types,
-    DataTypeVector* output_types, int64* collective_graph_key) {
+    DataTypeVector* output_types, int64* collective_graph_key,
+    int64* num_rendezvous_slots) {
   mutex_lock l(graph_state_lock_);
   std::unique_ptr<ClientGraph> client_graph;
 
@@ -1602,6 +1671,9 @@ Status DirectSession::CreateGraphs(
   };
   popts.flib_def = &client_graph->graph.flib_def();
   popts.control_flow_added = false;
+  // The partitions of a step always share its rendezvous, so their Send/Recv
+  // pairs can be matched by slot.
+  popts.num_rendezvous_slots = num_rendezvous_slots;
 
   std::unordered_map<string, GraphDef> partitions;
   TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, &partitions));
@@ -32,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/session_factory.h"
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -138,6 +139,8 @@ class DirectSession : public Session {
     Device* device = nullptr;                // not owned.
     FunctionLibraryRuntime* flib = nullptr;  // not owned.
     std::unique_ptr<Executor> executor;
+    // Set if CallableOptions.use_static_memory_plan is true.
+    core::RefCountPtr<StaticMemoryPlan> static_memory_plan;
   };
 
   // An ExecutorsAndKeys is created for a given set of feeds/fetches.
@@ -166,6 +169,10 @@ class DirectSession : public Session {
     CallableOptions callable_options;
 
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
+
+    // The number of Send/Recv pairs between the partitions, which the
+    // rendezvous of each step matches by slot.
+    int64 num_rendezvous_slots = 0;
   };
 
   // A FunctionInfo object is created for every unique set of feeds/fetches.
@@ -220,6 +227,10 @@ class DirectSession : public Session {
     std::unique_ptr<Graph> graph;
     const DebugOptions& debug_options;
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
+
+    // The number of Send/Recv pairs between the partitions, which the
+    // rendezvous of each step matches by slot.
+    int64 num_rendezvous_slots = 0;
   };
 
   // Retrieves an already existing set of executors to run 'inputs' and
@@ -245,7 +256,8 @@ class DirectSession : public Session {
       std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
       std::unique_ptr<FunctionLibraryDefinition>* flib_def,
       RunStateArgs* run_state_args, DataTypeVector* input_types,
-      DataTypeVector* output_types, int64* collective_graph_key);
+      DataTypeVector* output_types, int64* collective_graph_key,
+      int64* num_rendezvous_slots);
 
   ::tensorflow::Status RunInternal(
       int64 step_id, const RunOptions& run_options,
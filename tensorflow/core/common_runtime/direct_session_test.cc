@@ -662,6 +662,52 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithOpts_Callable) {
   EXPECT_EQ(run_metadata.step_stats().dev_stats_size(), 2);
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_StaticMemoryPlan) {
+  Initialize({3, 2, -1, 0});
+  auto session = CreateSession();
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  Session::CallableHandle handle;
+  CallableOptions callable_options =
+      MakeCallableOptions({}, {y_ + ":0"}, {y_neg_});
+  callable_options.set_use_static_memory_plan(true);
+  callable_options.mutable_run_options()->set_trace_level(
+      RunOptions::FULL_TRACE);
+  TF_ASSERT_OK(session->MakeCallable(callable_options, &handle));
+
+  // The first step warms up, the second one is recorded, and the following
+  // ones use the plan.
+  for (int i = 0; i < 3; ++i) {
+    RunMetadata run_metadata;
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->RunCallable(handle, {}, &outputs, &run_metadata));
+    ASSERT_EQ(1, outputs.size());
+    auto mat = outputs[0].matrix<float>();
+    EXPECT_FLOAT_EQ(5.0, mat(0, 0));
+    EXPECT_FLOAT_EQ(-3.0, mat(1, 0));
+
+    int64 num_arena_allocations = 0;
+    int64 num_allocations = 0;
+    for (const DeviceStepStats& dev_stats :
+         run_metadata.step_stats().dev_stats()) {
+      num_arena_allocations +=
+          dev_stats.static_memory_plan().num_arena_allocations();
+      num_allocations +=
+          dev_stats.static_memory_plan().num_arena_allocations() +
+          dev_stats.static_memory_plan().num_allocator_allocations();
+    }
+    EXPECT_GT(num_allocations, 0);
+    if (i < 2) {
+      EXPECT_EQ(0, num_arena_allocations);
+    } else {
+      // The negated result is dropped within the step, so it is planned.
+      EXPECT_GT(num_arena_allocations, 0);
+    }
+  }
+  TF_ASSERT_OK(session->ReleaseCallable(handle));
+}
+
 TEST_F(DirectSessionMinusAXTest, UseRunHandlerPool) {
   Initialize({3, 2, -1, 0});
   auto session = CreateSession();
@@ -2505,6 +2551,93 @@ void BM_FeedFetchCallable(int iters, int num_feeds) {
 BENCHMARK(BM_FeedFetch)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
 BENCHMARK(BM_FeedFetchCallable)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
 
+// Returns a session on 'num_devices' CPU devices, running a chain of 'length'
+// Adds of 1 to the float placeholder "x", whose consecutive nodes are placed
+// round-robin on the devices. With more than one device, every link of the
+// chain is a Send/Recv pair between two partitions. Sets '*output' to the
+// name of the output of the chain.
+std::unique_ptr<Session> CreatePartitionedChainSession(int num_devices,
+                                                       int length,
+                                                       string* output) {
+  Graph g(OpRegistry::Global());
+  auto device = [](int i) {
+    return strings::StrCat("/job:localhost/replica:0/task:0/cpu:", i);
+  };
+  Node* x;
+  TF_CHECK_OK(NodeBuilder("x", "Placeholder")
+                  .Attr("shape", TensorShape())
+                  .Attr("dtype", DT_FLOAT)
+                  .Device(device(0))
+                  .Finalize(&g, &x));
+  Tensor one(DT_FLOAT, TensorShape());
+  one.scalar<float>()() = 1;
+  Node* last = x;
+  for (int i = 0; i < length; ++i) {
+    const string d = device((i + 1) % num_devices);
+    Node* c = test::graph::Constant(&g, one);
+    c->set_assigned_device_name(d);
+    last = test::graph::Binary(&g, "Add", last, c);
+    last->set_assigned_device_name(d);
+  }
+  *output = strings::StrCat(last->name(), ":0");
+
+  GraphDef def;
+  g.ToGraphDef(&def);
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = num_devices;
+  // Keep the optimizers from collapsing the chain.
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_disable_meta_optimizer(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(def));
+  return session;
+}
+
+TEST(DirectSessionTest, PartitionedChain) {
+  string output;
+  std::unique_ptr<Session> session =
+      CreatePartitionedChainSession(4, 100, &output);
+  Tensor x(DT_FLOAT, TensorShape());
+  x.scalar<float>()() = 1;
+
+  // Run the graph in 4 threads concurrently, each step with its own
+  // rendezvous.
+  thread::ThreadPool* tp = new thread::ThreadPool(Env::Default(), "test", 4);
+  auto fn = [&session, &x, &output]() {
+    for (int i = 0; i < 50; ++i) {
+      std::vector<Tensor> outputs;
+      TF_ASSERT_OK(session->Run({{"x", x}}, {output}, {}, &outputs));
+      ASSERT_EQ(1, outputs.size());
+      EXPECT_FLOAT_EQ(101, outputs[0].scalar<float>()());
+    }
+  };
+  for (int i = 0; i < 4; ++i) {
+    tp->Schedule(fn);
+  }
+  delete tp;
+}
+
+// Measures the cost of `DirectSession::Run()` on a graph of many small
+// partitions, dominated by the Send/Recv pairs between them.
+void BM_PartitionedChain(int iters, int num_devices) {
+  testing::StopTiming();
+  string output;
+  std::unique_ptr<Session> session =
+      CreatePartitionedChainSession(num_devices, 256, &output);
+  Tensor x(DT_FLOAT, TensorShape());
+  x.scalar<float>()() = 1;
+  std::vector<Tensor> outputs;
+  // Ignore the first run, which partitions the graph.
+  TF_CHECK_OK(session->Run({{"x", x}}, {output}, {}, &outputs));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(session->Run({{"x", x}}, {output}, {}, &outputs));
+  }
+  testing::StopTiming();
+}
+BENCHMARK(BM_PartitionedChain)->Arg(1)->Arg(2)->Arg(8);
+
 }  // namespace
 
 class DirectSessionCollectiveTest : public ::testing::Test {
@@ -0,0 +1,304 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/elementwise_fusion_pass.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/lib/gtl/flatset.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/dump_graph.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kFusedElementwiseOp[] = "_FusedElementwise";
+
+// Bounds the size of the programs evaluated by the fused kernels.
+constexpr int kMaxFusedOps = 32;
+
+bool IsFusibleUnaryOp(const string& op) {
+  static const gtl::FlatSet<string>* const kOps = new gtl::FlatSet<string>({
+      "Abs", "Ceil", "Exp", "Expm1", "Floor", "Inv", "Log", "Log1p", "Neg",
+      "Reciprocal", "Relu", "Relu6", "Rsqrt", "Sigmoid", "Sqrt", "Square",
+      "Tanh",
+  });
+  return kOps->count(op) > 0;
+}
+
+bool IsFusibleBinaryOp(const string& op) {
+  static const gtl::FlatSet<string>* const kOps = new gtl::FlatSet<string>({
+      "Add", "AddV2", "Div", "Maximum", "Minimum", "Mul", "Pow", "RealDiv",
+      "SquaredDifference", "Sub",
+  });
+  return kOps->count(op) > 0;
+}
+
+// Returns true if `n` can be fused, and sets `*op_name` to the name of its
+// computation in the fused kernel and `*dtype` to its type.
+bool IsFusible(const Node* n, string* op_name, DataType* dtype) {
+  if (!n->IsOp() || n->num_outputs() != 1) return false;
+  const string& op = n->type_string();
+  int num_inputs;
+  if (op == "BiasAdd") {
+    // With the NHWC layout, BiasAdd is an Add broadcasting the bias along the
+    // last dimension.
+    string data_format;
+    if (GetNodeAttr(n->attrs(), "data_format", &data_format).ok() &&
+        data_format != "NHWC") {
+      return false;
+    }
+    *op_name = "Add";
+    num_inputs = 2;
+  } else if (IsFusibleUnaryOp(op)) {
+    *op_name = op;
+    num_inputs = 1;
+  } else if (IsFusibleBinaryOp(op)) {
+    *op_name = op;
+    num_inputs = 2;
+  } else {
+    return false;
+  }
+  if (n->num_inputs() != num_inputs) return false;
+  if (!GetNodeAttr(n->attrs(), "T", dtype).ok()) return false;
+  return *dtype == DT_FLOAT || *dtype == DT_DOUBLE;
+}
+
+// A tree of fusible ops. Every member but the root has a single consumer,
+// which is a member.
+struct Cluster {
+  Node* root = nullptr;
+  DataType dtype = DT_INVALID;
+  gtl::FlatSet<Node*> members;
+};
+
+// Builds the inputs and the program of the _FusedElementwise node computing
+// a cluster.
+class ProgramBuilder {
+ public:
+  ProgramBuilder(const Cluster& cluster,
+                 const gtl::FlatMap<Node*, string>& op_names)
+      : cluster_(cluster), op_names_(op_names) {}
+
+  Status Build() {
+    TF_RETURN_IF_ERROR(Emit(cluster_.root));
+    // Ops were numbered as -2 - index, before the number of inputs was
+    // known.
+    const int num_args = args_.size();
+    for (int& operand : operands_) {
+      if (operand <= -2) operand = num_args - 2 - operand;
+    }
+    return Status::OK();
+  }
+
+  const std::vector<NodeBuilder::NodeOut>& args() const { return args_; }
+  const std::vector<string>& ops() const { return ops_; }
+  const std::vector<int>& operands() const { return operands_; }
+
+ private:
+  // Emits the ops computing `n`, operands first, and records the operand
+  // number of its result in `results_`.
+  Status Emit(Node* n) {
+    std::vector<const Edge*> in_edges;
+    TF_RETURN_IF_ERROR(n->input_edges(&in_edges));
+    int operands[2] = {-1, -1};
+    for (int i = 0; i < in_edges.size(); ++i) {
+      Node* src = in_edges[i]->src();
+      if (cluster_.members.count(src) > 0) {
+        TF_RETURN_IF_ERROR(Emit(src));
+        operands[i] = results_[src];
+      } else {
+        const std::pair<Node*, int> output(src, in_edges[i]->src_output());
+        auto it = arg_indices_.find(output);
+        if (it == arg_indices_.end()) {
+          it = arg_indices_.emplace(output, args_.size()).first;
+          args_.emplace_back(src, output.second);
+        }
+        operands[i] = it->second;
+      }
+    }
+    results_[n] = -2 - static_cast<int>(ops_.size());
+    ops_.push_back(op_names_.at(n));
+    operands_.push_back(operands[0]);
+    operands_.push_back(operands[1]);
+    return Status::OK();
+  }
+
+  const Cluster& cluster_;
+  const gtl::FlatMap<Node*, string>& op_names_;
+
+  std::vector<NodeBuilder::NodeOut> args_;
+  std::map<std::pair<Node*, int>, int> arg_indices_;
+  gtl::FlatMap<Node*, int> results_;
+  std::vector<string> ops_;
+  std::vector<int> operands_;
+};
+
+// Replaces the members of `cluster` with a _FusedElementwise node.
+Status FuseCluster(Graph* graph, const Cluster& cluster,
+                   const gtl::FlatMap<Node*, string>& op_names) {
+  ProgramBuilder program(cluster, op_names);
+  TF_RETURN_IF_ERROR(program.Build());
+
+  Node* root = cluster.root;
+  std::vector<std::pair<Node*, int>> outputs;
+  std::vector<Node*> control_outputs;
+  for (const Edge* e : root->out_edges()) {
+    if (e->IsControlEdge()) {
+      control_outputs.push_back(e->dst());
+    } else {
+      outputs.emplace_back(e->dst(), e->dst_input());
+    }
+  }
+  gtl::FlatSet<Node*> control_inputs;
+  for (Node* member : cluster.members) {
+    for (const Edge* e : member->in_edges()) {
+      if (e->IsControlEdge() && cluster.members.count(e->src()) == 0) {
+        control_inputs.insert(e->src());
+      }
+    }
+  }
+
+  // The fused node takes over the name of the root, so that it can be found
+  // in the step stats and the cost model.
+  NodeDebugInfo debug_info(*root);
+  const string name = root->name();
+  const string requested_device = root->requested_device();
+  const string assigned_device = root->assigned_device_name();
+  for (Node* member : cluster.members) {
+    graph->RemoveNode(member);
+  }
+
+  Node* fused;
+  TF_RETURN_IF_ERROR(
+      NodeBuilder(name, kFusedElementwiseOp, OpRegistry::Global(), &debug_info)
+          .Input(program.args())
+          .Attr("T", cluster.dtype)
+          .Attr("op_names", program.ops())
+          .Attr("operands", program.operands())
+          .Device(requested_device)
+          .AssignedDevice(assigned_device)
+          .Finalize(graph, &fused));
+  for (Node* src : control_inputs) {
+    graph->AddControlEdge(src, fused);
+  }
+  for (const auto& output : outputs) {
+    graph->AddEdge(fused, 0, output.first, output.second);
+  }
+  for (Node* dst : control_outputs) {
+    graph->AddControlEdge(fused, dst);
+  }
+  VLOG(2) << "Fused " << cluster.members.size() << " elementwise ops into "
+          << fused->DebugString();
+  return Status::OK();
+}
+
+}  // namespace
+
+Status FuseElementwiseOps(Graph* graph, int* num_fused) {
+  *num_fused = 0;
+  gtl::FlatMap<Node*, string> op_names;
+  gtl::FlatMap<Node*, DataType> dtypes;
+  for (Node* n : graph->op_nodes()) {
+    string op_name;
+    DataType dtype;
+    if (IsFusible(n, &op_name, &dtype)) {
+      op_names[n] = std::move(op_name);
+      dtypes[n] = dtype;
+    }
+  }
+
+  // Grow clusters from the consumers to the producers, so that every cluster
+  // is rooted at the last op of a chain.
+  std::vector<Node*> order;
+  GetPostOrder(*graph, &order);
+  gtl::FlatSet<Node*> clustered;
+  std::vector<Cluster> clusters;
+  for (Node* n : order) {
+    if (op_names.count(n) == 0 || clustered.count(n) > 0) continue;
+    Cluster cluster;
+    cluster.root = n;
+    cluster.dtype = dtypes[n];
+    cluster.members.insert(n);
+    std::vector<Node*> stack = {n};
+    while (!stack.empty() && cluster.members.size() < kMaxFusedOps) {
+      Node* member = stack.back();
+      stack.pop_back();
+      for (const Edge* e : member->in_edges()) {
+        Node* src = e->src();
+        if (e->IsControlEdge() || op_names.count(src) == 0 ||
+            clustered.count(src) > 0 || cluster.members.count(src) > 0 ||
+            dtypes[src] != cluster.dtype || src->out_edges().size() != 1 ||
+            cluster.members.size() >= kMaxFusedOps) {
+          continue;
+        }
+        cluster.members.insert(src);
+        stack.push_back(src);
+      }
+    }
+    clustered.insert(cluster.members.begin(), cluster.members.end());
+    if (cluster.members.size() > 1) {
+      clusters.push_back(std::move(cluster));
+    }
+  }
+
+  for (const Cluster& cluster : clusters) {
+    TF_RETURN_IF_ERROR(FuseCluster(graph, cluster, op_names));
+  }
+  *num_fused = clusters.size();
+  return Status::OK();
+}
+
+Status ElementwiseFusionPass::Run(const GraphOptimizationPassOptions& options) {
+  if (options.session_options == nullptr ||
+      !options.session_options->config.experimental()
+           .enable_elementwise_fusion() ||
+      options.partition_graphs == nullptr) {
+    return Status::OK();
+  }
+
+  for (auto& partition : *options.partition_graphs) {
+    DeviceNameUtils::ParsedName device;
+    if (!DeviceNameUtils::ParseFullName(partition.first, &device) ||
+        device.type != DEVICE_CPU) {
+      continue;
+    }
+    Graph* graph = partition.second.get();
+    if (VLOG_IS_ON(3)) {
+      DumpGraphToFile("elementwise_fusion_before", *graph);
+    }
+    int num_fused;
+    TF_RETURN_IF_ERROR(FuseElementwiseOps(graph, &num_fused));
+    VLOG(1) << "Created " << num_fused << " fused elementwise ops on "
+            << partition.first;
+    if (VLOG_IS_ON(3)) {
+      DumpGraphToFile("elementwise_fusion_after", *graph);
+    }
+  }
+  return Status::OK();
+}
+
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::POST_PARTITIONING, 0,
+                      ElementwiseFusionPass);
+
+}  // namespace tensorflow
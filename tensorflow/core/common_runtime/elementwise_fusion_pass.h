@@ -0,0 +1,43 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_ELEMENTWISE_FUSION_PASS_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_ELEMENTWISE_FUSION_PASS_H_
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+// Replaces trees of unary and binary elementwise ops (e.g. Mul, Add, Relu,
+// Tanh), in which every intermediate result has a single consumer, with a
+// single _FusedElementwise node. The fused kernel evaluates the whole tree in
+// cache-sized tiles, so the intermediate results are never materialized.
+//
+// The pass runs after partitioning on the partitions of CPU devices, and only
+// if ConfigProto.Experimental.enable_elementwise_fusion is set.
+class ElementwiseFusionPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override;
+};
+
+// Fuses the elementwise ops of `graph`, which must be placed on a CPU device.
+// Sets `*num_fused` to the number of _FusedElementwise nodes created.
+Status FuseElementwiseOps(Graph* graph, int* num_fused);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_ELEMENTWISE_FUSION_PASS_H_
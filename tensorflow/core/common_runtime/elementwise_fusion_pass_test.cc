@@ -0,0 +1,184 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/elementwise_fusion_pass.h"
+
+#include <cmath>
+
+#include "tensorflow/cc/client/client_session.h"
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kCpuDevice[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+SessionOptions SessionOptionsWithFusion() {
+  SessionOptions session_options;
+  session_options.config.mutable_experimental()->set_enable_elementwise_fusion(
+      true);
+  return session_options;
+}
+
+Status Rewrite(const string& device, std::unique_ptr<Graph>* graph) {
+  std::unordered_map<string, std::unique_ptr<Graph>> partition_graphs;
+  partition_graphs[device] = std::move(*graph);
+  SessionOptions session_options = SessionOptionsWithFusion();
+  GraphOptimizationPassOptions opt_options;
+  opt_options.session_options = &session_options;
+  opt_options.partition_graphs = &partition_graphs;
+  ElementwiseFusionPass pass;
+  Status s = pass.Run(opt_options);
+  *graph = std::move(partition_graphs[device]);
+  return s;
+}
+
+std::vector<Node*> NodesOfType(const Graph& graph, const string& type) {
+  std::vector<Node*> nodes;
+  for (Node* n : graph.op_nodes()) {
+    if (n->type_string() == type) nodes.push_back(n);
+  }
+  return nodes;
+}
+
+TEST(ElementwiseFusionPassTest, FusesChain) {
+  Scope root = Scope::NewRootScope().ExitOnError().WithDevice(kCpuDevice);
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_FLOAT);
+  auto scale = ops::Placeholder(root.WithOpName("scale"), DT_FLOAT);
+  auto bias = ops::Placeholder(root.WithOpName("bias"), DT_FLOAT);
+  auto mul = ops::Mul(root.WithOpName("mul"), x, scale);
+  auto add = ops::BiasAdd(root.WithOpName("add"), mul, bias);
+  auto relu = ops::Relu(root.WithOpName("relu"), add);
+  ops::Identity(root.WithOpName("out"), relu);
+
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  TF_ASSERT_OK(root.ToGraph(graph.get()));
+  TF_ASSERT_OK(Rewrite(kCpuDevice, &graph));
+
+  EXPECT_TRUE(NodesOfType(*graph, "Mul").empty());
+  EXPECT_TRUE(NodesOfType(*graph, "BiasAdd").empty());
+  EXPECT_TRUE(NodesOfType(*graph, "Relu").empty());
+  std::vector<Node*> fused = NodesOfType(*graph, "_FusedElementwise");
+  ASSERT_EQ(1, fused.size());
+  EXPECT_EQ("relu", fused[0]->name());
+  EXPECT_EQ(kCpuDevice, fused[0]->assigned_device_name());
+
+  std::vector<string> op_names;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->attrs(), "op_names", &op_names));
+  EXPECT_EQ(std::vector<string>({"Mul", "Add", "Relu"}), op_names);
+  std::vector<int> operands;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->attrs(), "operands", &operands));
+  EXPECT_EQ(std::vector<int>({0, 1, 3, 2, 4, -1}), operands);
+
+  std::vector<const Edge*> inputs;
+  TF_ASSERT_OK(fused[0]->input_edges(&inputs));
+  ASSERT_EQ(3, inputs.size());
+  EXPECT_EQ("x", inputs[0]->src()->name());
+  EXPECT_EQ("scale", inputs[1]->src()->name());
+  EXPECT_EQ("bias", inputs[2]->src()->name());
+
+  std::vector<Node*> identities = NodesOfType(*graph, "Identity");
+  ASSERT_EQ(1, identities.size());
+  const Edge* out_edge;
+  TF_ASSERT_OK(identities[0]->input_edge(0, &out_edge));
+  EXPECT_EQ(fused[0], out_edge->src());
+}
+
+TEST(ElementwiseFusionPassTest, KeepsIntermediatesWithSeveralConsumers) {
+  Scope root = Scope::NewRootScope().ExitOnError().WithDevice(kCpuDevice);
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_FLOAT);
+  auto y = ops::Placeholder(root.WithOpName("y"), DT_FLOAT);
+  // `sum` is used by both the Tanh and the Sigmoid, and is not fused.
+  auto sum = ops::Add(root.WithOpName("sum"), x, y);
+  auto tanh = ops::Tanh(root.WithOpName("tanh"), sum);
+  auto sigmoid = ops::Sigmoid(root.WithOpName("sigmoid"), sum);
+  auto mul = ops::Mul(root.WithOpName("mul"), tanh, sigmoid);
+  ops::Identity(root.WithOpName("out"), mul);
+
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  TF_ASSERT_OK(root.ToGraph(graph.get()));
+  TF_ASSERT_OK(Rewrite(kCpuDevice, &graph));
+
+  ASSERT_EQ(1, NodesOfType(*graph, "Add").size());
+  std::vector<Node*> fused = NodesOfType(*graph, "_FusedElementwise");
+  ASSERT_EQ(1, fused.size());
+  std::vector<string> op_names;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->attrs(), "op_names", &op_names));
+  EXPECT_EQ(std::vector<string>({"Tanh", "Sigmoid", "Mul"}), op_names);
+  // `sum` is the single input of the fused node.
+  std::vector<int> operands;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->attrs(), "operands", &operands));
+  EXPECT_EQ(std::vector<int>({0, -1, 0, -1, 1, 2}), operands);
+}
+
+TEST(ElementwiseFusionPassTest, IgnoresNonCpuDevices) {
+  const string gpu_device = "/job:localhost/replica:0/task:0/device:GPU:0";
+  Scope root = Scope::NewRootScope().ExitOnError().WithDevice(gpu_device);
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_FLOAT);
+  auto neg = ops::Neg(root.WithOpName("neg"), x);
+  ops::Exp(root.WithOpName("exp"), neg);
+
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  TF_ASSERT_OK(root.ToGraph(graph.get()));
+  TF_ASSERT_OK(Rewrite(gpu_device, &graph));
+  EXPECT_TRUE(NodesOfType(*graph, "_FusedElementwise").empty());
+}
+
+TEST(ElementwiseFusionPassTest, IgnoresUnsupportedTypes) {
+  Scope root = Scope::NewRootScope().ExitOnError().WithDevice(kCpuDevice);
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_INT32);
+  auto neg = ops::Neg(root.WithOpName("neg"), x);
+  ops::Abs(root.WithOpName("abs"), neg);
+
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  TF_ASSERT_OK(root.ToGraph(graph.get()));
+  TF_ASSERT_OK(Rewrite(kCpuDevice, &graph));
+  EXPECT_TRUE(NodesOfType(*graph, "_FusedElementwise").empty());
+}
+
+TEST(ElementwiseFusionPassTest, ComputesSameResult) {
+  Scope root = Scope::NewRootScope().ExitOnError();
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_FLOAT);
+  auto mean = ops::Placeholder(root.WithOpName("mean"), DT_FLOAT);
+  auto gamma = ops::Placeholder(root.WithOpName("gamma"), DT_FLOAT);
+  auto centered = ops::Sub(root.WithOpName("centered"), x, mean);
+  auto scaled = ops::Mul(root.WithOpName("scaled"), centered, gamma);
+  auto y = ops::Tanh(root.WithOpName("y"), scaled);
+
+  ClientSession session(root, SessionOptionsWithFusion());
+  ClientSession::FeedType feeds;
+  feeds.emplace(x,
+                Input::Initializer({{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}}));
+  feeds.emplace(mean, Input::Initializer({{2.0f}, {5.0f}}));
+  feeds.emplace(gamma, Input::Initializer({0.5f, 1.0f, 2.0f}));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session.Run(feeds, {y}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+
+  Tensor expected(DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected,
+                          {std::tanh(-0.5f), 0.0f, std::tanh(2.0f),
+                           std::tanh(-0.5f), 0.0f, std::tanh(2.0f)});
+  test::ExpectTensorNear<float>(expected, outputs[0], 1e-6);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/executor.h"
 
+#include <algorithm>
 #include <atomic>
 #include <deque>
 #include <memory>
@@ -28,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/pending_counts.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -150,6 +152,21 @@ struct KernelTimer {
   }
 };
 
+// Constants used by the cost-aware scheduling mode (executor type
+// "COST_AWARE"), which orders ready nodes by their estimated distance to the
+// end of the graph and groups inexpensive nodes into a single closure.
+//
+// Cost (in CPU cycles) assumed for a node that has not been measured yet.
+static constexpr uint64 kCostAwareInitialNodeCycles = 1000;
+// Inexpensive ready nodes are grouped into closures of roughly this many
+// cycles, so that the overhead of dispatching a closure to the inter-op
+// threadpool is amortized over several kernels.
+static constexpr uint64 kCostAwareBatchCycles = 50 * 1000;
+// Node priorities are recomputed from the measured costs before steps
+// 2, 4, 8, ..., kCostAwareRefreshSteps, and every kCostAwareRefreshSteps
+// steps thereafter.
+static constexpr int64 kCostAwareRefreshSteps = 1024;
+
 struct NodeItem {
   NodeItem() {}
 
@@ -293,8 +310,12 @@ class GraphView {
 
 class ExecutorImpl : public Executor {
  public:
-  ExecutorImpl(const LocalExecutorParams& p, std::unique_ptr<const Graph> g)
-      : params_(p), graph_(std::move(g)), gview_() {
+  ExecutorImpl(const LocalExecutorParams& p, std::unique_ptr<const Graph> g,
+               bool cost_aware_scheduling = false)
+      : params_(p),
+        graph_(std::move(g)),
+        gview_(),
+        cost_aware_scheduling_(cost_aware_scheduling) {
     CHECK(p.create_kernel != nullptr);
     CHECK(p.delete_kernel != nullptr);
   }
@@ -370,6 +391,39 @@ class ExecutorImpl : public Executor {
     return *slot;
   }
 
+  // Cost-aware scheduling support. The methods below must only be called
+  // when `cost_aware_scheduling_` is true.
+
+  // Computes a topological order of the graph that ignores the back edges
+  // out of NextIteration nodes, and resets all the node costs and priorities.
+  void InitializeCostAwareScheduling();
+
+  // Recomputes the node priorities from the measured costs if the step that
+  // is about to start is a refresh step.
+  void MaybeUpdateNodePriorities();
+
+  // Sets the priority of every node to the estimated cost (in cycles) of the
+  // longest path from that node to the end of the graph, node included.
+  void UpdateNodePriorities() LOCKS_EXCLUDED(priority_mu_);
+
+  // Folds a measured execution time into the cost estimate of node `id`.
+  void RecordNodeCost(int id, uint64 elapsed_cycles) const {
+    std::atomic<uint64>* cost = &node_cost_cycles_[id];
+    // As with OpKernel::UpdateCostEstimate, concurrent updates may drop a
+    // sample, which only slows down convergence.
+    cost->store((OpKernel::kCostDecay - 1) *
+                        cost->load(std::memory_order_relaxed) /
+                        OpKernel::kCostDecay +
+                    elapsed_cycles / OpKernel::kCostDecay,
+                std::memory_order_relaxed);
+  }
+  uint64 NodeCost(int id) const {
+    return node_cost_cycles_[id].load(std::memory_order_relaxed);
+  }
+  uint64 NodePriority(int id) const {
+    return node_priority_[id].load(std::memory_order_relaxed);
+  }
+
   // Owned.
   LocalExecutorParams params_;
   std::unique_ptr<const Graph> graph_;
@@ -381,11 +435,42 @@ class ExecutorImpl : public Executor {
   // Root nodes (with no in edges) that should form the initial ready queue
   std::vector<const Node*> root_nodes_;
 
+  // True iff the graph has control flow nodes, or other nodes that may produce
+  // dead tensors. Without them, a step is a single iteration of the root frame
+  // and ExecutorState updates pending counts with atomic decrements instead of
+  // under the frame lock. See ExecutorState::ActivateNodesLockFree().
+  bool requires_control_flow_ = false;
+
+  // Indexed by node id. The initial pending count of each node, only set when
+  // `requires_control_flow_` is false.
+  std::vector<int32> initial_pending_counts_;
+
   // Mapping from frame name to static information about the frame.
   // TODO(yuanbyu): We could cache it along with the graph so to avoid
   // the overhead of constructing it for each executor instance.
   gtl::FlatMap<string, FrameInfo*> frame_info_;
 
+  // If true, ready nodes are scheduled by priority and inexpensive nodes are
+  // dispatched in batches. See ExecutorState::ScheduleReadyCostAware().
+  const bool cost_aware_scheduling_;
+
+  // The remaining fields are only used for cost-aware scheduling.
+
+  // Node ids in topological order, ignoring NextIteration back edges.
+  std::vector<int> topo_order_;
+
+  // Indexed by node id. The measured cost of each node, in CPU cycles, and the
+  // estimated cost of the longest path from each node to the end of the graph.
+  // Both are read on the scheduling hot path without synchronization.
+  std::unique_ptr<std::atomic<uint64>[]> node_cost_cycles_;
+  std::unique_ptr<std::atomic<uint64>[]> node_priority_;
+
+  // Number of steps started on this executor.
+  std::atomic<int64> num_steps_started_{0};
+
+  // Serializes UpdateNodePriorities().
+  mutex priority_mu_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
 
@@ -659,6 +744,9 @@ Status ExecutorImpl::Initialize() {
     item->is_sink = IsSink(n);
     item->is_enter_exit_or_next_iter =
         (IsEnter(n) || IsExit(n) || IsNextIteration(n));
+    if (IsControlFlow(n) || IsControlTrigger(n) || IsRecv(n)) {
+      requires_control_flow_ = true;
+    }
 
     // Compute the maximum values we'll store for this node in the
     // pending counts data structure, and allocate a handle in
@@ -682,9 +770,85 @@ Status ExecutorImpl::Initialize() {
   // all nodes.
   InitializePending(graph_.get(), cf_info);
 
+  if (!requires_control_flow_) {
+    initial_pending_counts_.resize(graph_->num_node_ids(), 0);
+    for (const Node* n : graph_->nodes()) {
+      size_t max_pending, max_dead;
+      GetMaxPendingCounts(n, &max_pending, &max_dead);
+      initial_pending_counts_[n->id()] = max_pending;
+    }
+  }
+
+  if (cost_aware_scheduling_) {
+    InitializeCostAwareScheduling();
+  }
+
   return gview_.SetAllocAttrs(graph_.get(), params_.device);
 }
 
+void ExecutorImpl::InitializeCostAwareScheduling() {
+  const int num_node_ids = graph_->num_node_ids();
+  node_cost_cycles_.reset(new std::atomic<uint64>[num_node_ids]);
+  node_priority_.reset(new std::atomic<uint64>[num_node_ids]);
+  for (int i = 0; i < num_node_ids; ++i) {
+    node_cost_cycles_[i].store(kCostAwareInitialNodeCycles,
+                               std::memory_order_relaxed);
+    node_priority_[i].store(0, std::memory_order_relaxed);
+  }
+
+  // Kahn's algorithm. The edges out of NextIteration nodes are the only
+  // cycles in a valid graph, so dropping them yields a DAG.
+  std::vector<int> pending(num_node_ids, 0);
+  for (const Edge* e : graph_->edges()) {
+    if (!IsNextIteration(e->src())) {
+      ++pending[e->dst()->id()];
+    }
+  }
+  topo_order_.clear();
+  topo_order_.reserve(graph_->num_nodes());
+  for (const Node* n : graph_->nodes()) {
+    if (pending[n->id()] == 0) {
+      topo_order_.push_back(n->id());
+    }
+  }
+  for (size_t i = 0; i < topo_order_.size(); ++i) {
+    const Node* n = graph_->FindNodeId(topo_order_[i]);
+    if (IsNextIteration(n)) continue;
+    for (const Edge* e : n->out_edges()) {
+      if (--pending[e->dst()->id()] == 0) {
+        topo_order_.push_back(e->dst()->id());
+      }
+    }
+  }
+  UpdateNodePriorities();
+}
+
+void ExecutorImpl::MaybeUpdateNodePriorities() {
+  const int64 step = num_steps_started_.fetch_add(1) + 1;
+  const bool is_refresh_step = step <= kCostAwareRefreshSteps
+                                   ? step > 1 && (step & (step - 1)) == 0
+                                   : step % kCostAwareRefreshSteps == 0;
+  if (is_refresh_step) {
+    UpdateNodePriorities();
+  }
+}
+
+void ExecutorImpl::UpdateNodePriorities() {
+  mutex_lock l(priority_mu_);
+  for (auto it = topo_order_.rbegin(); it != topo_order_.rend(); ++it) {
+    const Node* n = graph_->FindNodeId(*it);
+    uint64 longest_successor_path = 0;
+    if (!IsNextIteration(n)) {
+      for (const Edge* e : n->out_edges()) {
+        longest_successor_path =
+            std::max(longest_successor_path, NodePriority(e->dst()->id()));
+      }
+    }
+    node_priority_[*it].store(NodeCost(*it) + longest_successor_path,
+                              std::memory_order_relaxed);
+  }
+}
+
 // If a Node has been marked to use a ScopedAllocator x for output i, then
 // sc_attr will contain the subsequence (i, x) at an even offset.  This function
 // extracts and transfers that ScopedAllocator id to alloc_attr.  For now, we
@@ -1213,6 +1377,13 @@ class ExecutorState {
     TaggedNodeReadyQueue() : front_index_(0) {}
 
     void push_back(TaggedNode node) { ready_.push_back(node); }
+    void push_front(TaggedNode node) {
+      if (front_index_ > 0) {
+        ready_[--front_index_] = node;
+      } else {
+        ready_.insert(ready_.begin(), node);
+      }
+    }
     TaggedNode front() const {
       DCHECK_LT(front_index_, ready_.size());
       return ready_[front_index_];
@@ -1232,6 +1403,10 @@ class ExecutorState {
       }
     }
     bool empty() const { return ready_.empty(); }
+    void clear() {
+      ready_.clear();
+      front_index_ = 0;
+    }
     const TaggedNode* begin() const { return ready_.begin() + front_index_; }
     const TaggedNode* end() const { return ready_.end(); }
 
@@ -1258,6 +1433,7 @@ class ExecutorState {
   TensorStore* tensor_store_;
   // Step-local container.
   ScopedStepContainer* step_container_;
+  StaticMemoryPlan* const static_memory_plan_;
   StepStatsCollectorInterface* const stats_collector_;
   const tracing::EventCollector* const event_collector_;
   Context context_;
@@ -1282,6 +1458,11 @@ class ExecutorState {
   // The root frame in which the execution of this step is started.
   FrameState* root_frame_;
 
+  // Indexed by node id. The pending counts of the nodes of the root frame,
+  // when the graph doesn't require control flow support. They replace the
+  // PendingCounts of the root frame iteration, which are left untouched.
+  std::unique_ptr<std::atomic<int32>[]> atomic_pending_counts_;
+
   // Invoked when the execution finishes.
   Executor::DoneCallback done_cb_;
 
@@ -1324,6 +1505,14 @@ class ExecutorState {
   // Process a ready node in current thread.
   void Process(TaggedNode node, int64 scheduled_nsec);
 
+  // Process a batch of ready nodes in current thread, in order.
+  void ProcessBatch(const TaggedNodeSeq& batch, int64 scheduled_nsec);
+
+  // Process the nodes in 'inline_ready', and any inexpensive nodes they make
+  // ready, in current thread.
+  void ProcessReadyQueue(TaggedNodeReadyQueue* inline_ready,
+                         int64 scheduled_nsec);
+
   // Before invoking item->kernel, fills in its "inputs".
   Status PrepareInputs(const NodeItem& item, Entry* first_input,
                        TensorValueVec* inputs,
@@ -1341,6 +1530,13 @@ class ExecutorState {
   void PropagateOutputs(const TaggedNode& tagged_node, const NodeItem* item,
                         EntryVector* outputs, TaggedNodeSeq* ready);
 
+  // Activates the successors of a node in a graph that doesn't require
+  // control flow support, with atomic pending count updates. Contents of
+  // *outputs are left in an indeterminate state after returning from this
+  // method.
+  void ActivateNodesLockFree(const NodeItem* item, EntryVector* outputs,
+                             TaggedNodeSeq* ready);
+
   // "node" just finishes. Takes ownership of "stats". Returns true if
   // execution has completed.
   bool NodeDone(const Status& s, const Node* node, const TaggedNodeSeq& ready,
@@ -1352,6 +1548,15 @@ class ExecutorState {
   void ScheduleReady(const TaggedNodeSeq& ready,
                      TaggedNodeReadyQueue* inline_ready);
 
+  // Implementation of ScheduleReady() for cost-aware scheduling. The node in
+  // 'ready' with the highest priority is moved to the front of 'inline_ready'
+  // (if not null), expensive nodes are dispatched one per closure, and the
+  // remaining inexpensive nodes are dispatched in batches of roughly
+  // kCostAwareBatchCycles.
+  void ScheduleReadyCostAware(const TaggedNodeSeq& ready,
+                              TaggedNodeReadyQueue* inline_ready,
+                              int64 scheduled_nsec);
+
   // For debugging/logging only.
   inline void MaybeMarkCompleted(FrameState* frame, int64 iter, int64 id);
 
@@ -1394,6 +1599,7 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
       session_metadata_(impl->params_.session_metadata),
       tensor_store_(args.tensor_store),
       step_container_(args.step_container),
+      static_memory_plan_(args.static_memory_plan),
       stats_collector_(args.stats_collector),
       event_collector_(
           tracing::GetEventCollector(tracing::EventCategory::kCompute)),
@@ -1424,6 +1630,15 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
       root_frame_->pending_counts, root_frame_->total_input_tensors);
 
   outstanding_frames_.insert({root_frame_->frame_name, root_frame_});
+
+  if (!impl_->requires_control_flow_) {
+    const std::vector<int32>& initial_counts = impl_->initial_pending_counts_;
+    atomic_pending_counts_.reset(new std::atomic<int32>[initial_counts.size()]);
+    for (size_t i = 0; i < initial_counts.size(); ++i) {
+      atomic_pending_counts_[i].store(initial_counts[i],
+                                      std::memory_order_relaxed);
+    }
+  }
 }
 
 ExecutorState::~ExecutorState() {
@@ -1617,10 +1832,26 @@ bool MightTrace(const NodeItem& item,
 }
 
 void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
+  TaggedNodeReadyQueue inline_ready;
+  inline_ready.push_back(tagged_node);
+  ProcessReadyQueue(&inline_ready, scheduled_nsec);
+}
+
+void ExecutorState::ProcessBatch(const TaggedNodeSeq& batch,
+                                 int64 scheduled_nsec) {
+  TaggedNodeReadyQueue inline_ready;
+  for (const TaggedNode& tagged_node : batch) {
+    inline_ready.push_back(tagged_node);
+  }
+  ProcessReadyQueue(&inline_ready, scheduled_nsec);
+}
+
+void ExecutorState::ProcessReadyQueue(TaggedNodeReadyQueue* inline_ready_queue,
+                                      int64 scheduled_nsec) {
   WithContext wc(context_);
   const GraphView& gview = impl_->gview_;
   TaggedNodeSeq ready;
-  TaggedNodeReadyQueue inline_ready;
+  TaggedNodeReadyQueue& inline_ready = *inline_ready_queue;
 
   // Parameters passed to OpKernel::Compute.
   TensorValueVec inputs;
@@ -1680,9 +1911,8 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
 
   EntryVector outputs;
   bool completed = false;
-  inline_ready.push_back(tagged_node);
   while (!inline_ready.empty()) {
-    tagged_node = inline_ready.front();
+    const TaggedNode tagged_node = inline_ready.front();
     inline_ready.pop_front();
     const Node* node = tagged_node.node;
     FrameState* input_frame = tagged_node.input_frame;
@@ -1692,7 +1922,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
 
     // TODO(misard) Replace with a finer-grain enabling flag once we
     // add better optional debugging support.
-    if (vlog_ && VLOG_IS_ON(1)) {
+    if (vlog_ && VLOG_IS_ON(1) && impl_->requires_control_flow_) {
       mutex_lock l(input_frame->mu);
       input_frame->GetIteration(input_iter)->mark_started(item.pending_id);
     }
@@ -1751,6 +1981,9 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
       // Set up compute params.
       OpKernel* op_kernel = item.kernel;
       params.op_kernel = op_kernel;
+      if (static_memory_plan_ != nullptr) {
+        params.node_allocator = static_memory_plan_->NodeAllocator(id);
+      }
       params.frame_iter = FrameAndIter(input_frame->frame_id, input_iter);
       params.is_input_dead = is_input_dead;
       params.output_attr_array = item.output_attrs();
@@ -1846,7 +2079,15 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
           if (op_kernel->IsExpensive()) {
             KernelTimer timer;
             device->Compute(op_kernel, &ctx);
-            op_kernel->UpdateCostEstimate(timer.ElapsedCycles());
+            const uint64 elapsed_cycles = timer.ElapsedCycles();
+            op_kernel->UpdateCostEstimate(elapsed_cycles);
+            if (impl_->cost_aware_scheduling_) {
+              impl_->RecordNodeCost(id, elapsed_cycles);
+            }
+          } else if (impl_->cost_aware_scheduling_) {
+            KernelTimer timer;
+            device->Compute(op_kernel, &ctx);
+            impl_->RecordNodeCost(id, timer.ElapsedCycles());
           } else {
             device->Compute(op_kernel, &ctx);
           }
@@ -2121,6 +2362,16 @@ void ExecutorState::PropagateOutputs(const TaggedNode& tagged_node,
   FrameState* output_frame = input_frame;
   int64 output_iter = input_iter;
 
+  if (!impl_->requires_control_flow_) {
+    // Fast path for graphs without control flow: everything runs in iteration
+    // 0 of the root frame, which lives as long as the step, so there is no
+    // frame state to update under the lock.
+    DCHECK_EQ(input_frame, root_frame_);
+    DCHECK(!is_dead);
+    ActivateNodesLockFree(item, outputs, ready);
+    return;
+  }
+
   if (!item->is_enter_exit_or_next_iter) {
     // Fast path for nodes types that don't need special handling
     DCHECK_EQ(input_frame, output_frame);
@@ -2284,6 +2535,11 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
     scheduled_nsec = nodestats::NowInNsec();
   }
 
+  if (impl_->cost_aware_scheduling_) {
+    ScheduleReadyCostAware(ready, inline_ready, scheduled_nsec);
+    return;
+  }
+
   if (inline_ready == nullptr) {
     // Schedule to run all the ready ops in thread pool.
     for (auto& tagged_node : ready) {
@@ -2322,11 +2578,90 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
   }
 }
 
+void ExecutorState::ScheduleReadyCostAware(const TaggedNodeSeq& ready,
+                                           TaggedNodeReadyQueue* inline_ready,
+                                           int64 scheduled_nsec) {
+  // Snapshot the priorities before sorting, since they may be concurrently
+  // updated by ExecutorImpl::UpdateNodePriorities().
+  gtl::InlinedVector<std::pair<uint64, int>, 8> order;
+  order.reserve(ready.size());
+  for (int i = 0; i < ready.size(); ++i) {
+    order.emplace_back(impl_->NodePriority(ready[i].node->id()), i);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const std::pair<uint64, int>& a,
+                      const std::pair<uint64, int>& b) {
+                     return a.first > b.first;
+                   });
+
+  const GraphView& gview = impl_->gview_;
+  auto is_expensive = [&gview](const TaggedNode& tagged_node) {
+    return !tagged_node.is_dead &&
+           gview.node(tagged_node.node->id())->kernel->IsExpensive();
+  };
+  TaggedNodeSeq batch;
+  uint64 batch_cycles = 0;
+  auto dispatch_batch = [this, &batch, &batch_cycles, scheduled_nsec]() {
+    if (batch.size() == 1) {
+      runner_(std::bind(&ExecutorState::Process, this, batch[0],
+                        scheduled_nsec));
+    } else {
+      runner_([this, batch, scheduled_nsec]() {
+        ProcessBatch(batch, scheduled_nsec);
+      });
+    }
+    batch.clear();
+    batch_cycles = 0;
+  };
+
+  size_t begin = 0;
+  if (inline_ready != nullptr) {
+    // The node with the highest priority is (as far as we know) on the
+    // critical path, so it runs next on this thread. If it is expensive, the
+    // inexpensive nodes already queued behind it are handed to another thread
+    // instead of waiting for it.
+    const TaggedNode& critical_node = ready[order[0].second];
+    if (is_expensive(critical_node) && !inline_ready->empty()) {
+      for (const TaggedNode& tagged_node : *inline_ready) {
+        batch.push_back(tagged_node);
+      }
+      inline_ready->clear();
+      dispatch_batch();
+    }
+    inline_ready->push_front(critical_node);
+    begin = 1;
+  }
+
+  for (size_t i = begin; i < order.size(); ++i) {
+    const TaggedNode& tagged_node = ready[order[i].second];
+    if (is_expensive(tagged_node)) {
+      runner_(std::bind(&ExecutorState::Process, this, tagged_node,
+                        scheduled_nsec));
+      continue;
+    }
+    batch.push_back(tagged_node);
+    batch_cycles += impl_->NodeCost(tagged_node.node->id());
+    if (batch_cycles >= kCostAwareBatchCycles) {
+      dispatch_batch();
+    }
+  }
+  if (!batch.empty()) {
+    if (inline_ready != nullptr) {
+      // Not enough work to be worth another closure.
+      for (const TaggedNode& tagged_node : batch) {
+        inline_ready->push_back(tagged_node);
+      }
+    } else {
+      dispatch_batch();
+    }
+  }
+}
+
 inline void ExecutorState::MaybeMarkCompleted(FrameState* frame, int64 iter,
                                               int64 node_id) {
   // TODO(misard) Replace with a finer-grain enabling flag once we
   // add better optional debugging support.
-  if (vlog_ && VLOG_IS_ON(1)) {
+  if (vlog_ && VLOG_IS_ON(1) && impl_->requires_control_flow_) {
     const NodeItem* item = impl_->gview_.node(node_id);
     mutex_lock l(frame->mu);
     frame->GetIteration(iter)->mark_completed(item->pending_id);
@@ -2774,6 +3109,38 @@ void ExecutorState::FrameState::ActivateNodes(const NodeItem* item,
   }
 }
 
+void ExecutorState::ActivateNodesLockFree(const NodeItem* item,
+                                          EntryVector* outputs,
+                                          TaggedNodeSeq* ready) {
+  const GraphView& gview = impl_->gview_;
+  const size_t num_output_edges = item->num_output_edges;
+  const EdgeInfo* edges = item->output_edge_list();
+  Entry* input_tensors = GetInputTensors(root_frame_, 0);
+  for (size_t out_index = 0; out_index < num_output_edges; out_index++) {
+    const EdgeInfo& e = edges[out_index];
+    const int dst_id = e.dst_id;
+    const NodeItem* dst_item = gview.node(dst_id);
+    if (dst_item->is_sink) continue;
+
+    const int src_slot = e.output_slot;
+    if (src_slot != Graph::kControlSlot) {
+      const int dst_loc = dst_item->input_start + e.input_slot;
+      if (e.is_last) {
+        input_tensors[dst_loc] = std::move((*outputs)[src_slot]);
+      } else {
+        input_tensors[dst_loc] = (*outputs)[src_slot];
+      }
+    }
+
+    // The input must be written before the count is decremented: the thread
+    // that brings the count to zero goes on to read all the inputs of dst.
+    if (atomic_pending_counts_[dst_id].fetch_sub(
+            1, std::memory_order_acq_rel) == 1) {
+      ready->emplace_back(dst_item->node, root_frame_, 0, false);
+    }
+  }
+}
+
 void ExecutorState::FrameState::ActivateNexts(const GraphView* gview,
                                               int64 iter,
                                               TaggedNodeSeq* ready) {
@@ -2872,15 +3239,21 @@ bool ExecutorState::FrameState::CleanupIterations(const GraphView* gview,
 }
 
 void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
+  if (cost_aware_scheduling_) {
+    MaybeUpdateNodePriorities();
+  }
   (new ExecutorState(args, this))->RunAsync(std::move(done));
 }
 
 }  // namespace
 
-Status NewLocalExecutor(const LocalExecutorParams& params,
-                        std::unique_ptr<const Graph> graph,
-                        Executor** executor) {
-  ExecutorImpl* impl = new ExecutorImpl(params, std::move(graph));
+namespace {
+
+Status NewLocalExecutorImpl(const LocalExecutorParams& params,
+                            std::unique_ptr<const Graph> graph,
+                            bool cost_aware_scheduling, Executor** executor) {
+  ExecutorImpl* impl =
+      new ExecutorImpl(params, std::move(graph), cost_aware_scheduling);
   const Status s = impl->Initialize();
   if (s.ok()) {
     *executor = impl;
@@ -2890,6 +3263,15 @@ Status NewLocalExecutor(const LocalExecutorParams& params,
   return s;
 }
 
+}  // namespace
+
+Status NewLocalExecutor(const LocalExecutorParams& params,
+                        std::unique_ptr<const Graph> graph,
+                        Executor** executor) {
+  return NewLocalExecutorImpl(params, std::move(graph),
+                              /*cost_aware_scheduling=*/false, executor);
+}
+
 Status CreateNonCachedKernel(Device* device, FunctionLibraryRuntime* flib,
                              const NodeDef& ndef, int graph_def_version,
                              OpKernel** kernel) {
@@ -2925,6 +3307,30 @@ class DefaultExecutorRegistrar {
 };
 static DefaultExecutorRegistrar registrar;
 
+// Registers the "COST_AWARE" executor type, which runs the same executor as
+// "DEFAULT" but uses measured per-node costs to prioritize nodes on the
+// critical path and to batch inexpensive nodes into a single closure.
+class CostAwareExecutorRegistrar {
+ public:
+  CostAwareExecutorRegistrar() {
+    ExecutorFactory::Register("COST_AWARE", new Factory);
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params,
+                       std::unique_ptr<const Graph> graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      Executor* ret = nullptr;
+      TF_RETURN_IF_ERROR(NewLocalExecutorImpl(
+          params, std::move(graph), /*cost_aware_scheduling=*/true, &ret));
+      out_executor->reset(ret);
+      return Status::OK();
+    }
+  };
+};
+static CostAwareExecutorRegistrar cost_aware_registrar;
+
 }  // namespace
 
 }  // namespace tensorflow
@@ -31,6 +31,7 @@ limitations under the License.
 
 namespace tensorflow {
 
+class StaticMemoryPlan;
 class StepStatsCollector;
 
 // Executor runs a graph computation.
@@ -100,6 +101,11 @@ class Executor {
     CollectiveExecutor* collective_executor = nullptr;
     thread::ThreadPoolInterface* user_intra_op_threadpool = nullptr;
 
+    // If set, the default allocations of the kernels are served by the plan
+    // instead of the device allocator. The caller must bracket the step with
+    // StartStep()/EndStep() calls on the plan.
+    StaticMemoryPlan* static_memory_plan = nullptr;
+
     // If true, calls Sync() on the device.
     bool sync_on_finish = false;
 
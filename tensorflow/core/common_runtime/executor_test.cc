@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
@@ -56,8 +57,10 @@ class ExecutorTest : public ::testing::Test {
     delete exec_;
   }
 
-  // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
+  // Resets executor_ with a new executor of type 'executor_type' based on a
+  // graph 'gdef'.
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
@@ -77,7 +80,10 @@ class ExecutorTest : public ::testing::Test {
       return Status::OK();
     };
     delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, std::move(graph), &exec_));
+    std::unique_ptr<Executor> executor;
+    TF_CHECK_OK(
+        NewExecutor(executor_type, params, std::move(graph), &executor));
+    exec_ = executor.release();
     runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
   }
 
@@ -250,6 +256,25 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeCostAware) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  BuildTree(4096, g.get());
+  Create(std::move(g), "COST_AWARE");
+  // Run several steps so that the node priorities are recomputed from
+  // measured costs at least once.
+  for (int i = 0; i < 4; ++i) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -287,6 +312,42 @@ TEST_F(ExecutorTest, ConcurrentAddAssign) {
 }
 #endif
 
+// Without control flow, pending counts are updated without taking the frame
+// lock. Sums 1024 ones along a balanced tree of Adds, with control edges from
+// every leaf to the root, many times over.
+TEST_F(ExecutorTest, WideGraphWithoutControlFlow) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto one = test::graph::Constant(g.get(), V(1.0));
+  std::vector<Node*> leaves;
+  for (int i = 0; i < 1024; ++i) {
+    leaves.push_back(test::graph::Identity(g.get(), one));
+  }
+  std::vector<Node*> level = leaves;
+  while (level.size() > 1) {
+    std::vector<Node*> next;
+    for (size_t i = 0; i < level.size(); i += 2) {
+      next.push_back(test::graph::Add(g.get(), level[i], level[i + 1]));
+    }
+    level.swap(next);
+  }
+  for (Node* leaf : leaves) {
+    g->AddControlEdge(leaf, level[0]);
+  }
+  test::graph::Send(g.get(), level[0], "out", ALICE, kIncarnation, BOB);
+  Create(std::move(g));
+  for (int iters = 0; iters < 16; ++iters) {
+    Rendezvous* rendez = NewLocalRendezvous();
+    TF_ASSERT_OK(Run(rendez));
+    Rendezvous::Args args;
+    Tensor out;
+    bool is_dead;
+    TF_ASSERT_OK(rendez->Recv(Key(ALICE, kIncarnation, BOB, "out"), args, &out,
+                              &is_dead));
+    EXPECT_EQ(1024.0, V(out));
+    rendez->Unref();
+  }
+}
+
 TEST_F(ExecutorTest, SimpleSwitchLive) {
   std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
   auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
@@ -306,6 +367,25 @@ TEST_F(ExecutorTest, SimpleSwitchLive) {
   EXPECT_FALSE(is_dead);
 }
 
+TEST_F(ExecutorTest, SimpleSwitchLiveCostAware) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto in1 = test::graph::Constant(g.get(), VB(false));
+  auto tmp = test::graph::Switch(g.get(), in0, in1);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  Create(std::move(g), "COST_AWARE");
+  Rendezvous::Args args;
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0),
+                             false));  // in0 = 1.0
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_EQ(1.0, V(out));  // out = 1.0
+  EXPECT_FALSE(is_dead);
+}
+
 TEST_F(ExecutorTest, SimpleSwitchDead) {
   std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
   auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
@@ -468,6 +548,89 @@ BENCHMARK(BM_executor)->ArgPair(8192, 32);
 // Tall fat graph
 BENCHMARK(BM_executor)->ArgPair(1024, 1024);
 
+// Create a graph with one long chain of 'depth' matrix multiplications (the
+// critical path) next to 'width' short chains of inexpensive scalar ops, all
+// joined by a final NoOp. Nodes that are off the critical path should not
+// delay it.
+static void BM_WideGraph(int iters, int width, int depth,
+                         const char* executor_type) {
+#ifdef PLATFORM_GOOGLE
+  BenchmarkUseRealTime();
+#endif  // PLATFORM_GOOGLE
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor matrix(DT_FLOAT, TensorShape({128, 128}));
+  matrix.flat<float>().setConstant(1.0 / 128);
+  Node* m = test::graph::Constant(g, matrix);
+  Node* chain = m;
+  for (int i = 0; i < depth; ++i) {
+    chain = test::graph::Matmul(g, chain, m, false, false);
+  }
+  std::vector<Node*> sinks = {chain};
+  Node* scalar = test::graph::Constant(g, V(1.0));
+  for (int i = 0; i < width; ++i) {
+    Node* n = test::graph::Identity(g, scalar);
+    for (int j = 0; j < 4; ++j) {
+      n = test::graph::Add(g, n, scalar);
+    }
+    sinks.push_back(n);
+  }
+  test::graph::NoOp(g, sinks);
+#ifdef PLATFORM_GOOGLE
+  SetBenchmarkItemsProcessed(static_cast<int64>(iters));
+#endif  // PLATFORM_GOOGLE
+  test::Benchmark("cpu", g, nullptr, nullptr, nullptr, executor_type)
+      .Run(iters);
+}
+
+static void BM_WideGraphDefault(int iters, int width, int depth) {
+  BM_WideGraph(iters, width, depth, "");
+}
+
+static void BM_WideGraphCostAware(int iters, int width, int depth) {
+  BM_WideGraph(iters, width, depth, "COST_AWARE");
+}
+
+BENCHMARK(BM_WideGraphDefault)->ArgPair(256, 16)->ArgPair(4096, 64);
+BENCHMARK(BM_WideGraphCostAware)->ArgPair(256, 16)->ArgPair(4096, 64);
+
+// Create a graph of 'width' chains of 'depth' tiny (scalar) ops, fanning out
+// from one node and back into one, and run it on 'num_threads' threads. The
+// step time is dominated by the executor propagating outputs between nodes.
+static void BM_TinyNodes(int iters, int num_threads, int width) {
+#ifdef PLATFORM_GOOGLE
+  BenchmarkUseRealTime();
+#endif  // PLATFORM_GOOGLE
+  constexpr int kDepth = 8;
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* scalar = test::graph::Constant(g, V(1.0));
+  std::vector<Node*> chains;
+  for (int i = 0; i < width; ++i) {
+    Node* n = scalar;
+    for (int j = 0; j < kDepth; ++j) {
+      n = test::graph::Identity(g, n);
+    }
+    chains.push_back(n);
+  }
+  test::graph::NoOp(g, chains);
+#ifdef PLATFORM_GOOGLE
+  const int64 num_nodes = width * kDepth + 2;
+  SetBenchmarkLabel(strings::StrCat("Nodes = ", num_nodes));
+  SetBenchmarkItemsProcessed(num_nodes * static_cast<int64>(iters));
+#endif  // PLATFORM_GOOGLE
+  SessionOptions options;
+  options.config.set_inter_op_parallelism_threads(num_threads);
+  test::Benchmark("cpu", g, &options).Run(iters);
+}
+
+BENCHMARK(BM_TinyNodes)
+    ->ArgPair(1, 1024)
+    ->ArgPair(2, 1024)
+    ->ArgPair(4, 1024)
+    ->ArgPair(8, 1024)
+    ->ArgPair(16, 1024)
+    ->ArgPair(32, 1024)
+    ->ArgPair(64, 1024);
+
 static void BM_FeedInputFetchOutput(int iters) {
   Graph* g = new Graph(OpRegistry::Global());
   // z = x + y: x and y are provided as benchmark inputs.  z is the
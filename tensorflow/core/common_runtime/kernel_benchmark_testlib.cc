@@ -59,8 +59,10 @@ Benchmark::Benchmark(const string& device, Graph* g,
       DeviceFactory::NewDevice(t, *options, "/job:localhost/replica:0/task:0");
   CHECK(device_) << "Could not create a " << device << " device";
 
-  pool_ =
-      new thread::ThreadPool(options->env, "blocking", port::MaxParallelism());
+  const int num_threads = options->config.inter_op_parallelism_threads() > 0
+                              ? options->config.inter_op_parallelism_threads()
+                              : port::MaxParallelism();
+  pool_ = new thread::ThreadPool(options->env, "blocking", num_threads);
 
   auto runner = [this](std::function<void()> closure) {
     pool_->Schedule(closure);
@@ -36,7 +36,9 @@ namespace test {
 class Benchmark {
  public:
   // "device" must be either "cpu" or "gpu".  Takes ownership of "g",
-  // "init", and one reference on "rendez" (if not null).
+  // "init", and one reference on "rendez" (if not null). The executor runs
+  // its nodes on "options->config.inter_op_parallelism_threads()" threads, if
+  // set, and on one thread per core otherwise.
   Benchmark(const string& device, Graph* g,
             const SessionOptions* options = nullptr, Graph* init = nullptr,
             Rendezvous* rendez = nullptr, const char* executor_type = "");
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 namespace metrics {
@@ -55,6 +57,16 @@ auto* tf_data_bytes_read_counter = monitoring::Counter<1>::New(
     "/tensorflow/data/bytes_read",
     "The number of bytes read by tf.data Dataset sources.", "name");
 
+auto* tf_data_bytes_spilled_counter = monitoring::Counter<1>::New(
+    "/tensorflow/data/bytes_spilled",
+    "The number of bytes spilled to disk by tf.data Datasets.", "name");
+
+auto* tf_data_cross_numa_node_bytes_counter = monitoring::Counter<1>::New(
+    "/tensorflow/data/cross_numa_node_bytes",
+    "The number of bytes of elements produced by NUMA-pinned tf.data Datasets "
+    "that are consumed across NUMA nodes.",
+    "name");
+
 auto* tf_data_elements_counter = monitoring::Counter<1>::New(
     "/tensorflow/data/elements", "tf.data elements", "name");
 
@@ -87,6 +99,28 @@ auto* xla_compilation_time_usecs = monitoring::Counter<0>::New(
     "/tensorflow/core/xla_compilation_time_usecs",
     "The total time spent on compiling XLA graphs in microseconds.");
 
+auto* xla_async_compilation_queue_depth = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/xla_async_compilation_queue_depth",
+    "The number of XLA compilations queued or running on background threads.");
+
+auto* xla_compilation_fallbacks = monitoring::Counter<1>::New(
+    "/tensorflow/core/xla_compilation_fallbacks",
+    "The number of times an XLA cluster ran in the TensorFlow executor because "
+    "it did not have a compiled executable.",
+    "reason");
+
+auto* xla_shape_bucketing_rows = monitoring::Counter<1>::New(
+    "/tensorflow/core/xla_shape_bucketing_rows",
+    "The number of rows of the inputs of XLA clusters run with shape "
+    "bucketing. The `kind` label is \"batch\" for the rows of the batch and "
+    "\"padding\" for the rows added to reach the bucket size.",
+    "kind");
+
+auto* xla_shape_bucketing_compilations_saved = monitoring::Counter<0>::New(
+    "/tensorflow/core/xla_shape_bucketing_compilations_saved",
+    "The number of XLA compilations avoided by running a batch size with an "
+    "executable compiled for another batch size of the same bucket.");
+
 }  // namespace
 
 void RecordTFDataAutotune(const string& name) {
@@ -97,6 +131,14 @@ void RecordTFDataBytesRead(const string& name, int64 num_bytes) {
   tf_data_bytes_read_counter->GetCell(name)->IncrementBy(num_bytes);
 }
 
+void RecordTFDataBytesSpilled(const string& name, int64 num_bytes) {
+  tf_data_bytes_spilled_counter->GetCell(name)->IncrementBy(num_bytes);
+}
+
+void RecordTFDataCrossNumaNodeBytes(const string& name, int64 num_bytes) {
+  tf_data_cross_numa_node_bytes_counter->GetCell(name)->IncrementBy(num_bytes);
+}
+
 void RecordTFDataElements(const string& name, int64 num_elements) {
   tf_data_elements_counter->GetCell(name)->IncrementBy(num_elements);
 }
@@ -135,5 +177,26 @@ void UpdateXlaCompilationTime(const uint64 compilation_time_usecs) {
   }
 }
 
+void UpdateXlaAsyncCompilationQueueDepth(int64 delta) {
+  static mutex* mu = new mutex;
+  mutex_lock l(*mu);
+  auto* cell = xla_async_compilation_queue_depth->GetCell();
+  cell->Set(cell->value() + delta);
+}
+
+void RecordXlaCompilationFallback(const string& reason) {
+  xla_compilation_fallbacks->GetCell(reason)->IncrementBy(1);
+}
+
+void RecordXlaShapeBucketing(int64 batch_size, int64 bucket_size,
+                             bool reused_executable) {
+  xla_shape_bucketing_rows->GetCell("batch")->IncrementBy(batch_size);
+  xla_shape_bucketing_rows->GetCell("padding")->IncrementBy(bucket_size -
+                                                            batch_size);
+  if (reused_executable) {
+    xla_shape_bucketing_compilations_saved->GetCell()->IncrementBy(1);
+  }
+}
+
 }  // namespace metrics
 }  // namespace tensorflow
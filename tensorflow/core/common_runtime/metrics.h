@@ -32,6 +32,19 @@ void RecordTFDataAutotune(const string& name);
 // The `name` argument identifies the Dataset type (e.g. "TFRecordDataset").
 void RecordTFDataBytesRead(const string& name, int64 num_bytes);
 
+// Records the number of bytes spilled to disk by a tf.data.Dataset that
+// buffers more elements than fit in memory.
+//
+// The `name` argument identifies the Dataset type (e.g. "SpillingShuffle").
+void RecordTFDataBytesSpilled(const string& name, int64 num_bytes);
+
+// Records the number of bytes of elements produced by a tf.data.Dataset pinned
+// to a NUMA node that reside in the memory of another node than the one of the
+// consuming thread (or of the pinned node, if the consumer is not pinned).
+//
+// The `name` argument identifies the Dataset type (e.g. "ThreadPool").
+void RecordTFDataCrossNumaNodeBytes(const string& name, int64 num_bytes);
+
 // Records the number of elements produced by a tf.data.Dataset.
 //
 // The `name` argument identifies the Dataset type (e.g. "Batch" or "Map").
@@ -67,6 +80,26 @@ void UpdateGraphBuildTime(const uint64 running_time_usecs);
 // Updates the metrics stored about time XLA spents compiling graphs.
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 
+// Updates the number of XLA compilations queued or running on background
+// threads by `delta`.
+void UpdateXlaAsyncCompilationQueueDepth(int64 delta);
+
+// Records that an XLA cluster ran in the TensorFlow executor because it did not
+// have a compiled executable.
+//
+// The `reason` argument identifies why the cluster was not compiled (e.g.
+// "lazy" when it has not been requested often enough, or "compiling" while its
+// compilation runs in the background).
+void RecordXlaCompilationFallback(const string& reason);
+
+// Records that an XLA cluster ran with the leading dimension of its inputs
+// padded from `batch_size` to `bucket_size`.  `reused_executable` is true if
+// this is the first time the executable compiled for `bucket_size` runs a
+// batch of `batch_size` rows while it has already run other batch sizes, i.e.
+// when bucketing saved a compilation.
+void RecordXlaShapeBucketing(int64 batch_size, int64 bucket_size,
+                             bool reused_executable);
+
 }  // namespace metrics
 }  // namespace tensorflow
 
@@ -91,12 +91,20 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
         LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
       }
       int64 cpu_mem_limit = cpu_mem_limit_in_mb * (1LL << 20);
+      bool use_thread_caches = false;
+      status = ReadBoolFromEnvVar("TF_CPU_BFC_THREAD_CACHES", false,
+                                  &use_thread_caches);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
       DCHECK(sub_allocator);
-      allocator =
-          new BFCAllocator(sub_allocator, cpu_mem_limit, true /*allow_growth*/,
-                           "bfc_cpu_allocator_for_gpu" /*name*/);
+      allocator = new BFCAllocator(
+          sub_allocator, cpu_mem_limit, true /*allow_growth*/,
+          "bfc_cpu_allocator_for_gpu" /*name*/,
+          false /*garbage_collection*/, use_thread_caches /*thread_caches*/);
       VLOG(2) << "Using BFCAllocator with memory limit of "
-              << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
+              << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator"
+              << (use_thread_caches ? " (with thread caches)" : "");
     } else if (sub_allocator) {
       DCHECK(sub_allocator);
       allocator =
@@ -31,15 +31,47 @@ limitations under the License.
 
 namespace tensorflow {
 
-IntraProcessRendezvous::IntraProcessRendezvous(const DeviceMgr* device_mgr)
-    : device_mgr_(device_mgr), local_(NewLocalRendezvous()) {}
+IntraProcessRendezvous::IntraProcessRendezvous(const DeviceMgr* device_mgr,
+                                               int64 num_slots)
+    : device_mgr_(device_mgr),
+      local_(NewLocalRendezvous()),
+      num_slots_(num_slots) {
+  if (num_slots_ > 0) {
+    slots_.reset(new std::atomic<SlotItem*>[num_slots_]);
+    for (int64 i = 0; i < num_slots_; ++i) {
+      slots_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
 
-IntraProcessRendezvous::~IntraProcessRendezvous() { local_->Unref(); }
+IntraProcessRendezvous::~IntraProcessRendezvous() {
+  AbortSlots(errors::Cancelled("IntraProcessRendezvous deleted"));
+  local_->Unref();
+}
+
+IntraProcessRendezvous::SlotItem::~SlotItem() {
+  if (send_args.device_context) {
+    send_args.device_context->Unref();
+  }
+  if (recv_args.device_context) {
+    recv_args.device_context->Unref();
+  }
+}
+
+/* static */
+IntraProcessRendezvous::SlotItem* IntraProcessRendezvous::ConsumedSlot() {
+  static SlotItem* consumed = new SlotItem;
+  return consumed;
+}
 
 Status IntraProcessRendezvous::Send(const ParsedKey& parsed,
                                     const Rendezvous::Args& args,
                                     const Tensor& val, const bool is_dead) {
   VLOG(1) << "IntraProcessRendezvous Send " << this << " " << parsed.FullKey();
+  if (parsed.slot >= 0 && parsed.slot < num_slots_ &&
+      SendToSlot(parsed, args, val, is_dead)) {
+    return Status::OK();
+  }
   {
     mutex_lock l(mu_);
     if (!status_.ok()) return status_;
@@ -49,6 +81,83 @@ Status IntraProcessRendezvous::Send(const ParsedKey& parsed,
   return local_->Send(parsed, args, val, is_dead);
 }
 
+bool IntraProcessRendezvous::SendToSlot(const ParsedKey& parsed,
+                                        const Rendezvous::Args& send_args,
+                                        const Tensor& val, bool is_dead) {
+  std::atomic<SlotItem*>* slot = &slots_[parsed.slot];
+  SlotItem* item = slot->load(std::memory_order_acquire);
+  if (item == nullptr) {
+    // There is no waiter yet: park the value for the consumer to pick up.
+    SlotItem* value = new SlotItem;
+    value->value = val;
+    value->is_dead = is_dead;
+    value->send_args = send_args;
+    if (value->send_args.device_context) {
+      value->send_args.device_context->Ref();
+    }
+    if (slot->compare_exchange_strong(item, value, std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      return true;
+    }
+    delete value;
+  }
+  if (item == ConsumedSlot() || item->IsSendValue() ||
+      !slot->compare_exchange_strong(item, ConsumedSlot(),
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+    return false;
+  }
+  // Hand the value to the waiting consumer.
+  RecvDone(parsed, Status::OK(), send_args, item->recv_args, val, is_dead,
+           std::move(item->waiter));
+  delete item;
+  return true;
+}
+
+bool IntraProcessRendezvous::RecvFromSlot(const ParsedKey& parsed,
+                                          const Rendezvous::Args& recv_args,
+                                          DoneCallback* done) {
+  std::atomic<SlotItem*>* slot = &slots_[parsed.slot];
+  SlotItem* item = slot->load(std::memory_order_acquire);
+  if (item == nullptr) {
+    // There is no value yet: park the consumer until it is sent.
+    SlotItem* waiter = new SlotItem;
+    waiter->waiter = std::move(*done);
+    waiter->recv_args = recv_args;
+    if (waiter->recv_args.device_context) {
+      waiter->recv_args.device_context->Ref();
+    }
+    if (slot->compare_exchange_strong(item, waiter, std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      return true;
+    }
+    *done = std::move(waiter->waiter);
+    delete waiter;
+  }
+  if (item == ConsumedSlot() || !item->IsSendValue() ||
+      !slot->compare_exchange_strong(item, ConsumedSlot(),
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+    return false;
+  }
+  RecvDone(parsed, Status::OK(), item->send_args, recv_args, item->value,
+           item->is_dead, std::move(*done));
+  delete item;
+  return true;
+}
+
+void IntraProcessRendezvous::AbortSlots(const Status& status) {
+  for (int64 i = 0; i < num_slots_; ++i) {
+    SlotItem* item =
+        slots_[i].exchange(ConsumedSlot(), std::memory_order_acq_rel);
+    if (item == nullptr || item == ConsumedSlot()) continue;
+    if (!item->IsSendValue()) {
+      item->waiter(status, Args(), Args(), Tensor(), false);
+    }
+    delete item;
+  }
+}
+
 Status IntraProcessRendezvous::ParseKey(const string& key, bool is_src,
                                         Rendezvous::ParsedKey* parsed) {
   {
@@ -63,18 +172,6 @@ void IntraProcessRendezvous::SameWorkerRecvDone(
     const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& send_args,
     const Rendezvous::Args& recv_args, const Tensor& in, Tensor* out,
     StatusCallback done) {
-  // Do a quick copy (sharing the underlying buffer) if both tensors
-  // are on host memory.
-  const bool src_host =
-      (send_args.alloc_attrs.on_host() || parsed.src.type == "CPU");
-  const bool dst_host =
-      (recv_args.alloc_attrs.on_host() || parsed.dst.type == "CPU");
-  if (src_host && dst_host) {
-    *out = in;
-    done(Status::OK());
-    return;
-  }
-
   // This copy must involve a non-CPU device. Hence, "in" must support DMA
   // (e.g., string tensors do not work on GPU).  Variant copy DMA
   // checks happen inside CopyTensor::ViaDMA.
@@ -129,10 +226,53 @@ void IntraProcessRendezvous::SameWorkerRecvDone(
       out, 0 /*dev_to_dev_stream_index*/, std::move(done), sync_dst_compute);
 }
 
+void IntraProcessRendezvous::RecvDone(const Rendezvous::ParsedKey& parsed,
+                                      const Status& status,
+                                      const Rendezvous::Args& send_args,
+                                      const Rendezvous::Args& recv_args,
+                                      const Tensor& in, bool is_dead,
+                                      DoneCallback done) {
+  if (!status.ok() || !in.IsInitialized()) {
+    // If "in" is an uninitialized tensor, pass it on to preserve the
+    // uninitialized state, along with data type and shape info, which is
+    // useful for debugger purposes.
+    done(status, send_args, recv_args, in.IsInitialized() ? Tensor() : in,
+         is_dead);
+    return;
+  }
+
+  // Both sides on the host share the sent buffer, with no intermediate
+  // tensor to allocate.
+  const bool src_host =
+      (send_args.alloc_attrs.on_host() || parsed.src.type == "CPU");
+  const bool dst_host =
+      (recv_args.alloc_attrs.on_host() || parsed.dst.type == "CPU");
+  if (src_host && dst_host) {
+    done(Status::OK(), send_args, recv_args, in, is_dead);
+    return;
+  }
+
+  Tensor* out = new Tensor;
+  auto final_callback = std::bind(
+      [send_args, recv_args, out, is_dead](DoneCallback done,
+                                           // Begin unbound arguments.
+                                           const Status& s) {
+        done(s, send_args, recv_args, *out, is_dead);
+        delete out;
+      },
+      std::move(done), std::placeholders::_1);
+  SameWorkerRecvDone(parsed, send_args, recv_args, in, out,
+                     std::move(final_callback));
+}
+
 void IntraProcessRendezvous::RecvAsync(const ParsedKey& parsed,
                                        const Rendezvous::Args& recv_args,
                                        DoneCallback done) {
   VLOG(1) << "IntraProcessRendezvous Recv " << this << " " << parsed.FullKey();
+  if (parsed.slot >= 0 && parsed.slot < num_slots_ &&
+      RecvFromSlot(parsed, recv_args, &done)) {
+    return;
+  }
 
   // Recv the tensor from local_.
   local_->RecvAsync(
@@ -144,26 +284,8 @@ void IntraProcessRendezvous::RecvAsync(const ParsedKey& parsed,
                          const Rendezvous::Args& send_args,
                          const Rendezvous::Args& recv_args, const Tensor& in,
                          bool is_dead) {
-            // If "in" is an uninitialized tensor, do copy-construction to
-            // preserve the uninitialized state, along with data type and shape
-            // info, which is useful for debugger purposes.
-            Tensor* out = in.IsInitialized() ? new Tensor : new Tensor(in);
-
-            auto final_callback = std::bind(
-                [send_args, recv_args, out, is_dead](DoneCallback done,
-                                                     // Begin unbound arguments.
-                                                     const Status& s) {
-                  done(s, send_args, recv_args, *out, is_dead);
-                  delete out;
-                },
-                std::move(done), std::placeholders::_1);
-
-            if (status.ok() && in.IsInitialized()) {
-              SameWorkerRecvDone(parsed, send_args, recv_args, in, out,
-                                 std::move(final_callback));
-            } else {
-              final_callback(status);
-            }
+            RecvDone(parsed, status, send_args, recv_args, in, is_dead,
+                     std::move(done));
           },
           std::move(done), std::placeholders::_1, std::placeholders::_2,
           std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
@@ -172,6 +294,7 @@ void IntraProcessRendezvous::RecvAsync(const ParsedKey& parsed,
 void IntraProcessRendezvous::StartAbort(const Status& s) {
   CHECK(!s.ok());
   local_->StartAbort(s);
+  AbortSlots(s);
 }
 
 }  // end namespace tensorflow
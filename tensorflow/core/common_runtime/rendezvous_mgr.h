@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_RENDEZVOUS_MGR_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_RENDEZVOUS_MGR_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -37,9 +39,15 @@ namespace tensorflow {
 // Buffering of Tensor values is delegated to a "local" Rendezvous
 // obtained from NewLocalRendezvous().  This class just adds
 // functionality to coordinate multiple process-local devices.
+//
+// Keys whose slot (see Rendezvous::ParsedKey::slot) is below 'num_slots'
+// bypass local_: each such Send/Recv pair meets in its own entry of a
+// lock-free slot table, which is matched once per step.  Values received
+// on the host from the host share the sent buffer rather than being copied.
 class IntraProcessRendezvous : public Rendezvous {
  public:
-  explicit IntraProcessRendezvous(const DeviceMgr* device_mgr);
+  explicit IntraProcessRendezvous(const DeviceMgr* device_mgr,
+                                  int64 num_slots = 0);
 
   // Forwards to local_, where the Tensor "val" will be buffered and
   // any waiting callback stored.
@@ -56,9 +64,32 @@ class IntraProcessRendezvous : public Rendezvous {
   void StartAbort(const Status& status) override;
 
  private:
+  // A sent value, or a waiting consumer, parked in a slot until the other
+  // side of the pair arrives.
+  struct SlotItem {
+    DoneCallback waiter = nullptr;
+    Tensor value;
+    bool is_dead = false;
+    Rendezvous::Args send_args;
+    Rendezvous::Args recv_args;
+
+    ~SlotItem();
+
+    // Returns true iff this item represents a value being sent.
+    bool IsSendValue() const { return waiter == nullptr; }
+  };
+
   const DeviceMgr* device_mgr_;
   Rendezvous* local_;  // Owns a Ref on this object.
 
+  // Each slot starts empty (nullptr), holds the item of whichever of Send()
+  // and RecvAsync() comes first, and is then set to ConsumedSlot() by the
+  // other one.  Keys that find their slot consumed (e.g. after StartAbort())
+  // go through local_.
+  const int64 num_slots_;
+  std::unique_ptr<std::atomic<SlotItem*>[]> slots_;
+  static SlotItem* ConsumedSlot();
+
   mutable mutex mu_;
 
   // Status given by StartAbort() if any.
@@ -73,15 +104,33 @@ class IntraProcessRendezvous : public Rendezvous {
                   Rendezvous::ParsedKey* parsed);
 
   // Callback handling the case when a rendezvous has been
-  // accomplished in local_ and the consumer is local to this process.
-  // Tensor "in" will be copied into "out". The key "parsed" encodes
-  // the src and dst devices.
+  // accomplished and the consumer is local to this process, and either
+  // side is on a device. Tensor "in" will be copied into "out". The key
+  // "parsed" encodes the src and dst devices.
   typedef std::function<void(const Status&)> StatusCallback;
   void SameWorkerRecvDone(const Rendezvous::ParsedKey& parsed,
                           const Rendezvous::Args& send_args,
                           const Rendezvous::Args& recv_args, const Tensor& in,
                           Tensor* out, StatusCallback done);
 
+  // Completes a receive of "in", sent with "send_args", by copying it to the
+  // consumer's device if needed and then invoking "done".
+  void RecvDone(const Rendezvous::ParsedKey& parsed, const Status& status,
+                const Rendezvous::Args& send_args,
+                const Rendezvous::Args& recv_args, const Tensor& in,
+                bool is_dead, DoneCallback done);
+
+  // Sends or receives through the slot of "parsed".  Return false, without
+  // side effects, if the key must go through local_ instead.
+  bool SendToSlot(const Rendezvous::ParsedKey& parsed,
+                  const Rendezvous::Args& send_args, const Tensor& val,
+                  bool is_dead);
+  bool RecvFromSlot(const Rendezvous::ParsedKey& parsed,
+                    const Rendezvous::Args& recv_args, DoneCallback* done);
+
+  // Consumes every slot, failing the waiting consumers with "status".
+  void AbortSlots(const Status& status);
+
   TF_DISALLOW_COPY_AND_ASSIGN(IntraProcessRendezvous);
 };
 
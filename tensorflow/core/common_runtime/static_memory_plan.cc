@@ -0,0 +1,301 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <utility>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace {
+
+// The first step runs with the device allocator, so that kernels can set up
+// their persistent state, and the step after it is recorded.
+constexpr int64 kNumWarmupSteps = 1;
+
+size_t AlignedSize(size_t size) {
+  const size_t alignment = Allocator::kAllocatorAlignment;
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+bool LifetimesOverlap(const BufferLifetime& a, const BufferLifetime& b) {
+  return a.first_use <= b.last_use && b.first_use <= a.last_use;
+}
+
+}  // namespace
+
+size_t PlanArenaOffsets(const std::vector<BufferLifetime>& buffers,
+                        std::vector<size_t>* offsets) {
+  const int num_buffers = buffers.size();
+  std::vector<int> order(num_buffers);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&buffers](int a, int b) {
+    return buffers[a].size > buffers[b].size;
+  });
+
+  offsets->assign(num_buffers, 0);
+  size_t arena_size = 0;
+  std::vector<int> placed;
+  placed.reserve(num_buffers);
+  std::vector<std::pair<size_t, size_t>> busy;
+  for (int i : order) {
+    const size_t size = AlignedSize(buffers[i].size);
+    // Memory ranges of the placed buffers that are live at the same time.
+    busy.clear();
+    for (int j : placed) {
+      if (LifetimesOverlap(buffers[i], buffers[j])) {
+        busy.emplace_back((*offsets)[j],
+                          (*offsets)[j] + AlignedSize(buffers[j].size));
+      }
+    }
+    std::sort(busy.begin(), busy.end());
+    // Take the first gap that is large enough.
+    size_t offset = 0;
+    for (const auto& range : busy) {
+      if (range.first >= offset + size) break;
+      offset = std::max(offset, range.second);
+    }
+    (*offsets)[i] = offset;
+    arena_size = std::max(arena_size, offset + size);
+    placed.push_back(i);
+  }
+  return arena_size;
+}
+
+// Serves the allocations of one node. The ordinal of an allocation within the
+// step identifies its slot in the plan.
+class StaticMemoryPlan::NodeAllocatorImpl : public Allocator {
+ public:
+  NodeAllocatorImpl(StaticMemoryPlan* plan, int node_id)
+      : plan_(plan),
+        node_id_(node_id),
+        name_(strings::StrCat(plan->base_allocator_->Name(),
+                              "_static_arena")) {}
+
+  string Name() override { return name_; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+  }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override {
+    const int ordinal = next_ordinal_.fetch_add(1, std::memory_order_relaxed);
+    return plan_->AllocateForNode(node_id_, ordinal, alignment, num_bytes,
+                                  allocation_attr);
+  }
+
+  void DeallocateRaw(void* ptr) override { plan_->Deallocate(ptr); }
+
+  void ResetOrdinal() { next_ordinal_.store(0, std::memory_order_relaxed); }
+
+ private:
+  StaticMemoryPlan* const plan_;  // Not owned.
+  const int node_id_;
+  const string name_;
+  std::atomic<int> next_ordinal_{0};
+};
+
+StaticMemoryPlan::StaticMemoryPlan(Allocator* base_allocator, int num_node_ids)
+    : base_allocator_(base_allocator),
+      mode_(kWarmup),
+      node_slots_(num_node_ids) {
+  node_allocators_.reserve(num_node_ids);
+  for (int i = 0; i < num_node_ids; ++i) {
+    node_allocators_.emplace_back(new NodeAllocatorImpl(this, i));
+  }
+}
+
+StaticMemoryPlan::~StaticMemoryPlan() {
+  // Every live allocation holds a reference, so the arena is unused by now.
+  if (arena_ != nullptr) {
+    base_allocator_->DeallocateRaw(arena_);
+  }
+}
+
+Allocator* StaticMemoryPlan::NodeAllocator(int node_id) {
+  if (mode_.load(std::memory_order_relaxed) == kDisabled) {
+    return nullptr;
+  }
+  return node_allocators_[node_id].get();
+}
+
+int64 StaticMemoryPlan::StartStep() {
+  const int64 step = num_steps_started_.fetch_add(1);
+  if (step == kNumWarmupSteps) {
+    mutex_lock l(mu_);
+    int expected = kWarmup;
+    mode_.compare_exchange_strong(expected, kRecording);
+  }
+  for (auto& node_allocator : node_allocators_) {
+    node_allocator->ResetOrdinal();
+  }
+  return step;
+}
+
+void StaticMemoryPlan::EndStep(int64 step) {
+  if (step == kNumWarmupSteps) {
+    BuildPlan();
+  }
+}
+
+StaticMemoryPlan::Stats StaticMemoryPlan::GetStats() const {
+  Stats stats;
+  stats.num_arena_allocations =
+      num_arena_allocations_.load(std::memory_order_relaxed);
+  stats.num_allocator_allocations =
+      num_allocator_allocations_.load(std::memory_order_relaxed);
+  if (mode_.load(std::memory_order_acquire) == kPlanned) {
+    stats.arena_bytes = arena_size_;
+  }
+  return stats;
+}
+
+void* StaticMemoryPlan::AllocateForNode(
+    int node_id, int ordinal, size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  const int mode = mode_.load(std::memory_order_acquire);
+  if (mode == kPlanned && num_bytes > 0 &&
+      alignment <= Allocator::kAllocatorAlignment) {
+    void* ptr = AllocateFromArena(node_id, ordinal, num_bytes);
+    if (ptr != nullptr) {
+      Ref();
+      num_arena_allocations_.fetch_add(1, std::memory_order_relaxed);
+      return ptr;
+    }
+  }
+
+  void* ptr =
+      base_allocator_->AllocateRaw(alignment, num_bytes, allocation_attr);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  Ref();
+  num_allocator_allocations_.fetch_add(1, std::memory_order_relaxed);
+  if (mode == kRecording) {
+    mutex_lock l(mu_);
+    if (mode_.load(std::memory_order_relaxed) == kRecording) {
+      Record record;
+      record.node_id = node_id;
+      record.ordinal = ordinal;
+      record.lifetime.size = num_bytes;
+      record.lifetime.first_use = next_event_++;
+      record.lifetime.last_use = -1;
+      live_records_[ptr] = records_.size();
+      records_.push_back(record);
+    }
+  }
+  return ptr;
+}
+
+void* StaticMemoryPlan::AllocateFromArena(int node_id, int ordinal,
+                                          size_t num_bytes) {
+  const std::vector<int>& node_slots = node_slots_[node_id];
+  if (ordinal >= node_slots.size() || node_slots[ordinal] < 0) {
+    return nullptr;
+  }
+  const Slot& slot = slots_[node_slots[ordinal]];
+  if (num_bytes > slot.size) {
+    return nullptr;
+  }
+  const size_t end = slot.offset + slot.size;
+  mutex_lock l(mu_);
+  // Live ranges are disjoint, so only the last one starting before `end` can
+  // overlap the slot.
+  auto it = live_.lower_bound(end);
+  if (it != live_.begin() && std::prev(it)->second > slot.offset) {
+    return nullptr;
+  }
+  live_.emplace(slot.offset, end);
+  return arena_ + slot.offset;
+}
+
+void StaticMemoryPlan::Deallocate(void* ptr) {
+  const int mode = mode_.load(std::memory_order_acquire);
+  char* p = static_cast<char*>(ptr);
+  if (mode == kPlanned && p >= arena_ && p < arena_ + arena_size_) {
+    mutex_lock l(mu_);
+    live_.erase(p - arena_);
+  } else {
+    if (mode == kRecording) {
+      mutex_lock l(mu_);
+      auto it = live_records_.find(ptr);
+      if (it != live_records_.end()) {
+        records_[it->second].lifetime.last_use = next_event_++;
+        live_records_.erase(it);
+      }
+    }
+    base_allocator_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+void StaticMemoryPlan::BuildPlan() {
+  mutex_lock l(mu_);
+  if (mode_.load(std::memory_order_relaxed) != kRecording) {
+    return;
+  }
+  std::vector<BufferLifetime> buffers;
+  std::vector<int> planned_records;
+  for (int i = 0; i < records_.size(); ++i) {
+    // Buffers that are still alive at the end of the step escape it, e.g. as
+    // fetched outputs or as resource state, and are left to the device
+    // allocator.
+    if (records_[i].lifetime.last_use < 0 || records_[i].lifetime.size == 0) {
+      continue;
+    }
+    buffers.push_back(records_[i].lifetime);
+    planned_records.push_back(i);
+  }
+
+  size_t arena_size = 0;
+  std::vector<size_t> offsets;
+  if (!buffers.empty()) {
+    arena_size = PlanArenaOffsets(buffers, &offsets);
+    arena_ = static_cast<char*>(base_allocator_->AllocateRaw(
+        Allocator::kAllocatorAlignment, arena_size));
+  }
+  if (arena_ == nullptr) {
+    VLOG(1) << "Not using a static memory plan for " << buffers.size()
+            << " buffers of " << arena_size << " bytes.";
+    records_.clear();
+    live_records_.clear();
+    mode_.store(kDisabled, std::memory_order_release);
+    return;
+  }
+
+  arena_size_ = arena_size;
+  for (int i = 0; i < planned_records.size(); ++i) {
+    const Record& record = records_[planned_records[i]];
+    std::vector<int>* node_slots = &node_slots_[record.node_id];
+    if (node_slots->size() <= record.ordinal) {
+      node_slots->resize(record.ordinal + 1, -1);
+    }
+    (*node_slots)[record.ordinal] = slots_.size();
+    slots_.push_back({offsets[i], AlignedSize(record.lifetime.size)});
+  }
+  VLOG(1) << "Planned a static arena of " << arena_size_ << " bytes for "
+          << slots_.size() << " of " << records_.size() << " allocations.";
+  records_.clear();
+  live_records_.clear();
+  mode_.store(kPlanned, std::memory_order_release);
+}
+
+}  // namespace tensorflow
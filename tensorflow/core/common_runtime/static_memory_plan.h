@@ -0,0 +1,158 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The size and live range of a buffer, in allocation/deallocation events.
+struct BufferLifetime {
+  size_t size = 0;
+  int64 first_use = 0;
+  int64 last_use = 0;
+};
+
+// Assigns an arena offset to every buffer such that buffers with overlapping
+// lifetimes do not overlap in memory. Buffers are placed greedily, largest
+// first, at the lowest offset that fits. Offsets and sizes are aligned to
+// Allocator::kAllocatorAlignment. Returns the size of the arena.
+size_t PlanArenaOffsets(const std::vector<BufferLifetime>& buffers,
+                        std::vector<size_t>* offsets);
+
+// A StaticMemoryPlan serves the allocations of the kernels of one executor
+// from a single preallocated arena, bypassing the device allocator.
+//
+// The plan is built from the allocations observed while running the graph:
+// the first step warms up the kernels, the second one records the size and
+// the lifetime of every allocation made by every node, and at the end of the
+// second step the recorded buffers are packed into an arena by
+// PlanArenaOffsets(). From then on, the i-th allocation a node makes in a step
+// is served from its planned arena slot.
+//
+// The plan is only a hint: an allocation falls back to the device allocator
+// if it is larger than its slot, if it was not planned (e.g. because the
+// buffer outlived the recording step, like a fetched tensor), or if the slot
+// overlaps memory that is still in use (e.g. because nodes ran in a different
+// order than during the recording step). It is therefore always safe to use,
+// and it is most effective for graphs whose shapes do not change from step to
+// step.
+//
+// The plan is reference counted, and every live allocation holds a reference,
+// so it outlives the tensors it allocated.
+//
+// This class is thread-safe.
+class StaticMemoryPlan : public core::RefCounted {
+ public:
+  // Cumulative allocation counts of the plan.
+  struct Stats {
+    // Allocations served from the arena.
+    int64 num_arena_allocations = 0;
+    // Allocations forwarded to the device allocator.
+    int64 num_allocator_allocations = 0;
+    // Size of the arena, or 0 if it has not been planned yet.
+    int64 arena_bytes = 0;
+  };
+
+  // `base_allocator` is the device allocator the arena is carved from, and the
+  // fallback for allocations the plan cannot serve. It is not owned and must
+  // outlive the plan. `num_node_ids` is Graph::num_node_ids() of the graph run
+  // by the executor.
+  StaticMemoryPlan(Allocator* base_allocator, int num_node_ids);
+
+  // Returns the allocator serving the default allocations of node `node_id`,
+  // or nullptr if the node should use the device allocator directly.
+  Allocator* NodeAllocator(int node_id);
+
+  // Must be called before and after each step of the executor. StartStep()
+  // returns the step number that must be passed to EndStep().
+  int64 StartStep();
+  void EndStep(int64 step);
+
+  Stats GetStats() const;
+
+ private:
+  class NodeAllocatorImpl;
+
+  enum Mode { kWarmup, kRecording, kPlanned, kDisabled };
+
+  // A recorded allocation.
+  struct Record {
+    int node_id;
+    int ordinal;
+    BufferLifetime lifetime;
+  };
+
+  // A planned arena slot.
+  struct Slot {
+    size_t offset;
+    size_t size;
+  };
+
+  ~StaticMemoryPlan() override;
+
+  void* AllocateForNode(int node_id, int ordinal, size_t alignment,
+                        size_t num_bytes,
+                        const AllocationAttributes& allocation_attr)
+      LOCKS_EXCLUDED(mu_);
+  void* AllocateFromArena(int node_id, int ordinal, size_t num_bytes)
+      LOCKS_EXCLUDED(mu_);
+  void Deallocate(void* ptr) LOCKS_EXCLUDED(mu_);
+  void BuildPlan() LOCKS_EXCLUDED(mu_);
+
+  Allocator* const base_allocator_;  // Not owned.
+  std::vector<std::unique_ptr<NodeAllocatorImpl>> node_allocators_;
+
+  std::atomic<int> mode_;
+  std::atomic<int64> num_steps_started_{0};
+  std::atomic<int64> num_arena_allocations_{0};
+  std::atomic<int64> num_allocator_allocations_{0};
+
+  // Written once by BuildPlan() before mode_ becomes kPlanned, and read-only
+  // afterwards.
+  char* arena_ = nullptr;
+  size_t arena_size_ = 0;
+  std::vector<Slot> slots_;
+  // Indexed by node id and allocation ordinal, -1 if the allocation has no
+  // slot.
+  std::vector<std::vector<int>> node_slots_;
+
+  mutable mutex mu_;
+  // Live arena allocations, as a map from offset to end offset.
+  std::map<size_t, size_t> live_ GUARDED_BY(mu_);
+  // State of the recording step.
+  int64 next_event_ GUARDED_BY(mu_) = 0;
+  std::vector<Record> records_ GUARDED_BY(mu_);
+  gtl::FlatMap<void*, int> live_records_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StaticMemoryPlan);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_H_
@@ -0,0 +1,167 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_memory_plan.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+BufferLifetime Buffer(size_t size, int64 first_use, int64 last_use) {
+  BufferLifetime buffer;
+  buffer.size = size;
+  buffer.first_use = first_use;
+  buffer.last_use = last_use;
+  return buffer;
+}
+
+TEST(PlanArenaOffsetsTest, DisjointLifetimesShareMemory) {
+  std::vector<size_t> offsets;
+  const size_t arena_size = PlanArenaOffsets(
+      {Buffer(1024, 0, 1), Buffer(1024, 2, 3), Buffer(512, 4, 5)}, &offsets);
+  EXPECT_EQ(1024, arena_size);
+  EXPECT_EQ(std::vector<size_t>({0, 0, 0}), offsets);
+}
+
+TEST(PlanArenaOffsetsTest, OverlappingLifetimesDoNotShareMemory) {
+  std::vector<size_t> offsets;
+  const size_t arena_size = PlanArenaOffsets(
+      {Buffer(256, 0, 3), Buffer(1024, 1, 4), Buffer(512, 2, 5)}, &offsets);
+  EXPECT_EQ(1024 + 512 + 256, arena_size);
+  // Largest first.
+  EXPECT_EQ(1024 + 512, offsets[0]);
+  EXPECT_EQ(0, offsets[1]);
+  EXPECT_EQ(1024, offsets[2]);
+}
+
+TEST(PlanArenaOffsetsTest, ReusesGaps) {
+  std::vector<size_t> offsets;
+  // The third buffer fits in the memory of the first one, which is dead by
+  // the time it is allocated.
+  const size_t arena_size = PlanArenaOffsets(
+      {Buffer(1024, 0, 1), Buffer(1024, 0, 5), Buffer(512, 2, 3)}, &offsets);
+  EXPECT_EQ(2048, arena_size);
+  EXPECT_EQ(0, offsets[0]);
+  EXPECT_EQ(1024, offsets[1]);
+  EXPECT_EQ(0, offsets[2]);
+}
+
+TEST(PlanArenaOffsetsTest, AlignsSizes) {
+  std::vector<size_t> offsets;
+  const size_t arena_size =
+      PlanArenaOffsets({Buffer(1, 0, 1), Buffer(65, 0, 1)}, &offsets);
+  EXPECT_EQ(3 * Allocator::kAllocatorAlignment, arena_size);
+  EXPECT_EQ(2 * Allocator::kAllocatorAlignment, offsets[0]);
+  EXPECT_EQ(0, offsets[1]);
+}
+
+// Runs one step of a fake two-node graph: node 0 produces a temporary that
+// node 1 consumes, and node 1 produces an output that escapes the step.
+void* RunStep(StaticMemoryPlan* plan) {
+  const int64 step = plan->StartStep();
+  Allocator* a0 = plan->NodeAllocator(0);
+  Allocator* a1 = plan->NodeAllocator(1);
+  void* temp = a0->AllocateRaw(Allocator::kAllocatorAlignment, 4096);
+  void* output = a1->AllocateRaw(Allocator::kAllocatorAlignment, 1024);
+  EXPECT_NE(nullptr, temp);
+  EXPECT_NE(nullptr, output);
+  a0->DeallocateRaw(temp);
+  plan->EndStep(step);
+  return output;
+}
+
+TEST(StaticMemoryPlanTest, ServesPlannedAllocationsFromArena) {
+  Allocator* cpu_allocator = tensorflow::cpu_allocator();
+  StaticMemoryPlan* plan = new StaticMemoryPlan(cpu_allocator, 2);
+  core::ScopedUnref unref(plan);
+
+  // Warmup and recording steps.
+  std::vector<void*> outputs;
+  outputs.push_back(RunStep(plan));
+  outputs.push_back(RunStep(plan));
+  StaticMemoryPlan::Stats stats = plan->GetStats();
+  EXPECT_EQ(0, stats.num_arena_allocations);
+  EXPECT_EQ(4, stats.num_allocator_allocations);
+  // Only the temporary is planned, the output escapes the step.
+  EXPECT_EQ(4096, stats.arena_bytes);
+
+  outputs.push_back(RunStep(plan));
+  stats = plan->GetStats();
+  EXPECT_EQ(1, stats.num_arena_allocations);
+  EXPECT_EQ(5, stats.num_allocator_allocations);
+
+  for (void* output : outputs) {
+    plan->NodeAllocator(1)->DeallocateRaw(output);
+  }
+}
+
+TEST(StaticMemoryPlanTest, FallsBackToDeviceAllocator) {
+  StaticMemoryPlan* plan =
+      new StaticMemoryPlan(tensorflow::cpu_allocator(), 2);
+  core::ScopedUnref unref(plan);
+  plan->NodeAllocator(1)->DeallocateRaw(RunStep(plan));
+  plan->NodeAllocator(1)->DeallocateRaw(RunStep(plan));
+
+  const int64 step = plan->StartStep();
+  Allocator* a0 = plan->NodeAllocator(0);
+  // Larger than planned.
+  void* large = a0->AllocateRaw(Allocator::kAllocatorAlignment, 8192);
+  // Not planned: the node made a single allocation in the recording step.
+  void* unplanned = a0->AllocateRaw(Allocator::kAllocatorAlignment, 16);
+  EXPECT_EQ(0, plan->GetStats().num_arena_allocations);
+  a0->DeallocateRaw(large);
+  a0->DeallocateRaw(unplanned);
+  plan->EndStep(step);
+
+  // The slot of the temporary is still in use in the next step.
+  void* temp = nullptr;
+  {
+    const int64 step = plan->StartStep();
+    temp = a0->AllocateRaw(Allocator::kAllocatorAlignment, 4096);
+    plan->EndStep(step);
+  }
+  EXPECT_EQ(1, plan->GetStats().num_arena_allocations);
+  {
+    const int64 step = plan->StartStep();
+    void* overlapping = a0->AllocateRaw(Allocator::kAllocatorAlignment, 4096);
+    EXPECT_NE(temp, overlapping);
+    EXPECT_EQ(1, plan->GetStats().num_arena_allocations);
+    a0->DeallocateRaw(overlapping);
+    plan->EndStep(step);
+  }
+  a0->DeallocateRaw(temp);
+}
+
+TEST(StaticMemoryPlanTest, OutlivesItsAllocations) {
+  StaticMemoryPlan* plan =
+      new StaticMemoryPlan(tensorflow::cpu_allocator(), 2);
+  plan->NodeAllocator(1)->DeallocateRaw(RunStep(plan));
+  plan->NodeAllocator(1)->DeallocateRaw(RunStep(plan));
+
+  plan->StartStep();
+  Allocator* a0 = plan->NodeAllocator(0);
+  void* temp = a0->AllocateRaw(Allocator::kAllocatorAlignment, 4096);
+  EXPECT_EQ(1, plan->GetStats().num_arena_allocations);
+  // Drop the reference of the owner, the allocation keeps the plan alive.
+  EXPECT_FALSE(plan->Unref());
+  a0->DeallocateRaw(temp);
+}
+
+}  // namespace
+}  // namespace tensorflow
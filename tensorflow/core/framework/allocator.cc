@@ -28,7 +28,7 @@ limitations under the License.
 namespace tensorflow {
 
 string AllocatorStats::DebugString() const {
-  return strings::Printf(
+  string result = strings::Printf(
       "Limit:        %20lld\n"
       "InUse:        %20lld\n"
       "MaxInUse:     %20lld\n"
@@ -36,6 +36,13 @@ string AllocatorStats::DebugString() const {
       "MaxAllocSize: %20lld\n",
       this->bytes_limit ? *this->bytes_limit : 0, this->bytes_in_use,
       this->peak_bytes_in_use, this->num_allocs, this->largest_alloc_size);
+  if (this->num_cache_hits > 0 || this->num_cache_misses > 0) {
+    strings::Appendf(&result,
+                     "CacheHits:    %20lld\n"
+                     "CacheMisses:  %20lld\n",
+                     this->num_cache_hits, this->num_cache_misses);
+  }
+  return result;
 }
 
 constexpr size_t Allocator::kAllocatorAlignment;
@@ -82,13 +82,20 @@ struct AllocatorStats {
   // if such a limit is known.
   absl::optional<int64> bytes_reservable_limit;
 
+  // Stats for allocators that serve some allocations from a cache in front
+  // of their main data structures.
+  int64 num_cache_hits;    // Allocations served from the cache.
+  int64 num_cache_misses;  // Cacheable allocations that missed the cache.
+
   AllocatorStats()
       : num_allocs(0),
         bytes_in_use(0),
         peak_bytes_in_use(0),
         largest_alloc_size(0),
         bytes_reserved(0),
-        peak_bytes_reserved(0) {}
+        peak_bytes_reserved(0),
+        num_cache_hits(0),
+        num_cache_misses(0) {}
 
   string DebugString() const;
 };
@@ -17,7 +17,10 @@ limitations under the License.
 
 #include <memory>
 
+#include "absl/memory/memory.h"
 #include "absl/time/clock.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 
 namespace tensorflow {
@@ -140,6 +143,11 @@ class InterleaveMany : public Node {
         Args{id_, name_, std::move(output)});
   }
 
+  void RecordClassLocked(AutotuneRound::Node* node) const override
+      SHARED_LOCKS_REQUIRED(mu_) {
+    node->set_node_class(NodeClass::INTERLEAVE_MANY);
+  }
+
   // The output time is the sum of the self processing time and the average
   // output time of inputs comprising the interleave "cycle".
   double OutputTimeLocked(std::vector<double>* input_times,
@@ -232,6 +240,11 @@ class AsyncInterleaveMany : public Node {
         Args{id_, name_, std::move(output)}, parameters);
   }
 
+  void RecordClassLocked(AutotuneRound::Node* node) const override
+      SHARED_LOCKS_REQUIRED(mu_) {
+    node->set_node_class(NodeClass::ASYNC_INTERLEAVE_MANY);
+  }
+
   // The output time is estimated using `ComputeWaitTime(output_time,
   // input_time, parallelism, ...)`, where `output_time` is the sum of the
   // self-processing time and the average output time of inputs comprising the
@@ -338,6 +351,12 @@ class KnownRatio : public Node {
                                         ratio_);
   }
 
+  void RecordClassLocked(AutotuneRound::Node* node) const override
+      SHARED_LOCKS_REQUIRED(mu_) {
+    node->set_node_class(NodeClass::KNOWN_RATIO);
+    node->set_ratio(ratio_);
+  }
+
   // The output time is the sum of the self processing time and the product of
   // `ratio_` and the sum of output times of inputs.
   double OutputTimeLocked(std::vector<double>* input_times,
@@ -414,6 +433,12 @@ class AsyncKnownRatio : public Node {
         Args{id_, name_, std::move(output)}, ratio_, parameters);
   }
 
+  void RecordClassLocked(AutotuneRound::Node* node) const override
+      SHARED_LOCKS_REQUIRED(mu_) {
+    node->set_node_class(NodeClass::ASYNC_KNOWN_RATIO);
+    node->set_ratio(ratio_);
+  }
+
   // The output time is estimated using `ComputeWaitTime(output_time,
   // input_time, parallelism, ...)`, where `output_time` is the sum of the self
   // processing time and the product of `ratio_` and the sum of output times of
@@ -539,6 +564,11 @@ class UnknownRatio : public Node {
     return std::make_shared<UnknownRatio>(Args{id_, name_, std::move(output)});
   }
 
+  void RecordClassLocked(AutotuneRound::Node* node) const override
+      SHARED_LOCKS_REQUIRED(mu_) {
+    node->set_node_class(NodeClass::UNKNOWN_RATIO);
+  }
+
   // The output time is the sum of the self processing time and the product of
   // the ratio estimate and the sum of output times of inputs.
   double OutputTimeLocked(std::vector<double>* input_times,
@@ -626,8 +656,126 @@ class Unknown : public Node {
   }
 };
 
+// Collects the nodes in the subtree rooted in the given node for which
+// autotuning is enabled, keyed by their (unique) name.
+void CollectNodes(std::shared_ptr<Node> node,
+                  std::map<string, std::shared_ptr<Node>>* nodes) {
+  if (!node->autotune()) {
+    return;
+  }
+  nodes->insert(std::make_pair(node->long_name(), node));
+  for (auto& input : node->inputs()) {
+    CollectNodes(input, nodes);
+  }
+}
+
+// Reconstructs the subtree rooted in the node `id` of a trace round. The values
+// of tunable parameters are taken from `parameter_values` when present there.
+Status NodeFromTrace(const std::map<int64, const AutotuneRound::Node*>& nodes,
+                     int64 id, std::shared_ptr<Node> output,
+                     const std::map<string, double>& parameter_values,
+                     int depth, std::shared_ptr<Node>* result) {
+  const AutotuneRound::Node* const* node_trace = gtl::FindOrNull(nodes, id);
+  if (!node_trace) {
+    return errors::DataLoss("Node ", id, " is missing from the trace.");
+  }
+  // Bounds the recursion if the trace is corrupted into a cycle.
+  if (depth > nodes.size()) {
+    return errors::DataLoss("The trace contains a cycle through node ", id,
+                            ".");
+  }
+  Node::Args args{id, (*node_trace)->name(), output};
+  std::vector<std::shared_ptr<Parameter>> parameters;
+  for (const auto& parameter_trace : (*node_trace)->parameters()) {
+    auto state = std::make_shared<SharedState>(
+        parameter_trace.tunable() ? kAutotune : parameter_trace.value(),
+        std::make_shared<mutex>(), std::make_shared<condition_variable>());
+    state->value = parameter_trace.value();
+    parameters.push_back(MakeParameter(parameter_trace.name(), state,
+                                       parameter_trace.min(),
+                                       parameter_trace.max()));
+  }
+  std::shared_ptr<Node> node;
+  switch ((*node_trace)->node_class()) {
+    case NodeClass::INTERLEAVE_MANY:
+      node = MakeInterleaveManyNode(std::move(args));
+      break;
+    case NodeClass::ASYNC_INTERLEAVE_MANY:
+      node = MakeAsyncInterleaveManyNode(std::move(args), parameters);
+      break;
+    case NodeClass::KNOWN_RATIO:
+      node = MakeKnownRatioNode(std::move(args), (*node_trace)->ratio());
+      break;
+    case NodeClass::ASYNC_KNOWN_RATIO:
+      node = MakeAsyncKnownRatioNode(std::move(args), (*node_trace)->ratio(),
+                                     parameters);
+      break;
+    case NodeClass::UNKNOWN_RATIO:
+      node = MakeUnknownRatioNode(std::move(args));
+      break;
+    default:
+      node = MakeUnknownNode(std::move(args));
+      break;
+  }
+  node->RestoreTrace(**node_trace);
+  for (auto& parameter : parameters) {
+    auto* value = gtl::FindOrNull(parameter_values, node->long_name());
+    if (value && parameter->state->tunable) {
+      parameter->state->value = *value;
+      parameter->value = *value;
+    }
+  }
+  for (int64 input_id : (*node_trace)->inputs()) {
+    std::shared_ptr<Node> input;
+    TF_RETURN_IF_ERROR(NodeFromTrace(nodes, input_id, node, parameter_values,
+                                     depth + 1, &input));
+    node->add_input(std::move(input));
+  }
+  *result = std::move(node);
+  return Status::OK();
+}
+
 }  // namespace
 
+void Node::RecordTrace(AutotuneRound* round) const {
+  std::list<std::shared_ptr<Node>> inputs;
+  std::vector<std::pair<AutotuneRound::Parameter*, std::shared_ptr<Parameter>>>
+      parameters;
+  {
+    tf_shared_lock l(mu_);
+    AutotuneRound::Node* node = round->add_nodes();
+    node->set_id(id_);
+    node->set_name(name_);
+    RecordClassLocked(node);
+    node->set_autotune(autotune_);
+    node->set_buffered_bytes(buffered_bytes_);
+    node->set_buffered_elements(buffered_elements_);
+    node->set_processing_time(processing_time_);
+    node->set_num_elements(num_elements_);
+    for (auto& pair : parameters_) {
+      AutotuneRound::Parameter* parameter = node->add_parameters();
+      parameter->set_name(pair.second->name);
+      parameter->set_min(pair.second->min);
+      parameter->set_max(pair.second->max);
+      parameter->set_tunable(pair.second->state->tunable);
+      parameters.push_back(std::make_pair(parameter, pair.second));
+    }
+    for (auto& input : inputs_) {
+      node->add_inputs(input->id());
+    }
+    inputs = inputs_;
+  }
+  // The parameter state is read without holding the node lock, as input
+  // pipeline threads acquire the two locks in the opposite order.
+  for (auto& pair : parameters) {
+    mutex_lock l(*pair.second->state->mu);
+    pair.first->set_value(pair.second->state->value);
+  }
+  for (auto& input : inputs) {
+    input->RecordTrace(round);
+  }
+}
+
 std::shared_ptr<Parameter> MakeParameter(const string& name,
                                          std::shared_ptr<SharedState> state,
                                          double min, double max) {
@@ -713,12 +861,94 @@ void Model::AddProcessingTime(const string& name, int64 delta) {
 
 void Model::Optimize(AutotuneAlgorithm algorithm, int64 cpu_budget,
                      int64 ram_budget) {
+  std::shared_ptr<Node> snapshot;
+  {
+    tf_shared_lock lock(mu_);
+    snapshot = output_->Snapshot(nullptr);
+  }
+  const int64 now_nanos = absl::GetCurrentTimeNanos();
+  RecordTrace(snapshot, now_nanos, cpu_budget, ram_budget);
+  OptimizeSnapshot(algorithm, snapshot, now_nanos, cpu_budget, ram_budget);
+}
+
+Status Model::StartTrace(Env* env, const string& filename) {
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(filename, &file));
+  mutex_lock l(trace_mu_);
+  trace_writer_.reset();
+  trace_file_ = std::move(file);
+  trace_writer_ = absl::make_unique<io::RecordWriter>(trace_file_.get());
+  return Status::OK();
+}
+
+Status Model::ReplayTrace(Env* env, const string& filename,
+                          AutotuneAlgorithm algorithm,
+                          AutotuneReplayResult* result) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  io::SequentialRecordReader reader(file.get());
+  Model model([](std::shared_ptr<Node>) {});
+  std::map<string, double> parameter_values;
+  std::map<string, int> directions;
+  *result = AutotuneReplayResult();
+  while (true) {
+    tstring record;
+    Status s = reader.ReadRecord(&record);
+    if (errors::IsOutOfRange(s)) {
+      break;
+    }
+    TF_RETURN_IF_ERROR(s);
+    AutotuneRound round;
+    if (!round.ParseFromArray(record.data(), record.size())) {
+      return errors::DataLoss("Failed to parse an autotune round in ",
+                              filename, ".");
+    }
+    std::map<int64, const AutotuneRound::Node*> nodes;
+    for (const auto& node : round.nodes()) {
+      nodes[node.id()] = &node;
+    }
+    std::shared_ptr<Node> snapshot;
+    TF_RETURN_IF_ERROR(NodeFromTrace(nodes, round.output(), nullptr,
+                                     parameter_values, /*depth=*/0, &snapshot));
+    model.OptimizeSnapshot(algorithm, snapshot, round.time_nanos(),
+                           round.cpu_budget(), round.ram_budget());
+
+    std::map<string, double> new_values;
+    for (auto& pair : model.CollectTunableParameters(snapshot)) {
+      mutex_lock l(*pair.second->state->mu);
+      new_values[pair.first] = pair.second->state->value;
+    }
+    for (auto& pair : new_values) {
+      auto* old_value = gtl::FindOrNull(parameter_values, pair.first);
+      if (!old_value || *old_value == pair.second) {
+        continue;
+      }
+      const int direction = pair.second > *old_value ? 1 : -1;
+      int& last_direction = directions[pair.first];
+      ++result->num_changes;
+      if (last_direction == -direction) {
+        ++result->num_reversals;
+      }
+      last_direction = direction;
+    }
+    parameter_values = new_values;
+    result->parameter_values.push_back(std::move(new_values));
+  }
+  return Status::OK();
+}
+
+void Model::OptimizeSnapshot(AutotuneAlgorithm algorithm,
+                             std::shared_ptr<Node> snapshot, int64 now_nanos,
+                             int64 cpu_budget, int64 ram_budget) {
   switch (algorithm) {
     case AutotuneAlgorithm::HILL_CLIMB:
-      OptimizeHillClimb(cpu_budget, ram_budget);
+      OptimizeHillClimb(snapshot, cpu_budget, ram_budget);
       break;
     case AutotuneAlgorithm::GRADIENT_DESCENT:
-      OptimizeGradientDescent(cpu_budget, ram_budget);
+      OptimizeGradientDescent(snapshot, cpu_budget, ram_budget);
+      break;
+    case AutotuneAlgorithm::FEEDBACK:
+      OptimizeFeedback(snapshot, now_nanos, cpu_budget, ram_budget);
       break;
   }
 }
@@ -807,12 +1037,8 @@ std::map<string, std::shared_ptr<Parameter>> Model::CollectEssentialParallelism(
   return essential_parameters;
 }
 
-void Model::OptimizeGradientDescent(int64 cpu_budget, int64 ram_budget) {
-  std::shared_ptr<Node> snapshot;
-  {
-    tf_shared_lock lock(mu_);
-    snapshot = output_->Snapshot(nullptr);
-  }
+void Model::OptimizeGradientDescent(std::shared_ptr<Node> snapshot,
+                                    int64 cpu_budget, int64 ram_budget) {
   VLOG(2) << "Starting optimization of tunable parameters with GradientDescent";
   auto parameters = CollectTunableParameters(snapshot);
   auto essential_parameters = CollectEssentialParallelism(snapshot);
@@ -883,12 +1109,8 @@ void Model::OptimizeGradientDescent(int64 cpu_budget, int64 ram_budget) {
   }
 }
 
-void Model::OptimizeHillClimb(int64 cpu_budget, int64 ram_budget) {
-  std::shared_ptr<Node> snapshot;
-  {
-    tf_shared_lock lock(mu_);
-    snapshot = output_->Snapshot(nullptr);
-  }
+void Model::OptimizeHillClimb(std::shared_ptr<Node> snapshot, int64 cpu_budget,
+                              int64 ram_budget) {
   VLOG(2) << "Starting optimization of tunable parameters with HillClimb";
   const double processing_time = TotalProcessingTime(snapshot);
   auto parameters = CollectTunableParameters(snapshot);
@@ -951,6 +1173,191 @@ void Model::OptimizeHillClimb(int64 cpu_budget, int64 ram_budget) {
   }
 }
 
+void Model::OptimizeFeedback(std::shared_ptr<Node> snapshot, int64 now_nanos,
+                             int64 cpu_budget, int64 ram_budget) {
+  VLOG(2) << "Starting optimization of tunable parameters with Feedback";
+  auto parameters = CollectTunableParameters(snapshot);
+  std::map<string, std::shared_ptr<Node>> nodes;
+  CollectNodes(snapshot, &nodes);
+  // We add the number of model's buffered bytes because it is excluded from the
+  // memory budget, but it is included in the maximum number of buffered bytes.
+  ram_budget += TotalBufferedBytes(snapshot);
+  // Weight of the latest observation in the smoothed statistics.
+  constexpr double kSmoothing = 0.5L;
+  // A node is saturated if this fraction of its threads is busy on average.
+  constexpr double kSaturation = 0.9L;
+  // A buffer is drained below this occupancy and full above that occupancy.
+  constexpr double kLowOccupancy = 0.25L;
+  constexpr double kHighOccupancy = 0.9L;
+  // Number of consecutive rounds a change needs to be proposed in before it is
+  // made. Decreases wait longer since under-provisioning a parameter is more
+  // costly than over-provisioning it.
+  constexpr int kIncreaseRounds = 2;
+  constexpr int kDecreaseRounds = 3;
+
+  mutex_lock l(feedback_mu_);
+  for (auto it = feedback_states_.begin(); it != feedback_states_.end();) {
+    if (parameters.count(it->first)) {
+      ++it;
+    } else {
+      it = feedback_states_.erase(it);
+    }
+  }
+  double total_parallelism = 0;
+  for (auto& pair : parameters) {
+    auto& parameter = pair.second;
+    {
+      mutex_lock l2(*parameter->state->mu);
+      parameter->value = parameter->state->value;
+    }
+    parameter->value =
+        std::min(std::max(parameter->value, parameter->min), parameter->max);
+    if (parameter->name == kParallelism) {
+      total_parallelism += parameter->value;
+    }
+  }
+  std::vector<Parameter*> increased_parameters;
+  for (auto& pair : parameters) {
+    auto& parameter = pair.second;
+    auto* node = gtl::FindOrNull(nodes, pair.first);
+    if (!node) {
+      continue;
+    }
+    const int64 processing_time = (*node)->processing_time();
+    const double occupancy =
+        std::min(1.0, static_cast<double>((*node)->buffered_elements()) /
+                          std::max(parameter->value, 1.0));
+    auto it = feedback_states_.find(pair.first);
+    if (it == feedback_states_.end()) {
+      // The first observation of a parameter only establishes the baseline.
+      FeedbackState state;
+      state.time_nanos = now_nanos;
+      state.processing_time = processing_time;
+      state.occupancy = occupancy;
+      feedback_states_.insert(std::make_pair(pair.first, state));
+      continue;
+    }
+    FeedbackState& state = it->second;
+    const int64 elapsed_nanos = now_nanos - state.time_nanos;
+    if (elapsed_nanos <= 0) {
+      continue;
+    }
+    // By Little's law, the processing time accumulated per unit of wall time is
+    // the average number of busy threads.
+    const double busy_threads =
+        static_cast<double>(processing_time - state.processing_time) /
+        static_cast<double>(elapsed_nanos);
+    state.time_nanos = now_nanos;
+    state.processing_time = processing_time;
+    state.busy_threads =
+        kSmoothing * busy_threads + (1.0L - kSmoothing) * state.busy_threads;
+    state.occupancy =
+        kSmoothing * occupancy + (1.0L - kSmoothing) * state.occupancy;
+
+    int direction = 0;
+    if (parameter->name == kParallelism) {
+      if (state.busy_threads >= kSaturation * parameter->value &&
+          state.occupancy < kLowOccupancy) {
+        direction = 1;
+      } else if (std::ceil(state.busy_threads / kSaturation) + 1 <
+                 parameter->value) {
+        direction = -1;
+      }
+    } else if (state.occupancy < kLowOccupancy) {
+      direction = 1;
+    } else if (state.occupancy > kHighOccupancy) {
+      direction = -1;
+    }
+    if (direction == 0 || direction != state.direction) {
+      state.direction = direction;
+      state.num_rounds = 0;
+    }
+    if (direction == 0 ||
+        ++state.num_rounds < (direction > 0 ? kIncreaseRounds
+                                            : kDecreaseRounds)) {
+      continue;
+    }
+    state.num_rounds = 0;
+    const double new_value = parameter->value + direction;
+    if (new_value < parameter->min || new_value > parameter->max) {
+      continue;
+    }
+    if (parameter->name == kParallelism) {
+      if (direction > 0 && total_parallelism + 1 > cpu_budget) {
+        continue;
+      }
+      total_parallelism += direction;
+    }
+    parameter->value = new_value;
+    if (direction > 0) {
+      increased_parameters.push_back(parameter.get());
+    }
+  }
+  // Drop the increases if they exceed the memory budget and shrink the largest
+  // buffers until the model fits into the budget, starting with the buffer
+  // size parameters since shrinking them does not reduce parallelism.
+  if (TotalMaximumBufferedBytes(snapshot) > ram_budget) {
+    for (Parameter* parameter : increased_parameters) {
+      parameter->value--;
+    }
+  }
+  while (TotalMaximumBufferedBytes(snapshot) > ram_budget) {
+    Parameter* largest = nullptr;
+    for (auto& pair : parameters) {
+      Parameter* parameter = pair.second.get();
+      if (parameter->value <= parameter->min) {
+        continue;
+      }
+      if (!largest ||
+          (parameter->name == kBufferSize && largest->name != kBufferSize) ||
+          (parameter->name == largest->name &&
+           parameter->value > largest->value)) {
+        largest = parameter;
+      }
+    }
+    if (!largest) {
+      break;
+    }
+    largest->value--;
+  }
+  for (auto& pair : parameters) {
+    auto& parameter = pair.second;
+    mutex_lock l2(*parameter->state->mu);
+    if (parameter->state->value != parameter->value) {
+      VLOG(2) << "Setting tunable parameter " << pair.first << " to "
+              << parameter->value;
+      parameter->state->value = parameter->value;
+      parameter->state->cond_var->notify_all();
+    }
+  }
+}
+
+void Model::RecordTrace(std::shared_ptr<Node> snapshot, int64 now_nanos,
+                        int64 cpu_budget, int64 ram_budget) {
+  mutex_lock l(trace_mu_);
+  if (!trace_writer_) {
+    return;
+  }
+  AutotuneRound round;
+  round.set_time_nanos(now_nanos);
+  round.set_cpu_budget(cpu_budget);
+  round.set_ram_budget(ram_budget);
+  round.set_output(snapshot->id());
+  snapshot->RecordTrace(&round);
+  string record;
+  round.SerializeToString(&record);
+  Status s = trace_writer_->WriteRecord(record);
+  if (s.ok()) {
+    s = trace_writer_->Flush();
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to record the autotune trace, recording stops: "
+                 << s;
+    trace_writer_.reset();
+    trace_file_.reset();
+  }
+}
+
 double Model::OutputTime(std::shared_ptr<Node> node,
                          std::map<string, double>* gradient) {
   std::vector<double> input_times(1, 0);
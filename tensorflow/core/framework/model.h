@@ -23,10 +23,12 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "tensorflow/core/framework/model.pb.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
@@ -43,6 +45,7 @@ constexpr char kBufferSize[] = "buffer_size";
 enum class AutotuneAlgorithm {
   HILL_CLIMB = 0,
   GRADIENT_DESCENT = 1,
+  FEEDBACK = 2,
 };
 
 // Represents thread-safe state that can be shared between an input pipeline and
@@ -261,6 +264,20 @@ class Node {
     }
   }
 
+  // Appends the state of the subtree rooted in this node to `round`, in
+  // depth-first order.
+  void RecordTrace(AutotuneRound* round) const LOCKS_EXCLUDED(mu_);
+
+  // Restores the statistics of this node from its state recorded in a trace.
+  void RestoreTrace(const AutotuneRound::Node& node) LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    autotune_ = node.autotune();
+    buffered_bytes_ = node.buffered_bytes();
+    buffered_elements_ = node.buffered_elements();
+    processing_time_ = node.processing_time();
+    num_elements_ = node.num_elements();
+  }
+
   // Returns a human-readable representation of this node.
   string DebugString() const LOCKS_EXCLUDED(mu_) {
     tf_shared_lock l(mu_);
@@ -390,6 +407,12 @@ class Node {
   virtual std::shared_ptr<Node> Clone(std::shared_ptr<Node> output) const
       SHARED_LOCKS_REQUIRED(mu_) = 0;
 
+  // Records the class of this node and its class-specific arguments in `node`.
+  virtual void RecordClassLocked(AutotuneRound::Node* node) const
+      SHARED_LOCKS_REQUIRED(mu_) {
+    node->set_node_class(NodeClass::UNKNOWN);
+  }
+
   // Returns the average size of an element buffered in this node.
   double AverageBufferedElementSize() const SHARED_LOCKS_REQUIRED(mu_) {
     if (buffered_elements_ == 0) {
@@ -548,6 +571,22 @@ std::shared_ptr<Node> MakeUnknownRatioNode(Node::Args args);
 // as pass-through between inputs and output.
 std::shared_ptr<Node> MakeUnknownNode(Node::Args args);
 
+// Summary of the decisions made by an autotuning algorithm when replaying a
+// trace, see `Model::ReplayTrace()`.
+struct AutotuneReplayResult {
+  // The values of the tunable parameters after each round, keyed by the
+  // (unique) name of their node.
+  std::vector<std::map<string, double>> parameter_values;
+
+  // The number of times a parameter value changed between rounds.
+  int64 num_changes = 0;
+
+  // The number of times a parameter value changed in the opposite direction
+  // than in its previous change. A high ratio of reversals to changes
+  // indicates that the algorithm oscillates.
+  int64 num_reversals = 0;
+};
+
 // Abstract representation of a TensorFlow input pipeline that can be used
 // for collecting runtime information and optimizing performance. It collects
 // runtime information about execution of the input pipeline that is used to
@@ -588,6 +627,23 @@ class Model {
   void Optimize(AutotuneAlgorithm algorithm, int64 cpu_budget, int64 ram_budget)
       LOCKS_EXCLUDED(mu_);
 
+  // Starts recording the state of the model observed by each subsequent
+  // `Optimize()` call to `filename`, as a TFRecord file of serialized
+  // `AutotuneRound` protos. The trace can be replayed with `ReplayTrace()`.
+  Status StartTrace(Env* env, const string& filename) LOCKS_EXCLUDED(trace_mu_);
+
+  // Replays the rounds of the trace recorded in `filename` with the given
+  // algorithm and summarizes its decisions in `result`.
+  //
+  // The observed statistics of each round are the recorded ones, but the
+  // parameter values are the ones that the algorithm chose in the previous
+  // round, so that different algorithms can be compared offline on the same
+  // trace. As the trace does not react to the decisions, the replay measures
+  // the stability of an algorithm rather than its effect on throughput.
+  static Status ReplayTrace(Env* env, const string& filename,
+                            AutotuneAlgorithm algorithm,
+                            AutotuneReplayResult* result);
+
   // Records that a node has produced an element.
   void RecordElement(const string& name) LOCKS_EXCLUDED(mu_);
 
@@ -619,13 +675,20 @@ class Model {
   std::map<string, std::shared_ptr<Parameter>> CollectEssentialParallelism(
       std::shared_ptr<Node> node);
 
+  // Optimizes the tunable parameters of the given snapshot of the model with
+  // the given algorithm, as of `now_nanos`.
+  void OptimizeSnapshot(AutotuneAlgorithm algorithm,
+                        std::shared_ptr<Node> snapshot, int64 now_nanos,
+                        int64 cpu_budget, int64 ram_budget);
+
   // This optimization algorithm starts by setting all tunable parallelism
   // parameters to the minimum value. It then repeatedly identifies the
   // parameter whose increase in parallelism decreases the output time the most.
   // This process is repeated until all parameters reach their maximum values or
   // the projected output time is less than or equal to the processing time
   // needed to produce an element divided by CPU budget.
-  void OptimizeHillClimb(int64 cpu_budget, int64 ram_budget);
+  void OptimizeHillClimb(std::shared_ptr<Node> snapshot, int64 cpu_budget,
+                         int64 ram_budget);
 
   // This optimization algorithm starts by setting all tunable parallelism
   // parameters to the minimum value. It then improves current parameters by
@@ -634,7 +697,35 @@ class Model {
   // repeated until either the output time improvement is smaller than threshold
   // value or the output time is less than the processing time needed to produce
   // an element divided by CPU budget.
-  void OptimizeGradientDescent(int64 cpu_budget, int64 ram_budget);
+  void OptimizeGradientDescent(std::shared_ptr<Node> snapshot, int64 cpu_budget,
+                               int64 ram_budget);
+
+  // This optimization algorithm is a feedback controller that starts from the
+  // current parameter values and moves each parameter by at most one step per
+  // round, based on the throughput and buffer occupancy observed since the
+  // previous round rather than on the analytical output time:
+  //
+  // - by Little's law, the processing time a node accumulated per unit of wall
+  //   time is the average number of its busy threads. Parallelism is increased
+  //   when all threads are busy and the consumer finds the buffer empty, and is
+  //   decreased when at least two fewer threads would keep up;
+  // - a buffer size is increased when the consumer keeps draining the buffer
+  //   and decreased when the buffer stays full.
+  //
+  // Observations are smoothed across rounds and a change is only made once it
+  // has been proposed in several consecutive rounds, which prevents the
+  // parameters from oscillating. Increases are dropped if they would exceed the
+  // CPU or RAM budget, and buffers are shrunk while the model exceeds the RAM
+  // budget.
+  void OptimizeFeedback(std::shared_ptr<Node> snapshot, int64 now_nanos,
+                        int64 cpu_budget, int64 ram_budget)
+      LOCKS_EXCLUDED(feedback_mu_);
+
+  // Appends the state of the given snapshot of the model to the trace, if one
+  // is being recorded.
+  void RecordTrace(std::shared_ptr<Node> snapshot, int64 now_nanos,
+                   int64 cpu_budget, int64 ram_budget)
+      LOCKS_EXCLUDED(trace_mu_);
 
   // Collects the output time and if `gradient` is not `nullptr`, the output
   // time gradient w.r.t. tunable parameters of the subtree rooted in the given
@@ -673,6 +764,32 @@ class Model {
 
   // A hook invoked immediately before a node is removed from the model.
   const NodeHook remove_node_hook_;
+
+  // State of the `FEEDBACK` algorithm for a tunable parameter, carried across
+  // optimization rounds.
+  struct FeedbackState {
+    // Statistics of the parameter's node at the previous round.
+    int64 time_nanos = 0;
+    int64 processing_time = 0;
+
+    // Smoothed average number of busy threads of the node.
+    double busy_threads = 0;
+
+    // Smoothed fraction of the buffer that is occupied.
+    double occupancy = 0;
+
+    // Direction of the change proposed in the previous rounds and the number
+    // of consecutive rounds it has been proposed for.
+    int direction = 0;
+    int num_rounds = 0;
+  };
+
+  mutex feedback_mu_;
+  std::map<string, FeedbackState> feedback_states_ GUARDED_BY(feedback_mu_);
+
+  mutex trace_mu_;
+  std::unique_ptr<WritableFile> trace_file_ GUARDED_BY(trace_mu_);
+  std::unique_ptr<io::RecordWriter> trace_writer_ GUARDED_BY(trace_mu_);
 };
 
 }  // namespace model
@@ -16,7 +16,10 @@ limitations under the License.
 #include "tensorflow/core/framework/model.h"
 #include <memory>
 
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -727,6 +730,163 @@ TEST(UnknownGradientTest, Model) {
               (new_output_time - output_time) / kParameterStep,
               kComparisonPrecision);
 }
+
+// Returns a trace round of a pipeline with a single asynchronous node with the
+// given tunable parameter, observed `seconds` into the trace.
+AutotuneRound MakeRound(const string& parameter_name, double value,
+                        int64 seconds, int64 processing_time,
+                        int64 buffered_elements) {
+  constexpr int64 kNanosPerSecond = 1000 * 1000 * 1000;
+  AutotuneRound round;
+  round.set_time_nanos(seconds * kNanosPerSecond);
+  round.set_cpu_budget(4);
+  round.set_ram_budget(1 << 30);
+  round.set_output(1);
+  AutotuneRound::Node* node = round.add_nodes();
+  node->set_id(1);
+  node->set_name("async");
+  node->set_node_class(NodeClass::ASYNC_KNOWN_RATIO);
+  node->set_ratio(1);
+  node->set_autotune(true);
+  node->set_buffered_bytes(buffered_elements * 1000);
+  node->set_buffered_elements(buffered_elements);
+  node->set_processing_time(processing_time * kNanosPerSecond);
+  node->set_num_elements(seconds * 100);
+  node->add_inputs(2);
+  AutotuneRound::Parameter* parameter = node->add_parameters();
+  parameter->set_name(parameter_name);
+  parameter->set_value(value);
+  parameter->set_min(1);
+  parameter->set_max(8);
+  parameter->set_tunable(true);
+  AutotuneRound::Node* source = round.add_nodes();
+  source->set_id(2);
+  source->set_name("source");
+  source->set_node_class(NodeClass::KNOWN_RATIO);
+  source->set_autotune(true);
+  return round;
+}
+
+string WriteTrace(const string& name,
+                  const std::vector<AutotuneRound>& rounds) {
+  const string filename = io::JoinPath(testing::TmpDir(), name);
+  std::unique_ptr<WritableFile> file;
+  TF_CHECK_OK(Env::Default()->NewWritableFile(filename, &file));
+  io::RecordWriter writer(file.get());
+  for (const AutotuneRound& round : rounds) {
+    TF_CHECK_OK(writer.WriteRecord(round.SerializeAsString()));
+  }
+  TF_CHECK_OK(writer.Close());
+  TF_CHECK_OK(file->Close());
+  return filename;
+}
+
+TEST(FeedbackTest, IncreasesParallelismOfSaturatedNode) {
+  // All threads are busy and the buffer is empty.
+  std::vector<AutotuneRound> rounds;
+  for (int i = 0; i < 12; ++i) {
+    rounds.push_back(MakeRound(kParallelism, 1, i, 8 * i, 0));
+  }
+  AutotuneReplayResult result;
+  TF_ASSERT_OK(Model::ReplayTrace(Env::Default(),
+                                  WriteTrace("saturated", rounds),
+                                  AutotuneAlgorithm::FEEDBACK, &result));
+  ASSERT_EQ(rounds.size(), result.parameter_values.size());
+  // Parallelism increases by one every other round until it reaches the CPU
+  // budget.
+  std::vector<double> values;
+  for (const auto& parameter_values : result.parameter_values) {
+    values.push_back(parameter_values.at("async(id:1)"));
+  }
+  EXPECT_EQ(std::vector<double>({1, 1, 2, 2, 3, 3, 4, 4, 4, 4, 4, 4}), values);
+  EXPECT_EQ(3, result.num_changes);
+  EXPECT_EQ(0, result.num_reversals);
+}
+
+TEST(FeedbackTest, DecreasesParallelismOfIdleNode) {
+  // One thread out of eight is busy and the buffer is full.
+  std::vector<AutotuneRound> rounds;
+  for (int i = 0; i < 30; ++i) {
+    rounds.push_back(MakeRound(kParallelism, 8, i, i, 8));
+  }
+  AutotuneReplayResult result;
+  TF_ASSERT_OK(Model::ReplayTrace(Env::Default(), WriteTrace("idle", rounds),
+                                  AutotuneAlgorithm::FEEDBACK, &result));
+  ASSERT_EQ(rounds.size(), result.parameter_values.size());
+  // A margin of one thread is kept over the two threads needed.
+  EXPECT_EQ(3, result.parameter_values.back().at("async(id:1)"));
+  EXPECT_EQ(0, result.num_reversals);
+}
+
+TEST(FeedbackTest, IgnoresNoisyObservations) {
+  // The node alternates between saturated and mostly idle rounds.
+  std::vector<AutotuneRound> rounds;
+  int64 processing_time = 0;
+  for (int i = 0; i < 30; ++i) {
+    rounds.push_back(
+        MakeRound(kParallelism, 4, i, processing_time, i % 2 ? 0 : 4));
+    processing_time += i % 2 ? 4 : 0;
+  }
+  AutotuneReplayResult result;
+  TF_ASSERT_OK(Model::ReplayTrace(Env::Default(), WriteTrace("noisy", rounds),
+                                  AutotuneAlgorithm::FEEDBACK, &result));
+  ASSERT_EQ(rounds.size(), result.parameter_values.size());
+  EXPECT_EQ(0, result.num_changes);
+  EXPECT_EQ(4, result.parameter_values.back().at("async(id:1)"));
+}
+
+TEST(FeedbackTest, ShrinksBuffersOverRamBudget) {
+  // Two buffered elements of 1000 bytes, so that a full buffer of 8 elements
+  // would need 6000 more bytes than the budget allows.
+  AutotuneRound round = MakeRound(kBufferSize, 8, 0, 0, 2);
+  round.set_ram_budget(3000);
+  AutotuneReplayResult result;
+  TF_ASSERT_OK(Model::ReplayTrace(Env::Default(), WriteTrace("ram", {round}),
+                                  AutotuneAlgorithm::FEEDBACK, &result));
+  ASSERT_EQ(1, result.parameter_values.size());
+  EXPECT_EQ(5, result.parameter_values[0].at("async(id:1)"));
+}
+
+TEST(TraceTest, RecordsAndReplaysModel) {
+  auto state = std::make_shared<SharedState>(
+      kAutotune, std::make_shared<mutex>(),
+      std::make_shared<condition_variable>());
+  state->value = 2;
+  Model model([](std::shared_ptr<Node>) {});
+  model.AddNode(
+      [state](Node::Args args) {
+        return MakeAsyncKnownRatioNode(
+            std::move(args), 1, {MakeParameter(kParallelism, state, 1, 8)});
+      },
+      "map", "");
+  std::shared_ptr<Node> source = model.AddNode(
+      [](Node::Args args) { return MakeSourceNode(std::move(args)); },
+      "map::source", "map");
+  source->add_processing_time(100);
+  source->record_element();
+
+  const string filename = io::JoinPath(testing::TmpDir(), "recorded");
+  TF_ASSERT_OK(model.StartTrace(Env::Default(), filename));
+  model.Optimize(AutotuneAlgorithm::FEEDBACK, 4, 1 << 30);
+  model.Optimize(AutotuneAlgorithm::FEEDBACK, 4, 1 << 30);
+
+  AutotuneReplayResult result;
+  TF_ASSERT_OK(Model::ReplayTrace(Env::Default(), filename,
+                                  AutotuneAlgorithm::HILL_CLIMB, &result));
+  ASSERT_EQ(2, result.parameter_values.size());
+  EXPECT_EQ(1, result.parameter_values[0].count("map(id:1)"));
+  EXPECT_EQ(0, result.parameter_values[0].count("source(id:2)"));
+}
+
+TEST(TraceTest, MissingNode) {
+  AutotuneRound round = MakeRound(kParallelism, 1, 0, 0, 0);
+  round.mutable_nodes()->RemoveLast();
+  AutotuneReplayResult result;
+  EXPECT_TRUE(errors::IsDataLoss(
+      Model::ReplayTrace(Env::Default(), WriteTrace("missing", {round}),
+                         AutotuneAlgorithm::HILL_CLIMB, &result)));
+}
+
 }  // namespace
 }  // namespace model
 }  // namespace data
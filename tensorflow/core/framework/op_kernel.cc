@@ -319,6 +319,8 @@ Allocator* OpKernelContext::get_allocator(AllocatorAttributes attr) {
   if (TF_PREDICT_FALSE(attr.scope_id > 0)) {
     allocator = params_->device->GetScopedAllocator(attr, step_id());
     CHECK(allocator);
+  } else if (params_->node_allocator != nullptr && attr.value == 0) {
+    allocator = params_->node_allocator;
   } else {
     allocator = params_->device->GetAllocator(attr);
   }
@@ -663,6 +663,10 @@ class OpKernelContext {
     // Array indexed by output number for this node
     const AllocatorAttributes* output_attr_array = nullptr;
 
+    // If not null, serves the allocations this op kernel invocation makes
+    // with default allocator attributes, instead of the device allocator.
+    Allocator* node_allocator = nullptr;
+
     // Shared resources accessible by this op kernel invocation.
     ResourceMgr* resource_manager = nullptr;
 
@@ -69,6 +69,12 @@ class Rendezvous : public core::RefCounted {
     DeviceNameUtils::ParsedName dst;
     StringPiece edge_name;
 
+    // If non-negative, identifies the key among the top-level keys of a step.
+    // Assigned to matching Send/Recv pairs when graphs are partitioned (see
+    // PartitionOptions::num_rendezvous_slots), so that a rendezvous can match
+    // them without looking up the key string.
+    int64 slot = -1;
+
     ParsedKey() {}
     ParsedKey(const ParsedKey& b) { *this = b; }
 
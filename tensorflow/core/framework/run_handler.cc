@@ -19,6 +19,8 @@ limitations under the License.
 
 #include <algorithm>
 #include <cmath>
+#include <numeric>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/run_handler_util.h"
@@ -59,13 +61,21 @@ class RunHandlerEnvironment {
       : env_(env), thread_options_(thread_options), name_(name) {}
 
   EnvThread* CreateThread(std::function<void()> f) {
-    return env_->StartThread(thread_options_, name_, [=]() {
+    return CreateThread(std::move(f), thread_options_.numa_node);
+  }
+
+  // Same as above, but pins the thread to 'numa_node' instead of the node in
+  // the thread options.
+  EnvThread* CreateThread(std::function<void()> f, int numa_node) {
+    ThreadOptions thread_options = thread_options_;
+    thread_options.numa_node = numa_node;
+    return env_->StartThread(thread_options, name_, [=]() {
       // Set the processor flag to flush denormals to zero.
       port::ScopedFlushDenormal flush;
       // Set the processor rounding mode to ROUND TO NEAREST.
       port::ScopedSetRound round(FE_TONEAREST);
-      if (thread_options_.numa_node != port::kNUMANoAffinity) {
-        port::NUMASetThreadNodeAffinity(thread_options_.numa_node);
+      if (numa_node != port::kNUMANoAffinity) {
+        port::NUMASetThreadNodeAffinity(numa_node);
       }
       f();
     });
@@ -311,26 +321,41 @@ class RunHandlerThreadPool {
     int thread_id;               // Worker thread index in pool.
   };
 
+  // If num_numa_nodes > 1, the blocking and the non-blocking threads are
+  // each split into num_numa_nodes groups and every group is pinned to its
+  // NUMA node.
   RunHandlerThreadPool(int num_blocking_threads, int num_non_blocking_threads,
                        Env* env, const ThreadOptions& thread_options,
-                       const string& name)
+                       const string& name, int num_numa_nodes = 1)
       : num_threads_(num_blocking_threads + num_non_blocking_threads),
         num_blocking_threads_(num_blocking_threads),
         num_non_blocking_threads_(num_non_blocking_threads),
+        num_numa_nodes_(std::max(1, num_numa_nodes)),
         thread_data_(num_threads_),
         env_(env, thread_options, name),
         name_(name) {
     VLOG(1) << "Creating RunHandlerThreadPool " << name << " with  "
             << num_blocking_threads_ << " blocking threads and "
-            << num_non_blocking_threads_ << " non-blocking threads.";
+            << num_non_blocking_threads_ << " non-blocking threads on "
+            << num_numa_nodes_ << " NUMA nodes.";
     cancelled_ = false;
 
+    thread_numa_nodes_ =
+        AssignThreadsToNumaNodes(num_blocking_threads_, num_numa_nodes_);
+    std::vector<int> non_blocking_numa_nodes =
+        AssignThreadsToNumaNodes(num_non_blocking_threads_, num_numa_nodes_);
+    thread_numa_nodes_.insert(thread_numa_nodes_.end(),
+                              non_blocking_numa_nodes.begin(),
+                              non_blocking_numa_nodes.end());
+
     thread_data_.resize(num_threads_);
     for (int i = 0; i < num_threads_; i++) {
-      thread_data_[i].thread.reset(
-          env_.CreateThread([this, i, num_blocking_threads]() {
+      thread_data_[i].thread.reset(env_.CreateThread(
+          [this, i, num_blocking_threads]() {
             WorkerLoop(i, i < num_blocking_threads);
-          }));
+          },
+          num_numa_nodes_ > 1 ? thread_numa_nodes_[i]
+                              : thread_options.numa_node));
     }
   }
 
@@ -383,6 +408,20 @@ class RunHandlerThreadPool {
     thread_data_[tid].sources_not_empty.notify_all();
   }
 
+  // Set work queues from which the thread 'tid' can steal its work, to be
+  // attempted in the order of the request indices in 'steal_order'.
+  void SetThreadWorkSources(
+      int tid, const std::vector<int>& steal_order,
+      const Eigen::MaxSizeVector<ThreadWorkSource*>& thread_work_sources) {
+    mutex_lock l(thread_data_[tid].mu);
+    thread_data_[tid].thread_work_sources.resize(0);
+    for (int request_idx : steal_order) {
+      thread_data_[tid].thread_work_sources.emplace_back(
+          thread_work_sources[request_idx]);
+    }
+    thread_data_[tid].sources_not_empty.notify_all();
+  }
+
   PerThread* GetPerThread() {
     thread_local PerThread per_thread_;
     PerThread* pt = &per_thread_;
@@ -405,6 +444,10 @@ class RunHandlerThreadPool {
 
   int NumNonBlockingThreads() const { return num_non_blocking_threads_; }
 
+  int NumNumaNodes() const { return num_numa_nodes_; }
+
+  int NumaNodeForThread(int tid) const { return thread_numa_nodes_[tid]; }
+
   void WorkerLoop(int thread_id, bool may_steal_blocking_work);
 
   void WaitForWork(bool is_blocking, int thread_id,
@@ -422,6 +465,9 @@ class RunHandlerThreadPool {
   const int num_threads_;
   const int num_blocking_threads_;
   const int num_non_blocking_threads_;
+  const int num_numa_nodes_;
+  // NUMA node of each thread. Only meaningful if num_numa_nodes_ > 1.
+  std::vector<int> thread_numa_nodes_;
   Eigen::MaxSizeVector<ThreadData> thread_data_;
   RunHandlerEnvironment env_;
   std::atomic<bool> cancelled_;
@@ -566,6 +612,8 @@ class RunHandler::Impl {
   // requested via RunHandlerPool::Get().
   uint64 start_time_us() const { return start_time_us_; }
   int64 step_id() const { return step_id_; }
+  int numa_node() const { return numa_node_; }
+  void set_numa_node(int numa_node) { numa_node_ = numa_node; }
   void ScheduleInterOpClosure(std::function<void()> fn);
   void ScheduleIntraOpClosure(std::function<void()> fn);
 
@@ -592,6 +640,7 @@ class RunHandler::Impl {
   RunHandlerPool::Impl* pool_impl_;  // NOT OWNED.
   uint64 start_time_us_;
   int64 step_id_;
+  int numa_node_ = port::kNUMANoAffinity;
   std::unique_ptr<thread::ThreadPoolInterface> thread_pool_interface_;
   ThreadWorkSource tws_;
 };
@@ -603,11 +652,14 @@ class RunHandlerPool::Impl {
  public:
   explicit Impl(int num_inter_op_threads, int num_intra_op_threads)
       : max_handlers_(kMaxConcurrentHandlers),
+        num_numa_nodes_(NumNumaNodesFromEnvironment()),
         run_handler_thread_pool_(new RunHandlerThreadPool(
             num_inter_op_threads, num_intra_op_threads, Env::Default(),
-            ThreadOptions(), "tf_run_handler_pool")),
+            ThreadOptions(), "tf_run_handler_pool", num_numa_nodes_)),
+        num_active_handlers_per_node_(num_numa_nodes_, 0),
         iterations_(0) {
-    VLOG(1) << "Creating a RunHandlerPool with max handlers: " << max_handlers_;
+    VLOG(1) << "Creating a RunHandlerPool with max handlers: " << max_handlers_
+            << " on " << num_numa_nodes_ << " NUMA nodes.";
     for (int i = 0; i < max_handlers_; ++i) {
       handlers_.emplace_back(new RunHandler::Impl(this));
       free_handlers_.push_back(handlers_.back().get());
@@ -639,6 +691,15 @@ class RunHandlerPool::Impl {
     // sorted_active_handlers_.
     auto* handler_impl = free_handlers_.back();
     handler_impl->Reset(step_id);
+    if (num_numa_nodes_ > 1) {
+      // Place the request on the node with the fewest active requests.
+      int numa_node =
+          std::min_element(num_active_handlers_per_node_.begin(),
+                           num_active_handlers_per_node_.end()) -
+          num_active_handlers_per_node_.begin();
+      ++num_active_handlers_per_node_[numa_node];
+      handler_impl->set_numa_node(numa_node);
+    }
     // Sortedness isn't violated if we simply add at the end of the list, since
     // handlers are expected to be obtained in increasing order of time.
     sorted_active_handlers_.push_back(handler_impl);
@@ -673,6 +734,10 @@ class RunHandlerPool::Impl {
       // handlers.
       sorted_active_handlers_.erase(iter);
       free_handlers_.push_back(handler);
+      if (num_numa_nodes_ > 1) {
+        --num_active_handlers_per_node_[handler->numa_node()];
+        handler->set_numa_node(port::kNUMANoAffinity);
+      }
       DCHECK_LE(free_handlers_.size(), max_handlers_);
 
       RecomputePoolStatsLocked();
@@ -681,14 +746,37 @@ class RunHandlerPool::Impl {
   }
 
  private:
+  // Return the number of NUMA nodes the pool spreads its threads and requests
+  // over. This is 1 unless TF_RUN_HANDLER_USE_NUMA is set and the machine has
+  // more than one NUMA node.
+  static int NumNumaNodesFromEnvironment() {
+    if (ParamFromEnvWithDefault("TF_RUN_HANDLER_USE_NUMA", 0) == 0 ||
+        !port::NUMAEnabled()) {
+      return 1;
+    }
+    return std::max(1, port::NUMANumNodes());
+  }
+
   void RecomputePoolStatsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Set the work sources of threads [first_tid, first_tid + num_threads) such
+  // that every thread first steals from the requests on its own NUMA node.
+  void SetNumaAwareThreadWorkSourcesLocked(
+      int first_tid, int num_threads,
+      const Eigen::MaxSizeVector<ThreadWorkSource*>& thread_work_sources)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // Maximum number of handlers pre-created during pool construction time. The
   // number has been chosen expecting each handler might at least want 1
   // inter-op thread for execution (during compute intensive workloads like
   // inference).
   const int max_handlers_;
 
+  // Number of NUMA nodes the pool threads are spread over. If it is larger
+  // than 1, every request is placed on a node and the threads on that node
+  // prefer its work over the work of requests placed on other nodes.
+  const int num_numa_nodes_;
+
   std::unique_ptr<RunHandlerThreadPool> run_handler_thread_pool_;
   // Thread compatible part used only by lock under RunHandlerPool.
   // Handlers are sorted by start time.
@@ -696,6 +784,7 @@ class RunHandlerPool::Impl {
   std::vector<RunHandler::Impl*> sorted_active_handlers_ GUARDED_BY(mu_);
   std::vector<RunHandler::Impl*> free_handlers_ GUARDED_BY(mu_);
   std::vector<std::unique_ptr<RunHandler::Impl>> handlers_ GUARDED_BY(mu_);
+  std::vector<int> num_active_handlers_per_node_ GUARDED_BY(mu_);
   // Histogram of elapsed runtime of every handler (in ms).
   histogram::Histogram time_hist_ GUARDED_BY(mu_);
 
@@ -720,22 +809,30 @@ void RunHandlerPool::Impl::RecomputePoolStatsLocked() {
   int num_blocking_threads = run_handler_thread_pool()->NumBlockingThreads();
   int num_non_blocking_threads = num_threads - num_blocking_threads;
 
-  std::vector<int> request_idx_list = ChooseRequestsWithExponentialDistribution(
-      num_active_requests, num_blocking_threads);
-  for (int i = 0; i < num_blocking_threads; ++i) {
-    VLOG(2) << "Set work for tid=" << i
-            << " with start_request_idx=" << request_idx_list[i];
-    run_handler_thread_pool()->SetThreadWorkSources(i, request_idx_list[i],
-                                                    thread_work_sources);
-  }
+  if (num_numa_nodes_ > 1) {
+    SetNumaAwareThreadWorkSourcesLocked(0, num_blocking_threads,
+                                        thread_work_sources);
+    SetNumaAwareThreadWorkSourcesLocked(
+        num_blocking_threads, num_non_blocking_threads, thread_work_sources);
+  } else {
+    std::vector<int> request_idx_list =
+        ChooseRequestsWithExponentialDistribution(num_active_requests,
+                                                  num_blocking_threads);
+    for (int i = 0; i < num_blocking_threads; ++i) {
+      VLOG(2) << "Set work for tid=" << i
+              << " with start_request_idx=" << request_idx_list[i];
+      run_handler_thread_pool()->SetThreadWorkSources(i, request_idx_list[i],
+                                                      thread_work_sources);
+    }
 
-  request_idx_list = ChooseRequestsWithExponentialDistribution(
-      num_active_requests, num_non_blocking_threads);
-  for (int i = 0; i < num_non_blocking_threads; ++i) {
-    VLOG(2) << "Set work for tid=" << (i + num_blocking_threads)
-            << " with start_request_idx=" << request_idx_list[i];
-    run_handler_thread_pool()->SetThreadWorkSources(
-        i + num_blocking_threads, request_idx_list[i], thread_work_sources);
+    request_idx_list = ChooseRequestsWithExponentialDistribution(
+        num_active_requests, num_non_blocking_threads);
+    for (int i = 0; i < num_non_blocking_threads; ++i) {
+      VLOG(2) << "Set work for tid=" << (i + num_blocking_threads)
+              << " with start_request_idx=" << request_idx_list[i];
+      run_handler_thread_pool()->SetThreadWorkSources(
+          i + num_blocking_threads, request_idx_list[i], thread_work_sources);
+    }
   }
 
   if (iterations_++ % 50000 == 10 && VLOG_IS_ON(1)) {
@@ -760,6 +857,51 @@ void RunHandlerPool::Impl::RecomputePoolStatsLocked() {
   }
 }
 
+void RunHandlerPool::Impl::SetNumaAwareThreadWorkSourcesLocked(
+    int first_tid, int num_threads,
+    const Eigen::MaxSizeVector<ThreadWorkSource*>& thread_work_sources) {
+  const int num_active_requests = sorted_active_handlers_.size();
+  std::vector<int> request_numa_nodes(num_active_requests);
+  for (int i = 0; i < num_active_requests; ++i) {
+    request_numa_nodes[i] = sorted_active_handlers_[i]->numa_node();
+  }
+
+  for (int numa_node = 0; numa_node < num_numa_nodes_; ++numa_node) {
+    std::vector<int> node_threads;
+    for (int tid = first_tid; tid < first_tid + num_threads; ++tid) {
+      if (run_handler_thread_pool()->NumaNodeForThread(tid) == numa_node) {
+        node_threads.push_back(tid);
+      }
+    }
+    if (node_threads.empty()) continue;
+
+    // Distribute the threads of the node across the requests on the node,
+    // oldest first. Nodes without requests help all requests.
+    std::vector<int> node_requests;
+    for (int i = 0; i < num_active_requests; ++i) {
+      if (request_numa_nodes[i] == numa_node) node_requests.push_back(i);
+    }
+    if (node_requests.empty()) {
+      node_requests.resize(num_active_requests);
+      std::iota(node_requests.begin(), node_requests.end(), 0);
+    }
+
+    std::vector<int> request_idx_list =
+        ChooseRequestsWithExponentialDistribution(node_requests.size(),
+                                                  node_threads.size());
+    for (int i = 0; i < node_threads.size(); ++i) {
+      const int start_request_idx = node_requests[request_idx_list[i]];
+      VLOG(2) << "Set work for tid=" << node_threads[i] << " on NUMA node "
+              << numa_node << " with start_request_idx=" << start_request_idx;
+      run_handler_thread_pool()->SetThreadWorkSources(
+          node_threads[i],
+          ComputeNumaAwareStealOrder(start_request_idx, numa_node,
+                                     request_numa_nodes),
+          thread_work_sources);
+    }
+  }
+}
+
 // It is important to return a value such as:
 // CurrentThreadId() in [0, NumThreads)
 int RunHandler::Impl::ThreadPoolInterfaceWrapper::NumThreads() const {
@@ -823,6 +965,8 @@ thread::ThreadPoolInterface* RunHandler::AsIntraThreadPoolInterface() {
   return impl_->thread_pool_interface();
 }
 
+int RunHandler::numa_node() const { return impl_->numa_node(); }
+
 RunHandler::~RunHandler() { impl_->pool_impl()->ReleaseHandler(impl_); }
 
 }  // namespace tensorflow
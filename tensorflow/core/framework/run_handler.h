@@ -46,6 +46,12 @@ class RunHandler;
 // * Use handler for scheduling all inter-op work by:
 // handler->ScheduleInterOpClosure(closure);
 //
+// If the environment variable TF_RUN_HANDLER_USE_NUMA is set to a non-zero
+// value and the machine has several NUMA nodes, the pool threads are split into
+// one group per node and every group is pinned to its node. Each request is
+// placed on the node with the fewest active requests, and threads steal work
+// from requests on their own node before crossing to remote nodes.
+//
 // This class is thread safe.
 class RunHandlerPool {
  public:
@@ -88,6 +94,12 @@ class RunHandler {
   void ScheduleInterOpClosure(std::function<void()> fn);
   thread::ThreadPoolInterface* AsIntraThreadPoolInterface();
 
+  // Returns the NUMA node whose threads preferentially run the work of this
+  // handler, or port::kNUMANoAffinity if the pool is not NUMA-aware. Buffers
+  // private to the request can be allocated node-locally, e.g. with
+  // ProcessState::GetCPUAllocator(numa_node()).
+  int numa_node() const;
+
   ~RunHandler();
 
  private:
@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "tensorflow/core/framework/run_handler.h"
 
+#include <stdlib.h>
+
 #include <memory>
 #include <vector>
 
@@ -25,10 +27,14 @@ limitations under the License.
 #include "absl/synchronization/barrier.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -72,5 +78,103 @@ TEST(RunHandlerUtilTest, TestBasicScheduling) {
   counter.Wait();
 }
 
+TEST(RunHandlerUtilTest, TestNumaAwareScheduling) {
+  setenv("TF_RUN_HANDLER_USE_NUMA", "1", 1 /*overwrite*/);
+  int num_threads = 4;
+  int num_handlers = 8;
+  std::unique_ptr<RunHandlerPool> pool(
+      new RunHandlerPool(num_threads, num_threads));
+  unsetenv("TF_RUN_HANDLER_USE_NUMA");
+
+  const bool numa_aware = port::NUMAEnabled() && port::NUMANumNodes() > 1;
+  BlockingCounter counter(2 * num_handlers * num_threads);
+  thread::ThreadPool test_pool(Env::Default(), "test", num_handlers);
+  for (int i = 0; i < num_handlers; ++i) {
+    test_pool.Schedule([&counter, &pool, i, num_threads, numa_aware]() {
+      auto handler = pool->Get(i);
+      if (numa_aware) {
+        EXPECT_GE(handler->numa_node(), 0);
+        EXPECT_LT(handler->numa_node(), port::NUMANumNodes());
+      } else {
+        EXPECT_EQ(port::kNUMANoAffinity, handler->numa_node());
+      }
+      BlockingCounter local_counter(2 * num_threads);
+      auto intra_thread_pool = handler->AsIntraThreadPoolInterface();
+      for (int j = 0; j < num_threads; ++j) {
+        handler->ScheduleInterOpClosure([&local_counter, &counter]() {
+          counter.DecrementCount();
+          local_counter.DecrementCount();
+        });
+        intra_thread_pool->Schedule([&local_counter, &counter]() {
+          counter.DecrementCount();
+          local_counter.DecrementCount();
+        });
+      }
+      local_counter.Wait();
+    });
+  }
+  counter.Wait();
+}
+
+// Runs 'num_requests' concurrent requests, each fanning out memory bound
+// inter-op closures, and reports the median and tail request latency.
+static void BM_MultiRequestLatency(int iters, int num_requests,
+                                   int use_numa) {
+  testing::StopTiming();
+  const int kNumThreads = port::MaxParallelism();
+  const int kClosuresPerRequest = 32;
+  const int kBufferSize = 64 << 10;
+  if (use_numa) setenv("TF_RUN_HANDLER_USE_NUMA", "1", 1 /*overwrite*/);
+  std::unique_ptr<RunHandlerPool> pool(
+      new RunHandlerPool(kNumThreads, kNumThreads));
+  if (use_numa) unsetenv("TF_RUN_HANDLER_USE_NUMA");
+  thread::ThreadPool client_pool(Env::Default(), "client", num_requests);
+  mutex mu;
+  histogram::Histogram latency_us;
+  testing::StartTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    BlockingCounter requests_done(num_requests);
+    for (int r = 0; r < num_requests; ++r) {
+      client_pool.Schedule([&pool, &mu, &latency_us, &requests_done, i]() {
+        const uint64 start = Env::Default()->NowMicros();
+        auto handler = pool->Get(i);
+        BlockingCounter closures_done(kClosuresPerRequest);
+        for (int c = 0; c < kClosuresPerRequest; ++c) {
+          handler->ScheduleInterOpClosure([&closures_done]() {
+            std::vector<float> buffer(kBufferSize / sizeof(float), 1.0f);
+            float sum = 0;
+            for (float v : buffer) sum += v;
+            testing::DoNotOptimize(sum);
+            closures_done.DecrementCount();
+          });
+        }
+        closures_done.Wait();
+        handler.reset();
+        const uint64 elapsed = Env::Default()->NowMicros() - start;
+        {
+          mutex_lock l(mu);
+          latency_us.Add(elapsed);
+        }
+        requests_done.DecrementCount();
+      });
+    }
+    requests_done.Wait();
+  }
+
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_requests);
+  testing::SetLabel(strings::StrCat("p50: ", latency_us.Median(),
+                                    "us p99: ", latency_us.Percentile(99),
+                                    "us"));
+}
+BENCHMARK(BM_MultiRequestLatency)
+    ->ArgPair(4, 0)
+    ->ArgPair(4, 1)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1);
+
 }  // namespace
 }  // namespace tensorflow
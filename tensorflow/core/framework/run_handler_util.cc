@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/run_handler_util.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include "tensorflow/core/lib/strings/numbers.h"
@@ -133,4 +134,35 @@ std::vector<int> ChooseRequestsWithExponentialDistribution(
   return request_idx_list;
 }
 
+std::vector<int> AssignThreadsToNumaNodes(int num_threads,
+                                          int num_numa_nodes) {
+  num_numa_nodes = std::max(1, num_numa_nodes);
+  std::vector<int> numa_nodes(num_threads);
+  for (int tid = 0; tid < num_threads; ++tid) {
+    numa_nodes[tid] =
+        static_cast<int64_t>(tid) * num_numa_nodes / std::max(1, num_threads);
+  }
+  return numa_nodes;
+}
+
+std::vector<int> ComputeNumaAwareStealOrder(
+    int start_request_idx, int thread_numa_node,
+    const std::vector<int>& request_numa_nodes) {
+  const int num_requests = request_numa_nodes.size();
+  std::vector<int> steal_order;
+  steal_order.reserve(num_requests);
+  steal_order.push_back(start_request_idx);
+  for (int i = 0; i < num_requests; ++i) {
+    if (i != start_request_idx && request_numa_nodes[i] == thread_numa_node) {
+      steal_order.push_back(i);
+    }
+  }
+  for (int i = 0; i < num_requests; ++i) {
+    if (i != start_request_idx && request_numa_nodes[i] != thread_numa_node) {
+      steal_order.push_back(i);
+    }
+  }
+  return steal_order;
+}
+
 }  // namespace tensorflow
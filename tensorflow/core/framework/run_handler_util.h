@@ -54,6 +54,20 @@ void ComputeInterOpStealingRanges(int num_threads, int min_threads_per_domain,
 std::vector<int> ChooseRequestsWithExponentialDistribution(
     int num_active_requests, int num_threads);
 
+// Assign num_threads threads to num_numa_nodes NUMA nodes in contiguous blocks
+// of (almost) equal size. Return a vector of size num_threads holding the node
+// of each thread.
+std::vector<int> AssignThreadsToNumaNodes(int num_threads, int num_numa_nodes);
+
+// Return the order in which a thread on NUMA node 'thread_numa_node' should
+// attempt to steal work from the active requests, where request_numa_nodes[i]
+// is the node of the i-th active request. The request with start_request_idx
+// is attempted first, then the other requests on the thread's node, then the
+// requests on remote nodes. Both groups keep the order of request_numa_nodes.
+std::vector<int> ComputeNumaAwareStealOrder(
+    int start_request_idx, int thread_numa_node,
+    const std::vector<int>& request_numa_nodes);
+
 // Loop environment variable named 'var_name' and return the value if it exist
 // and can be parsed. Return 'default_value' otherwise.
 double ParamFromEnvWithDefault(const std::string& var_name,
@@ -124,5 +124,39 @@ TEST(RunHandlerUtilTest, TestExponentialRequestDistribution) {
   ASSERT_EQ(actual_distribution, expected_distribution);
 }
 
+TEST(RunHandlerUtilTest, TestAssignThreadsToNumaNodes) {
+  std::vector<int> expected_nodes{0, 0, 0, 1, 1, 1};
+  ASSERT_EQ(AssignThreadsToNumaNodes(6, 2), expected_nodes);
+
+  expected_nodes = {0, 0, 1, 1, 2};
+  ASSERT_EQ(AssignThreadsToNumaNodes(5, 3), expected_nodes);
+
+  // Fewer threads than nodes: every thread gets its own node.
+  expected_nodes = {0, 2};
+  ASSERT_EQ(AssignThreadsToNumaNodes(2, 4), expected_nodes);
+
+  expected_nodes = {0, 0, 0};
+  ASSERT_EQ(AssignThreadsToNumaNodes(3, 1), expected_nodes);
+  ASSERT_TRUE(AssignThreadsToNumaNodes(0, 2).empty());
+}
+
+TEST(RunHandlerUtilTest, TestComputeNumaAwareStealOrder) {
+  std::vector<int> request_numa_nodes{0, 1, 0, 1, 1};
+
+  // Local requests come first, in arrival order, then remote ones.
+  std::vector<int> expected_order{3, 1, 4, 0, 2};
+  ASSERT_EQ(ComputeNumaAwareStealOrder(3, 1, request_numa_nodes),
+            expected_order);
+
+  expected_order = {0, 2, 1, 3, 4};
+  ASSERT_EQ(ComputeNumaAwareStealOrder(0, 0, request_numa_nodes),
+            expected_order);
+
+  // A primary request on a remote node is still attempted first.
+  expected_order = {1, 0, 2, 3, 4};
+  ASSERT_EQ(ComputeNumaAwareStealOrder(1, 0, request_numa_nodes),
+            expected_order);
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -1007,6 +1007,7 @@ Status Partition(const PartitionOptions& opts, Graph* g,
 
   int32 num_data = 0;
   int32 num_control = 0;
+  int64 num_slots = 0;
   for (const Node* dst : g->op_nodes()) {
     dstp = opts.node_to_loc(dst);
     GraphDef* dst_graph = &(*partitions)[dstp];
@@ -1149,6 +1150,12 @@ Status Partition(const PartitionOptions& opts, Graph* g,
           AddRecv(opts, g_info, dst_graph, edge, &real_recv, &status);
       if (!status.ok()) return status;
 
+      if (opts.num_rendezvous_slots != nullptr) {
+        AddNodeAttr("_rendezvous_slot", num_slots, send);
+        AddNodeAttr("_rendezvous_slot", num_slots, real_recv);
+        ++num_slots;
+      }
+
       // Fix up the control flow edge.
       // NOTE(yuanbyu): 'real_recv' must be the real recv node.
       if (src_graph == dst_graph) {
@@ -1236,6 +1243,10 @@ Status Partition(const PartitionOptions& opts, Graph* g,
     }
   }
 
+  if (opts.num_rendezvous_slots != nullptr) {
+    *opts.num_rendezvous_slots = num_slots;
+  }
+
   VLOG(1) << "Added send/recv: controls=" << num_control
           << ", data=" << num_data;
   if (VLOG_IS_ON(2)) {
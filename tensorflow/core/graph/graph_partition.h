@@ -76,6 +76,13 @@ struct PartitionOptions {
   // in the graph as a node attribute.
   bool need_to_record_start_times = false;
   std::vector<Microseconds> start_times;
+
+  // If non-null, each Send/Recv pair added by partitioning is numbered with
+  // a "_rendezvous_slot" attr, from 0 to *num_rendezvous_slots - 1, so that
+  // a rendezvous sized for the whole step can match the pair by index (see
+  // IntraProcessRendezvous). Only set this if the partitions are run
+  // together, once per step, with a rendezvous of their own.
+  int64* num_rendezvous_slots = nullptr;
 };
 
 // Partition "input" graph into a set of graphs, one per location.
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/graph/graph_partition.h"
 
+#include <map>
+#include <set>
 #include <unordered_map>
 #include <utility>
 
@@ -74,7 +76,8 @@ string DeviceName(const Node* node) {
 }
 
 void Partition(const GraphDef& graph_def,
-               std::unordered_map<string, GraphDef>* partitions) {
+               std::unordered_map<string, GraphDef>* partitions,
+               int64* num_rendezvous_slots = nullptr) {
   Graph g(OpRegistry::Global());
   GraphConstructorOptions opts;
   TF_CHECK_OK(ConvertGraphDefToGraph(opts, graph_def, &g));
@@ -94,6 +97,7 @@ void Partition(const GraphDef& graph_def,
   popts.get_incarnation = [](const string& name) {
     return (name[0] - 'A') + 100;
   };
+  popts.num_rendezvous_slots = num_rendezvous_slots;
   Status s = Partition(popts, &g, partitions);
   CHECK(s.ok()) << s;
 
@@ -371,6 +375,55 @@ TEST_F(GraphPartitionTest, CrossDevice_DataControl) {
   ExpectMatchB();
 }
 
+TEST_F(GraphPartitionTest, RendezvousSlots) {
+  auto a1 = FloatInput(in_.WithOpName("A1"));
+  auto b1 = FloatInput(in_.WithOpName("B1"));
+  auto c1 = FloatInput(in_.WithOpName("C1"));
+  Combine(in_.WithOpName("B2"), a1, c1);
+  Combine(in_.WithOpName("C2"), a1, b1);
+  // Reuses the Send/Recv pair of A1 -> B2.
+  Combine(in_.WithOpName("B3"), a1, a1);
+
+  int64 num_slots = -1;
+  Partition(ToGraphDef(), &partitions_, &num_slots);
+  EXPECT_EQ(3, partitions_.size());
+  EXPECT_EQ(4, num_slots);
+
+  // Each Send/Recv pair has its own slot, shared by both sides.
+  std::map<string, int64> send_slots;
+  std::map<string, int64> recv_slots;
+  for (const auto& kv : partitions_) {
+    for (const NodeDef& ndef : kv.second.node()) {
+      if (ndef.op() != "_Send" && ndef.op() != "_Recv") continue;
+      string tensor_name;
+      TF_ASSERT_OK(GetNodeAttr(ndef, "tensor_name", &tensor_name));
+      int64 slot;
+      TF_ASSERT_OK(GetNodeAttr(ndef, "_rendezvous_slot", &slot));
+      auto* slots = ndef.op() == "_Send" ? &send_slots : &recv_slots;
+      EXPECT_TRUE(slots->emplace(tensor_name, slot).second);
+    }
+  }
+  EXPECT_EQ(send_slots, recv_slots);
+  std::set<int64> slots;
+  for (const auto& kv : send_slots) {
+    slots.insert(kv.second);
+  }
+  EXPECT_EQ((std::set<int64>{0, 1, 2, 3}), slots);
+}
+
+TEST_F(GraphPartitionTest, NoRendezvousSlotsByDefault) {
+  auto a1 = FloatInput(in_.WithOpName("A1"));
+  auto b1 = FloatInput(in_.WithOpName("B1"));
+  Combine(in_.WithOpName("B2"), a1, b1);
+
+  Partition(ToGraphDef(), &partitions_);
+  for (const auto& kv : partitions_) {
+    for (const NodeDef& ndef : kv.second.node()) {
+      EXPECT_EQ(0, ndef.attr().count("_rendezvous_slot"));
+    }
+  }
+}
+
 TEST_F(GraphPartitionTest, CrossDeviceLoopSimple) {
   auto a1 = BoolInput(in_.WithOpName("A1"));
   auto a2 = ::tensorflow::ops::internal::Enter(in_.WithOpName("A2"), a1, "foo");
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/model.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"  // NOLINT
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
@@ -29,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
 #include "tensorflow/core/grappler/optimizers/data/function_utils.h"
 #include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization_cost_model.h"
 #include "tensorflow/core/grappler/optimizers/data/vectorization_utils.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -55,6 +57,10 @@ constexpr char kParallelMapOp[] = "ParallelMapDataset";
 constexpr char kChooseFastestOp[] = "ChooseFastestBranchDataset";
 constexpr char kPrefetchOp[] = "PrefetchDataset";
 
+// Batch size used to estimate the cost of vectorization when the batch size of
+// the input pipeline is not a constant.
+constexpr int64 kDefaultBatchSize = 16;
+
 // Returns a FunctionDef containing a MapDefun op that wraps the original
 // function.
 FunctionDef* CreateMapDefunWrapper(const NodeDef& map_node,
@@ -189,6 +195,27 @@ Status GetInputNodeName(StringPiece input_name, const NameRangeMap& input_map,
   return Status::OK();
 }
 
+// Returns the batch size of `batch_node` if it is a constant, or
+// `kDefaultBatchSize` otherwise.
+int64 GetBatchSize(const NodeDef& batch_node, const MutableGraphView& graph) {
+  NameRangeMap input_map;
+  string batch_size_name;
+  if (!GetInputMap(batch_node, &input_map).ok() ||
+      !GetInputNodeName("batch_size", input_map, batch_node, &batch_size_name)
+           .ok()) {
+    return kDefaultBatchSize;
+  }
+  const NodeDef* batch_size_node = graph.GetNode(batch_size_name);
+  Tensor batch_size;
+  if (batch_size_node == nullptr || batch_size_node->op() != "Const" ||
+      !batch_size.FromProto(batch_size_node->attr().at("value").tensor()) ||
+      batch_size.dtype() != DT_INT64 || batch_size.NumElements() != 1 ||
+      batch_size.flat<int64>()(0) < 1) {
+    return kDefaultBatchSize;
+  }
+  return batch_size.flat<int64>()(0);
+}
+
 Status AddNewBatchNode(const NodeDef& old_batch_node, const NodeDef& input_node,
                        const FunctionDef& vectorized_func,
                        MutableGraphView* graph, NodeDef** new_batch_node) {
@@ -531,9 +558,26 @@ Status MapVectorization::OptimizeAndCollectStats(Cluster* cluster,
       continue;
     }
 
+    // Only rewrite the pipeline if the cost model expects the vectorized
+    // function to be faster, e.g. not if most of its ops would still run
+    // element by element.
+    FunctionDefLibrary original_library = *library;
     FunctionDef* vectorized_func =
         AddVectorizedFunction(*map_node, *map_func, library);
     CHECK_NOTNULL(vectorized_func);
+    vectorization_utils::VectorizationCost cost;
+    TF_RETURN_IF_ERROR(vectorization_utils::EstimateVectorizationCost(
+        *map_func, *vectorized_func,
+        FunctionLibraryDefinition(OpRegistry::Global(), *library),
+        GetBatchSize(*batch_node, graph), &cost));
+    if (!cost.IsProfitable()) {
+      VLOG(1) << "Not vectorizing dataset.map().batch() because the estimated "
+                 "cost of the vectorized map function ("
+              << cost.vectorized << ") is not lower than the cost of the "
+              << "original one (" << cost.original << ").";
+      *library = std::move(original_library);
+      continue;
+    }
 
     NodeDef* new_batch_node;
     TF_RETURN_IF_ERROR(AddNewBatchNode(
@@ -36,6 +36,10 @@ namespace grappler {
 // To:
 //      input --> batch --> map --> output
 //
+// The rewrite is skipped when a static cost model (see
+// vectorization_cost_model.h) estimates that the vectorized function would not
+// be cheaper than the original one, e.g. when few of its ops can be vectorized.
+//
 // If the "ChooseFastest" configuration is enabled, it adds a
 // ChooseFastestBranch dataset node to pick between the original map->batch
 // branch and the vectorized batch->map branch.
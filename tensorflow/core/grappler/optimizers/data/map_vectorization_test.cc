@@ -586,6 +586,32 @@ TEST(MapVectorizationTest, VectorizeWithUndefinedOutputTypes) {
       input_node->name());
 }
 
+TEST(MapVectorizationTest, DoesNotVectorizeUnprofitableMapFn) {
+  // Tests that the optimization is skipped when none of the ops of the map
+  // function can be vectorized, since the vectorized function would run them
+  // element by element in a MapDefun node anyway.
+  GrapplerItem item;
+  MutableGraphView graph(&item.graph);
+  auto range_node = AddRangeNode(&graph);
+  FunctionDef* map_fn = graph.graph()->mutable_library()->add_function();
+  *map_fn = FunctionDefHelper::Create(
+      /*function_name=*/"map_fn",
+      /*in_def=*/{"x: int64"},
+      /*out_def=*/{"res: int64"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{{"node"}, "Unique", {"x"}, {{"T", DT_INT64}, {"out_idx", DT_INT32}}}},
+      /*ret_def=*/{{"res", "node:y:0"}});
+  auto map_node =
+      AddMapNode(&graph, range_node->name(), map_fn->signature().name());
+  auto batch_node = AddBatchNode(&graph, map_node->name());
+  GraphDef output;
+  TF_ASSERT_OK(OptimizeWithMapVectorization(item, &output, true));
+  CheckNotVectorized(output, map_node->op(), batch_node->op(),
+                     range_node->name());
+  EXPECT_EQ(output.library().function_size(), 1);
+}
+
 // TODO(rachelim): Add test that has a polymorphic function.
 
 }  // namespace
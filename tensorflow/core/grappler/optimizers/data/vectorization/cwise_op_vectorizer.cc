@@ -223,8 +223,11 @@ REGISTER_VECTORIZER("Tanh", UnaryCwiseOpVectorizer);
 REGISTER_VECTORIZER("Tan", UnaryCwiseOpVectorizer);
 
 // Miscellaneous unary
+REGISTER_VECTORIZER("Bitcast", UnaryCwiseOpVectorizer);
 REGISTER_VECTORIZER("Cast", UnaryCwiseOpVectorizer);
 REGISTER_VECTORIZER("Identity", UnaryCwiseOpVectorizer);
+REGISTER_VECTORIZER("OnesLike", UnaryCwiseOpVectorizer);
+REGISTER_VECTORIZER("ZerosLike", UnaryCwiseOpVectorizer);
 
 // Bitwise binary
 REGISTER_VECTORIZER("BitwiseAnd", BinaryCwiseOpVectorizer);
@@ -0,0 +1,92 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// Vectorizer for ops that apply independently to each element (or, for image
+// ops, to each image) of their first input, and whose other inputs are
+// parameters, such as a regular expression or a scale factor, that apply to
+// the whole first input. When the parameters are unstacked, the vectorized op
+// is the same as the original.
+class ElementwiseOpVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    NodeBuilder::NodeOut input;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &input));
+
+    std::vector<NodeBuilder::NodeOut> params(inputs.size() - 1);
+    for (size_t i = 1; i < inputs.size(); ++i) {
+      TF_RETURN_IF_ERROR(inputs.unstacked(i, &params[i - 1]));
+    }
+
+    auto node_builder = NodeBuilder(strings::StrCat("vectorized/", node.name()),
+                                    node.type_string())
+                            .Input(input);
+    for (const auto& param : params) {
+      node_builder = node_builder.Input(param);
+    }
+    for (const auto& attr : node.attrs()) {
+      node_builder = node_builder.Attr(attr.first, attr.second);
+    }
+    Node* new_node;
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &new_node));
+
+    // Add output mappings
+    for (int i = 0; i < node.num_outputs(); ++i) {
+      outputs->emplace_back(new_node, i, true);
+    }
+    return Status::OK();
+  }
+};
+
+// String ops
+REGISTER_VECTORIZER("AsString", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("DecodeBase64", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("EncodeBase64", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("RegexFullMatch", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("RegexReplace", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StaticRegexFullMatch", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StaticRegexReplace", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringLength", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringLower", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringStrip", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringToHashBucket", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringToHashBucketFast", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringToHashBucketStrong", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringUpper", ElementwiseOpVectorizer);
+
+// Parsing ops
+REGISTER_VECTORIZER("DecodeCompressed", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("DecodeJSONExample", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("StringToNumber", ElementwiseOpVectorizer);
+
+// Image ops
+REGISTER_VECTORIZER("AdjustContrastv2", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("AdjustHue", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("AdjustSaturation", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("HSVToRGB", ElementwiseOpVectorizer);
+REGISTER_VECTORIZER("RGBToHSV", ElementwiseOpVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
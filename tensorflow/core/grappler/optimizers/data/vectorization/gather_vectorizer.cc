@@ -0,0 +1,136 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kGatherV2Op[] = "GatherV2";
+
+// Gets the value of the scalar `tensor`, which must be produced by a Const
+// node.
+Status GetConstScalar(const WrappedTensor& tensor, int64* value) {
+  if (tensor.node->type_string() != "Const") {
+    return errors::Unimplemented("Expecting a constant, but got the output of ",
+                                 tensor.node->type_string());
+  }
+  const TensorProto* proto;
+  TF_RETURN_IF_ERROR(GetNodeAttr(tensor.node->attrs(), "value", &proto));
+  Tensor t;
+  if (!t.FromProto(*proto) || t.NumElements() != 1) {
+    return errors::InvalidArgument("Expecting a scalar constant.");
+  }
+  if (t.dtype() == DT_INT32) {
+    *value = t.flat<int32>()(0);
+  } else if (t.dtype() == DT_INT64) {
+    *value = t.flat<int64>()(0);
+  } else {
+    return errors::InvalidArgument("Expecting an integer constant.");
+  }
+  return Status::OK();
+}
+
+// Vectorizes Gather and GatherV2 ops into a GatherV2 op. The axis must be a
+// constant.
+//
+// - If only `indices` is stacked, the gathered slices of `params` are stacked
+//   as long as they are gathered along dimension 0, so the vectorized op is the
+//   same as the original.
+// - If only `params` is stacked, the slices are gathered along the axis after
+//   the original one.
+// - If both are stacked, each element of `indices` gathers from the matching
+//   element of `params`, which is GatherV2 with one more batch dimension.
+class GatherVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    const WrappedTensor& params = inputs.at(0);
+    const WrappedTensor& indices = inputs.at(1);
+
+    int64 axis = 0;
+    int batch_dims = 0;
+    if (node.type_string() == kGatherV2Op) {
+      NodeBuilder::NodeOut unused;
+      TF_RETURN_IF_ERROR(inputs.unstacked(2, &unused));
+      TF_RETURN_IF_ERROR(GetConstScalar(inputs.at(2), &axis));
+      TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "batch_dims", &batch_dims));
+    }
+    if (batch_dims < 0) {
+      return errors::Unimplemented(
+          "Cannot vectorize gathers with negative batch_dims.");
+    }
+
+    if (!params.stacked) {
+      if (!indices.stacked) {
+        return errors::InvalidArgument("Expecting an input to be stacked.");
+      }
+      if (axis != 0 || batch_dims != 0) {
+        return errors::Unimplemented(
+            "Cannot vectorize gathers of unstacked params along axis ", axis,
+            " with batch_dims ", batch_dims);
+      }
+    } else {
+      // Since the vectorized params have an extra leading dimension, we need
+      // to increment non-negative axis values by 1. Negative axis values wrap
+      // around.
+      if (axis >= 0) ++axis;
+      if (indices.stacked) {
+        ++batch_dims;
+      } else if (batch_dims != 0) {
+        return errors::Unimplemented(
+            "Cannot vectorize gathers of unstacked indices with batch_dims ",
+            batch_dims);
+      }
+    }
+
+    Tensor axis_value(DT_INT64, TensorShape({}));
+    axis_value.scalar<int64>()() = axis;
+    Node* axis_node;
+    TF_RETURN_IF_ERROR(
+        NodeBuilder(strings::StrCat("vectorized/", node.name(), "/axis"),
+                    "Const")
+            .Attr("value", axis_value)
+            .Attr("dtype", DT_INT64)
+            .Finalize(outer_scope, &axis_node));
+
+    Node* new_node;
+    TF_RETURN_IF_ERROR(
+        NodeBuilder(strings::StrCat("vectorized/", node.name()), kGatherV2Op)
+            .Input(params.node, params.output_index)
+            .Input(indices.node, indices.output_index)
+            .Input(axis_node)
+            .Attr("batch_dims", batch_dims)
+            .Finalize(outer_scope, &new_node));
+
+    // Add output mappings
+    outputs->push_back({new_node, 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("Gather", GatherVectorizer);
+REGISTER_VECTORIZER("GatherV2", GatherVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,92 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kResizePrefix[] = "vectorized/resize";
+
+// Resize ops take a batch of images of shape [batch, height, width, channels],
+// so the stacked images, of shape [n, batch, height, width, channels], are
+// merged into a single batch of n * batch images before resizing, and split
+// again afterwards.
+class ImageResizeVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, /*refiner=*/nullptr);
+    Scope scope = parent.NewSubScope(kResizePrefix);
+
+    Output images, size;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &images));
+    TF_RETURN_IF_ERROR(inputs.unstacked(1, &size));
+
+    Output shape = ops::Shape(scope, images);
+    // shape[begin:end]
+    auto slice = [&scope, &shape](int begin, int end) -> Output {
+      return ops::StridedSlice(scope, shape, ops::Const(scope, {begin}),
+                               ops::Const(scope, {end}),
+                               ops::Const(scope, {1}));
+    };
+    // tf.reshape(images, tf.concat([[-1], shape[2:]], 0))
+    Output merged_images = ops::Reshape(
+        scope, images,
+        ops::Concat(scope, {ops::Const(scope, {-1}), slice(2, 5)},
+                    ops::Const(scope, 0)));
+
+    // Add new node with the same op type and attrs as the original node
+    Node* resized;
+    auto node_builder = NodeBuilder(strings::StrCat("vectorized/", node.name()),
+                                    node.type_string())
+                            .Input(merged_images.node(), merged_images.index())
+                            .Input(size.node(), size.index());
+    for (const auto& attr : node.attrs()) {
+      node_builder = node_builder.Attr(attr.first, attr.second);
+    }
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &resized));
+
+    // tf.concat([shape[:2], size, shape[4:]], 0), where shape[4:] is [channels]
+    Output resized_shape = ops::Concat(
+        scope, {slice(0, 2), size, slice(4, 5)}, ops::Const(scope, 0));
+    Output vectorized_resize =
+        ops::Reshape(scope, Output(resized, 0), resized_shape);
+
+    TF_RETURN_IF_ERROR(status);
+
+    // Add output mappings
+    outputs->push_back({vectorized_resize.node(), 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("ResizeArea", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBicubic", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBilinear", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeNearestNeighbor", ImageResizeVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,124 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kParseExamplePrefix[] = "vectorized/parse_example";
+
+// ParseExample already parses a vector of examples, so the stacked vectors,
+// of shape [n, batch], are merged into a single vector of n * batch examples
+// before parsing, and the dense values are split again afterwards. This is
+// what `tf.parse_single_example` runs inside a map function.
+class ParseExampleVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    // The sparse indices count the examples across the whole merged vector,
+    // and variable length dense values are padded to the longest value across
+    // it, so neither can be split back into the results for each element.
+    int num_sparse, num_dense;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "Nsparse", &num_sparse));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "Ndense", &num_dense));
+    if (num_sparse > 0) {
+      return errors::Unimplemented(
+          "Cannot vectorize ParseExample with sparse outputs.");
+    }
+    std::vector<PartialTensorShape> dense_shapes;
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node.attrs(), "dense_shapes", &dense_shapes));
+    for (const PartialTensorShape& shape : dense_shapes) {
+      if (!shape.IsFullyDefined()) {
+        return errors::Unimplemented(
+            "Cannot vectorize ParseExample with variable length dense "
+            "outputs.");
+      }
+    }
+
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, /*refiner=*/nullptr);
+    Scope scope = parent.NewSubScope(kParseExamplePrefix);
+
+    Output serialized;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &serialized));
+    // Input 1 holds the names of the examples, which only label the errors.
+    // They are dropped rather than merged like the examples.
+    std::vector<NodeBuilder::NodeOut> dense_keys, dense_defaults;
+    for (int i = 0; i < num_dense; ++i) {
+      dense_keys.emplace_back();
+      TF_RETURN_IF_ERROR(inputs.unstacked(2 + i, &dense_keys.back()));
+      dense_defaults.emplace_back();
+      TF_RETURN_IF_ERROR(
+          inputs.unstacked(2 + num_dense + i, &dense_defaults.back()));
+    }
+
+    // tf.reshape(serialized, [-1])
+    Output merged_serialized =
+        ops::Reshape(scope, serialized, ops::Const(scope, {-1}));
+    Output names = ops::Const(scope, std::initializer_list<string>({}));
+
+    Node* parsed;
+    auto node_builder =
+        NodeBuilder(strings::StrCat("vectorized/", node.name()),
+                    "ParseExample")
+            .Input(merged_serialized.node(), merged_serialized.index())
+            .Input(names.node(), names.index())
+            .Input(std::vector<NodeBuilder::NodeOut>())
+            .Input(dense_keys)
+            .Input(dense_defaults);
+    for (const auto& attr : {"sparse_types", "dense_shapes"}) {
+      const AttrValue* val;
+      TF_RETURN_IF_ERROR(node.attrs().Find(attr, &val));
+      node_builder = node_builder.Attr(attr, *val);
+    }
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &parsed));
+
+    Output serialized_shape = ops::Shape(scope, serialized);
+    for (int i = 0; i < num_dense; ++i) {
+      Output dense_values(parsed, i);
+      // tf.concat([tf.shape(serialized), tf.shape(dense_values)[1:]], 0)
+      Output value_shape = ops::StridedSlice(
+          scope, ops::Shape(scope, dense_values), ops::Const(scope, {1}),
+          ops::Const(scope, {0}), ops::Const(scope, {1}),
+          ops::StridedSlice::Attrs().EndMask(1));
+      Output vectorized_dense_values = ops::Reshape(
+          scope, dense_values,
+          ops::Concat(scope, {serialized_shape, value_shape},
+                      ops::Const(scope, 0)));
+      outputs->push_back({vectorized_dense_values.node(), 0, true});
+    }
+
+    TF_RETURN_IF_ERROR(status);
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("ParseExample", ParseExampleVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
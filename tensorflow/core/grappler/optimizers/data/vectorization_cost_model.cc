@@ -0,0 +1,116 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/vectorization_cost_model.h"
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+constexpr char kMapDefunOp[] = "MapDefun";
+
+// Cost of invoking a function: creating an executor for it and passing its
+// arguments and return values.
+constexpr double kFunctionCallCost = 10;
+// Cost of dispatching one op, independently of the size of its inputs.
+constexpr double kOpDispatchCost = 1;
+// Cost for MapDefun, per element, of slicing its arguments and copying the
+// results into its outputs, on top of invoking its function.
+constexpr double kMapDefunElementCost = 1;
+// Compute cost, per element, of ops that are not listed below.
+constexpr double kDefaultComputeCost = 1;
+// Compute cost, per element, of parsing, decoding and resizing ops.
+constexpr double kExpensiveComputeCost = 20;
+// Compute cost, per element, of parsing a batch of examples at once, which the
+// kernels split into shards that are parsed in parallel.
+constexpr double kBatchedParsingComputeCost = 5;
+
+// Returns the compute cost of running `op` on one element.
+double ComputeCost(const string& op) {
+  // Ops that only look at or change the metadata of tensors.
+  static const auto* const kFreeOps = new absl::flat_hash_set<string>(
+      {"_Arg", "_Retval", "Const", "ExpandDims", "Identity", "NoOp", "Rank",
+       "Reshape", "Shape", "ShapeN", "Size", "Squeeze"});
+  static const auto* const kExpensiveOps = new absl::flat_hash_set<string>(
+      {"DecodeAndCropJpeg", "DecodeBmp", "DecodeCSV", "DecodeCompressed",
+       "DecodeGif", "DecodeJSONExample", "DecodeJpeg", "DecodePng",
+       "DecodeRaw", "ParseExample", "ParseSingleExample",
+       "ParseSingleSequenceExample", "RegexFullMatch", "RegexReplace",
+       "ResizeArea", "ResizeBicubic", "ResizeBilinear",
+       "ResizeNearestNeighbor", "StaticRegexFullMatch", "StaticRegexReplace",
+       "StringToNumber"});
+  if (kFreeOps->contains(op)) return 0;
+  if (kExpensiveOps->contains(op)) return kExpensiveComputeCost;
+  return kDefaultComputeCost;
+}
+
+// Returns the compute cost, per element, of running `op` once on a batch.
+double BatchedComputeCost(const string& op) {
+  static const auto* const kBatchedParsingOps =
+      new absl::flat_hash_set<string>({"ParseExample", "ParseSequenceExample"});
+  if (kBatchedParsingOps->contains(op)) return kBatchedParsingComputeCost;
+  return ComputeCost(op);
+}
+
+// Returns the cost of running the ops of `fn` once on one element. Nested
+// function calls are costed like any other op.
+double PerElementCost(const FunctionDef& fn) {
+  double cost = kFunctionCallCost;
+  for (const NodeDef& node : fn.node_def()) {
+    cost += kOpDispatchCost + ComputeCost(node.op());
+  }
+  return cost;
+}
+
+}  // namespace
+
+Status EstimateVectorizationCost(const FunctionDef& map_fn,
+                                 const FunctionDef& vectorized_fn,
+                                 const FunctionLibraryDefinition& library,
+                                 int64 batch_size, VectorizationCost* cost) {
+  if (batch_size < 1) {
+    return errors::InvalidArgument("Batch size must be positive, but got ",
+                                   batch_size);
+  }
+  cost->original = batch_size * PerElementCost(map_fn);
+
+  cost->vectorized = kFunctionCallCost;
+  for (const NodeDef& node : vectorized_fn.node_def()) {
+    if (node.op() != kMapDefunOp) {
+      cost->vectorized +=
+          kOpDispatchCost + batch_size * BatchedComputeCost(node.op());
+      continue;
+    }
+    const string& name = node.attr().at("f").func().name();
+    const FunctionDef* map_defun_fn = library.Find(name);
+    if (map_defun_fn == nullptr) {
+      return errors::NotFound("Could not find function ", name,
+                              " in the function library.");
+    }
+    cost->vectorized +=
+        kOpDispatchCost +
+        batch_size * (kMapDefunElementCost + PerElementCost(*map_defun_fn));
+  }
+  return Status::OK();
+}
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
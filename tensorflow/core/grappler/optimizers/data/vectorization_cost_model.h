@@ -0,0 +1,58 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_COST_MODEL_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_COST_MODEL_H_
+
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+
+// Estimated costs, in arbitrary units, of computing a batch of elements with
+// the original map function and with the vectorized map function.
+struct VectorizationCost {
+  double original = 0;
+  double vectorized = 0;
+
+  // Returns true if vectorization is expected to be faster.
+  bool IsProfitable() const { return vectorized < original; }
+};
+
+// Estimates the cost of running `map_fn` on each of `batch_size` elements, and
+// of running `vectorized_fn` once on the batch.
+//
+// The model accounts for the fixed overheads that vectorization amortizes
+// (invoking a function and dispatching each of its ops) and for the overheads
+// it adds (the MapDefun node that runs the ops that could not be vectorized
+// element by element, and the ops that stack or reshape tensors). The compute
+// cost of an op is assumed to be the same whether it processes its elements one
+// by one or in a batch, except for parsing ops, whose kernels parse a batch in
+// parallel. The estimates are conservative for other ops whose kernels are
+// faster on batches. The functions that MapDefun nodes in `vectorized_fn` call
+// are looked up in `library`.
+Status EstimateVectorizationCost(const FunctionDef& map_fn,
+                                 const FunctionDef& vectorized_fn,
+                                 const FunctionLibraryDefinition& library,
+                                 int64 batch_size, VectorizationCost* cost);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_COST_MODEL_H_
@@ -0,0 +1,151 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/vectorization_cost_model.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// dataset.map(lambda x: tf.cast(x, tf.float32))
+FunctionDef CastFn() {
+  return FunctionDefHelper::Create(
+      /*function_name=*/"cast_fn",
+      /*in_def=*/{"x: int64"},
+      /*out_def=*/{"res: float"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{{"cast"}, "Cast", {"x"}, {{"SrcT", DT_INT64}, {"DstT", DT_FLOAT}}}},
+      /*ret_def=*/{{"res", "cast:y:0"}});
+}
+
+// The vectorized version of `CastFn()`, which does the same work on a batch.
+FunctionDef VectorizedCastFn() {
+  FunctionDef fn = CastFn();
+  fn.mutable_signature()->set_name("vectorized_cast_fn");
+  return fn;
+}
+
+// The vectorized version of `CastFn()` if the cast could not be vectorized.
+FunctionDef MapDefunCastFn() {
+  return FunctionDefHelper::Create(
+      /*function_name=*/"map_defun_cast_fn",
+      /*in_def=*/{"x: int64"},
+      /*out_def=*/{"res: float"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{{"map_defun"},
+        "MapDefun",
+        {"x"},
+        {{"Targuments", DataTypeSlice{DT_INT64}},
+         {"Tcaptured", DataTypeSlice{}},
+         {"output_types", DataTypeSlice{DT_FLOAT}},
+         {"output_shapes", gtl::ArraySlice<TensorShape>{{}}},
+         {"f", FunctionDefHelper::FunctionRef("cast_fn")}}}},
+      /*ret_def=*/{{"res", "map_defun:output:0"}});
+}
+
+// dataset.map(lambda x: tf.io.parse_example(x, {"f": FixedLenFeature((),
+// tf.int64, 0)})), where `x` is a vector of serialized examples.
+FunctionDef ParseExampleFn() {
+  return FunctionDefHelper::Create(
+      /*function_name=*/"parse_example_fn",
+      /*in_def=*/{"x: string"},
+      /*out_def=*/{"res: int64"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {FunctionDefHelper::Const("names", gtl::ArraySlice<tstring>({})),
+       FunctionDefHelper::Const("key", tstring("f")),
+       FunctionDefHelper::Const("default", static_cast<int64>(0)),
+       {{"parse"},
+        "ParseExample",
+        {"x", "names:output:0", "key:output:0", "default:output:0"},
+        {{"Nsparse", 0},
+         {"Ndense", 1},
+         {"sparse_types", DataTypeSlice{}},
+         {"Tdense", DataTypeSlice{DT_INT64}},
+         {"dense_shapes", std::vector<TensorShape>({TensorShape()})}}}},
+      /*ret_def=*/{{"res", "parse:dense_values:0"}});
+}
+
+TEST(VectorizationCostModelTest, VectorizedFunctionIsProfitable) {
+  FunctionDefLibrary lib_def;
+  FunctionLibraryDefinition library(OpRegistry::Global(), lib_def);
+  VectorizationCost cost;
+  TF_ASSERT_OK(EstimateVectorizationCost(CastFn(), VectorizedCastFn(), library,
+                                         /*batch_size=*/16, &cost));
+  EXPECT_TRUE(cost.IsProfitable());
+}
+
+TEST(VectorizationCostModelTest, MapDefunFunctionIsNotProfitable) {
+  FunctionDefLibrary lib_def;
+  *lib_def.add_function() = CastFn();
+  FunctionLibraryDefinition library(OpRegistry::Global(), lib_def);
+  VectorizationCost cost;
+  TF_ASSERT_OK(EstimateVectorizationCost(CastFn(), MapDefunCastFn(), library,
+                                         /*batch_size=*/16, &cost));
+  EXPECT_FALSE(cost.IsProfitable());
+}
+
+TEST(VectorizationCostModelTest, BatchedParsingIsDiscounted) {
+  FunctionDefLibrary lib_def;
+  FunctionLibraryDefinition library(OpRegistry::Global(), lib_def);
+  FunctionDef vectorized_fn = ParseExampleFn();
+  vectorized_fn.mutable_signature()->set_name("vectorized_parse_example_fn");
+  VectorizationCost cost;
+  TF_ASSERT_OK(EstimateVectorizationCost(ParseExampleFn(), vectorized_fn,
+                                         library, /*batch_size=*/16, &cost));
+  // Parsing dominates both functions, and a batch is parsed in parallel.
+  EXPECT_LT(cost.vectorized, cost.original / 2);
+}
+
+TEST(VectorizationCostModelTest, BatchOfOneIsNotProfitable) {
+  FunctionDefLibrary lib_def;
+  FunctionLibraryDefinition library(OpRegistry::Global(), lib_def);
+  VectorizationCost cost;
+  TF_ASSERT_OK(EstimateVectorizationCost(CastFn(), VectorizedCastFn(), library,
+                                         /*batch_size=*/1, &cost));
+  EXPECT_FALSE(cost.IsProfitable());
+}
+
+TEST(VectorizationCostModelTest, MissingMapDefunFunction) {
+  FunctionDefLibrary lib_def;
+  FunctionLibraryDefinition library(OpRegistry::Global(), lib_def);
+  VectorizationCost cost;
+  EXPECT_EQ(EstimateVectorizationCost(CastFn(), MapDefunCastFn(), library,
+                                      /*batch_size=*/16, &cost)
+                .code(),
+            error::NOT_FOUND);
+}
+
+TEST(VectorizationCostModelTest, InvalidBatchSize) {
+  FunctionDefLibrary lib_def;
+  FunctionLibraryDefinition library(OpRegistry::Global(), lib_def);
+  VectorizationCost cost;
+  EXPECT_EQ(EstimateVectorizationCost(CastFn(), VectorizedCastFn(), library,
+                                      /*batch_size=*/0, &cost)
+                .code(),
+            error::INVALID_ARGUMENT);
+}
+
+}  // namespace
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op_def.pb.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/grappler/mutable_graph_view.h"
 #include "tensorflow/core/grappler/optimizers/data/function_utils.h"
@@ -156,6 +157,22 @@ class Vectorization {
   // `outer_scope_`, until there are no convertible outputs remaining.
   void VectorizeHelper();
 
+  // Vectorizes the ops of `map_defun_fn_` whose inputs have all been converted,
+  // in topological order, starting from the arguments. This complements
+  // `VectorizeHelper`, which converts ops backwards from the outputs and stops
+  // at the first unconvertible op: the ops that run before that op are
+  // converted here, and their results are passed to the MapDefun node as new
+  // arguments, so that only the unconvertible ops run element by element.
+  Status VectorizePrefix();
+
+  // Replaces `map_defun_node_` with a MapDefun node that also takes
+  // `new_arguments` as arguments and `new_captured` as captured inputs, and
+  // adds the corresponding `_Arg` nodes to `map_defun_fn_`, in
+  // `new_arg_nodes`.
+  Status AddMapDefunInputs(const std::vector<WrappedTensor>& new_arguments,
+                           const std::vector<WrappedTensor>& new_captured,
+                           std::vector<Node*>* new_arg_nodes);
+
   // Vectorizes map_defun_fn's output at output_position.
   Status ConvertOutput(int output_position);
 
@@ -334,6 +351,9 @@ Status Vectorization::Vectorize(const FunctionDef& outer_scope,
                                 FunctionDef** result) {
   TF_RETURN_IF_ERROR(Initialize(outer_scope, map_defun_node));
   VectorizeHelper();
+  if (!map_defun_fn_->ret_nodes.empty()) {
+    TF_RETURN_IF_ERROR(VectorizePrefix());
+  }
   return GetResult(result);
 }
 
@@ -364,6 +384,221 @@ void Vectorization::VectorizeHelper() {
   }
 }
 
+Status Vectorization::VectorizePrefix() {
+  Graph* inner = map_defun_fn_->graph;
+  std::vector<Node*> order;
+  GetReversePostOrder(*inner, &order);
+
+  absl::flat_hash_set<const Node*> converted;
+  for (Node* node : order) {
+    if (!node->IsOp() || node->IsArg() || node->IsRetval() ||
+        node->num_outputs() == 0 || node->op_def().is_stateful() ||
+        conversion_map_.find({node, 0}) != conversion_map_.end()) {
+      continue;
+    }
+    auto vectorizer = VectorizerRegistry::Global()->Get(node->type_string());
+    if (vectorizer == nullptr) continue;
+    // The sparse outputs of a vectorized parsing op describe the whole batch,
+    // so MapDefun cannot slice them into the outputs for each element.
+    int num_sparse;
+    if (GetNodeAttr(node->attrs(), "num_sparse", &num_sparse).ok() &&
+        num_sparse > 0) {
+      continue;
+    }
+
+    std::vector<const Edge*> input_edges;
+    if (!node->input_edges(&input_edges).ok()) continue;
+    bool has_control_inputs = false;
+    for (const Edge* edge : node->in_edges()) {
+      if (edge->IsControlEdge() && !edge->src()->IsSource()) {
+        has_control_inputs = true;
+      }
+    }
+    if (has_control_inputs) continue;
+
+    // Only ops whose inputs have all been converted, at least one of them to a
+    // stacked tensor, are worth converting: ops with only unstacked inputs were
+    // already lifted by `AddUnstackedTensorMappings`.
+    std::vector<WrappedTensor> inputs;
+    inputs.reserve(input_edges.size());
+    bool has_stacked_input = false;
+    for (const Edge* edge : input_edges) {
+      auto found =
+          gtl::FindOrNull(conversion_map_, {edge->src(), edge->src_output()});
+      if (found == nullptr) break;
+      has_stacked_input |= found->stacked;
+      inputs.push_back(*found);
+    }
+    if (inputs.size() != input_edges.size() || !has_stacked_input) continue;
+
+    std::vector<WrappedTensor> outputs;
+    Status s = vectorizer->Vectorize(*node, outer_scope_.get(),
+                                     std::move(inputs), &outputs);
+    if (!s.ok() || outputs.size() != node->num_outputs()) {
+      VLOG(2) << "Could not convert node " << node->name()
+              << " before the MapDefun node: " << s;
+      continue;
+    }
+    for (int i = 0; i < node->num_outputs(); ++i) {
+      conversion_map_.insert({{node, i}, outputs[i]});
+    }
+    converted.insert(node);
+  }
+  if (converted.empty()) return Status::OK();
+
+  // Feed the converted tensors that unconverted ops consume to the MapDefun
+  // node. Stacked tensors become arguments, which MapDefun slices, and
+  // unstacked ones captured inputs.
+  std::vector<TensorDesc> new_argument_tensors, new_captured_tensors;
+  std::vector<WrappedTensor> new_arguments, new_captured;
+  std::vector<const Edge*> edges_to_replace;
+  for (const Node* node : order) {
+    if (!converted.contains(node)) continue;
+    for (const Edge* edge : node->out_edges()) {
+      if (edge->IsControlEdge() || converted.contains(edge->dst())) continue;
+      edges_to_replace.push_back(edge);
+      TensorDesc tensor = {edge->src(), edge->src_output()};
+      if (std::find(new_argument_tensors.begin(), new_argument_tensors.end(),
+                    tensor) != new_argument_tensors.end() ||
+          std::find(new_captured_tensors.begin(), new_captured_tensors.end(),
+                    tensor) != new_captured_tensors.end()) {
+        continue;
+      }
+      const WrappedTensor& converted_tensor = conversion_map_.at(tensor);
+      if (converted_tensor.stacked) {
+        new_argument_tensors.push_back(tensor);
+        new_arguments.push_back(converted_tensor);
+      } else {
+        new_captured_tensors.push_back(tensor);
+        new_captured.push_back(converted_tensor);
+      }
+    }
+  }
+
+  std::vector<Node*> new_arg_nodes;
+  TF_RETURN_IF_ERROR(
+      AddMapDefunInputs(new_arguments, new_captured, &new_arg_nodes));
+  std::map<TensorDesc, Node*> arg_for_tensor;
+  for (int i = 0; i < new_argument_tensors.size(); ++i) {
+    arg_for_tensor[new_argument_tensors[i]] = new_arg_nodes[i];
+  }
+  for (int i = 0; i < new_captured_tensors.size(); ++i) {
+    arg_for_tensor[new_captured_tensors[i]] =
+        new_arg_nodes[new_argument_tensors.size() + i];
+  }
+  for (const Edge* edge : edges_to_replace) {
+    Node* arg_node = arg_for_tensor.at({edge->src(), edge->src_output()});
+    Node* dst = edge->dst();
+    int dst_input = edge->dst_input();
+    inner->RemoveEdge(edge);
+    inner->AddEdge(arg_node, 0, dst, dst_input);
+  }
+
+  // Drop the converted ops that nothing in the function depends on anymore.
+  std::unordered_set<const Node*> live(map_defun_fn_->ret_nodes.begin(),
+                                       map_defun_fn_->ret_nodes.end());
+  live.insert(map_defun_fn_->arg_nodes.begin(),
+              map_defun_fn_->arg_nodes.end());
+  PruneForReverseReachability(inner, std::move(live));
+  return Status::OK();
+}
+
+Status Vectorization::AddMapDefunInputs(
+    const std::vector<WrappedTensor>& new_arguments,
+    const std::vector<WrappedTensor>& new_captured,
+    std::vector<Node*>* new_arg_nodes) {
+  const int num_arguments =
+      map_defun_node_->attrs().Find("Targuments")->list().type_size();
+  const int num_captured = map_defun_fn_->arg_nodes.size() - num_arguments;
+
+  std::vector<const Edge*> input_edges;
+  TF_RETURN_IF_ERROR(map_defun_node_->input_edges(&input_edges));
+  std::vector<NodeBuilder::NodeOut> arguments, captured;
+  DataTypeVector t_arguments, t_captured;
+  for (int i = 0; i < input_edges.size(); ++i) {
+    const Edge* edge = input_edges[i];
+    NodeBuilder::NodeOut input(edge->src(), edge->src_output());
+    if (i < num_arguments) {
+      arguments.push_back(input);
+      t_arguments.push_back(input.dt);
+    } else {
+      captured.push_back(input);
+      t_captured.push_back(input.dt);
+    }
+  }
+
+  // Adds an `_Arg` node for `tensor` to `map_defun_fn_` and `tensor` to
+  // `inputs`.
+  auto add_input = [this, new_arg_nodes](
+                       const WrappedTensor& tensor,
+                       std::vector<NodeBuilder::NodeOut>* inputs,
+                       DataTypeVector* types) {
+    DataType type = tensor.node->output_type(tensor.output_index);
+    inputs->emplace_back(tensor.node, tensor.output_index);
+    types->push_back(type);
+    Node* arg_node;
+    TF_RETURN_IF_ERROR(NodeBuilder("map_arg", "_Arg")
+                           .Attr("T", type)
+                           .Attr("index", 0)  // Set below.
+                           .Finalize(map_defun_fn_->graph, &arg_node));
+    new_arg_nodes->push_back(arg_node);
+    return Status::OK();
+  };
+  for (const WrappedTensor& tensor : new_arguments) {
+    TF_RETURN_IF_ERROR(add_input(tensor, &arguments, &t_arguments));
+  }
+  for (const WrappedTensor& tensor : new_captured) {
+    TF_RETURN_IF_ERROR(add_input(tensor, &captured, &t_captured));
+  }
+
+  // Arguments come before captured inputs, so the new arguments go between
+  // the old arguments and the old captured inputs.
+  const auto& old_arg_nodes = map_defun_fn_->arg_nodes;
+  std::vector<Node*> arg_nodes(old_arg_nodes.begin(),
+                               old_arg_nodes.begin() + num_arguments);
+  arg_nodes.insert(arg_nodes.end(), new_arg_nodes->begin(),
+                   new_arg_nodes->begin() + new_arguments.size());
+  arg_nodes.insert(arg_nodes.end(), old_arg_nodes.begin() + num_arguments,
+                   old_arg_nodes.end());
+  arg_nodes.insert(arg_nodes.end(),
+                   new_arg_nodes->begin() + new_arguments.size(),
+                   new_arg_nodes->end());
+  DCHECK_EQ(arg_nodes.size(), num_arguments + new_arguments.size() +
+                                  num_captured + new_captured.size());
+  map_defun_fn_->arg_nodes.assign(arg_nodes.begin(), arg_nodes.end());
+  map_defun_fn_->arg_types.clear();
+  for (int i = 0; i < arg_nodes.size(); ++i) {
+    arg_nodes[i]->AddAttr("index", i);
+    map_defun_fn_->arg_types.push_back(arg_nodes[i]->output_type(0));
+  }
+
+  NodeBuilder builder(map_defun_node_->name(), map_defun_node_->type_string());
+  builder.Input(arguments).Input(captured);
+  for (const auto& attr : map_defun_node_->attrs()) {
+    if (attr.first != "Targuments" && attr.first != "Tcaptured") {
+      builder.Attr(attr.first, attr.second);
+    }
+  }
+  builder.Attr("Targuments", t_arguments).Attr("Tcaptured", t_captured);
+  Node* new_map_defun_node;
+  TF_RETURN_IF_ERROR(builder.Finalize(outer_scope_.get(), &new_map_defun_node));
+
+  for (const Edge* edge : map_defun_node_->in_edges()) {
+    if (edge->IsControlEdge()) {
+      outer_scope_->AddControlEdge(edge->src(), new_map_defun_node);
+    }
+  }
+  std::vector<const Edge*> out_edges(map_defun_node_->out_edges().begin(),
+                                     map_defun_node_->out_edges().end());
+  for (const Edge* edge : out_edges) {
+    outer_scope_->AddEdge(new_map_defun_node, edge->src_output(), edge->dst(),
+                          edge->dst_input());
+  }
+  outer_scope_->RemoveNode(map_defun_node_);
+  map_defun_node_ = new_map_defun_node;
+  return Status::OK();
+}
+
 Status Vectorization::Initialize(const FunctionDef& outer_scope,
                                  const NodeDef& map_defun_node) {
   // Convert outer_scope and map_defun_fn to FunctionBodys so we can
@@ -36,7 +36,10 @@ namespace vectorization_utils {
 // vectorization only succeeds partially, a MapDefun node remains in `result` to
 // be used for operations that were not lifted, and the modified MapDefun
 // function is added to `lib`. The newly vectorized function `result` is also
-// added to `lib`.
+// added to `lib`. Operations are lifted both backwards from the outputs of the
+// MapDefun function and forwards from its arguments, so when an operation
+// cannot be lifted, the operations that run before and after it still are, and
+// only the operations in between run element by element.
 //
 // Returns Status::OK() if the vectorization is completely or partially
 // successful. Otherwise, returns an error, and sets `result` to nullptr.
@@ -655,6 +655,102 @@ TEST(VectorizeMapDefunTest, VectorizeWithUnstackedControl) {
   EXPECT_EQ(cast_node.input(1), strings::StrCat("^", const_dep_node->name()));
 }
 
+// Before:
+//
+//                 +------+
+// +---------------+ Arg0 +---------+
+// |               +---+--+         |
+// |                   |            |
+// |               +---v--+         |
+// |   +-----------+ Arg0 +-----+   |
+// |   |           +---+--+     |   |
+// |   |               |        |   |
+// |   |           +---v--+     |   |
+// |   |           | Cast |     |   |
+// |   |           +---+--+     |   |
+// |   |               |        |   |
+// |   |           +---v--+     |   |
+// |   |           | XOp1 |     |   |
+// |   |           +---+--+     |   |
+// |   |               |        |   |
+// |   | MapDefun  +---v--+     |   |
+// |   +-----------+ Ret0 +-----+   |
+// |               +---+--+         |
+// |                   |            |
+// |               +---v--+         |
+// +---------------+ Ret0 +---------+
+//                 +------+
+//
+//   where XOp1 does not have a vectorizer defined.
+//
+// After:
+//
+//                 +------+
+// +---------------+ Arg0 +---------+
+// |               +---+--+         |
+// |                   |            |
+// |               +---v--+         |
+// |               | Cast |         |
+// |               +---+--+         |
+// |                   |            |
+// |               +---v--+         |
+// |   +-----------+ Arg1 +-----+   |
+// |   |           +---+--+     |   |
+// |   |               |        |   |
+// |   |           +---v--+     |   |
+// |   |           | XOp1 |     |   |
+// |   |           +---+--+     |   |
+// |   |               |        |   |
+// |   | MapDefun  +---v--+     |   |
+// |   +-----------+ Ret0 +-----+   |
+// |               +---+--+         |
+// |                   |            |
+// |               +---v--+         |
+// +---------------+ Ret0 +---------+
+//                 +------+
+//
+TEST(VectorizeMapDefunTest, VectorizeOpsBeforeUnvectorizableOp) {
+  FunctionDef inner = FunctionDefHelper::Create(
+      /*function_name=*/"inner_function",
+      /*in_def=*/{"arg0: int32"},
+      /*out_def=*/{"ret0: int64"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {Cast("Cast", {"arg0"}, DT_INT32, DT_INT64),
+       {{"MatMul"}, "MatMul", {"Cast:y:0", "Cast:y:0"}, {{"T", DT_INT64}}}},
+      /*ret_def=*/{{"ret0", "MatMul:product:0"}});
+
+  FunctionDefLibrary lib;
+  FunctionDef* vectorized;
+  TF_ASSERT_OK(WrapAndVectorize(inner, &lib, &vectorized));
+
+  ASSERT_TRUE(function_utils::ContainsFunctionNodeWithOp("Cast", *vectorized));
+  ASSERT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+  const NodeDef& cast_node = vectorized->node_def(
+      function_utils::FindFunctionNodeWithOp("Cast", *vectorized));
+  const NodeDef& map_defun_node = vectorized->node_def(
+      function_utils::FindFunctionNodeWithOp("MapDefun", *vectorized));
+  EXPECT_EQ(cast_node.input(0), vectorized->signature().input_arg(0).name());
+  ASSERT_EQ(map_defun_node.attr().at("Targuments").list().type_size(), 2);
+  EXPECT_EQ(map_defun_node.input(1), strings::StrCat(cast_node.name(), ":y:0"));
+
+  // Only MatMul should be left in the MapDefun function, and it should read
+  // the new argument.
+  FunctionLibraryDefinition lib_def(OpRegistry::Global(), lib);
+  const FunctionDef* map_defun_fn =
+      lib_def.Find(map_defun_node.attr().at("f").func().name());
+  ASSERT_NE(map_defun_fn, nullptr);
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("Cast", *map_defun_fn));
+  ASSERT_EQ(map_defun_fn->signature().input_arg_size(), 2);
+  const string& new_arg = map_defun_fn->signature().input_arg(1).name();
+  const NodeDef& matmul_node = map_defun_fn->node_def(
+      function_utils::FindFunctionNodeWithOp("MatMul", *map_defun_fn));
+  EXPECT_EQ(matmul_node.input(0), new_arg);
+  EXPECT_EQ(matmul_node.input(1), new_arg);
+}
+
 ///==================================//
 // Tests for specific op vectorizers //
 ///==================================//
@@ -1332,6 +1428,61 @@ TEST(VectorizerTest, VectorizeParseSingleExampleWithStackedDefaults) {
       function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
 }
 
+// What `tf.parse_single_example` runs: the example is expanded to a vector of
+// one example for ParseExample, and the dense values are squeezed again.
+TEST(VectorizerTest, VectorizeParseExampleOfOneExample) {
+  FunctionDef inner = FunctionDefHelper::Create(
+      /*function_name=*/"inner_function",
+      /*in_def=*/{"arg0: string"},
+      /*out_def=*/{"dv0: int64", "dv1: string"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {FunctionDefHelper::Const("Dim", 0),
+       {{"ExpandDims"},
+        "ExpandDims",
+        {"arg0", "Dim:output:0"},
+        {{"T", DT_STRING}, {"Tdim", DT_INT32}}},
+       FunctionDefHelper::Const("Names", gtl::ArraySlice<tstring>({})),
+       FunctionDefHelper::Const("DenseIntKey", tstring("dense_int")),
+       FunctionDefHelper::Const("DenseStrKey", tstring("dense_str")),
+       FunctionDefHelper::Const("DenseIntDefault", static_cast<int64>(0)),
+       FunctionDefHelper::Const("DenseStrDefault", tstring("")),
+       {{"Parse"},
+        "ParseExample",
+        {"ExpandDims:output:0", "Names:output:0", "DenseIntKey:output:0",
+         "DenseStrKey:output:0", "DenseIntDefault:output:0",
+         "DenseStrDefault:output:0"},
+        {
+            {"Nsparse", 0},
+            {"Ndense", 2},
+            {"sparse_types", DataTypeVector({})},
+            {"Tdense", DataTypeVector({DT_INT64, DT_STRING})},
+            {"dense_shapes",
+             std::vector<TensorShape>({TensorShape(), TensorShape()})},
+        }},
+       {{"SqueezeInt"},
+        "Squeeze",
+        {"Parse:dense_values:0"},
+        {{"T", DT_INT64}, {"squeeze_dims", gtl::ArraySlice<int>({0})}}},
+       {{"SqueezeStr"},
+        "Squeeze",
+        {"Parse:dense_values:1"},
+        {{"T", DT_STRING}, {"squeeze_dims", gtl::ArraySlice<int>({0})}}}},
+      /*ret_def=*/
+      {
+          {"dv0", "SqueezeInt:output:0"},
+          {"dv1", "SqueezeStr:output:0"},
+      });
+
+  FunctionDefLibrary lib;
+  FunctionDef* vectorized;
+  TF_ASSERT_OK(WrapAndVectorize(inner, &lib, &vectorized));
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+  EXPECT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("ParseExample", *vectorized));
+}
+
 TEST(VectorizerTest, VectorizeTranspose) {
   FunctionDef inner = FunctionDefHelper::Create(
       /*function_name=*/"inner_function",
@@ -1380,6 +1531,101 @@ TEST(VectorizerTest, VectorizeIdentity) {
   EXPECT_EQ(vectorized->node_def_size(), 1);
 }
 
+TEST(VectorizerTest, VectorizeStringLower) {
+  FunctionDef inner = FunctionDefHelper::Create(
+      /*function_name=*/"inner_function",
+      /*in_def=*/{"arg0: string"},
+      /*out_def=*/{"ret0: string"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{{"StringLower"}, "StringLower", {"arg0"}, {{"encoding", ""}}}},
+      /*ret_def=*/{{"ret0", "StringLower:output:0"}});
+
+  FunctionDefLibrary lib;
+  FunctionDef* vectorized;
+  TF_ASSERT_OK(WrapAndVectorize(inner, &lib, &vectorized));
+
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+  ASSERT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("StringLower", *vectorized));
+  const NodeDef& lower_node = vectorized->node_def(
+      function_utils::FindFunctionNodeWithOp("StringLower", *vectorized));
+  EXPECT_EQ(lower_node.input(0), vectorized->signature().input_arg(0).name());
+  EXPECT_EQ(GetRetval(*vectorized, 0),
+            strings::StrCat(lower_node.name(), ":output:0"));
+}
+
+TEST(VectorizerTest, VectorizeGatherWithStackedIndices) {
+  FunctionDef inner = FunctionDefHelper::Create(
+      /*function_name=*/"inner_function",
+      /*in_def=*/{"arg0: int32"},
+      /*out_def=*/{"ret0: float"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {FunctionDefHelper::Const("Params", gtl::ArraySlice<float>({1, 2, 3})),
+       FunctionDefHelper::Const("Axis", 0),
+       {{"Gather"},
+        "GatherV2",
+        {"Params:output:0", "arg0", "Axis:output:0"},
+        {{"Tparams", DT_FLOAT},
+         {"Tindices", DT_INT32},
+         {"Taxis", DT_INT32},
+         {"batch_dims", 0}}}},
+      /*ret_def=*/{{"ret0", "Gather:output:0"}});
+
+  FunctionDefLibrary lib;
+  FunctionDef* vectorized;
+  TF_ASSERT_OK(WrapAndVectorize(inner, &lib, &vectorized));
+
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+  ASSERT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("GatherV2", *vectorized));
+  const NodeDef& gather_node = vectorized->node_def(
+      function_utils::FindFunctionNodeWithOp("GatherV2", *vectorized));
+  EXPECT_EQ(gather_node.input(1), vectorized->signature().input_arg(0).name());
+}
+
+TEST(VectorizerTest, VectorizeGatherWithStackedParams) {
+  FunctionDef inner = FunctionDefHelper::Create(
+      /*function_name=*/"inner_function",
+      /*in_def=*/{"arg0: float"},
+      /*out_def=*/{"ret0: float"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {FunctionDefHelper::Const("Indices", gtl::ArraySlice<int>({2, 0})),
+       FunctionDefHelper::Const("Axis", 0),
+       {{"Gather"},
+        "GatherV2",
+        {"arg0", "Indices:output:0", "Axis:output:0"},
+        {{"Tparams", DT_FLOAT},
+         {"Tindices", DT_INT32},
+         {"Taxis", DT_INT32},
+         {"batch_dims", 0}}}},
+      /*ret_def=*/{{"ret0", "Gather:output:0"}});
+
+  FunctionDefLibrary lib;
+  FunctionDef* vectorized;
+  TF_ASSERT_OK(WrapAndVectorize(inner, &lib, &vectorized));
+
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+  ASSERT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("GatherV2", *vectorized));
+  const NodeDef& gather_node = vectorized->node_def(
+      function_utils::FindFunctionNodeWithOp("GatherV2", *vectorized));
+  EXPECT_EQ(gather_node.input(0), vectorized->signature().input_arg(0).name());
+  // The elements are gathered along the second dimension of the batch.
+  const string axis_name =
+      gather_node.input(2).substr(0, gather_node.input(2).find(':'));
+  const NodeDef& axis_node = vectorized->node_def(
+      function_utils::FindFunctionNodeWithName(axis_name, *vectorized));
+  Tensor axis;
+  ASSERT_TRUE(axis.FromProto(axis_node.attr().at("value").tensor()));
+  EXPECT_EQ(axis.flat<int64>()(0), 1);
+}
+
 }  // namespace
 }  // namespace vectorization_utils
 }  // namespace grappler
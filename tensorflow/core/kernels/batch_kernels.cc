@@ -20,14 +20,17 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/batching_util/adaptive_batch_size_policy.h"
 #include "tensorflow/core/kernels/batching_util/periodic_function.h"
 #include "tensorflow/core/kernels/batching_util/shared_batch_scheduler.h"
 #include "tensorflow/core/kernels/concat_lib.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/kernels/split_lib.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
@@ -38,6 +41,32 @@ typedef Eigen::GpuDevice GPUDevice;
 typedef Eigen::SyclDevice SYCLDevice;
 #endif  // TENSORFLOW_USE_SYCL
 
+namespace {
+
+auto* batch_size_histogram = monitoring::Sampler<2>::New(
+    {"/tensorflow/serving/batching/batch_size",
+     "The size of the batches formed by a batching queue, before padding.",
+     "shared_name", "queue"},
+    // Power of 2 with bucket count 16 (32768)
+    {monitoring::Buckets::Exponential(1, 2, 16)});
+
+auto* padding_ratio_histogram = monitoring::Sampler<2>::New(
+    {"/tensorflow/serving/batching/padding_ratio",
+     "The fraction of padding in the batches formed by a batching queue.",
+     "shared_name", "queue"},
+    {monitoring::Buckets::Explicit(
+        {0.05, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9})});
+
+auto* queueing_delay_histogram = monitoring::Sampler<2>::New(
+    {"/tensorflow/serving/batching/queueing_delay_usecs",
+     "The time spent by the tasks in a batching queue, from their arrival to "
+     "the processing of their batch, in microseconds.",
+     "shared_name", "queue"},
+    // Power of 2 with bucket count 24 (> 16 seconds)
+    {monitoring::Buckets::Exponential(1, 2, 24)});
+
+}  // namespace
+
 // Concatenates 'inputs' into a single tensor along the zeroth dimension.
 // Requires that all elements of 'inputs' have element type T. Writes to the
 // op's output at position 'output_index', using 'context' for the allocation to
@@ -215,8 +244,13 @@ class BatchResource : public ResourceBase {
                        int32 batch_timeout_micros, int32 max_enqueued_batches,
                        const std::vector<int32>& allowed_batch_sizes,
                        FunctionLibraryRuntime::Handle fhandle,
+                       bool enable_adaptive_batching,
+                       const string& shared_name,
                        std::unique_ptr<BatchResource>* resource) {
     std::unique_ptr<BatchResource> new_resource(new BatchResource);
+    new_resource->shared_name_ = shared_name;
+    new_resource->num_batch_threads_ = num_batch_threads;
+    new_resource->enable_adaptive_batching_ = enable_adaptive_batching;
 
     Batcher::Options batcher_options;
     batcher_options.num_batch_threads = num_batch_threads;
@@ -246,6 +280,7 @@ class BatchResource : public ResourceBase {
                        AsyncOpKernel::DoneCallback done_callback) {
     std::unique_ptr<BatchTask> batch_components(new BatchTask);
     batch_components->guid = guid;
+    batch_components->start_time_micros = Env::Default()->NowMicros();
     batch_components->propagated_context = Context(ContextKind::kThread);
     OpInputList tensors;
     TF_RETURN_IF_ERROR(context->input_list("in_tensors", &tensors));
@@ -275,8 +310,13 @@ class BatchResource : public ResourceBase {
     batch_components->done_callback = std::move(done_callback);
 
     BatcherQueue* batcher_queue;
-    TF_RETURN_IF_ERROR(
-        LookupOrCreateBatcherQueue(batcher_queue_name, &batcher_queue));
+    serving::AdaptiveBatchSizePolicy* policy;
+    TF_RETURN_IF_ERROR(LookupOrCreateBatcherQueue(batcher_queue_name,
+                                                  &batcher_queue, &policy));
+    if (policy != nullptr) {
+      policy->RecordArrival(batch_components->start_time_micros,
+                            batch_components->size());
+    }
     return batcher_queue->Schedule(&batch_components);
   }
 
@@ -290,6 +330,9 @@ class BatchResource : public ResourceBase {
 
     Context propagated_context;
 
+    // The time at which the task was enqueued.
+    uint64 start_time_micros;
+
     std::vector<Tensor> inputs;
     std::vector<Tensor> captured_inputs;
     OpKernelContext* context;
@@ -334,6 +377,23 @@ class BatchResource : public ResourceBase {
     return batch_size;
   }
 
+  // Records the size, the padding and the queueing delays of 'batch' in the
+  // metrics of the queue named 'queue_name'.
+  void RecordBatchMetrics(const Batch& batch, const string& queue_name) const {
+    const uint64 now_micros = Env::Default()->NowMicros();
+    const int batch_size = batch.size();
+    const int padded_batch_size = RoundToLowestAllowedBatchSize(batch_size);
+    batch_size_histogram->GetCell(shared_name_, queue_name)->Add(batch_size);
+    padding_ratio_histogram->GetCell(shared_name_, queue_name)
+        ->Add(static_cast<double>(padded_batch_size - batch_size) /
+              padded_batch_size);
+    auto* queueing_delay =
+        queueing_delay_histogram->GetCell(shared_name_, queue_name);
+    for (int task_idx = 0; task_idx < batch.num_tasks(); ++task_idx) {
+      queueing_delay->Add(now_micros - batch.task(task_idx).start_time_micros);
+    }
+  }
+
   Status ConcatInputTensors(const Batch& batch, OpKernelContext* context,
                             std::vector<Tensor>* concatenated_tensors) const {
     if (batch.num_tasks() == 0) {
@@ -343,6 +403,12 @@ class BatchResource : public ResourceBase {
     const int padded_batch_size = RoundToLowestAllowedBatchSize(batch.size());
     const int padding_amount = padded_batch_size - batch.size();
 
+    // A batch made of a single task needs no copy.
+    if (batch.num_tasks() == 1 && padding_amount == 0) {
+      *concatenated_tensors = batch.task(0).inputs;
+      return Status::OK();
+    }
+
     // All tasks should have the same number of input edges.
     const int num_inputs = batch.task(0).inputs.size();
     concatenated_tensors->reserve(num_inputs);
@@ -451,6 +517,11 @@ class BatchResource : public ResourceBase {
             "the 0th dimension sizes of the input tensors");
       }
 
+      if (batch->num_tasks() == 1 && padding_size == 0) {
+        batch->mutable_task(0)->context->set_output(i, output_tensor);
+        continue;
+      }
+
       std::vector<Tensor> split_tensor;
       const Status split_status = tensor::Split(
           output_tensor, task_sizes_plus_optional_padding, &split_tensor);
@@ -477,10 +548,14 @@ class BatchResource : public ResourceBase {
     return Status::OK();
   }
 
-  void ProcessFuncBatch(std::unique_ptr<Batch> batch) const {
+  // Processes a batch of the queue named 'queue_name' by running the
+  // function. If 'policy' is not null, records the latency of the batch in it.
+  void ProcessFuncBatch(std::unique_ptr<Batch> batch, const string& queue_name,
+                        serving::AdaptiveBatchSizePolicy* policy) const {
     if (batch->empty()) {
       return;
     }
+    RecordBatchMetrics(*batch, queue_name);
 
     // We use the 'propagated_context' from one of the threads which setup one
     // of the tasks. This will propagate any common context over all the threads
@@ -538,6 +613,8 @@ class BatchResource : public ResourceBase {
     // Releases the cleanup method here, because the callback of the function
     // library runtime will handle it now.
     finally.release();
+    const int padded_batch_size = RoundToLowestAllowedBatchSize(batch->size());
+    const uint64 start_time_micros = Env::Default()->NowMicros();
     flib->Run(
         opts, fhandle_, args, &combined_outputs, [&](const Status& run_status) {
           Status final_status;
@@ -554,6 +631,11 @@ class BatchResource : public ResourceBase {
           if (!final_status.ok()) {
             return;
           }
+          if (policy != nullptr) {
+            policy->RecordBatchLatency(
+                padded_batch_size,
+                Env::Default()->NowMicros() - start_time_micros);
+          }
           final_status = SplitOutputTensors(combined_outputs, batch.get());
         });
     // By waiting for the notification we are ensuring that this thread isn't
@@ -563,11 +645,14 @@ class BatchResource : public ResourceBase {
     done.WaitForNotification();
   }
 
-  // Processes a batch of one or more BatchTask entries.
-  void ProcessBatch(std::unique_ptr<Batch> batch) const {
+  // Processes a batch of one or more BatchTask entries, of the queue named
+  // 'queue_name'.
+  void ProcessBatch(std::unique_ptr<Batch> batch,
+                    const string& queue_name) const {
     if (batch->empty()) {
       return;
     }
+    RecordBatchMetrics(*batch, queue_name);
 
     WithContext wc(batch->task(batch->num_tasks() - 1).propagated_context);
 
@@ -660,29 +745,57 @@ class BatchResource : public ResourceBase {
   }
 
   // Looks up the batcher queue for 'queue_name'. If it did't previously exist,
-  // creates it.
+  // creates it. Sets '*policy' to the adaptive batching policy of the queue,
+  // or to null if adaptive batching is disabled.
   Status LookupOrCreateBatcherQueue(const string& queue_name,
-                                    BatcherQueue** queue) {
+                                    BatcherQueue** queue,
+                                    serving::AdaptiveBatchSizePolicy** policy) {
     mutex_lock l(batcher_queues_mu_);
 
     auto it = batcher_queues_.find(queue_name);
     if (it != batcher_queues_.end()) {
       *queue = it->second.get();
+      auto policy_it = adaptive_policies_.find(queue_name);
+      *policy = policy_it == adaptive_policies_.end() ? nullptr
+                                                      : policy_it->second.get();
       return Status::OK();
     }
 
+    Batcher::QueueOptions queue_options = batcher_queue_options_;
+    std::unique_ptr<serving::AdaptiveBatchSizePolicy> new_policy;
+    if (enable_adaptive_batching_) {
+      serving::AdaptiveBatchSizePolicy::Options policy_options;
+      policy_options.allowed_batch_sizes = allowed_batch_sizes_;
+      policy_options.max_batch_size = queue_options.max_batch_size;
+      policy_options.max_batch_timeout_micros =
+          queue_options.batch_timeout_micros;
+      policy_options.num_batch_threads = num_batch_threads_;
+      new_policy.reset(new serving::AdaptiveBatchSizePolicy(policy_options));
+      serving::AdaptiveBatchSizePolicy* adaptive_policy = new_policy.get();
+      queue_options.batch_timeout_micros_fn =
+          [adaptive_policy](size_t open_batch_size) {
+            return adaptive_policy->BatchTimeoutMicros(open_batch_size);
+          };
+    }
+
     std::unique_ptr<BatcherQueue> new_queue;
-    auto process_batch_callback = [this](std::unique_ptr<Batch> batch) {
+    serving::AdaptiveBatchSizePolicy* adaptive_policy = new_policy.get();
+    auto process_batch_callback = [this, queue_name, adaptive_policy](
+                                      std::unique_ptr<Batch> batch) {
       if (fhandle_ == kInvalidHandle) {
-        ProcessBatch(std::move(batch));
+        ProcessBatch(std::move(batch), queue_name);
       } else {
-        ProcessFuncBatch(std::move(batch));
+        ProcessFuncBatch(std::move(batch), queue_name, adaptive_policy);
       }
     };
-    TF_RETURN_IF_ERROR(batcher_->AddQueue(batcher_queue_options_,
-                                          process_batch_callback, &new_queue));
+    TF_RETURN_IF_ERROR(
+        batcher_->AddQueue(queue_options, process_batch_callback, &new_queue));
     *queue = new_queue.get();
+    *policy = adaptive_policy;
     batcher_queues_[queue_name] = std::move(new_queue);
+    if (new_policy != nullptr) {
+      adaptive_policies_[queue_name] = std::move(new_policy);
+    }
     return Status::OK();
   }
 
@@ -694,11 +807,22 @@ class BatchResource : public ResourceBase {
   // TODO(olston): Garbage-collect unused queues (perhaps simply remove empty
   // ones (with a time delay?); it's okay if they get recreated later).
   mutable mutex batcher_queues_mu_;
+  // The adaptive batching policies of the queues, if enabled. (Declared before
+  // 'batcher_queues_', so that the queues, which use them, are destroyed
+  // first.)
+  std::map<string, std::unique_ptr<serving::AdaptiveBatchSizePolicy>>
+      adaptive_policies_ GUARDED_BY(batcher_queues_mu_);
   std::map<string, std::unique_ptr<BatcherQueue>> batcher_queues_
       GUARDED_BY(batcher_queues_mu_);
 
   std::vector<int32> allowed_batch_sizes_;
   FunctionLibraryRuntime::Handle fhandle_;
+
+  // The shared name of the resource, which labels the metrics of its queues.
+  string shared_name_;
+  int32 num_batch_threads_ = 0;
+  // If true, each queue picks its batch sizes and timeout adaptively.
+  bool enable_adaptive_batching_ = false;
 };
 
 class BatchFunctionKernel : public AsyncOpKernel {
@@ -720,6 +844,8 @@ class BatchFunctionKernel : public AsyncOpKernel {
                    c->GetAttr("max_enqueued_batches", &max_enqueued_batches_));
     OP_REQUIRES_OK(c, c->GetAttr("allowed_batch_sizes", &allowed_batch_sizes_));
     OP_REQUIRES_OK(c, ValidateAllowedBatchSizes());
+    OP_REQUIRES_OK(c, c->GetAttr("enable_adaptive_batching",
+                                 &enable_adaptive_batching_));
 
     auto lib = c->function_library();
     OP_REQUIRES(c, lib != nullptr, errors::Internal("No function library"));
@@ -738,7 +864,9 @@ class BatchFunctionKernel : public AsyncOpKernel {
       TF_RETURN_IF_ERROR(
           BatchResource::Create(num_batch_threads_, max_batch_size_,
                                 batch_timeout_micros_, max_enqueued_batches_,
-                                allowed_batch_sizes_, fhandle_, &new_resource));
+                                allowed_batch_sizes_, fhandle_,
+                                enable_adaptive_batching_, shared_name_,
+                                &new_resource));
       *r = new_resource.release();
       return Status::OK();
     };
@@ -784,6 +912,7 @@ class BatchFunctionKernel : public AsyncOpKernel {
   int32 batch_timeout_micros_;
   int32 max_enqueued_batches_;
   std::vector<int32> allowed_batch_sizes_;
+  bool enable_adaptive_batching_;
   FunctionLibraryRuntime::Handle fhandle_;
 };
 
@@ -818,7 +947,7 @@ class BatchKernel : public AsyncOpKernel {
       TF_RETURN_IF_ERROR(BatchResource::Create(
           num_batch_threads_, max_batch_size_, batch_timeout_micros_,
           max_enqueued_batches_, allowed_batch_sizes_, kInvalidHandle,
-          &new_resource));
+          /*enable_adaptive_batching=*/false, shared_name_, &new_resource));
       *r = new_resource.release();
       return Status::OK();
     };
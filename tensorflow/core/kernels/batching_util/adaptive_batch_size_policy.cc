@@ -0,0 +1,164 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/adaptive_batch_size_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// An underfull batch waits for up to this many times the time it is expected to
+// take to fill its bucket, to absorb some jitter in the arrivals.
+constexpr double kFillTimeSlack = 2.0;
+
+}  // namespace
+
+AdaptiveBatchSizePolicy::AdaptiveBatchSizePolicy(const Options& options)
+    : options_(options) {
+  DCHECK_GT(options_.max_batch_size, 0);
+  DCHECK_GT(options_.smoothing, 0);
+  DCHECK_LE(options_.smoothing, 1);
+  if (!options_.allowed_batch_sizes.empty()) {
+    buckets_ = options_.allowed_batch_sizes;
+  } else {
+    for (int32 size = 1; size < options_.max_batch_size; size *= 2) {
+      buckets_.push_back(size);
+    }
+    buckets_.push_back(options_.max_batch_size);
+  }
+  latency_micros_.resize(buckets_.size(), -1);
+}
+
+void AdaptiveBatchSizePolicy::RecordArrival(int64 now_micros, int64 size) {
+  if (size <= 0) return;
+  mutex_lock l(mu_);
+  if (last_arrival_micros_ >= 0) {
+    const double sample =
+        static_cast<double>(std::max<int64>(now_micros - last_arrival_micros_,
+                                            0)) /
+        size;
+    micros_per_element_ =
+        micros_per_element_ < 0
+            ? sample
+            : (1 - options_.smoothing) * micros_per_element_ +
+                  options_.smoothing * sample;
+  }
+  last_arrival_micros_ = std::max(last_arrival_micros_, now_micros);
+}
+
+void AdaptiveBatchSizePolicy::RecordBatchLatency(int32 batch_size,
+                                                 int64 latency_micros) {
+  if (batch_size <= 0) return;
+  const int index = BucketIndex(batch_size);
+  mutex_lock l(mu_);
+  double& latency = latency_micros_[index];
+  latency = latency < 0 ? latency_micros
+                        : (1 - options_.smoothing) * latency +
+                              options_.smoothing * latency_micros;
+}
+
+int64 AdaptiveBatchSizePolicy::BatchTimeoutMicros(
+    int64 open_batch_size) const {
+  mutex_lock l(mu_);
+  const int32 target_batch_size = TargetBatchSizeLocked();
+  if (open_batch_size >= target_batch_size) {
+    return 0;
+  }
+  if (micros_per_element_ < 0 || EstimatedLatencyMicros(0) < 0) {
+    return options_.max_batch_timeout_micros;
+  }
+
+  // Wait for the open batch to fill its bucket, so that it needs no padding.
+  // If it already fills one exactly, the target is larger: wait for the next
+  // one.
+  int index = BucketIndex(open_batch_size);
+  if (buckets_[index] == open_batch_size) {
+    ++index;
+  }
+  DCHECK_LT(index, buckets_.size());
+  const double fill_time_micros =
+      (buckets_[index] - open_batch_size) * micros_per_element_;
+  return std::min(
+      options_.max_batch_timeout_micros,
+      static_cast<int64>(std::ceil(kFillTimeSlack * fill_time_micros)));
+}
+
+int32 AdaptiveBatchSizePolicy::TargetBatchSize() const {
+  mutex_lock l(mu_);
+  return TargetBatchSizeLocked();
+}
+
+int32 AdaptiveBatchSizePolicy::PaddedBatchSize(int32 batch_size) const {
+  if (options_.allowed_batch_sizes.empty()) {
+    return batch_size;
+  }
+  return std::max(batch_size, buckets_[BucketIndex(batch_size)]);
+}
+
+int AdaptiveBatchSizePolicy::BucketIndex(int64 batch_size) const {
+  const auto it = std::lower_bound(buckets_.begin(), buckets_.end(),
+                                   static_cast<int32>(std::min<int64>(
+                                       batch_size, buckets_.back())));
+  return it - buckets_.begin();
+}
+
+double AdaptiveBatchSizePolicy::EstimatedLatencyMicros(int index) const {
+  if (latency_micros_[index] >= 0) {
+    return latency_micros_[index];
+  }
+  int lower = index - 1;
+  while (lower >= 0 && latency_micros_[lower] < 0) --lower;
+  int upper = index + 1;
+  while (upper < buckets_.size() && latency_micros_[upper] < 0) ++upper;
+  const double size = buckets_[index];
+  if (lower >= 0 && upper < buckets_.size()) {
+    const double weight =
+        (size - buckets_[lower]) / (buckets_[upper] - buckets_[lower]);
+    return (1 - weight) * latency_micros_[lower] +
+           weight * latency_micros_[upper];
+  }
+  if (lower >= 0) {
+    return latency_micros_[lower] * size / buckets_[lower];
+  }
+  if (upper < buckets_.size()) {
+    return latency_micros_[upper] * size / buckets_[upper];
+  }
+  return -1;
+}
+
+int32 AdaptiveBatchSizePolicy::TargetBatchSizeLocked() const {
+  if (micros_per_element_ < 0) {
+    return buckets_.back();
+  }
+  // A batch of size b arrives every b * micros_per_element_ microseconds, and
+  // 'num_batch_threads' of them are processed concurrently.
+  for (int i = 0; i < buckets_.size(); ++i) {
+    const double latency = EstimatedLatencyMicros(i);
+    if (latency < 0) break;
+    if (latency <= buckets_[i] * micros_per_element_ *
+                       std::max(options_.num_batch_threads, 1)) {
+      return buckets_[i];
+    }
+  }
+  return buckets_.back();
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,129 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// AdaptiveBatchSizePolicy picks the size of the batches formed by a batching
+// queue, and how long an underfull batch waits for more tasks, from the arrival
+// rate of the tasks and the processing latency of each batch size. Both are
+// learned online, as exponential moving averages.
+//
+// Batches are padded to the next allowed batch size ("bucket"). The policy
+// closes a batch as soon as it fills the smallest bucket that the batch threads
+// process at least as fast as the tasks arrive (the "target" batch size), and
+// otherwise lets it wait only as long as it is expected to take to fill its
+// bucket. Under a steady load, this forms batches that need no padding, of the
+// smallest size that keeps up with the load. Until both the arrival rate and
+// some latencies have been observed, the policy behaves like a static
+// configuration: batches are closed when they reach the maximum batch size or
+// the maximum timeout.
+//
+// The latency of a bucket that hasn't been observed yet is interpolated
+// linearly between the nearest observed buckets, or scaled proportionally to
+// the batch size from the nearest one.
+//
+// Without allowed batch sizes, latencies are tracked for power-of-two buckets
+// (and the maximum batch size), but batches aren't padded.
+//
+// This object is thread-safe. BatchTimeoutMicros() is suitable for use as the
+// 'batch_timeout_micros_fn' of a SharedBatchScheduler queue.
+
+#ifndef TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_ADAPTIVE_BATCH_SIZE_POLICY_H_
+#define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_ADAPTIVE_BATCH_SIZE_POLICY_H_
+
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+class AdaptiveBatchSizePolicy {
+ public:
+  struct Options {
+    // The sizes batches are padded to, in increasing order. If not empty, the
+    // last entry must equal 'max_batch_size'.
+    std::vector<int32> allowed_batch_sizes;
+
+    // The maximum size of each batch.
+    int32 max_batch_size = 1000;
+
+    // The longest an underfull batch may wait for more tasks.
+    int64 max_batch_timeout_micros = 0;
+
+    // The number of threads processing batches concurrently.
+    int num_batch_threads = 1;
+
+    // The weight of the newest sample in the moving averages, in (0, 1].
+    double smoothing = 0.1;
+  };
+
+  explicit AdaptiveBatchSizePolicy(const Options& options);
+
+  // Records that tasks with a total size of 'size' were enqueued at time
+  // 'now_micros'.
+  void RecordArrival(int64 now_micros, int64 size);
+
+  // Records that processing a batch of size 'batch_size' (after padding) took
+  // 'latency_micros'.
+  void RecordBatchLatency(int32 batch_size, int64 latency_micros);
+
+  // Returns how long an open batch of size 'open_batch_size' may wait, since
+  // its first task was enqueued, before it's scheduled for processing.
+  int64 BatchTimeoutMicros(int64 open_batch_size) const;
+
+  // Returns the batch size at which open batches are closed right away.
+  int32 TargetBatchSize() const;
+
+  // Returns the size a batch of size 'batch_size' is padded to.
+  int32 PaddedBatchSize(int32 batch_size) const;
+
+ private:
+  // Returns the index of the smallest bucket holding 'batch_size' elements.
+  int BucketIndex(int64 batch_size) const;
+
+  // Returns the estimated latency of the bucket at 'index', or a negative value
+  // if no latencies have been observed yet.
+  double EstimatedLatencyMicros(int index) const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  int32 TargetBatchSizeLocked() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+
+  // The bucket sizes, in increasing order. The last one is the maximum batch
+  // size.
+  std::vector<int32> buckets_;
+
+  mutable mutex mu_;
+
+  // The time of the latest arrival, or -1 before the first one.
+  int64 last_arrival_micros_ GUARDED_BY(mu_) = -1;
+
+  // The average time between the arrivals of two elements, or a negative value
+  // before it could be measured.
+  double micros_per_element_ GUARDED_BY(mu_) = -1;
+
+  // The average latency of each bucket, or a negative value for the buckets
+  // that haven't been observed yet.
+  std::vector<double> latency_micros_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AdaptiveBatchSizePolicy);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_ADAPTIVE_BATCH_SIZE_POLICY_H_
@@ -0,0 +1,146 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/adaptive_batch_size_policy.h"
+
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+AdaptiveBatchSizePolicy::Options PolicyOptions() {
+  AdaptiveBatchSizePolicy::Options options;
+  options.allowed_batch_sizes = {4, 8, 16, 32};
+  options.max_batch_size = 32;
+  options.max_batch_timeout_micros = 1000;
+  options.num_batch_threads = 1;
+  options.smoothing = 1.0;
+  return options;
+}
+
+// Records arrivals of single elements every 'micros_per_element' microseconds,
+// starting at '*now_micros', which is advanced past the last arrival.
+void RecordArrivals(int64 micros_per_element, AdaptiveBatchSizePolicy* policy,
+                    int64* now_micros) {
+  for (int i = 0; i < 10; ++i) {
+    *now_micros += micros_per_element;
+    policy->RecordArrival(*now_micros, 1);
+  }
+}
+
+TEST(AdaptiveBatchSizePolicyTest, PadsToAllowedBatchSizes) {
+  AdaptiveBatchSizePolicy policy(PolicyOptions());
+  EXPECT_EQ(4, policy.PaddedBatchSize(1));
+  EXPECT_EQ(4, policy.PaddedBatchSize(4));
+  EXPECT_EQ(16, policy.PaddedBatchSize(9));
+  EXPECT_EQ(32, policy.PaddedBatchSize(32));
+}
+
+TEST(AdaptiveBatchSizePolicyTest, DoesntPadWithoutAllowedBatchSizes) {
+  AdaptiveBatchSizePolicy::Options options = PolicyOptions();
+  options.allowed_batch_sizes.clear();
+  AdaptiveBatchSizePolicy policy(options);
+  EXPECT_EQ(9, policy.PaddedBatchSize(9));
+  EXPECT_EQ(32, policy.TargetBatchSize());
+}
+
+TEST(AdaptiveBatchSizePolicyTest, StaticBeforeObservations) {
+  AdaptiveBatchSizePolicy policy(PolicyOptions());
+  int64 now_micros = 0;
+  EXPECT_EQ(32, policy.TargetBatchSize());
+  EXPECT_EQ(1000, policy.BatchTimeoutMicros(1));
+
+  // Without latencies, the arrival rate alone doesn't change anything.
+  RecordArrivals(10, &policy, &now_micros);
+  EXPECT_EQ(32, policy.TargetBatchSize());
+  EXPECT_EQ(1000, policy.BatchTimeoutMicros(1));
+}
+
+TEST(AdaptiveBatchSizePolicyTest, PicksSmallestSustainableBatchSize) {
+  AdaptiveBatchSizePolicy policy(PolicyOptions());
+  // A fixed cost of 100us, plus 1us per element.
+  policy.RecordBatchLatency(4, 104);
+  policy.RecordBatchLatency(32, 132);
+  int64 now_micros = 0;
+
+  // With an element every 100us, batches of 4 take 400us to arrive.
+  RecordArrivals(100, &policy, &now_micros);
+  EXPECT_EQ(4, policy.TargetBatchSize());
+
+  // With an element every 10us, batches of 16 take 160us to arrive, and are
+  // processed in 116us, while batches of 8 aren't processed fast enough.
+  RecordArrivals(10, &policy, &now_micros);
+  EXPECT_EQ(16, policy.TargetBatchSize());
+
+  // Under overload, batches are as large as possible.
+  RecordArrivals(1, &policy, &now_micros);
+  EXPECT_EQ(32, policy.TargetBatchSize());
+}
+
+TEST(AdaptiveBatchSizePolicyTest, AccountsForBatchThreads) {
+  AdaptiveBatchSizePolicy::Options options = PolicyOptions();
+  options.num_batch_threads = 4;
+  AdaptiveBatchSizePolicy policy(options);
+  policy.RecordBatchLatency(4, 104);
+  policy.RecordBatchLatency(32, 132);
+  int64 now_micros = 0;
+  RecordArrivals(10, &policy, &now_micros);
+  EXPECT_EQ(4, policy.TargetBatchSize());
+}
+
+TEST(AdaptiveBatchSizePolicyTest, WaitsForBucketToFill) {
+  AdaptiveBatchSizePolicy policy(PolicyOptions());
+  policy.RecordBatchLatency(4, 104);
+  policy.RecordBatchLatency(32, 132);
+  int64 now_micros = 0;
+  RecordArrivals(10, &policy, &now_micros);
+  ASSERT_EQ(16, policy.TargetBatchSize());
+
+  // Batches of the target size are scheduled right away.
+  EXPECT_EQ(0, policy.BatchTimeoutMicros(16));
+  EXPECT_EQ(0, policy.BatchTimeoutMicros(20));
+  // Underfull batches wait for (twice) the time needed to fill their bucket.
+  EXPECT_EQ(2 * 10 * 3, policy.BatchTimeoutMicros(1));
+  EXPECT_EQ(2 * 10 * 2, policy.BatchTimeoutMicros(14));
+  // Batches filling their bucket exactly wait for the next one.
+  EXPECT_EQ(2 * 10 * 8, policy.BatchTimeoutMicros(8));
+
+  // The timeout is capped.
+  RecordArrivals(500, &policy, &now_micros);
+  EXPECT_EQ(4, policy.TargetBatchSize());
+  EXPECT_EQ(1000, policy.BatchTimeoutMicros(1));
+}
+
+TEST(AdaptiveBatchSizePolicyTest, AveragesSamples) {
+  AdaptiveBatchSizePolicy::Options options = PolicyOptions();
+  options.smoothing = 0.5;
+  AdaptiveBatchSizePolicy policy(options);
+  policy.RecordBatchLatency(4, 104);
+  policy.RecordBatchLatency(32, 100);
+  policy.RecordBatchLatency(32, 164);
+
+  policy.RecordArrival(0, 1);
+  policy.RecordArrival(10, 1);
+  EXPECT_EQ(16, policy.TargetBatchSize());
+  // The average time between two elements goes up to 20us, which is enough
+  // for batches of 8 (processed in 108us) but not of 4.
+  policy.RecordArrival(40, 1);
+  EXPECT_EQ(8, policy.TargetBatchSize());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
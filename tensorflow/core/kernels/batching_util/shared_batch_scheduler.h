@@ -17,8 +17,10 @@ limitations under the License.
 #define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_SHARED_BATCH_SCHEDULER_H_
 
 #include <stddef.h>
+#include <algorithm>
 #include <deque>
 #include <functional>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <string>
@@ -75,6 +77,17 @@ namespace serving {
 // BasicBatchScheduler instance, in the sense that it has maximum batch size and
 // timeout parameters, which govern when a batch is eligible to be processed.
 //
+// PRIORITIES AND DEADLINES: Each queue belongs to a priority lane, either
+// latency-critical (the default) or bulk. Batch threads always serve the
+// latency-critical queues before the bulk ones, and bulk queues yield batch
+// threads while latency-critical tasks are waiting (see
+// Options::max_bulk_batch_threads_under_pressure). Within a lane, the batch
+// with the earliest task deadline (see BatchTask::deadline_micros()) is
+// processed first, both across queues and among the batches of a queue;
+// batches without deadlines are served round-robin, as above. Queues with an
+// 'expired_task_callback' drop the tasks that are past their deadline, instead
+// of processing them.
+//
 // Each queue is independently configured with a maximum size (in terms of the
 // maximum number of batches worth of enqueued tasks). For online serving, it is
 // recommended that the queue sizes be configured such that the sum of the sizes
@@ -111,6 +124,18 @@ class SharedBatchScheduler
     // Must be >= 1, and should be tuned carefully.
     int num_batch_threads = port::MaxParallelism();
 
+    // The maximum number of batch threads processing batches of bulk queues
+    // while tasks of latency-critical queues are enqueued. Bulk batches that
+    // are already being processed run to completion, but no new ones are
+    // started past this limit. When no latency-critical task is enqueued, bulk
+    // queues may use all the batch threads.
+    //
+    // The default of -1 keeps one batch thread for the latency-critical queues,
+    // unless there is only one: bulk batches then still run while the
+    // latency-critical batches wait for their timeout. 0 starts no bulk batch
+    // under pressure, even if it leaves batch threads idle.
+    int max_bulk_batch_threads_under_pressure = -1;
+
     // The environment to use.
     // (Typically only overridden by test code.)
     Env* env = Env::Default();
@@ -129,6 +154,13 @@ class SharedBatchScheduler
   //
   // The returned queue's destructor blocks until all tasks submitted to it have
   // been processed.
+  enum class QueuePriority {
+    // Served before any bulk queue.
+    kLatencyCritical,
+    // Served only when no latency-critical queue has a batch to process, and
+    // yields batch threads to latency-critical queues under pressure.
+    kBulk,
+  };
   struct QueueOptions {
     // The maximum size of each batch.
     //
@@ -152,12 +184,34 @@ class SharedBatchScheduler
     // avoid latency spikes.
     int64 batch_timeout_micros = 0;
 
+    // If set, takes the place of 'batch_timeout_micros' for the open batch: it
+    // is called with the size of the open batch whenever the queue considers
+    // scheduling that batch, and returns how long (in microseconds) the batch
+    // may stay open since its first task was enqueued. Returning 0 makes the
+    // batch schedulable right away. Lets the owner of the queue pick the batch
+    // sizes and the timeout adaptively, e.g. from the observed arrival rate.
+    //
+    // Called with the queue's lock held, so it must be cheap and must not call
+    // back into the scheduler.
+    std::function<int64(size_t open_batch_size)> batch_timeout_micros_fn;
+
     // The maximum allowable number of enqueued (accepted by Schedule() but
     // not yet being processed on a batch thread) tasks in terms of batches.
     // If this limit is reached, Schedule() will return an UNAVAILABLE error.
     // See the class documentation above for guidelines on how to tune this
     // parameter.
     size_t max_enqueued_batches = 10;
+
+    // The priority lane of the queue.
+    QueuePriority priority = QueuePriority::kLatencyCritical;
+
+    // If set, tasks that are past their deadline when their batch is about to
+    // be processed are removed from the batch and handed to this callback,
+    // which is expected to fail them (e.g. with a DEADLINE_EXCEEDED error),
+    // and Schedule() rejects tasks that are already past their deadline. If
+    // not set, tasks are processed regardless of their deadlines. Called on a
+    // batch thread.
+    std::function<void(std::unique_ptr<TaskType>)> expired_task_callback;
   };
   Status AddQueue(const QueueOptions& options,
                   std::function<void(std::unique_ptr<Batch<TaskType>>)>
@@ -168,13 +222,18 @@ class SharedBatchScheduler
   explicit SharedBatchScheduler(const Options& options);
 
   // The code executed in 'batch_threads_'. Obtains a batch to process from the
-  // queue pointed to by 'next_queue_to_schedule_', and processes it. If that
-  // queue declines to provide a batch to process, moves onto the next queue. If
-  // no queues provide a batch to process, just sleeps briefly and exits.
+  // queue whose next batch goes first (see the class comment: latency-critical
+  // queues first, then earliest deadline first, then round-robin starting at
+  // 'next_queue_to_schedule_'), and processes it. If no queue provides a batch
+  // to process, or the only batches are from bulk queues that must yield, just
+  // sleeps briefly and exits.
   void ThreadLogic();
 
   const Options options_;
 
+  // Options::max_bulk_batch_threads_under_pressure, with the default resolved.
+  const int max_bulk_batch_threads_under_pressure_;
+
   mutex mu_;
 
   // A list of queues. (We use std::list instead of std::vector to ensure that
@@ -188,9 +247,12 @@ class SharedBatchScheduler
   QueueList queues_ GUARDED_BY(mu_);
 
   // An iterator over 'queues_', pointing to the queue from which the next
-  // available batch thread should grab work.
+  // available batch thread should grab work, all else being equal.
   typename QueueList::iterator next_queue_to_schedule_ GUARDED_BY(mu_);
 
+  // The number of batches of bulk queues being processed.
+  int num_bulk_batches_being_processed_ GUARDED_BY(mu_) = 0;
+
   // Used by idle batch threads to wait for work to enter the system. Notified
   // whenever a batch becomes schedulable.
   condition_variable schedulable_batch_cv_;
@@ -206,6 +268,18 @@ class SharedBatchScheduler
 
 namespace internal {
 
+// Maps a task deadline to a value that orders deadlines earliest first, with
+// the absence of a deadline (0) last.
+inline uint64 DeadlineOrder(uint64 deadline_micros) {
+  return deadline_micros == 0 ? kuint64max : deadline_micros;
+}
+
+// Returns the earlier of two task deadlines, where 0 means no deadline.
+inline uint64 EarlierDeadline(uint64 a_micros, uint64 b_micros) {
+  return DeadlineOrder(a_micros) <= DeadlineOrder(b_micros) ? a_micros
+                                                            : b_micros;
+}
+
 // A task queue for SharedBatchScheduler. Accepts tasks and accumulates them
 // into batches, and dispenses those batches to be processed via a "pull"
 // interface. The queue's behavior is governed by maximum batch size, timeout
@@ -220,10 +294,11 @@ namespace internal {
 // but the queue isn't full, then that batch is closed and a new open batch is
 // started.
 //
-// Batch pull requests are handled by dequeuing the front-most batch if it is
-// closed. If the front-most batch is open (i.e. the queue contains only one
-// batch) and has reached the timeout, it is immediately closed and returned;
-// otherwise no batch is returned for the request.
+// Batch pull requests are handled by dequeuing the batch with the earliest task
+// deadline, or the front-most one if none of them has deadlines, among the
+// closed batches and the open batch if it has reached the timeout. If the batch
+// is open, it is immediately closed and returned. If no batch is eligible, no
+// batch is returned for the request.
 template <typename TaskType>
 class Queue {
  public:
@@ -252,13 +327,24 @@ class Queue {
   // Returns the maximum allowed size of tasks submitted to the queue.
   size_t max_task_size() const { return options_.max_batch_size; }
 
+  // Returns the priority lane of the queue.
+  typename SharedBatchScheduler<TaskType>::QueuePriority priority() const {
+    return options_.priority;
+  }
+
+  // Returns true if ScheduleBatch() would return a batch at this time, and
+  // sets '*deadline_micros' to the earliest deadline of the tasks in that
+  // batch (0 if none of them has a deadline).
+  bool PeekBatch(uint64* deadline_micros) const;
+
   // Called by a thread that is ready to process a batch, to request one from
   // this queue. Either returns a batch that is ready to be processed, or
   // nullptr if the queue declines to schedule a batch at this time. If it
   // returns a batch, the batch is guaranteed to be closed.
   std::unique_ptr<Batch<TaskType>> ScheduleBatch();
 
-  // Processes a batch that has been returned earlier by ScheduleBatch().
+  // Processes a batch that has been returned earlier by ScheduleBatch(), after
+  // dropping its expired tasks if the queue has an 'expired_task_callback'.
   void ProcessBatch(std::unique_ptr<Batch<TaskType>> batch);
 
   // Determines whether the queue is empty, i.e. has no tasks waiting or being
@@ -285,6 +371,16 @@ class Queue {
   // currently schedulable.
   bool IsOpenBatchSchedulable() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Returns the index in 'batches_' of the batch to schedule next, or -1 if no
+  // batch is schedulable.
+  int NextBatchIndex() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Hands the tasks of 'batch' that are past their deadline to
+  // 'options_.expired_task_callback', and returns a closed batch with the
+  // other ones.
+  std::unique_ptr<Batch<TaskType>> DropExpiredTasks(
+      std::unique_ptr<Batch<TaskType>> batch);
+
   const typename SharedBatchScheduler<TaskType>::QueueOptions options_;
 
   // The environment to use.
@@ -308,6 +404,10 @@ class Queue {
   // The enqueued batches. See the invariants in the class comments above.
   std::deque<std::unique_ptr<Batch<TaskType>>> batches_ GUARDED_BY(mu_);
 
+  // The earliest task deadline of each batch in 'batches_', or 0 for the
+  // batches whose tasks have no deadlines.
+  std::deque<uint64> batch_deadlines_micros_ GUARDED_BY(mu_);
+
   // The time at which the first task was added to the open (back-most) batch
   // in 'batches_'. Valid iff that batch contains at least one task.
   uint64 open_batch_start_time_micros_ GUARDED_BY(mu_);
@@ -365,6 +465,11 @@ Status SharedBatchScheduler<TaskType>::Create(
     return errors::InvalidArgument("num_batch_threads must be positive; was ",
                                    options.num_batch_threads);
   }
+  if (options.max_bulk_batch_threads_under_pressure < -1) {
+    return errors::InvalidArgument(
+        "max_bulk_batch_threads_under_pressure must be at least -1; was ",
+        options.max_bulk_batch_threads_under_pressure);
+  }
   scheduler->reset(new SharedBatchScheduler<TaskType>(options));
   return Status::OK();
 }
@@ -433,7 +538,12 @@ Status SharedBatchScheduler<TaskType>::AddQueue(
 
 template <typename TaskType>
 SharedBatchScheduler<TaskType>::SharedBatchScheduler(const Options& options)
-    : options_(options), next_queue_to_schedule_(queues_.end()) {
+    : options_(options),
+      max_bulk_batch_threads_under_pressure_(
+          options.max_bulk_batch_threads_under_pressure >= 0
+              ? options.max_bulk_batch_threads_under_pressure
+              : std::max(1, options.num_batch_threads - 1)),
+      next_queue_to_schedule_(queues_.end()) {
   // Kick off the batch threads.
   PeriodicFunction::Options periodic_fn_options;
   periodic_fn_options.thread_name_prefix =
@@ -452,39 +562,78 @@ void SharedBatchScheduler<TaskType>::ThreadLogic() {
   std::unique_ptr<Batch<TaskType>> batch_to_process;
   // The queue with which 'batch_to_process' is associated.
   internal::Queue<TaskType>* queue_for_batch = nullptr;
+  bool bulk_batch = false;
   {
     mutex_lock l(mu_);
 
-    const int num_queues = queues_.size();
-    for (int num_queues_tried = 0;
-         batch_to_process == nullptr && num_queues_tried < num_queues;
-         ++num_queues_tried) {
-      DCHECK(next_queue_to_schedule_ != queues_.end());
-
-      // If a closed queue responds to ScheduleBatch() with nullptr, the queue
-      // will never yield any further batches so we can drop it. To avoid a
-      // race, we take a snapshot of the queue's closedness state *before*
-      // calling ScheduleBatch().
-      const bool queue_closed = (*next_queue_to_schedule_)->closed();
-
-      // Ask '*next_queue_to_schedule_' if it wants us to process a batch.
-      batch_to_process = (*next_queue_to_schedule_)->ScheduleBatch();
-      if (batch_to_process != nullptr) {
-        queue_for_batch = next_queue_to_schedule_->get();
+    // Drop the closed queues with no work left. They will never yield any
+    // further batches.
+    for (auto it = queues_.begin(); it != queues_.end();) {
+      if ((*it)->closed() && (*it)->IsEmpty()) {
+        const bool next = it == next_queue_to_schedule_;
+        it = queues_.erase(it);
+        if (next) {
+          next_queue_to_schedule_ = it;
+        }
+      } else {
+        ++it;
       }
+    }
+    if (next_queue_to_schedule_ == queues_.end()) {
+      next_queue_to_schedule_ = queues_.begin();
+    }
 
-      // Advance 'next_queue_to_schedule_'.
-      if (queue_closed && (*next_queue_to_schedule_)->IsEmpty() &&
-          batch_to_process == nullptr) {
-        // We've encountered a closed queue with no work to do. Drop it.
-        DCHECK_NE(queue_for_batch, next_queue_to_schedule_->get());
-        next_queue_to_schedule_ = queues_.erase(next_queue_to_schedule_);
-      } else {
-        ++next_queue_to_schedule_;
+    // Find the queue whose next batch goes first: latency-critical queues
+    // before bulk ones, then the earliest deadline, then round-robin starting
+    // at 'next_queue_to_schedule_'.
+    typename QueueList::iterator best_queue = queues_.end();
+    bool best_is_bulk = false;
+    uint64 best_deadline_order = 0;
+    bool latency_critical_tasks_enqueued = false;
+    auto it = next_queue_to_schedule_;
+    for (int i = 0; i < queues_.size(); ++i) {
+      internal::Queue<TaskType>* queue = it->get();
+      const bool is_bulk = queue->priority() == QueuePriority::kBulk;
+      if (!is_bulk && queue->NumEnqueuedTasks() > 0) {
+        latency_critical_tasks_enqueued = true;
+      }
+      uint64 deadline_micros;
+      if (queue->PeekBatch(&deadline_micros)) {
+        const uint64 deadline_order = internal::DeadlineOrder(deadline_micros);
+        if (best_queue == queues_.end() || (best_is_bulk && !is_bulk) ||
+            (best_is_bulk == is_bulk && deadline_order < best_deadline_order)) {
+          best_queue = it;
+          best_is_bulk = is_bulk;
+          best_deadline_order = deadline_order;
+        }
       }
-      if (next_queue_to_schedule_ == queues_.end() && !queues_.empty()) {
-        // We've hit the end. Wrap to the first queue.
-        next_queue_to_schedule_ = queues_.begin();
+      if (++it == queues_.end()) {
+        it = queues_.begin();
+      }
+    }
+
+    // Bulk queues yield batch threads to the latency-critical queues with
+    // enqueued tasks.
+    if (best_queue != queues_.end() && best_is_bulk &&
+        latency_critical_tasks_enqueued &&
+        num_bulk_batches_being_processed_ >=
+            max_bulk_batch_threads_under_pressure_) {
+      best_queue = queues_.end();
+    }
+
+    if (best_queue != queues_.end()) {
+      batch_to_process = (*best_queue)->ScheduleBatch();
+      if (batch_to_process != nullptr) {
+        queue_for_batch = best_queue->get();
+        bulk_batch = best_is_bulk;
+        if (bulk_batch) {
+          ++num_bulk_batches_being_processed_;
+        }
+        // Advance 'next_queue_to_schedule_' past the queue we picked.
+        next_queue_to_schedule_ = std::next(best_queue);
+        if (next_queue_to_schedule_ == queues_.end()) {
+          next_queue_to_schedule_ = queues_.begin();
+        }
       }
     }
 
@@ -498,6 +647,11 @@ void SharedBatchScheduler<TaskType>::ThreadLogic() {
   }
 
   queue_for_batch->ProcessBatch(std::move(batch_to_process));
+
+  if (bulk_batch) {
+    mutex_lock l(mu_);
+    --num_bulk_batches_being_processed_;
+  }
 }
 
 namespace internal {
@@ -513,6 +667,7 @@ Queue<TaskType>::Queue(
       schedulable_batch_callback_(schedulable_batch_callback) {
   // Create an initial, open batch.
   batches_.emplace_back(new Batch<TaskType>);
+  batch_deadlines_micros_.push_back(0);
 }
 
 template <typename TaskType>
@@ -531,6 +686,12 @@ Status Queue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
                                    " is larger than maximum batch size ",
                                    options_.max_batch_size);
   }
+  const uint64 deadline_micros = (*task)->deadline_micros();
+  if (options_.expired_task_callback && deadline_micros != 0 &&
+      deadline_micros < env_->NowMicros()) {
+    return errors::DeadlineExceeded(
+        "The task was past its deadline before it was scheduled");
+  }
 
   bool notify_of_schedulable_batch = false;
   {
@@ -550,6 +711,8 @@ Status Queue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
       open_batch_start_time_micros_ = env_->NowMicros();
     }
     batches_.back()->AddTask(std::move(*task));
+    batch_deadlines_micros_.back() =
+        EarlierDeadline(batch_deadlines_micros_.back(), deadline_micros);
 
     if (!schedulable_batch_) {
       if (batches_.size() > 1 || IsOpenBatchSchedulable()) {
@@ -587,6 +750,17 @@ size_t Queue<TaskType>::SchedulingCapacity() const {
          open_batch_capacity;
 }
 
+template <typename TaskType>
+bool Queue<TaskType>::PeekBatch(uint64* deadline_micros) const {
+  mutex_lock l(mu_);
+  const int index = NextBatchIndex();
+  if (index < 0) {
+    return false;
+  }
+  *deadline_micros = batch_deadlines_micros_[index];
+  return true;
+}
+
 template <typename TaskType>
 std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
   // The batch to schedule, which we may populate below. (If left as nullptr,
@@ -596,19 +770,20 @@ std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
   {
     mutex_lock l(mu_);
 
-    // Consider closing the open batch at this time, to schedule it.
-    if (batches_.size() == 1 && IsOpenBatchSchedulable()) {
-      StartNewBatch();
-    }
-
-    if (batches_.size() >= 2) {
-      // There is at least one closed batch that is ready to be scheduled.
+    const int index = NextBatchIndex();
+    if (index >= 0) {
+      // Close the open batch, if that's the one to schedule.
+      if (index == batches_.size() - 1) {
+        StartNewBatch();
+      }
       ++num_batches_being_processed_;
-      batch_to_schedule = std::move(batches_.front());
-      batches_.pop_front();
-    } else {
-      schedulable_batch_ = false;
+      batch_to_schedule = std::move(batches_[index]);
+      batches_.erase(batches_.begin() + index);
+      batch_deadlines_micros_.erase(batch_deadlines_micros_.begin() + index);
     }
+    // Schedule() only notifies the scheduler when this flips to true, so it
+    // must be cleared once no schedulable batch is left.
+    schedulable_batch_ = NextBatchIndex() >= 0;
   }
 
   return batch_to_schedule;
@@ -616,7 +791,12 @@ std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
 
 template <typename TaskType>
 void Queue<TaskType>::ProcessBatch(std::unique_ptr<Batch<TaskType>> batch) {
-  process_batch_callback_(std::move(batch));
+  if (options_.expired_task_callback) {
+    batch = DropExpiredTasks(std::move(batch));
+  }
+  if (!batch->empty()) {
+    process_batch_callback_(std::move(batch));
+  }
 
   {
     mutex_lock l(mu_);
@@ -659,6 +839,7 @@ template <typename TaskType>
 void Queue<TaskType>::StartNewBatch() {
   batches_.back()->Close();
   batches_.emplace_back(new Batch<TaskType>);
+  batch_deadlines_micros_.push_back(0);
 }
 
 template <typename TaskType>
@@ -667,9 +848,63 @@ bool Queue<TaskType>::IsOpenBatchSchedulable() const {
   if (open_batch->empty()) {
     return false;
   }
-  return closed_ || open_batch->size() >= options_.max_batch_size ||
-         env_->NowMicros() >=
-             open_batch_start_time_micros_ + options_.batch_timeout_micros;
+  if (closed_ || open_batch->size() >= options_.max_batch_size) {
+    return true;
+  }
+  const int64 batch_timeout_micros =
+      options_.batch_timeout_micros_fn
+          ? options_.batch_timeout_micros_fn(open_batch->size())
+          : options_.batch_timeout_micros;
+  return env_->NowMicros() >=
+         open_batch_start_time_micros_ + batch_timeout_micros;
+}
+
+template <typename TaskType>
+int Queue<TaskType>::NextBatchIndex() const {
+  const int num_candidates =
+      IsOpenBatchSchedulable() ? batches_.size() : batches_.size() - 1;
+  int index = -1;
+  for (int i = 0; i < num_candidates; ++i) {
+    if (index < 0 || DeadlineOrder(batch_deadlines_micros_[i]) <
+                         DeadlineOrder(batch_deadlines_micros_[index])) {
+      index = i;
+    }
+  }
+  return index;
+}
+
+template <typename TaskType>
+std::unique_ptr<Batch<TaskType>> Queue<TaskType>::DropExpiredTasks(
+    std::unique_ptr<Batch<TaskType>> batch) {
+  const uint64 now_micros = env_->NowMicros();
+  auto is_expired = [now_micros](const TaskType& task) {
+    const uint64 deadline_micros = task.deadline_micros();
+    return deadline_micros != 0 && deadline_micros < now_micros;
+  };
+  bool has_expired_tasks = false;
+  for (int i = 0; i < batch->num_tasks() && !has_expired_tasks; ++i) {
+    has_expired_tasks = is_expired(batch->task(i));
+  }
+  if (!has_expired_tasks) {
+    return batch;
+  }
+
+  // Tasks can only be removed from the back of a batch.
+  std::vector<std::unique_ptr<TaskType>> tasks;
+  tasks.reserve(batch->num_tasks());
+  while (!batch->empty()) {
+    tasks.push_back(batch->RemoveTask());
+  }
+  std::unique_ptr<Batch<TaskType>> unexpired_batch(new Batch<TaskType>);
+  for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+    if (is_expired(**it)) {
+      options_.expired_task_callback(std::move(*it));
+    } else {
+      unexpired_batch->AddTask(std::move(*it));
+    }
+  }
+  unexpired_batch->Close();
+  return unexpired_batch;
 }
 
 template <typename TaskType>
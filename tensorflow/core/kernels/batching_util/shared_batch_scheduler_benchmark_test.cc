@@ -0,0 +1,258 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Load-generator benchmark for SharedBatchScheduler, serving a mix of
+// latency-critical and bulk traffic for one model. Runs against a simulated
+// clock (FakeClockEnv): the load generator advances the clock in small steps,
+// injecting tasks at the configured rates, and batch processing "takes" a
+// simulated amount of time that grows with the batch size. Reports the latency
+// of the latency-critical tasks, the number of tasks that missed their
+// deadline, and the bulk throughput, with and without priority lanes and
+// deadlines.
+
+#include <iostream>
+
+#include "tensorflow/core/kernels/batching_util/fake_clock_env.h"
+#include "tensorflow/core/kernels/batching_util/shared_batch_scheduler.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::tensorflow::histogram::Histogram;
+
+// The simulated time between two steps of the load generator.
+constexpr int64 kStepMicros = 100;
+
+class LoadTask : public BatchTask {
+ public:
+  LoadTask(bool latency_critical, uint64 start_time_micros,
+           uint64 deadline_micros)
+      : latency_critical_(latency_critical),
+        start_time_micros_(start_time_micros),
+        deadline_micros_(deadline_micros) {}
+
+  LoadTask(const LoadTask&) = delete;
+  LoadTask& operator=(const LoadTask&) = delete;
+
+  size_t size() const override { return 1; }
+
+  uint64 deadline_micros() const override { return deadline_micros_; }
+
+  bool latency_critical() const { return latency_critical_; }
+
+  uint64 start_time_micros() const { return start_time_micros_; }
+
+ private:
+  const bool latency_critical_;
+  const uint64 start_time_micros_;
+  const uint64 deadline_micros_;
+};
+
+struct LoadOptions {
+  // Whether the bulk queue is in the bulk lane, and whether latency-critical
+  // tasks have deadlines, past which they are dropped.
+  bool use_priorities = false;
+  bool use_deadlines = false;
+
+  // Injection rates, in tasks per simulated millisecond. Bulk tasks arrive in
+  // bursts of 'bulk_burst_size' tasks.
+  double latency_critical_rate = 2;
+  double bulk_rate = 60;
+  int bulk_burst_size = 128;
+
+  // The deadline of the latency-critical tasks, relative to their arrival.
+  int64 deadline_micros = 10 * 1000;
+
+  // The simulated cost of a batch of n tasks is
+  // 'batch_cost_micros' + n * 'task_cost_micros'.
+  int64 batch_cost_micros = 2 * 1000;
+  int64 task_cost_micros = 20;
+
+  int num_batch_threads = 2;
+  int64 duration_micros = 2 * 1000 * 1000;
+};
+
+class LoadBenchmark {
+ public:
+  explicit LoadBenchmark(const LoadOptions& options)
+      : options_(options), env_(Env::Default()) {}
+
+  LoadBenchmark(const LoadBenchmark&) = delete;
+  LoadBenchmark& operator=(const LoadBenchmark&) = delete;
+
+  void Run();
+
+ private:
+  // Processes a batch, for a simulated time.
+  void ProcessBatch(std::unique_ptr<Batch<LoadTask>> batch);
+
+  // Waits until the simulated clock reaches 'time_micros'.
+  void WaitUntil(uint64 time_micros) const;
+
+  const LoadOptions options_;
+  test_util::FakeClockEnv env_;
+
+  mutex mu_;
+  Histogram latency_critical_latency_millis_ GUARDED_BY(mu_);
+  int64 num_latency_critical_late_ GUARDED_BY(mu_) = 0;
+  int64 num_latency_critical_dropped_ GUARDED_BY(mu_) = 0;
+  int64 num_bulk_processed_ GUARDED_BY(mu_) = 0;
+};
+
+void LoadBenchmark::Run() {
+  SharedBatchScheduler<LoadTask>::Options scheduler_options;
+  scheduler_options.num_batch_threads = options_.num_batch_threads;
+  scheduler_options.env = &env_;
+  std::shared_ptr<SharedBatchScheduler<LoadTask>> scheduler;
+  TF_CHECK_OK(
+      SharedBatchScheduler<LoadTask>::Create(scheduler_options, &scheduler));
+
+  auto process_batch = [this](std::unique_ptr<Batch<LoadTask>> batch) {
+    ProcessBatch(std::move(batch));
+  };
+  SharedBatchScheduler<LoadTask>::QueueOptions queue_options;
+  queue_options.max_batch_size = 32;
+  queue_options.batch_timeout_micros = 1000;
+  queue_options.max_enqueued_batches = 1000;
+  if (options_.use_deadlines) {
+    queue_options.expired_task_callback = [this](std::unique_ptr<LoadTask>) {
+      mutex_lock l(mu_);
+      ++num_latency_critical_dropped_;
+    };
+  }
+  std::unique_ptr<BatchScheduler<LoadTask>> latency_critical_queue;
+  TF_CHECK_OK(scheduler->AddQueue(queue_options, process_batch,
+                                  &latency_critical_queue));
+
+  queue_options.max_batch_size = 256;
+  queue_options.batch_timeout_micros = 5 * 1000;
+  queue_options.expired_task_callback = nullptr;
+  if (options_.use_priorities) {
+    queue_options.priority =
+        SharedBatchScheduler<LoadTask>::QueuePriority::kBulk;
+  }
+  std::unique_ptr<BatchScheduler<LoadTask>> bulk_queue;
+  TF_CHECK_OK(scheduler->AddQueue(queue_options, process_batch, &bulk_queue));
+
+  // Inject the load, with Poisson arrivals of latency-critical tasks and bulk
+  // bursts.
+  random::PhiloxRandom philox(1234, 5678);
+  random::SimplePhilox rand(&philox);
+  const double latency_critical_per_step =
+      options_.latency_critical_rate * kStepMicros / 1000;
+  const double bursts_per_step = options_.bulk_rate / options_.bulk_burst_size *
+                                 kStepMicros / 1000;
+  for (int64 elapsed_micros = 0; elapsed_micros < options_.duration_micros;
+       elapsed_micros += kStepMicros) {
+    const uint64 now_micros = env_.NowMicros();
+    if (rand.RandDouble() < latency_critical_per_step) {
+      std::unique_ptr<LoadTask> task(new LoadTask(
+          true, now_micros,
+          options_.use_deadlines ? now_micros + options_.deadline_micros : 0));
+      latency_critical_queue->Schedule(&task).IgnoreError();
+    }
+    if (rand.RandDouble() < bursts_per_step) {
+      for (int i = 0; i < options_.bulk_burst_size; ++i) {
+        std::unique_ptr<LoadTask> task(new LoadTask(false, now_micros, 0));
+        bulk_queue->Schedule(&task).IgnoreError();
+      }
+    }
+    env_.AdvanceByMicroseconds(kStepMicros);
+    // Let the batch threads catch up with the clock.
+    Env::Default()->SleepForMicroseconds(20);
+  }
+
+  // Drain the queues, letting the clock advance until they are empty.
+  Notification drained;
+  std::unique_ptr<Thread> clock_thread(Env::Default()->StartThread(
+      {}, "ClockAdvancer", [this, &drained] {
+        while (!drained.HasBeenNotified()) {
+          env_.AdvanceByMicroseconds(kStepMicros);
+          Env::Default()->SleepForMicroseconds(20);
+        }
+      }));
+  latency_critical_queue.reset();
+  bulk_queue.reset();
+  drained.Notify();
+  clock_thread.reset();
+
+  mutex_lock l(mu_);
+  std::cout << "\tlatency-critical p50 "
+            << latency_critical_latency_millis_.Percentile(50) << "ms, p99 "
+            << latency_critical_latency_millis_.Percentile(99) << "ms, late "
+            << num_latency_critical_late_ << ", dropped "
+            << num_latency_critical_dropped_ << "; bulk throughput "
+            << num_bulk_processed_ * 1000.0 / options_.duration_micros
+            << " tasks/ms" << std::endl;
+}
+
+void LoadBenchmark::ProcessBatch(std::unique_ptr<Batch<LoadTask>> batch) {
+  const uint64 end_micros = env_.NowMicros() + options_.batch_cost_micros +
+                            batch->num_tasks() * options_.task_cost_micros;
+  WaitUntil(end_micros);
+
+  mutex_lock l(mu_);
+  for (int i = 0; i < batch->num_tasks(); ++i) {
+    const LoadTask& task = batch->task(i);
+    if (!task.latency_critical()) {
+      ++num_bulk_processed_;
+      continue;
+    }
+    const uint64 latency_micros = end_micros - task.start_time_micros();
+    latency_critical_latency_millis_.Add(latency_micros / 1000.0);
+    if (latency_micros > options_.deadline_micros) {
+      ++num_latency_critical_late_;
+    }
+  }
+}
+
+void LoadBenchmark::WaitUntil(uint64 time_micros) const {
+  while (env_.NowMicros() < time_micros) {
+    Env::Default()->SleepForMicroseconds(10);
+  }
+}
+
+void RunLoadBenchmarks() {
+  for (const bool use_priorities : {false, true}) {
+    for (const bool use_deadlines : {false, true}) {
+      std::cout << "Load benchmark w/ priority lanes "
+                << (use_priorities ? "on" : "off") << ", deadlines "
+                << (use_deadlines ? "on" : "off") << std::endl;
+      LoadOptions options;
+      options.use_priorities = use_priorities;
+      options.use_deadlines = use_deadlines;
+      LoadBenchmark benchmark(options);
+      benchmark.Run();
+    }
+  }
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::serving::RunLoadBenchmarks();
+
+  return 0;
+}
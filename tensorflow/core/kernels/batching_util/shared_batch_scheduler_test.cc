@@ -28,22 +28,27 @@ namespace {
 
 class FakeTask : public BatchTask {
  public:
-  explicit FakeTask(size_t size) : size_(size) {}
+  explicit FakeTask(size_t size, uint64 deadline_micros = 0)
+      : size_(size), deadline_micros_(deadline_micros) {}
 
   ~FakeTask() override = default;
 
   size_t size() const override { return size_; }
 
+  uint64 deadline_micros() const override { return deadline_micros_; }
+
  private:
   const size_t size_;
+  const uint64 deadline_micros_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(FakeTask);
 };
 
-// Creates a FakeTask of size 'task_size', and calls 'scheduler->Schedule()' on
-// that task. Returns the resulting status.
-Status ScheduleTask(size_t task_size, BatchScheduler<FakeTask>* scheduler) {
-  std::unique_ptr<FakeTask> task(new FakeTask(task_size));
+// Creates a FakeTask of size 'task_size' and with deadline 'deadline_micros',
+// and calls 'scheduler->Schedule()' on that task. Returns the resulting status.
+Status ScheduleTask(size_t task_size, BatchScheduler<FakeTask>* scheduler,
+                   uint64 deadline_micros = 0) {
+  std::unique_ptr<FakeTask> task(new FakeTask(task_size, deadline_micros));
   Status status = scheduler->Schedule(&task);
   // Schedule() should have consumed 'task' iff it returned Status::OK.
   CHECK_EQ(status.ok(), task == nullptr);
@@ -254,6 +259,59 @@ TEST(SharedBatchSchedulerTest, ObeysTimeout) {
   stop_teardown.Notify();
 }
 
+TEST(SharedBatchSchedulerTest, ObeysTimeoutFunction) {
+  test_util::FakeClockEnv env(Env::Default());
+  Notification start_teardown, stop_teardown;
+  std::unique_ptr<Thread> teardown_thread =
+      CreateFakeClockAdvancerThread(&env, &start_teardown, &stop_teardown);
+
+  {
+    Notification first_batch_processed, second_batch_processed;
+    auto callback = [&first_batch_processed, &second_batch_processed](
+                        std::unique_ptr<Batch<FakeTask>> batch) {
+      ASSERT_TRUE(batch->IsClosed());
+      if (batch->size() == 1) {
+        first_batch_processed.Notify();
+      } else if (batch->size() == 2) {
+        second_batch_processed.Notify();
+      } else {
+        EXPECT_TRUE(false) << "Unexpected batch size";
+      }
+    };
+
+    SharedBatchScheduler<FakeTask>::Options options;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+    SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 4;
+    queue_options.batch_timeout_micros = 1000 * 1000;
+    queue_options.max_enqueued_batches = 2;
+    // Batches of a single task wait for 10 microseconds, larger ones are
+    // scheduled right away.
+    queue_options.batch_timeout_micros_fn = [](size_t open_batch_size) {
+      return open_batch_size < 2 ? 10 : 0;
+    };
+    std::unique_ptr<BatchScheduler<FakeTask>> queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+
+    TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    env.AdvanceByMicroseconds(9);
+    Env::Default()->SleepForMicroseconds(10 * 1000 /* 10 milliseconds */);
+    EXPECT_FALSE(first_batch_processed.HasBeenNotified());
+    env.AdvanceByMicroseconds(1);
+    first_batch_processed.WaitForNotification();
+
+    // The underfull batch of size 2 doesn't wait for the timeout.
+    TF_ASSERT_OK(ScheduleTask(2, queue.get()));
+    second_batch_processed.WaitForNotification();
+
+    start_teardown.Notify();
+  }
+  stop_teardown.Notify();
+}
+
 TEST(SharedBatchSchedulerTest, ObeysTimeoutWithRealClock) {
   Notification first_batch_processed, second_batch_processed;
   auto callback = [&first_batch_processed, &second_batch_processed](
@@ -407,6 +465,279 @@ TEST(SharedBatchSchedulerTest, Fairness) {
   stop_teardown.Notify();
 }
 
+TEST(SharedBatchSchedulerTest, LatencyCriticalQueuesGoFirst) {
+  mutex mu;
+  std::vector<string> processed_batches;
+  Notification blocker_scheduled, blocker_proceed;
+  auto make_callback = [&](const string& queue_name) {
+    return [&, queue_name](std::unique_ptr<Batch<FakeTask>> batch) {
+      if (!blocker_scheduled.HasBeenNotified()) {
+        blocker_scheduled.Notify();
+        blocker_proceed.WaitForNotification();
+      }
+      mutex_lock l(mu);
+      processed_batches.push_back(queue_name);
+    };
+  };
+
+  SharedBatchScheduler<FakeTask>::Options options;
+  options.num_batch_threads = 1;
+  std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+  TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+  SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+  queue_options.max_batch_size = 10;
+  queue_options.batch_timeout_micros = 0;
+  std::unique_ptr<BatchScheduler<FakeTask>> critical_queue;
+  TF_ASSERT_OK(scheduler->AddQueue(queue_options, make_callback("critical"),
+                                   &critical_queue));
+  queue_options.priority =
+      SharedBatchScheduler<FakeTask>::QueuePriority::kBulk;
+  std::unique_ptr<BatchScheduler<FakeTask>> bulk_queue;
+  TF_ASSERT_OK(
+      scheduler->AddQueue(queue_options, make_callback("bulk"), &bulk_queue));
+
+  // Keep the batch thread busy, while a bulk batch and then a latency-critical
+  // one become schedulable.
+  TF_ASSERT_OK(ScheduleTask(1, critical_queue.get()));
+  blocker_scheduled.WaitForNotification();
+  TF_ASSERT_OK(ScheduleTask(1, bulk_queue.get()));
+  TF_ASSERT_OK(ScheduleTask(1, critical_queue.get()));
+  blocker_proceed.Notify();
+
+  critical_queue.reset();
+  bulk_queue.reset();
+  EXPECT_EQ(std::vector<string>({"critical", "critical", "bulk"}),
+            processed_batches);
+}
+
+TEST(SharedBatchSchedulerTest, BulkQueuesYieldUnderPressure) {
+  for (const int max_bulk_batch_threads : {0, 1}) {
+    test_util::FakeClockEnv env(Env::Default());
+    Notification start_teardown, stop_teardown;
+    std::unique_ptr<Thread> teardown_thread =
+        CreateFakeClockAdvancerThread(&env, &start_teardown, &stop_teardown);
+
+    {
+      Notification critical_batch_processed, bulk_batch_processed;
+      auto critical_callback = [&critical_batch_processed](
+                                   std::unique_ptr<Batch<FakeTask>> batch) {
+        critical_batch_processed.Notify();
+      };
+      auto bulk_callback =
+          [&bulk_batch_processed](std::unique_ptr<Batch<FakeTask>> batch) {
+            bulk_batch_processed.Notify();
+          };
+
+      SharedBatchScheduler<FakeTask>::Options options;
+      options.num_batch_threads = 2;
+      options.max_bulk_batch_threads_under_pressure = max_bulk_batch_threads;
+      options.env = &env;
+      std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+      TF_ASSERT_OK(
+          SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+      SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+      queue_options.max_batch_size = 10;
+      queue_options.batch_timeout_micros = 100;
+      std::unique_ptr<BatchScheduler<FakeTask>> critical_queue;
+      TF_ASSERT_OK(scheduler->AddQueue(queue_options, critical_callback,
+                                       &critical_queue));
+      queue_options.batch_timeout_micros = 0;
+      queue_options.priority =
+          SharedBatchScheduler<FakeTask>::QueuePriority::kBulk;
+      std::unique_ptr<BatchScheduler<FakeTask>> bulk_queue;
+      TF_ASSERT_OK(
+          scheduler->AddQueue(queue_options, bulk_callback, &bulk_queue));
+
+      // The latency-critical task waits for its timeout, while the bulk one is
+      // schedulable right away.
+      TF_ASSERT_OK(ScheduleTask(1, critical_queue.get()));
+      TF_ASSERT_OK(ScheduleTask(1, bulk_queue.get()));
+      Env::Default()->SleepForMicroseconds(10 * 1000 /* 10 milliseconds */);
+      EXPECT_FALSE(critical_batch_processed.HasBeenNotified());
+      EXPECT_EQ(max_bulk_batch_threads > 0,
+                bulk_batch_processed.HasBeenNotified());
+
+      env.AdvanceByMicroseconds(100);
+      critical_batch_processed.WaitForNotification();
+      bulk_batch_processed.WaitForNotification();
+
+      start_teardown.Notify();
+    }
+    stop_teardown.Notify();
+  }
+}
+
+TEST(SharedBatchSchedulerTest, FullBulkBatchRunsNextToOpenCriticalBatch) {
+  test_util::FakeClockEnv env(Env::Default());
+  Notification start_teardown, stop_teardown;
+  std::unique_ptr<Thread> teardown_thread =
+      CreateFakeClockAdvancerThread(&env, &start_teardown, &stop_teardown);
+
+  {
+    Notification critical_batch_processed, bulk_batch_processed;
+    auto critical_callback = [&critical_batch_processed](
+                                 std::unique_ptr<Batch<FakeTask>> batch) {
+      critical_batch_processed.Notify();
+    };
+    auto bulk_callback =
+        [&bulk_batch_processed](std::unique_ptr<Batch<FakeTask>> batch) {
+          bulk_batch_processed.Notify();
+        };
+
+    // With the default options, bulk queues keep all but one batch thread
+    // under pressure.
+    SharedBatchScheduler<FakeTask>::Options options;
+    options.num_batch_threads = 2;
+    options.env = &env;
+    std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+    SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 10;
+    queue_options.batch_timeout_micros = 1000 * 1000;
+    std::unique_ptr<BatchScheduler<FakeTask>> critical_queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, critical_callback,
+                                     &critical_queue));
+    queue_options.priority =
+        SharedBatchScheduler<FakeTask>::QueuePriority::kBulk;
+    std::unique_ptr<BatchScheduler<FakeTask>> bulk_queue;
+    TF_ASSERT_OK(
+        scheduler->AddQueue(queue_options, bulk_callback, &bulk_queue));
+
+    // The latency-critical batch stays open until its timeout, which the fake
+    // clock does not reach, while the bulk batch is full.
+    TF_ASSERT_OK(ScheduleTask(1, critical_queue.get()));
+    TF_ASSERT_OK(ScheduleTask(10, bulk_queue.get()));
+    bulk_batch_processed.WaitForNotification();
+    EXPECT_FALSE(critical_batch_processed.HasBeenNotified());
+
+    start_teardown.Notify();
+  }
+  stop_teardown.Notify();
+}
+
+TEST(SharedBatchSchedulerTest, EarliestDeadlineFirst) {
+  mutex mu;
+  std::vector<uint64> processed_deadlines;
+  Notification blocker_scheduled, blocker_proceed;
+  auto callback = [&](std::unique_ptr<Batch<FakeTask>> batch) {
+    if (!blocker_scheduled.HasBeenNotified()) {
+      blocker_scheduled.Notify();
+      blocker_proceed.WaitForNotification();
+      return;
+    }
+    mutex_lock l(mu);
+    for (int i = 0; i < batch->num_tasks(); ++i) {
+      processed_deadlines.push_back(batch->task(i).deadline_micros());
+    }
+  };
+
+  SharedBatchScheduler<FakeTask>::Options options;
+  options.num_batch_threads = 1;
+  std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+  TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+  SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+  // One task per batch.
+  queue_options.max_batch_size = 1;
+  queue_options.batch_timeout_micros = 0;
+  std::unique_ptr<BatchScheduler<FakeTask>> queue_0, queue_1;
+  TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue_0));
+  TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue_1));
+
+  TF_ASSERT_OK(ScheduleTask(1, queue_0.get()));
+  blocker_scheduled.WaitForNotification();
+  // Tasks without deadlines go last.
+  TF_ASSERT_OK(ScheduleTask(1, queue_0.get()));
+  TF_ASSERT_OK(ScheduleTask(1, queue_0.get(), 500));
+  TF_ASSERT_OK(ScheduleTask(1, queue_0.get(), 100));
+  TF_ASSERT_OK(ScheduleTask(1, queue_1.get(), 300));
+  TF_ASSERT_OK(ScheduleTask(1, queue_1.get(), 200));
+  blocker_proceed.Notify();
+
+  queue_0.reset();
+  queue_1.reset();
+  EXPECT_EQ(std::vector<uint64>({100, 200, 300, 500, 0}), processed_deadlines);
+}
+
+TEST(SharedBatchSchedulerTest, DropsExpiredTasks) {
+  test_util::FakeClockEnv env(Env::Default());
+  Notification start_teardown, stop_teardown;
+  std::unique_ptr<Thread> teardown_thread =
+      CreateFakeClockAdvancerThread(&env, &start_teardown, &stop_teardown);
+
+  {
+    mutex mu;
+    std::vector<uint64> processed_deadlines, expired_deadlines;
+    Notification batch_processed;
+    auto callback = [&](std::unique_ptr<Batch<FakeTask>> batch) {
+      {
+        mutex_lock l(mu);
+        for (int i = 0; i < batch->num_tasks(); ++i) {
+          processed_deadlines.push_back(batch->task(i).deadline_micros());
+        }
+      }
+      batch_processed.Notify();
+    };
+
+    SharedBatchScheduler<FakeTask>::Options options;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+    SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 10;
+    queue_options.batch_timeout_micros = 100;
+    queue_options.expired_task_callback =
+        [&](std::unique_ptr<FakeTask> task) {
+          mutex_lock l(mu);
+          expired_deadlines.push_back(task->deadline_micros());
+        };
+    std::unique_ptr<BatchScheduler<FakeTask>> queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+
+    const uint64 start_micros = env.NowMicros();
+    TF_ASSERT_OK(ScheduleTask(1, queue.get(), start_micros + 50));
+    TF_ASSERT_OK(ScheduleTask(2, queue.get()));
+    TF_ASSERT_OK(ScheduleTask(3, queue.get(), start_micros + 1000));
+    env.AdvanceByMicroseconds(100);
+    batch_processed.WaitForNotification();
+    {
+      mutex_lock l(mu);
+      EXPECT_EQ(std::vector<uint64>({0, start_micros + 1000}),
+                processed_deadlines);
+      EXPECT_EQ(std::vector<uint64>({start_micros + 50}), expired_deadlines);
+    }
+
+    // Tasks past their deadline are rejected right away.
+    EXPECT_EQ(error::DEADLINE_EXCEEDED,
+              ScheduleTask(1, queue.get(), start_micros + 50).code());
+
+    start_teardown.Notify();
+  }
+  stop_teardown.Notify();
+}
+
+TEST(SharedBatchSchedulerTest, NotifiesOfEachSchedulableBatch) {
+  int num_notifications = 0;
+  SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+  queue_options.max_batch_size = 1;
+  internal::Queue<FakeTask> queue(
+      queue_options, Env::Default(),
+      [](std::unique_ptr<Batch<FakeTask>> batch) {},
+      [&num_notifications] { ++num_notifications; });
+
+  // Each full batch wakes up a batch thread, rather than leaving the second
+  // one to be found when an idle batch thread polls the queues.
+  for (int i = 1; i <= 2; ++i) {
+    std::unique_ptr<FakeTask> task(new FakeTask(1));
+    TF_ASSERT_OK(queue.Schedule(&task));
+    EXPECT_EQ(i, num_notifications);
+    std::unique_ptr<Batch<FakeTask>> batch = queue.ScheduleBatch();
+    ASSERT_NE(nullptr, batch);
+    queue.ProcessBatch(std::move(batch));
+  }
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
 TEST(SharedBatchSchedulerTest, ConstMethods) {
   for (const int max_enqueued_batches : {1, 2, 5}) {
     Notification processing, proceed;
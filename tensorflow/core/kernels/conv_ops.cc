@@ -27,8 +27,10 @@ limitations under the License.
 #include <string.h>
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <mutex>  // NOLINT(build/c++11): only using std::call_once, not mutex.
+#include <type_traits>
 #include <vector>
 
 #include "tensorflow/core/framework/allocator.h"
@@ -41,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/conv_2d.h"
+#include "tensorflow/core/kernels/cpu_autotune.h"
 #include "tensorflow/core/kernels/deep_conv2d.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -186,12 +189,14 @@ class LaunchDeepConvOp {
                   int /*out_cols*/, int /*out_depth*/, int /*dilation_rows*/,
                   int /*dilation_cols*/, int /*stride_rows*/,
                   int /*stride_cols*/, Tensor* /*output*/,
-                  TensorFormat /*data_format*/) {
+                  TensorFormat /*data_format*/, bool /*autotuning*/ = false) {
     return false;
   }
 };
 
 // Conditionally launches DeepConv operation based on convolution parameters.
+// When autotuning, it runs whenever it supports the convolution, regardless of
+// its estimated cost and of TF_USE_DEEP_CONV2D.
 template <>
 class LaunchDeepConvOp<CPUDevice, float> {
  public:
@@ -201,11 +206,17 @@ class LaunchDeepConvOp<CPUDevice, float> {
                   int filter_cols, int pad_rows, int pad_cols, int out_rows,
                   int out_cols, int out_depth, int dilation_rows,
                   int dilation_cols, int stride_rows, int stride_cols,
-                  Tensor* output, TensorFormat data_format) {
+                  Tensor* output, TensorFormat data_format,
+                  bool autotuning = false) {
     if (data_format != FORMAT_NHWC || dilation_rows != 1 ||
-        dilation_cols != 1 ||
-        !CanUseDeepConv2D(stride_rows, stride_cols, filter_rows, filter_cols,
-                          in_depth, out_depth, out_rows, out_cols)) {
+        dilation_cols != 1) {
+      return false;
+    }
+    if (autotuning ? !DeepConv2DSupports(stride_rows, stride_cols, filter_rows,
+                                         filter_cols)
+                   : !CanUseDeepConv2D(stride_rows, stride_cols, filter_rows,
+                                       filter_cols, in_depth, out_depth,
+                                       out_rows, out_cols)) {
       return false;
     }
 
@@ -475,6 +486,8 @@ class Conv2DOp : public BinaryOp<T> {
     OP_REQUIRES_OK(context, context->GetAttr("use_cudnn_on_gpu", &use_cudnn_));
     use_cudnn_ &= CanUseCudnn();
     cudnn_use_autotune_ = CudnnUseAutotune();
+    cpu_autotune_ = std::is_same<Device, CPUDevice>::value &&
+                    std::is_same<T, float>::value && CpuAutotuneEnabled();
   }
 
   void Compute(OpKernelContext* context) override {
@@ -516,6 +529,11 @@ class Conv2DOp : public BinaryOp<T> {
       return;
     }
 
+    if (cpu_autotune_ && params_.padding != EXPLICIT) {
+      ComputeAutotuned(context, input, filter, dimensions, output);
+      return;
+    }
+
 #ifdef TENSORFLOW_USE_LIBXSMM_CONVOLUTIONS
     if (params_.padding != EXPLICIT &&
         LaunchXsmmConvOp<Device, T>::Run(
@@ -549,9 +567,68 @@ class Conv2DOp : public BinaryOp<T> {
   }
 
  private:
+  // Runs the implementation that was the fastest for this convolution when it
+  // was first computed.
+  void ComputeAutotuned(OpKernelContext* context, const Tensor& input,
+                        const Tensor& filter,
+                        const Conv2DDimensions& dimensions, Tensor* output) {
+    // The indices of the candidates are the algorithm ids saved in the
+    // autotuning cache, so new candidates must be added at the end.
+    const std::function<bool()> candidates[] = {
+        // Eigen spatial convolution.
+        [&]() {
+          launcher_(context, use_cudnn_, cudnn_use_autotune_, input, filter,
+                    dimensions.dilation_rows, dimensions.dilation_cols,
+                    dimensions.stride_rows, dimensions.stride_cols,
+                    params_.padding, params_.explicit_paddings, output,
+                    params_.data_format);
+          return context->status().ok();
+        },
+        // Winograd (DeepConv2D).
+        [&]() {
+          return LaunchDeepConvOp<Device, T>::Run(
+              context, input, filter, dimensions.batch, dimensions.input_rows,
+              dimensions.input_cols, dimensions.in_depth,
+              dimensions.filter_rows, dimensions.filter_cols,
+              dimensions.pad_rows_before, dimensions.pad_cols_before,
+              dimensions.out_rows, dimensions.out_cols, dimensions.out_depth,
+              dimensions.dilation_rows, dimensions.dilation_cols,
+              dimensions.stride_rows, dimensions.stride_cols, output,
+              params_.data_format, /*autotuning=*/true);
+        },
+        // libxsmm.
+        [&]() {
+#ifdef TENSORFLOW_USE_LIBXSMM_CONVOLUTIONS
+          return LaunchXsmmConvOp<Device, T>::Run(
+              context, input, filter, dimensions.batch, dimensions.input_rows,
+              dimensions.input_cols, dimensions.in_depth,
+              dimensions.filter_rows, dimensions.filter_cols,
+              dimensions.pad_rows_before, dimensions.pad_cols_before,
+              dimensions.out_rows, dimensions.out_cols, dimensions.out_depth,
+              dimensions.dilation_rows, dimensions.dilation_cols,
+              dimensions.stride_rows, dimensions.stride_cols, output,
+              params_.data_format);
+#else
+          return false;
+#endif
+        }};
+    const CpuAutotuneKey key(
+        "Conv2D",
+        {dimensions.batch, dimensions.input_rows, dimensions.input_cols,
+         dimensions.in_depth, dimensions.filter_rows, dimensions.filter_cols,
+         dimensions.out_depth, dimensions.stride_rows, dimensions.stride_cols,
+         dimensions.dilation_rows, dimensions.dilation_cols,
+         dimensions.pad_rows_before, dimensions.pad_cols_before},
+        DataTypeToEnum<T>::value,
+        context->device()->tensorflow_cpu_worker_threads()->num_threads);
+    CpuAutotuneAndRun(key, candidates);
+  }
+
   Conv2DParameters params_;
   bool use_cudnn_;
   bool cudnn_use_autotune_;
+  // True if the CPU implementation is picked by autotuning.
+  bool cpu_autotune_;
 
   LaunchConv2DOp<Device, T> launcher_;
 
@@ -0,0 +1,245 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/cpu_autotune.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+// The number of timed runs of each candidate, after a warmup run. The fastest
+// run is kept, as the least disturbed by other work on the machine.
+constexpr int kNumTimedRuns = 3;
+
+string CacheFilename() {
+  string filename;
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_CPU_AUTOTUNE_CACHE", "", &filename));
+  return filename;
+}
+
+// Serializes the writes of the global map to its cache file.
+mutex* GlobalSaveMutex() {
+  static mutex* mu = new mutex;
+  return mu;
+}
+
+void MaybeSaveGlobal() {
+  const string filename = CacheFilename();
+  if (filename.empty()) return;
+  mutex_lock l(*GlobalSaveMutex());
+  Status s = CpuAutotuneMap::Global()->Save(filename);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to save the CPU autotuning results to "
+                 << filename << ": " << s;
+  }
+}
+
+}  // namespace
+
+bool CpuAutotuneEnabled() {
+  bool value;
+  Status status = ReadBoolFromEnvVar("TF_CPU_AUTOTUNE", false, &value);
+  if (!status.ok()) {
+    LOG(ERROR) << status.error_message();
+  }
+  return value;
+}
+
+CpuAutotuneKey::CpuAutotuneKey(string op, std::vector<int64> params,
+                               DataType dtype, int num_threads)
+    : op_(std::move(op)),
+      params_(std::move(params)),
+      dtype_(dtype),
+      num_threads_(num_threads) {
+  hash_ = Hash64(op_);
+  for (int64 param : params_) {
+    hash_ = Hash64Combine(hash_, param);
+  }
+  hash_ = Hash64Combine(hash_, dtype_);
+  hash_ = Hash64Combine(hash_, num_threads_);
+}
+
+string CpuAutotuneKey::ToString() const {
+  return strings::StrCat(op_, "[", str_util::Join(params_, ","), "] ",
+                         DataTypeString(dtype_), " on ", num_threads_,
+                         " threads");
+}
+
+CpuAutotuneMap* CpuAutotuneMap::Global() {
+  static CpuAutotuneMap* map = [] {
+    CpuAutotuneMap* map = new CpuAutotuneMap;
+    const string filename = CacheFilename();
+    if (!filename.empty() && Env::Default()->FileExists(filename).ok()) {
+      Status s = map->Load(filename);
+      if (s.ok()) {
+        VLOG(1) << "Loaded " << map->size()
+                << " CPU autotuning results from " << filename;
+      } else {
+        LOG(WARNING) << "Failed to load the CPU autotuning results from "
+                     << filename << ": " << s;
+      }
+    }
+    return map;
+  }();
+  return map;
+}
+
+bool CpuAutotuneMap::Find(const CpuAutotuneKey& key, int* algorithm) const {
+  mutex_lock l(mu_);
+  auto it = results_.find(key);
+  if (it == results_.end()) {
+    return false;
+  }
+  *algorithm = it->second.algorithm;
+  return true;
+}
+
+void CpuAutotuneMap::Insert(const CpuAutotuneKey& key, int algorithm,
+                            int64 run_time_nanos) {
+  mutex_lock l(mu_);
+  results_[key] = Result{algorithm, run_time_nanos};
+}
+
+int64 CpuAutotuneMap::size() const {
+  mutex_lock l(mu_);
+  return results_.size();
+}
+
+void CpuAutotuneMap::Clear() {
+  mutex_lock l(mu_);
+  results_.clear();
+}
+
+void CpuAutotuneMap::ToProto(CpuAutotuneResults* results) const {
+  results->Clear();
+  results->set_cpu_vendor(port::CPUVendorIDString());
+  results->set_cpu_family(port::CPUFamily());
+  results->set_cpu_model(port::CPUModelNum());
+  mutex_lock l(mu_);
+  for (const auto& key_result : results_) {
+    const CpuAutotuneKey& key = key_result.first;
+    CpuAutotuneResults::Entry* entry = results->add_entries();
+    entry->set_op(key.op());
+    for (int64 param : key.params()) {
+      entry->add_params(param);
+    }
+    entry->set_dtype(key.dtype());
+    entry->set_num_threads(key.num_threads());
+    entry->set_algorithm(key_result.second.algorithm);
+    entry->set_run_time_nanos(key_result.second.run_time_nanos);
+  }
+}
+
+Status CpuAutotuneMap::FromProto(const CpuAutotuneResults& results) {
+  if (results.cpu_vendor() != port::CPUVendorIDString() ||
+      results.cpu_family() != port::CPUFamily() ||
+      results.cpu_model() != port::CPUModelNum()) {
+    return errors::FailedPrecondition(
+        "CPU autotuning results measured on a different CPU (",
+        results.cpu_vendor(), " family ", results.cpu_family(), " model ",
+        results.cpu_model(), ")");
+  }
+  mutex_lock l(mu_);
+  for (const CpuAutotuneResults::Entry& entry : results.entries()) {
+    CpuAutotuneKey key(
+        entry.op(),
+        std::vector<int64>(entry.params().begin(), entry.params().end()),
+        entry.dtype(), entry.num_threads());
+    results_[key] = Result{entry.algorithm(), entry.run_time_nanos()};
+  }
+  return Status::OK();
+}
+
+Status CpuAutotuneMap::Save(const string& filename) const {
+  CpuAutotuneResults results;
+  ToProto(&results);
+  // Write to a temporary file first, so that readers never see a partially
+  // written cache.
+  Env* env = Env::Default();
+  const string tmp_filename =
+      strings::StrCat(filename, ".tmp", random::New64());
+  TF_RETURN_IF_ERROR(WriteBinaryProto(env, tmp_filename, results));
+  return env->RenameFile(tmp_filename, filename);
+}
+
+Status CpuAutotuneMap::Load(const string& filename) {
+  CpuAutotuneResults results;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(Env::Default(), filename, &results));
+  return FromProto(results);
+}
+
+int CpuAutotuneAndRun(const CpuAutotuneKey& key,
+                      gtl::ArraySlice<std::function<bool()>> candidates,
+                      CpuAutotuneMap* map) {
+  int algorithm;
+  if (map->Find(key, &algorithm) && algorithm >= 0 &&
+      algorithm < candidates.size() && candidates[algorithm]()) {
+    return algorithm;
+  }
+
+  // The warmup runs also tell which candidates support the problem.
+  std::vector<int> supported;
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (candidates[i]()) {
+      supported.push_back(i);
+    }
+  }
+  if (supported.empty()) {
+    return -1;
+  }
+
+  int best_algorithm = supported[0];
+  int64 best_run_time_nanos = 0;
+  if (supported.size() > 1) {
+    Env* env = Env::Default();
+    best_run_time_nanos = std::numeric_limits<int64>::max();
+    for (int i : supported) {
+      int64 run_time_nanos = std::numeric_limits<int64>::max();
+      for (int run = 0; run < kNumTimedRuns; ++run) {
+        const uint64 start_nanos = env->NowNanos();
+        candidates[i]();
+        run_time_nanos = std::min<int64>(run_time_nanos,
+                                         env->NowNanos() - start_nanos);
+      }
+      VLOG(2) << "Algorithm " << i << " for " << key.ToString() << " runs in "
+              << run_time_nanos << "ns";
+      if (run_time_nanos < best_run_time_nanos) {
+        best_algorithm = i;
+        best_run_time_nanos = run_time_nanos;
+      }
+    }
+  }
+  VLOG(1) << "Autotuned " << key.ToString() << ": algorithm " << best_algorithm;
+  map->Insert(key, best_algorithm, best_run_time_nanos);
+  if (map == CpuAutotuneMap::Global()) {
+    MaybeSaveGlobal();
+  }
+  return best_algorithm;
+}
+
+}  // namespace tensorflow
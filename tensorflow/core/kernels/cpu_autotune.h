@@ -0,0 +1,144 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Autotuning support for CPU kernels that can choose among several
+// implementations of the same computation, the CPU counterpart of the GPU
+// AutoTuneMap in gpu_utils.h.
+//
+// On the first use of a problem (op, op-specific parameters, dtype and number
+// of threads), CpuAutotuneAndRun() runs every candidate algorithm and times it,
+// then caches the fastest one. Later uses run the cached algorithm directly.
+//
+// The cache can be saved to and loaded from a file. If TF_CPU_AUTOTUNE_CACHE
+// names a file, the global cache is loaded from it when first used, and written
+// back to it whenever a new result is added, so that processes started later
+// on the same kind of CPU start already tuned.
+
+#ifndef TENSORFLOW_CORE_KERNELS_CPU_AUTOTUNE_H_
+#define TENSORFLOW_CORE_KERNELS_CPU_AUTOTUNE_H_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/cpu_autotuning.pb.h"
+
+namespace tensorflow {
+
+// Returns true if CPU kernels should autotune their algorithms, as set by the
+// TF_CPU_AUTOTUNE environment variable (false by default).
+bool CpuAutotuneEnabled();
+
+// Identifies a problem that a CPU kernel tunes its algorithm for.
+class CpuAutotuneKey {
+ public:
+  CpuAutotuneKey(string op, std::vector<int64> params, DataType dtype,
+                 int num_threads);
+
+  const string& op() const { return op_; }
+  const std::vector<int64>& params() const { return params_; }
+  DataType dtype() const { return dtype_; }
+  int num_threads() const { return num_threads_; }
+  uint64 hash() const { return hash_; }
+
+  bool operator==(const CpuAutotuneKey& other) const {
+    return hash_ == other.hash_ && op_ == other.op_ &&
+           params_ == other.params_ && dtype_ == other.dtype_ &&
+           num_threads_ == other.num_threads_;
+  }
+  bool operator!=(const CpuAutotuneKey& other) const {
+    return !(*this == other);
+  }
+
+  string ToString() const;
+
+  struct Hasher {
+    size_t operator()(const CpuAutotuneKey& key) const { return key.hash(); }
+  };
+
+ private:
+  string op_;
+  std::vector<int64> params_;
+  DataType dtype_;
+  int num_threads_;
+  uint64 hash_;
+};
+
+// A thread-safe map from problems to the id of their fastest algorithm.
+class CpuAutotuneMap {
+ public:
+  CpuAutotuneMap() = default;
+
+  // Returns the process-wide map, loaded from TF_CPU_AUTOTUNE_CACHE if set.
+  static CpuAutotuneMap* Global();
+
+  // Returns true and sets '*algorithm' if 'key' has been tuned.
+  bool Find(const CpuAutotuneKey& key, int* algorithm) const;
+
+  // Records that 'algorithm' is the fastest for 'key', running in
+  // 'run_time_nanos'. Overwrites any previous result.
+  void Insert(const CpuAutotuneKey& key, int algorithm, int64 run_time_nanos);
+
+  int64 size() const;
+  void Clear();
+
+  // Converts to and from the persisted format. FromProto() adds the results to
+  // the map, and fails without changing it if they were measured on a
+  // different CPU.
+  void ToProto(CpuAutotuneResults* results) const;
+  Status FromProto(const CpuAutotuneResults& results);
+
+  // Saves the map to, or adds the results saved in, the file 'filename'.
+  Status Save(const string& filename) const;
+  Status Load(const string& filename);
+
+ private:
+  struct Result {
+    int algorithm;
+    int64 run_time_nanos;
+  };
+
+  mutable mutex mu_;
+  std::unordered_map<CpuAutotuneKey, Result, CpuAutotuneKey::Hasher> results_
+      GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CpuAutotuneMap);
+};
+
+// Solves the problem identified by 'key' with the fastest of 'candidates',
+// whose indices are the algorithm ids recorded in 'map'. Each candidate
+// either solves the whole problem and returns true, or returns false without
+// side effects if it doesn't support the problem.
+//
+// If 'key' hasn't been tuned yet, runs every candidate, timing the ones that
+// support the problem, and records the fastest in 'map' (saving the global map
+// to TF_CPU_AUTOTUNE_CACHE if set). The problem is solved as a side effect.
+//
+// Returns the id of the algorithm that solved the problem, or -1 if no
+// candidate supports it.
+int CpuAutotuneAndRun(const CpuAutotuneKey& key,
+                      gtl::ArraySlice<std::function<bool()>> candidates,
+                      CpuAutotuneMap* map = CpuAutotuneMap::Global());
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_CPU_AUTOTUNE_H_
@@ -0,0 +1,139 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/cpu_autotune.h"
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+CpuAutotuneKey TestKey(int64 size) {
+  return CpuAutotuneKey("TestOp", {size, 3}, DT_FLOAT, 4);
+}
+
+// A candidate algorithm that counts its runs, and takes 'sleep_micros' to run
+// if it supports the problem.
+std::function<bool()> Candidate(bool supported, int64 sleep_micros,
+                                int* num_runs) {
+  return [supported, sleep_micros, num_runs]() {
+    if (!supported) return false;
+    ++*num_runs;
+    Env::Default()->SleepForMicroseconds(sleep_micros);
+    return true;
+  };
+}
+
+TEST(CpuAutotuneKeyTest, Equality) {
+  EXPECT_EQ(TestKey(1), TestKey(1));
+  EXPECT_EQ(TestKey(1).hash(), TestKey(1).hash());
+  EXPECT_NE(TestKey(1), TestKey(2));
+  EXPECT_NE(TestKey(1), CpuAutotuneKey("TestOp", {1, 3}, DT_DOUBLE, 4));
+  EXPECT_NE(TestKey(1), CpuAutotuneKey("TestOp", {1, 3}, DT_FLOAT, 8));
+  EXPECT_NE(TestKey(1), CpuAutotuneKey("OtherOp", {1, 3}, DT_FLOAT, 4));
+}
+
+TEST(CpuAutotuneTest, PicksFastestAndCachesIt) {
+  CpuAutotuneMap map;
+  int slow_runs = 0;
+  int fast_runs = 0;
+  const std::vector<std::function<bool()>> candidates = {
+      Candidate(true, 5000, &slow_runs), Candidate(true, 0, &fast_runs)};
+
+  EXPECT_EQ(1, CpuAutotuneAndRun(TestKey(1), candidates, &map));
+  // One warmup run and the timed runs of each candidate.
+  EXPECT_EQ(4, slow_runs);
+  EXPECT_EQ(4, fast_runs);
+  int algorithm;
+  ASSERT_TRUE(map.Find(TestKey(1), &algorithm));
+  EXPECT_EQ(1, algorithm);
+
+  // Later uses run the winner once.
+  EXPECT_EQ(1, CpuAutotuneAndRun(TestKey(1), candidates, &map));
+  EXPECT_EQ(4, slow_runs);
+  EXPECT_EQ(5, fast_runs);
+
+  // Other problems are tuned separately.
+  EXPECT_FALSE(map.Find(TestKey(2), &algorithm));
+}
+
+TEST(CpuAutotuneTest, SkipsUnsupportedCandidates) {
+  CpuAutotuneMap map;
+  int unsupported_runs = 0;
+  int supported_runs = 0;
+  const std::vector<std::function<bool()>> candidates = {
+      Candidate(false, 0, &unsupported_runs),
+      Candidate(true, 1000, &supported_runs)};
+
+  // A single supported candidate isn't timed.
+  EXPECT_EQ(1, CpuAutotuneAndRun(TestKey(1), candidates, &map));
+  EXPECT_EQ(0, unsupported_runs);
+  EXPECT_EQ(1, supported_runs);
+  EXPECT_EQ(1, map.size());
+
+  const std::vector<std::function<bool()>> unsupported = {
+      Candidate(false, 0, &unsupported_runs)};
+  EXPECT_EQ(-1, CpuAutotuneAndRun(TestKey(2), unsupported, &map));
+  EXPECT_EQ(1, map.size());
+}
+
+TEST(CpuAutotuneTest, RetunesIfCachedAlgorithmIsUnsupported) {
+  CpuAutotuneMap map;
+  map.Insert(TestKey(1), 0, 100);
+  int runs = 0;
+  const std::vector<std::function<bool()>> candidates = {
+      Candidate(false, 0, &runs), Candidate(true, 0, &runs)};
+  EXPECT_EQ(1, CpuAutotuneAndRun(TestKey(1), candidates, &map));
+  int algorithm;
+  ASSERT_TRUE(map.Find(TestKey(1), &algorithm));
+  EXPECT_EQ(1, algorithm);
+}
+
+TEST(CpuAutotuneTest, SavesAndLoads) {
+  CpuAutotuneMap map;
+  map.Insert(TestKey(1), 2, 100);
+  map.Insert(TestKey(2), 1, 200);
+  const string filename =
+      io::JoinPath(testing::TmpDir(), "cpu_autotune_test_results");
+  TF_ASSERT_OK(map.Save(filename));
+
+  CpuAutotuneMap loaded;
+  TF_ASSERT_OK(loaded.Load(filename));
+  EXPECT_EQ(2, loaded.size());
+  int algorithm;
+  ASSERT_TRUE(loaded.Find(TestKey(1), &algorithm));
+  EXPECT_EQ(2, algorithm);
+  ASSERT_TRUE(loaded.Find(TestKey(2), &algorithm));
+  EXPECT_EQ(1, algorithm);
+}
+
+TEST(CpuAutotuneTest, RejectsResultsFromOtherCpus) {
+  CpuAutotuneMap map;
+  map.Insert(TestKey(1), 1, 100);
+  CpuAutotuneResults results;
+  map.ToProto(&results);
+  results.set_cpu_model(results.cpu_model() + 1);
+
+  CpuAutotuneMap loaded;
+  EXPECT_TRUE(errors::IsFailedPrecondition(loaded.FromProto(results)));
+  EXPECT_EQ(0, loaded.size());
+}
+
+}  // namespace
+}  // namespace tensorflow
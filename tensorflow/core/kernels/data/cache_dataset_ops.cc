@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/cache_ops.h"
+#include "tensorflow/core/kernels/data/columnar_cache.h"
 #include "tensorflow/core/kernels/data/name_utils.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
@@ -44,6 +45,7 @@ constexpr char kLockFileSuffix[] = ".lockfile";
 constexpr char kIterationCompleted[] = "iteration_completed";
 constexpr char kCurIndex[] = "cur_index";
 constexpr char kShardId[] = "shard_id";
+constexpr char kColumnar[] = "columnar";
 constexpr char kCreatedAt[] = "Created at";
 constexpr char kMemoryDatasetPrefix[] = "Memory";
 constexpr char kMemoryCache[] = "MemoryCache";
@@ -70,7 +72,10 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         item_index_padding_size_(StringPaddingSize(kMaxItems)),
         tensor_format_string_(strings::Printf(kKeyStrFormat,
                                               item_index_padding_size_,
-                                              tensor_index_padding_size_)) {
+                                              tensor_index_padding_size_)),
+        use_columnar_(CanUseColumnarCache(input->output_dtypes(),
+                                          input->output_shapes(),
+                                          &columnar_shapes_)) {
     input_->Ref();
     DCHECK_EQ(item_index_padding_size_, 7);
   }
@@ -130,13 +135,42 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
                            tensor_index);
   }
 
+  bool IsColumnarCache() const {
+    return env_->FileExists(ColumnarIndexFilename(filename_)).ok();
+  }
+
+  // Returns true if the cache has been completely written, in either format.
+  bool CacheExists() const {
+    return env_->FileExists(MetaFilename(filename_)).ok() || IsColumnarCache();
+  }
+
+  // Opens the columnar cache on first use. The reader is shared by all the
+  // iterators of this dataset, which read its blocks concurrently.
+  Status GetColumnarReader(std::shared_ptr<const ColumnarCacheReader>* reader)
+      const {
+    mutex_lock l(columnar_reader_mu_);
+    if (!columnar_reader_) {
+      std::unique_ptr<ColumnarCacheReader> new_reader;
+      TF_RETURN_IF_ERROR(ColumnarCacheReader::Open(
+          env_, filename_, /*use_mmap=*/true, &new_reader));
+      columnar_reader_ = std::move(new_reader);
+    }
+    *reader = columnar_reader_;
+    return Status::OK();
+  }
+
+  // Drops the shared columnar reader, so that a cache that has just been
+  // (re)written is opened again by the next reader.
+  void ResetColumnarReader() const {
+    mutex_lock l(columnar_reader_mu_);
+    columnar_reader_.reset();
+  }
+
   class FileIterator : public DatasetIterator<FileDataset> {
    public:
     explicit FileIterator(const Params& params)
         : DatasetIterator<FileDataset>(params) {
-      if (params.dataset->env_
-              ->FileExists(MetaFilename(params.dataset->filename_))
-              .ok()) {
+      if (params.dataset->CacheExists()) {
         mode_ = Mode::read;
       } else {
         mode_ = Mode::write;
@@ -176,18 +210,16 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kMode), &temp));
         mode_ = static_cast<Mode>(temp);
       }
-      if (mode_ == Mode::write &&
-          dataset()
-              ->env_->FileExists(MetaFilename(dataset()->filename_))
-              .ok()) {
+      if (mode_ == Mode::write && dataset()->CacheExists()) {
         // This could happen if the cache was completely written after the
         // checkpoint was saved.
         LOG(WARNING)
             << "It looks like the cache was already completely written("
-            << MetaFilename(dataset()->filename_)
+            << dataset()->filename_
             << ") after the last checkpoint was saved. Attempting to read "
             << "the cache instead of continuing to write. If this is a "
-            << "mistake, please remove the above file and try running again.";
+            << "mistake, please remove the above files and try running "
+            << "again.";
         mode_ = Mode::read;
       }
       InitializeIterator();
@@ -203,8 +235,10 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
     // creates the cache directory, and passes on the underlying iterator's
     // elements.
     //
-    // Caching is performed by writing the input tensors to disk using the
-    // `BundleWriter`. Note that the cache gets fully flushed to disk only
+    // Caching is performed by writing the input tensors to disk using a
+    // `ColumnarCacheWriter` when all the components have fixed shapes and
+    // data types that can be copied with memcpy, and using the `BundleWriter`
+    // otherwise. Note that the cache gets fully flushed to disk only
     // after the input iterator has been fully exhausted. If the program
     // exits, before completion of an epoch, the cached state would be lost.
     // To ensure that the partial cache persists across sessions, one should
@@ -222,10 +256,13 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
                 strings::StrCat(params.dataset->filename_, "_", shard_id_)),
             lockfile_(strings::StrCat(filename_, kLockFileSuffix)),
             lockfile_created_(false),
-            iteration_completed_(false) {}
+            iteration_completed_(false),
+            columnar_(params.dataset->use_columnar_) {}
 
       ~FileWriterIterator() {
-        if (!dataset()->env_->FileExists(MetaFilename(filename_)).ok()) {
+        if (!dataset()->env_->FileExists(MetaFilename(filename_)).ok() &&
+            !dataset()->env_->FileExists(ColumnarIndexFilename(filename_))
+                 .ok()) {
           std::vector<string> cache_files;
           Status s = dataset()->env_->GetMatchingPaths(
               strings::StrCat(filename_, "*"), &cache_files);
@@ -256,7 +293,7 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         if (*end_of_sequence) {
           return Status::OK();
         }
-        TF_RETURN_IF_ERROR(writer_->status());
+        TF_RETURN_IF_ERROR(WriterStatus());
         if (cur_index_ >= kMaxItems) {
           // As a courtesy, close the [truncated] cache file.
           Status s = Finish();
@@ -281,11 +318,15 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
               "Expected ",
               dataset()->num_tensors_, " got: ", out_tensors->size());
         }
-        size_t tensor_index = 0;
-        for (const Tensor& t : *out_tensors) {
-          DCHECK_LT(tensor_index, dataset()->num_tensors_);
-          string key = dataset()->FormatName(cur_index_, tensor_index++);
-          TF_RETURN_IF_ERROR(writer_->Add(key, t));
+        if (columnar_) {
+          TF_RETURN_IF_ERROR(columnar_writer_->Add(*out_tensors));
+        } else {
+          size_t tensor_index = 0;
+          for (const Tensor& t : *out_tensors) {
+            DCHECK_LT(tensor_index, dataset()->num_tensors_);
+            string key = dataset()->FormatName(cur_index_, tensor_index++);
+            TF_RETURN_IF_ERROR(writer_->Add(key, t));
+          }
         }
         if (*end_of_sequence) {
           TF_RETURN_IF_ERROR(Finish());
@@ -305,6 +346,9 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         mutex_lock l(mu_);
         TF_RETURN_IF_ERROR(
             writer->WriteScalar(full_name(kCurIndex), cur_index_));
+        if (columnar_) {
+          TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kColumnar), ""));
+        }
 
         if (iteration_completed_) {
           TF_RETURN_IF_ERROR(
@@ -319,7 +363,7 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         // empty shards.
         if (lockfile_created_) {
           // Flush the current bundle.
-          TF_RETURN_IF_ERROR(writer_->Finish());
+          TF_RETURN_IF_ERROR(FinishWriter());
 
           // Note: We do not delete the lockfile here. We keep lockfiles of
           // all shards around until the entire cache has been written to
@@ -349,6 +393,9 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
             return errors::Internal("Invalid value for cur_index ", temp);
           }
         }
+        // Checkpoints written before the columnar format was introduced
+        // always refer to bundle shards.
+        columnar_ = reader->Contains(full_name(kColumnar));
 
         if (reader->Contains(full_name(kIterationCompleted))) {
           iteration_completed_ = true;
@@ -368,7 +415,7 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         }
         filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
         lockfile_ = strings::StrCat(filename_, kLockFileSuffix);
-        writer_ = absl::make_unique<BundleWriter>(dataset()->env_, filename_);
+        NewWriter();
         return Status::OK();
       }
 
@@ -394,6 +441,14 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
                                        DataFilename(filename_, 0, 1), "\n",
                                        "To continue delete the above files.");
         }
+        if (dataset()->env_->FileExists(ColumnarIndexFilename(filename_))
+                .ok()) {
+          return errors::AlreadyExists(
+              "Existing cache files found: \n",
+              ColumnarIndexFilename(filename_), "\n",
+              ColumnarDataFilename(filename_, 0), "\n",
+              "To continue delete the above files.");
+        }
 
         // 2. Check that there isn't a concurrent iterator that is writing
         // to cache.
@@ -429,16 +484,36 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
         // unsafe to initialize the BundleWriter anywhere the above
         // conditions are not met since BundleWriter's constructor creates
         // new temp files which can delete the temp files created by a
-        // BundleWriter in another Session.
-        writer_ = absl::make_unique<BundleWriter>(dataset()->env_, filename_);
+        // BundleWriter in another Session. The same holds for the data file
+        // of a ColumnarCacheWriter.
+        NewWriter();
         lockfile_created_ = true;
         return Status::OK();
       }
 
+      void NewWriter() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (columnar_) {
+          columnar_writer_ = absl::make_unique<ColumnarCacheWriter>(
+              dataset()->env_, filename_, dataset()->output_dtypes(),
+              dataset()->columnar_shapes_);
+        } else {
+          writer_ =
+              absl::make_unique<BundleWriter>(dataset()->env_, filename_);
+        }
+      }
+
+      Status WriterStatus() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return columnar_ ? columnar_writer_->status() : writer_->status();
+      }
+
+      Status FinishWriter() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return columnar_ ? columnar_writer_->Finish() : writer_->Finish();
+      }
+
       Status Finish() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         iteration_completed_ = true;
         // Flush the current bundle.
-        TF_RETURN_IF_ERROR(writer_->Finish());
+        TF_RETURN_IF_ERROR(FinishWriter());
         // Merge all the bundles.
         // Currently there are `shard_id_ + 1` bundles, one for each
         // checkpoint. Each bundle has prefix <filename>_<id> where `id` is an
@@ -453,8 +528,14 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
             prefixes.emplace_back(
                 strings::StrCat(dataset()->filename_, "_", i));
           }
-          TF_RETURN_IF_ERROR(
-              MergeBundles(dataset()->env_, prefixes, dataset()->filename_));
+          if (columnar_) {
+            TF_RETURN_IF_ERROR(MergeColumnarCaches(dataset()->env_, prefixes,
+                                                   dataset()->filename_));
+            dataset()->ResetColumnarReader();
+          } else {
+            TF_RETURN_IF_ERROR(MergeBundles(dataset()->env_, prefixes,
+                                            dataset()->filename_));
+          }
         }
         // Delete all lockfiles.
         for (size_t i = 0; i <= shard_id_; ++i) {
@@ -474,9 +555,12 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
       // `StrCat(dataset()->filename_, "_", shard_id_)`.
       string filename_;
       std::unique_ptr<BundleWriter> writer_ GUARDED_BY(mu_);
+      std::unique_ptr<ColumnarCacheWriter> columnar_writer_ GUARDED_BY(mu_);
       string lockfile_ GUARDED_BY(mu_);
       bool lockfile_created_ GUARDED_BY(mu_);
       bool iteration_completed_ GUARDED_BY(mu_);
+      // Whether the shards are written in the columnar format.
+      bool columnar_ GUARDED_BY(mu_);
     };  // FileWriterIterator
 
     class FileReaderIterator : public DatasetIterator<FileDataset> {
@@ -567,6 +651,131 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
       bool iterator_restored_ GUARDED_BY(mu_);
     };  // FileReaderIterator
 
+    // FileColumnarReaderIterator reads a cache written in the columnar format.
+    //
+    // Elements are copied out of whole blocks, which are memory mapped where
+    // the filesystem supports it. While the elements of a block are consumed,
+    // the next block is read and its checksum is verified in the background,
+    // so that sequential reads rarely wait for I/O. Since every element has
+    // the same size, restoring from a checkpoint only needs to locate the
+    // block that holds `cur_index_` in the index.
+    class FileColumnarReaderIterator : public DatasetIterator<FileDataset> {
+     public:
+      explicit FileColumnarReaderIterator(const Params& params)
+          : DatasetIterator<FileDataset>(params), cur_index_(0) {}
+
+      ~FileColumnarReaderIterator() override {
+        mutex_lock l(mu_);
+        while (prefetch_in_flight_) {
+          cond_var_.wait(l);
+        }
+      }
+
+      Status Initialize(IteratorContext* ctx) override {
+        mutex_lock l(mu_);
+        return dataset()->GetColumnarReader(&reader_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (cur_index_ >= reader_->num_elements()) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        if (!block_ || !block_->Contains(cur_index_)) {
+          TF_RETURN_IF_ERROR(
+              LoadBlock(ctx, reader_->BlockIndex(cur_index_), &l));
+        }
+        block_->GetElement(ctx->allocator({}), cur_index_, out_tensors);
+        *end_of_sequence = false;
+        cur_index_++;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args),
+                                         /*ratio=*/1);
+      }
+
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kCurIndex), cur_index_));
+        return Status::OK();
+      }
+
+      Status RestoreInternal(
+          IteratorContext* ctx,
+          IteratorStateReader* iterator_state_reader) override {
+        mutex_lock l(mu_);
+        int64 temp;
+        TF_RETURN_IF_ERROR(
+            iterator_state_reader->ReadScalar(full_name(kCurIndex), &temp));
+        cur_index_ = temp;
+        if (cur_index_ < 0) {
+          return errors::Internal("Invalid value for cur_index ", temp);
+        }
+        return Status::OK();
+      }
+
+     private:
+      // Makes `block_index` the current block, and starts reading the next
+      // one in the background.
+      Status LoadBlock(IteratorContext* ctx, int64 block_index,
+                       mutex_lock* l) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        while (prefetch_in_flight_) {
+          cond_var_.wait(*l);
+        }
+        if (prefetched_block_ && prefetched_block_index_ == block_index) {
+          Status s = prefetch_status_;
+          block_ = std::move(prefetched_block_);
+          if (!s.ok()) {
+            block_.reset();
+            return s;
+          }
+        } else {
+          prefetched_block_.reset();
+          block_ = absl::make_unique<ColumnarCacheBlock>();
+          Status s = reader_->ReadBlock(block_index, block_.get());
+          if (!s.ok()) {
+            block_.reset();
+            return s;
+          }
+        }
+        const int64 next_block_index = block_index + 1;
+        if (next_block_index < reader_->num_blocks()) {
+          prefetch_in_flight_ = true;
+          prefetched_block_index_ = next_block_index;
+          std::shared_ptr<const ColumnarCacheReader> reader = reader_;
+          (*ctx->runner())([this, reader, next_block_index]() {
+            auto block = absl::make_unique<ColumnarCacheBlock>();
+            Status s = reader->ReadBlock(next_block_index, block.get());
+            mutex_lock l(mu_);
+            prefetch_status_ = s;
+            prefetched_block_ = std::move(block);
+            prefetch_in_flight_ = false;
+            cond_var_.notify_all();
+          });
+        }
+        return Status::OK();
+      }
+
+      mutex mu_;
+      condition_variable cond_var_;
+      int64 cur_index_ GUARDED_BY(mu_);
+      std::shared_ptr<const ColumnarCacheReader> reader_ GUARDED_BY(mu_);
+      std::unique_ptr<ColumnarCacheBlock> block_ GUARDED_BY(mu_);
+      // The block after `block_`, which is read in the background.
+      std::unique_ptr<ColumnarCacheBlock> prefetched_block_ GUARDED_BY(mu_);
+      int64 prefetched_block_index_ GUARDED_BY(mu_) = -1;
+      Status prefetch_status_ GUARDED_BY(mu_);
+      bool prefetch_in_flight_ GUARDED_BY(mu_) = false;
+    };  // FileColumnarReaderIterator
+
     void InitializeIterator() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       // We intentionally use the same prefix for both `FileReaderIterator`
       // and `FileWriterIterator`. Since at any time there will be at most
@@ -578,9 +787,15 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
       // `FileReaderIterator` and seek to the `cur_index`.
       switch (mode_) {
         case Mode::read:
-          iterator_ =
-              absl::make_unique<FileReaderIterator>(FileReaderIterator::Params{
-                  dataset(), strings::StrCat(prefix(), kImpl)});
+          if (dataset()->IsColumnarCache()) {
+            iterator_ = absl::make_unique<FileColumnarReaderIterator>(
+                FileColumnarReaderIterator::Params{
+                    dataset(), strings::StrCat(prefix(), kImpl)});
+          } else {
+            iterator_ = absl::make_unique<FileReaderIterator>(
+                FileReaderIterator::Params{dataset(),
+                                           strings::StrCat(prefix(), kImpl)});
+          }
           break;
         case Mode::write:
           iterator_ =
@@ -601,6 +816,13 @@ class CacheDatasetOp::FileDataset : public DatasetBase {
   static const size_t kMaxItems = 10000000;  // 10 million
   const size_t item_index_padding_size_;
   const string tensor_format_string_;
+  // Whether new caches are written in the columnar format, in which case
+  // `columnar_shapes_` holds the shapes of the components.
+  std::vector<TensorShape> columnar_shapes_;
+  const bool use_columnar_;
+  mutable mutex columnar_reader_mu_;
+  mutable std::shared_ptr<const ColumnarCacheReader> columnar_reader_
+      GUARDED_BY(columnar_reader_mu_);
 };  // FileDataset
 
 class CacheDatasetOp::FileDatasetV2 : public CacheDatasetOp::FileDataset {
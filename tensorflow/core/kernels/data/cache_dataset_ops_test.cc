@@ -95,7 +95,7 @@ struct TestCase {
   std::vector<int> breakpoints;
 };
 
-// Test case 1: cache data in file.
+// Test case 1: cache data in file, using the columnar format.
 TestCase TestCase1() {
   return {/*input_tensors*/ {CreateTensor<int64>(TensorShape{3, 3, 1},
                                                  {0, 1, 2, 3, 4, 5, 6, 7, 8})},
@@ -147,6 +147,23 @@ TestCase TestCase4() {
           /*breakpoints*/ {0, 2, 4, 11}};
 }
 
+// Test case 5: cache data in file, using the tensor bundle format since
+// strings cannot be stored in the columnar format.
+TestCase TestCase5() {
+  return {/*input_tensors*/ {CreateTensor<tstring>(TensorShape{3, 2},
+                                                   {"a", "b", "c", "d", "e",
+                                                    "f"})},
+          /*file_name*/ absl::StrCat(testing::TmpDir(), "/string_cache_data"),
+          /*expected_outputs*/
+          {CreateTensor<tstring>(TensorShape{2}, {"a", "b"}),
+           CreateTensor<tstring>(TensorShape{2}, {"c", "d"}),
+           CreateTensor<tstring>(TensorShape{2}, {"e", "f"})},
+          /*expected_output_dtypes*/ {DT_STRING},
+          /*expected_output_shapes*/ {PartialTensorShape({2})},
+          /*expected_cardinality*/ 3,
+          /*breakpoints*/ {0, 2, 4, 11}};
+}
+
 class ParameterizedCacheDatasetOpTest
     : public CacheDatasetOpTest,
       public ::testing::WithParamInterface<TestCase> {};
@@ -522,7 +539,8 @@ TEST_P(ParameterizedCacheDatasetOpTest, Roundtrip) {
 INSTANTIATE_TEST_SUITE_P(
     CacheDatasetOpTest, ParameterizedCacheDatasetOpTest,
     ::testing::ValuesIn(std::vector<TestCase>({TestCase1(), TestCase2(),
-                                               TestCase3(), TestCase4()})));
+                                               TestCase3(), TestCase4(),
+                                               TestCase5()})));
 
 }  // namespace
 }  // namespace data
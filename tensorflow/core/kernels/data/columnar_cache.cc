@@ -0,0 +1,396 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/columnar_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr int32 kColumnarCacheVersion = 1;
+// Blocks start at multiples of this offset in the data files.
+constexpr int64 kBlockAlignment = 64;
+
+// Writes `index` to `filename` through a temporary file, so that a partially
+// written index is never observed.
+Status WriteIndex(Env* env, const string& filename,
+                  const ColumnarCacheIndex& index) {
+  const string tmp_filename =
+      strings::StrCat(filename, ".tempstate", random::New64());
+  TF_RETURN_IF_ERROR(WriteBinaryProto(env, tmp_filename, index));
+  return env->RenameFile(tmp_filename, filename);
+}
+
+bool SameElementSpec(const ColumnarCacheIndex& a, const ColumnarCacheIndex& b) {
+  if (a.dtype_size() != b.dtype_size() || a.shape_size() != b.shape_size()) {
+    return false;
+  }
+  for (int i = 0; i < a.dtype_size(); ++i) {
+    if (a.dtype(i) != b.dtype(i)) return false;
+  }
+  for (int i = 0; i < a.shape_size(); ++i) {
+    if (!TensorShape::IsValid(a.shape(i)) ||
+        !TensorShape::IsValid(b.shape(i)) ||
+        TensorShape(a.shape(i)) != TensorShape(b.shape(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+/* static */ constexpr int64 ColumnarCacheWriter::kDefaultBlockSizeBytes;
+
+string ColumnarIndexFilename(StringPiece prefix) {
+  return strings::StrCat(prefix, ".columns_index");
+}
+
+string ColumnarDataFilename(StringPiece prefix, int file_index) {
+  return strings::Printf("%.*s.columns-%05d", static_cast<int>(prefix.size()),
+                         prefix.data(), file_index);
+}
+
+bool CanUseColumnarCache(const DataTypeVector& dtypes,
+                         const std::vector<PartialTensorShape>& partial_shapes,
+                         std::vector<TensorShape>* shapes) {
+  if (dtypes.size() != partial_shapes.size()) {
+    return false;
+  }
+  for (DataType dtype : dtypes) {
+    if (!DataTypeCanUseMemcpy(dtype)) {
+      return false;
+    }
+  }
+  shapes->clear();
+  for (const PartialTensorShape& partial_shape : partial_shapes) {
+    TensorShape shape;
+    if (!partial_shape.AsTensorShape(&shape)) {
+      return false;
+    }
+    shapes->push_back(shape);
+  }
+  return true;
+}
+
+ColumnarCacheWriter::ColumnarCacheWriter(Env* env, StringPiece prefix,
+                                         const DataTypeVector& dtypes,
+                                         const std::vector<TensorShape>& shapes,
+                                         int64 block_size_bytes)
+    : env_(env), prefix_(prefix), dtypes_(dtypes), shapes_(shapes) {
+  if (dtypes_.size() != shapes_.size()) {
+    status_ = errors::InvalidArgument("Got ", dtypes_.size(), " types and ",
+                                      shapes_.size(), " shapes.");
+    return;
+  }
+  int64 element_bytes = 0;
+  for (int i = 0; i < dtypes_.size(); ++i) {
+    if (!DataTypeCanUseMemcpy(dtypes_[i])) {
+      status_ = errors::InvalidArgument(
+          "A columnar cache cannot store elements of type ",
+          DataTypeString(dtypes_[i]));
+      return;
+    }
+    component_bytes_.push_back(shapes_[i].num_elements() *
+                               DataTypeSize(dtypes_[i]));
+    element_bytes += component_bytes_.back();
+  }
+  elements_per_block_ =
+      std::max<int64>(1, block_size_bytes / std::max<int64>(element_bytes, 1));
+  columns_.resize(dtypes_.size());
+  for (int i = 0; i < columns_.size(); ++i) {
+    columns_[i].reserve(elements_per_block_ * component_bytes_[i]);
+  }
+
+  index_.set_version(kColumnarCacheVersion);
+  for (int i = 0; i < dtypes_.size(); ++i) {
+    index_.add_dtype(dtypes_[i]);
+    shapes_[i].AsProto(index_.add_shape());
+  }
+  index_.set_num_files(1);
+
+  status_ = env_->CreateDir(string(io::Dirname(prefix_)));
+  if (!status_.ok() && !errors::IsAlreadyExists(status_)) {
+    return;
+  }
+  status_ = env_->NewWritableFile(ColumnarDataFilename(prefix_, 0), &file_);
+}
+
+Status ColumnarCacheWriter::Add(const std::vector<Tensor>& element) {
+  TF_RETURN_IF_ERROR(status_);
+  if (finished_) {
+    return errors::FailedPrecondition("The columnar cache ", prefix_,
+                                      " has already been finished.");
+  }
+  if (element.size() != dtypes_.size()) {
+    return errors::InvalidArgument("Expected an element with ", dtypes_.size(),
+                                   " components, got ", element.size());
+  }
+  for (int i = 0; i < element.size(); ++i) {
+    if (element[i].dtype() != dtypes_[i] || element[i].shape() != shapes_[i]) {
+      return errors::InvalidArgument(
+          "Expected component ", i, " to be a ", DataTypeString(dtypes_[i]),
+          " tensor of shape ", shapes_[i].DebugString(), ", got a ",
+          DataTypeString(element[i].dtype()), " tensor of shape ",
+          element[i].shape().DebugString());
+    }
+  }
+  for (int i = 0; i < element.size(); ++i) {
+    columns_[i].append(element[i].tensor_data().data(), component_bytes_[i]);
+  }
+  if (++num_buffered_elements_ == elements_per_block_) {
+    status_ = FlushBlock();
+  }
+  return status_;
+}
+
+Status ColumnarCacheWriter::FlushBlock() {
+  if (num_buffered_elements_ == 0) {
+    return Status::OK();
+  }
+  const int64 padding =
+      (kBlockAlignment - offset_ % kBlockAlignment) % kBlockAlignment;
+  if (padding > 0) {
+    TF_RETURN_IF_ERROR(file_->Append(string(padding, '\0')));
+    offset_ += padding;
+  }
+  ColumnarCacheIndex::Block* block = index_.add_block();
+  block->set_file_index(0);
+  block->set_offset(offset_);
+  block->set_num_elements(num_buffered_elements_);
+  uint32 crc = 0;
+  for (string& column : columns_) {
+    crc = crc32c::Extend(crc, column.data(), column.size());
+    TF_RETURN_IF_ERROR(file_->Append(column));
+    offset_ += column.size();
+    column.clear();
+  }
+  block->set_crc32c(crc);
+  num_buffered_elements_ = 0;
+  return Status::OK();
+}
+
+Status ColumnarCacheWriter::Finish() {
+  TF_RETURN_IF_ERROR(status_);
+  if (finished_) {
+    return errors::FailedPrecondition("The columnar cache ", prefix_,
+                                      " has already been finished.");
+  }
+  finished_ = true;
+  status_ = FlushBlock();
+  if (status_.ok()) {
+    status_ = file_->Close();
+  }
+  if (status_.ok()) {
+    status_ = WriteIndex(env_, ColumnarIndexFilename(prefix_), index_);
+  }
+  return status_;
+}
+
+Status MergeColumnarCaches(Env* env, gtl::ArraySlice<tstring> prefixes,
+                           StringPiece merged_prefix) {
+  if (prefixes.empty()) {
+    return errors::InvalidArgument("No columnar caches to merge.");
+  }
+  // Validates all the indices before renaming any data file.
+  std::vector<ColumnarCacheIndex> indices(prefixes.size());
+  for (int i = 0; i < prefixes.size(); ++i) {
+    TF_RETURN_IF_ERROR(
+        ReadBinaryProto(env, ColumnarIndexFilename(prefixes[i]), &indices[i]));
+    if (indices[i].version() != indices[0].version() ||
+        !SameElementSpec(indices[i], indices[0])) {
+      return errors::InvalidArgument("The columnar caches ", prefixes[0],
+                                     " and ", prefixes[i],
+                                     " have different element types or "
+                                     "shapes.");
+    }
+  }
+
+  ColumnarCacheIndex merged = indices[0];
+  merged.clear_block();
+  merged.set_num_files(0);
+  for (int i = 0; i < prefixes.size(); ++i) {
+    const int file_offset = merged.num_files();
+    for (int f = 0; f < indices[i].num_files(); ++f) {
+      TF_RETURN_IF_ERROR(env->RenameFile(
+          ColumnarDataFilename(prefixes[i], f),
+          ColumnarDataFilename(merged_prefix, file_offset + f)));
+    }
+    for (const ColumnarCacheIndex::Block& block : indices[i].block()) {
+      ColumnarCacheIndex::Block* merged_block = merged.add_block();
+      *merged_block = block;
+      merged_block->set_file_index(file_offset + block.file_index());
+    }
+    merged.set_num_files(file_offset + indices[i].num_files());
+  }
+  TF_RETURN_IF_ERROR(
+      WriteIndex(env, ColumnarIndexFilename(merged_prefix), merged));
+  // Cleanup: best effort based and ignores errors.
+  for (const tstring& prefix : prefixes) {
+    env->DeleteFile(ColumnarIndexFilename(prefix)).IgnoreError();
+  }
+  return Status::OK();
+}
+
+void ColumnarCacheBlock::GetElement(Allocator* allocator, int64 element,
+                                    std::vector<Tensor>* out_tensors) const {
+  DCHECK(Contains(element));
+  const int64 position = element - first_element_;
+  const char* column = data_;
+  out_tensors->clear();
+  out_tensors->reserve(dtypes_->size());
+  for (int i = 0; i < dtypes_->size(); ++i) {
+    const int64 bytes = (*component_bytes_)[i];
+    out_tensors->emplace_back(allocator, (*dtypes_)[i], (*shapes_)[i]);
+    if (bytes > 0) {
+      std::memcpy(const_cast<char*>(out_tensors->back().tensor_data().data()),
+                  column + position * bytes, bytes);
+    }
+    column += num_elements_ * bytes;
+  }
+}
+
+Status ColumnarCacheReader::Open(Env* env, StringPiece prefix, bool use_mmap,
+                                 std::unique_ptr<ColumnarCacheReader>* reader) {
+  std::unique_ptr<ColumnarCacheReader> result(new ColumnarCacheReader());
+  result->prefix_ = string(prefix);
+  ColumnarCacheIndex& index = result->index_;
+  TF_RETURN_IF_ERROR(
+      ReadBinaryProto(env, ColumnarIndexFilename(prefix), &index));
+  if (index.version() != kColumnarCacheVersion) {
+    return errors::Unimplemented("Unsupported version ", index.version(),
+                                 " of the columnar cache ", prefix);
+  }
+  if (index.dtype_size() != index.shape_size()) {
+    return errors::DataLoss("Corrupted index of the columnar cache ", prefix);
+  }
+  for (int i = 0; i < index.dtype_size(); ++i) {
+    const DataType dtype = static_cast<DataType>(index.dtype(i));
+    if (!DataTypeCanUseMemcpy(dtype)) {
+      return errors::DataLoss("Corrupted index of the columnar cache ", prefix);
+    }
+    TF_RETURN_IF_ERROR(TensorShape::IsValidShape(index.shape(i)));
+    result->dtypes_.push_back(dtype);
+    result->shapes_.emplace_back(index.shape(i));
+    result->component_bytes_.push_back(result->shapes_.back().num_elements() *
+                                       DataTypeSize(dtype));
+    result->element_bytes_ += result->component_bytes_.back();
+  }
+  result->block_first_element_.reserve(index.block_size() + 1);
+  result->block_first_element_.push_back(0);
+  for (const ColumnarCacheIndex::Block& block : index.block()) {
+    if (block.file_index() < 0 || block.file_index() >= index.num_files() ||
+        block.offset() < 0 || block.num_elements() <= 0) {
+      return errors::DataLoss("Corrupted index of the columnar cache ", prefix);
+    }
+    result->block_first_element_.push_back(
+        result->block_first_element_.back() + block.num_elements());
+  }
+  result->files_.resize(index.num_files());
+  for (int f = 0; f < index.num_files(); ++f) {
+    const string filename = ColumnarDataFilename(prefix, f);
+    DataFile* file = &result->files_[f];
+    uint64 file_size = 0;
+    if (use_mmap) {
+      TF_RETURN_IF_ERROR(env->GetFileSize(filename, &file_size));
+    }
+    // Empty files, e.g. those of empty datasets, cannot be memory-mapped.
+    if (use_mmap && file_size > 0) {
+      std::unique_ptr<ReadOnlyMemoryRegion> region;
+      Status s = env->NewReadOnlyMemoryRegionFromFile(filename, &region);
+      if (s.ok()) {
+        file->region = std::move(region);
+        continue;
+      }
+      if (!errors::IsUnimplemented(s)) {
+        return s;
+      }
+    }
+    TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file->file));
+  }
+  *reader = std::move(result);
+  return Status::OK();
+}
+
+int64 ColumnarCacheReader::BlockIndex(int64 element) const {
+  DCHECK_LT(element, num_elements());
+  return std::upper_bound(block_first_element_.begin(),
+                          block_first_element_.end(), element) -
+         block_first_element_.begin() - 1;
+}
+
+Status ColumnarCacheReader::ReadBlock(int64 block_index,
+                                      ColumnarCacheBlock* block) const {
+  if (block_index < 0 || block_index >= num_blocks()) {
+    return errors::OutOfRange("Block ", block_index,
+                              " is out of range in the columnar cache ",
+                              prefix_);
+  }
+  const ColumnarCacheIndex::Block& block_index_entry =
+      index_.block(block_index);
+  const int64 size = block_index_entry.num_elements() * element_bytes_;
+  const DataFile& file = files_[block_index_entry.file_index()];
+  if (file.region) {
+    if (block_index_entry.offset() + size > file.region->length()) {
+      return errors::DataLoss(
+          "Truncated columnar cache file ",
+          ColumnarDataFilename(prefix_, block_index_entry.file_index()));
+    }
+    block->region_ = file.region;
+    block->owned_data_.clear();
+    block->data_ = static_cast<const char*>(file.region->data()) +
+                   block_index_entry.offset();
+  } else {
+    block->region_.reset();
+    block->owned_data_.resize(size);
+    StringPiece result;
+    Status s = file.file->Read(block_index_entry.offset(), size, &result,
+                               &block->owned_data_[0]);
+    if (!s.ok() && !errors::IsOutOfRange(s)) {
+      return s;
+    }
+    if (result.size() != size) {
+      return errors::DataLoss(
+          "Truncated columnar cache file ",
+          ColumnarDataFilename(prefix_, block_index_entry.file_index()));
+    }
+    if (result.data() != block->owned_data_.data()) {
+      std::memmove(&block->owned_data_[0], result.data(), size);
+    }
+    block->data_ = block->owned_data_.data();
+  }
+  if (crc32c::Value(block->data_, size) != block_index_entry.crc32c()) {
+    return errors::DataLoss("Checksum mismatch for block ", block_index,
+                            " of the columnar cache ", prefix_);
+  }
+  block->dtypes_ = &dtypes_;
+  block->shapes_ = &shapes_;
+  block->component_bytes_ = &component_bytes_;
+  block->first_element_ = block_first_element_[block_index];
+  block->num_elements_ = block_index_entry.num_elements();
+  return Status::OK();
+}
+
+}  // namespace data
+}  // namespace tensorflow
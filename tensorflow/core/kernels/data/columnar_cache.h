@@ -0,0 +1,195 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_COLUMNAR_CACHE_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_COLUMNAR_CACHE_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/protobuf/data/columnar_cache.pb.h"
+
+namespace tensorflow {
+namespace data {
+
+// A columnar cache stores the elements of a dataset whose components have
+// fully defined shapes and data types that can be copied with memcpy. The
+// elements are written in blocks of a few megabytes, with the contents of
+// each component stored contiguously within a block, and a compact index
+// with one entry per block (see `ColumnarCacheIndex`). Compared to a tensor
+// bundle, which stores one key per component of every element, the index is
+// tiny, any element can be located without a lookup and whole blocks are read
+// with a single sequential read or a memory mapping.
+//
+// A cache with prefix `prefix` is made of the index file
+// `ColumnarIndexFilename(prefix)` and of the data files
+// `ColumnarDataFilename(prefix, i)`.
+
+// Returns the name of the index file of the columnar cache `prefix`.
+string ColumnarIndexFilename(StringPiece prefix);
+
+// Returns the name of the `file_index`-th data file of the columnar cache
+// `prefix`.
+string ColumnarDataFilename(StringPiece prefix, int file_index);
+
+// Returns true if elements with the given types and shapes can be stored in a
+// columnar cache, in which case `shapes` is set to the fully defined shapes.
+bool CanUseColumnarCache(const DataTypeVector& dtypes,
+                         const std::vector<PartialTensorShape>& partial_shapes,
+                         std::vector<TensorShape>* shapes);
+
+// Writes the elements of a columnar cache with a single data file.
+//
+// Like `BundleWriter`, the writer creates its data file on construction and
+// reports errors through `status()`. The index is only written by `Finish()`,
+// so an incomplete cache is never mistaken for a complete one.
+class ColumnarCacheWriter {
+ public:
+  // Blocks are flushed once they hold about `block_size_bytes` bytes.
+  static constexpr int64 kDefaultBlockSizeBytes = 4 << 20;  // 4MB
+
+  ColumnarCacheWriter(Env* env, StringPiece prefix,
+                      const DataTypeVector& dtypes,
+                      const std::vector<TensorShape>& shapes,
+                      int64 block_size_bytes = kDefaultBlockSizeBytes);
+
+  // Appends an element, which must match the types and shapes the writer was
+  // created with.
+  Status Add(const std::vector<Tensor>& element);
+
+  // Flushes the last block and writes the index. No more elements can be added
+  // afterwards.
+  Status Finish();
+
+  Status status() const { return status_; }
+
+ private:
+  Status FlushBlock();
+
+  Env* const env_;
+  const string prefix_;
+  const DataTypeVector dtypes_;
+  const std::vector<TensorShape> shapes_;
+  std::vector<int64> component_bytes_;
+  int64 elements_per_block_;
+  std::unique_ptr<WritableFile> file_;
+  // The contents of each component of the current block.
+  std::vector<string> columns_;
+  int64 num_buffered_elements_ = 0;
+  int64 offset_ = 0;
+  ColumnarCacheIndex index_;
+  bool finished_ = false;
+  Status status_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ColumnarCacheWriter);
+};
+
+// Merges the columnar caches `prefixes`, whose elements have the same types
+// and shapes, into the cache `merged_prefix`, in order. The data files are
+// renamed, not copied, and the indices of `prefixes` are deleted.
+Status MergeColumnarCaches(Env* env, gtl::ArraySlice<tstring> prefixes,
+                           StringPiece merged_prefix);
+
+// A block of elements read from a columnar cache. The contents either point
+// into a memory mapping of the data file, which the block keeps alive, or are
+// owned by the block. A block can only be used while the reader that read it
+// is alive.
+class ColumnarCacheBlock {
+ public:
+  ColumnarCacheBlock() = default;
+
+  int64 first_element() const { return first_element_; }
+  int64 num_elements() const { return num_elements_; }
+  bool Contains(int64 element) const {
+    return element >= first_element_ &&
+           element < first_element_ + num_elements_;
+  }
+
+  // Copies the components of `element`, which must be contained in the block,
+  // into `out_tensors`, which are allocated with `allocator`.
+  void GetElement(Allocator* allocator, int64 element,
+                  std::vector<Tensor>* out_tensors) const;
+
+ private:
+  friend class ColumnarCacheReader;
+
+  const DataTypeVector* dtypes_ = nullptr;
+  const std::vector<TensorShape>* shapes_ = nullptr;
+  const std::vector<int64>* component_bytes_ = nullptr;
+  int64 first_element_ = 0;
+  int64 num_elements_ = 0;
+  std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  string owned_data_;
+  const char* data_ = nullptr;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ColumnarCacheBlock);
+};
+
+// Reads a columnar cache. The reader is immutable once opened, so it can be
+// shared by several threads reading blocks concurrently.
+class ColumnarCacheReader {
+ public:
+  // Opens the cache `prefix`. If `use_mmap` is true, the data files are
+  // memory mapped where the filesystem supports it, and read with
+  // `RandomAccessFile` otherwise.
+  static Status Open(Env* env, StringPiece prefix, bool use_mmap,
+                     std::unique_ptr<ColumnarCacheReader>* reader);
+
+  const DataTypeVector& dtypes() const { return dtypes_; }
+  const std::vector<TensorShape>& shapes() const { return shapes_; }
+  int64 num_elements() const { return block_first_element_.back(); }
+  int64 num_blocks() const { return index_.block_size(); }
+
+  // Returns the index of the block that contains `element`, which must be less
+  // than `num_elements()`.
+  int64 BlockIndex(int64 element) const;
+
+  // Reads the block `block_index` and verifies its checksum.
+  Status ReadBlock(int64 block_index, ColumnarCacheBlock* block) const;
+
+ private:
+  struct DataFile {
+    std::shared_ptr<ReadOnlyMemoryRegion> region;
+    std::unique_ptr<RandomAccessFile> file;
+  };
+
+  ColumnarCacheReader() = default;
+
+  string prefix_;
+  ColumnarCacheIndex index_;
+  DataTypeVector dtypes_;
+  std::vector<TensorShape> shapes_;
+  std::vector<int64> component_bytes_;
+  int64 element_bytes_ = 0;
+  // `block_first_element_[i]` is the index of the first element of block `i`.
+  // The last entry is the total number of elements.
+  std::vector<int64> block_first_element_;
+  std::vector<DataFile> files_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ColumnarCacheReader);
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_COLUMNAR_CACHE_H_
@@ -0,0 +1,343 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/columnar_cache.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+string Prefix(const string& name) {
+  return io::JoinPath(testing::TmpDir(), strings::StrCat("columnar_", name));
+}
+
+// Returns element `i` of the test caches, made of an int64 scalar and a
+// float vector of size 3.
+std::vector<Tensor> Element(int64 i) {
+  const float f = static_cast<float>(i);
+  return {test::AsScalar<int64>(i),
+          test::AsTensor<float>({f + 0.5f, f + 1.5f, f + 2.5f})};
+}
+
+const DataTypeVector& Dtypes() {
+  static DataTypeVector* dtypes = new DataTypeVector({DT_INT64, DT_FLOAT});
+  return *dtypes;
+}
+
+const std::vector<TensorShape>& Shapes() {
+  static std::vector<TensorShape>* shapes =
+      new std::vector<TensorShape>({TensorShape({}), TensorShape({3})});
+  return *shapes;
+}
+
+// Writes elements [begin, end) to the cache `prefix`, in blocks of
+// `block_size_bytes` bytes.
+void WriteCache(const string& prefix, int64 begin, int64 end,
+                int64 block_size_bytes) {
+  ColumnarCacheWriter writer(Env::Default(), prefix, Dtypes(), Shapes(),
+                             block_size_bytes);
+  for (int64 i = begin; i < end; ++i) {
+    TF_ASSERT_OK(writer.Add(Element(i)));
+  }
+  TF_ASSERT_OK(writer.Finish());
+}
+
+void ExpectElements(const ColumnarCacheReader& reader, int64 num_elements) {
+  EXPECT_EQ(num_elements, reader.num_elements());
+  ColumnarCacheBlock block;
+  for (int64 i = 0; i < num_elements; ++i) {
+    if (!block.Contains(i)) {
+      EXPECT_EQ(i, block.first_element() + block.num_elements());
+      TF_ASSERT_OK(reader.ReadBlock(reader.BlockIndex(i), &block));
+      EXPECT_EQ(i, block.first_element());
+    }
+    std::vector<Tensor> element;
+    block.GetElement(cpu_allocator(), i, &element);
+    const std::vector<Tensor> expected = Element(i);
+    ASSERT_EQ(expected.size(), element.size());
+    test::ExpectTensorEqual<int64>(expected[0], element[0]);
+    test::ExpectTensorEqual<float>(expected[1], element[1]);
+  }
+}
+
+TEST(ColumnarCacheTest, RoundTrip) {
+  for (bool use_mmap : {false, true}) {
+    const string prefix = Prefix(strings::StrCat("round_trip_", use_mmap));
+    // Each element takes 20 bytes, so blocks hold 5 elements.
+    WriteCache(prefix, 0, 23, /*block_size_bytes=*/100);
+
+    std::unique_ptr<ColumnarCacheReader> reader;
+    TF_ASSERT_OK(
+        ColumnarCacheReader::Open(Env::Default(), prefix, use_mmap, &reader));
+    EXPECT_EQ(Dtypes(), reader->dtypes());
+    EXPECT_EQ(Shapes(), reader->shapes());
+    EXPECT_EQ(5, reader->num_blocks());
+    ExpectElements(*reader, 23);
+  }
+}
+
+TEST(ColumnarCacheTest, RandomAccess) {
+  const string prefix = Prefix("random_access");
+  WriteCache(prefix, 0, 100, /*block_size_bytes=*/100);
+  std::unique_ptr<ColumnarCacheReader> reader;
+  TF_ASSERT_OK(ColumnarCacheReader::Open(Env::Default(), prefix,
+                                         /*use_mmap=*/true, &reader));
+  for (int64 i : {99, 0, 42, 5, 4}) {
+    ColumnarCacheBlock block;
+    TF_ASSERT_OK(reader->ReadBlock(reader->BlockIndex(i), &block));
+    ASSERT_TRUE(block.Contains(i));
+    std::vector<Tensor> element;
+    block.GetElement(cpu_allocator(), i, &element);
+    test::ExpectTensorEqual<int64>(test::AsScalar<int64>(i), element[0]);
+  }
+  ColumnarCacheBlock block;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->ReadBlock(20, &block)));
+}
+
+TEST(ColumnarCacheTest, EmptyCache) {
+  const string prefix = Prefix("empty");
+  WriteCache(prefix, 0, 0, ColumnarCacheWriter::kDefaultBlockSizeBytes);
+  std::unique_ptr<ColumnarCacheReader> reader;
+  TF_ASSERT_OK(ColumnarCacheReader::Open(Env::Default(), prefix,
+                                         /*use_mmap=*/true, &reader));
+  EXPECT_EQ(0, reader->num_elements());
+  EXPECT_EQ(0, reader->num_blocks());
+}
+
+TEST(ColumnarCacheTest, Merge) {
+  const string prefix = Prefix("merged");
+  std::vector<tstring> shard_prefixes;
+  for (int i = 0; i < 3; ++i) {
+    shard_prefixes.push_back(strings::StrCat(prefix, "_", i));
+    WriteCache(shard_prefixes.back(), i * 12, (i + 1) * 12,
+               /*block_size_bytes=*/100);
+  }
+  TF_ASSERT_OK(MergeColumnarCaches(Env::Default(), shard_prefixes, prefix));
+  for (const tstring& shard_prefix : shard_prefixes) {
+    EXPECT_TRUE(errors::IsNotFound(
+        Env::Default()->FileExists(ColumnarIndexFilename(shard_prefix))));
+    EXPECT_TRUE(errors::IsNotFound(
+        Env::Default()->FileExists(ColumnarDataFilename(shard_prefix, 0))));
+  }
+
+  std::unique_ptr<ColumnarCacheReader> reader;
+  TF_ASSERT_OK(ColumnarCacheReader::Open(Env::Default(), prefix,
+                                         /*use_mmap=*/false, &reader));
+  // Blocks are not shared across shards.
+  EXPECT_EQ(9, reader->num_blocks());
+  ExpectElements(*reader, 36);
+}
+
+TEST(ColumnarCacheTest, MergeMismatchedShapes) {
+  const string prefix = Prefix("merged_mismatched");
+  const string first = strings::StrCat(prefix, "_0");
+  const string second = strings::StrCat(prefix, "_1");
+  WriteCache(first, 0, 10, ColumnarCacheWriter::kDefaultBlockSizeBytes);
+  ColumnarCacheWriter writer(Env::Default(), second, {DT_INT64},
+                             {TensorShape({2})});
+  TF_ASSERT_OK(writer.Add({test::AsTensor<int64>({1, 2})}));
+  TF_ASSERT_OK(writer.Finish());
+  const std::vector<tstring> prefixes = {first, second};
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      MergeColumnarCaches(Env::Default(), prefixes, prefix)));
+  // Nothing is renamed when the caches cannot be merged.
+  TF_EXPECT_OK(Env::Default()->FileExists(ColumnarDataFilename(first, 0)));
+}
+
+TEST(ColumnarCacheTest, CorruptedBlock) {
+  for (bool use_mmap : {false, true}) {
+    const string prefix = Prefix(strings::StrCat("corrupted_", use_mmap));
+    WriteCache(prefix, 0, 10, /*block_size_bytes=*/100);
+    const string filename = ColumnarDataFilename(prefix, 0);
+    string data;
+    TF_ASSERT_OK(ReadFileToString(Env::Default(), filename, &data));
+    // Flip a bit of the second block, which starts at offset 128.
+    data[130] ^= 1;
+    TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, data));
+
+    std::unique_ptr<ColumnarCacheReader> reader;
+    TF_ASSERT_OK(
+        ColumnarCacheReader::Open(Env::Default(), prefix, use_mmap, &reader));
+    ColumnarCacheBlock block;
+    TF_EXPECT_OK(reader->ReadBlock(0, &block));
+    EXPECT_TRUE(errors::IsDataLoss(reader->ReadBlock(1, &block)));
+  }
+}
+
+TEST(ColumnarCacheTest, InvalidElements) {
+  ColumnarCacheWriter writer(Env::Default(), Prefix("invalid"), Dtypes(),
+                             Shapes());
+  EXPECT_TRUE(errors::IsInvalidArgument(writer.Add({})));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      writer.Add({test::AsScalar<int64>(0), test::AsTensor<float>({1, 2})})));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      writer.Add({test::AsScalar<int32>(0),
+                  test::AsTensor<float>({1, 2, 3})})));
+  TF_ASSERT_OK(writer.Finish());
+  EXPECT_TRUE(errors::IsFailedPrecondition(writer.Add(Element(0))));
+
+  ColumnarCacheWriter string_writer(Env::Default(), Prefix("invalid_string"),
+                                    {DT_STRING}, {TensorShape({})});
+  EXPECT_TRUE(errors::IsInvalidArgument(string_writer.status()));
+}
+
+TEST(ColumnarCacheTest, CanUseColumnarCache) {
+  std::vector<TensorShape> shapes;
+  EXPECT_TRUE(CanUseColumnarCache(
+      {DT_INT64, DT_FLOAT},
+      {PartialTensorShape({}), PartialTensorShape({3})}, &shapes));
+  EXPECT_EQ(Shapes(), shapes);
+  EXPECT_FALSE(CanUseColumnarCache({DT_INT64}, {PartialTensorShape({-1})},
+                                   &shapes));
+  EXPECT_FALSE(CanUseColumnarCache({DT_STRING}, {PartialTensorShape({})},
+                                   &shapes));
+  EXPECT_FALSE(CanUseColumnarCache({DT_VARIANT}, {PartialTensorShape({})},
+                                   &shapes));
+}
+
+// The benchmarks below compare the columnar format with the tensor bundle
+// format, which CacheDataset used to store every cache, with the keys that it
+// uses. Each element is made of an int64 scalar and a float vector of
+// `vector_size` elements. The write benchmarks measure the first epoch of a
+// cached dataset and the read benchmarks the following ones.
+
+constexpr int kBenchmarkElements = 20000;
+
+std::vector<Tensor> BenchmarkElement(int64 i, int vector_size) {
+  Tensor vector(DT_FLOAT, TensorShape({vector_size}));
+  vector.flat<float>().setConstant(static_cast<float>(i));
+  return {test::AsScalar<int64>(i), vector};
+}
+
+string BundleKey(int64 element, int component) {
+  return strings::Printf("%07lld_%d", static_cast<long long>(element),
+                         component);
+}
+
+void WriteBundle(const string& prefix, int vector_size, int64* bytes) {
+  BundleWriter writer(Env::Default(), prefix);
+  for (int64 i = 0; i < kBenchmarkElements; ++i) {
+    const std::vector<Tensor> element = BenchmarkElement(i, vector_size);
+    for (int j = 0; j < element.size(); ++j) {
+      TF_CHECK_OK(writer.Add(BundleKey(i, j), element[j]));
+      *bytes += element[j].TotalBytes();
+    }
+  }
+  TF_CHECK_OK(writer.Finish());
+}
+
+void WriteColumnar(const string& prefix, int vector_size, int64* bytes) {
+  ColumnarCacheWriter writer(Env::Default(), prefix, {DT_INT64, DT_FLOAT},
+                             {TensorShape({}), TensorShape({vector_size})});
+  for (int64 i = 0; i < kBenchmarkElements; ++i) {
+    const std::vector<Tensor> element = BenchmarkElement(i, vector_size);
+    TF_CHECK_OK(writer.Add(element));
+    for (const Tensor& t : element) {
+      *bytes += t.TotalBytes();
+    }
+  }
+  TF_CHECK_OK(writer.Finish());
+}
+
+void BM_WriteBundle(int iters, int vector_size) {
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    WriteBundle(Prefix(strings::StrCat("bm_write_bundle_", i)), vector_size,
+                &bytes);
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_WriteBundle)->Arg(1)->Arg(256);
+
+void BM_WriteColumnar(int iters, int vector_size) {
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    WriteColumnar(Prefix(strings::StrCat("bm_write_columnar_", i)),
+                  vector_size, &bytes);
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_WriteColumnar)->Arg(1)->Arg(256);
+
+void BM_ReadBundle(int iters, int vector_size) {
+  testing::StopTiming();
+  const string prefix = Prefix(strings::StrCat("bm_read_bundle_", vector_size));
+  int64 unused_bytes = 0;
+  WriteBundle(prefix, vector_size, &unused_bytes);
+  testing::StartTiming();
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    BundleReader reader(Env::Default(), prefix);
+    reader.Next();  // Skips the header.
+    Tensor t;
+    while (reader.Valid()) {
+      TF_CHECK_OK(reader.ReadCurrent(&t));
+      bytes += t.TotalBytes();
+      reader.Next();
+    }
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_ReadBundle)->Arg(1)->Arg(256);
+
+void BM_ReadColumnar(int iters, int vector_size, bool use_mmap) {
+  testing::StopTiming();
+  const string prefix =
+      Prefix(strings::StrCat("bm_read_columnar_", vector_size));
+  int64 unused_bytes = 0;
+  WriteColumnar(prefix, vector_size, &unused_bytes);
+  testing::StartTiming();
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<ColumnarCacheReader> reader;
+    TF_CHECK_OK(ColumnarCacheReader::Open(Env::Default(), prefix, use_mmap,
+                                          &reader));
+    ColumnarCacheBlock block;
+    std::vector<Tensor> element;
+    for (int64 j = 0; j < reader->num_elements(); ++j) {
+      if (!block.Contains(j)) {
+        TF_CHECK_OK(reader->ReadBlock(reader->BlockIndex(j), &block));
+      }
+      block.GetElement(cpu_allocator(), j, &element);
+      for (const Tensor& t : element) {
+        bytes += t.TotalBytes();
+      }
+    }
+  }
+  testing::BytesProcessed(bytes);
+}
+
+void BM_ReadColumnarMmap(int iters, int vector_size) {
+  BM_ReadColumnar(iters, vector_size, /*use_mmap=*/true);
+}
+BENCHMARK(BM_ReadColumnarMmap)->Arg(1)->Arg(256);
+
+void BM_ReadColumnarFile(int iters, int vector_size) {
+  BM_ReadColumnar(iters, vector_size, /*use_mmap=*/false);
+}
+BENCHMARK(BM_ReadColumnarFile)->Arg(1)->Arg(256);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
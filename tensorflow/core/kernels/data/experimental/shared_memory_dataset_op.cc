@@ -0,0 +1,359 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/function_handle_cache.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/kernels/data/dataset_utils.h"
+#include "tensorflow/core/kernels/data/experimental/shared_memory_ring_buffer.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// Publishes the elements of a dataset in a shared memory buffer, from which
+// the `SharedMemoryDataset` ops of other processes on the host read them.
+class ToSharedMemoryOp : public AsyncOpKernel {
+ public:
+  explicit ToSharedMemoryOp(OpKernelConstruction* ctx)
+      : AsyncOpKernel(ctx),
+        background_worker_(ctx->env(), "tf_data_to_shared_memory") {}
+
+  template <typename T>
+  Status ParseScalarArgument(OpKernelContext* ctx,
+                             const StringPiece& argument_name, T* output) {
+    const Tensor* argument_t;
+    TF_RETURN_IF_ERROR(ctx->input(argument_name, &argument_t));
+    if (!TensorShapeUtils::IsScalar(argument_t->shape())) {
+      return errors::InvalidArgument(argument_name, " must be a scalar");
+    }
+    *output = argument_t->scalar<T>()();
+    return Status::OK();
+  }
+
+  void ComputeAsync(OpKernelContext* ctx, DoneCallback done) override {
+    // The call to `iterator->GetNext()` may block and depend on an inter-op
+    // thread pool thread, and publishing waits for the consumers, so we issue
+    // the calls using a background thread.
+    background_worker_.Schedule(std::bind(
+        [this, ctx](std::function<void()>& done) {
+          tstring buffer_name;
+          OP_REQUIRES_OK_ASYNC(
+              ctx,
+              ParseScalarArgument<tstring>(ctx, "buffer_name", &buffer_name),
+              done);
+          SharedMemoryRingBuffer::Options options;
+          OP_REQUIRES_OK_ASYNC(
+              ctx,
+              ParseScalarArgument<int64>(ctx, "num_consumers",
+                                         &options.num_consumers),
+              done);
+          OP_REQUIRES_OK_ASYNC(
+              ctx,
+              ParseScalarArgument<int64>(ctx, "num_slots", &options.num_slots),
+              done);
+          OP_REQUIRES_OK_ASYNC(ctx,
+                               ParseScalarArgument<int64>(
+                                   ctx, "slot_size_bytes",
+                                   &options.slot_size_bytes),
+                               done);
+
+          DatasetBase* dataset;
+          OP_REQUIRES_OK_ASYNC(
+              ctx, GetDatasetFromVariantTensor(ctx->input(0), &dataset), done);
+
+          std::shared_ptr<SharedMemoryRingBuffer> buffer;
+          OP_REQUIRES_OK_ASYNC(
+              ctx,
+              SharedMemoryRingBuffer::Create(buffer_name, options, &buffer),
+              done);
+
+          IteratorContext::Params params(ctx);
+          FunctionHandleCache function_handle_cache(params.flr);
+          params.function_handle_cache = &function_handle_cache;
+          ResourceMgr resource_mgr;
+          params.resource_mgr = &resource_mgr;
+          CancellationManager cancellation_manager;
+          params.cancellation_manager = &cancellation_manager;
+          std::function<void()> deregister_fn;
+          OP_REQUIRES_OK_ASYNC(ctx,
+                               ConnectCancellationManagers(
+                                   ctx->cancellation_manager(),
+                                   params.cancellation_manager, &deregister_fn),
+                               done);
+
+          // Update the `done` callback to deregister the cancellation callback.
+          done = std::bind(
+              [](const std::function<void()>& done,
+                 const std::function<void()>& deregister_fn) {
+                deregister_fn();
+                done();
+              },
+              std::move(done), std::move(deregister_fn));
+
+          auto is_cancelled = [&cancellation_manager]() {
+            return cancellation_manager.IsCancelled();
+          };
+
+          IteratorContext iter_ctx(std::move(params));
+          std::unique_ptr<IteratorBase> iterator;
+          Status s = dataset->MakeIterator(
+              &iter_ctx, "ToSharedMemoryOpIterator", &iterator);
+
+          // Update the `done` callback to destroy the iterator before calling
+          // the actual callback to avoid destruction races.
+          IteratorBase* raw_iterator = iterator.release();
+          done = std::bind(
+              [raw_iterator](const std::function<void()>& done) {
+                delete raw_iterator;
+                done();
+              },
+              std::move(done));
+
+          std::vector<Tensor> components;
+          components.reserve(dataset->output_dtypes().size());
+          bool end_of_sequence = false;
+          while (s.ok() && !end_of_sequence) {
+            s = raw_iterator->GetNext(&iter_ctx, &components,
+                                      &end_of_sequence);
+            if (s.ok() && !end_of_sequence) {
+              s = buffer->Publish(components, is_cancelled);
+            }
+            components.clear();
+          }
+          // Consumers report the errors of the input pipeline, and the buffer
+          // must outlive the elements they are reading.
+          buffer->Finish(s);
+          Status wait_status = buffer->WaitForConsumers(is_cancelled);
+          OP_REQUIRES_OK_ASYNC(ctx, s, done);
+          OP_REQUIRES_OK_ASYNC(ctx, wait_status, done);
+          done();
+        },
+        std::move(done)));
+  }
+
+ private:
+  BackgroundWorker background_worker_;
+};
+
+// Reads the elements published by a `DatasetToSharedMemory` op, which
+// typically runs in another process on the same host.
+class SharedMemoryDatasetOp : public DatasetOpKernel {
+ public:
+  explicit SharedMemoryDatasetOp(OpKernelConstruction* ctx)
+      : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("output_types", &output_types_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("output_shapes", &output_shapes_));
+  }
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
+    tstring buffer_name;
+    OP_REQUIRES_OK(
+        ctx, ParseScalarArgument<tstring>(ctx, "buffer_name", &buffer_name));
+    int64 consumer_index;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "consumer_index",
+                                                   &consumer_index));
+    OP_REQUIRES(ctx, consumer_index >= 0,
+                errors::InvalidArgument("`consumer_index` must be >= 0"));
+    int64 timeout_ms;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument<int64>(ctx, "timeout_ms", &timeout_ms));
+
+    *output = new Dataset(ctx, buffer_name, consumer_index, timeout_ms,
+                          output_types_, output_shapes_);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, const string& buffer_name,
+            int64 consumer_index, int64 timeout_ms,
+            const DataTypeVector& output_types,
+            const std::vector<PartialTensorShape>& output_shapes)
+        : DatasetBase(DatasetContext(ctx)),
+          buffer_name_(buffer_name),
+          consumer_index_(consumer_index),
+          timeout_ms_(timeout_ms),
+          output_types_(output_types),
+          output_shapes_(output_shapes) {}
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return absl::make_unique<Iterator>(
+          Iterator::Params{this, strings::StrCat(prefix, "::SharedMemory")});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      return output_types_;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return output_shapes_;
+    }
+
+    string DebugString() const override {
+      return "SharedMemoryDatasetOp::Dataset";
+    }
+
+    Status CheckExternalState() const override {
+      return errors::FailedPrecondition(
+          DebugString(), " depends on a shared memory buffer written by ",
+          "another process.");
+    }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* buffer_name = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(buffer_name_, &buffer_name));
+      Node* consumer_index = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(consumer_index_, &consumer_index));
+      Node* timeout_ms = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(timeout_ms_, &timeout_ms));
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this, {buffer_name, consumer_index, timeout_ms}, output));
+      return Status::OK();
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params) {}
+
+      ~Iterator() override {
+        if (buffer_) {
+          buffer_->Detach(dataset()->consumer_index_);
+        }
+      }
+
+      Status Initialize(IteratorContext* ctx) override {
+        CancellationManager* cancellation_manager = ctx->cancellation_manager();
+        const int64 timeout_micros =
+            dataset()->timeout_ms_ < 0 ? -1 : dataset()->timeout_ms_ * 1000;
+        std::shared_ptr<SharedMemoryRingBuffer> buffer;
+        TF_RETURN_IF_ERROR(SharedMemoryRingBuffer::Open(
+            dataset()->buffer_name_, timeout_micros,
+            [cancellation_manager]() {
+              return cancellation_manager &&
+                     cancellation_manager->IsCancelled();
+            },
+            &buffer));
+        TF_RETURN_IF_ERROR(buffer->Attach(dataset()->consumer_index_));
+        mutex_lock l(mu_);
+        buffer_ = std::move(buffer);
+        return Status::OK();
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (end_of_sequence_) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        CancellationManager* cancellation_manager = ctx->cancellation_manager();
+        TF_RETURN_IF_ERROR(buffer_->Read(
+            dataset()->consumer_index_, num_read_,
+            [cancellation_manager]() {
+              return cancellation_manager &&
+                     cancellation_manager->IsCancelled();
+            },
+            out_tensors, &end_of_sequence_));
+        *end_of_sequence = end_of_sequence_;
+        if (end_of_sequence_) {
+          return Status::OK();
+        }
+        ++num_read_;
+        return CheckElement(*out_tensors);
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeSourceNode(std::move(args));
+      }
+
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        return errors::Unimplemented(
+            "Checkpointing is currently not supported for "
+            "SharedMemoryDataset.");
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        return errors::Unimplemented(
+            "Checkpointing is currently not supported for "
+            "SharedMemoryDataset.");
+      }
+
+     private:
+      // Checks that the producer publishes the elements the dataset expects.
+      Status CheckElement(const std::vector<Tensor>& element) const {
+        const DataTypeVector& dtypes = dataset()->output_types_;
+        const std::vector<PartialTensorShape>& shapes =
+            dataset()->output_shapes_;
+        if (element.size() != dtypes.size()) {
+          return errors::InvalidArgument(
+              "Expected elements with ", dtypes.size(),
+              " components from the shared memory buffer ",
+              dataset()->buffer_name_, ", got ", element.size());
+        }
+        for (int i = 0; i < element.size(); ++i) {
+          if (element[i].dtype() != dtypes[i] ||
+              !shapes[i].IsCompatibleWith(element[i].shape())) {
+            return errors::InvalidArgument(
+                "Expected component ", i, " of the elements of the shared "
+                "memory buffer ", dataset()->buffer_name_, " to be a ",
+                DataTypeString(dtypes[i]), " tensor of shape ",
+                shapes[i].DebugString(), ", got a ",
+                DataTypeString(element[i].dtype()), " tensor of shape ",
+                element[i].shape().DebugString());
+          }
+        }
+        return Status::OK();
+      }
+
+      mutex mu_;
+      std::shared_ptr<SharedMemoryRingBuffer> buffer_ GUARDED_BY(mu_);
+      int64 num_read_ GUARDED_BY(mu_) = 0;
+      bool end_of_sequence_ GUARDED_BY(mu_) = false;
+    };
+
+    const string buffer_name_;
+    const int64 consumer_index_;
+    const int64 timeout_ms_;
+    const DataTypeVector output_types_;
+    const std::vector<PartialTensorShape> output_shapes_;
+  };
+
+  DataTypeVector output_types_;
+  std::vector<PartialTensorShape> output_shapes_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("DatasetToSharedMemory").Device(DEVICE_CPU),
+                        ToSharedMemoryOp);
+REGISTER_KERNEL_BUILDER(Name("SharedMemoryDataset").Device(DEVICE_CPU),
+                        SharedMemoryDatasetOp);
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,790 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/shared_memory_ring_buffer.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !PLATFORM_WINDOWS
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory synchronization requires lock-free atomics.");
+
+constexpr uint64 kMagic = 0x7466646174617368;  // "tfdatash"
+constexpr int32 kVersion = 3;
+// The header, the consumer states, the leases, the element slots, the slots and
+// the tensor contents within a slot start at multiples of this offset.
+constexpr int64 kAlignment = 64;
+constexpr int64 kMaxErrorMessageBytes = 1024;
+constexpr int64 kMaxNameLength = 200;
+// The number of elements read by a consumer that has detached.
+constexpr uint64 kDetached = std::numeric_limits<uint64>::max();
+
+enum FinishState : int32 { kNotFinished = 0, kFinishedOk = 1, kFinishedError };
+
+int64 RoundUp(int64 n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Waits for `done` to return true, polling with an increasing backoff since
+// the processes sharing a buffer cannot share a condition variable.
+Status WaitUntil(const std::function<bool()>& done,
+                 const SharedMemoryRingBuffer::CancelledFn& is_cancelled,
+                 int64 deadline_micros = kint64max) {
+  int64 backoff_micros = 0;
+  while (!done()) {
+    if (is_cancelled && is_cancelled()) {
+      return errors::Cancelled("Cancelled waiting for a shared memory buffer.");
+    }
+    if (Env::Default()->NowMicros() > deadline_micros) {
+      return errors::DeadlineExceeded(
+          "Timed out waiting for a shared memory buffer.");
+    }
+    if (backoff_micros == 0) {
+      backoff_micros = 1;
+      continue;
+    }
+    Env::Default()->SleepForMicroseconds(backoff_micros);
+    backoff_micros = std::min<int64>(2 * backoff_micros, 1000);
+  }
+  return Status::OK();
+}
+
+Status ValidateName(const string& name) {
+  if (name.empty() || name.size() > kMaxNameLength ||
+      name.find('/') != string::npos) {
+    return errors::InvalidArgument(
+        "Invalid shared memory buffer name \"", name,
+        "\": names must be non-empty, have at most ", kMaxNameLength,
+        " characters and must not contain '/'.");
+  }
+  return Status::OK();
+}
+
+string SegmentName(const string& name) {
+  return strings::StrCat("/tf_data_", name);
+}
+
+#if !defined(PLATFORM_WINDOWS)
+
+Status IOError(const string& context, const string& name) {
+  return errors::Internal(context, " of the shared memory buffer ", name,
+                          " failed: ", strerror(errno));
+}
+
+#endif  // !PLATFORM_WINDOWS
+
+// Returns false if the process `pid` is known to have exited. A process that
+// has exited but has not been reaped by its parent still counts as alive.
+bool ProcessIsAlive(int64 pid) {
+#if defined(PLATFORM_WINDOWS)
+  return true;
+#else
+  return pid == 0 || kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif  // PLATFORM_WINDOWS
+}
+
+}  // namespace
+
+// The header at the start of the segment (see `SegmentSize()` for the rest).
+struct SharedMemoryRingBuffer::Header {
+  // Set to `kMagic` once the rest of the header is initialized.
+  std::atomic<uint64> magic;
+  int32 version;
+  int64 num_consumers;
+  int64 num_slots;
+  int64 slot_size;
+  // The number of elements the producer has written.
+  std::atomic<uint64> num_published;
+  std::atomic<int32> finished;
+  int32 error_code;
+  char error_message[kMaxErrorMessageBytes];
+};
+
+// The number of elements a consumer has read, on its own cache line since each
+// consumer updates it concurrently.
+struct SharedMemoryRingBuffer::ConsumerState {
+  alignas(kAlignment) std::atomic<uint64> num_read;
+  std::atomic<int32> attached;
+  // The process that attached the consumer, so that the producer can detach
+  // it if the process exits without detaching.
+  std::atomic<int64> pid;
+};
+
+// Keeps the slot of an element from being reused while the element is parsed
+// and, if they point into the slot, until its tensors are all destroyed.
+class SharedMemoryRingBuffer::Lease {
+ public:
+  Lease(std::shared_ptr<SharedMemoryRingBuffer> buffer, int64 consumer_index,
+        int64 slot_index, bool held)
+      : buffer_(std::move(buffer)),
+        consumer_index_(consumer_index),
+        slot_index_(slot_index),
+        held_(held) {}
+
+  ~Lease() { buffer_->Release(consumer_index_, slot_index_, held_); }
+
+ private:
+  // Keeps the segment mapped while the tensors are alive.
+  const std::shared_ptr<SharedMemoryRingBuffer> buffer_;
+  const int64 consumer_index_;
+  const int64 slot_index_;
+  const bool held_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Lease);
+};
+
+// The buffer of a tensor that points into a slot.
+class SharedMemoryRingBuffer::ElementBuffer : public TensorBuffer {
+ public:
+  ElementBuffer(void* data, size_t size, std::shared_ptr<Lease> lease)
+      : TensorBuffer(data), size_(size), lease_(std::move(lease)) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("shared_memory");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const size_t size_;
+  const std::shared_ptr<Lease> lease_;
+};
+
+SharedMemoryRingBuffer::SharedMemoryRingBuffer(const string& name,
+                                               bool is_producer, int fd,
+                                               char* base, size_t size)
+    : name_(name),
+      is_producer_(is_producer),
+      fd_(fd),
+      base_(base),
+      size_(size) {}
+
+SharedMemoryRingBuffer::~SharedMemoryRingBuffer() {
+#if !defined(PLATFORM_WINDOWS)
+  munmap(base_, size_);
+  close(fd_);
+  if (is_producer_) {
+    // Consumers that still have the segment mapped keep using it.
+    shm_unlink(SegmentName(name_).c_str());
+  }
+#endif  // !PLATFORM_WINDOWS
+}
+
+Status SharedMemoryRingBuffer::Map(
+    const string& name, bool is_producer, int fd, size_t size,
+    std::shared_ptr<SharedMemoryRingBuffer>* buffer) {
+#if defined(PLATFORM_WINDOWS)
+  return errors::Unimplemented(
+      "Shared memory buffers are not supported on Windows.");
+#else
+  void* base =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, /*offset=*/0);
+  if (base == MAP_FAILED) {
+    Status s = IOError("Mapping", name);
+    close(fd);
+    if (is_producer) {
+      shm_unlink(SegmentName(name).c_str());
+    }
+    return s;
+  }
+  buffer->reset(new SharedMemoryRingBuffer(name, is_producer, fd,
+                                           static_cast<char*>(base), size));
+  return Status::OK();
+#endif  // PLATFORM_WINDOWS
+}
+
+Status SharedMemoryRingBuffer::Create(
+    const string& name, const Options& options,
+    std::shared_ptr<SharedMemoryRingBuffer>* buffer) {
+  TF_RETURN_IF_ERROR(ValidateName(name));
+  if (options.num_consumers <= 0) {
+    return errors::InvalidArgument("num_consumers must be positive, got ",
+                                   options.num_consumers);
+  }
+  if (options.num_slots <= 0) {
+    return errors::InvalidArgument("num_slots must be positive, got ",
+                                   options.num_slots);
+  }
+  if (options.slot_size_bytes <= 0) {
+    return errors::InvalidArgument("slot_size_bytes must be positive, got ",
+                                   options.slot_size_bytes);
+  }
+  const int64 slot_size = RoundUp(options.slot_size_bytes);
+  const int64 size =
+      SegmentSize(options.num_consumers, options.num_slots, slot_size);
+#if defined(PLATFORM_WINDOWS)
+  return errors::Unimplemented(
+      "Shared memory buffers are not supported on Windows.");
+#else
+  const string segment_name = SegmentName(name);
+  // A segment with the same name is left by a producer that did not finish,
+  // e.g. because its process was killed.
+  shm_unlink(segment_name.c_str());
+  int fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    return IOError("Creation", name);
+  }
+  if (ftruncate(fd, size) != 0) {
+    Status s = IOError("Resizing", name);
+    close(fd);
+    shm_unlink(segment_name.c_str());
+    return s;
+  }
+  TF_RETURN_IF_ERROR(Map(name, /*is_producer=*/true, fd, size, buffer));
+#endif  // PLATFORM_WINDOWS
+
+  SharedMemoryRingBuffer* b = buffer->get();
+  Header* header = new (b->base_) Header();
+  header->version = kVersion;
+  header->num_consumers = options.num_consumers;
+  header->num_slots = options.num_slots;
+  header->slot_size = slot_size;
+  header->num_published.store(0);
+  header->finished.store(kNotFinished);
+  for (int64 i = 0; i < options.num_consumers; ++i) {
+    ConsumerState* state = new (b->consumer(i)) ConsumerState();
+    state->num_read.store(0);
+    state->attached.store(0);
+    state->pid.store(0);
+    for (int64 j = 0; j < options.num_slots; ++j) {
+      new (b->leases(i) + j) std::atomic<int32>(0);
+    }
+  }
+  for (int64 i = 0; i < options.num_slots; ++i) {
+    new (b->element_slot(i)) std::atomic<int64>(-1);
+  }
+  b->slot_elements_.assign(options.num_slots, -1);
+  // Consumers only read the header once the magic number is visible.
+  header->magic.store(kMagic, std::memory_order_release);
+  return Status::OK();
+}
+
+Status SharedMemoryRingBuffer::Open(
+    const string& name, int64 timeout_micros, const CancelledFn& is_cancelled,
+    std::shared_ptr<SharedMemoryRingBuffer>* buffer) {
+  TF_RETURN_IF_ERROR(ValidateName(name));
+#if defined(PLATFORM_WINDOWS)
+  return errors::Unimplemented(
+      "Shared memory buffers are not supported on Windows.");
+#else
+  const int64 deadline_micros =
+      timeout_micros < 0 ? kint64max
+                         : Env::Default()->NowMicros() + timeout_micros;
+  const string segment_name = SegmentName(name);
+  int fd = -1;
+  struct stat st;
+  // The producer sizes the segment right after creating it.
+  Status s = WaitUntil(
+      [&]() {
+        if (fd < 0) {
+          fd = shm_open(segment_name.c_str(), O_RDWR, 0600);
+          if (fd < 0) return false;
+        }
+        return fstat(fd, &st) == 0 && st.st_size >= RoundUp(sizeof(Header));
+      },
+      is_cancelled, deadline_micros);
+  if (!s.ok()) {
+    if (fd >= 0) close(fd);
+    if (errors::IsDeadlineExceeded(s)) {
+      return errors::DeadlineExceeded("Timed out waiting for a producer to "
+                                      "create the shared memory buffer ",
+                                      name);
+    }
+    return s;
+  }
+  TF_RETURN_IF_ERROR(
+      Map(name, /*is_producer=*/false, fd, st.st_size, buffer));
+#endif  // PLATFORM_WINDOWS
+
+  SharedMemoryRingBuffer* b = buffer->get();
+  Header* header = b->header();
+  s = WaitUntil(
+      [header]() {
+        return header->magic.load(std::memory_order_acquire) == kMagic;
+      },
+      is_cancelled, deadline_micros);
+  if (!s.ok()) {
+    buffer->reset();
+    return s;
+  }
+  if (header->version != kVersion) {
+    buffer->reset();
+    return errors::Unimplemented("Unsupported version ", header->version,
+                                 " of the shared memory buffer ", name);
+  }
+  if (header->num_consumers <= 0 || header->num_slots <= 0 ||
+      header->slot_size <= 0 ||
+      SegmentSize(header->num_consumers, header->num_slots,
+                  header->slot_size) != b->size_) {
+    buffer->reset();
+    return errors::DataLoss("Corrupted header of the shared memory buffer ",
+                            name);
+  }
+  mutex_lock l(b->mu_);
+  b->local_consumers_.resize(header->num_consumers);
+  // Keep at least one slot that no consumer holds, so that the producer can
+  // publish the element that the consumers wait for.
+  b->max_held_ = (header->num_slots - 1) / header->num_consumers;
+  return Status::OK();
+}
+
+int64 SharedMemoryRingBuffer::SegmentSize(int64 num_consumers,
+                                          int64 num_slots, int64 slot_size) {
+  const int64 leases_offset =
+      RoundUp(sizeof(Header)) + num_consumers * sizeof(ConsumerState);
+  const int64 element_slots_offset = RoundUp(
+      leases_offset + num_consumers * num_slots * sizeof(std::atomic<int32>));
+  const int64 slots_offset = RoundUp(element_slots_offset +
+                                     num_slots * sizeof(std::atomic<int64>));
+  return slots_offset + num_slots * slot_size;
+}
+
+SharedMemoryRingBuffer::Header* SharedMemoryRingBuffer::header() const {
+  return reinterpret_cast<Header*>(base_);
+}
+
+SharedMemoryRingBuffer::ConsumerState* SharedMemoryRingBuffer::consumer(
+    int64 consumer_index) const {
+  return reinterpret_cast<ConsumerState*>(base_ + RoundUp(sizeof(Header))) +
+         consumer_index;
+}
+
+std::atomic<int32>* SharedMemoryRingBuffer::leases(
+    int64 consumer_index) const {
+  return reinterpret_cast<std::atomic<int32>*>(
+             consumer(header()->num_consumers)) +
+         consumer_index * header()->num_slots;
+}
+
+// The slot of element `element_index`, which is kept until element
+// `element_index + num_slots` is published.
+std::atomic<int64>* SharedMemoryRingBuffer::element_slot(
+    int64 element_index) const {
+  const Header* h = header();
+  char* element_slots = base_ + RoundUp(reinterpret_cast<char*>(
+                                            leases(h->num_consumers)) -
+                                        base_);
+  return reinterpret_cast<std::atomic<int64>*>(element_slots) +
+         element_index % h->num_slots;
+}
+
+char* SharedMemoryRingBuffer::slot(int64 slot_index) const {
+  const Header* h = header();
+  char* slots = base_ + RoundUp(reinterpret_cast<char*>(
+                                    element_slot(0) + h->num_slots) -
+                                base_);
+  return slots + slot_index * h->slot_size;
+}
+
+int64 SharedMemoryRingBuffer::num_consumers() const {
+  return header()->num_consumers;
+}
+
+uint64 SharedMemoryRingBuffer::MinRead() const {
+  uint64 result = kDetached;
+  for (int64 i = 0; i < header()->num_consumers; ++i) {
+    result =
+        std::min(result, consumer(i)->num_read.load(std::memory_order_acquire));
+  }
+  return result;
+}
+
+int64 SharedMemoryRingBuffer::FindFreeSlot() {
+  const Header* h = header();
+  const uint64 min_read = MinRead();
+  for (int64 i = 0; i < h->num_slots; ++i) {
+    const int64 slot_index = (next_slot_ + i) % h->num_slots;
+    const int64 element_index = slot_elements_[slot_index];
+    if (element_index >= 0 && static_cast<uint64>(element_index) >= min_read) {
+      continue;
+    }
+    bool leased = false;
+    for (int64 c = 0; c < h->num_consumers && !leased; ++c) {
+      leased = leases(c)[slot_index].load(std::memory_order_acquire) > 0;
+    }
+    if (!leased) {
+      return slot_index;
+    }
+  }
+  return -1;
+}
+
+void SharedMemoryRingBuffer::DetachExitedConsumers() {
+  for (int64 i = 0; i < header()->num_consumers; ++i) {
+    ConsumerState* state = consumer(i);
+    if (state->attached.load(std::memory_order_acquire) == 0 ||
+        ProcessIsAlive(state->pid.load(std::memory_order_acquire))) {
+      continue;
+    }
+    if (state->num_read.exchange(kDetached) != kDetached) {
+      LOG(WARNING) << "Consumer " << i << " of the shared memory buffer "
+                   << name_ << " exited without detaching.";
+    }
+    for (int64 j = 0; j < header()->num_slots; ++j) {
+      leases(i)[j].store(0, std::memory_order_release);
+    }
+  }
+}
+
+Status SharedMemoryRingBuffer::WaitForConsumersTo(
+    const std::function<bool()>& done, const CancelledFn& is_cancelled) {
+  // Only check whether the consumers are alive while waiting for them.
+  return WaitUntil(
+      [this, &done]() {
+        if (done()) return true;
+        DetachExitedConsumers();
+        return done();
+      },
+      is_cancelled);
+}
+
+// A slot starts with a header of int64 values: the number of components and,
+// for each component, its type, rank, dimensions, and the offset and size of
+// its contents in the slot. Strings are stored as their lengths, as uint64
+// values, followed by their bytes.
+Status SharedMemoryRingBuffer::Publish(const std::vector<Tensor>& element,
+                                       const CancelledFn& is_cancelled) {
+  DCHECK(is_producer_);
+  Header* h = header();
+  const uint64 index = h->num_published.load(std::memory_order_relaxed);
+  const uint64 num_slots = h->num_slots;
+  int64 slot_index = -1;
+  TF_RETURN_IF_ERROR(WaitForConsumersTo(
+      [this, index, num_slots, &slot_index]() {
+        // Element `index` replaces element `index - num_slots` in the element
+        // slots, which every consumer must have read.
+        if (index >= num_slots && MinRead() <= index - num_slots) {
+          return false;
+        }
+        slot_index = FindFreeSlot();
+        return slot_index >= 0;
+      },
+      is_cancelled));
+
+  std::vector<int64> slot_header = {static_cast<int64>(element.size())};
+  std::vector<int64> num_bytes(element.size());
+  for (int i = 0; i < element.size(); ++i) {
+    const Tensor& t = element[i];
+    if (t.dtype() == DT_STRING) {
+      const auto strings = t.flat<tstring>();
+      num_bytes[i] = strings.size() * sizeof(uint64);
+      for (int64 j = 0; j < strings.size(); ++j) {
+        num_bytes[i] += strings(j).size();
+      }
+    } else if (DataTypeCanUseMemcpy(t.dtype())) {
+      num_bytes[i] = t.TotalBytes();
+    } else {
+      return errors::InvalidArgument(
+          "Shared memory buffers cannot store tensors of type ",
+          DataTypeString(t.dtype()));
+    }
+    slot_header.push_back(t.dtype());
+    slot_header.push_back(t.dims());
+    for (int d = 0; d < t.dims(); ++d) {
+      slot_header.push_back(t.dim_size(d));
+    }
+    // The offset is filled in below.
+    slot_header.push_back(0);
+    slot_header.push_back(num_bytes[i]);
+  }
+  int64 offset = RoundUp(slot_header.size() * sizeof(int64));
+  for (int i = 0, pos = 1; i < element.size(); ++i) {
+    pos += 2 + element[i].dims();
+    slot_header[pos] = offset;
+    offset = RoundUp(offset + num_bytes[i]);
+    pos += 2;
+  }
+  if (offset > h->slot_size) {
+    return errors::InvalidArgument(
+        "An element of ", offset, " bytes does not fit in the ", h->slot_size,
+        " byte slots of the shared memory buffer ", name_,
+        ". Use larger slots.");
+  }
+
+  char* s = slot(slot_index);
+  std::memcpy(s, slot_header.data(), slot_header.size() * sizeof(int64));
+  for (int i = 0, pos = 1; i < element.size(); ++i) {
+    pos += 2 + element[i].dims();
+    char* data = s + slot_header[pos];
+    pos += 2;
+    const Tensor& t = element[i];
+    if (t.dtype() == DT_STRING) {
+      const auto strings = t.flat<tstring>();
+      for (int64 j = 0; j < strings.size(); ++j) {
+        const uint64 length = strings(j).size();
+        std::memcpy(data, &length, sizeof(length));
+        data += sizeof(length);
+      }
+      for (int64 j = 0; j < strings.size(); ++j) {
+        std::memcpy(data, strings(j).data(), strings(j).size());
+        data += strings(j).size();
+      }
+    } else if (num_bytes[i] > 0) {
+      std::memcpy(data, t.tensor_data().data(), num_bytes[i]);
+    }
+  }
+  slot_elements_[slot_index] = index;
+  next_slot_ = (slot_index + 1) % num_slots;
+  element_slot(index)->store(slot_index, std::memory_order_relaxed);
+  h->num_published.store(index + 1, std::memory_order_release);
+  return Status::OK();
+}
+
+void SharedMemoryRingBuffer::Finish(const Status& status) {
+  DCHECK(is_producer_);
+  Header* h = header();
+  if (status.ok()) {
+    h->finished.store(kFinishedOk, std::memory_order_release);
+    return;
+  }
+  h->error_code = status.code();
+  const string& message = status.error_message();
+  const size_t length =
+      std::min<size_t>(message.size(), kMaxErrorMessageBytes - 1);
+  std::memcpy(h->error_message, message.data(), length);
+  h->error_message[length] = '\0';
+  h->finished.store(kFinishedError, std::memory_order_release);
+}
+
+Status SharedMemoryRingBuffer::WaitForConsumers(
+    const CancelledFn& is_cancelled) {
+  DCHECK(is_producer_);
+  const uint64 num_published = header()->num_published.load();
+  return WaitForConsumersTo(
+      [this, num_published]() {
+        if (MinRead() < num_published) return false;
+        for (int64 c = 0; c < header()->num_consumers; ++c) {
+          for (int64 j = 0; j < header()->num_slots; ++j) {
+            if (leases(c)[j].load(std::memory_order_acquire) > 0) return false;
+          }
+        }
+        return true;
+      },
+      is_cancelled);
+}
+
+Status SharedMemoryRingBuffer::Attach(int64 consumer_index) {
+  DCHECK(!is_producer_);
+  if (consumer_index < 0 || consumer_index >= header()->num_consumers) {
+    return errors::InvalidArgument("Consumer index ", consumer_index,
+                                   " is out of range for the ",
+                                   header()->num_consumers,
+                                   " consumers of the shared memory buffer ",
+                                   name_);
+  }
+  ConsumerState* state = consumer(consumer_index);
+  int32 expected = 0;
+  if (!state->attached.compare_exchange_strong(expected, 1)) {
+    return errors::AlreadyExists("Consumer ", consumer_index,
+                                 " of the shared memory buffer ", name_,
+                                 " is already attached.");
+  }
+#if !defined(PLATFORM_WINDOWS)
+  // Until then, the producer considers the consumer alive.
+  state->pid.store(getpid(), std::memory_order_release);
+#endif  // !PLATFORM_WINDOWS
+  mutex_lock l(mu_);
+  local_consumers_[consumer_index].attached = true;
+  return Status::OK();
+}
+
+void SharedMemoryRingBuffer::Detach(int64 consumer_index) {
+  mutex_lock l(mu_);
+  LocalConsumer& local = local_consumers_[consumer_index];
+  if (!local.attached || local.detached) return;
+  local.detached = true;
+  // The slots of the elements that were read stay leased until their tensors
+  // are destroyed.
+  consumer(consumer_index)
+      ->num_read.store(kDetached, std::memory_order_release);
+}
+
+void SharedMemoryRingBuffer::Release(int64 consumer_index, int64 slot_index,
+                                     bool held) {
+  // Orders the reads of the slot before the producer reuses it.
+  leases(consumer_index)[slot_index].fetch_sub(1, std::memory_order_release);
+  if (held) {
+    mutex_lock l(mu_);
+    --local_consumers_[consumer_index].num_held;
+  }
+}
+
+Status SharedMemoryRingBuffer::Read(int64 consumer_index, int64 element_index,
+                                    const CancelledFn& is_cancelled,
+                                    std::vector<Tensor>* element,
+                                    bool* end_of_sequence) {
+  DCHECK(!is_producer_);
+  {
+    mutex_lock l(mu_);
+    const LocalConsumer& local = local_consumers_[consumer_index];
+    if (!local.attached || local.detached) {
+      return errors::FailedPrecondition("Consumer ", consumer_index,
+                                        " is not attached to the shared "
+                                        "memory buffer ",
+                                        name_);
+    }
+    if (element_index != local.num_read) {
+      return errors::InvalidArgument("Expected to read element ",
+                                     local.num_read, ", got ", element_index);
+    }
+  }
+  Header* h = header();
+  TF_RETURN_IF_ERROR(WaitUntil(
+      [h, element_index]() {
+        return h->num_published.load(std::memory_order_acquire) >
+                   element_index ||
+               h->finished.load(std::memory_order_acquire) != kNotFinished;
+      },
+      is_cancelled));
+  // The producer may have published more elements before finishing.
+  if (h->num_published.load(std::memory_order_acquire) <= element_index) {
+    if (h->finished.load(std::memory_order_acquire) == kFinishedError) {
+      return Status(static_cast<error::Code>(h->error_code),
+                    h->error_message);
+    }
+    *end_of_sequence = true;
+    return Status::OK();
+  }
+  *end_of_sequence = false;
+
+  auto corrupted = [this, element_index]() {
+    return errors::DataLoss("Corrupted element ", element_index,
+                            " in the shared memory buffer ", name_);
+  };
+  // Ordered after the load of `num_published` above.
+  const int64 slot_index =
+      element_slot(element_index)->load(std::memory_order_relaxed);
+  if (slot_index < 0 || slot_index >= h->num_slots) {
+    return corrupted();
+  }
+  // Lease the slot before reporting the element as read, since the producer
+  // may reuse the slot of an element that every consumer has read.
+  std::shared_ptr<Lease> lease;
+  bool held;
+  {
+    mutex_lock l(mu_);
+    LocalConsumer& local = local_consumers_[consumer_index];
+    if (local.detached) {
+      return errors::FailedPrecondition("Consumer ", consumer_index,
+                                        " is not attached to the shared "
+                                        "memory buffer ",
+                                        name_);
+    }
+    held = local.num_held < max_held_;
+    if (held) {
+      ++local.num_held;
+    }
+    leases(consumer_index)[slot_index].fetch_add(1, std::memory_order_relaxed);
+    lease = std::make_shared<Lease>(shared_from_this(), consumer_index,
+                                    slot_index, held);
+    ++local.num_read;
+    consumer(consumer_index)
+        ->num_read.store(local.num_read, std::memory_order_release);
+  }
+  char* s = slot(slot_index);
+  const int64* slot_header = reinterpret_cast<const int64*>(s);
+  const int64 slot_size = h->slot_size;
+  const int64 max_header_values = slot_size / sizeof(int64);
+  int64 pos = 0;
+  const int64 num_components = slot_header[pos++];
+  if (num_components < 0 || num_components > max_header_values) {
+    return corrupted();
+  }
+  element->clear();
+  element->reserve(num_components);
+  for (int64 i = 0; i < num_components; ++i) {
+    if (pos + 2 > max_header_values) return corrupted();
+    const DataType dtype = static_cast<DataType>(slot_header[pos++]);
+    const int64 rank = slot_header[pos++];
+    if (rank < 0 || pos + rank + 2 > max_header_values) return corrupted();
+    TensorShape shape;
+    if (!TensorShapeUtils::MakeShape(slot_header + pos, rank, &shape).ok()) {
+      return corrupted();
+    }
+    pos += rank;
+    const int64 offset = slot_header[pos++];
+    const int64 num_bytes = slot_header[pos++];
+    if (offset < 0 || num_bytes < 0 || offset + num_bytes > slot_size) {
+      return corrupted();
+    }
+    char* data = s + offset;
+    if (dtype == DT_STRING) {
+      const int64 n = shape.num_elements();
+      if (n * static_cast<int64>(sizeof(uint64)) > num_bytes) {
+        return corrupted();
+      }
+      Tensor t(DT_STRING, shape);
+      auto strings = t.flat<tstring>();
+      const char* contents = data + n * sizeof(uint64);
+      const char* end = data + num_bytes;
+      for (int64 j = 0; j < n; ++j) {
+        uint64 length;
+        std::memcpy(&length, data + j * sizeof(uint64), sizeof(length));
+        if (length > end - contents) return corrupted();
+        strings(j).assign(contents, length);
+        contents += length;
+      }
+      element->push_back(std::move(t));
+    } else if (DataTypeCanUseMemcpy(dtype)) {
+      if (shape.num_elements() * DataTypeSize(dtype) != num_bytes) {
+        return corrupted();
+      }
+      if (!held) {
+        // The slot is released once the element is parsed.
+        Tensor t(dtype, shape);
+        if (num_bytes > 0) {
+          std::memcpy(const_cast<char*>(t.tensor_data().data()), data,
+                      num_bytes);
+        }
+        element->push_back(std::move(t));
+        continue;
+      }
+      ElementBuffer* buffer = new ElementBuffer(data, num_bytes, lease);
+      element->emplace_back(dtype, shape, buffer);
+      buffer->Unref();
+    } else {
+      return corrupted();
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
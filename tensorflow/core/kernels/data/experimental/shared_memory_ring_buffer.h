@@ -0,0 +1,192 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_EXPERIMENTAL_SHARED_MEMORY_RING_BUFFER_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_EXPERIMENTAL_SHARED_MEMORY_RING_BUFFER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+
+// A ring buffer of dataset elements in a shared memory segment, which lets
+// one process publish the elements of an input pipeline to the other processes
+// of the host, e.g. the replicas of a model that consume the same data.
+//
+// The buffer has a single producer and a fixed number of consumers, each of
+// which reads every element in order. An element is copied once into a free
+// slot by the producer. Consumers build tensors that point into the slot,
+// except for strings, which are copied, and the slot is free again once every
+// consumer has read the element and destroyed all the tensors built from it.
+// So that consumers holding many elements at once, e.g. to batch or shuffle
+// them, never pin every slot, each consumer holds at most
+// (num_slots - 1) / num_consumers elements in their slots, and copies the
+// elements it reads past that limit.
+//
+// Processes synchronize through atomics in the segment and wait by polling,
+// so a process that dies never leaves a lock held. While the producer waits
+// for consumers, it detaches those whose process has exited, which requires
+// the processes to share a PID namespace. Shared memory is only supported on
+// POSIX platforms.
+class SharedMemoryRingBuffer
+    : public std::enable_shared_from_this<SharedMemoryRingBuffer> {
+ public:
+  struct Options {
+    // The number of consumers, which read the buffer with the indices
+    // 0, ..., num_consumers - 1.
+    int64 num_consumers = 1;
+    // The number of elements the buffer holds.
+    int64 num_slots = 16;
+    // The maximum size in bytes of an element, including a small header.
+    int64 slot_size_bytes = 16 << 20;  // 16MB
+  };
+
+  // Returns true if the caller should stop waiting for other processes.
+  using CancelledFn = std::function<bool()>;
+
+  ~SharedMemoryRingBuffer();
+
+  // Creates the buffer `name` for a producer, replacing any buffer left with
+  // the same name by a producer that did not finish. The segment is removed
+  // when the producer's buffer is destroyed, but stays mapped in the consumers
+  // that opened it.
+  static Status Create(const string& name, const Options& options,
+                       std::shared_ptr<SharedMemoryRingBuffer>* buffer);
+
+  // Opens the buffer `name` for a consumer, waiting up to `timeout_micros` for
+  // a producer to create it.
+  static Status Open(const string& name, int64 timeout_micros,
+                     const CancelledFn& is_cancelled,
+                     std::shared_ptr<SharedMemoryRingBuffer>* buffer);
+
+  int64 num_consumers() const;
+
+  // Producer methods.
+
+  // Copies `element` into a free slot, waiting for consumers to read or release
+  // elements, or to exit, until there is one.
+  Status Publish(const std::vector<Tensor>& element,
+                 const CancelledFn& is_cancelled);
+
+  // Marks the end of the elements, with an error if `status` is not OK.
+  void Finish(const Status& status);
+
+  // Waits for every consumer to release every element, to detach or to exit.
+  Status WaitForConsumers(const CancelledFn& is_cancelled);
+
+  // Consumer methods.
+
+  // Registers the caller as consumer `consumer_index`. Each consumer index can
+  // be attached once.
+  Status Attach(int64 consumer_index);
+
+  // Stops reading as `consumer_index`. The producer no longer waits for the
+  // consumer once the tensors it has read are destroyed.
+  void Detach(int64 consumer_index);
+
+  // Reads the element with index `element_index` for `consumer_index`. The
+  // element is released when all the tensors in `element` are destroyed, and
+  // elements must be read in order. Past the elements a consumer may hold in
+  // their slots, the tensors are copied out of the buffer.
+  Status Read(int64 consumer_index, int64 element_index,
+              const CancelledFn& is_cancelled, std::vector<Tensor>* element,
+              bool* end_of_sequence);
+
+ private:
+  struct Header;
+  struct ConsumerState;
+  class ElementBuffer;
+  class Lease;
+
+  // The state of a consumer attached by this process.
+  struct LocalConsumer {
+    bool attached = false;
+    bool detached = false;
+    // The number of elements read.
+    int64 num_read = 0;
+    // The number of elements read whose tensors point into their slot and are
+    // not all destroyed.
+    int64 num_held = 0;
+  };
+
+  SharedMemoryRingBuffer(const string& name, bool is_producer, int fd,
+                         char* base, size_t size);
+
+  static Status Map(const string& name, bool is_producer, int fd, size_t size,
+                    std::shared_ptr<SharedMemoryRingBuffer>* buffer);
+
+  // Returns the size of a segment. It holds the header, the consumer states,
+  // the number of leases of each consumer on each slot, the slot of each of
+  // the last `num_slots` elements, and the slots.
+  static int64 SegmentSize(int64 num_consumers, int64 num_slots,
+                           int64 slot_size);
+
+  Header* header() const;
+  ConsumerState* consumer(int64 consumer_index) const;
+  std::atomic<int32>* leases(int64 consumer_index) const;
+  std::atomic<int64>* element_slot(int64 element_index) const;
+  char* slot(int64 slot_index) const;
+
+  // Returns the number of elements that every consumer has read.
+  uint64 MinRead() const;
+
+  // Returns a slot whose element every consumer has read and released, or -1.
+  int64 FindFreeSlot();
+
+  // Detaches the attached consumers whose process has exited, and releases
+  // their leases.
+  void DetachExitedConsumers();
+
+  // Waits for `done` to return true, detaching the consumers that exit.
+  Status WaitForConsumersTo(const std::function<bool()>& done,
+                            const CancelledFn& is_cancelled);
+
+  // Called when the lease of `consumer_index` on `slot_index` ends. `held` is
+  // true if tensors pointed into the slot.
+  void Release(int64 consumer_index, int64 slot_index, bool held);
+
+  const string name_;
+  const bool is_producer_;
+  const int fd_;
+  char* const base_;
+  const size_t size_;
+
+  // Producer state: the element last copied to each slot, or -1, and the slot
+  // to try first.
+  std::vector<int64> slot_elements_;
+  int64 next_slot_ = 0;
+
+  mutex mu_;
+  std::vector<LocalConsumer> local_consumers_ GUARDED_BY(mu_);
+  // The number of elements each consumer may hold in their slots.
+  int64 max_held_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryRingBuffer);
+};
+
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_EXPERIMENTAL_SHARED_MEMORY_RING_BUFFER_H_
@@ -0,0 +1,374 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/shared_memory_ring_buffer.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+// Returns a name that no other test uses, since shared memory segments are
+// visible to every process of the host.
+string BufferName(const string& test_name) {
+  return strings::StrCat("shm_test_", test_name, "_", getpid(), "_",
+                         random::New64());
+}
+
+// Returns element `i` of the test buffers, made of an int64 scalar, a float
+// vector and a string vector.
+std::vector<Tensor> Element(int64 i) {
+  const float f = static_cast<float>(i);
+  return {test::AsScalar<int64>(i),
+          test::AsTensor<float>({f + 0.5f, f + 1.5f, f + 2.5f}),
+          test::AsTensor<tstring>({strings::StrCat("element_", i), ""})};
+}
+
+// Returns true if `element` is equal to `Element(i)`.
+bool IsElement(const std::vector<Tensor>& element, int64 i) {
+  const std::vector<Tensor> expected = Element(i);
+  if (element.size() != expected.size()) return false;
+  for (int c = 0; c < expected.size(); ++c) {
+    if (element[c].dtype() != expected[c].dtype() ||
+        element[c].shape() != expected[c].shape()) {
+      return false;
+    }
+  }
+  return element[0].scalar<int64>()() == i &&
+         element[1].vec<float>()(2) == expected[1].vec<float>()(2) &&
+         element[2].vec<tstring>()(0) == expected[2].vec<tstring>()(0) &&
+         element[2].vec<tstring>()(1).empty();
+}
+
+SharedMemoryRingBuffer::Options MakeOptions(int64 num_consumers,
+                                            int64 num_slots) {
+  SharedMemoryRingBuffer::Options options;
+  options.num_consumers = num_consumers;
+  options.num_slots = num_slots;
+  options.slot_size_bytes = 1024;
+  return options;
+}
+
+// Returns a function that reports cancellation once it is called more than
+// `num_calls` times.
+SharedMemoryRingBuffer::CancelledFn CancelAfter(int num_calls) {
+  auto calls = std::make_shared<int>(0);
+  return [calls, num_calls]() { return ++*calls > num_calls; };
+}
+
+TEST(SharedMemoryRingBufferTest, PublishAndRead) {
+  const string name = BufferName("publish_and_read");
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(2, 4), &producer));
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  TF_ASSERT_OK(SharedMemoryRingBuffer::Open(name, /*timeout_micros=*/0,
+                                            nullptr, &consumer));
+  EXPECT_EQ(2, consumer->num_consumers());
+  TF_ASSERT_OK(consumer->Attach(0));
+  TF_ASSERT_OK(consumer->Attach(1));
+
+  // Both consumers read every element, while holding at most 4 of them.
+  for (int64 i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(producer->Publish(Element(i), nullptr));
+    for (int64 c = 0; c < 2; ++c) {
+      std::vector<Tensor> element;
+      bool end_of_sequence = true;
+      TF_ASSERT_OK(consumer->Read(c, i, nullptr, &element, &end_of_sequence));
+      EXPECT_FALSE(end_of_sequence);
+      EXPECT_TRUE(IsElement(element, i));
+    }
+  }
+  producer->Finish(Status::OK());
+  for (int64 c = 0; c < 2; ++c) {
+    std::vector<Tensor> element;
+    bool end_of_sequence = false;
+    TF_ASSERT_OK(consumer->Read(c, 10, nullptr, &element, &end_of_sequence));
+    EXPECT_TRUE(end_of_sequence);
+  }
+  TF_EXPECT_OK(producer->WaitForConsumers(CancelAfter(0)));
+}
+
+TEST(SharedMemoryRingBufferTest, SlotsAreReusedOnceTensorsAreDestroyed) {
+  const string name = BufferName("reuse");
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(1, 3), &producer));
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  TF_ASSERT_OK(SharedMemoryRingBuffer::Open(name, 0, nullptr, &consumer));
+  TF_ASSERT_OK(consumer->Attach(0));
+
+  for (int64 i = 0; i < 3; ++i) {
+    TF_ASSERT_OK(producer->Publish(Element(i), nullptr));
+  }
+  std::vector<Tensor> element_0, element_1, element_2;
+  bool end_of_sequence;
+  TF_ASSERT_OK(consumer->Read(0, 0, nullptr, &element_0, &end_of_sequence));
+  TF_ASSERT_OK(consumer->Read(0, 1, nullptr, &element_1, &end_of_sequence));
+  // The consumer holds at most 2 elements in their slots, so element 2 is
+  // copied and its slot is reused.
+  TF_ASSERT_OK(consumer->Read(0, 2, nullptr, &element_2, &end_of_sequence));
+  TF_ASSERT_OK(producer->Publish(Element(3), CancelAfter(10)));
+  // The tensors of elements 0 and 1 point into their slots, and element 3 is
+  // not read yet, so no slot is free.
+  EXPECT_TRUE(errors::IsCancelled(
+      producer->Publish(Element(4), CancelAfter(10))));
+
+  // Elements are released in any order, once all their tensors are destroyed.
+  Tensor float_tensor = element_1[1];
+  element_1.clear();
+  EXPECT_TRUE(errors::IsCancelled(
+      producer->Publish(Element(4), CancelAfter(10))));
+  float_tensor = Tensor();
+  TF_ASSERT_OK(producer->Publish(Element(4), CancelAfter(10)));
+
+  std::vector<Tensor> element_3, element_4;
+  TF_ASSERT_OK(consumer->Read(0, 3, nullptr, &element_3, &end_of_sequence));
+  TF_ASSERT_OK(consumer->Read(0, 4, nullptr, &element_4, &end_of_sequence));
+  EXPECT_TRUE(IsElement(element_0, 0));
+  EXPECT_TRUE(IsElement(element_2, 2));
+  EXPECT_TRUE(IsElement(element_3, 3));
+  EXPECT_TRUE(IsElement(element_4, 4));
+}
+
+TEST(SharedMemoryRingBufferTest, ConsumersHoldMoreElementsThanSlots) {
+  for (const int64 num_consumers : {1, 2}) {
+    const string name = BufferName("hold");
+    std::shared_ptr<SharedMemoryRingBuffer> producer;
+    TF_ASSERT_OK(SharedMemoryRingBuffer::Create(
+        name, MakeOptions(num_consumers, 4), &producer));
+    std::shared_ptr<SharedMemoryRingBuffer> consumer;
+    TF_ASSERT_OK(SharedMemoryRingBuffer::Open(name, 0, nullptr, &consumer));
+    for (int64 c = 0; c < num_consumers; ++c) {
+      TF_ASSERT_OK(consumer->Attach(c));
+    }
+
+    // Like a batch of 10 elements, every consumer holds all the elements it
+    // has read while the producer publishes the next one.
+    std::vector<std::vector<std::vector<Tensor>>> batches(num_consumers);
+    for (int64 i = 0; i < 10; ++i) {
+      TF_ASSERT_OK(producer->Publish(Element(i), CancelAfter(100)));
+      for (int64 c = 0; c < num_consumers; ++c) {
+        std::vector<Tensor> element;
+        bool end_of_sequence;
+        TF_ASSERT_OK(consumer->Read(c, i, nullptr, &element, &end_of_sequence));
+        batches[c].push_back(std::move(element));
+      }
+    }
+    for (int64 c = 0; c < num_consumers; ++c) {
+      for (int64 i = 0; i < 10; ++i) {
+        EXPECT_TRUE(IsElement(batches[c][i], i));
+      }
+    }
+  }
+}
+
+TEST(SharedMemoryRingBufferTest, DetachUnblocksProducer) {
+  const string name = BufferName("detach");
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(2, 1), &producer));
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  TF_ASSERT_OK(SharedMemoryRingBuffer::Open(name, 0, nullptr, &consumer));
+  TF_ASSERT_OK(consumer->Attach(0));
+  TF_ASSERT_OK(consumer->Attach(1));
+
+  TF_ASSERT_OK(producer->Publish(Element(0), nullptr));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  TF_ASSERT_OK(consumer->Read(0, 0, nullptr, &element, &end_of_sequence));
+  element.clear();
+  EXPECT_TRUE(errors::IsCancelled(
+      producer->Publish(Element(1), CancelAfter(10))));
+
+  // Consumer 1 never reads element 0, and stops waiting for it once detached.
+  consumer->Detach(1);
+  TF_ASSERT_OK(producer->Publish(Element(1), CancelAfter(10)));
+  EXPECT_TRUE(errors::IsFailedPrecondition(
+      consumer->Read(1, 0, nullptr, &element, &end_of_sequence)));
+  consumer->Detach(0);
+  producer->Finish(Status::OK());
+  TF_EXPECT_OK(producer->WaitForConsumers(CancelAfter(0)));
+}
+
+TEST(SharedMemoryRingBufferTest, ExitedConsumerUnblocksProducer) {
+  const string name = BufferName("exited");
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(1, 2), &producer));
+  TF_ASSERT_OK(producer->Publish(Element(0), nullptr));
+
+  // The consumer exits while it holds element 0, without detaching.
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    std::shared_ptr<SharedMemoryRingBuffer> consumer;
+    std::vector<Tensor> element;
+    bool end_of_sequence;
+    if (!SharedMemoryRingBuffer::Open(name, -1, nullptr, &consumer).ok() ||
+        !consumer->Attach(0).ok() ||
+        !consumer->Read(0, 0, nullptr, &element, &end_of_sequence).ok()) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  // Element 2 needs the slot of element 0, or for element 1 to be read.
+  TF_ASSERT_OK(producer->Publish(Element(1), CancelAfter(100)));
+  TF_ASSERT_OK(producer->Publish(Element(2), CancelAfter(100)));
+  producer->Finish(Status::OK());
+  TF_EXPECT_OK(producer->WaitForConsumers(CancelAfter(100)));
+}
+
+TEST(SharedMemoryRingBufferTest, ErrorsArePropagated) {
+  const string name = BufferName("error");
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(1, 2), &producer));
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  TF_ASSERT_OK(SharedMemoryRingBuffer::Open(name, 0, nullptr, &consumer));
+  TF_ASSERT_OK(consumer->Attach(0));
+
+  TF_ASSERT_OK(producer->Publish(Element(0), nullptr));
+  producer->Finish(errors::DataLoss("Corrupted input"));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  // Elements published before the error are read first.
+  TF_ASSERT_OK(consumer->Read(0, 0, nullptr, &element, &end_of_sequence));
+  EXPECT_TRUE(IsElement(element, 0));
+  Status s = consumer->Read(0, 1, nullptr, &element, &end_of_sequence);
+  EXPECT_TRUE(errors::IsDataLoss(s));
+  EXPECT_EQ("Corrupted input", s.error_message());
+}
+
+TEST(SharedMemoryRingBufferTest, InvalidArguments) {
+  std::shared_ptr<SharedMemoryRingBuffer> buffer;
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      SharedMemoryRingBuffer::Create("", MakeOptions(1, 1), &buffer)));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      SharedMemoryRingBuffer::Create("a/b", MakeOptions(1, 1), &buffer)));
+  const string name = BufferName("invalid");
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(0, 1), &buffer)));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(1, 0), &buffer)));
+
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(
+      SharedMemoryRingBuffer::Create(name, MakeOptions(1, 1), &producer));
+  Tensor too_large(DT_FLOAT, TensorShape({1024}));
+  too_large.flat<float>().setZero();
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(producer->Publish({too_large}, nullptr)));
+  Tensor variant(DT_VARIANT, TensorShape({}));
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(producer->Publish({variant}, nullptr)));
+
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  TF_ASSERT_OK(SharedMemoryRingBuffer::Open(name, 0, nullptr, &consumer));
+  EXPECT_TRUE(errors::IsInvalidArgument(consumer->Attach(1)));
+  TF_ASSERT_OK(consumer->Attach(0));
+  EXPECT_TRUE(errors::IsAlreadyExists(consumer->Attach(0)));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      consumer->Read(0, 1, nullptr, &element, &end_of_sequence)));
+}
+
+TEST(SharedMemoryRingBufferTest, OpenTimesOut) {
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  EXPECT_TRUE(errors::IsDeadlineExceeded(SharedMemoryRingBuffer::Open(
+      BufferName("missing"), /*timeout_micros=*/1000, nullptr, &consumer)));
+  EXPECT_TRUE(errors::IsCancelled(SharedMemoryRingBuffer::Open(
+      BufferName("missing"), /*timeout_micros=*/-1, CancelAfter(10),
+      &consumer)));
+}
+
+// Reads every element of `name` as `consumer_index` and returns the exit code
+// of a consumer process.
+int RunConsumer(const string& name, int64 consumer_index,
+                int64 num_elements) {
+  std::shared_ptr<SharedMemoryRingBuffer> consumer;
+  if (!SharedMemoryRingBuffer::Open(name, /*timeout_micros=*/10000000,
+                                    nullptr, &consumer)
+           .ok() ||
+      !consumer->Attach(consumer_index).ok()) {
+    return 1;
+  }
+  for (int64 i = 0;; ++i) {
+    std::vector<Tensor> element;
+    bool end_of_sequence;
+    if (!consumer->Read(consumer_index, i, nullptr, &element, &end_of_sequence)
+             .ok()) {
+      return 2;
+    }
+    if (end_of_sequence) {
+      return i == num_elements ? 0 : 3;
+    }
+    if (!IsElement(element, i)) {
+      return 4;
+    }
+  }
+}
+
+TEST(SharedMemoryRingBufferTest, MultipleProcesses) {
+  const string name = BufferName("processes");
+  constexpr int64 kNumConsumers = 3;
+  constexpr int64 kNumElements = 1000;
+  std::shared_ptr<SharedMemoryRingBuffer> producer;
+  TF_ASSERT_OK(SharedMemoryRingBuffer::Create(
+      name, MakeOptions(kNumConsumers, 8), &producer));
+
+  std::vector<pid_t> pids;
+  for (int64 c = 0; c < kNumConsumers; ++c) {
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      _exit(RunConsumer(name, c, kNumElements));
+    }
+    pids.push_back(pid);
+  }
+  for (int64 i = 0; i < kNumElements; ++i) {
+    TF_ASSERT_OK(producer->Publish(Element(i), nullptr));
+  }
+  producer->Finish(Status::OK());
+  TF_EXPECT_OK(producer->WaitForConsumers(nullptr));
+  for (pid_t pid : pids) {
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+  }
+}
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
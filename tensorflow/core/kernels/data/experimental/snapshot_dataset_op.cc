@@ -57,6 +57,10 @@ const int64 kDefaultShardSizeBytes = 10LL * 1024 * 1024 * 1024;
 
 const size_t kHeaderSize = sizeof(uint64);
 
+// Versions of the format of the snapshot files, see SnapshotMetadataRecord.
+constexpr int64 kProtoEncodingVersion = 0;
+constexpr int64 kRawTensorEncodingVersion = 1;
+
 constexpr char kSnapshotFilename[] = "snapshot.metadata";
 constexpr char kSnapshotReaderWorkerPool[] = "snapshot_reader_worker_pool";
 constexpr char kSnapshotWriterWorkerPool[] = "snapshot_writer_worker_pool";
@@ -100,6 +104,24 @@ class SnapshotWriter {
     return dest_->Append(data);
   }
 
+  // Writes the concatenation of `data` as one record, without copying it.
+  Status WriteRecord(const std::vector<StringPiece>& data) {
+    profiler::TraceMe activity(
+        absl::StrCat(kClassName, kSeparator, kWriteStringPiece),
+        profiler::TraceMeLevel::kInfo);
+    uint64 length = 0;
+    for (const StringPiece& piece : data) {
+      length += piece.size();
+    }
+    char header[kHeaderSize];
+    core::EncodeFixed64(header, length);
+    TF_RETURN_IF_ERROR(dest_->Append(StringPiece(header, sizeof(header))));
+    for (const StringPiece& piece : data) {
+      TF_RETURN_IF_ERROR(dest_->Append(piece));
+    }
+    return Status::OK();
+  }
+
 #if defined(PLATFORM_GOOGLE)
   Status WriteRecord(const absl::Cord& data) {
     profiler::TraceMe activity(absl::StrCat(kClassName, kSeparator, kWriteCord),
@@ -198,6 +220,83 @@ class SnapshotReader {
   const string compression_type_;
 };
 
+// Returns true if the elements of `dtypes` can be written with the raw tensor
+// encoding.
+bool CanUseRawTensorEncoding(const DataTypeVector& dtypes) {
+  for (DataType dtype : dtypes) {
+    if (!DataTypeCanUseMemcpy(dtype)) return false;
+  }
+  return true;
+}
+
+// Writes `tensors` with the raw tensor encoding: a SnapshotTensorMetadata
+// record followed by a record holding the contents of the tensors.
+Status WriteRawTensors(const std::vector<Tensor>& tensors,
+                       SnapshotWriter* writer) {
+  experimental::SnapshotTensorMetadata metadata;
+  std::vector<StringPiece> tensor_data;
+  tensor_data.reserve(tensors.size());
+  for (const Tensor& t : tensors) {
+    auto* tensor_metadata = metadata.add_tensor_metadata();
+    t.shape().AsProto(tensor_metadata->mutable_tensor_shape());
+    tensor_data.push_back(t.tensor_data());
+    tensor_metadata->set_tensor_size_bytes(tensor_data.back().size());
+  }
+  TF_RETURN_IF_ERROR(writer->WriteRecord(metadata.SerializeAsString()));
+  return writer->WriteRecord(tensor_data);
+}
+
+// Reads tensors of types `dtypes` written by WriteRawTensors(). Returns
+// OUT_OF_RANGE at the end of the file.
+Status ReadRawTensors(const DataTypeVector& dtypes, SnapshotReader* reader,
+                      std::vector<Tensor>* tensors) {
+  tstring metadata_bytes;
+  TF_RETURN_IF_ERROR(reader->ReadRecord(&metadata_bytes));
+  experimental::SnapshotTensorMetadata metadata;
+  if (!metadata.ParseFromString(metadata_bytes)) {
+    return errors::DataLoss("Unable to parse snapshot tensor metadata.");
+  }
+  if (metadata.tensor_metadata_size() != dtypes.size()) {
+    return errors::DataLoss("Expected ", dtypes.size(), " tensors but got ",
+                            metadata.tensor_metadata_size(), ".");
+  }
+
+  tstring data;
+  Status s = reader->ReadRecord(&data);
+  if (errors::IsOutOfRange(s)) {
+    return errors::DataLoss("Missing the contents of snapshot tensors.");
+  }
+  TF_RETURN_IF_ERROR(s);
+
+  size_t offset = 0;
+  tensors->reserve(dtypes.size());
+  for (int i = 0; i < dtypes.size(); ++i) {
+    const auto& tensor_metadata = metadata.tensor_metadata(i);
+    if (!TensorShape::IsValid(tensor_metadata.tensor_shape())) {
+      return errors::DataLoss("Invalid snapshot tensor shape.");
+    }
+    Tensor t(dtypes[i], TensorShape(tensor_metadata.tensor_shape()));
+    const size_t size = t.TotalBytes();
+    if (size != tensor_metadata.tensor_size_bytes() ||
+        size > data.size() - offset) {
+      return errors::DataLoss("Snapshot tensor ", i, " has ",
+                              tensor_metadata.tensor_size_bytes(),
+                              " bytes, expected ", size, ".");
+    }
+    if (size > 0) {
+      std::memcpy(const_cast<char*>(t.tensor_data().data()),
+                  data.data() + offset, size);
+    }
+    offset += size;
+    tensors->push_back(std::move(t));
+  }
+  if (offset != data.size()) {
+    return errors::DataLoss("Found ", data.size() - offset,
+                            " unexpected bytes after snapshot tensors.");
+  }
+  return Status::OK();
+}
+
 Status WriteMetadataFile(const string& hash_dir,
                          const experimental::SnapshotMetadataRecord& metadata) {
   string metadata_filename = absl::StrCat(hash_dir, "/", kSnapshotFilename);
@@ -307,6 +406,10 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("shuffle_on_read", &shuffle_on_read_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("seed", &seed_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("seed2", &seed2_));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("raw_tensor_encoding", &raw_tensor_encoding_));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("deterministic_reads", &deterministic_reads_));
 
     if (shard_size_bytes_ == -1) shard_size_bytes_ = kDefaultShardSizeBytes;
 
@@ -355,7 +458,8 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
                           writer_path_prefix_, compression_, shard_size_bytes_,
                           pending_snapshot_expiry_seconds_, num_reader_threads_,
                           reader_buffer_size_, num_writer_threads_,
-                          writer_buffer_size_, shuffle_on_read_, seed_, seed2_);
+                          writer_buffer_size_, shuffle_on_read_, seed_, seed2_,
+                          raw_tensor_encoding_, deterministic_reads_);
   }
 
  private:
@@ -368,7 +472,8 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
             const uint64 pending_snapshot_expiry_seconds,
             const uint64 num_reader_threads, const uint64 reader_buffer_size,
             const uint64 num_writer_threads, const uint64 writer_buffer_size,
-            const bool shuffle_on_read, const uint64 seed, const uint64 seed2)
+            const bool shuffle_on_read, const uint64 seed, const uint64 seed2,
+            const bool raw_tensor_encoding, const bool deterministic_reads)
         : DatasetBase(DatasetContext(ctx)),
           input_(input),
           dir_(path),
@@ -384,7 +489,9 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           writer_buffer_size_(writer_buffer_size),
           shuffle_on_read_(shuffle_on_read),
           seed_(seed),
-          seed2_(seed2) {
+          seed2_(seed2),
+          raw_tensor_encoding_(raw_tensor_encoding),
+          deterministic_reads_(deterministic_reads) {
       input_->Ref();
     }
 
@@ -459,6 +566,12 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
       AttrValue seed2_attr;
       b->BuildAttrValue<int64>(seed2_, &seed2_attr);
 
+      AttrValue raw_tensor_encoding_attr;
+      b->BuildAttrValue<bool>(raw_tensor_encoding_, &raw_tensor_encoding_attr);
+
+      AttrValue deterministic_reads_attr;
+      b->BuildAttrValue<bool>(deterministic_reads_, &deterministic_reads_attr);
+
       TF_RETURN_IF_ERROR(b->AddDataset(
           this,
           /*inputs=*/
@@ -478,7 +591,9 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
            {"writer_buffer_size", writer_buffer_size_attr},
            {"shuffle_on_read", shuffle_on_read_attr},
            {"seed", seed_attr},
-           {"seed2", seed2_attr}},
+           {"seed2", seed2_attr},
+           {"raw_tensor_encoding", raw_tensor_encoding_attr},
+           {"deterministic_reads", deterministic_reads_attr}},
           output));
       return Status::OK();
     }
@@ -567,6 +682,15 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
 
         Status Initialize(IteratorContext* ctx) override {
           mutex_lock l(mu_);
+          if (metadata_.version() > kRawTensorEncodingVersion) {
+            return errors::Unimplemented("Unsupported snapshot version: ",
+                                         metadata_.version());
+          }
+          if (metadata_.version() == kRawTensorEncodingVersion) {
+            for (int dtype : metadata_.dtype()) {
+              dtypes_.push_back(static_cast<DataType>(dtype));
+            }
+          }
           thread_pool_ = ctx->CreateThreadPool(kSnapshotReaderWorkerPool,
                                                dataset()->num_reader_threads_);
           run_id_ = metadata_.run_id();
@@ -590,6 +714,19 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           } else {
             std::sort(filenames_.begin(), filenames_.end());
           }
+
+          // With deterministic reads, each reader thread has a buffer of its
+          // own which the elements are taken from in turn. Otherwise all the
+          // threads share a single buffer.
+          if (dataset()->deterministic_reads_) {
+            buffers_.resize(dataset()->num_reader_threads_);
+            buffer_capacity_ = std::max<uint64>(
+                1, dataset()->reader_buffer_size_ /
+                       dataset()->num_reader_threads_);
+          } else {
+            buffers_.resize(1);
+            buffer_capacity_ = dataset()->reader_buffer_size_;
+          }
           return Status::OK();
         }
 
@@ -601,15 +738,69 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           if (!background_threads_started_) {
             for (int i = 0; i < dataset()->num_reader_threads_; ++i) {
               ++num_active_threads_;
-              thread_pool_->Schedule([this]() { ReadingFilesLoop(); });
+              thread_pool_->Schedule([this, i]() { ReadingFilesLoop(i); });
             }
             background_threads_started_ = true;
           }
 
+          BufferElement elem;
+          if (dataset()->deterministic_reads_) {
+            TF_RETURN_IF_ERROR(
+                NextDeterministicElementLocked(&l, &elem, end_of_sequence));
+          } else {
+            TF_RETURN_IF_ERROR(NextElementLocked(&l, &elem, end_of_sequence));
+          }
+          if (*end_of_sequence) return Status::OK();
+          TF_RETURN_IF_ERROR(elem.status);
+          *out_tensors = std::move(elem.value);
+
+          {
+            profiler::TraceMe activity(
+                absl::StrCat(prefix(), kSeparator, kBookkeeping),
+                profiler::TraceMeLevel::kInfo);
+            // Printing some statistics along the way.
+            int64 num_bytes = 0;
+            for (int i = 0; i < out_tensors->size(); ++i) {
+              num_bytes += (*out_tensors)[i].TotalBytes();
+            }
+            absl::Time end = absl::Now();
+            absl::Duration d = end - start;
+            time_spent_micros_ += absl::ToInt64Microseconds(d);
+            kbytes_read_ += static_cast<double>(num_bytes) / 1024.0;
+            elements_produced_++;
+            if (elements_produced_ % 10000 == 0) {
+              LOG(INFO) << "Current read throughput (MBPS): "
+                        << ((kbytes_read_ / 1024.0) /
+                            (time_spent_micros_ / 1000000.0));
+            }
+          }
+          return Status::OK();
+        }
+
+       private:
+        struct BufferElement {
+          Status status;
+          std::vector<Tensor> value;
+          // With deterministic reads, marks the end of a file.
+          bool end_of_file = false;
+        };
+
+        struct ReaderBuffer {
+          std::deque<BufferElement> elements;
+          // Set when the reader thread filling this buffer has terminated.
+          bool finished = false;
+        };
+
+        // Takes the next element from the shared buffer, in the order in
+        // which the reader threads produced them.
+        Status NextElementLocked(mutex_lock* l, BufferElement* elem,
+                                 bool* end_of_sequence)
+            EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+          std::deque<BufferElement>& buffer = buffers_[0].elements;
           // Wait till the buffer has something in it.
-          while (!cancelled_ && buffer_.empty() &&
+          while (!cancelled_ && buffer.empty() &&
                  !background_threads_finished_) {
-            cond_var_.wait(l);
+            cond_var_.wait(*l);
           }
 
           if (cancelled_) {
@@ -617,36 +808,12 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
                 "SnapshotDatasetOp::Dataset::SnapshotReaderIterator::GetNext");
           }
 
-          if (!buffer_.empty()) {
-            Status s = buffer_.front().status;
-            if (s.ok()) {
-              *end_of_sequence = false;
-              *out_tensors = std::move(buffer_.front().value);
-
-              {
-                profiler::TraceMe activity(
-                    absl::StrCat(prefix(), kSeparator, kBookkeeping),
-                    profiler::TraceMeLevel::kInfo);
-                // Printing some statistics along the way.
-                int64 num_bytes = 0;
-                for (int i = 0; i < out_tensors->size(); ++i) {
-                  num_bytes += (*out_tensors)[i].TotalBytes();
-                }
-                absl::Time end = absl::Now();
-                absl::Duration d = end - start;
-                time_spent_micros_ += absl::ToInt64Microseconds(d);
-                kbytes_read_ += static_cast<double>(num_bytes) / 1024.0;
-                elements_produced_++;
-                if (elements_produced_ % 10000 == 0) {
-                  LOG(INFO) << "Current read throughput (MBPS): "
-                            << ((kbytes_read_ / 1024.0) /
-                                (time_spent_micros_ / 1000000.0));
-                }
-              }
-            }
-            buffer_.pop_front();
+          if (!buffer.empty()) {
+            *elem = std::move(buffer.front());
+            buffer.pop_front();
             cond_var_.notify_all();
-            return s;
+            *end_of_sequence = false;
+            return Status::OK();
           }
 
           if (background_threads_finished_) {
@@ -657,9 +824,82 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           return errors::Internal("Unreachable point in SnapshotReader");
         }
 
-       private:
-        // Reads one file end to end.
-        Status ReadFile(const string& filename) {
+        // Takes the next element from the buffers of the reader threads in
+        // turn, one file at a time, so that the elements are produced in the
+        // order of the files.
+        Status NextDeterministicElementLocked(mutex_lock* l,
+                                              BufferElement* elem,
+                                              bool* end_of_sequence)
+            EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+          while (true) {
+            ReaderBuffer& buffer = buffers_[next_buffer_index_];
+            while (!cancelled_ && buffer.elements.empty() &&
+                   !buffer.finished) {
+              cond_var_.wait(*l);
+            }
+
+            if (cancelled_) {
+              return errors::Cancelled(
+                  "SnapshotDatasetOp::Dataset::SnapshotReaderIterator::"
+                  "GetNext");
+            }
+
+            if (buffer.elements.empty()) {
+              // The reader of the next file has no files left, so all the
+              // files have been read.
+              *end_of_sequence = true;
+              return Status::OK();
+            }
+
+            *elem = std::move(buffer.elements.front());
+            buffer.elements.pop_front();
+            cond_var_.notify_all();
+            if (elem->end_of_file) {
+              next_buffer_index_ = (next_buffer_index_ + 1) % buffers_.size();
+              continue;
+            }
+            *end_of_sequence = false;
+            return Status::OK();
+          }
+        }
+
+        // Reads the next element of `reader`. Returns OUT_OF_RANGE at the end
+        // of the file.
+        Status ReadElement(SnapshotReader* reader,
+                           std::vector<Tensor>* out_tensors) {
+          if (metadata_.version() == kRawTensorEncodingVersion) {
+            profiler::TraceMe activity(
+                absl::StrCat(prefix(), kSeparator, kParse),
+                profiler::TraceMeLevel::kInfo);
+            return ReadRawTensors(dtypes_, reader, out_tensors);
+          }
+#if !defined(PLATFORM_GOOGLE)
+          tstring record_bytes;
+          TF_RETURN_IF_ERROR(reader->ReadRecord(&record_bytes));
+#else
+          absl::Cord record_cord;
+          TF_RETURN_IF_ERROR(reader->ReadRecord(&record_cord));
+#endif
+          profiler::TraceMe activity(absl::StrCat(prefix(), kSeparator, kParse),
+                                     profiler::TraceMeLevel::kInfo);
+          experimental::SnapshotRecord record;
+#if !defined(PLATFORM_GOOGLE)
+          record.ParseFromString(record_bytes);
+#else
+          record.ParseFromCord(record_cord);
+#endif
+          for (int i = 0; i < record.tensor_size(); ++i) {
+            Tensor t;
+            if (!t.FromProto(record.tensor(i))) {
+              return errors::DataLoss("Unable to parse tensor from proto.");
+            }
+            out_tensors->push_back(std::move(t));
+          }
+          return Status::OK();
+        }
+
+        // Reads one file end to end into `buffers_[buffer_index]`.
+        Status ReadFile(const string& filename, size_t buffer_index) {
           std::unique_ptr<RandomAccessFile> file;
           TF_CHECK_OK(Env::Default()->NewRandomAccessFile(filename, &file));
           std::unique_ptr<SnapshotReader> reader(
@@ -669,8 +909,8 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
             // Wait for a slot in the buffer.
             {
               mutex_lock l(mu_);
-              while (!cancelled_ &&
-                     buffer_.size() >= dataset()->reader_buffer_size_) {
+              while (!cancelled_ && buffers_[buffer_index].elements.size() >=
+                                        buffer_capacity_) {
                 cond_var_.wait(l);
               }
 
@@ -680,38 +920,20 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
                     "ReadFile");
               }
             }
-#if !defined(PLATFORM_GOOGLE)
-            string record_bytes;
-            Status s = reader->ReadRecord(&record_bytes);
-#else
-            absl::Cord record_cord;
-            Status s = reader->ReadRecord(&record_cord);
-#endif
+            BufferElement elem;
+            Status s = ReadElement(reader.get(), &elem.value);
             if (s.ok()) {
-              profiler::TraceMe activity(
-                  absl::StrCat(prefix(), kSeparator, kParse),
-                  profiler::TraceMeLevel::kInfo);
-              experimental::SnapshotRecord record;
-#if !defined(PLATFORM_GOOGLE)
-              record.ParseFromString(record_bytes);
-#else
-              record.ParseFromCord(record_cord);
-#endif
-              std::vector<Tensor> out_tensors;
-              for (int i = 0; i < record.tensor_size(); ++i) {
-                Tensor t;
-                if (!t.FromProto(record.tensor(i))) {
-                  return errors::DataLoss("Unable to parse tensor from proto.");
-                }
-                out_tensors.push_back(t);
-              }
-              BufferElement elem;
-              std::swap(elem.value, out_tensors);
               elem.status = Status::OK();
               mutex_lock l(mu_);
-              buffer_.push_back(std::move(elem));
+              buffers_[buffer_index].elements.push_back(std::move(elem));
               cond_var_.notify_all();
             } else if (errors::IsOutOfRange(s)) {
+              if (dataset()->deterministic_reads_) {
+                elem.end_of_file = true;
+                mutex_lock l(mu_);
+                buffers_[buffer_index].elements.push_back(std::move(elem));
+                cond_var_.notify_all();
+              }
               return Status::OK();
             } else {
               return s;
@@ -720,27 +942,44 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           return Status::OK();
         }
 
-        // Pulls one file off the filenames_ list and reads it through. When
+        // Returns the index of the next file for the reader thread
+        // `reader_index` to read, or false when there are none left. With
+        // deterministic reads, reader i reads files i, i + n, i + 2n, ...
+        // where n is the number of reader threads; otherwise the threads
+        // pull the files off the filenames_ list.
+        bool NextFileIndex(int reader_index, size_t* reader_file_index,
+                           size_t* file_index) LOCKS_EXCLUDED(mu_) {
+          if (dataset()->deterministic_reads_) {
+            *file_index = reader_index +
+                          *reader_file_index * dataset()->num_reader_threads_;
+            ++*reader_file_index;
+          } else {
+            mutex_lock l(mu_);
+            *file_index = next_file_index_++;
+          }
+          return *file_index < filenames_.size();
+        }
+
+        // Reads the files of the reader thread `reader_index` through. When
         // all files are read, terminates.
-        void ReadingFilesLoop() {
-          auto cleanup = gtl::MakeCleanup([this]() {
+        void ReadingFilesLoop(int reader_index) {
+          const size_t buffer_index =
+              dataset()->deterministic_reads_ ? reader_index : 0;
+          auto cleanup = gtl::MakeCleanup([this, buffer_index]() {
             mutex_lock l(mu_);
             --num_active_threads_;
+            if (dataset()->deterministic_reads_) {
+              buffers_[buffer_index].finished = true;
+            }
             cond_var_.notify_all();
           });
-          while (true) {
-            string filename = "";
-            {
-              mutex_lock l(mu_);
-              if (next_file_index_ >= filenames_.size()) {
-                return;
-              }
-              filename = absl::StrCat(dataset()->reader_path_prefix_,
-                                      filenames_[next_file_index_]);
-              VLOG(2) << "Starting to read: " << filename;
-              next_file_index_++;
-            }
-            Status s = ReadFile(filename);
+          size_t reader_file_index = 0;
+          size_t file_index;
+          while (NextFileIndex(reader_index, &reader_file_index, &file_index)) {
+            const string filename = absl::StrCat(dataset()->reader_path_prefix_,
+                                                 filenames_[file_index]);
+            VLOG(2) << "Starting to read: " << filename;
+            Status s = ReadFile(filename, buffer_index);
             // If we get to the end of the file, it's a clean termination and
             // we are at the end of the file. If all files have been processed,
             // then we insert an end_of_sequence marker in the buffer and
@@ -759,23 +998,20 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
               BufferElement elem;
               elem.status = s;
               mutex_lock l(mu_);
-              buffer_.push_back(std::move(elem));
+              buffers_[buffer_index].elements.push_back(std::move(elem));
               cond_var_.notify_all();
               return;
             }
           }
         }
 
-        struct BufferElement {
-          Status status;
-          std::vector<Tensor> value;
-        };
-
         mutex mu_;
         condition_variable cond_var_;
 
         const string hash_dir_;
         const experimental::SnapshotMetadataRecord metadata_;
+        // The types of the tensors with the raw tensor encoding.
+        DataTypeVector dtypes_;
         string run_id_ GUARDED_BY(mu_);
         string run_dir_ GUARDED_BY(mu_);
         std::vector<string> filenames_;
@@ -788,7 +1024,12 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
 
         std::unique_ptr<thread::ThreadPool> thread_pool_;
         int64 num_active_threads_ GUARDED_BY(mu_) = 0;
-        std::deque<BufferElement> buffer_ GUARDED_BY(mu_);
+        std::vector<ReaderBuffer> buffers_ GUARDED_BY(mu_);
+        // The maximum number of elements in each of buffers_.
+        uint64 buffer_capacity_ GUARDED_BY(mu_) = 0;
+        // The buffer to take the next element from with deterministic reads,
+        // which is the buffer of the reader of the file being produced.
+        size_t next_buffer_index_ GUARDED_BY(mu_) = 0;
         bool cancelled_ GUARDED_BY(mu_) = false;
         bool background_threads_started_ GUARDED_BY(mu_) = false;
         bool background_threads_finished_ GUARDED_BY(mu_) = false;
@@ -827,6 +1068,17 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           metadata.set_graph_hash(dataset()->graph_hash_);
           metadata.set_run_id(run_id_);
           metadata.set_finalized(false);
+          raw_tensor_encoding_ =
+              dataset()->raw_tensor_encoding_ &&
+              CanUseRawTensorEncoding(dataset()->output_dtypes());
+          if (raw_tensor_encoding_) {
+            metadata.set_version(kRawTensorEncodingVersion);
+            for (DataType dtype : dataset()->output_dtypes()) {
+              metadata.add_dtype(dtype);
+            }
+          } else {
+            metadata.set_version(kProtoEncodingVersion);
+          }
           TF_RETURN_IF_ERROR(WriteMetadataFile(hash_dir_, metadata));
 
           return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
@@ -998,11 +1250,8 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
           }
 
           if (produced_elem) {
-            experimental::SnapshotRecord record;
-            for (auto out_tensor : elem.value) {
+            for (const Tensor& out_tensor : elem.value) {
               *bytes_written += out_tensor.TotalBytes();
-              TensorProto* t = record.add_tensor();
-              out_tensor.AsProtoTensorContent(t);
             }
 
             if (*bytes_written > dataset()->shard_size_bytes_) {
@@ -1016,6 +1265,13 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
                   file->get(), dataset()->compression_);
               *bytes_written = 0;
             }
+            if (raw_tensor_encoding_) {
+              return WriteRawTensors(elem.value, writer->get());
+            }
+            experimental::SnapshotRecord record;
+            for (const Tensor& out_tensor : elem.value) {
+              out_tensor.AsProtoTensorContent(record.add_tensor());
+            }
 #if defined(PLATFORM_GOOGLE)
             TF_RETURN_IF_ERROR(
                 (*writer)->WriteRecord(record.SerializeAsCord()));
@@ -1118,6 +1374,8 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
         uint64 next_file_index_ GUARDED_BY(mu_) = 0;
         std::unique_ptr<thread::ThreadPool> thread_pool_;
         int64 num_active_threads_ GUARDED_BY(mu_) = 0;
+        // Set in Initialize(), before the writer threads start.
+        bool raw_tensor_encoding_ = false;
       };
 
       class SnapshotPassthroughIterator : public DatasetIterator<Dataset> {
@@ -1164,6 +1422,9 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
 
     const uint64 seed_;
     const uint64 seed2_;
+
+    const bool raw_tensor_encoding_;
+    const bool deterministic_reads_;
   };
 
   const int graph_def_version_;
@@ -1184,6 +1445,9 @@ class SnapshotDatasetOp : public UnaryDatasetOpKernel {
 
   int64 seed_;
   int64 seed2_;
+
+  bool raw_tensor_encoding_;
+  bool deterministic_reads_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("SnapshotDataset").Device(DEVICE_CPU),
@@ -0,0 +1,608 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/experimental/spilling_shuffle_dataset_op.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/metrics.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/kernels/data/name_utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+
+// Constants declared in spilling_shuffle_dataset_op.h and used both here and in
+// test cases.
+/* static */ constexpr const char* const SpillingShuffleDatasetOp::kDatasetType;
+/* static */ constexpr const char* const
+    SpillingShuffleDatasetOp::kInputDataset;
+/* static */ constexpr const char* const SpillingShuffleDatasetOp::kBufferSize;
+/* static */ constexpr const char* const SpillingShuffleDatasetOp::kSeed;
+/* static */ constexpr const char* const SpillingShuffleDatasetOp::kSeed2;
+/* static */ constexpr const char* const
+    SpillingShuffleDatasetOp::kMaxMemoryBytes;
+/* static */ constexpr const char* const
+    SpillingShuffleDatasetOp::kSpillDirectory;
+/* static */ constexpr const char* const SpillingShuffleDatasetOp::kOutputTypes;
+/* static */ constexpr const char* const
+    SpillingShuffleDatasetOp::kOutputShapes;
+
+namespace {
+
+constexpr char kNumRandomSamples[] = "num_random_samples";
+constexpr char kSeedKey[] = "seed";
+constexpr char kSeed2Key[] = "seed2";
+constexpr char kEndOfInputSequence[] = "end_of_input_sequence";
+constexpr char kBuffer[] = "buffer";
+constexpr char kSize[] = "size";
+
+// The maximum number of spilled runs to read from at once. Once a new run
+// would exceed it, the smallest runs are merged into one.
+constexpr int kMaxNumRuns = 16;
+constexpr int kNumRunsToMerge = kMaxNumRuns / 2;
+
+// Bounds of the read buffer of each spilled run.
+constexpr int64 kMinRunReadBufferSize = 16 << 10;   // 16 KB
+constexpr int64 kMaxRunReadBufferSize = 256 << 10;  // 256 KB
+
+// Half of `max_memory_bytes` holds the elements in memory, and the other half
+// the read buffers of the runs, which must fit at least their minimum size.
+constexpr int64 kMinMaxMemoryBytes =
+    2 * kMaxNumRuns * kMinRunReadBufferSize;  // 512 KB
+
+}  // namespace
+
+class SpillingShuffleDatasetOp::Dataset : public DatasetBase {
+ public:
+  Dataset(OpKernelContext* ctx, const DatasetBase* input, int64 buffer_size,
+          int64 seed, int64 seed2, int64 max_memory_bytes,
+          const string& spill_directory)
+      : DatasetBase(DatasetContext(ctx)),
+        input_(input),
+        buffer_size_(buffer_size),
+        seed_(seed),
+        seed2_(seed2),
+        max_memory_bytes_(max_memory_bytes),
+        run_read_buffer_size_(std::min(
+            std::max(max_memory_bytes / 2 / kMaxNumRuns, kMinRunReadBufferSize),
+            kMaxRunReadBufferSize)),
+        spill_directory_(spill_directory) {
+    input_->Ref();
+  }
+
+  ~Dataset() override { input_->Unref(); }
+
+  std::unique_ptr<IteratorBase> MakeIteratorInternal(
+      const string& prefix) const override {
+    return absl::make_unique<Iterator>(Iterator::Params{
+        this, name_utils::IteratorPrefix(kDatasetType, prefix)});
+  }
+
+  const DataTypeVector& output_dtypes() const override {
+    return input_->output_dtypes();
+  }
+
+  const std::vector<PartialTensorShape>& output_shapes() const override {
+    return input_->output_shapes();
+  }
+
+  string DebugString() const override {
+    return name_utils::DatasetDebugString(kDatasetType);
+  }
+
+  int64 Cardinality() const override { return input_->Cardinality(); }
+
+  Status CheckExternalState() const override {
+    return input_->CheckExternalState();
+  }
+
+ protected:
+  Status AsGraphDefInternal(SerializationContext* ctx,
+                            DatasetGraphDefBuilder* b,
+                            Node** output) const override {
+    Node* input_graph_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
+    Node* buffer_size = nullptr;
+    Node* seed = nullptr;
+    Node* seed2 = nullptr;
+    Node* max_memory_bytes = nullptr;
+    Node* spill_directory = nullptr;
+    TF_RETURN_IF_ERROR(b->AddScalar(buffer_size_, &buffer_size));
+    TF_RETURN_IF_ERROR(b->AddScalar(seed_, &seed));
+    TF_RETURN_IF_ERROR(b->AddScalar(seed2_, &seed2));
+    TF_RETURN_IF_ERROR(b->AddScalar(max_memory_bytes_, &max_memory_bytes));
+    TF_RETURN_IF_ERROR(b->AddScalar(spill_directory_, &spill_directory));
+    TF_RETURN_IF_ERROR(b->AddDataset(
+        this,
+        {input_graph_node, buffer_size, seed, seed2, max_memory_bytes,
+         spill_directory},
+        output));
+    return Status::OK();
+  }
+
+ private:
+  // The elements of the shuffle buffer are kept in memory until they take more
+  // than half of `max_memory_bytes_`, at which point the elements in memory are
+  // shuffled and written to a file as a "run". Because each run is a uniformly
+  // random permutation of its elements, taking the next element of a run is
+  // the same as taking one of its remaining elements uniformly at random, so
+  // producing an element from the memory or a run chosen in proportion to the
+  // number of elements they hold samples the whole buffer uniformly, like
+  // ShuffleDataset does.
+  //
+  // The other half of `max_memory_bytes_` holds the read buffers of the runs.
+  // To bound their number, the smallest runs are merged into one whenever
+  // there would be more than `kMaxNumRuns` of them, interleaving their
+  // elements in the same way, so that the merged run is again a uniformly
+  // random permutation.
+  class Iterator : public DatasetIterator<Dataset> {
+   public:
+    explicit Iterator(const Params& params)
+        : DatasetIterator<Dataset>(params),
+          parent_generator_(0, 0),
+          generator_(&parent_generator_) {}
+
+    Status Initialize(IteratorContext* ctx) override {
+      mutex_lock l(mu_);
+      // Unless a seed is given, each iterator shuffles differently.
+      seed_ = dataset()->seed_;
+      seed2_ = dataset()->seed2_;
+      if (seed_ == 0 && seed2_ == 0) {
+        seed_ = random::New64();
+        seed2_ = random::New64();
+      }
+      ResetRngs();
+
+      env_ = ctx->env();
+      spill_directory_ = dataset()->spill_directory_;
+      if (spill_directory_.empty()) {
+        std::vector<string> directories;
+        env_->GetLocalTempDirectories(&directories);
+        if (directories.empty()) {
+          return errors::NotFound(
+              "Could not find a local temporary directory to spill to.");
+        }
+        spill_directory_ = directories[0];
+      }
+      TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(spill_directory_));
+      return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+    }
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      mutex_lock l(mu_);
+      while (input_impl_ && num_elements_ < dataset()->buffer_size_) {
+        std::vector<Tensor> input_element;
+        bool end_of_input_sequence = false;
+        TF_RETURN_IF_ERROR(
+            input_impl_->GetNext(ctx, &input_element, &end_of_input_sequence));
+        if (end_of_input_sequence) {
+          input_impl_.reset();
+          break;
+        }
+        TF_RETURN_IF_ERROR(AddElement(ctx, std::move(input_element)));
+      }
+
+      if (num_elements_ == 0) {
+        *end_of_sequence = true;
+        return Status::OK();
+      }
+      *end_of_sequence = false;
+
+      // Choose the element to produce uniformly at random from the buffer.
+      uint64 index = RandomIndex(num_elements_);
+      num_elements_--;
+      if (index < memory_.size()) {
+        *out_tensors = std::move(memory_[index]);
+        std::swap(memory_[index], memory_.back());
+        memory_.pop_back();
+        memory_bytes_ -= GetAllocatedBytes(*out_tensors);
+        RecordBufferDequeue(ctx, *out_tensors);
+        return Status::OK();
+      }
+      index -= memory_.size();
+      for (auto it = runs_.begin(); it != runs_.end(); ++it) {
+        Run* run = it->get();
+        if (index >= run->num_elements) {
+          index -= run->num_elements;
+          continue;
+        }
+        TF_RETURN_IF_ERROR(run->ReadElement(dataset()->output_dtypes().size(),
+                                            out_tensors));
+        if (run->num_elements == 0) {
+          runs_.erase(it);
+        }
+        return Status::OK();
+      }
+      return errors::Internal("Unreachable point in SpillingShuffleDataset");
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeKnownRatioNode(std::move(args),
+                                       /*ratio=*/1);
+    }
+
+    Status SaveInternal(IteratorStateWriter* writer) override {
+      mutex_lock l(mu_);
+      if (!runs_.empty()) {
+        return errors::Unimplemented(
+            "SpillingShuffleDataset does not support checkpointing once it "
+            "has spilled elements to disk.");
+      }
+      // Save state needed to restore the random number generators.
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kNumRandomSamples),
+                                             num_random_samples_));
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kSeedKey), seed_));
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kSeed2Key), seed2_));
+
+      if (!input_impl_) {
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kEndOfInputSequence), ""));
+      } else {
+        TF_RETURN_IF_ERROR(SaveInput(writer, input_impl_));
+      }
+
+      TF_RETURN_IF_ERROR(
+          writer->WriteScalar(full_name(strings::StrCat(kBuffer, "_", kSize)),
+                              memory_.size()));
+      for (size_t i = 0; i < memory_.size(); ++i) {
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(strings::StrCat(kBuffer, "_", i, "_", kSize)),
+            memory_[i].size()));
+        for (size_t j = 0; j < memory_[i].size(); ++j) {
+          TF_RETURN_IF_ERROR(writer->WriteTensor(
+              full_name(strings::StrCat(kBuffer, "_", i, "_", j)),
+              memory_[i][j]));
+        }
+      }
+      return Status::OK();
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kNumRandomSamples),
+                                            &num_random_samples_));
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kSeedKey), &seed_));
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kSeed2Key), &seed2_));
+      ResetRngs();
+
+      if (!reader->Contains(full_name(kEndOfInputSequence))) {
+        TF_RETURN_IF_ERROR(
+            dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
+        TF_RETURN_IF_ERROR(RestoreInput(ctx, reader, input_impl_));
+      } else {
+        input_impl_.reset();
+      }
+
+      runs_.clear();
+      memory_.clear();
+      memory_bytes_ = 0;
+      int64 buffer_size;
+      TF_RETURN_IF_ERROR(reader->ReadScalar(
+          full_name(strings::StrCat(kBuffer, "_", kSize)), &buffer_size));
+      for (int64 i = 0; i < buffer_size; ++i) {
+        int64 element_size;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(
+            full_name(strings::StrCat(kBuffer, "_", i, "_", kSize)),
+            &element_size));
+        std::vector<Tensor> element(element_size);
+        for (int64 j = 0; j < element_size; ++j) {
+          TF_RETURN_IF_ERROR(reader->ReadTensor(
+              full_name(strings::StrCat(kBuffer, "_", i, "_", j)),
+              &element[j]));
+        }
+        memory_bytes_ += GetAllocatedBytes(element);
+        memory_.push_back(std::move(element));
+      }
+      num_elements_ = memory_.size();
+      return Status::OK();
+    }
+
+   private:
+    // A file of spilled elements, in random order. The file is deleted once
+    // all its elements have been read or when the run is destroyed.
+    class Run {
+     public:
+      Run(Env* env, string filename, int64 num_elements)
+          : num_elements(num_elements),
+            env_(env),
+            filename_(std::move(filename)) {}
+
+      ~Run() {
+        reader_.reset();
+        file_.reset();
+        Status s = env_->DeleteFile(filename_);
+        if (!s.ok()) {
+          LOG(WARNING) << "Failed to delete " << filename_ << ": " << s;
+        }
+      }
+
+      Status Open(int64 buffer_size) {
+        TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(filename_, &file_));
+        io::RecordReaderOptions options;
+        options.buffer_size = buffer_size;
+        reader_ = absl::make_unique<io::SequentialRecordReader>(file_.get(),
+                                                                options);
+        return Status::OK();
+      }
+
+      // Reads the next element, which has `num_components` tensors.
+      Status ReadElement(size_t num_components,
+                         std::vector<Tensor>* element) {
+        element->clear();
+        element->reserve(num_components);
+        for (size_t i = 0; i < num_components; ++i) {
+          tstring record;
+          TF_RETURN_IF_ERROR(ReadRecord(&record));
+          TensorProto proto;
+          Tensor t;
+          if (!proto.ParseFromString(record) || !t.FromProto(proto)) {
+            return errors::DataLoss("Unable to parse a spilled tensor in ",
+                                    filename_);
+          }
+          element->push_back(std::move(t));
+        }
+        num_elements--;
+        return Status::OK();
+      }
+
+      // Copies the next element, which has `num_components` tensors, to
+      // `writer` without parsing it.
+      Status CopyElement(size_t num_components, io::RecordWriter* writer) {
+        for (size_t i = 0; i < num_components; ++i) {
+          tstring record;
+          TF_RETURN_IF_ERROR(ReadRecord(&record));
+          TF_RETURN_IF_ERROR(writer->WriteRecord(record));
+        }
+        num_elements--;
+        return Status::OK();
+      }
+
+      // The number of elements left to read.
+      int64 num_elements;
+
+     private:
+      Status ReadRecord(tstring* record) {
+        Status s = reader_->ReadRecord(record);
+        if (errors::IsOutOfRange(s)) {
+          return errors::DataLoss("Unexpected end of spilled elements in ",
+                                  filename_);
+        }
+        return s;
+      }
+
+      Env* const env_;
+      const string filename_;
+      std::unique_ptr<RandomAccessFile> file_;
+      std::unique_ptr<io::SequentialRecordReader> reader_;
+    };
+
+    Status AddElement(IteratorContext* ctx, std::vector<Tensor> element)
+        EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      RecordBufferEnqueue(ctx, element);
+      memory_bytes_ += GetAllocatedBytes(element);
+      memory_.push_back(std::move(element));
+      num_elements_++;
+      if (memory_bytes_ > dataset()->max_memory_bytes_ / 2) {
+        return SpillMemory(ctx);
+      }
+      return Status::OK();
+    }
+
+    // Shuffles the elements in memory and writes them to a new run.
+    Status SpillMemory(IteratorContext* ctx) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (runs_.size() >= static_cast<size_t>(kMaxNumRuns)) {
+        TF_RETURN_IF_ERROR(MergeRuns());
+      }
+      for (size_t i = memory_.size() - 1; i > 0; --i) {
+        std::swap(memory_[i], memory_[RandomIndex(i + 1)]);
+      }
+
+      const string filename = NewRunFilename();
+      // Create the run first, so that the file is deleted on errors.
+      auto run = absl::make_unique<Run>(env_, filename, memory_.size());
+      std::unique_ptr<WritableFile> file;
+      TF_RETURN_IF_ERROR(env_->NewWritableFile(filename, &file));
+      io::RecordWriter writer(file.get());
+      int64 num_bytes = 0;
+      for (const std::vector<Tensor>& element : memory_) {
+        for (const Tensor& t : element) {
+          TensorProto proto;
+          t.AsProtoTensorContent(&proto);
+          string record = proto.SerializeAsString();
+          num_bytes += record.size();
+          TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+        }
+        RecordBufferDequeue(ctx, element);
+      }
+      TF_RETURN_IF_ERROR(writer.Close());
+      TF_RETURN_IF_ERROR(file->Close());
+      TF_RETURN_IF_ERROR(run->Open(dataset()->run_read_buffer_size_));
+
+      VLOG(2) << "Spilled " << memory_.size() << " elements (" << num_bytes
+              << " bytes) to " << filename;
+      metrics::RecordTFDataBytesSpilled(kDatasetType, num_bytes);
+      runs_.push_back(std::move(run));
+      memory_.clear();
+      memory_bytes_ = 0;
+      return Status::OK();
+    }
+
+    // Merges the `kNumRunsToMerge` smallest runs into a new run. The next
+    // element of the new run is taken from one of the merged runs chosen in
+    // proportion to the number of elements it has left, so that the new run is
+    // a uniformly random permutation of their elements. Merging the smallest
+    // runs keeps the number of times each element is rewritten logarithmic in
+    // the number of spilled runs.
+    Status MergeRuns() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      std::sort(runs_.begin(), runs_.end(),
+                [](const std::unique_ptr<Run>& lhs,
+                   const std::unique_ptr<Run>& rhs) {
+                  return lhs->num_elements < rhs->num_elements;
+                });
+      std::vector<std::unique_ptr<Run>> sources;
+      int64 num_elements = 0;
+      for (int i = 0; i < kNumRunsToMerge; ++i) {
+        num_elements += runs_[i]->num_elements;
+        sources.push_back(std::move(runs_[i]));
+      }
+      runs_.erase(runs_.begin(), runs_.begin() + kNumRunsToMerge);
+
+      const string filename = NewRunFilename();
+      // Create the run first, so that the file is deleted on errors.
+      auto run = absl::make_unique<Run>(env_, filename, num_elements);
+      std::unique_ptr<WritableFile> file;
+      TF_RETURN_IF_ERROR(env_->NewWritableFile(filename, &file));
+      io::RecordWriter writer(file.get());
+      const size_t num_components = dataset()->output_dtypes().size();
+      for (int64 remaining = num_elements; remaining > 0; --remaining) {
+        uint64 index = RandomIndex(remaining);
+        for (const std::unique_ptr<Run>& source : sources) {
+          if (index < source->num_elements) {
+            TF_RETURN_IF_ERROR(source->CopyElement(num_components, &writer));
+            break;
+          }
+          index -= source->num_elements;
+        }
+      }
+      TF_RETURN_IF_ERROR(writer.Close());
+      TF_RETURN_IF_ERROR(file->Close());
+      // Release the read buffers of the merged runs before allocating the one
+      // of the new run.
+      sources.clear();
+      TF_RETURN_IF_ERROR(run->Open(dataset()->run_read_buffer_size_));
+
+      VLOG(2) << "Merged " << kNumRunsToMerge << " runs of " << num_elements
+              << " elements to " << filename;
+      runs_.push_back(std::move(run));
+      return Status::OK();
+    }
+
+    string NewRunFilename() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return io::JoinPath(
+          spill_directory_,
+          strings::StrCat("spilling_shuffle_",
+                          strings::Hex(random::New64(), strings::kZeroPad16),
+                          "_", num_runs_created_++, ".spill"));
+    }
+
+    void ResetRngs() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      // Reset the generators based on the current iterator seeds.
+      parent_generator_ = random::PhiloxRandom(seed_, seed2_);
+      generator_ =
+          random::SingleSampleAdapter<random::PhiloxRandom>(&parent_generator_);
+      generator_.Skip(num_random_samples_);
+    }
+
+    // Returns a random number in [0, n).
+    uint64 RandomIndex(uint64 n) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      uint64 value = Random();
+      if (n > kuint32max) {
+        value = (value << 32) | Random();
+      }
+      return value % n;
+    }
+
+    random::SingleSampleAdapter<random::PhiloxRandom>::ResultType Random()
+        EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      num_random_samples_++;
+      return generator_();
+    }
+
+    mutex mu_;
+    Env* env_ = nullptr;
+    string spill_directory_;
+    std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
+    // The elements of the buffer that are in memory, and their size.
+    std::vector<std::vector<Tensor>> memory_ GUARDED_BY(mu_);
+    int64 memory_bytes_ GUARDED_BY(mu_) = 0;
+    // The runs with elements left to read.
+    std::vector<std::unique_ptr<Run>> runs_ GUARDED_BY(mu_);
+    int64 num_runs_created_ GUARDED_BY(mu_) = 0;
+    // The number of elements in the buffer, in memory or in runs.
+    int64 num_elements_ GUARDED_BY(mu_) = 0;
+    int64 seed_ GUARDED_BY(mu_) = 0;
+    int64 seed2_ GUARDED_BY(mu_) = 0;
+    random::PhiloxRandom parent_generator_ GUARDED_BY(mu_);
+    random::SingleSampleAdapter<random::PhiloxRandom> generator_
+        GUARDED_BY(mu_);
+    int64 num_random_samples_ GUARDED_BY(mu_) = 0;
+  };
+
+  const DatasetBase* const input_;
+  const int64 buffer_size_;
+  const int64 seed_;
+  const int64 seed2_;
+  const int64 max_memory_bytes_;
+  // The size of the read buffer of each run, so that the read buffers of at
+  // most `kMaxNumRuns` runs take at most half of `max_memory_bytes_`.
+  const int64 run_read_buffer_size_;
+  const tstring spill_directory_;
+};
+
+SpillingShuffleDatasetOp::SpillingShuffleDatasetOp(OpKernelConstruction* ctx)
+    : UnaryDatasetOpKernel(ctx) {}
+
+void SpillingShuffleDatasetOp::MakeDataset(OpKernelContext* ctx,
+                                           DatasetBase* input,
+                                           DatasetBase** output) {
+  int64 buffer_size;
+  int64 seed;
+  int64 seed2;
+  int64 max_memory_bytes;
+  tstring spill_directory;
+  OP_REQUIRES_OK(ctx,
+                 ParseScalarArgument<int64>(ctx, kBufferSize, &buffer_size));
+  OP_REQUIRES(
+      ctx, buffer_size > 0,
+      errors::InvalidArgument("buffer_size must be greater than zero."));
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, kSeed, &seed));
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, kSeed2, &seed2));
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, kMaxMemoryBytes,
+                                                 &max_memory_bytes));
+  OP_REQUIRES(ctx, max_memory_bytes >= kMinMaxMemoryBytes,
+              errors::InvalidArgument("max_memory_bytes must be at least ",
+                                      kMinMaxMemoryBytes, " but was ",
+                                      max_memory_bytes, "."));
+  OP_REQUIRES_OK(ctx, ParseScalarArgument<tstring>(ctx, kSpillDirectory,
+                                                   &spill_directory));
+  *output = new Dataset(ctx, input, buffer_size, seed, seed2, max_memory_bytes,
+                        spill_directory);
+}
+
+namespace {
+REGISTER_KERNEL_BUILDER(Name("SpillingShuffleDataset").Device(DEVICE_CPU),
+                        SpillingShuffleDatasetOp);
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -14,12 +14,18 @@ limitations under the License.
 ==============================================================================*/
 #include <memory>
 
+#include "tensorflow/core/common_runtime/metrics.h"
+#include "tensorflow/core/common_runtime/process_state.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/thread_factory.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
 #include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/core/threadpool_interface.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
@@ -27,13 +33,138 @@ namespace data {
 namespace experimental {
 namespace {
 
+// Runs `fn` with the current thread pinned to `numa_node`. The threads that
+// run iterator threads and scheduled work are shared with other pipelines, so
+// the previous affinity is restored afterwards, which unpins threads that were
+// not pinned to any node.
+void RunOnNumaNode(int numa_node, const std::function<void()>& fn) {
+  const int previous_numa_node = port::NUMAGetThreadNodeAffinity();
+  if (previous_numa_node != numa_node) {
+    port::NUMASetThreadNodeAffinity(numa_node);
+  }
+  fn();
+  if (previous_numa_node != numa_node) {
+    port::NUMASetThreadNodeAffinity(previous_numa_node);
+  }
+}
+
+// Starts threads pinned to a NUMA node, using `base` (or the default `Env` if
+// it is null) to create them.
+class NumaThreadFactory : public ThreadFactory {
+ public:
+  NumaThreadFactory(std::shared_ptr<ThreadFactory> base, int numa_node)
+      : base_(std::move(base)), numa_node_(numa_node) {}
+
+  std::unique_ptr<Thread> StartThread(const string& name,
+                                      std::function<void()> fn) override {
+    std::function<void()> pinned_fn =
+        std::bind(&RunOnNumaNode, numa_node_, std::move(fn));
+    if (base_) {
+      return base_->StartThread(name, std::move(pinned_fn));
+    }
+    return absl::WrapUnique(
+        Env::Default()->StartThread({}, name, std::move(pinned_fn)));
+  }
+
+ private:
+  const std::shared_ptr<ThreadFactory> base_;
+  const int numa_node_;
+};
+
+// Schedules work on `base` pinned to a NUMA node.
+class NumaThreadPool : public thread::ThreadPoolInterface {
+ public:
+  NumaThreadPool(thread::ThreadPoolInterface* base, int numa_node)
+      : base_(base), numa_node_(numa_node) {}
+
+  void Schedule(std::function<void()> fn) override {
+    base_->Schedule(std::bind(&RunOnNumaNode, numa_node_, std::move(fn)));
+  }
+
+  int NumThreads() const override { return base_->NumThreads(); }
+
+  int CurrentThreadId() const override { return base_->CurrentThreadId(); }
+
+ private:
+  thread::ThreadPoolInterface* const base_;  // Not owned.
+  const int numa_node_;
+};
+
+// Places the work of the iterators below a dataset on a NUMA node: their
+// threads are pinned to the node and, when NUMA allocators are enabled in the
+// `ProcessState`, their elements are allocated from the node's memory.
+// Otherwise, freshly allocated pages land on the node by first touch, since
+// the threads that fill them are pinned.
+class NumaPlacement {
+ public:
+  NumaPlacement(const string& dataset_type, int numa_node)
+      : dataset_type_(dataset_type), numa_node_(numa_node) {}
+
+  // Pins the threads that `ctx` creates and schedules work on.
+  void Initialize(IteratorContext* ctx) {
+    thread_factory_ =
+        std::make_shared<NumaThreadFactory>(ctx->thread_factory(), numa_node_);
+    if (ctx->thread_pool()) {
+      thread_pool_ =
+          absl::make_unique<NumaThreadPool>(ctx->thread_pool(), numa_node_);
+    }
+  }
+
+  void UpdateParams(IteratorContext::Params* params) const {
+    params->thread_factory = thread_factory_;
+    if (thread_pool_) {
+      params->thread_pool = thread_pool_.get();
+    }
+    if (port::NUMAEnabled()) {
+      const int numa_node = numa_node_;
+      params->allocator_getter = [numa_node](AllocatorAttributes) {
+        return ProcessState::singleton()->GetCPUAllocator(numa_node);
+      };
+    }
+  }
+
+  // Records the bytes of `tensors` that reside on another NUMA node than the
+  // one of the consuming thread, or than `numa_node_` if the consuming thread
+  // is not pinned.
+  void RecordCrossNodeBytes(const std::vector<Tensor>& tensors) const {
+    if (!port::NUMAEnabled()) {
+      return;
+    }
+    int consumer_numa_node = port::NUMAGetThreadNodeAffinity();
+    if (consumer_numa_node == port::kNUMANoAffinity) {
+      consumer_numa_node = numa_node_;
+    }
+    int64 num_bytes = 0;
+    for (const Tensor& t : tensors) {
+      if (!DataTypeCanUseMemcpy(t.dtype()) || t.TotalBytes() == 0) {
+        continue;
+      }
+      const int numa_node = port::NUMAGetMemAffinity(t.tensor_data().data());
+      if (numa_node != port::kNUMANoAffinity &&
+          numa_node != consumer_numa_node) {
+        num_bytes += t.TotalBytes();
+      }
+    }
+    if (num_bytes > 0) {
+      metrics::RecordTFDataCrossNumaNodeBytes(dataset_type_, num_bytes);
+    }
+  }
+
+ private:
+  const string dataset_type_;
+  const int numa_node_;
+  std::shared_ptr<ThreadFactory> thread_factory_;
+  std::unique_ptr<NumaThreadPool> thread_pool_;
+};
+
 class ThreadPoolResource : public ResourceBase {
  public:
   ThreadPoolResource(Env* env, const ThreadOptions& thread_options,
                      const string& name, int num_threads, bool low_latency_hint,
                      int max_intra_op_parallelism)
       : thread_pool_(env, thread_options, name, num_threads, low_latency_hint),
-        max_intra_op_parallelism_(max_intra_op_parallelism) {}
+        max_intra_op_parallelism_(max_intra_op_parallelism),
+        numa_node_(thread_options.numa_node) {}
 
   // Schedules fn() for execution in the pool of threads.
   void Schedule(std::function<void()> fn) {
@@ -53,11 +184,15 @@ class ThreadPoolResource : public ResourceBase {
 
   int32 NumThreads() { return thread_pool_.NumThreads(); }
 
+  // The NUMA node that the threads are pinned to, or `port::kNUMANoAffinity`.
+  int numa_node() const { return numa_node_; }
+
   string DebugString() const override { return "ThreadPoolResource"; }
 
  private:
   thread::ThreadPool thread_pool_;
   const int max_intra_op_parallelism_;
+  const int numa_node_;
 };
 
 // Creates a handle to a ThreadPool resource. Note that we don't use
@@ -74,6 +209,12 @@ class ThreadPoolHandleOp : public OpKernel {
     OP_REQUIRES(
         ctx, num_threads_ > 0,
         errors::InvalidArgument("`num_threads` must be greater than zero."));
+    // The deprecated `ExperimentalThreadPoolHandle` op has no `numa_node`.
+    if (ctx->HasAttr("numa_node")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("numa_node", &numa_node_));
+      OP_REQUIRES(ctx, numa_node_ >= port::kNUMANoAffinity,
+                  errors::InvalidArgument("`numa_node` must be >= -1."));
+    }
   }
 
   // The resource is deleted from the resource manager only when it is private
@@ -99,9 +240,11 @@ class ThreadPoolHandleOp : public OpKernel {
                               cinfo_.container(), cinfo_.name(), &resource,
                               [this, ctx](ThreadPoolResource** ret)
                                   EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+                                    ThreadOptions thread_options;
+                                    thread_options.numa_node = numa_node_;
                                     *ret = new ThreadPoolResource(
-                                        ctx->env(), {}, display_name_,
-                                        num_threads_,
+                                        ctx->env(), thread_options,
+                                        display_name_, num_threads_,
                                         /*low_latency_hint=*/false,
                                         max_intra_op_parallelism_);
                                     return Status::OK();
@@ -120,6 +263,7 @@ class ThreadPoolHandleOp : public OpKernel {
   string display_name_;
   int num_threads_;
   int max_intra_op_parallelism_;
+  int numa_node_ = port::kNUMANoAffinity;
 };
 
 class ThreadPoolDatasetOp : public UnaryDatasetOpKernel {
@@ -196,6 +340,12 @@ class ThreadPoolDatasetOp : public UnaryDatasetOpKernel {
           : DatasetIterator<Dataset>(params) {}
 
       Status Initialize(IteratorContext* ctx) override {
+        const int numa_node = dataset()->threadpool_->numa_node();
+        if (numa_node != port::kNUMANoAffinity) {
+          numa_placement_ =
+              absl::make_unique<NumaPlacement>("ThreadPool", numa_node);
+          numa_placement_->Initialize(ctx);
+        }
         return dataset()->input_->MakeIterator(
             IteratorContext(CreateParams(ctx)), prefix(), &input_impl_);
       }
@@ -203,8 +353,12 @@ class ThreadPoolDatasetOp : public UnaryDatasetOpKernel {
       Status GetNextInternal(IteratorContext* ctx,
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
-        return input_impl_->GetNext(IteratorContext(CreateParams(ctx)),
-                                    out_tensors, end_of_sequence);
+        TF_RETURN_IF_ERROR(input_impl_->GetNext(
+            IteratorContext(CreateParams(ctx)), out_tensors, end_of_sequence));
+        if (numa_placement_ && !*end_of_sequence) {
+          numa_placement_->RecordCrossNodeBytes(*out_tensors);
+        }
+        return Status::OK();
       }
 
      protected:
@@ -222,9 +376,14 @@ class ThreadPoolDatasetOp : public UnaryDatasetOpKernel {
           pool->Schedule(std::move(c));
         };
         params.runner_threadpool_size = pool->NumThreads();
+        if (numa_placement_) {
+          numa_placement_->UpdateParams(&params);
+        }
         return params;
       }
 
+      // Declared before `input_impl_`, whose threads it may have started.
+      std::unique_ptr<NumaPlacement> numa_placement_;
       std::unique_ptr<IteratorBase> input_impl_;
     };
 
@@ -341,27 +500,52 @@ class MaxIntraOpParallelismDatasetOp : public UnaryDatasetOpKernel {
 class PrivateThreadPoolDatasetOp : public UnaryDatasetOpKernel {
  public:
   explicit PrivateThreadPoolDatasetOp(OpKernelConstruction* ctx)
-      : UnaryDatasetOpKernel(ctx) {}
+      : UnaryDatasetOpKernel(ctx) {
+    // The deprecated `ExperimentalPrivateThreadPoolDataset` op has no
+    // `numa_node`.
+    if (ctx->HasAttr("numa_node")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("numa_node", &numa_node_));
+      OP_REQUIRES(ctx, numa_node_ >= port::kNUMANoAffinity,
+                  errors::InvalidArgument("`numa_node` must be >= -1."));
+    }
+  }
 
   void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                    DatasetBase** output) override {
     int64 num_threads = 0;
     OP_REQUIRES_OK(
         ctx, ParseScalarArgument<int64>(ctx, "num_threads", &num_threads));
-    OP_REQUIRES(ctx, num_threads >= 1,
-                errors::InvalidArgument("`num_threads` must be >= 1"));
-    *output = new Dataset(ctx, input, num_threads);
+    if (numa_node_ == port::kNUMANoAffinity) {
+      OP_REQUIRES(ctx, num_threads >= 1,
+                  errors::InvalidArgument("`num_threads` must be >= 1"));
+    } else {
+      OP_REQUIRES(ctx, num_threads >= 0,
+                  errors::InvalidArgument(
+                      "`num_threads` must be >= 0 when `numa_node` is set"));
+    }
+    *output = new Dataset(ctx, input, num_threads, numa_node_);
   }
 
  private:
   class Dataset : public DatasetBase {
    public:
-    Dataset(OpKernelContext* ctx, const DatasetBase* input, int num_threads)
+    Dataset(OpKernelContext* ctx, const DatasetBase* input, int num_threads,
+            int numa_node)
         : DatasetBase(DatasetContext(ctx)),
           input_(input),
-          num_threads_(num_threads) {
+          num_threads_(num_threads),
+          numa_node_(numa_node) {
+      int pool_size = num_threads;
+      ThreadOptions thread_options;
+      if (numa_node != port::kNUMANoAffinity) {
+        if (pool_size == 0) {
+          pool_size = port::MaxParallelism(numa_node);
+        }
+        thread_options.numa_node = numa_node;
+      }
+      pool_size_ = pool_size;
       thread_pool_ = absl::make_unique<thread::ThreadPool>(
-          ctx->env(), ThreadOptions{}, "data_private_threadpool", num_threads,
+          ctx->env(), thread_options, "data_private_threadpool", pool_size,
           /*low_latency_hint=*/false);
       input_->Ref();
     }
@@ -399,8 +583,17 @@ class PrivateThreadPoolDatasetOp : public UnaryDatasetOpKernel {
       TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
       Node* num_threads_node = nullptr;
       TF_RETURN_IF_ERROR(b->AddScalar(num_threads_, &num_threads_node));
-      TF_RETURN_IF_ERROR(
-          b->AddDataset(this, {input_graph_node, num_threads_node}, output));
+      // Only set `numa_node` when it differs from its default, so that
+      // datasets created by the deprecated op, which lacks the attribute,
+      // still serialize.
+      std::vector<std::pair<StringPiece, AttrValue>> attrs;
+      if (numa_node_ != port::kNUMANoAffinity) {
+        AttrValue numa_node_attr;
+        b->BuildAttrValue(numa_node_, &numa_node_attr);
+        attrs.emplace_back("numa_node", numa_node_attr);
+      }
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this, {input_graph_node, num_threads_node}, attrs, output));
       return Status::OK();
     }
 
@@ -411,7 +604,16 @@ class PrivateThreadPoolDatasetOp : public UnaryDatasetOpKernel {
           : DatasetIterator<Dataset>(params) {}
 
       Status Initialize(IteratorContext* ctx) override {
-        return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+        if (dataset()->numa_node_ == port::kNUMANoAffinity) {
+          return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+        }
+        numa_placement_ = absl::make_unique<NumaPlacement>(
+            "PrivateThreadPool", dataset()->numa_node_);
+        numa_placement_->Initialize(ctx);
+        IteratorContext::Params params(ctx);
+        numa_placement_->UpdateParams(&params);
+        return dataset()->input_->MakeIterator(
+            IteratorContext(std::move(params)), prefix(), &input_impl_);
       }
 
       Status GetNextInternal(IteratorContext* ctx,
@@ -422,9 +624,16 @@ class PrivateThreadPoolDatasetOp : public UnaryDatasetOpKernel {
         params.runner = [pool](std::function<void()> c) {
           pool->Schedule(std::move(c));
         };
-        params.runner_threadpool_size = dataset()->num_threads_;
-        return input_impl_->GetNext(IteratorContext{std::move(params)},
-                                    out_tensors, end_of_sequence);
+        params.runner_threadpool_size = dataset()->pool_size_;
+        if (numa_placement_) {
+          numa_placement_->UpdateParams(&params);
+        }
+        TF_RETURN_IF_ERROR(input_impl_->GetNext(
+            IteratorContext{std::move(params)}, out_tensors, end_of_sequence));
+        if (numa_placement_ && !*end_of_sequence) {
+          numa_placement_->RecordCrossNodeBytes(*out_tensors);
+        }
+        return Status::OK();
       }
 
      protected:
@@ -435,13 +644,19 @@ class PrivateThreadPoolDatasetOp : public UnaryDatasetOpKernel {
       }
 
      private:
+      // Declared before `input_impl_`, whose threads it may have started.
+      std::unique_ptr<NumaPlacement> numa_placement_;
       std::unique_ptr<IteratorBase> input_impl_;
     };
 
     const DatasetBase* const input_;
     const int64 num_threads_;
+    const int numa_node_;
+    int pool_size_;
     std::unique_ptr<thread::ThreadPool> thread_pool_;
   };
+
+  int numa_node_ = port::kNUMANoAffinity;
 };
 
 REGISTER_KERNEL_BUILDER(Name("MaxIntraOpParallelismDataset").Device(DEVICE_CPU),
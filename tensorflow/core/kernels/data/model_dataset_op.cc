@@ -19,8 +19,10 @@ limitations under the License.
 #include "tensorflow/core/framework/model.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/ptr_util.h"
 
 namespace tensorflow {
@@ -32,6 +34,10 @@ constexpr int64 kOptimizationPeriodThresholdMs = 60 * EnvTime::kSecondsToMillis;
 // Default share of available RAM that can be used by model's internal buffers.
 constexpr double kRamBudgetShare = 0.5;
 
+// If set, each iterator records a trace of its autotuning rounds in a new file
+// in this directory, which can be replayed with `model::Model::ReplayTrace()`.
+constexpr char kAutotuneTraceDirEnvVar[] = "TF_DATA_AUTOTUNE_TRACE_DIR";
+
 class ModelDatasetOp : public UnaryDatasetOpKernel {
  public:
   explicit ModelDatasetOp(OpKernelConstruction* ctx)
@@ -125,6 +131,16 @@ class ModelDatasetOp : public UnaryDatasetOpKernel {
       }
 
       Status Initialize(IteratorContext* ctx) override {
+        string trace_dir;
+        TF_RETURN_IF_ERROR(
+            ReadStringFromEnvVar(kAutotuneTraceDirEnvVar, "", &trace_dir));
+        if (!trace_dir.empty()) {
+          TF_RETURN_IF_ERROR(ctx->env()->RecursivelyCreateDir(trace_dir));
+          TF_RETURN_IF_ERROR(model_->StartTrace(
+              ctx->env(),
+              io::JoinPath(trace_dir, strings::StrCat("autotune_trace_",
+                                                      random::New64()))));
+        }
         IteratorContext::Params params(ctx);
         params.model = model_;
         return dataset()->input_->MakeIterator(
@@ -14,12 +14,18 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
+#include <algorithm>
+
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/stats_aggregator.h"
 #include "tensorflow/core/kernels/data/name_utils.h"
+#include "tensorflow/core/kernels/data/stats_utils.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/io/mapped_record_reader.h"
+#include "tensorflow/core/lib/io/parallel_record_reader.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
@@ -35,6 +41,9 @@ namespace data {
 /* static */ constexpr const char* const TFRecordDatasetOp::kFileNames;
 /* static */ constexpr const char* const TFRecordDatasetOp::kCompressionType;
 /* static */ constexpr const char* const TFRecordDatasetOp::kBufferSize;
+/* static */ constexpr const char* const
+    TFRecordDatasetOp::kNumParallelBlockReads;
+/* static */ constexpr const char* const TFRecordDatasetOp::kUseMmap;
 
 constexpr char kCurrentFileIndex[] = "current_file_index";
 constexpr char kOffset[] = "offset";
@@ -42,15 +51,20 @@ constexpr char kOffset[] = "offset";
 class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
-                   const string& compression_type, int64 buffer_size)
+                   const string& compression_type, int64 buffer_size,
+                   int64 num_parallel_block_reads, bool use_mmap)
       : DatasetBase(DatasetContext(ctx)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
         options_(io::RecordReaderOptions::CreateRecordReaderOptions(
-            compression_type)) {
+            compression_type)),
+        num_parallel_block_reads_(num_parallel_block_reads),
+        use_mmap_(use_mmap) {
     if (buffer_size > 0) {
       options_.buffer_size = buffer_size;
+      parallel_options_.block_size = buffer_size;
     }
+    parallel_options_.num_parallel_reads = num_parallel_block_reads;
   }
 
   std::unique_ptr<IteratorBase> MakeIteratorInternal(
@@ -86,11 +100,32 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(compression_type_, &compression_type));
     Node* buffer_size = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(options_.buffer_size, &buffer_size));
+    AttrValue num_parallel_block_reads;
+    b->BuildAttrValue(num_parallel_block_reads_, &num_parallel_block_reads);
+    AttrValue use_mmap;
+    b->BuildAttrValue(use_mmap_, &use_mmap);
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {filenames, compression_type, buffer_size}, output));
+        this, {filenames, compression_type, buffer_size},
+        {std::make_pair(kNumParallelBlockReads, num_parallel_block_reads),
+         std::make_pair(kUseMmap, use_mmap)},
+        output));
     return Status::OK();
   }
 
+  // Whether the files are read with an `io::ParallelRecordReader`. Compressed
+  // files can only be read sequentially.
+  bool use_parallel_reads() const {
+    return num_parallel_block_reads_ > 0 && !use_mmap_ &&
+           options_.compression_type == io::RecordReaderOptions::NONE;
+  }
+
+  // Whether the files are read with an `io::MappedRecordReader` where the
+  // filesystem supports it. Compressed files cannot be read in place.
+  bool use_mapped_reads() const {
+    return use_mmap_ &&
+           options_.compression_type == io::RecordReaderOptions::NONE;
+  }
+
  private:
   class Iterator : public DatasetIterator<Dataset> {
    public:
@@ -101,13 +136,15 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       mutex_lock l(mu_);
+      if (dataset()->use_parallel_reads()) {
+        return GetNextParallelLocked(ctx, out_tensors, end_of_sequence);
+      }
       do {
         // We are currently processing a file, so try to read the next record.
-        if (reader_) {
+        if (reader_ || mapped_reader_) {
           out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
                                     TensorShape({}));
-          Status s =
-              reader_->ReadRecord(&out_tensors->back().scalar<tstring>()());
+          Status s = ReadRecordLocked(&out_tensors->back().scalar<tstring>()());
           if (s.ok()) {
             metrics::RecordTFDataBytesRead(
                 kDatasetType, out_tensors->back().scalar<tstring>()().size());
@@ -155,6 +192,15 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         TF_RETURN_IF_ERROR(
             writer->WriteScalar(full_name(kOffset), reader_->TellOffset()));
       }
+      if (mapped_reader_) {
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name(kOffset), static_cast<int64>(mapped_offset_)));
+      }
+      if (parallel_reader_ &&
+          current_file_index_ < dataset()->filenames_.size()) {
+        const int64 offset = parallel_reader_->offset();
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kOffset), offset));
+      }
       return Status::OK();
     }
 
@@ -169,13 +215,88 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       if (reader->Contains(full_name(kOffset))) {
         int64 offset;
         TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kOffset), &offset));
+        if (dataset()->use_parallel_reads()) {
+          SetupParallelReaderLocked(ctx, offset);
+          return Status::OK();
+        }
         TF_RETURN_IF_ERROR(SetupStreamsLocked(ctx->env()));
+        if (mapped_reader_) {
+          mapped_offset_ = offset;
+          return Status::OK();
+        }
         TF_RETURN_IF_ERROR(reader_->SeekOffset(offset));
       }
       return Status::OK();
     }
 
    private:
+    // Reads the next record of the current file into `*record`.
+    Status ReadRecordLocked(tstring* record) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (!mapped_reader_) {
+        return reader_->ReadRecord(record);
+      }
+      StringPiece data;
+      TF_RETURN_IF_ERROR(mapped_reader_->ReadRecord(&mapped_offset_, &data));
+      record->assign(data.data(), data.size());
+      return Status::OK();
+    }
+
+    Status GetNextParallelLocked(IteratorContext* ctx,
+                                 std::vector<Tensor>* out_tensors,
+                                 bool* end_of_sequence)
+        EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (!parallel_reader_) {
+        if (current_file_index_ >= dataset()->filenames_.size()) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        SetupParallelReaderLocked(ctx, 0);
+      }
+      out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
+                                TensorShape({}));
+      tstring* record = &out_tensors->back().scalar<tstring>()();
+      // The reader moves on to the next file after an error, so that this
+      // works with ignore_errors.
+      Status s = parallel_reader_->ReadRecord(record);
+      current_file_index_ = parallel_reader_->file_index();
+      if (!s.ok()) {
+        out_tensors->pop_back();
+        if (errors::IsOutOfRange(s)) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        return s;
+      }
+      metrics::RecordTFDataBytesRead(kDatasetType, record->size());
+      const auto& stats_aggregator = ctx->stats_aggregator();
+      if (stats_aggregator) {
+        const uint64 elapsed_micros =
+            std::max<uint64>(ctx->env()->NowMicros() - start_micros_, 1);
+        stats_aggregator->AddScalar(
+            stats_utils::ReadThroughputScalarName(dataset()->node_name()),
+            static_cast<float>(parallel_reader_->bytes_read()) * 1e6 /
+                elapsed_micros,
+            num_elements());
+      }
+      *end_of_sequence = false;
+      return Status::OK();
+    }
+
+    // Sets up a parallel reader of the files, from `offset` in the file at
+    // `current_file_index_`.
+    void SetupParallelReaderLocked(IteratorContext* ctx, int64 offset)
+        EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (!thread_pool_) {
+        thread_pool_ = ctx->CreateThreadPool(
+            "tf_record_block_reads", dataset()->num_parallel_block_reads_);
+      }
+      parallel_reader_.reset();
+      parallel_reader_ = absl::make_unique<io::ParallelRecordReader>(
+          ctx->env(), dataset()->filenames_, current_file_index_, offset,
+          dataset()->parallel_options_, thread_pool_.get());
+      start_micros_ = ctx->env()->NowMicros();
+    }
+
     // Sets up reader streams to read from the file at `current_file_index_`.
     Status SetupStreamsLocked(Env* env) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (current_file_index_ >= dataset()->filenames_.size()) {
@@ -186,6 +307,18 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
 
       // Actually move on to next file.
       const string& next_filename = dataset()->filenames_[current_file_index_];
+      if (dataset()->use_mapped_reads()) {
+        Status s =
+            io::MappedRecordReader::Create(env, next_filename, &mapped_reader_);
+        if (s.ok()) {
+          mapped_offset_ = 0;
+          return Status::OK();
+        }
+        // Fall back to buffered reads on filesystems without memory mapping.
+        if (!errors::IsUnimplemented(s)) {
+          return s;
+        }
+      }
       TF_RETURN_IF_ERROR(env->NewRandomAccessFile(next_filename, &file_));
       reader_ = absl::make_unique<io::SequentialRecordReader>(
           file_.get(), dataset()->options_);
@@ -196,6 +329,8 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     void ResetStreamsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       reader_.reset();
       file_.reset();
+      mapped_reader_.reset();
+      parallel_reader_.reset();
     }
 
     mutex mu_;
@@ -205,15 +340,34 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ GUARDED_BY(mu_);
     std::unique_ptr<io::SequentialRecordReader> reader_ GUARDED_BY(mu_);
+
+    // Used instead of `reader_` if `dataset()->use_mapped_reads()` and the
+    // file could be memory-mapped, along with the offset of its next record.
+    std::unique_ptr<io::MappedRecordReader> mapped_reader_ GUARDED_BY(mu_);
+    uint64 mapped_offset_ GUARDED_BY(mu_) = 0;
+
+    // Used instead of `reader_` if `dataset()->use_parallel_reads()`. The
+    // reader must be destroyed before the thread pool it runs on.
+    std::unique_ptr<thread::ThreadPool> thread_pool_ GUARDED_BY(mu_);
+    std::unique_ptr<io::ParallelRecordReader> parallel_reader_
+        GUARDED_BY(mu_);
+    uint64 start_micros_ GUARDED_BY(mu_) = 0;
   };
 
   const std::vector<string> filenames_;
   const tstring compression_type_;
   io::RecordReaderOptions options_;
+  const int64 num_parallel_block_reads_;
+  const bool use_mmap_;
+  io::ParallelRecordReader::Options parallel_options_;
 };
 
 TFRecordDatasetOp::TFRecordDatasetOp(OpKernelConstruction* ctx)
-    : DatasetOpKernel(ctx) {}
+    : DatasetOpKernel(ctx) {
+  OP_REQUIRES_OK(
+      ctx, ctx->GetAttr(kNumParallelBlockReads, &num_parallel_block_reads_));
+  OP_REQUIRES_OK(ctx, ctx->GetAttr(kUseMmap, &use_mmap_));
+}
 
 void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
                                     DatasetBase** output) {
@@ -241,8 +395,8 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
               errors::InvalidArgument(
                   "`buffer_size` must be >= 0 (0 == no buffering)"));
 
-  *output =
-      new Dataset(ctx, std::move(filenames), compression_type, buffer_size);
+  *output = new Dataset(ctx, std::move(filenames), compression_type,
+                        buffer_size, num_parallel_block_reads_, use_mmap_);
 }
 
 namespace {
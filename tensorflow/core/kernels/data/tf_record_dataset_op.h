@@ -26,6 +26,9 @@ class TFRecordDatasetOp : public DatasetOpKernel {
   static constexpr const char* const kFileNames = "filenames";
   static constexpr const char* const kCompressionType = "compression_type";
   static constexpr const char* const kBufferSize = "buffer_size";
+  static constexpr const char* const kNumParallelBlockReads =
+      "num_parallel_block_reads";
+  static constexpr const char* const kUseMmap = "use_mmap";
 
   explicit TFRecordDatasetOp(OpKernelConstruction* ctx);
 
@@ -34,6 +37,9 @@ class TFRecordDatasetOp : public DatasetOpKernel {
 
  private:
   class Dataset;
+
+  int64 num_parallel_block_reads_;
+  bool use_mmap_;
 };
 
 }  // namespace data
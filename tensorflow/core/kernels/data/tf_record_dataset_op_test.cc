@@ -24,12 +24,14 @@ class TFRecordDatasetOpTest : public DatasetOpsTestBase {
  protected:
   // Create a new `TFRecordDataset` op kernel.
   Status CreateTFRecordDatasetOpKernel(
+      int64 num_parallel_block_reads, bool use_mmap,
       std::unique_ptr<OpKernel>* tf_record_dataset_op_kernel) {
     NodeDef node_def = test::function::NDef(
         kNodeName, name_utils::OpName(TFRecordDatasetOp::kDatasetType),
         {TFRecordDatasetOp::kFileNames, TFRecordDatasetOp::kCompressionType,
          TFRecordDatasetOp::kBufferSize},
-        {});
+        {{TFRecordDatasetOp::kNumParallelBlockReads, num_parallel_block_reads},
+         {TFRecordDatasetOp::kUseMmap, use_mmap}});
     TF_RETURN_IF_ERROR(CreateOpKernel(node_def, tf_record_dataset_op_kernel));
     return Status::OK();
   }
@@ -55,6 +57,8 @@ struct TestCase {
   std::vector<PartialTensorShape> expected_output_shapes;
   int64 expected_cardinality;
   std::vector<int> breakpoints;
+  int64 num_parallel_block_reads = 0;
+  bool use_mmap = false;
 };
 
 Status CreateTestFiles(const TestCase& test_case) {
@@ -139,6 +143,59 @@ TestCase TestCase3() {
           /*breakpoints*/ {0, 2, 7}};
 }
 
+// Test case 4: multiple text files without compression, read in parallel
+// blocks that are smaller than the records.
+TestCase TestCase4() {
+  return {/*filenames*/ {
+              absl::StrCat(testing::TmpDir(), "/tf_record_PARALLEL_1"),
+              absl::StrCat(testing::TmpDir(), "/tf_record_PARALLEL_2"),
+              absl::StrCat(testing::TmpDir(), "/tf_record_PARALLEL_3")},
+          /*contents*/
+          {{"1", "22", "333"}, {}, {"a", "bb", "abcdefghijklmnopqrstuvwxyz"}},
+          /*compression_type*/ CompressionType::UNCOMPRESSED,
+          /*buffer_size*/ 10,
+          /*expected_outputs*/
+          {CreateTensor<tstring>(TensorShape({}), {"1"}),
+           CreateTensor<tstring>(TensorShape({}), {"22"}),
+           CreateTensor<tstring>(TensorShape({}), {"333"}),
+           CreateTensor<tstring>(TensorShape({}), {"a"}),
+           CreateTensor<tstring>(TensorShape({}), {"bb"}),
+           CreateTensor<tstring>(TensorShape({}),
+                                 {"abcdefghijklmnopqrstuvwxyz"})},
+          /*expected_output_dtypes*/ {DT_STRING},
+          /*expected_output_shapes*/ {PartialTensorShape({})},
+          /*expected_cardinality*/ kUnknownCardinality,
+          /*breakpoints*/ {0, 2, 3, 7},
+          /*num_parallel_block_reads*/ 3};
+}
+
+// Test case 5: multiple text files without compression, read from memory
+// mappings.
+TestCase TestCase5() {
+  return {/*filenames*/ {
+              absl::StrCat(testing::TmpDir(), "/tf_record_MMAP_1"),
+              absl::StrCat(testing::TmpDir(), "/tf_record_MMAP_2"),
+              absl::StrCat(testing::TmpDir(), "/tf_record_MMAP_3")},
+          /*contents*/
+          {{"1", "22", "333"}, {}, {"a", "bb", "abcdefghijklmnopqrstuvwxyz"}},
+          /*compression_type*/ CompressionType::UNCOMPRESSED,
+          /*buffer_size*/ 10,
+          /*expected_outputs*/
+          {CreateTensor<tstring>(TensorShape({}), {"1"}),
+           CreateTensor<tstring>(TensorShape({}), {"22"}),
+           CreateTensor<tstring>(TensorShape({}), {"333"}),
+           CreateTensor<tstring>(TensorShape({}), {"a"}),
+           CreateTensor<tstring>(TensorShape({}), {"bb"}),
+           CreateTensor<tstring>(TensorShape({}),
+                                 {"abcdefghijklmnopqrstuvwxyz"})},
+          /*expected_output_dtypes*/ {DT_STRING},
+          /*expected_output_shapes*/ {PartialTensorShape({})},
+          /*expected_cardinality*/ kUnknownCardinality,
+          /*breakpoints*/ {0, 2, 3, 7},
+          /*num_parallel_block_reads*/ 0,
+          /*use_mmap*/ true};
+}
+
 class ParameterizedTFRecordDatasetOpTest
     : public TFRecordDatasetOpTest,
       public ::testing::WithParamInterface<TestCase> {};
@@ -152,7 +209,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, GetNext) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -202,7 +261,9 @@ TEST_F(TFRecordDatasetOpTest, DatasetNodeName) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -235,7 +296,9 @@ TEST_F(TFRecordDatasetOpTest, DatasetTypeString) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -269,7 +332,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, DatasetOutputDtypes) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -303,7 +368,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, DatasetOutputShapes) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -337,7 +404,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, Cardinality) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -370,7 +439,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, IteratorOutputDtypes) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -412,7 +483,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, IteratorOutputShapes) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -454,7 +527,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, IteratorOutputPrefix) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -497,7 +572,9 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, Roundtrip) {
   TF_ASSERT_OK(CreateTestFiles(test_case));
 
   std::unique_ptr<OpKernel> tf_record_dataset_kernel;
-  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(&tf_record_dataset_kernel));
+  TF_ASSERT_OK(CreateTFRecordDatasetOpKernel(
+      test_case.num_parallel_block_reads, test_case.use_mmap,
+      &tf_record_dataset_kernel));
 
   int64 num_files = test_case.filenames.size();
   Tensor filenames =
@@ -558,7 +635,8 @@ TEST_P(ParameterizedTFRecordDatasetOpTest, Roundtrip) {
 INSTANTIATE_TEST_SUITE_P(TFRecordDatasetOpTest,
                          ParameterizedTFRecordDatasetOpTest,
                          ::testing::ValuesIn(std::vector<TestCase>(
-                             {TestCase1(), TestCase2(), TestCase3()})));
+                             {TestCase1(), TestCase2(), TestCase3(),
+                              TestCase4(), TestCase5()})));
 
 }  // namespace
 }  // namespace data
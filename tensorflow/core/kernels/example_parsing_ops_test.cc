@@ -64,6 +64,43 @@ class Int64Filler {
   DataType dtype = DT_INT64;
 };
 
+// Fills features with ids and labels, which are small enough to be encoded
+// with one byte each.
+class SmallInt64Filler {
+ public:
+  SmallInt64Filler() {}
+  void operator()(Feature* f, int feature_size) const {
+    for (int i = 0; i < feature_size; ++i) {
+      f->mutable_int64_list()->add_value(i % 100);
+    }
+  }
+  Tensor make_dense_default(int feature_size) {
+    return Tensor(dtype, TensorShape({feature_size}));
+  }
+  DataType dtype = DT_INT64;
+};
+
+// Fills features with a number of values between 1 and `feature_size` that
+// varies from one feature to the next, like ragged features. Only suitable for
+// sparse and variable length features.
+class RaggedInt64Filler {
+ public:
+  RaggedInt64Filler() {}
+  void operator()(Feature* f, int feature_size) {
+    const int num_values = 1 + (num_features_++ % feature_size);
+    for (int i = 0; i < num_values; ++i) {
+      f->mutable_int64_list()->add_value(int64{1} << (i % 40));
+    }
+  }
+  Tensor make_dense_default(int feature_size) {
+    return Tensor(dtype, TensorShape({feature_size}));
+  }
+  DataType dtype = DT_INT64;
+
+ private:
+  int num_features_ = 0;
+};
+
 class FloatFiller {
  public:
   FloatFiller() {}
@@ -137,6 +174,8 @@ std::once_flag ExampleStore<T>::flags_init;
 
 template struct ExampleStore<BytesFiller>;
 template struct ExampleStore<Int64Filler>;
+template struct ExampleStore<SmallInt64Filler>;
+template struct ExampleStore<RaggedInt64Filler>;
 template struct ExampleStore<FloatFiller>;
 
 enum BenchmarkType { kDense, kSparse, kVarLenDense };
@@ -257,6 +296,16 @@ typedef BenchmarkOptions<ExampleStore<Int64Filler>, kSparse> SparseInt64;
 typedef BenchmarkOptions<ExampleStore<Int64Filler>, kDense> DenseInt64;
 typedef BenchmarkOptions<ExampleStore<Int64Filler>, kVarLenDense>
     VarLenDenseInt64;
+typedef BenchmarkOptions<ExampleStore<SmallInt64Filler>, kSparse>
+    SparseSmallInt64;
+typedef BenchmarkOptions<ExampleStore<SmallInt64Filler>, kDense>
+    DenseSmallInt64;
+typedef BenchmarkOptions<ExampleStore<SmallInt64Filler>, kVarLenDense>
+    VarLenDenseSmallInt64;
+typedef BenchmarkOptions<ExampleStore<RaggedInt64Filler>, kSparse>
+    SparseRaggedInt64;
+typedef BenchmarkOptions<ExampleStore<RaggedInt64Filler>, kVarLenDense>
+    VarLenDenseRaggedInt64;
 typedef BenchmarkOptions<ExampleStore<FloatFiller>, kSparse> SparseFloat;
 typedef BenchmarkOptions<ExampleStore<FloatFiller>, kDense> DenseFloat;
 typedef BenchmarkOptions<ExampleStore<FloatFiller>, kVarLenDense>
@@ -291,6 +340,11 @@ BM_AllParseExample(VarLenDenseString);
 BM_AllParseExample(SparseInt64);
 BM_AllParseExample(DenseInt64);
 BM_AllParseExample(VarLenDenseInt64);
+BM_AllParseExample(SparseSmallInt64);
+BM_AllParseExample(DenseSmallInt64);
+BM_AllParseExample(VarLenDenseSmallInt64);
+BM_AllParseExample(SparseRaggedInt64);
+BM_AllParseExample(VarLenDenseRaggedInt64);
 BM_AllParseExample(SparseFloat);
 BM_AllParseExample(DenseFloat);
 BM_AllParseExample(VarLenDenseFloat);
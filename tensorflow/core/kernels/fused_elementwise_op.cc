@@ -0,0 +1,438 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/cwise_ops.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/util/bcast.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+// Number of elements of every value of the chain that are evaluated at once.
+// The operands of the ops of a tile stay in L1 cache.
+constexpr int64 kTileSize = 1024;
+
+template <typename T>
+struct FusedElementwiseFns {
+  using InputBuffer = typename TTypes<T>::UnalignedConstFlat;
+  using OutputBuffer = typename TTypes<T>::UnalignedFlat;
+
+  using UnaryFn = void (*)(const InputBuffer&, OutputBuffer*);
+  using BinaryFn = void (*)(const InputBuffer&, const InputBuffer&,
+                            OutputBuffer*);
+
+  struct Fn {
+    UnaryFn unary = nullptr;
+    BinaryFn binary = nullptr;
+    int cost = 0;
+  };
+
+  template <typename Functor>
+  static void ComputeUnary(const InputBuffer& in, OutputBuffer* out) {
+    *out = in.unaryExpr(typename Functor::func());
+  }
+
+  template <typename Functor>
+  static void ComputeBinary(const InputBuffer& x, const InputBuffer& y,
+                            OutputBuffer* out) {
+    *out = x.binaryExpr(y, typename Functor::func());
+  }
+
+  static void ComputeRelu(const InputBuffer& in, OutputBuffer* out) {
+    *out = in.cwiseMax(static_cast<T>(0));
+  }
+
+  static void ComputeRelu6(const InputBuffer& in, OutputBuffer* out) {
+    *out = in.cwiseMax(static_cast<T>(0)).cwiseMin(static_cast<T>(6));
+  }
+
+  template <typename Functor>
+  static Fn Unary() {
+    Fn fn;
+    fn.unary = ComputeUnary<Functor>;
+    fn.cost = Eigen::internal::functor_traits<typename Functor::func>::Cost;
+    return fn;
+  }
+
+  template <typename Functor>
+  static Fn Binary() {
+    Fn fn;
+    fn.binary = ComputeBinary<Functor>;
+    fn.cost = Eigen::internal::functor_traits<typename Functor::func>::Cost;
+    return fn;
+  }
+
+  // Returns the compute functions of the ops that can be fused, by op name.
+  static const std::unordered_map<string, Fn>& Get() {
+    static const std::unordered_map<string, Fn>* fns = [] {
+      auto* fns = new std::unordered_map<string, Fn>;
+      // clang-format off
+      (*fns)["Abs"]        = Unary<functor::abs<T>>();
+      (*fns)["Ceil"]       = Unary<functor::ceil<T>>();
+      (*fns)["Exp"]        = Unary<functor::exp<T>>();
+      (*fns)["Expm1"]      = Unary<functor::expm1<T>>();
+      (*fns)["Floor"]      = Unary<functor::floor<T>>();
+      (*fns)["Inv"]        = Unary<functor::inverse<T>>();
+      (*fns)["Log"]        = Unary<functor::log<T>>();
+      (*fns)["Log1p"]      = Unary<functor::log1p<T>>();
+      (*fns)["Neg"]        = Unary<functor::neg<T>>();
+      (*fns)["Reciprocal"] = Unary<functor::inverse<T>>();
+      (*fns)["Rsqrt"]      = Unary<functor::rsqrt<T>>();
+      (*fns)["Sigmoid"]    = Unary<functor::sigmoid<T>>();
+      (*fns)["Sqrt"]       = Unary<functor::sqrt<T>>();
+      (*fns)["Square"]     = Unary<functor::square<T>>();
+      (*fns)["Tanh"]       = Unary<functor::tanh<T>>();
+
+      (*fns)["Add"]               = Binary<functor::add<T>>();
+      (*fns)["AddV2"]             = Binary<functor::add<T>>();
+      (*fns)["Div"]               = Binary<functor::div<T>>();
+      (*fns)["Maximum"]           = Binary<functor::maximum<T>>();
+      (*fns)["Minimum"]           = Binary<functor::minimum<T>>();
+      (*fns)["Mul"]               = Binary<functor::mul<T>>();
+      (*fns)["Pow"]               = Binary<functor::pow<T>>();
+      (*fns)["RealDiv"]           = Binary<functor::div<T>>();
+      (*fns)["SquaredDifference"] = Binary<functor::squared_difference<T>>();
+      (*fns)["Sub"]               = Binary<functor::sub<T>>();
+      // clang-format on
+
+      Fn relu;
+      relu.unary = ComputeRelu;
+      relu.cost = Eigen::internal::functor_traits<
+          Eigen::internal::scalar_max_op<T>>::Cost;
+      (*fns)["Relu"] = relu;
+      Fn relu6;
+      relu6.unary = ComputeRelu6;
+      relu6.cost = 2 * relu.cost;
+      (*fns)["Relu6"] = relu6;
+      return fns;
+    }();
+    return *fns;
+  }
+};
+
+// How the elements of an input map to the elements of the output.
+struct InputMapping {
+  enum Kind {
+    // The input has as many elements as the output.
+    kFull,
+    // The input is a single element.
+    kScalar,
+    // The input is broadcast along some dimensions of the output.
+    kBroadcast,
+  };
+  Kind kind = kFull;
+  // For kBroadcast, the strides of the input for every dimension of the
+  // output, 0 along broadcast dimensions.
+  gtl::InlinedVector<int64, 8> strides;
+};
+
+// Copies the `len` elements of a broadcast input that map to the output
+// elements starting at `begin` into `buffer`.
+template <typename T>
+void GatherBroadcastInput(const T* input, const InputMapping& mapping,
+                          const BCast::Vec& out_dims, int64 begin, int64 len,
+                          T* buffer) {
+  const int rank = out_dims.size();
+  gtl::InlinedVector<int64, 8> index(rank);
+  int64 offset = 0;
+  for (int d = rank - 1; d >= 0; --d) {
+    index[d] = begin % out_dims[d];
+    begin /= out_dims[d];
+    offset += index[d] * mapping.strides[d];
+  }
+
+  const int inner = rank - 1;
+  const int64 inner_stride = mapping.strides[inner];
+  int64 i = 0;
+  while (i < len) {
+    // Copy or splat the rest of the innermost dimension.
+    const int64 run = std::min(len - i, out_dims[inner] - index[inner]);
+    if (inner_stride == 0) {
+      std::fill(buffer + i, buffer + i + run, input[offset]);
+    } else {
+      std::copy(input + offset, input + offset + run, buffer + i);
+    }
+    i += run;
+    index[inner] += run;
+    offset += run * inner_stride;
+    if (index[inner] < out_dims[inner]) continue;
+
+    // Carry into the outer dimensions.
+    offset -= out_dims[inner] * inner_stride;
+    index[inner] = 0;
+    for (int d = inner - 1; d >= 0; --d) {
+      offset += mapping.strides[d];
+      if (++index[d] < out_dims[d]) break;
+      offset -= out_dims[d] * mapping.strides[d];
+      index[d] = 0;
+    }
+  }
+}
+
+}  // namespace
+
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  using Fns = FusedElementwiseFns<T>;
+  using InputBuffer = typename Fns::InputBuffer;
+  using OutputBuffer = typename Fns::OutputBuffer;
+  using Packet = typename Eigen::internal::packet_traits<T>::type;
+
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args_));
+    OP_REQUIRES_OK(context, context->GetAttr("op_names", &op_names_));
+    OP_REQUIRES_OK(context, context->GetAttr("operands", &operands_));
+
+    const int num_ops = op_names_.size();
+    OP_REQUIRES(context, num_ops > 0,
+                errors::InvalidArgument(
+                    "Fused elementwise op must have at least one op"));
+    OP_REQUIRES(context, operands_.size() == 2 * num_ops,
+                errors::InvalidArgument("Expected ", 2 * num_ops,
+                                        " operands for ", num_ops,
+                                        " ops, got ", operands_.size()));
+
+    const auto& fns = Fns::Get();
+    std::vector<int> last_use(num_args_ + num_ops, -1);
+    for (int i = 0; i < num_ops; ++i) {
+      auto it = fns.find(op_names_[i]);
+      OP_REQUIRES(context, it != fns.end(),
+                  errors::InvalidArgument(
+                      "Do not have a compute function registered for op: ",
+                      op_names_[i]));
+      fns_.push_back(it->second);
+
+      const int num_operands = it->second.unary != nullptr ? 1 : 2;
+      for (int j = 0; j < 2; ++j) {
+        const int operand = operands_[2 * i + j];
+        if (j < num_operands) {
+          OP_REQUIRES(context, operand >= 0 && operand < num_args_ + i,
+                      errors::InvalidArgument("Invalid operand ", operand,
+                                              " of op ", i, " (",
+                                              op_names_[i], ")"));
+          last_use[operand] = i;
+        } else {
+          OP_REQUIRES(context, operand == -1,
+                      errors::InvalidArgument("Unary op ", i, " (",
+                                              op_names_[i],
+                                              ") must have operand -1"));
+        }
+      }
+      cost_ += it->second.cost;
+    }
+
+    // Assign a tile buffer to the result of every op but the last one, which
+    // is written to the output. A buffer is reused once its value is dead.
+    std::vector<int> free_buffers;
+    buffers_.assign(num_ops, -1);
+    for (int i = 0; i < num_ops; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        const int operand = operands_[2 * i + j];
+        if (j == 1 && operand == operands_[2 * i]) continue;
+        if (operand >= num_args_ && last_use[operand] == i) {
+          free_buffers.push_back(buffers_[operand - num_args_]);
+        }
+      }
+      if (i == num_ops - 1) break;
+      if (free_buffers.empty()) {
+        buffers_[i] = num_buffers_++;
+      } else {
+        buffers_[i] = free_buffers.back();
+        free_buffers.pop_back();
+      }
+    }
+
+    VLOG(2) << "Fused elementwise op: [" << absl::StrJoin(op_names_, ", ")
+            << "]; num_args=" << num_args_ << " num_buffers=" << num_buffers_
+            << " cost=" << cost_;
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    OpInputList args;
+    OP_REQUIRES_OK(ctx, ctx->input_list("args", &args));
+
+    BCast::Vec out_dims = BCast::FromShape(args[0].shape());
+    for (int i = 1; i < num_args_; ++i) {
+      BCast bcast(out_dims, BCast::FromShape(args[i].shape()),
+                  /*fewer_dims_optimization=*/false);
+      OP_REQUIRES(ctx, bcast.IsValid(),
+                  errors::InvalidArgument(
+                      "Incompatible shapes: ",
+                      BCast::ToShape(out_dims).DebugString(), " vs. ",
+                      args[i].shape().DebugString()));
+      out_dims = bcast.output_shape();
+    }
+    const TensorShape out_shape = BCast::ToShape(out_dims);
+    const int64 num_elements = out_shape.num_elements();
+
+    std::vector<InputMapping> mappings(num_args_);
+    std::vector<int> forwardable_inputs;
+    int num_broadcast_inputs = 0;
+    for (int i = 0; i < num_args_; ++i) {
+      const int64 input_elements = args[i].NumElements();
+      if (input_elements == num_elements) {
+        mappings[i].kind = InputMapping::kFull;
+        forwardable_inputs.push_back(i);
+      } else if (input_elements == 1) {
+        mappings[i].kind = InputMapping::kScalar;
+      } else {
+        mappings[i].kind = InputMapping::kBroadcast;
+        ComputeBroadcastStrides(args[i].shape(), out_dims, &mappings[i]);
+      }
+      if (mappings[i].kind != InputMapping::kFull) ++num_broadcast_inputs;
+    }
+
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->forward_input_or_allocate_output(
+                            forwardable_inputs, 0, out_shape, &out));
+    if (num_elements == 0) return;
+
+    std::vector<const T*> inputs(num_args_);
+    for (int i = 0; i < num_args_; ++i) {
+      inputs[i] = args[i].flat<T>().data();
+    }
+    T* output = out->flat<T>().data();
+
+    const int num_ops = fns_.size();
+    auto compute_fn = [&, this, num_broadcast_inputs, num_ops](int64 begin,
+                                                               int64 end) {
+      // Tiles for the intermediate results, followed by tiles for the
+      // broadcast inputs.
+      const int64 tile_size = std::min(kTileSize, end - begin);
+      std::vector<T> scratch((num_buffers_ + num_broadcast_inputs) *
+                             tile_size);
+      gtl::InlinedVector<T*, 8> input_buffers(num_args_, nullptr);
+      T* next_buffer = scratch.data() + num_buffers_ * tile_size;
+      for (int i = 0; i < num_args_; ++i) {
+        if (mappings[i].kind == InputMapping::kFull) continue;
+        input_buffers[i] = next_buffer;
+        next_buffer += tile_size;
+        if (mappings[i].kind == InputMapping::kScalar) {
+          std::fill(input_buffers[i], input_buffers[i] + tile_size,
+                    inputs[i][0]);
+        }
+      }
+
+      gtl::InlinedVector<const T*, 16> values(num_args_ + num_ops);
+      for (int64 tile_begin = begin; tile_begin < end;
+           tile_begin += tile_size) {
+        const int64 len = std::min(tile_size, end - tile_begin);
+        for (int i = 0; i < num_args_; ++i) {
+          switch (mappings[i].kind) {
+            case InputMapping::kFull:
+              values[i] = inputs[i] + tile_begin;
+              break;
+            case InputMapping::kScalar:
+              values[i] = input_buffers[i];
+              break;
+            case InputMapping::kBroadcast:
+              GatherBroadcastInput(inputs[i], mappings[i], out_dims,
+                                   tile_begin, len, input_buffers[i]);
+              values[i] = input_buffers[i];
+              break;
+          }
+        }
+
+        for (int i = 0; i < num_ops; ++i) {
+          T* result = i == num_ops - 1
+                          ? output + tile_begin
+                          : scratch.data() + buffers_[i] * tile_size;
+          OutputBuffer result_buffer(result, len);
+          const InputBuffer x(values[operands_[2 * i]], len);
+          if (fns_[i].unary != nullptr) {
+            fns_[i].unary(x, &result_buffer);
+          } else {
+            const InputBuffer y(values[operands_[2 * i + 1]], len);
+            fns_[i].binary(x, y, &result_buffer);
+          }
+          values[num_args_ + i] = result;
+        }
+      }
+    };
+
+    const CPUDevice& device = ctx->eigen_device<CPUDevice>();
+    Eigen::TensorOpCost cost(/*bytes_loaded=*/sizeof(T) * num_args_,
+                             /*bytes_stored=*/sizeof(T),
+                             /*compute_cycles=*/num_ops * 2 + cost_);
+    device.parallelFor(num_elements, cost, AlignBlockSize,
+                       std::move(compute_fn));
+  }
+
+ private:
+  static const int kPacketSize = Eigen::internal::unpacket_traits<Packet>::size;
+
+  static inline int64 AlignBlockSize(int64 block_size) {
+    // Blocks of at least a tile are made of whole tiles.
+    if (block_size >= kTileSize) {
+      return (block_size + kTileSize - 1) & ~(kTileSize - 1);
+    }
+    return (block_size + kPacketSize - 1) & ~(kPacketSize - 1);
+  }
+
+  // Computes the strides of `shape` for every dimension of `out_dims`, which
+  // `shape` is broadcast to.
+  static void ComputeBroadcastStrides(const TensorShape& shape,
+                                      const BCast::Vec& out_dims,
+                                      InputMapping* mapping) {
+    const int rank = out_dims.size();
+    const int offset = rank - shape.dims();
+    mapping->strides.assign(rank, 0);
+    int64 stride = 1;
+    for (int d = rank - 1; d >= offset; --d) {
+      const int64 dim = shape.dim_size(d - offset);
+      if (dim != 1) mapping->strides[d] = stride;
+      stride *= dim;
+    }
+  }
+
+  int num_args_ = 0;
+  std::vector<string> op_names_;
+  std::vector<int> operands_;
+  std::vector<typename Fns::Fn> fns_;
+  // The tile buffer of the result of every op, -1 for the last op.
+  std::vector<int> buffers_;
+  int num_buffers_ = 0;
+  int cost_ = 0;
+};
+
+#define REGISTER_CPU(T)                                                    \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("_FusedElementwise").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedElementwiseOp<T>);
+
+REGISTER_CPU(float);
+REGISTER_CPU(double);
+
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
@@ -0,0 +1,242 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  Status InitFusedOp(int num_args, const std::vector<string>& op_names,
+                     const std::vector<int>& operands) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("fused_elementwise", "_FusedElementwise")
+                           .Input(FakeInput(num_args, DT_FLOAT))
+                           .Attr("op_names", op_names)
+                           .Attr("operands", operands)
+                           .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(FusedElementwiseOpTest, UnaryChain) {
+  // Sqrt(Abs(Neg(x)))
+  TF_ASSERT_OK(InitFusedOp(1, {"Neg", "Abs", "Sqrt"}, {0, -1, 1, -1, 2, -1}));
+  AddInputFromArray<float>(TensorShape({4}), {-4, 9, 0, 16});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&expected, {2, 3, 0, 4});
+  test::ExpectClose(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, BinaryOpsWithScalars) {
+  // Relu(x * 2 + b)
+  TF_ASSERT_OK(
+      InitFusedOp(3, {"Mul", "Add", "Relu"}, {0, 1, 3, 2, 4, -1}));
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, -2, 3, -4});
+  AddInputFromArray<float>(TensorShape({}), {2});
+  AddInputFromArray<float>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {3, 0, 7, 0});
+  test::ExpectClose(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, SameInputTwice) {
+  // x * x - x
+  TF_ASSERT_OK(InitFusedOp(1, {"Mul", "Sub"}, {0, 0, 1, 0}));
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3}));
+  test::FillValues<float>(&expected, {0, 2, 6});
+  test::ExpectClose(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, Broadcasting) {
+  // (x - mean) * gamma, with x: [2, 3], mean: [2, 1], gamma: [3].
+  TF_ASSERT_OK(InitFusedOp(3, {"Sub", "Mul"}, {0, 1, 3, 2}));
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2, 1}), {2, 5});
+  AddInputFromArray<float>(TensorShape({3}), {1, 10, 100});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {-1, 0, 100, -1, 0, 100});
+  test::ExpectClose(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, BroadcastsOutputShape) {
+  // x + y, with x: [3, 1] and y: [1, 2].
+  TF_ASSERT_OK(InitFusedOp(2, {"AddV2"}, {0, 1}));
+  AddInputFromArray<float>(TensorShape({3, 1}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({1, 2}), {10, 20});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {11, 21, 12, 22, 13, 23});
+  test::ExpectClose(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, ManyTiles) {
+  // Tanh(x * bias + x), over several tiles and shards.
+  const int kRows = 257;
+  const int kCols = 33;
+  TF_ASSERT_OK(InitFusedOp(2, {"Mul", "Add", "Tanh"}, {0, 1, 2, 0, 3, -1}));
+  std::vector<float> x(kRows * kCols);
+  std::vector<float> bias(kCols);
+  for (int i = 0; i < x.size(); ++i) x[i] = std::sin(i);
+  for (int i = 0; i < bias.size(); ++i) bias[i] = std::cos(i);
+  AddInputFromArray<float>(TensorShape({kRows, kCols}), x);
+  AddInputFromArray<float>(TensorShape({kCols}), bias);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<float> y(x.size());
+  for (int i = 0; i < x.size(); ++i) {
+    y[i] = std::tanh(x[i] * bias[i % kCols] + x[i]);
+  }
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({kRows, kCols}));
+  test::FillValues<float>(&expected, y);
+  test::ExpectClose(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, IncompatibleShapes) {
+  TF_ASSERT_OK(InitFusedOp(2, {"Add"}, {0, 1}));
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(FusedElementwiseOpTest, InvalidProgram) {
+  // Unknown op.
+  EXPECT_FALSE(InitFusedOp(1, {"MatMul"}, {0, -1}).ok());
+  // Operand is not computed yet.
+  EXPECT_FALSE(InitFusedOp(1, {"Neg", "Abs"}, {1, -1, 1, -1}).ok());
+  // Missing operand of a binary op.
+  EXPECT_FALSE(InitFusedOp(1, {"Add"}, {0, -1}).ok());
+  // Operand of a unary op.
+  EXPECT_FALSE(InitFusedOp(1, {"Neg"}, {0, 0}).ok());
+}
+
+// Performance benchmarks below.
+
+// Relu(x * scale + bias), as in a batch normalization folded into a dense
+// layer.
+static Graph* ScaleBiasRelu(int rows, int cols, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({rows, cols}));
+  x.flat<float>().setRandom();
+  Tensor scale(DT_FLOAT, TensorShape({cols}));
+  scale.flat<float>().setRandom();
+  Tensor bias(DT_FLOAT, TensorShape({cols}));
+  bias.flat<float>().setRandom();
+  Node* x_node = test::graph::Constant(g, x);
+  Node* scale_node = test::graph::Constant(g, scale);
+  Node* bias_node = test::graph::Constant(g, bias);
+
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedElementwise")
+                    .Input({x_node, scale_node, bias_node})
+                    .Attr("op_names", {"Mul", "Add", "Relu"})
+                    .Attr("operands", {0, 1, 3, 2, 4, -1})
+                    .Finalize(g, nullptr));
+  } else {
+    Node* mul = test::graph::Binary(g, "Mul", x_node, scale_node);
+    Node* add = test::graph::Binary(g, "Add", mul, bias_node);
+    test::graph::Unary(g, "Relu", add);
+  }
+  return g;
+}
+
+// (x - mean) * Rsqrt(variance + epsilon) * gamma + beta, as in a layer
+// normalization.
+static Graph* LayerNorm(int rows, int cols, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({rows, cols}));
+  x.flat<float>().setRandom();
+  Tensor mean(DT_FLOAT, TensorShape({rows, 1}));
+  mean.flat<float>().setRandom();
+  Tensor variance(DT_FLOAT, TensorShape({rows, 1}));
+  variance.flat<float>() = variance.flat<float>().setRandom().abs();
+  Tensor epsilon(DT_FLOAT, TensorShape({}));
+  epsilon.scalar<float>()() = 1e-3;
+  Tensor gamma(DT_FLOAT, TensorShape({cols}));
+  gamma.flat<float>().setRandom();
+  Tensor beta(DT_FLOAT, TensorShape({cols}));
+  beta.flat<float>().setRandom();
+  Node* x_node = test::graph::Constant(g, x);
+  Node* mean_node = test::graph::Constant(g, mean);
+  Node* variance_node = test::graph::Constant(g, variance);
+  Node* epsilon_node = test::graph::Constant(g, epsilon);
+  Node* gamma_node = test::graph::Constant(g, gamma);
+  Node* beta_node = test::graph::Constant(g, beta);
+
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedElementwise")
+                    .Input({x_node, mean_node, variance_node, epsilon_node,
+                            gamma_node, beta_node})
+                    .Attr("op_names", {"Sub", "Add", "Rsqrt", "Mul", "Mul",
+                                       "Add"})
+                    .Attr("operands", {0, 1, 2, 3, 7, -1, 6, 8, 9, 4, 10, 5})
+                    .Finalize(g, nullptr));
+  } else {
+    Node* centered = test::graph::Binary(g, "Sub", x_node, mean_node);
+    Node* rstd = test::graph::Unary(
+        g, "Rsqrt", test::graph::Binary(g, "Add", variance_node, epsilon_node));
+    Node* normalized = test::graph::Binary(g, "Mul", centered, rstd);
+    Node* scaled = test::graph::Binary(g, "Mul", normalized, gamma_node);
+    test::graph::Binary(g, "Add", scaled, beta_node);
+  }
+  return g;
+}
+
+#define BM_FusedElementwise(GRAPH, ROWS, COLS)                              \
+  static void BM_##GRAPH##_Chain_##ROWS##_##COLS(int iters) {               \
+    testing::ItemsProcessed(static_cast<int64>(iters) * ROWS * COLS);       \
+    test::Benchmark("cpu", GRAPH(ROWS, COLS, false)).Run(iters);            \
+  }                                                                         \
+  BENCHMARK(BM_##GRAPH##_Chain_##ROWS##_##COLS);                            \
+  static void BM_##GRAPH##_Fused_##ROWS##_##COLS(int iters) {               \
+    testing::ItemsProcessed(static_cast<int64>(iters) * ROWS * COLS);       \
+    test::Benchmark("cpu", GRAPH(ROWS, COLS, true)).Run(iters);             \
+  }                                                                         \
+  BENCHMARK(BM_##GRAPH##_Fused_##ROWS##_##COLS);
+
+BM_FusedElementwise(ScaleBiasRelu, 32, 1024);
+BM_FusedElementwise(ScaleBiasRelu, 256, 1024);
+BM_FusedElementwise(ScaleBiasRelu, 4096, 1024);
+
+BM_FusedElementwise(LayerNorm, 32, 1024);
+BM_FusedElementwise(LayerNorm, 256, 1024);
+BM_FusedElementwise(LayerNorm, 4096, 1024);
+
+}  // namespace
+}  // namespace tensorflow
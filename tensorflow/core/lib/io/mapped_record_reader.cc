@@ -0,0 +1,91 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/mapped_record_reader.h"
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+// Stands in for the mapping of an empty file, which mmap() rejects.
+class EmptyMemoryRegion : public ReadOnlyMemoryRegion {
+ public:
+  const void* data() override { return nullptr; }
+  uint64 length() override { return 0; }
+};
+
+}  // namespace
+
+Status MappedRecordReader::Create(Env* env, const string& filename,
+                                  std::unique_ptr<MappedRecordReader>* reader) {
+  uint64 file_size;
+  TF_RETURN_IF_ERROR(env->GetFileSize(filename, &file_size));
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  if (file_size == 0) {
+    region.reset(new EmptyMemoryRegion);
+  } else {
+    TF_RETURN_IF_ERROR(env->NewReadOnlyMemoryRegionFromFile(filename, &region));
+  }
+  reader->reset(new MappedRecordReader(std::move(region)));
+  return Status::OK();
+}
+
+MappedRecordReader::MappedRecordReader(
+    std::shared_ptr<ReadOnlyMemoryRegion> region)
+    : region_(std::move(region)),
+      data_(static_cast<const char*>(region_->data())),
+      size_(region_->length()) {}
+
+Status MappedRecordReader::ReadRecord(uint64* offset,
+                                      StringPiece* record) const {
+  static const size_t kHeaderSize = RecordReader::kHeaderSize;
+  static const size_t kFooterSize = RecordReader::kFooterSize;
+
+  const uint64 start = *offset;
+  if (start >= size_) {
+    return errors::OutOfRange("eof");
+  }
+  if (size_ - start < kHeaderSize) {
+    return errors::DataLoss("truncated record at ", start);
+  }
+  const char* header = data_ + start;
+  const uint32 masked_length_crc = core::DecodeFixed32(header + sizeof(uint64));
+  if (crc32c::Unmask(masked_length_crc) !=
+      crc32c::Value(header, sizeof(uint64))) {
+    return errors::DataLoss("corrupted record at ", start);
+  }
+  const uint64 length = core::DecodeFixed64(header);
+  if (size_ - start - kHeaderSize < kFooterSize ||
+      length > size_ - start - kHeaderSize - kFooterSize) {
+    return errors::DataLoss("truncated record at ", start);
+  }
+
+  const char* data = header + kHeaderSize;
+  const uint32 masked_data_crc = core::DecodeFixed32(data + length);
+  if (crc32c::Unmask(masked_data_crc) != crc32c::Value(data, length)) {
+    return errors::DataLoss("corrupted record at ", start + kHeaderSize);
+  }
+  *record = StringPiece(data, length);
+  *offset = start + kHeaderSize + length + kFooterSize;
+  return Status::OK();
+}
+
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,66 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_LIB_IO_MAPPED_RECORD_READER_H_
+#define TENSORFLOW_CORE_LIB_IO_MAPPED_RECORD_READER_H_
+
+#include <memory>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace io {
+
+// Reads the records of an uncompressed TFRecord file that is mapped in
+// memory, without copying them: the records are returned as views into the
+// mapping, which stays valid as long as `region()` is referenced.
+//
+// Unlike RecordReader, this class is thread safe.
+class MappedRecordReader {
+ public:
+  // Maps `filename` with Env::NewReadOnlyMemoryRegionFromFile(), which
+  // returns UNIMPLEMENTED on filesystems that do not support it. An empty file
+  // is not mapped, and reads as zero records.
+  static Status Create(Env* env, const string& filename,
+                       std::unique_ptr<MappedRecordReader>* reader);
+
+  explicit MappedRecordReader(std::shared_ptr<ReadOnlyMemoryRegion> region);
+
+  // Reads the record at "*offset" into *record and updates *offset to point
+  // to the offset of the next record. Returns OK on success, OUT_OF_RANGE for
+  // end of file, or DATA_LOSS for a truncated or corrupted record.
+  Status ReadRecord(uint64* offset, StringPiece* record) const;
+
+  // The mapping that the records point into.
+  const std::shared_ptr<ReadOnlyMemoryRegion>& region() const {
+    return region_;
+  }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const char* const data_;
+  const uint64 size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MappedRecordReader);
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_LIB_IO_MAPPED_RECORD_READER_H_
@@ -0,0 +1,230 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/mapped_record_reader.h"
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+string TestFilename(const string& name) {
+  return JoinPath(testing::TmpDir(), strings::StrCat("mapped_record_", name));
+}
+
+void WriteRecords(const string& filename, const std::vector<string>& records) {
+  std::unique_ptr<WritableFile> file;
+  TF_CHECK_OK(Env::Default()->NewWritableFile(filename, &file));
+  RecordWriter writer(file.get());
+  for (const string& record : records) {
+    TF_CHECK_OK(writer.WriteRecord(record));
+  }
+  TF_CHECK_OK(writer.Close());
+  TF_CHECK_OK(file->Close());
+}
+
+// Rewrites `filename` after applying `change` to its contents.
+void ChangeFile(const string& filename,
+                const std::function<void(string*)>& change) {
+  string data;
+  TF_CHECK_OK(ReadFileToString(Env::Default(), filename, &data));
+  change(&data);
+  TF_CHECK_OK(WriteStringToFile(Env::Default(), filename, data));
+}
+
+TEST(MappedRecordReaderTest, ReadsViewsOfRecords) {
+  const std::vector<string> expected = {"", "a", "bb", string(1000, 'c')};
+  const string filename = TestFilename("views");
+  WriteRecords(filename, expected);
+
+  std::unique_ptr<MappedRecordReader> reader;
+  TF_ASSERT_OK(MappedRecordReader::Create(Env::Default(), filename, &reader));
+  const char* begin = static_cast<const char*>(reader->region()->data());
+  const char* end = begin + reader->region()->length();
+
+  uint64 offset = 0;
+  for (const string& expected_record : expected) {
+    StringPiece record;
+    TF_ASSERT_OK(reader->ReadRecord(&offset, &record));
+    EXPECT_EQ(expected_record, record);
+    // The record points into the mapping.
+    EXPECT_GE(record.data(), begin);
+    EXPECT_LE(record.data() + record.size(), end);
+  }
+  EXPECT_EQ(reader->region()->length(), offset);
+  StringPiece record;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&offset, &record)));
+}
+
+TEST(MappedRecordReaderTest, EmptyFile) {
+  const string filename = TestFilename("empty");
+  WriteRecords(filename, {});
+
+  std::unique_ptr<MappedRecordReader> reader;
+  TF_ASSERT_OK(MappedRecordReader::Create(Env::Default(), filename, &reader));
+  EXPECT_EQ(0, reader->region()->length());
+  uint64 offset = 0;
+  StringPiece record;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&offset, &record)));
+}
+
+TEST(MappedRecordReaderTest, MatchesRecordReaderOffsets) {
+  const std::vector<string> records = {"first", "second", "third"};
+  const string filename = TestFilename("offsets");
+  WriteRecords(filename, records);
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+  RecordReader record_reader(file.get());
+  std::unique_ptr<MappedRecordReader> mapped_reader;
+  TF_ASSERT_OK(
+      MappedRecordReader::Create(Env::Default(), filename, &mapped_reader));
+
+  uint64 offset = 0;
+  uint64 mapped_offset = 0;
+  for (int i = 0; i < records.size(); ++i) {
+    tstring record;
+    TF_ASSERT_OK(record_reader.ReadRecord(&offset, &record));
+    StringPiece mapped_record;
+    TF_ASSERT_OK(mapped_reader->ReadRecord(&mapped_offset, &mapped_record));
+    EXPECT_EQ(record, mapped_record);
+    EXPECT_EQ(offset, mapped_offset);
+  }
+
+  // Records can be read again from any of their offsets.
+  mapped_offset = 0;
+  StringPiece mapped_record;
+  TF_ASSERT_OK(mapped_reader->ReadRecord(&mapped_offset, &mapped_record));
+  TF_ASSERT_OK(mapped_reader->ReadRecord(&mapped_offset, &mapped_record));
+  EXPECT_EQ(records[1], mapped_record);
+}
+
+TEST(MappedRecordReaderTest, CorruptedRecords) {
+  const std::vector<string> records = {"first", "second"};
+  const size_t second_offset =
+      RecordReader::kHeaderSize + records[0].size() + RecordReader::kFooterSize;
+  struct {
+    const char* name;
+    size_t position;
+  } corruptions[] = {
+      {"length", second_offset},
+      {"length_crc", second_offset + sizeof(uint64)},
+      {"data", second_offset + RecordReader::kHeaderSize},
+      {"data_crc",
+       second_offset + RecordReader::kHeaderSize + records[1].size()},
+  };
+  for (const auto& corruption : corruptions) {
+    const string filename = TestFilename(corruption.name);
+    WriteRecords(filename, records);
+    const size_t position = corruption.position;
+    ChangeFile(filename, [position](string* data) { (*data)[position] ^= 1; });
+
+    std::unique_ptr<MappedRecordReader> reader;
+    TF_ASSERT_OK(
+        MappedRecordReader::Create(Env::Default(), filename, &reader));
+    uint64 offset = 0;
+    StringPiece record;
+    TF_ASSERT_OK(reader->ReadRecord(&offset, &record));
+    EXPECT_EQ(records[0], record);
+    Status s = reader->ReadRecord(&offset, &record);
+    EXPECT_TRUE(errors::IsDataLoss(s)) << corruption.name << ": " << s;
+    EXPECT_EQ(second_offset, offset);
+  }
+}
+
+TEST(MappedRecordReaderTest, TruncatedRecords) {
+  const std::vector<string> records = {"first", "second"};
+  const string filename = TestFilename("truncated");
+  WriteRecords(filename, records);
+  uint64 file_size;
+  TF_ASSERT_OK(Env::Default()->GetFileSize(filename, &file_size));
+
+  // Truncate inside the footer, the data and the header of the last record.
+  for (const size_t truncated_bytes : {1, 5, 20}) {
+    WriteRecords(filename, records);
+    ChangeFile(filename, [file_size, truncated_bytes](string* data) {
+      data->resize(file_size - truncated_bytes);
+    });
+
+    std::unique_ptr<MappedRecordReader> reader;
+    TF_ASSERT_OK(
+        MappedRecordReader::Create(Env::Default(), filename, &reader));
+    uint64 offset = 0;
+    StringPiece record;
+    TF_ASSERT_OK(reader->ReadRecord(&offset, &record));
+    Status s = reader->ReadRecord(&offset, &record);
+    EXPECT_TRUE(errors::IsDataLoss(s)) << truncated_bytes << ": " << s;
+  }
+}
+
+void WriteBenchmarkFile(int record_size, string* filename) {
+  const int num_records = (16 << 20) / record_size;
+  *filename = TestFilename(strings::StrCat("benchmark_", record_size));
+  WriteRecords(*filename,
+               std::vector<string>(num_records, string(record_size, 'x')));
+}
+
+void BM_SequentialRecordReader(int iters, int record_size) {
+  testing::StopTiming();
+  string filename;
+  WriteBenchmarkFile(record_size, &filename);
+  testing::StartTiming();
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_CHECK_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+    SequentialRecordReader reader(
+        file.get(), RecordReaderOptions::CreateRecordReaderOptions(""));
+    tstring record;
+    while (reader.ReadRecord(&record).ok()) {
+      bytes += record.size();
+    }
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_SequentialRecordReader)->Arg(100)->Arg(10000);
+
+void BM_MappedRecordReader(int iters, int record_size) {
+  testing::StopTiming();
+  string filename;
+  WriteBenchmarkFile(record_size, &filename);
+  testing::StartTiming();
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<MappedRecordReader> reader;
+    TF_CHECK_OK(MappedRecordReader::Create(Env::Default(), filename, &reader));
+    uint64 offset = 0;
+    StringPiece record;
+    while (reader->ReadRecord(&offset, &record).ok()) {
+      bytes += record.size();
+    }
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_MappedRecordReader)->Arg(100)->Arg(10000);
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,411 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/parallel_record_reader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+
+namespace tensorflow {
+namespace io {
+
+struct ParallelRecordReader::Block {
+  size_t file_index;
+  uint64 offset;
+  size_t size;
+  std::unique_ptr<char[]> scratch;
+
+  // Set when the read is done.
+  bool done = false;
+  Status status;
+  StringPiece data;
+};
+
+struct ParallelRecordReader::Batch {
+  size_t file_index;
+  std::vector<tstring> records;
+  std::vector<uint32> masked_crcs;
+  // The offset of each record, and the offset past the last one.
+  std::vector<uint64> offsets;
+  uint64 end_offset = 0;
+  // True if the batch ends its file.
+  bool end_of_file = false;
+  // The error that follows the records, if any.
+  Status status;
+
+  // Set when the checksums have been verified: the number of records before
+  // the first corrupted one, if any.
+  bool verified = false;
+  size_t num_valid = 0;
+  size_t next = 0;
+};
+
+ParallelRecordReader::ParallelRecordReader(Env* env,
+                                           std::vector<string> filenames,
+                                           size_t file_index, uint64 offset,
+                                           const Options& options,
+                                           thread::ThreadPool* pool)
+    : env_(env),
+      filenames_(std::move(filenames)),
+      options_(options),
+      pool_(pool),
+      file_sizes_(filenames_.size(), -1),
+      issue_file_(file_index),
+      issue_offset_(offset),
+      frame_file_(file_index),
+      frame_offset_(offset),
+      position_file_(file_index),
+      position_offset_(offset) {}
+
+ParallelRecordReader::~ParallelRecordReader() {
+  mutex_lock l(mu_);
+  while (num_outstanding_ > 0) {
+    cond_var_.wait(l);
+  }
+}
+
+int64 ParallelRecordReader::bytes_read() const {
+  mutex_lock l(mu_);
+  return bytes_read_;
+}
+
+Status ParallelRecordReader::ReadRecord(tstring* record) {
+  mutex_lock l(mu_);
+  while (true) {
+    // Keep framing, and verifying, the records that have arrived ahead of
+    // the ones returned.
+    while (batches_.size() < static_cast<size_t>(options_.num_parallel_reads) &&
+           FrameBatchLocked(/*wait=*/false, &l)) {
+    }
+
+    if (!batches_.empty()) {
+      std::shared_ptr<Batch> batch = batches_.front();
+      while (!batch->verified) {
+        cond_var_.wait(l);
+      }
+      if (batch->next < batch->num_valid) {
+        *record = std::move(batch->records[batch->next]);
+        ++batch->next;
+        position_file_ = batch->file_index;
+        position_offset_ = batch->next < batch->records.size()
+                               ? batch->offsets[batch->next]
+                               : batch->end_offset;
+        return Status::OK();
+      }
+      batches_.pop_front();
+      if (!batch->status.ok()) {
+        SkipFileLocked(batch->file_index);
+        position_file_ = batch->file_index + 1;
+        position_offset_ = 0;
+        return batch->status;
+      }
+      if (batch->end_of_file) {
+        position_file_ = batch->file_index + 1;
+        position_offset_ = 0;
+      }
+      continue;
+    }
+
+    if (frame_file_ >= filenames_.size()) {
+      return errors::OutOfRange("eof");
+    }
+    FrameBatchLocked(/*wait=*/true, &l);
+  }
+}
+
+void ParallelRecordReader::MaybeIssueReadsLocked() {
+  while (blocks_.size() < static_cast<size_t>(options_.num_parallel_reads) &&
+         issue_file_ < filenames_.size()) {
+    if (issue_handle_ == nullptr) {
+      const string& filename = filenames_[issue_file_];
+      std::unique_ptr<RandomAccessFile> file;
+      uint64 file_size = 0;
+      Status s = env_->NewRandomAccessFile(filename, &file);
+      if (s.ok()) {
+        s = env_->GetFileSize(filename, &file_size);
+      }
+      if (!s.ok()) {
+        file_errors_[issue_file_] = s;
+        NextIssueFileLocked();
+        continue;
+      }
+      issue_handle_ = std::move(file);
+      file_sizes_[issue_file_] = file_size;
+    }
+    const uint64 file_size = file_sizes_[issue_file_];
+    if (issue_offset_ >= file_size) {
+      NextIssueFileLocked();
+      continue;
+    }
+    const size_t n = std::min<uint64>(options_.block_size,
+                                      file_size - issue_offset_);
+    IssueReadLocked(issue_offset_, n);
+    issue_offset_ += n;
+  }
+}
+
+void ParallelRecordReader::IssueReadLocked(uint64 offset, size_t n) {
+  auto block = std::make_shared<Block>();
+  block->file_index = issue_file_;
+  block->offset = offset;
+  block->size = n;
+  block->scratch.reset(new char[n]);
+  blocks_.push_back(block);
+
+  // The callback holds the file, which must outlive the read.
+  std::shared_ptr<RandomAccessFile> file = issue_handle_;
+  auto done = [this, block, file](const Status& status, StringPiece data) {
+    mutex_lock l(mu_);
+    block->done = true;
+    block->data = data;
+    if (status.ok() || (errors::IsOutOfRange(status) && !data.empty())) {
+      if (data.size() < block->size) {
+        // The file was truncated since it was opened.
+        block->status = errors::DataLoss(
+            "unexpected end of file ", filenames_[block->file_index], " at ",
+            block->offset + data.size());
+      }
+    } else {
+      block->status = status;
+    }
+    bytes_read_ += data.size();
+    --num_outstanding_;
+    cond_var_.notify_all();
+  };
+
+  // Start the read from the thread pool, so that a filesystem can run the
+  // callback before ReadAsync() returns, and fall back to a blocking read.
+  ++num_outstanding_;
+  pool_->Schedule([file, block, done]() {
+    Status s =
+        file->ReadAsync(block->offset, block->size, block->scratch.get(), done);
+    if (errors::IsUnimplemented(s)) {
+      StringPiece data;
+      s = file->Read(block->offset, block->size, &data, block->scratch.get());
+      done(s, data);
+    } else if (!s.ok()) {
+      done(s, StringPiece());
+    }
+  });
+}
+
+void ParallelRecordReader::NextIssueFileLocked() {
+  issue_handle_.reset();
+  ++issue_file_;
+  issue_offset_ = 0;
+}
+
+bool ParallelRecordReader::FrameBatchLocked(bool wait, mutex_lock* l) {
+  MaybeIssueReadsLocked();
+  if (frame_file_ >= filenames_.size()) {
+    return false;
+  }
+
+  auto batch = std::make_shared<Batch>();
+  batch->file_index = frame_file_;
+  int64 batch_bytes = 0;
+  while (batch_bytes < options_.block_size) {
+    auto error = file_errors_.find(frame_file_);
+    if (error != file_errors_.end()) {
+      batch->status = error->second;
+      batch->end_of_file = true;
+      break;
+    }
+    const uint64 file_size = file_sizes_[frame_file_];
+    const uint64 offset = frame_offset_;
+    if (offset >= file_size) {
+      batch->end_of_file = true;
+      break;
+    }
+    if (file_size - offset < RecordReader::kHeaderSize) {
+      batch->status = errors::DataLoss("truncated record at ", offset);
+      batch->end_of_file = true;
+      break;
+    }
+    const bool wait_for_record = wait && batch->records.empty();
+
+    // Check the header, and that the whole record is in the file.
+    Status s;
+    Availability availability =
+        AvailableLocked(RecordReader::kHeaderSize, wait_for_record, l, &s);
+    if (availability == Availability::kPending) break;
+    if (availability == Availability::kFailed) {
+      batch->status = s;
+      batch->end_of_file = true;
+      break;
+    }
+    char header[RecordReader::kHeaderSize];
+    CopyLocked(RecordReader::kHeaderSize, header, /*consume=*/false);
+    const uint64 length = core::DecodeFixed64(header);
+    const uint32 masked_crc = core::DecodeFixed32(header + sizeof(uint64));
+    if (crc32c::Unmask(masked_crc) != crc32c::Value(header, sizeof(uint64))) {
+      batch->status = errors::DataLoss("corrupted record at ", offset);
+      batch->end_of_file = true;
+      break;
+    }
+    const uint64 max_length = file_size - offset - RecordReader::kHeaderSize;
+    if (max_length < RecordReader::kFooterSize ||
+        length > max_length - RecordReader::kFooterSize) {
+      batch->status = errors::DataLoss("truncated record at ", offset);
+      batch->end_of_file = true;
+      break;
+    }
+
+    // Wait for, or check the arrival of, the rest of the record.
+    const uint64 record_size =
+        RecordReader::kHeaderSize + length + RecordReader::kFooterSize;
+    availability = AvailableLocked(record_size, wait_for_record, l, &s);
+    if (availability == Availability::kPending) break;
+    if (availability == Availability::kFailed) {
+      batch->status = s;
+      batch->end_of_file = true;
+      break;
+    }
+
+    CopyLocked(RecordReader::kHeaderSize, nullptr, /*consume=*/true);
+    batch->offsets.push_back(offset);
+    batch->records.emplace_back();
+    tstring* record = &batch->records.back();
+    record->resize(length);
+    CopyLocked(length, &(*record)[0], /*consume=*/true);
+    char footer[RecordReader::kFooterSize];
+    CopyLocked(RecordReader::kFooterSize, footer, /*consume=*/true);
+    batch->masked_crcs.push_back(core::DecodeFixed32(footer));
+    batch_bytes += record_size;
+  }
+
+  if (batch->records.empty() && !batch->end_of_file) {
+    // Nothing has arrived yet.
+    return false;
+  }
+  batch->end_offset = frame_offset_;
+  if (batch->end_of_file) {
+    NextFrameFileLocked();
+  }
+  batches_.push_back(batch);
+
+  if (batch->records.empty()) {
+    batch->verified = true;
+  } else {
+    ++num_outstanding_;
+    pool_->Schedule([this, batch]() { VerifyBatch(batch); });
+  }
+  return true;
+}
+
+ParallelRecordReader::Availability ParallelRecordReader::AvailableLocked(
+    uint64 n, bool wait, mutex_lock* l, Status* status) {
+  // A record larger than the read-ahead window is requested past it.
+  const uint64 end = frame_offset_ + n;
+  while (issue_file_ == frame_file_ && issue_handle_ != nullptr &&
+         issue_offset_ < end) {
+    const size_t size = std::min<uint64>(options_.block_size,
+                                         file_sizes_[issue_file_] -
+                                             issue_offset_);
+    IssueReadLocked(issue_offset_, size);
+    issue_offset_ += size;
+  }
+
+  for (const std::shared_ptr<Block>& block : blocks_) {
+    if (block->file_index != frame_file_ || block->offset >= end) break;
+    while (!block->done) {
+      if (!wait) return Availability::kPending;
+      cond_var_.wait(*l);
+    }
+    if (!block->status.ok()) {
+      *status = block->status;
+      return Availability::kFailed;
+    }
+  }
+  return Availability::kAvailable;
+}
+
+void ParallelRecordReader::CopyLocked(uint64 n, char* dst, bool consume) {
+  uint64 offset = frame_offset_;
+  auto it = blocks_.begin();
+  while (n > 0) {
+    const Block& block = **it;
+    DCHECK_EQ(block.file_index, frame_file_);
+    DCHECK_LE(block.offset, offset);
+    const size_t pos = offset - block.offset;
+    const size_t m = std::min<uint64>(n, block.data.size() - pos);
+    if (dst != nullptr) {
+      memcpy(dst, block.data.data() + pos, m);
+      dst += m;
+    }
+    offset += m;
+    n -= m;
+    if (pos + m == block.data.size()) {
+      ++it;
+    }
+  }
+  if (consume) {
+    frame_offset_ = offset;
+    blocks_.erase(blocks_.begin(), it);
+  }
+}
+
+void ParallelRecordReader::NextFrameFileLocked() {
+  while (!blocks_.empty() && blocks_.front()->file_index == frame_file_) {
+    blocks_.pop_front();
+  }
+  if (issue_file_ == frame_file_) {
+    NextIssueFileLocked();
+  }
+  ++frame_file_;
+  frame_offset_ = 0;
+  MaybeIssueReadsLocked();
+}
+
+void ParallelRecordReader::VerifyBatch(const std::shared_ptr<Batch>& batch) {
+  size_t num_valid = 0;
+  while (num_valid < batch->records.size()) {
+    const tstring& record = batch->records[num_valid];
+    if (crc32c::Unmask(batch->masked_crcs[num_valid]) !=
+        crc32c::Value(record.data(), record.size())) {
+      break;
+    }
+    ++num_valid;
+  }
+
+  mutex_lock l(mu_);
+  batch->num_valid = num_valid;
+  if (num_valid < batch->records.size()) {
+    batch->status = errors::DataLoss("corrupted record at ",
+                                     batch->offsets[num_valid] +
+                                         RecordReader::kHeaderSize);
+  }
+  batch->verified = true;
+  --num_outstanding_;
+  cond_var_.notify_all();
+}
+
+void ParallelRecordReader::SkipFileLocked(size_t file_index) {
+  while (!batches_.empty() && batches_.front()->file_index == file_index) {
+    batches_.pop_front();
+  }
+  if (frame_file_ == file_index) {
+    NextFrameFileLocked();
+  }
+}
+
+}  // namespace io
+}  // namespace tensorflow
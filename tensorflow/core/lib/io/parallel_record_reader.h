@@ -0,0 +1,162 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_LIB_IO_PARALLEL_RECORD_READER_H_
+#define TENSORFLOW_CORE_LIB_IO_PARALLEL_RECORD_READER_H_
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace io {
+
+// Reads the records of a sequence of uncompressed TFRecord files, in order,
+// with the I/O and the checksum verification done ahead on a thread pool:
+//
+// - The files are read in blocks of `block_size` bytes, with up to
+//   `num_parallel_reads` blocks being read or buffered at a time. Once a file
+//   has been fully requested, the blocks of the following files are
+//   requested, so that small files are read in parallel too. Blocks are read
+//   with RandomAccessFile::ReadAsync() where the filesystem supports it, or
+//   with RandomAccessFile::Read() on the thread pool otherwise.
+// - The records of the blocks that have arrived are split off in batches of
+//   about `block_size` bytes, and the data checksums of each batch are
+//   verified on the thread pool.
+//
+// As with SequentialRecordReader, an error in a file (a failed read, a
+// truncated or corrupted record) is returned once, after the records that
+// precede it, and the rest of the file is skipped.
+//
+// Note: this class is not thread safe; external synchronization required.
+class ParallelRecordReader {
+ public:
+  struct Options {
+    // The number of bytes of each read.
+    int64 block_size = 1 << 20;
+    // The maximum number of blocks being read or buffered.
+    int num_parallel_reads = 8;
+  };
+
+  // Creates a reader of the records of `filenames`, starting at `offset` in
+  // the file `filenames[file_index]`. `pool` runs the reads and the checksum
+  // verifications, and must outlive the reader.
+  ParallelRecordReader(Env* env, std::vector<string> filenames,
+                       size_t file_index, uint64 offset,
+                       const Options& options, thread::ThreadPool* pool);
+
+  // Waits for the outstanding reads and verifications.
+  ~ParallelRecordReader();
+
+  // Reads the next record into *record. Returns OK on success, OUT_OF_RANGE
+  // after the last record of the last file, or the error of the current file.
+  Status ReadRecord(tstring* record);
+
+  // The position of the next record, from which a new reader can resume.
+  // Past the last record of a file, this is the start of the next file.
+  size_t file_index() const { return position_file_; }
+  uint64 offset() const { return position_offset_; }
+
+  // The number of bytes read from the files so far, including the blocks
+  // that are buffered but not returned yet.
+  int64 bytes_read() const;
+
+ private:
+  struct Block;
+  struct Batch;
+
+  // Whether the bytes of a record have arrived.
+  enum class Availability { kAvailable, kPending, kFailed };
+
+  // Requests blocks until `options_.num_parallel_reads` are in flight or
+  // buffered, or the last file has been fully requested.
+  void MaybeIssueReadsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Starts reading `n` bytes at `offset` of the file being requested.
+  void IssueReadLocked(uint64 offset, size_t n) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Moves on to requesting the next file.
+  void NextIssueFileLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Splits the next batch of records off the blocks of the file being framed,
+  // and starts verifying it. If `wait`, waits for the blocks of the first
+  // record; otherwise only frames the records that have arrived. Returns
+  // false if no batch was added.
+  bool FrameBatchLocked(bool wait, mutex_lock* l)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Checks whether the `n` bytes at the framing position have arrived,
+  // waiting for them if `wait`. Sets `*status` if they failed to be read.
+  Availability AvailableLocked(uint64 n, bool wait, mutex_lock* l,
+                               Status* status) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Copies the `n` bytes at the framing position to `dst`, if not null. If
+  // `consume`, moves the framing position past them.
+  void CopyLocked(uint64 n, char* dst, bool consume)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Moves on to framing the next file, dropping the blocks of the current one.
+  void NextFrameFileLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Verifies the data checksums of `batch`, on the thread pool.
+  void VerifyBatch(const std::shared_ptr<Batch>& batch);
+
+  // Skips the rest of the file `file_index`, after an error.
+  void SkipFileLocked(size_t file_index) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Env* const env_;
+  const std::vector<string> filenames_;
+  const Options options_;
+  thread::ThreadPool* const pool_;
+
+  mutable mutex mu_;
+  condition_variable cond_var_;
+  // The number of reads and verifications running on the thread pool.
+  int64 num_outstanding_ GUARDED_BY(mu_) = 0;
+  int64 bytes_read_ GUARDED_BY(mu_) = 0;
+
+  // The sizes of the files opened so far, and the errors of the files that
+  // failed to be opened.
+  std::vector<int64> file_sizes_ GUARDED_BY(mu_);
+  std::unordered_map<size_t, Status> file_errors_ GUARDED_BY(mu_);
+
+  // The next block to request.
+  size_t issue_file_ GUARDED_BY(mu_);
+  uint64 issue_offset_ GUARDED_BY(mu_);
+  std::shared_ptr<RandomAccessFile> issue_handle_ GUARDED_BY(mu_);
+
+  // The blocks requested, in file and offset order. The first one holds the
+  // framing position.
+  std::deque<std::shared_ptr<Block>> blocks_ GUARDED_BY(mu_);
+  size_t frame_file_ GUARDED_BY(mu_);
+  uint64 frame_offset_ GUARDED_BY(mu_);
+
+  // The batches of records framed but not returned yet, in order.
+  std::deque<std::shared_ptr<Batch>> batches_ GUARDED_BY(mu_);
+
+  size_t position_file_;
+  uint64 position_offset_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ParallelRecordReader);
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_LIB_IO_PARALLEL_RECORD_READER_H_
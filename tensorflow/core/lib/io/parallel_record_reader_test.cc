@@ -0,0 +1,384 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/parallel_record_reader.h"
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/null_file_system.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+string TestFilename(const string& name) {
+  return JoinPath(testing::TmpDir(), strings::StrCat("parallel_record_", name));
+}
+
+void WriteRecords(const string& filename, const std::vector<string>& records) {
+  std::unique_ptr<WritableFile> file;
+  TF_CHECK_OK(Env::Default()->NewWritableFile(filename, &file));
+  RecordWriter writer(file.get());
+  for (const string& record : records) {
+    TF_CHECK_OK(writer.WriteRecord(record));
+  }
+  TF_CHECK_OK(writer.Close());
+  TF_CHECK_OK(file->Close());
+}
+
+std::vector<string> MakeRecords(const string& prefix, int num_records,
+                                int record_size) {
+  std::vector<string> records;
+  for (int i = 0; i < num_records; ++i) {
+    string record = strings::StrCat(prefix, i, ":");
+    record.resize(record_size + record.size(), 'a' + i % 26);
+    records.push_back(record);
+  }
+  return records;
+}
+
+// Reads the records until the end or an error, which is returned.
+Status ReadAll(ParallelRecordReader* reader, std::vector<string>* records) {
+  while (true) {
+    tstring record;
+    Status s = reader->ReadRecord(&record);
+    if (!s.ok()) return s;
+    records->push_back(record);
+  }
+}
+
+class ParallelRecordReaderTest : public ::testing::Test {
+ protected:
+  ParallelRecordReaderTest() : pool_(Env::Default(), "test", 4) {}
+
+  std::unique_ptr<ParallelRecordReader> NewReader(
+      const std::vector<string>& filenames, int64 block_size,
+      int num_parallel_reads, Env* env = Env::Default()) {
+    ParallelRecordReader::Options options;
+    options.block_size = block_size;
+    options.num_parallel_reads = num_parallel_reads;
+    return std::unique_ptr<ParallelRecordReader>(
+        new ParallelRecordReader(env, filenames, 0, 0, options, &pool_));
+  }
+
+  thread::ThreadPool pool_;
+};
+
+TEST_F(ParallelRecordReaderTest, ReadsFilesInOrder) {
+  const std::vector<std::vector<string>> contents = {
+      MakeRecords("a", 10, 5), {}, MakeRecords("b", 1, 0),
+      MakeRecords("c", 50, 100)};
+  std::vector<string> filenames;
+  std::vector<string> expected;
+  for (int i = 0; i < contents.size(); ++i) {
+    filenames.push_back(TestFilename(strings::StrCat("in_order_", i)));
+    WriteRecords(filenames.back(), contents[i]);
+    expected.insert(expected.end(), contents[i].begin(), contents[i].end());
+  }
+
+  for (int64 block_size : {1, 7, 16, 100, 4096, 1 << 20}) {
+    for (int num_parallel_reads : {1, 2, 8}) {
+      auto reader = NewReader(filenames, block_size, num_parallel_reads);
+      std::vector<string> records;
+      EXPECT_TRUE(errors::IsOutOfRange(ReadAll(reader.get(), &records)));
+      EXPECT_EQ(expected, records)
+          << "block_size: " << block_size
+          << " num_parallel_reads: " << num_parallel_reads;
+      // The end is sticky.
+      tstring record;
+      EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&record)));
+    }
+  }
+}
+
+TEST_F(ParallelRecordReaderTest, RecordsLargerThanTheReadWindow) {
+  const std::vector<string> expected = MakeRecords("large", 5, 1000);
+  const string filename = TestFilename("large");
+  WriteRecords(filename, expected);
+
+  auto reader = NewReader({filename}, 16, 2);
+  std::vector<string> records;
+  EXPECT_TRUE(errors::IsOutOfRange(ReadAll(reader.get(), &records)));
+  EXPECT_EQ(expected, records);
+  uint64 file_size;
+  TF_ASSERT_OK(Env::Default()->GetFileSize(filename, &file_size));
+  EXPECT_EQ(file_size, reader->bytes_read());
+}
+
+TEST_F(ParallelRecordReaderTest, CorruptedRecordSkipsTheRestOfItsFile) {
+  const std::vector<string> first = MakeRecords("first", 4, 10);
+  const std::vector<string> second = MakeRecords("second", 3, 10);
+  const std::vector<string> filenames = {TestFilename("corrupted_0"),
+                                         TestFilename("corrupted_1")};
+  WriteRecords(filenames[0], first);
+  WriteRecords(filenames[1], second);
+
+  // Flip a byte of the data of the third record.
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), filenames[0], &data));
+  const size_t record_size =
+      RecordReader::kHeaderSize + first[0].size() + RecordReader::kFooterSize;
+  data[2 * record_size + RecordReader::kHeaderSize + 1] ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filenames[0], data));
+
+  for (int64 block_size : {8, 1 << 20}) {
+    auto reader = NewReader(filenames, block_size, 4);
+    std::vector<string> records;
+    Status s = ReadAll(reader.get(), &records);
+    EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+    EXPECT_EQ(std::vector<string>(first.begin(), first.begin() + 2), records);
+    EXPECT_EQ(1, reader->file_index());
+    EXPECT_EQ(0, reader->offset());
+
+    records.clear();
+    EXPECT_TRUE(errors::IsOutOfRange(ReadAll(reader.get(), &records)));
+    EXPECT_EQ(second, records);
+  }
+}
+
+TEST_F(ParallelRecordReaderTest, CorruptedHeader) {
+  const std::vector<string> expected = MakeRecords("header", 3, 10);
+  const string filename = TestFilename("corrupted_header");
+  WriteRecords(filename, expected);
+
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), filename, &data));
+  const size_t record_size = RecordReader::kHeaderSize + expected[0].size() +
+                             RecordReader::kFooterSize;
+  data[record_size] ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, data));
+
+  auto reader = NewReader({filename}, 1 << 20, 4);
+  std::vector<string> records;
+  Status s = ReadAll(reader.get(), &records);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+  EXPECT_EQ(std::vector<string>(1, expected[0]), records);
+  tstring record;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&record)));
+}
+
+TEST_F(ParallelRecordReaderTest, TruncatedFile) {
+  const std::vector<string> expected = MakeRecords("truncated", 3, 10);
+  const string filename = TestFilename("truncated");
+  WriteRecords(filename, expected);
+
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), filename, &data));
+  data.resize(data.size() - 1);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, data));
+
+  for (int64 block_size : {3, 1 << 20}) {
+    auto reader = NewReader({filename}, block_size, 2);
+    std::vector<string> records;
+    Status s = ReadAll(reader.get(), &records);
+    EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+    EXPECT_EQ(std::vector<string>(expected.begin(), expected.begin() + 2),
+              records);
+  }
+}
+
+TEST_F(ParallelRecordReaderTest, MissingFile) {
+  const std::vector<string> expected = MakeRecords("present", 3, 10);
+  const std::vector<string> filenames = {TestFilename("does_not_exist"),
+                                         TestFilename("present")};
+  WriteRecords(filenames[1], expected);
+
+  auto reader = NewReader(filenames, 1 << 20, 4);
+  std::vector<string> records;
+  EXPECT_TRUE(errors::IsNotFound(ReadAll(reader.get(), &records)));
+  EXPECT_TRUE(records.empty());
+  EXPECT_TRUE(errors::IsOutOfRange(ReadAll(reader.get(), &records)));
+  EXPECT_EQ(expected, records);
+}
+
+TEST_F(ParallelRecordReaderTest, ResumesFromPosition) {
+  const std::vector<string> first = MakeRecords("first", 5, 20);
+  const std::vector<string> second = MakeRecords("second", 5, 20);
+  const std::vector<string> filenames = {TestFilename("resume_0"),
+                                         TestFilename("resume_1")};
+  WriteRecords(filenames[0], first);
+  WriteRecords(filenames[1], second);
+  std::vector<string> expected = first;
+  expected.insert(expected.end(), second.begin(), second.end());
+
+  for (int num_records = 0; num_records <= expected.size(); ++num_records) {
+    std::vector<string> records;
+    size_t file_index;
+    uint64 offset;
+    {
+      auto reader = NewReader(filenames, 32, 4);
+      for (int i = 0; i < num_records; ++i) {
+        tstring record;
+        TF_ASSERT_OK(reader->ReadRecord(&record));
+        records.push_back(record);
+      }
+      file_index = reader->file_index();
+      offset = reader->offset();
+    }
+    ParallelRecordReader::Options options;
+    options.block_size = 32;
+    ParallelRecordReader reader(Env::Default(), filenames, file_index, offset,
+                                options, &pool_);
+    EXPECT_TRUE(errors::IsOutOfRange(ReadAll(&reader, &records)));
+    EXPECT_EQ(expected, records) << "num_records: " << num_records;
+  }
+}
+
+// A file that reads asynchronously on a thread of its own.
+class AsyncFile : public RandomAccessFile {
+ public:
+  AsyncFile(std::unique_ptr<RandomAccessFile> file,
+            std::atomic<int>* num_async_reads)
+      : file_(std::move(file)), num_async_reads_(num_async_reads) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    return errors::Internal("Read() called on an async file");
+  }
+
+  Status ReadAsync(uint64 offset, size_t n, char* scratch,
+                   ReadDoneCallback done) const override {
+    ++*num_async_reads_;
+    Env::Default()->SchedClosure([this, offset, n, scratch, done]() {
+      StringPiece result;
+      Status s = file_->Read(offset, n, &result, scratch);
+      done(s, result);
+    });
+    return Status::OK();
+  }
+
+ private:
+  const std::unique_ptr<RandomAccessFile> file_;
+  std::atomic<int>* const num_async_reads_;
+};
+
+// A filesystem whose files read asynchronously.
+class AsyncFileSystem : public NullFileSystem {
+ public:
+  Status NewRandomAccessFile(
+      const string& fname, std::unique_ptr<RandomAccessFile>* result) override {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_RETURN_IF_ERROR(Env::Default()->NewRandomAccessFile(fname, &file));
+    result->reset(new AsyncFile(std::move(file), &num_async_reads));
+    return Status::OK();
+  }
+
+  Status GetFileSize(const string& fname, uint64* file_size) override {
+    return Env::Default()->GetFileSize(fname, file_size);
+  }
+
+  std::atomic<int> num_async_reads{0};
+};
+
+class AsyncEnv : public EnvWrapper {
+ public:
+  AsyncEnv() : EnvWrapper(Env::Default()) {}
+
+  Status GetFileSystemForFile(const string& fname,
+                              FileSystem** result) override {
+    *result = &file_system;
+    return Status::OK();
+  }
+
+  AsyncFileSystem file_system;
+};
+
+TEST_F(ParallelRecordReaderTest, UsesReadAsync) {
+  const std::vector<string> expected = MakeRecords("async", 20, 10);
+  const string filename = TestFilename("async");
+  WriteRecords(filename, expected);
+
+  AsyncEnv env;
+  auto reader = NewReader({filename}, 16, 4, &env);
+  std::vector<string> records;
+  EXPECT_TRUE(errors::IsOutOfRange(ReadAll(reader.get(), &records)));
+  EXPECT_EQ(expected, records);
+  EXPECT_GT(env.file_system.num_async_reads, 1);
+}
+
+// Reads `num_files` files of 16MB, with records of `record_size` bytes.
+void WriteBenchmarkFiles(int num_files, int record_size,
+                         std::vector<string>* filenames) {
+  const int num_records = (16 << 20) / record_size;
+  const std::vector<string> records = MakeRecords("", num_records, record_size);
+  for (int i = 0; i < num_files; ++i) {
+    filenames->push_back(TestFilename(
+        strings::StrCat("benchmark_", num_files, "_", record_size, "_", i)));
+    WriteRecords(filenames->back(), records);
+  }
+}
+
+void BM_SequentialRecordReader(int iters, int num_files, int record_size) {
+  testing::StopTiming();
+  std::vector<string> filenames;
+  WriteBenchmarkFiles(num_files, record_size, &filenames);
+  testing::StartTiming();
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    for (const string& filename : filenames) {
+      std::unique_ptr<RandomAccessFile> file;
+      TF_CHECK_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+      SequentialRecordReader reader(
+          file.get(), RecordReaderOptions::CreateRecordReaderOptions(""));
+      tstring record;
+      while (reader.ReadRecord(&record).ok()) {
+        bytes += record.size();
+      }
+    }
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_SequentialRecordReader)
+    ->ArgPair(1, 100)
+    ->ArgPair(1, 10000)
+    ->ArgPair(8, 100)
+    ->ArgPair(8, 10000);
+
+void BM_ParallelRecordReader(int iters, int num_files, int record_size) {
+  testing::StopTiming();
+  std::vector<string> filenames;
+  WriteBenchmarkFiles(num_files, record_size, &filenames);
+  thread::ThreadPool pool(Env::Default(), "benchmark", 8);
+  testing::StartTiming();
+  int64 bytes = 0;
+  for (int i = 0; i < iters; ++i) {
+    ParallelRecordReader reader(Env::Default(), filenames, 0, 0,
+                                ParallelRecordReader::Options(), &pool);
+    tstring record;
+    while (reader.ReadRecord(&record).ok()) {
+      bytes += record.size();
+    }
+  }
+  testing::BytesProcessed(bytes);
+}
+BENCHMARK(BM_ParallelRecordReader)
+    ->ArgPair(1, 100)
+    ->ArgPair(1, 10000)
+    ->ArgPair(8, 100)
+    ->ArgPair(8, 10000);
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
@@ -315,6 +315,33 @@ REGISTER_OP("_UnaryOpsComposition")
 expected to create these operators.
 )doc");
 
+REGISTER_OP("_FusedElementwise")
+    .Input("args: num_args * T")
+    .Output("y: T")
+    .Attr("T: {float, double}")
+    .Attr("num_args: int >= 1")
+    .Attr("op_names: list(string)")
+    .Attr("operands: list(int)")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle out = c->input(0);
+      for (int i = 1; i < c->num_inputs(); ++i) {
+        TF_RETURN_IF_ERROR(
+            BroadcastBinaryOpOutputShapeFnHelper(c, out, c->input(i), &out));
+      }
+      c->set_output(0, out);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Evaluates a chain of unary and binary elementwise ops, with broadcasting, in a
+single kernel. The i-th op in `op_names` reads the values at indices
+`operands[2 * i]` and `operands[2 * i + 1]` (-1 for unary ops), where the
+first `num_args` values are the inputs and value `num_args + i` is the result
+of the i-th op. The result of the last op is the output.
+
+*NOTE*: Do not invoke this operator directly in Python. Graph rewrite pass is
+expected to create these operators.
+)doc");
+
 #undef UNARY
 #undef UNARY_REAL
 #undef UNARY_COMPLEX
@@ -261,6 +261,25 @@ class RandomAccessFile {
   virtual Status Read(uint64 offset, size_t n, StringPiece* result,
                       char* scratch) const = 0;
 
+  typedef std::function<void(const Status&, StringPiece)> ReadDoneCallback;
+
+  /// \brief Starts reading up to `n` bytes from the file starting at
+  /// `offset`, without blocking the caller.
+  ///
+  /// `done` is called, possibly on another thread, with the status and the
+  /// data that `Read(offset, n, &result, scratch)` would have returned.
+  /// `scratch[0..n-1]` and the file must be live until then.
+  ///
+  /// If the read cannot be started, returns its error without calling
+  /// `done`. This is an optional operation for filesystems with native
+  /// asynchronous I/O: it returns `UNIMPLEMENTED` if it is not supported, and
+  /// callers then call `Read()` on a thread of their own.
+  virtual Status ReadAsync(uint64 offset, size_t n, char* scratch,
+                           ReadDoneCallback done) const {
+    return errors::Unimplemented(
+        "This filesystem does not support ReadAsync()");
+  }
+
   // TODO(ebrevdo): Remove this ifdef when absl is updated.
 #if defined(PLATFORM_GOOGLE)
   /// \brief Read up to `n` bytes from the file starting at `offset`.
@@ -185,6 +185,14 @@ int NUMANumNodes() {
 void NUMASetThreadNodeAffinity(int node) {
 #ifdef TENSORFLOW_USE_NUMA
   if (HaveHWLocTopology()) {
+    if (node == kNUMANoAffinity) {
+      // Let the thread run on any CPU that the process may use.
+      hwloc_set_cpubind(
+          hwloc_topology_handle,
+          hwloc_topology_get_allowed_cpuset(hwloc_topology_handle),
+          HWLOC_CPUBIND_THREAD);
+      return;
+    }
     // Find the corresponding NUMA node topology object.
     hwloc_obj_t obj = GetHWLocTypeIndex(HWLOC_OBJ_NUMANODE, node);
     if (obj) {
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <cstring>
 #include <vector>
 
 #include "absl/base/casts.h"
@@ -64,6 +65,92 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+// Packed int64 lists are decoded straight from the serialized bytes instead
+// of one `ReadVarint64()` call at a time. The bytes are scanned 8 at a time,
+// as a 64-bit word: the number of varints in a word is the number of bytes
+// without a continuation bit, and a word without any continuation bit holds 8
+// one-byte varints, which is the common case for ids and labels.
+constexpr uint64 kContinuationBits = 0x8080808080808080ULL;
+
+inline uint64 LoadWord(const uint8* p) {
+  uint64 word;
+  std::memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+// Returns the number of varints that end in [begin, end).
+inline size_t CountVarints(const uint8* begin, const uint8* end) {
+  size_t count = 0;
+  const uint8* p = begin;
+  for (; end - p >= 8; p += 8) {
+    // One bit per byte that ends a varint, in the lowest bit of the byte.
+    const uint64 ends = (~LoadWord(p) & kContinuationBits) >> 7;
+    // Sums the bytes of `ends` into the top byte.
+    count += (ends * 0x0101010101010101ULL) >> 56;
+  }
+  for (; p < end; ++p) {
+    if (*p < 0x80) ++count;
+  }
+  return count;
+}
+
+// Decodes the varint at `p`, which must end before `end`. Returns the position
+// that follows it, or nullptr if the varint is truncated or too long.
+inline const uint8* DecodeVarint64(const uint8* p, const uint8* end,
+                                   uint64* value) {
+  uint64 result = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    const uint64 byte = *p++;
+    result |= (byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      *value = result;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Decodes the packed varints in [begin, end) into `out`, which has room for
+// `out_size` values. Values that do not fit are validated but dropped. Returns
+// false if the varints are malformed.
+template <typename T>
+bool DecodePackedVarints(const uint8* begin, const uint8* end, T* out,
+                         size_t out_size) {
+  const uint8* p = begin;
+  size_t i = 0;
+  while (p < end) {
+    if (end - p >= 8 && i + 8 <= out_size &&
+        (LoadWord(p) & kContinuationBits) == 0) {
+      for (int k = 0; k < 8; ++k) out[i + k] = static_cast<T>(p[k]);
+      p += 8;
+      i += 8;
+      continue;
+    }
+    uint64 value;
+    p = DecodeVarint64(p, end, &value);
+    if (p == nullptr) return false;
+    if (i < out_size) out[i] = static_cast<T>(value);
+    ++i;
+  }
+  return true;
+}
+
+// Gets the `length` bytes at the current position of `stream`, which must be
+// within a limit of exactly `length` bytes, and skips them. Returns false if
+// the bytes are not contiguous in memory.
+inline bool ReadPackedBytes(protobuf::io::CodedInputStream* stream,
+                            uint32 length, const uint8** begin,
+                            const uint8** end) {
+  const void* data;
+  int size;
+  if (!stream->GetDirectBufferPointer(&data, &size) || size != length) {
+    return false;
+  }
+  *begin = static_cast<const uint8*>(data);
+  *end = *begin + length;
+  return stream->Skip(length);
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -240,6 +327,22 @@ class Feature {
         if (!stream.ReadVarint32(&packed_length)) return false;
         auto packed_limit = stream.PushLimit(packed_length);
 
+        const uint8* packed_begin;
+        const uint8* packed_end;
+        if (packed_length > 0 &&
+            ReadPackedBytes(&stream, packed_length, &packed_begin,
+                            &packed_end)) {
+          // Resize the output once, then decode into it. `size()` can be less
+          // than requested in case of a LimitedArraySlice.
+          const size_t initial_size = int64_list->size();
+          int64_list->resize(initial_size +
+                             CountVarints(packed_begin, packed_end));
+          if (!DecodePackedVarints(packed_begin, packed_end,
+                                   int64_list->data() + initial_size,
+                                   int64_list->size() - initial_size)) {
+            return false;
+          }
+        }
         while (!stream.ExpectAtEnd()) {
           protobuf_uint64 n;  // There is no API for int64
           if (!stream.ReadVarint64(&n)) return false;
@@ -542,7 +645,7 @@ void LogSparseFeatureDataLoss(StringPiece feature_name) {
 }
 
 Status FastParseSerializedExample(
-    const string& serialized_example, const string& example_name,
+    StringPiece serialized_example, StringPiece example_name,
     const size_t example_index, const Config& config,
     const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
     SeededHasher hasher, std::vector<Tensor>* output_dense,
@@ -999,12 +1102,12 @@ class TensorVector {
   T* data_ = nullptr;
 };
 
-}  // namespace
-
-Status FastParseExample(const Config& config,
-                        gtl::ArraySlice<tstring> serialized,
-                        gtl::ArraySlice<tstring> example_names,
-                        thread::ThreadPool* thread_pool, Result* result) {
+// Parses `serialized`, a slice of strings or of views of strings.
+template <typename StringType>
+Status FastParseExampleImpl(const Config& config,
+                            gtl::ArraySlice<StringType> serialized,
+                            gtl::ArraySlice<tstring> example_names,
+                            thread::ThreadPool* thread_pool, Result* result) {
   DCHECK(result != nullptr);
   // Check config so we can safely CHECK(false) in switches on config.*.dtype
   for (auto& c : config.sparse) {
@@ -1110,8 +1213,9 @@ Status FastParseExample(const Config& config,
       }
       status_of_minibatch[minibatch] = FastParseSerializedExample(
           serialized[e],
-          (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
-          config_index, hasher, &fixed_dense_values,
+          (!example_names.empty() ? StringPiece(example_names[e])
+                                  : StringPiece("<unknown>")),
+          e, config, config_index, hasher, &fixed_dense_values,
           &varlen_dense_buffers[minibatch], &sparse_buffers[minibatch], stats);
       if (!status_of_minibatch[minibatch].ok()) break;
     }
@@ -1273,6 +1377,24 @@ Status FastParseExample(const Config& config,
   return Status::OK();
 }
 
+}  // namespace
+
+Status FastParseExample(const Config& config,
+                        gtl::ArraySlice<tstring> serialized,
+                        gtl::ArraySlice<tstring> example_names,
+                        thread::ThreadPool* thread_pool, Result* result) {
+  return FastParseExampleImpl(config, serialized, example_names, thread_pool,
+                              result);
+}
+
+Status FastParseExample(const Config& config,
+                        gtl::ArraySlice<StringPiece> serialized,
+                        gtl::ArraySlice<tstring> example_names,
+                        thread::ThreadPool* thread_pool, Result* result) {
+  return FastParseExampleImpl(config, serialized, example_names, thread_pool,
+                              result);
+}
+
 Status FastParseSingleExample(const Config& config,
                               absl::string_view serialized, Result* result) {
   DCHECK(result != nullptr);
@@ -1694,6 +1816,14 @@ inline int ParseFloatFeature(protobuf::io::CodedInputStream* stream,
         return -1;
       }
       auto packed_limit = stream->PushLimit(packed_length);
+      if (port::kLittleEndian && packed_length % sizeof(float) == 0) {
+        num_elements = packed_length / sizeof(float);
+        if (out == nullptr) {
+          if (!stream->Skip(packed_length)) return -1;
+        } else if (!stream->ReadRaw(out, packed_length)) {
+          return -1;
+        }
+      }
       while (!stream->ExpectAtEnd()) {
         uint32 buffer32;
         if (!stream->ReadLittleEndian32(&buffer32)) {
@@ -1745,6 +1875,17 @@ inline int ParseInt64Feature(protobuf::io::CodedInputStream* stream,
         return -1;
       }
       auto packed_limit = stream->PushLimit(packed_length);
+      const uint8* packed_begin;
+      const uint8* packed_end;
+      if (packed_length > 0 && ReadPackedBytes(stream, packed_length,
+                                               &packed_begin, &packed_end)) {
+        num_elements = CountVarints(packed_begin, packed_end);
+        if (out != nullptr &&
+            !DecodePackedVarints(packed_begin, packed_end, out,
+                                 num_elements)) {
+          return -1;
+        }
+      }
       while (!stream->ExpectAtEnd()) {
         protobuf_uint64 n;  // There is no API for int64
         if (!stream->ReadVarint64(&n)) {
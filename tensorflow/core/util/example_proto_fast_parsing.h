@@ -103,6 +103,14 @@ Status FastParseExample(const FastParseExampleConfig& config,
                         gtl::ArraySlice<tstring> example_names,
                         thread::ThreadPool* thread_pool, Result* result);
 
+// As above, but parses views of the serialized Example protos, which must
+// stay valid for the duration of the call. This parses records in place, e.g.
+// the records of an io::MappedRecordReader, without copying them first.
+Status FastParseExample(const FastParseExampleConfig& config,
+                        gtl::ArraySlice<StringPiece> serialized,
+                        gtl::ArraySlice<tstring> example_names,
+                        thread::ThreadPool* thread_pool, Result* result);
+
 // TODO(mrry): Move the hash table construction into the config object.
 typedef FastParseExampleConfig FastParseSingleExampleConfig;
 
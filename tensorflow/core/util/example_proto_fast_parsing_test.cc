@@ -13,12 +13,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <limits>
 #include <utility>
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/mapped_record_reader.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -170,6 +176,33 @@ TEST(FastParse, Packed) {
       "\x0a\x0d\x0a\x0b\x0a\x03\x61\x67\x65\x12\x04\x1a\x02\x08\x0d");
 }
 
+TEST(FastParse, PackedInt64OfAllLengths) {
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["age"]
+          .mutable_int64_list();
+  // Long runs of one-byte varints, interleaved with longer ones.
+  for (int64 i = 0; i < 300; ++i) {
+    int64_list->add_value(i);
+    if (i % 37 == 0) int64_list->add_value(int64{1} << (i % 63));
+  }
+  int64_list->add_value(-1);
+  int64_list->add_value(std::numeric_limits<int64>::min());
+  int64_list->add_value(std::numeric_limits<int64>::max());
+  TestCorrectness(Serialize(example));
+}
+
+TEST(FastParse, TruncatedPackedInt64) {
+  // Like `NonPacked`, but the last byte of the varint has its continuation bit
+  // set.
+  const string serialized =
+      "\x0a\x0e\x0a\x0c\x0a\x03\x61\x67\x65\x12\x05\x1a\x03\x0a\x01"
+      "\x8d";
+  Example example;
+  EXPECT_FALSE(example.ParseFromString(serialized));
+  EXPECT_FALSE(TestFastParse(serialized, &example));
+}
+
 TEST(FastParse, EmptyFeatures) {
   Example example;
   example.mutable_features();
@@ -321,6 +354,22 @@ TEST(FastParse, StatsCollection) {
   }
 }
 
+TEST(FastParse, DenseInt64WithTooManyValues) {
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["int64_list"]
+          .mutable_int64_list();
+  for (int64 i = 0; i < 20; ++i) int64_list->add_value(i);
+  std::vector<tstring> serialized = {Serialize(example)};
+
+  FastParseExampleConfig config;
+  AddDenseFeature("int64_list", DT_INT64, {3}, false, 3, &config);
+  Result result;
+  Status s = FastParseExample(config, serialized, {}, nullptr, &result);
+  EXPECT_TRUE(errors::IsInvalidArgument(s));
+  EXPECT_NE(s.error_message().find("Values size: 20"), string::npos) << s;
+}
+
 string RandStr(random::SimplePhilox* rng) {
   static const char key_char_lookup[] =
       "0123456789{}~`!@#$%^&*()"
@@ -423,6 +472,55 @@ TEST(TestFastParseExample, Empty) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(TestFastParseExample, ParsesMappedRecords) {
+  const size_t kNumExamples = 10;
+  const string filename =
+      io::JoinPath(testing::TmpDir(), "fast_parse_mapped_records");
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_ASSERT_OK(Env::Default()->NewWritableFile(filename, &file));
+    io::RecordWriter writer(file.get());
+    for (size_t i = 0; i < kNumExamples; ++i) {
+      TF_ASSERT_OK(writer.WriteRecord(ExampleWithSomeFeatures()));
+    }
+    TF_ASSERT_OK(writer.Close());
+    TF_ASSERT_OK(file->Close());
+  }
+
+  std::unique_ptr<io::MappedRecordReader> reader;
+  TF_ASSERT_OK(
+      io::MappedRecordReader::Create(Env::Default(), filename, &reader));
+  std::vector<StringPiece> views;
+  std::vector<tstring> copies;
+  uint64 offset = 0;
+  StringPiece record;
+  while (reader->ReadRecord(&offset, &record).ok()) {
+    views.push_back(record);
+    copies.emplace_back(record);
+  }
+  ASSERT_EQ(kNumExamples, views.size());
+
+  FastParseExampleConfig config;
+  AddDenseFeature("bytes_list", DT_STRING, {2}, false, 2, &config);
+  AddDenseFeature("float_list", DT_FLOAT, {-1}, true, 1, &config);
+  AddSparseFeature("int64_list", DT_INT64, &config);
+
+  Result from_views;
+  TF_ASSERT_OK(FastParseExample(config, views, {}, nullptr, &from_views));
+  Result from_copies;
+  TF_ASSERT_OK(FastParseExample(config, copies, {}, nullptr, &from_copies));
+  test::ExpectTensorEqual<tstring>(from_copies.dense_values[0],
+                                   from_views.dense_values[0]);
+  test::ExpectTensorEqual<float>(from_copies.dense_values[1],
+                                 from_views.dense_values[1]);
+  test::ExpectTensorEqual<int64>(from_copies.sparse_indices[0],
+                                 from_views.sparse_indices[0]);
+  test::ExpectTensorEqual<int64>(from_copies.sparse_values[0],
+                                 from_views.sparse_values[0]);
+  test::ExpectTensorEqual<int64>(from_copies.sparse_shapes[0],
+                                 from_views.sparse_shapes[0]);
+}
+
 }  // namespace
 }  // namespace example
 }  // namespace tensorflow
@@ -29,8 +29,11 @@ from tensorflow.python.data.util import nest
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import image_ops
 from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import nn
 from tensorflow.python.ops import parsing_ops
+from tensorflow.python.ops import string_ops
 from tensorflow.python.platform import test
 
 
@@ -171,12 +174,81 @@ class MapVectorizationBenchmark(test.Benchmark):
 
   def benchmark_parse_single_example(self):
     # NOTE: Since we haven't implemented a vectorizer for "SerializeSparse",
-    # this function is only naively vectorized.
+    # the cost model prevents this function from being vectorized.
     parse_fn, parse_factory = _generate_parse_single_example_test_case()
 
     self._benchmark_helper(parse_fn, "parse_single_example",
                            lambda: [parse_factory()])
 
+  # Typical preprocessing functions
+  def benchmark_normalize_string(self):
+
+    def normalize_fn(x):
+      x = string_ops.string_strip(string_ops.string_lower(x))
+      return string_ops.regex_replace(x, "[^a-z0-9 ]", "")
+
+    def string_factory():
+      yield dataset_ops.Dataset.from_tensor_slices(
+          [" Hello, World! ", "The QUICK brown fox.", "tf.data"])
+
+    self._benchmark_helper(normalize_fn, "normalize_string", string_factory)
+
+  def benchmark_hash_string(self):
+
+    def hash_fn(x):
+      return string_ops.string_to_hash_bucket_fast(
+          string_ops.string_lower(x), 1000)
+
+    def string_factory():
+      yield dataset_ops.Dataset.from_tensor_slices(
+          [str(i) for i in range(100)])
+
+    self._benchmark_helper(hash_fn, "hash_string", string_factory)
+
+  def benchmark_resize_and_normalize_image(self):
+
+    def image_fn(x):
+      x = image_ops.resize_bilinear(x, (32, 32))
+      return (x - 0.5) * 2.
+
+    def image_factory():
+      for sz in [(10, 1, 64, 64, 3), (10, 1, 128, 128, 3)]:
+        yield dataset_ops.Dataset.from_tensor_slices(
+            np.random.rand(*sz).astype(np.float32))
+
+    self._benchmark_helper(image_fn, "resize_and_normalize_image",
+                           image_factory)
+
+  def benchmark_vocabulary_lookup(self):
+    vocabulary = constant_op.constant([str(i) for i in range(1000)])
+
+    def index_factory():
+      yield dataset_ops.Dataset.range(1000)
+
+    self._benchmark_helper(lambda x: array_ops.gather(vocabulary, x),
+                           "vocabulary_lookup", index_factory)
+
+  def benchmark_decode_csv_and_cast(self):
+    csv_fn, csv_factory = _generate_csv_test_case()
+
+    def decode_and_cast_fn(x):
+      a, b, c = csv_fn(x)
+      b = math_ops.cast(b, dtypes.float32)
+      return a * 2., b, string_ops.string_upper(c)
+
+    self._benchmark_helper(decode_and_cast_fn, "decode_csv_and_cast",
+                           lambda: [csv_factory()])
+
+  def benchmark_partially_vectorizable(self):
+    # There is no vectorizer for `MatMul`, so only the ops before and after it
+    # are vectorized.
+    def partial_fn(x):
+      x = math_ops.cast(x, dtypes.float32) * 2.
+      x = math_ops.matmul(x, x, transpose_b=True)
+      return nn.relu(x + 1.)
+
+    self._benchmark_helper(partial_fn, "partially_vectorizable")
+
   def _default_dataset_factory(self):
     input_sizes = [(10, 10, 3), (10, 100, 300)]
     for sz in input_sizes:
@@ -43,7 +43,12 @@ class SnapshotDatasetBenchmark(benchmark_base.DatasetBenchmarkBase):
     return tmp_dir
 
   def _createSimpleDataset(self, num_elems, tmp_dir=None,
-                           compression=snapshot.COMPRESSION_NONE):
+                           compression=snapshot.COMPRESSION_NONE,
+                           raw_tensor_encoding=True,
+                           num_writer_threads=None,
+                           num_reader_threads=None,
+                           reader_buffer_size=None,
+                           deterministic_reads=None):
     if not tmp_dir:
       tmp_dir = self._makeSnapshotDirectory()
 
@@ -51,7 +56,15 @@ class SnapshotDatasetBenchmark(benchmark_base.DatasetBenchmarkBase):
     dataset = dataset.map(
         lambda x: gen_array_ops.broadcast_to(x, [50, 50, 3]))
     dataset = dataset.repeat(num_elems)
-    dataset = dataset.apply(snapshot.snapshot(tmp_dir, compression=compression))
+    dataset = dataset.apply(
+        snapshot.snapshot(
+            tmp_dir,
+            compression=compression,
+            num_writer_threads=num_writer_threads,
+            num_reader_threads=num_reader_threads,
+            reader_buffer_size=reader_buffer_size,
+            raw_tensor_encoding=raw_tensor_encoding,
+            deterministic_reads=deterministic_reads))
 
     return dataset
 
@@ -111,6 +124,45 @@ class SnapshotDatasetBenchmark(benchmark_base.DatasetBenchmarkBase):
     self._consumeDataset(dataset, num_elems)
     self.run_and_report_benchmark(dataset, num_elems, "read_gzip")
 
+  def benchmarkReadSnapshotProtoEncoding(self):
+    num_elems = 100000
+    tmp_dir = self._makeSnapshotDirectory()
+    dataset = self._createSimpleDataset(
+        num_elems, tmp_dir, raw_tensor_encoding=False)
+
+    self._consumeDataset(dataset, num_elems)
+    self.run_and_report_benchmark(dataset, num_elems, "read_proto_encoding")
+
+  def benchmarkReadSnapshotParallelGzip(self):
+    num_elems = 100000
+    tmp_dir = self._makeSnapshotDirectory()
+    dataset = self._createSimpleDataset(
+        num_elems,
+        tmp_dir,
+        compression=snapshot.COMPRESSION_GZIP,
+        num_writer_threads=4,
+        num_reader_threads=4,
+        reader_buffer_size=64)
+
+    self._consumeDataset(dataset, num_elems)
+    self.run_and_report_benchmark(dataset, num_elems, "read_parallel_gzip")
+
+  def benchmarkReadSnapshotParallelGzipDeterministic(self):
+    num_elems = 100000
+    tmp_dir = self._makeSnapshotDirectory()
+    dataset = self._createSimpleDataset(
+        num_elems,
+        tmp_dir,
+        compression=snapshot.COMPRESSION_GZIP,
+        num_writer_threads=4,
+        num_reader_threads=4,
+        reader_buffer_size=64,
+        deterministic_reads=True)
+
+    self._consumeDataset(dataset, num_elems)
+    self.run_and_report_benchmark(dataset, num_elems,
+                                  "read_parallel_gzip_deterministic")
+
 
 if __name__ == "__main__":
   test.main()
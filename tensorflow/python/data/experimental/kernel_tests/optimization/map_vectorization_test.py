@@ -37,9 +37,11 @@ from tensorflow.python.ops import bitwise_ops
 from tensorflow.python.ops import check_ops
 from tensorflow.python.ops import clip_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import image_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn
 from tensorflow.python.ops import parsing_ops
+from tensorflow.python.ops import string_ops
 from tensorflow.python.platform import test
 
 
@@ -284,11 +286,34 @@ def _generate_optimization_test_cases():
     b = lambda i: math_ops.add(i, 1)
     return control_flow_ops.while_loop(c, b, [x])
 
+  def string_dataset_factory():
+    return dataset_ops.Dataset.from_tensor_slices(
+        [" Hello ", "WORLD", " foo bar  ", ""]).repeat(5)
+
+  def image_dataset_factory():
+    return dataset_ops.Dataset.from_tensors(
+        np.random.rand(2, 8, 6, 3).astype(np.float32)).repeat(5)
+
+  def index_dataset_factory():
+    return dataset_ops.Dataset.range(5).repeat(5)
+
+  vocabulary = constant_op.constant(["a", "b", "c", "d", "e"])
+
+  def partially_vectorizable_fn(x):
+    # There is no vectorizer for `MatMul`, so only the ops before and after it
+    # are vectorized.
+    x = math_ops.cast(x, dtypes.float32)
+    x = math_ops.matmul(x, x, transpose_b=True)
+    return nn.relu(x)
+
   # Misc test cases
   test_cases = [
       ("Basic", lambda x: (x, x + 1), base_dataset_factory),
       ("Broadcast", lambda x: x + rand_val, base_dataset_factory),
-      ("Cycle", map_fn_with_cycle, lambda: dataset_ops.Dataset.from_tensors(1)),
+      # None of the ops of a while loop can be vectorized, so the cost model
+      # prevents the rewrite.
+      ("Cycle", map_fn_with_cycle, lambda: dataset_ops.Dataset.from_tensors(1),
+       False),
       ("Const", lambda x: 2, base_dataset_factory),
       ("Cast", lambda x: math_ops.cast(x, dtypes.float64),
        base_dataset_factory),
@@ -303,6 +328,27 @@ def _generate_optimization_test_cases():
       ("ParseSingleExample", parse_fn, parse_base),
       ("ParseSingleExampleDenseOutputOnly", dense_output_only_parse_fn,
        parse_base),
+      # String ops
+      ("StringLower", string_ops.string_lower, string_dataset_factory),
+      ("StringStrip", string_ops.string_strip, string_dataset_factory),
+      ("RegexReplace", lambda x: string_ops.regex_replace(x, "o+", "0"),
+       string_dataset_factory),
+      ("StringToHashBucketFast",
+       lambda x: string_ops.string_to_hash_bucket_fast(x, 10),
+       string_dataset_factory),
+      # Image ops
+      ("ResizeBilinear", lambda x: image_ops.resize_bilinear(x, (4, 3)),
+       image_dataset_factory),
+      ("AdjustContrast", lambda x: image_ops.adjust_contrast(x, 2.),
+       image_dataset_factory),
+      # Gather
+      ("GatherVocabulary", lambda x: array_ops.gather(vocabulary, x),
+       index_dataset_factory),
+      ("GatherStackedParams", lambda x: array_ops.gather(x, [2, 0], axis=1),
+       base_dataset_factory),
+      # Partially vectorizable map functions
+      ("PartiallyVectorizable", partially_vectorizable_fn,
+       base_dataset_factory),
   ] + _generate_cwise_test_cases()
 
   return [{
@@ -313,7 +359,9 @@ def _generate_optimization_test_cases():
       "base_dataset_factory":
           x[2],
       "num_parallel_calls":
-          num_parallel_calls
+          num_parallel_calls,
+      "expect_optimized":
+          x[3] if len(x) > 3 else True
   } for x in test_cases for num_parallel_calls in (None, 12)]
 
 
@@ -371,10 +419,12 @@ class MapVectorizationTest(test_base.DatasetTestBase, parameterized.TestCase):
     return unoptimized, optimized
 
   @parameterized.named_parameters(_generate_optimization_test_cases())
-  def testOptimization(self, map_fn, base_dataset_factory, num_parallel_calls):
+  def testOptimization(self, map_fn, base_dataset_factory, num_parallel_calls,
+                       expect_optimized):
     base_dataset = base_dataset_factory()
     unoptimized, optimized = self._get_test_datasets(base_dataset, map_fn,
-                                                     num_parallel_calls)
+                                                     num_parallel_calls,
+                                                     expect_optimized)
     self.assertDatasetsEqual(unoptimized, optimized)
 
   def testOptimizationBadMapFn(self):
@@ -121,6 +121,47 @@ class OverrideThreadpoolTest(test_base.DatasetTestBase,
 
     self._testNumThreadsHelper(num_threads, override_threadpool_fn)
 
+  @parameterized.named_parameters(
+      ("Default", None),
+      ("2", 2),
+  )
+  def testNumaNode(self, num_threads):
+    # Pinning to node 0 is a no-op on machines without NUMA support, but the
+    # pipeline must produce the same results either way.
+
+    def override_threadpool_fn(dataset):
+      t_options = threading_options.ThreadingOptions()
+      t_options.numa_node = 0
+      if num_threads is not None:
+        t_options.private_threadpool_size = num_threads
+      options = dataset_ops.Options()
+      options.experimental_threading = t_options
+      return dataset.with_options(options)
+
+    self._testNumThreadsHelper(num_threads, override_threadpool_fn)
+
+  def testNumaNodeDeprecated(self):
+
+    def override_threadpool_fn(dataset):
+      return threadpool.override_threadpool(
+          dataset,
+          threadpool.PrivateThreadPool(
+              4, display_name="numa_thread_pool", numa_node=0))
+
+    self._testNumThreadsHelper(4, override_threadpool_fn)
+
+  def testNumaNodeAsGraphDefInternal(self):
+    dataset = dataset_ops.Dataset.from_tensors(0)
+    dataset = dataset_ops._PrivateThreadPoolDataset(dataset, 0, numa_node=0)
+    graph = graph_pb2.GraphDef().FromString(
+        self.evaluate(dataset._as_serialized_graph()))
+    numa_nodes = [
+        node.attr["numa_node"].i
+        for node in graph.node
+        if node.op == "PrivateThreadPoolDataset"
+    ]
+    self.assertEqual([0], numa_nodes)
+
   def testMaxIntraOpParallelismAsGraphDefInternal(self):
     dataset = dataset_ops.Dataset.from_tensors(0)
     dataset = dataset_ops._MaxIntraOpParallelismDataset(dataset, 1)
@@ -0,0 +1,177 @@
+# Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for `SharedMemoryWriter` and `SharedMemoryDataset`."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+import uuid
+
+from absl.testing import parameterized
+
+from tensorflow.python.data.experimental.ops import shared_memory
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.eager import context
+from tensorflow.python.framework import combinations
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import errors
+from tensorflow.python.framework import tensor_spec
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import string_ops
+from tensorflow.python.platform import test
+
+
+class SharedMemoryTest(test_base.DatasetTestBase, parameterized.TestCase):
+
+  def _buffer_name(self):
+    return "shared_memory_test_%d_%s" % (os.getpid(), uuid.uuid4().hex)
+
+  def _start_writer(self, writer, dataset, expected_error=None):
+    """Runs `writer.write(dataset)` in a background thread."""
+    if context.executing_eagerly():
+      def write():
+        # The eager mode of the test does not carry over to other threads.
+        with context.eager_mode():
+          writer.write(dataset)
+    else:
+      write_op = writer.write(dataset)
+      write = lambda: self.evaluate(write_op)
+
+    def run():
+      try:
+        write()
+      except Exception as e:  # pylint: disable=broad-except
+        if expected_error is None or not isinstance(e, expected_error):
+          raise
+
+    thread = self.checkedThread(run)
+    thread.start()
+    return thread
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testMultipleConsumers(self):
+    num_elements = 100
+    buffer_name = self._buffer_name()
+    dataset = dataset_ops.Dataset.range(num_elements).map(
+        lambda x: (x, array_ops.fill([3], math_ops.cast(x, dtypes.float32)),
+                   string_ops.as_string(x)))
+    writer = shared_memory.SharedMemoryWriter(
+        buffer_name, num_consumers=2, num_slots=4, slot_size_bytes=1024)
+    thread = self._start_writer(writer, dataset)
+
+    next_fns = [
+        self.getNext(
+            shared_memory.SharedMemoryDataset(
+                buffer_name,
+                consumer_index=i,
+                element_spec=dataset.element_spec,
+                timeout_ms=10000)) for i in range(2)
+    ]
+    for i in range(num_elements):
+      for next_fn in next_fns:
+        x, y, z = self.evaluate(next_fn())
+        self.assertEqual(i, x)
+        self.assertEqual([float(i)] * 3, y.tolist())
+        self.assertEqual(str(i).encode(), z)
+    for next_fn in next_fns:
+      with self.assertRaises(errors.OutOfRangeError):
+        self.evaluate(next_fn())
+    thread.join()
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testBatchMoreElementsThanSlots(self):
+    buffer_name = self._buffer_name()
+    dataset = dataset_ops.Dataset.range(100).map(
+        lambda x: array_ops.fill([3], math_ops.cast(x, dtypes.float32)))
+    writer = shared_memory.SharedMemoryWriter(
+        buffer_name, num_slots=4, slot_size_bytes=1024)
+    thread = self._start_writer(writer, dataset)
+
+    # Each batch holds 10 elements before copying them.
+    next_fn = self.getNext(
+        shared_memory.SharedMemoryDataset(
+            buffer_name,
+            consumer_index=0,
+            element_spec=dataset.element_spec,
+            timeout_ms=10000).batch(10))
+    for i in range(10):
+      expected = [[float(x)] * 3 for x in range(10 * i, 10 * i + 10)]
+      self.assertEqual(expected, self.evaluate(next_fn()).tolist())
+    with self.assertRaises(errors.OutOfRangeError):
+      self.evaluate(next_fn())
+    thread.join()
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testWriterError(self):
+    buffer_name = self._buffer_name()
+    dataset = dataset_ops.Dataset.from_tensor_slices([1.0, 2.0, 0.0]).map(
+        lambda x: array_ops.check_numerics(1.0 / x, "division by zero"))
+    writer = shared_memory.SharedMemoryWriter(buffer_name)
+    thread = self._start_writer(
+        writer, dataset, expected_error=errors.InvalidArgumentError)
+
+    next_fn = self.getNext(
+        shared_memory.SharedMemoryDataset(
+            buffer_name,
+            consumer_index=0,
+            element_spec=dataset.element_spec,
+            timeout_ms=10000))
+    self.assertEqual(1.0, self.evaluate(next_fn()))
+    self.assertEqual(0.5, self.evaluate(next_fn()))
+    with self.assertRaisesRegexp(errors.InvalidArgumentError,
+                                 "division by zero"):
+      self.evaluate(next_fn())
+    thread.join()
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testInvalidConsumerIndex(self):
+    buffer_name = self._buffer_name()
+    dataset = dataset_ops.Dataset.range(10)
+    writer = shared_memory.SharedMemoryWriter(buffer_name, num_consumers=1)
+    thread = self._start_writer(writer, dataset)
+
+    with self.assertRaises(errors.InvalidArgumentError):
+      next_fn = self.getNext(
+          shared_memory.SharedMemoryDataset(
+              buffer_name,
+              consumer_index=1,
+              element_spec=dataset.element_spec,
+              timeout_ms=10000))
+      self.evaluate(next_fn())
+    self.assertDatasetProduces(
+        shared_memory.SharedMemoryDataset(
+            buffer_name,
+            consumer_index=0,
+            element_spec=dataset.element_spec,
+            timeout_ms=10000),
+        expected_output=list(range(10)))
+    thread.join()
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testTimeout(self):
+    dataset = shared_memory.SharedMemoryDataset(
+        self._buffer_name(),
+        consumer_index=0,
+        element_spec=tensor_spec.TensorSpec([], dtypes.int64),
+        timeout_ms=10)
+    with self.assertRaises(errors.DeadlineExceededError):
+      self.evaluate(self.getNext(dataset)())
+
+
+if __name__ == "__main__":
+  test.main()
@@ -256,6 +256,61 @@ class SnapshotDatasetTest(reader_dataset_ops_test_base.TFRecordDatasetTestBase,
             reader_buffer_size=10))
     self.assertDatasetProduces(dataset2, expected, assert_items_equal=True)
 
+  @combinations.generate(
+      combinations.times(
+          test_base.default_test_combinations(),
+          combinations.combine(threads=[1, 2, 3])))
+  def testReadSnapshotParallelDeterministicAfterWrite(self, threads):
+    self.setUpTFRecord(10, 400)
+    filenames = self.test_filenames
+
+    expected = [
+        b"Record %d of file %d" % (r, f)  # pylint:disable=g-complex-comprehension
+        for f in range(0, 10)
+        for r in range(0, 400)
+    ]
+
+    tmpdir = self.makeSnapshotDirectory()
+    dataset = core_readers._TFRecordDataset(filenames)
+    dataset = dataset.apply(
+        snapshot.snapshot(tmpdir, shard_size_bytes=10 * 1024))
+    self.assertDatasetProduces(dataset, expected)
+
+    # remove the original files and try to read the data back only from
+    # snapshot, in the order it was written.
+    self.removeTFRecords()
+
+    dataset2 = core_readers._TFRecordDataset(filenames)
+    dataset2 = dataset2.apply(
+        snapshot.snapshot(
+            tmpdir,
+            shard_size_bytes=10 * 1024,
+            num_reader_threads=threads,
+            reader_buffer_size=10,
+            deterministic_reads=True))
+    self.assertDatasetProduces(dataset2, expected)
+
+  @combinations.generate(
+      combinations.times(
+          test_base.default_test_combinations(),
+          combinations.combine(raw_tensor_encoding=[False, True])))
+  def testReadSnapshotBackWithTensorEncoding(self, raw_tensor_encoding):
+    tmpdir = self.makeSnapshotDirectory()
+
+    dataset = dataset_ops.Dataset.range(100)
+    dataset = dataset.map(lambda x: (x, [x, x + 1], x > 50))
+    dataset = dataset.apply(
+        snapshot.snapshot(tmpdir, raw_tensor_encoding=raw_tensor_encoding))
+    expected = [(x, [x, x + 1], x > 50) for x in range(100)]
+    self.assertDatasetProduces(dataset, expected)
+
+    dataset2 = dataset_ops.Dataset.range(100)
+    dataset2 = dataset2.map(lambda x: (x, [x, x + 1], x > 50))
+    dataset2 = dataset2.apply(
+        snapshot.snapshot(tmpdir, raw_tensor_encoding=raw_tensor_encoding))
+    self.assertDatasetProduces(dataset2, expected)
+    self.assertSnapshotDirectoryContains(tmpdir, 1, 1, 1)
+
   @combinations.generate(
       combinations.times(
           test_base.default_test_combinations(),
@@ -0,0 +1,123 @@
+# Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for `tf.data.experimental.spilling_shuffle()`."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+from absl.testing import parameterized
+
+from tensorflow.python.data.experimental.ops import shuffle_ops
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.framework import combinations
+from tensorflow.python.framework import errors
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import string_ops
+from tensorflow.python.platform import test
+
+# The smallest `max_memory_bytes` that `spilling_shuffle` accepts.
+_MIN_MAX_MEMORY_BYTES = 512 << 10
+
+
+class SpillingShuffleTest(test_base.DatasetTestBase, parameterized.TestCase):
+
+  def _spill_directory(self):
+    spill_directory = os.path.join(self.get_temp_dir(), "spill")
+    if not os.path.exists(spill_directory):
+      os.mkdir(spill_directory)
+    return spill_directory
+
+  def _build_ds(self, num_elements, buffer_size, max_memory_bytes, seed=None):
+    # Each element takes 8 KB, so that the smallest `max_memory_bytes` spills
+    # a run every 32 elements.
+    dataset = dataset_ops.Dataset.range(num_elements)
+    dataset = dataset.map(lambda x: array_ops.fill([1024], x))
+    return dataset.apply(
+        shuffle_ops.spilling_shuffle(
+            buffer_size,
+            max_memory_bytes,
+            spill_directory=self._spill_directory(),
+            seed=seed))
+
+  def _gen_outputs(self, dataset):
+    get_next = self.getNext(dataset)
+    outputs = []
+    while True:
+      try:
+        outputs.append(self.evaluate(get_next())[0])
+      except errors.OutOfRangeError:
+        return outputs
+
+  @combinations.generate(
+      combinations.times(
+          test_base.default_test_combinations(),
+          combinations.combine(
+              max_memory_bytes=[_MIN_MAX_MEMORY_BYTES, 1 << 20, 1 << 30])))
+  def testCorrectOutput(self, max_memory_bytes):
+    # With the smallest `max_memory_bytes`, the buffer holds about 30 runs, so
+    # that runs are merged.
+    output = self._gen_outputs(
+        self._build_ds(2000, 1000, max_memory_bytes, seed=42))
+    self.assertEqual(list(range(2000)), sorted(output))
+    self.assertNotEqual(list(range(2000)), output)
+    # Like `Dataset.shuffle`, an element is produced after at most
+    # `buffer_size - 1` elements that follow it in the input.
+    for i, x in enumerate(output):
+      self.assertLess(x, i + 1000)
+    # All the spilled files have been read and deleted.
+    self.assertEmpty(os.listdir(self._spill_directory()))
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testSameOrderForSameSeeds(self):
+    output1 = self._gen_outputs(
+        self._build_ds(1000, 1000, _MIN_MAX_MEMORY_BYTES, seed=10))
+    output2 = self._gen_outputs(
+        self._build_ds(1000, 1000, _MIN_MAX_MEMORY_BYTES, seed=10))
+    output3 = self._gen_outputs(
+        self._build_ds(1000, 1000, _MIN_MAX_MEMORY_BYTES, seed=20))
+    self.assertEqual(output1, output2)
+    self.assertNotEqual(output1, output3)
+    self.assertEqual(sorted(output1), sorted(output3))
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testMultipleComponents(self):
+    dataset = dataset_ops.Dataset.range(500)
+    dataset = dataset.map(lambda x: (x, string_ops.as_string(x), [x, x]))
+    dataset = dataset.apply(
+        shuffle_ops.spilling_shuffle(
+            1000,
+            _MIN_MAX_MEMORY_BYTES,
+            spill_directory=self._spill_directory(),
+            seed=1))
+    expected = [(x, b"%d" % x, [x, x]) for x in range(500)]
+    self.assertDatasetProduces(dataset, expected, assert_items_equal=True)
+
+  @combinations.generate(
+      combinations.times(
+          test_base.default_test_combinations(),
+          combinations.combine(max_memory_bytes=[-1, 0, 100])))
+  def testInvalidMaxMemoryBytes(self, max_memory_bytes):
+    dataset = self._build_ds(10, 10, max_memory_bytes)
+    self.assertDatasetProduces(
+        dataset,
+        expected_error=(errors.InvalidArgumentError,
+                        "max_memory_bytes must be at least"))
+
+
+if __name__ == "__main__":
+  test.main()
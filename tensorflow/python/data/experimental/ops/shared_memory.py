@@ -0,0 +1,133 @@
+# Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Experimental API for sharing a `tf.data` pipeline between local processes.
+
+One process runs the input pipeline and publishes its elements in a shared
+memory buffer with `SharedMemoryWriter`, and the other processes of the host,
+e.g. the replicas of a model, read them with `SharedMemoryDataset`:
+
+```python
+# In the producer process.
+writer = SharedMemoryWriter("train_input", num_consumers=NUM_REPLICAS)
+writer.write(dataset)
+
+# In each consumer process.
+dataset = SharedMemoryDataset("train_input", consumer_index=REPLICA_INDEX,
+                              element_spec=ELEMENT_SPEC)
+```
+
+Every consumer reads every element, in order. The tensors of numeric types
+that consumers read point into the shared memory buffer, whose slot is reused
+once they are destroyed, so the input pipeline runs once per host instead of
+once per process. Consumers that hold many elements, e.g. to batch them, copy
+the elements they read past `(num_slots - 1) / num_consumers` held elements,
+so that the writer always has a free slot. Shared memory buffers are not
+supported on Windows.
+"""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.data.util import structure
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import gen_experimental_dataset_ops
+
+
+class SharedMemoryWriter(object):
+  """Publishes the elements of a dataset in a shared memory buffer."""
+
+  def __init__(self,
+               buffer_name,
+               num_consumers=1,
+               num_slots=16,
+               slot_size_bytes=16 << 20):
+    """Creates a `SharedMemoryWriter`.
+
+    Args:
+      buffer_name: A `tf.string` scalar, the name of the shared memory buffer,
+        which must be non-empty and must not contain "/".
+      num_consumers: A `tf.int64` scalar, the number of `SharedMemoryDataset`s
+        that read every element of the buffer.
+      num_slots: A `tf.int64` scalar, the number of elements the buffer holds.
+      slot_size_bytes: A `tf.int64` scalar, the maximum size in bytes of an
+        element in the buffer.
+    """
+    self._buffer_name = ops.convert_to_tensor(
+        buffer_name, dtypes.string, name="buffer_name")
+    self._num_consumers = ops.convert_to_tensor(
+        num_consumers, dtypes.int64, name="num_consumers")
+    self._num_slots = ops.convert_to_tensor(
+        num_slots, dtypes.int64, name="num_slots")
+    self._slot_size_bytes = ops.convert_to_tensor(
+        slot_size_bytes, dtypes.int64, name="slot_size_bytes")
+
+  def write(self, dataset):
+    """Returns a `tf.Operation` to publish the elements of a dataset.
+
+    Args:
+      dataset: a `tf.data.Dataset` whose elements are to be published. The
+        elements must be made of dense tensors of numeric or string types.
+
+    Returns:
+      A `tf.Operation` that, when run, publishes the elements of `dataset` and
+      returns once every consumer has read every element.
+    """
+    if not isinstance(dataset, dataset_ops.DatasetV2):
+      raise TypeError("`dataset` must be a `tf.data.Dataset` object.")
+    return gen_experimental_dataset_ops.dataset_to_shared_memory(
+        dataset._variant_tensor,  # pylint: disable=protected-access
+        self._buffer_name,
+        self._num_consumers,
+        self._num_slots,
+        self._slot_size_bytes)
+
+
+class SharedMemoryDataset(dataset_ops.DatasetSource):
+  """A `Dataset` that reads the elements published by a `SharedMemoryWriter`."""
+
+  def __init__(self, buffer_name, consumer_index, element_spec,
+               timeout_ms=-1):
+    """Creates a `SharedMemoryDataset`.
+
+    Args:
+      buffer_name: A `tf.string` scalar, the name of the shared memory buffer.
+      consumer_index: A `tf.int64` scalar, the index of this consumer, which
+        must be less than the `num_consumers` of the writer.
+      element_spec: A nested structure of `tf.TensorSpec`s describing the
+        elements of the dataset published by the writer.
+      timeout_ms: (Optional.) A `tf.int64` scalar, the time in milliseconds to
+        wait for the writer to create the buffer. If negative, waits until the
+        iterator is cancelled.
+    """
+    self._buffer_name = ops.convert_to_tensor(
+        buffer_name, dtypes.string, name="buffer_name")
+    self._consumer_index = ops.convert_to_tensor(
+        consumer_index, dtypes.int64, name="consumer_index")
+    self._timeout_ms = ops.convert_to_tensor(
+        timeout_ms, dtypes.int64, name="timeout_ms")
+    self._element_spec = element_spec
+    variant_tensor = gen_experimental_dataset_ops.shared_memory_dataset(
+        self._buffer_name,
+        self._consumer_index,
+        self._timeout_ms,
+        output_types=structure.get_flat_tensor_types(element_spec),
+        output_shapes=structure.get_flat_tensor_shapes(element_spec))
+    super(SharedMemoryDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return self._element_spec
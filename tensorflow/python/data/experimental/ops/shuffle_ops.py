@@ -23,6 +23,7 @@ from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import gen_dataset_ops
+from tensorflow.python.ops import gen_experimental_dataset_ops
 from tensorflow.python.util import deprecation
 from tensorflow.python.util.tf_export import tf_export
 
@@ -90,3 +91,77 @@ def shuffle_and_repeat(buffer_size, count=None, seed=None):
     return _ShuffleAndRepeatDataset(dataset, buffer_size, count, seed)
 
   return _apply_fn
+
+
+class _SpillingShuffleDataset(dataset_ops.UnaryUnchangedStructureDataset):
+  """A `Dataset` that shuffles elements, spilling its buffer to disk."""
+
+  def __init__(self,
+               input_dataset,
+               buffer_size,
+               max_memory_bytes,
+               spill_directory=None,
+               seed=None):
+    self._input_dataset = input_dataset
+    self._buffer_size = ops.convert_to_tensor(
+        buffer_size, dtype=dtypes.int64, name="buffer_size")
+    self._max_memory_bytes = ops.convert_to_tensor(
+        max_memory_bytes, dtype=dtypes.int64, name="max_memory_bytes")
+    self._spill_directory = ops.convert_to_tensor(
+        spill_directory if spill_directory is not None else "",
+        dtype=dtypes.string,
+        name="spill_directory")
+    self._seed, self._seed2 = random_seed.get_seed(seed)
+    variant_tensor = gen_experimental_dataset_ops.spilling_shuffle_dataset(
+        self._input_dataset._variant_tensor,  # pylint: disable=protected-access
+        buffer_size=self._buffer_size,
+        seed=self._seed,
+        seed2=self._seed2,
+        max_memory_bytes=self._max_memory_bytes,
+        spill_directory=self._spill_directory,
+        **self._flat_structure)
+    super(_SpillingShuffleDataset, self).__init__(input_dataset,
+                                                  variant_tensor)
+
+
+def spilling_shuffle(buffer_size,
+                     max_memory_bytes,
+                     spill_directory=None,
+                     seed=None):
+  """Shuffles a Dataset with a buffer that may not fit in memory.
+
+  Like `tf.data.Dataset.shuffle`, the elements are sampled uniformly at random
+  from a buffer of `buffer_size` elements. At most half of `max_memory_bytes`
+  of buffered elements are kept in memory: beyond that, the elements in memory
+  are shuffled and written to a file in `spill_directory`, from which they are
+  read back as they are sampled. The other half holds the read buffers of
+  these files, which are merged to bound their number. The files are deleted
+  once they have been read, or when the iterator is destroyed.
+
+  Iterators of the resulting dataset can only be checkpointed before any
+  element has been spilled to disk.
+
+  Args:
+    buffer_size: A `tf.int64` scalar `tf.Tensor`, representing the number of
+      elements from the dataset to sample from.
+    max_memory_bytes: A `tf.int64` scalar `tf.Tensor`, representing the
+      maximum number of bytes of memory to use, including the read buffers of
+      the spilled files. Must be at least 512 KB.
+    spill_directory: (Optional.) A `tf.string` scalar `tf.Tensor`, representing
+      the local directory to spill elements to. Defaults to a local temporary
+      directory.
+    seed: (Optional.) A `tf.int64` scalar `tf.Tensor`, representing the
+      random seed that will be used to create the distribution. If no seed is
+      set, each iteration produces a different order. See
+      `tf.compat.v1.set_random_seed` for behavior.
+
+  Returns:
+    A `Dataset` transformation function, which can be passed to
+    `tf.data.Dataset.apply`.
+  """
+
+  def _apply_fn(dataset):  # pylint: disable=missing-docstring
+    return _SpillingShuffleDataset(dataset, buffer_size, max_memory_bytes,
+                                   spill_directory, seed)
+
+  return _apply_fn
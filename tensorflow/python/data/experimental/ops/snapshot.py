@@ -44,7 +44,9 @@ class _SnapshotDataset(dataset_ops.UnaryUnchangedStructureDataset):
                num_writer_threads=None,
                writer_buffer_size=None,
                shuffle_on_read=None,
-               seed=None):
+               seed=None,
+               raw_tensor_encoding=None,
+               deterministic_reads=None):
 
     self._compression = compression if compression is not None else ""
     self._reader_path_prefix = (
@@ -66,6 +68,10 @@ class _SnapshotDataset(dataset_ops.UnaryUnchangedStructureDataset):
         writer_buffer_size if writer_buffer_size is not None else -1)
     self._shuffle_on_read = (
         shuffle_on_read if shuffle_on_read is not None else False)
+    self._raw_tensor_encoding = (
+        raw_tensor_encoding if raw_tensor_encoding is not None else False)
+    self._deterministic_reads = (
+        deterministic_reads if deterministic_reads is not None else False)
 
     self._seed, self._seed2 = random_seed.get_seed(seed)
 
@@ -87,6 +93,8 @@ class _SnapshotDataset(dataset_ops.UnaryUnchangedStructureDataset):
         shuffle_on_read=self._shuffle_on_read,
         seed=self._seed,
         seed2=self._seed2,
+        raw_tensor_encoding=self._raw_tensor_encoding,
+        deterministic_reads=self._deterministic_reads,
         **self._flat_structure)
     super(_SnapshotDataset, self).__init__(input_dataset, variant_tensor)
 
@@ -102,7 +110,9 @@ def snapshot(path,
              num_writer_threads=None,
              writer_buffer_size=None,
              shuffle_on_read=None,
-             seed=None):
+             seed=None,
+             raw_tensor_encoding=None,
+             deterministic_reads=None):
   """Writes to/reads from a snapshot of a dataset.
 
   This function attempts to determine whether a valid snapshot exists at the
@@ -127,7 +137,8 @@ def snapshot(path,
       Especially useful if compression is turned on since the decompression
       operation tends to be intensive. Defaults to 1. If > 1, then this might
       introduce non-determinism i.e. the order in which the elements are
-      read from the snapshot are different from the order they're written.
+      read from the snapshot are different from the order they're written,
+      unless `deterministic_reads` is True.
     reader_buffer_size: Maximum number of elements we can prefetch reading from
       the snapshot. Defaults to 1. Increasing this might improve performance
       but will increase memory consumption.
@@ -144,6 +155,15 @@ def snapshot(path,
       produced when reading from a snapshot will be random. Defaults to False.
     seed: If seed is set, the random number generator is seeded by the given
       seed. Otherwise, it is seeded by a random seed.
+    raw_tensor_encoding: If this is True, the contents of the tensors are
+      written as they are rather than as `TensorProto`s, which makes reading
+      and writing the snapshot cheaper. Only applies when all the components
+      of the dataset have numeric or boolean types. Defaults to False.
+    deterministic_reads: If this is True, the elements read with
+      `num_reader_threads` > 1 are produced in the order of the snapshot
+      files rather than as they are read, at the cost of buffering up to
+      `reader_buffer_size / num_reader_threads` elements per thread. Defaults
+      to False.
   Returns:
     A `Dataset` transformation function, which can be passed to
     `tf.data.Dataset.apply`.
@@ -154,6 +174,7 @@ def snapshot(path,
                             writer_path_prefix, shard_size_bytes,
                             pending_snapshot_expiry_seconds, num_reader_threads,
                             reader_buffer_size, num_writer_threads,
-                            writer_buffer_size, shuffle_on_read, seed)
+                            writer_buffer_size, shuffle_on_read, seed,
+                            raw_tensor_encoding, deterministic_reads)
 
   return _apply_fn
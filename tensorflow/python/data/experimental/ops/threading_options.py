@@ -43,6 +43,15 @@ class ThreadingOptions(options.OptionsBase):
       docstring=
       "If set, it overrides the maximum degree of intra-op parallelism.")
 
+  numa_node = options.create_option(
+      name="numa_node",
+      ty=int,
+      docstring=
+      "If set, the dataset will use a private threadpool whose threads are "
+      "pinned to the given NUMA node, and will allocate its elements from the "
+      "memory of that node where possible. Unless `private_threadpool_size` is "
+      "also set, the threadpool has one thread per core of the node.")
+
   private_threadpool_size = options.create_option(
       name="private_threadpool_size",
       ty=int,
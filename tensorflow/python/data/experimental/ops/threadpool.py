@@ -42,22 +42,31 @@ class PrivateThreadPool(object):
   """A stateful resource that represents a private thread pool."""
 
   def __init__(self, num_threads, display_name=None,
-               max_intra_op_parallelism=1):
-    """Creates a `PrivateThreadPool` with the given number of threads."""
+               max_intra_op_parallelism=1, numa_node=None):
+    """Creates a `PrivateThreadPool` with the given number of threads.
+
+    If `numa_node` is set, the threads of the pool, and the threads of the
+    datasets that use it, are pinned to that NUMA node.
+    """
+    kwargs = {}
+    if numa_node is not None:
+      kwargs["numa_node"] = numa_node
     if context.executing_eagerly():
       shared_name = _generate_shared_name("privatethreadpool")
       self._resource = ged_ops.thread_pool_handle(
           num_threads=num_threads,
           max_intra_op_parallelism=max_intra_op_parallelism,
           display_name=display_name,
-          shared_name=shared_name)
+          shared_name=shared_name,
+          **kwargs)
       self._resource_deleter = resource_variable_ops.EagerResourceDeleter(
           handle=self._resource, handle_device=context.context().device_name)
     else:
       self._resource = ged_ops.thread_pool_handle(
           num_threads=num_threads,
           max_intra_op_parallelism=max_intra_op_parallelism,
-          display_name=display_name)
+          display_name=display_name,
+          **kwargs)
 
 
 class _ThreadPoolDataset(dataset_ops.UnaryUnchangedStructureDataset):
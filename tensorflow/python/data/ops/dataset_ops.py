@@ -99,6 +99,7 @@ tf_export("data.experimental.AUTOTUNE").export_constant(__name__, "AUTOTUNE")
 class AutotuneAlgorithm(enum.Enum):
   HILL_CLIMB = 0
   GRADIENT_DESCENT = 1
+  FEEDBACK = 2
 
 
 @tf_export("data.Dataset", v1=[])
@@ -284,7 +285,11 @@ class DatasetV2(tracking_base.Trackable, composite_tensor.CompositeTensor):
       if t_options.max_intra_op_parallelism is not None:
         dataset = _MaxIntraOpParallelismDataset(
             dataset, t_options.max_intra_op_parallelism)
-      if t_options.private_threadpool_size is not None:
+      if t_options.numa_node is not None:
+        dataset = _PrivateThreadPoolDataset(
+            dataset, t_options.private_threadpool_size or 0,
+            numa_node=t_options.numa_node)
+      elif t_options.private_threadpool_size is not None:
         dataset = _PrivateThreadPoolDataset(dataset,
                                             t_options.private_threadpool_size)
     # pylint: disable=protected-access
@@ -3814,14 +3819,19 @@ class _MaxIntraOpParallelismDataset(UnaryUnchangedStructureDataset):
 class _PrivateThreadPoolDataset(UnaryUnchangedStructureDataset):
   """A `Dataset` that acts as an identity, setting a private threadpool."""
 
-  def __init__(self, input_dataset, num_threads):
+  def __init__(self, input_dataset, num_threads, numa_node=None):
     self._input_dataset = input_dataset
     self._num_threads = ops.convert_to_tensor(
         num_threads, dtype=dtypes.int64, name="num_threads")
+    kwargs = self._flat_structure
+    # Only set `numa_node` when requested, so that graphs remain loadable by
+    # binaries that predate the attribute.
+    if numa_node is not None:
+      kwargs["numa_node"] = numa_node
     variant_tensor = ged_ops.private_thread_pool_dataset(
         input_dataset._variant_tensor,  # pylint: disable=protected-access
         self._num_threads,
-        **self._flat_structure)
+        **kwargs)
     super(_PrivateThreadPoolDataset, self).__init__(input_dataset,
                                                     variant_tensor)
 